@@ -46,6 +46,18 @@ static const uint8_t gcr_6_2_byte[64] = {
     0xd6, 0xd7, 0xd9, 0xda, 0xdb, 0xdc, 0xdd, 0xde, 0xdf, 0xe5, 0xe6, 0xe7, 0xe9, 0xea, 0xeb, 0xec,
     0xed, 0xee, 0xef, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf9, 0xfa, 0xfb, 0xfc, 0xfd, 0xfe, 0xff};
 
+/* Inverse of gcr_6_2_byte indexed by (disk byte - 0x80), since disk bytes
+   always have their high bit set.  Invalid disk bytes map to 0xff. */
+static const uint8_t gcr_6_2_decode[128] = {
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x00, 0x01, 0xff, 0xff, 0x02, 0x03, 0xff, 0x04, 0x05, 0x06,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x07, 0x08, 0xff, 0xff, 0xff, 0x09, 0x0a, 0x0b, 0x0c, 0x0d,
+    0xff, 0xff, 0x0e, 0x0f, 0x10, 0x11, 0x12, 0x13, 0xff, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1a,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x1b, 0xff, 0x1c, 0x1d, 0x1e,
+    0xff, 0xff, 0xff, 0x1f, 0xff, 0xff, 0x20, 0x21, 0xff, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0x29, 0x2a, 0x2b, 0xff, 0x2c, 0x2d, 0x2e, 0x2f, 0x30, 0x31, 0x32,
+    0xff, 0xff, 0x33, 0x34, 0x35, 0x36, 0x37, 0x38, 0xff, 0x39, 0x3a, 0x3b, 0x3c, 0x3d, 0x3e, 0x3f};
+
 static const unsigned prodos_to_logical_sector_map_525[1][16] = {
     {0, 8, 1, 9, 2, 10, 3, 11, 4, 12, 5, 13, 6, 14, 7, 15}};
 
@@ -402,30 +414,51 @@ static void _clem_nib_init_encoder(struct ClemensNibEncoder *encoder, uint8_t *b
     encoder->bit_index_end = (end - begin) * 8;
 }
 
-static void _clem_nib_write_bytes(struct ClemensNibEncoder *encoder, unsigned cnt, unsigned bit_cnt,
-                                  uint8_t value) {
-    uint8_t *nib_cur = encoder->begin + (encoder->bit_index / 8);
-    unsigned bit_count = bit_cnt * cnt;
-    unsigned nib_bit_index_end = encoder->bit_index + bit_count;
-    unsigned bit_cnt_minus_1 = bit_cnt - 1;
-    unsigned out_shift = 7 - (encoder->bit_index % 8);
-    unsigned in_shift = 0;
-
-    nib_bit_index_end %= encoder->bit_index_end;
+/* Writes the low bit_cnt bits of value (most significant first.)  Writes that
+   fit before the end of the track are merged into at most three bytes at once.
+   Writes crossing the track end wrap to its start bit by bit.
+*/
+static void _clem_nib_write_bits(struct ClemensNibEncoder *encoder, unsigned value,
+                                 unsigned bit_cnt) {
+    unsigned bit_index = encoder->bit_index;
+    uint8_t *nib_cur = encoder->begin + (bit_index / 8);
+    unsigned out_shift, in_shift;
+
+    if (bit_index + bit_cnt < encoder->bit_index_end) {
+        /* align the bits into a 24-bit window starting at nib_cur */
+        unsigned window_shift = 24 - (bit_index % 8) - bit_cnt;
+        uint32_t mask = ((1U << bit_cnt) - 1) << window_shift;
+        uint32_t window = ((uint32_t)value << window_shift) & mask;
+        nib_cur[0] = (uint8_t)((nib_cur[0] & ~(mask >> 16)) | (window >> 16));
+        if (mask & 0xffff) {
+            nib_cur[1] = (uint8_t)((nib_cur[1] & ~(mask >> 8)) | (window >> 8));
+            if (mask & 0xff) {
+                nib_cur[2] = (uint8_t)((nib_cur[2] & ~mask) | window);
+            }
+        }
+        encoder->bit_index = bit_index + bit_cnt;
+        return;
+    }
 
-    while (encoder->bit_index != nib_bit_index_end) {
-        if (value & (1 << (bit_cnt_minus_1 - in_shift))) {
+    for (in_shift = bit_cnt; in_shift > 0; --in_shift) {
+        out_shift = 7 - (encoder->bit_index % 8);
+        if (value & (1 << (in_shift - 1))) {
             nib_cur[0] |= (1 << out_shift);
         } else {
             nib_cur[0] &= ~(1 << out_shift);
         }
         encoder->bit_index = (encoder->bit_index + 1) % encoder->bit_index_end;
-        in_shift = (in_shift + 1) % bit_cnt;
-        out_shift = 7 - (encoder->bit_index % 8);
         nib_cur = encoder->begin + (encoder->bit_index / 8);
     }
 }
 
+static void _clem_nib_write_bytes(struct ClemensNibEncoder *encoder, unsigned cnt, unsigned bit_cnt,
+                                  uint8_t value) {
+    while (cnt--) {
+        _clem_nib_write_bits(encoder, value, bit_cnt);
+    }
+}
+
 static void _clem_nib_encode_self_sync_ff(struct ClemensNibEncoder *encoder, unsigned cnt) {
     _clem_nib_write_bytes(encoder, cnt, 10, 0xff);
 }
@@ -590,28 +623,93 @@ static void _clem_nib_encode_data_525(struct ClemensNibEncoder *encoder, const u
       the time to decode data into memory before reading the next sector in
       sequence
     - in general DOS and ProDOS formatting is interchangeable at this level
+
+   The pass is split so that a track can be encoded knowing only its index -
+   clem_2img_nibblize_prepare lays out every track's location in the bits
+   buffer up front, which lets tracks be encoded in any order.
 */
-bool clem_2img_nibblize_data(struct Clemens2IMGDisk *disk) {
-    unsigned clem_max_sectors_per_region[CLEM_DISK_35_NUM_REGIONS];
-    unsigned clem_track_start_per_region[CLEM_DISK_35_NUM_REGIONS + 1];
-    unsigned self_sync_gap_1_cnt = 0;
-    unsigned self_sync_gap_2_cnt = 0;
-    unsigned self_sync_gap_3_cnt = 0;
-    const unsigned(*to_logical_sector_map)[16] = NULL;
-    unsigned num_regions = 0, current_region = 0;
-    unsigned track_increment = 0;
-    unsigned track_byte_offset;
-    unsigned logical_sector_index;
-    unsigned i, qtr_track_index;
-    uint8_t *nib_begin = disk->nib->bits_data;
-    uint8_t *nib_out = nib_begin;
-    unsigned data_in_size = disk->data_end - disk->data;
+struct _ClemNibTrackFormat {
+    unsigned self_sync_gap_1_cnt;
+    unsigned self_sync_gap_2_cnt;
+    unsigned self_sync_gap_3_cnt;
+    unsigned track_increment;
     unsigned in_sector_size;
+    const unsigned (*to_logical_sector_map)[16];
+};
+
+static bool _clem_nib_get_track_format(const struct Clemens2IMGDisk *disk,
+                                       struct _ClemNibTrackFormat *format) {
+    /* gap values are derived from a mix of Beneath Apple DOS and ProDOS
+       sources and Ciderpress mentions (the 3.5" equivalents, which are
+       *very* hard to derive from existing documentation) */
+    switch (disk->nib->disk_type) {
+    case CLEM_DISK_TYPE_3_5:
+        /* guesswork based on gap 3 size of 36 10-bit bytes and the  */
+        format->self_sync_gap_1_cnt = (CLEM_DISK_35_BYTES_TRACK_GAP_1 * 8) / 10;
+        format->self_sync_gap_2_cnt = 4;
+        format->self_sync_gap_3_cnt = (CLEM_DISK_35_BYTES_TRACK_GAP_3 * 8) / 10;
+        format->track_increment = disk->nib->is_double_sided ? 1 : 2;
+        format->in_sector_size = 512;
+        break;
+    case CLEM_DISK_TYPE_5_25:
+        /* From Beneath Apple DOS/ProDOS - evaluate if DOS values should
+           reflect those from Beneath Apple DOS. - anyway these are taken
+           from Ciderpress and ROM 03 ProDOS block formatting disassembly */
+        format->self_sync_gap_1_cnt = 64; /* somewhere between 12-85 */
+        format->self_sync_gap_2_cnt = 6;  /* somewhere between 5- 10 */
+        format->self_sync_gap_3_cnt = 24; /* somewhere between 16-28 */
+        format->track_increment = 4;
+        format->in_sector_size = 256;
+        break;
+    default:
+        return false;
+    }
+
+    switch (disk->format) {
+    case CLEM_2IMG_FORMAT_PRODOS:
+        if (disk->nib->disk_type == CLEM_DISK_TYPE_3_5) {
+            format->to_logical_sector_map = prodos_to_logical_sector_map_35;
+        } else {
+            format->to_logical_sector_map = prodos_to_logical_sector_map_525;
+        }
+        break;
+    case CLEM_2IMG_FORMAT_DOS:
+        if (disk->nib->disk_type != CLEM_DISK_TYPE_5_25)
+            return false;
+        format->to_logical_sector_map = dos_to_logical_sector_map_525;
+        break;
+    case CLEM_2IMG_FORMAT_RAW:
+    default:
+        return false;
+    }
+    return true;
+}
+
+static unsigned _clem_nib_get_region(unsigned disk_type, unsigned qtr_track_index) {
+    unsigned region = 0;
+    if (disk_type != CLEM_DISK_TYPE_3_5)
+        return 0;
+    while (qtr_track_index >= g_clem_track_start_per_region_35[region + 1]) {
+        ++region;
+    }
+    return region;
+}
 
-    /* disk->nib->disk_type must be set before this call
-       gap values are derived from a mix of Beneath Apple DOS and ProDOS
-            sources and Ciderpress mentions (the 3.5" equivalents, which are
-            *very* hard to derive from existing documentation) */
+static unsigned _clem_nib_get_sector_count(unsigned disk_type, unsigned region) {
+    if (disk_type == CLEM_DISK_TYPE_3_5) {
+        return g_clem_max_sectors_per_region_35[region];
+    }
+    return CLEM_DISK_525_NUM_SECTORS_PER_TRACK;
+}
+
+bool clem_2img_nibblize_prepare(struct Clemens2IMGDisk *disk) {
+    struct _ClemNibTrackFormat format;
+    unsigned data_in_size = disk->data_end - disk->data;
+    unsigned track_byte_offset = 0;
+    unsigned sector_count_total = 0;
+    unsigned qtr_track_index, nib_track_index;
+
+    /* disk->nib->disk_type must be set before this call */
     switch (disk->nib->disk_type) {
     case CLEM_DISK_TYPE_3_5:
         if (disk->block_count > 0) {
@@ -629,210 +727,534 @@ bool clem_2img_nibblize_data(struct Clemens2IMGDisk *disk) {
         } else {
             return false;
         }
-        /* guesswork based on gap 3 size of 36 10-bit bytes and the  */
-        self_sync_gap_1_cnt = (CLEM_DISK_35_BYTES_TRACK_GAP_1 * 8) / 10;
-        self_sync_gap_2_cnt = 4;
-        self_sync_gap_3_cnt = (CLEM_DISK_35_BYTES_TRACK_GAP_3 * 8) / 10;
-        num_regions = CLEM_DISK_35_NUM_REGIONS;
-        for (i = 0; i < num_regions; ++i) {
-            clem_max_sectors_per_region[i] = g_clem_max_sectors_per_region_35[i];
-            clem_track_start_per_region[i] = g_clem_track_start_per_region_35[i];
-        }
-        clem_track_start_per_region[num_regions] = (g_clem_track_start_per_region_35[num_regions]);
         /* 80 tracks for single sided - is this ever true?, otherwise the
            full track listing for double sided 3.5" disks */
         disk->nib->bit_timing_ns = 2000;
         disk->nib->track_count = disk->nib->is_double_sided ? 160 : 80;
-        track_increment = disk->nib->is_double_sided ? 1 : 2;
-        in_sector_size = 512;
         break;
     case CLEM_DISK_TYPE_5_25:
-        num_regions = 1;
-        clem_max_sectors_per_region[0] = CLEM_DISK_525_NUM_SECTORS_PER_TRACK;
-        clem_track_start_per_region[0] = 0;
-        clem_track_start_per_region[1] = CLEM_DISK_LIMIT_QTR_TRACKS;
-        /* From Beneath Apple DOS/ProDOS - evaluate if DOS values should
-           reflect those from Beneath Apple DOS. - anyway these are taken
-           from Ciderpress and ROM 03 ProDOS block formatting disassembly */
-        self_sync_gap_1_cnt = 64; /* somewhere between 12-85 */
-        self_sync_gap_2_cnt = 6;  /* somewhere between 5- 10 */
-        self_sync_gap_3_cnt = 24; /* somewhere between 16-28 */
         /* 40 tracks total - always 35 for DOS/ProDOS disks */
         disk->nib->bit_timing_ns = 4000;
         disk->nib->track_count = 35;
-        track_increment = 4;
-        in_sector_size = 256;
         break;
-
     default:
         return false;
     }
-
-    switch (disk->format) {
-    case CLEM_2IMG_FORMAT_PRODOS:
-        if (disk->nib->disk_type == CLEM_DISK_TYPE_3_5) {
-            to_logical_sector_map = prodos_to_logical_sector_map_35;
-        } else {
-            to_logical_sector_map = prodos_to_logical_sector_map_525;
-        }
-        break;
-    case CLEM_2IMG_FORMAT_DOS:
-        assert(disk->nib->disk_type == CLEM_DISK_TYPE_5_25);
-        to_logical_sector_map = dos_to_logical_sector_map_525;
-        break;
-    case CLEM_2IMG_FORMAT_RAW:
-        assert(false);
-    default:
+    if (!_clem_nib_get_track_format(disk, &format))
         return false;
-    }
 
-    /* encode nibbles using the specified image format layout */
-    track_byte_offset = 0;
-    logical_sector_index = 0;
     /* clear out meta track map to its defaults, so that we can simply assign
-       track_indices to the meta track map for 3.5 and 5.25 disks versus
-       adding extra conditionals in the below loop
+       track_indices to the meta track map for 3.5 and 5.25 disks
     */
     memset(disk->nib->meta_track_map, 0xff, sizeof(disk->nib->meta_track_map));
     memset(disk->nib->track_bits_count, 0x00, sizeof(disk->nib->track_bits_count));
     memset(disk->nib->track_byte_count, 0x00, sizeof(disk->nib->track_byte_count));
     memset(disk->nib->track_initialized, 0x00, sizeof(disk->nib->track_initialized));
-    for (qtr_track_index = 0; qtr_track_index < CLEM_DISK_LIMIT_QTR_TRACKS;) {
-        //  isolate into a function for readability
-        unsigned sector_count = clem_max_sectors_per_region[current_region];
-        unsigned track_size;
-        uint8_t *data_in;
-        unsigned sector_index;
-        unsigned in_sector_index;
-        unsigned logical_track_index = qtr_track_index / 2;
-        unsigned side_index = qtr_track_index & 1;
-        unsigned nib_track_index = qtr_track_index / track_increment;
-        unsigned temp, byte_index;
-        struct ClemensNibEncoder nib_encoder;
 
+    for (nib_track_index = 0; nib_track_index < disk->nib->track_count; ++nib_track_index) {
+        unsigned track_size, sector_count;
+        qtr_track_index = nib_track_index * format.track_increment;
+        sector_count = _clem_nib_get_sector_count(
+            disk->nib->disk_type, _clem_nib_get_region(disk->nib->disk_type, qtr_track_index));
         if (disk->nib->disk_type == CLEM_DISK_TYPE_3_5) {
             track_size = CLEM_DISK_35_CALC_BYTES_FROM_SECTORS(sector_count);
         } else {
             track_size = CLEM_DISK_525_BYTES_PER_TRACK;
         }
-
         if (disk->nib->bits_data + track_byte_offset + track_size > disk->nib->bits_data_end) {
             assert(false);
             return false;
         }
+        sector_count_total += sector_count;
 
         disk->nib->track_byte_offset[nib_track_index] = track_byte_offset;
         disk->nib->track_byte_count[nib_track_index] = track_size;
+        disk->nib->track_bits_count[nib_track_index] = track_size * 8;
+        disk->nib->meta_track_map[qtr_track_index] = nib_track_index;
+        if (disk->nib->disk_type == CLEM_DISK_TYPE_5_25) {
+            if (qtr_track_index > 0) {
+                /* track is copied onto the one quarter track before and after
+                   this qtr track */
+                disk->nib->meta_track_map[qtr_track_index - 1] = nib_track_index;
+            }
+            disk->nib->meta_track_map[(qtr_track_index + 1) % CLEM_DISK_LIMIT_QTR_TRACKS] =
+                nib_track_index;
+        }
+        track_byte_offset += track_size;
+    }
+
+    /* every track reads its sectors from the source image */
+    return sector_count_total * format.in_sector_size <= data_in_size;
+}
+
+bool clem_2img_nibblize_track(const struct Clemens2IMGDisk *disk, unsigned nib_track_index) {
+    struct _ClemNibTrackFormat format;
+    struct ClemensNibEncoder nib_encoder;
+    unsigned qtr_track_index, current_region, sector_count;
+    unsigned logical_sector_index = 0;
+    unsigned logical_track_index, side_index;
+    unsigned sector_index, in_sector_index, temp, i;
+    const uint8_t *data_in;
+
+    if (nib_track_index >= disk->nib->track_count)
+        return false;
+    if (!_clem_nib_get_track_format(disk, &format))
+        return false;
+
+    qtr_track_index = nib_track_index * format.track_increment;
+    current_region = _clem_nib_get_region(disk->nib->disk_type, qtr_track_index);
+    sector_count = _clem_nib_get_sector_count(disk->nib->disk_type, current_region);
+    for (i = 0; i < qtr_track_index; i += format.track_increment) {
+        logical_sector_index += _clem_nib_get_sector_count(
+            disk->nib->disk_type, _clem_nib_get_region(disk->nib->disk_type, i));
+    }
+    side_index = qtr_track_index & 1;
+    if (disk->nib->disk_type == CLEM_DISK_TYPE_3_5) {
+        logical_track_index = qtr_track_index / 2;
+    } else {
+        logical_track_index = qtr_track_index / 4; // tracks 0 - 39
+    }
+
+    /* see clem_disk.h for documentation on the 3.5" prodos format */
+    _clem_nib_init_encoder(&nib_encoder,
+                           disk->nib->bits_data + disk->nib->track_byte_offset[nib_track_index],
+                           disk->nib->bits_data + disk->nib->track_byte_offset[nib_track_index] +
+                               disk->nib->track_byte_count[nib_track_index]);
+
+    /* pad */
+    if (disk->nib->disk_type == CLEM_DISK_TYPE_3_5) {
+        _clem_nib_write_one(&nib_encoder, 0xff);
+    }
+
+    _clem_nib_encode_self_sync_ff(&nib_encoder, format.self_sync_gap_1_cnt);
 
-        /* see clem_disk.h for documentation on the 3.5" prodos format */
-        _clem_nib_init_encoder(&nib_encoder, disk->nib->bits_data + track_byte_offset,
-                               disk->nib->bits_data + track_byte_offset + track_size);
+    for (sector_index = 0; sector_index < sector_count; ++sector_index) {
+        in_sector_index = format.to_logical_sector_map[current_region][sector_index];
+        data_in = disk->data + (logical_sector_index + in_sector_index) * format.in_sector_size;
 
-        /* pad */
         if (disk->nib->disk_type == CLEM_DISK_TYPE_3_5) {
             _clem_nib_write_one(&nib_encoder, 0xff);
+        }
+        /* Address */
+        _clem_nib_write_one(&nib_encoder, 0xd5);
+        _clem_nib_write_one(&nib_encoder, 0xaa);
+        _clem_nib_write_one(&nib_encoder, 0x96);
+        if (disk->nib->disk_type == CLEM_DISK_TYPE_3_5) {
+            /* track, sector, side, format (0x22 or 0x24 - assume 0x24?) */
+            /* I THINK 0x22 = 512 byte sectors */
+            /*       - 0x24 is 524 byte sectors to allow for the 12 byte
+                            empty tag
+            */
+            unsigned side_index_35 = (side_index << 5) | (logical_track_index >> 6);
+
+            _clem_nib_encode_one_6_2(&nib_encoder, (uint8_t)(logical_track_index));
+            _clem_nib_encode_one_6_2(&nib_encoder, (uint8_t)(in_sector_index & 0xff));
+            _clem_nib_encode_one_6_2(&nib_encoder, (uint8_t)(side_index_35));
+            _clem_nib_encode_one_6_2(&nib_encoder, 0x24);
+            temp = (logical_track_index ^ in_sector_index ^ side_index_35 ^ 0x24);
+            _clem_nib_encode_one_6_2(&nib_encoder, (uint8_t)(temp));
+            _clem_nib_write_one(&nib_encoder, 0xde);
+            _clem_nib_write_one(&nib_encoder, 0xaa);
+            _clem_nib_write_one(&nib_encoder, 0xff);
         } else {
-            logical_track_index /= 2; // tracks 0 - 39
+            _clem_nib_encode_one_4_4(&nib_encoder, (uint8_t)(disk->dos_volume & 0xff));
+            _clem_nib_encode_one_4_4(&nib_encoder, logical_track_index);
+            _clem_nib_encode_one_4_4(&nib_encoder, sector_index);
+            _clem_nib_encode_one_4_4(
+                &nib_encoder, (uint8_t)(disk->dos_volume ^ logical_track_index ^ sector_index));
+            _clem_nib_write_one(&nib_encoder, 0xde);
+            _clem_nib_write_one(&nib_encoder, 0xaa);
+            _clem_nib_write_one(&nib_encoder, 0xeb);
         }
 
-        _clem_nib_encode_self_sync_ff(&nib_encoder, self_sync_gap_1_cnt);
+        _clem_nib_encode_self_sync_ff(&nib_encoder, format.self_sync_gap_2_cnt);
 
-        for (sector_index = 0; sector_index < sector_count; ++sector_index) {
-            in_sector_index = to_logical_sector_map[current_region][sector_index];
-            data_in = disk->data + (logical_sector_index + in_sector_index) * in_sector_size;
-
-            if (disk->nib->disk_type == CLEM_DISK_TYPE_3_5) {
-                _clem_nib_write_one(&nib_encoder, 0xff);
-            }
-            /* Address */
-            _clem_nib_write_one(&nib_encoder, 0xd5);
+        /* Data */
+        if (disk->nib->disk_type == CLEM_DISK_TYPE_3_5) {
+            _clem_nib_write_one(&nib_encoder, 0xff);
+        }
+        _clem_nib_write_one(&nib_encoder, 0xd5);
+        _clem_nib_write_one(&nib_encoder, 0xaa);
+        _clem_nib_write_one(&nib_encoder, 0xad);
+        if (disk->nib->disk_type == CLEM_DISK_TYPE_3_5) {
+            _clem_nib_encode_one_6_2(&nib_encoder, (uint8_t)in_sector_index);
+            /* TODO: handle cases where input sector data is 524 vs 512 */
+            _clem_nib_encode_data_35(&nib_encoder, data_in, 512);
+            _clem_nib_write_one(&nib_encoder, 0xde);
             _clem_nib_write_one(&nib_encoder, 0xaa);
-            _clem_nib_write_one(&nib_encoder, 0x96);
-            if (disk->nib->disk_type == CLEM_DISK_TYPE_3_5) {
-                /* track, sector, side, format (0x22 or 0x24 - assume 0x24?) */
-                /* I THINK 0x22 = 512 byte sectors */
-                /*       - 0x24 is 524 byte sectors to allow for the 12 byte
-                                empty tag
-                */
-                unsigned side_index_35 = (side_index << 5) | (logical_track_index >> 6);
-
-                _clem_nib_encode_one_6_2(&nib_encoder, (uint8_t)(logical_track_index));
-                _clem_nib_encode_one_6_2(&nib_encoder, (uint8_t)(in_sector_index & 0xff));
-                _clem_nib_encode_one_6_2(&nib_encoder, (uint8_t)(side_index_35));
-                _clem_nib_encode_one_6_2(&nib_encoder, 0x24);
-                temp = (logical_track_index ^ in_sector_index ^ side_index_35 ^ 0x24);
-                _clem_nib_encode_one_6_2(&nib_encoder, (uint8_t)(temp));
-                _clem_nib_write_one(&nib_encoder, 0xde);
-                _clem_nib_write_one(&nib_encoder, 0xaa);
+            if (sector_index < sector_count - 1) {
+                _clem_nib_write_one(&nib_encoder, 0xff);
                 _clem_nib_write_one(&nib_encoder, 0xff);
-            } else {
-                _clem_nib_encode_one_4_4(&nib_encoder, (uint8_t)(disk->dos_volume & 0xff));
-                _clem_nib_encode_one_4_4(&nib_encoder, logical_track_index);
-                _clem_nib_encode_one_4_4(&nib_encoder, sector_index);
-                _clem_nib_encode_one_4_4(
-                    &nib_encoder, (uint8_t)(disk->dos_volume ^ logical_track_index ^ sector_index));
-                _clem_nib_write_one(&nib_encoder, 0xde);
-                _clem_nib_write_one(&nib_encoder, 0xaa);
-                _clem_nib_write_one(&nib_encoder, 0xeb);
-            }
-
-            _clem_nib_encode_self_sync_ff(&nib_encoder, self_sync_gap_2_cnt);
-
-            /* Data */
-            if (disk->nib->disk_type == CLEM_DISK_TYPE_3_5) {
                 _clem_nib_write_one(&nib_encoder, 0xff);
             }
-            _clem_nib_write_one(&nib_encoder, 0xd5);
+        } else {
+            _clem_nib_encode_data_525(&nib_encoder, data_in, 256);
+            _clem_nib_write_one(&nib_encoder, 0xde);
             _clem_nib_write_one(&nib_encoder, 0xaa);
-            _clem_nib_write_one(&nib_encoder, 0xad);
-            if (disk->nib->disk_type == CLEM_DISK_TYPE_3_5) {
-                _clem_nib_encode_one_6_2(&nib_encoder, (uint8_t)in_sector_index);
-                /* TODO: handle cases where input sector data is 524 vs 512 */
-                _clem_nib_encode_data_35(&nib_encoder, data_in, 512);
-                _clem_nib_write_one(&nib_encoder, 0xde);
-                _clem_nib_write_one(&nib_encoder, 0xaa);
-                if (sector_index < sector_count - 1) {
-                    _clem_nib_write_one(&nib_encoder, 0xff);
-                    _clem_nib_write_one(&nib_encoder, 0xff);
-                    _clem_nib_write_one(&nib_encoder, 0xff);
-                }
-            } else {
-                _clem_nib_encode_data_525(&nib_encoder, data_in, 256);
-                _clem_nib_write_one(&nib_encoder, 0xde);
-                _clem_nib_write_one(&nib_encoder, 0xaa);
-                _clem_nib_write_one(&nib_encoder, 0xeb);
-            }
-            if (sector_index + 1 < sector_count) {
-                _clem_nib_encode_self_sync_ff(&nib_encoder, self_sync_gap_3_cnt);
+            _clem_nib_write_one(&nib_encoder, 0xeb);
+        }
+        if (sector_index + 1 < sector_count) {
+            _clem_nib_encode_self_sync_ff(&nib_encoder, format.self_sync_gap_3_cnt);
+        }
+    }
+
+    disk->nib->track_initialized[nib_track_index] = 1;
+    return true;
+}
+
+bool clem_2img_nibblize_data(struct Clemens2IMGDisk *disk) {
+    unsigned nib_track_index;
+
+    if (!clem_2img_nibblize_prepare(disk))
+        return false;
+    for (nib_track_index = 0; nib_track_index < disk->nib->track_count; ++nib_track_index) {
+        if (!clem_2img_nibblize_track(disk, nib_track_index))
+            return false;
+    }
+    return true;
+}
+
+/* The decoder mimics the IWM data latch - zero bits are shifted out until a
+   one bit is found, which becomes the high bit of the next disk byte.  This
+   handles 10-bit self sync bytes without any special casing.  Bits are fetched
+   8 at a time where possible instead of one at a time.
+*/
+static void _clem_nib_init_decoder(struct ClemensNibDecoder *decoder, const uint8_t *begin,
+                                   unsigned bit_count, unsigned bit_limit) {
+    decoder->begin = begin;
+    decoder->bit_index = 0;
+    decoder->bit_index_end = bit_count;
+    decoder->bits_left = bit_limit;
+}
+
+static uint8_t _clem_nib_peek_8(const struct ClemensNibDecoder *decoder) {
+    unsigned bit_index = decoder->bit_index;
+    unsigned shift = bit_index & 7;
+    uint8_t value = 0;
+    unsigned i;
+
+    if (bit_index + 8 <= decoder->bit_index_end) {
+        const uint8_t *cur = decoder->begin + (bit_index >> 3);
+        if (!shift)
+            return cur[0];
+        return (uint8_t)((cur[0] << shift) | (cur[1] >> (8 - shift)));
+    }
+    /* wraps around to the start of the track */
+    for (i = 0; i < 8; ++i) {
+        value <<= 1;
+        value |= (decoder->begin[bit_index >> 3] >> (7 - (bit_index & 7))) & 1;
+        bit_index = (bit_index + 1) % decoder->bit_index_end;
+    }
+    return value;
+}
+
+static void _clem_nib_skip_bits(struct ClemensNibDecoder *decoder, unsigned cnt) {
+    decoder->bit_index = (decoder->bit_index + cnt) % decoder->bit_index_end;
+    decoder->bits_left = decoder->bits_left > cnt ? decoder->bits_left - cnt : 0;
+}
+
+static bool _clem_nib_read_one(struct ClemensNibDecoder *decoder, uint8_t *out) {
+    uint8_t value;
+    unsigned lead;
+
+    while (decoder->bits_left >= 8) {
+        value = _clem_nib_peek_8(decoder);
+        if (!value) {
+            _clem_nib_skip_bits(decoder, 8);
+            continue;
+        }
+        for (lead = 0; !(value & 0x80); ++lead) {
+            value <<= 1;
+        }
+        if (lead) {
+            _clem_nib_skip_bits(decoder, lead);
+            value = _clem_nib_peek_8(decoder);
+        }
+        _clem_nib_skip_bits(decoder, 8);
+        *out = value;
+        return true;
+    }
+    return false;
+}
+
+static bool _clem_nib_decode_one_6_2(struct ClemensNibDecoder *decoder, uint8_t *out) {
+    uint8_t value;
+    if (!_clem_nib_read_one(decoder, &value))
+        return false;
+    *out = gcr_6_2_decode[value & 0x7f];
+    return *out != 0xff;
+}
+
+static bool _clem_nib_decode_one_4_4(struct ClemensNibDecoder *decoder, uint8_t *out) {
+    uint8_t odd, even;
+    if (!_clem_nib_read_one(decoder, &odd) || !_clem_nib_read_one(decoder, &even))
+        return false;
+    *out = ((odd << 1) | 1) & even;
+    return true;
+}
+
+/* scans for a D5 AA xx prologue within 'limit' disk bytes */
+static bool _clem_nib_scan_prologue(struct ClemensNibDecoder *decoder, uint8_t mark,
+                                    unsigned limit) {
+    unsigned state = 0;
+    uint8_t value;
+
+    while (limit-- > 0 && _clem_nib_read_one(decoder, &value)) {
+        if (value == 0xd5) {
+            state = 1;
+        } else if (state == 1 && value == 0xaa) {
+            state = 2;
+        } else if (state == 2 && value == mark) {
+            return true;
+        } else {
+            state = 0;
+        }
+    }
+    return false;
+}
+
+static bool _clem_nib_decode_data_525(struct ClemensNibDecoder *decoder, uint8_t *buf) {
+    /* reverses _clem_nib_encode_data_525 - 86 bytes containing the low 2 bits
+       of each data byte (in reverse order) followed by the upper 6 bits of all
+       256 bytes, each xor'ed with the previous value */
+    uint8_t enc[CLEM_NIB_ENCODE_525_6_2_RIGHT_BUFFER_SIZE + 256];
+    uint8_t chksum = 0;
+    uint8_t value, right;
+    unsigned i;
+
+    for (i = 0; i < sizeof(enc); ++i) {
+        if (!_clem_nib_decode_one_6_2(decoder, &value))
+            return false;
+        chksum ^= value;
+        enc[i] = chksum;
+    }
+    if (!_clem_nib_decode_one_6_2(decoder, &value) || value != chksum)
+        return false;
+
+    for (i = 0; i < 256; ++i) {
+        right = enc[i % CLEM_NIB_ENCODE_525_6_2_RIGHT_BUFFER_SIZE] >>
+                ((i / CLEM_NIB_ENCODE_525_6_2_RIGHT_BUFFER_SIZE) * 2);
+        buf[i] = (uint8_t)(enc[CLEM_NIB_ENCODE_525_6_2_RIGHT_BUFFER_SIZE + i] << 2) |
+                 ((right & 1) << 1) | ((right & 2) >> 1);
+    }
+    return true;
+}
+
+static bool _clem_nib_decode_data_35(struct ClemensNibDecoder *decoder, uint8_t *buf) {
+    /* reverses _clem_nib_encode_data_35 (again, see Ciderpress Nibble35.cpp) */
+    uint8_t scratch0[175], scratch1[175], scratch2[175];
+    uint8_t data[524];
+    unsigned chksum[3];
+    unsigned data_idx, scratch_idx;
+    uint8_t v, lo, hi;
+
+    for (scratch_idx = 0; scratch_idx < 175; ++scratch_idx) {
+        if (!_clem_nib_decode_one_6_2(decoder, &hi))
+            return false;
+        if (!_clem_nib_decode_one_6_2(decoder, &lo))
+            return false;
+        scratch0[scratch_idx] = ((hi << 2) & 0xc0) | lo;
+        if (!_clem_nib_decode_one_6_2(decoder, &lo))
+            return false;
+        scratch1[scratch_idx] = ((hi << 4) & 0xc0) | lo;
+        if (scratch_idx < 174) {
+            if (!_clem_nib_decode_one_6_2(decoder, &lo))
+                return false;
+            scratch2[scratch_idx] = ((hi << 6) & 0xc0) | lo;
+        }
+    }
+
+    chksum[0] = chksum[1] = chksum[2] = 0;
+    data_idx = 0;
+    scratch_idx = 0;
+    while (data_idx < 524) {
+        chksum[0] = (chksum[0] & 0xff) << 1;
+        if (chksum[0] & 0x100) {
+            ++chksum[0];
+        }
+        v = scratch0[scratch_idx] ^ (chksum[0] & 0xff);
+        chksum[2] += v;
+        if (chksum[0] > 0xff) {
+            ++chksum[2];
+            chksum[0] &= 0xff;
+        }
+        data[data_idx++] = v;
+
+        v = scratch1[scratch_idx] ^ (chksum[2] & 0xff);
+        chksum[1] += v;
+        if (chksum[2] > 0xff) {
+            ++chksum[1];
+            chksum[2] &= 0xff;
+        }
+        data[data_idx++] = v;
+
+        if (data_idx < 524) {
+            v = scratch2[scratch_idx] ^ (chksum[1] & 0xff);
+            chksum[0] += v;
+            if (chksum[1] > 0xff) {
+                ++chksum[0];
+                chksum[1] &= 0xff;
             }
+            data[data_idx++] = v;
+            ++scratch_idx;
         }
-        logical_sector_index += sector_count;
+    }
 
-        disk->nib->track_bits_count[nib_track_index] = nib_encoder.bit_index_end;
-        disk->nib->track_initialized[nib_track_index] = 1;
-        if (disk->nib->disk_type == CLEM_DISK_TYPE_3_5) {
-            disk->nib->meta_track_map[qtr_track_index] = nib_track_index;
+    if (!_clem_nib_decode_one_6_2(decoder, &hi))
+        return false;
+    for (data_idx = 3; data_idx > 0; --data_idx) {
+        if (!_clem_nib_decode_one_6_2(decoder, &lo))
+            return false;
+        /* stored in order of chksum 2, 1, 0 */
+        v = ((hi << ((4 - data_idx) * 2)) & 0xc0) | lo;
+        if (v != (chksum[data_idx - 1] & 0xff))
+            return false;
+    }
+
+    /* skip the 12 byte tag header */
+    memcpy(buf, data + 12, 512);
+    return true;
+}
+
+/* Finds and decodes all sectors on a track, writing them to data_out in logical
+   order.  Tracks are scanned for up to two revolutions so that sectors
+   straddling the track's end can be read.
+*/
+static bool _clem_nib_decode_track(const struct ClemensNibbleDisk *nib, unsigned nib_track_index,
+                                   unsigned track_index, unsigned side_index,
+                                   unsigned sector_count, const unsigned *to_logical_sector_map,
+                                   uint8_t *data_out) {
+    struct ClemensNibDecoder decoder;
+    uint32_t sectors_found = 0;
+    uint32_t sectors_mask = (1U << sector_count) - 1;
+    uint8_t field[5];
+    uint8_t sector_data[512];
+    unsigned i, logical_sector;
+    bool is_35 = nib->disk_type == CLEM_DISK_TYPE_3_5;
+
+    if (nib_track_index >= CLEM_DISK_LIMIT_QTR_TRACKS || !nib->track_initialized[nib_track_index])
+        return false;
+    if (nib->track_bits_count[nib_track_index] < 8)
+        return false;
+
+    _clem_nib_init_decoder(&decoder, nib->bits_data + nib->track_byte_offset[nib_track_index],
+                           nib->track_bits_count[nib_track_index],
+                           nib->track_bits_count[nib_track_index] * 2);
+
+    while (sectors_found != sectors_mask) {
+        if (!_clem_nib_scan_prologue(&decoder, 0x96, UINT32_MAX))
+            break;
+        if (is_35) {
+            /* track, sector, side, format, checksum */
+            for (i = 0; i < 5; ++i) {
+                if (!_clem_nib_decode_one_6_2(&decoder, &field[i]))
+                    break;
+            }
+            if (i < 5 || (field[0] ^ field[1] ^ field[2] ^ field[3]) != field[4])
+                continue;
+            if ((field[0] | ((unsigned)(field[2] & 0x1f) << 6)) != track_index ||
+                ((field[2] >> 5) & 1) != side_index)
+                continue;
+            logical_sector = field[1];
         } else {
-            disk->nib->meta_track_map[qtr_track_index] = nib_track_index;
-            if (qtr_track_index > 0) {
-                /* track is copied onto the one quarter track before and after
-                   this qtr track */
-                disk->nib->meta_track_map[qtr_track_index - 1] = nib_track_index;
+            /* volume, track, sector, checksum */
+            for (i = 0; i < 4; ++i) {
+                if (!_clem_nib_decode_one_4_4(&decoder, &field[i]))
+                    break;
             }
-            disk->nib->meta_track_map[(qtr_track_index + 1) % CLEM_DISK_LIMIT_QTR_TRACKS] =
-                nib_track_index;
+            if (i < 4 || (field[0] ^ field[1] ^ field[2]) != field[3])
+                continue;
+            if (field[1] != track_index || field[2] >= sector_count)
+                continue;
+            logical_sector = to_logical_sector_map[field[2]];
+        }
+        if (logical_sector >= sector_count || (sectors_found & (1U << logical_sector)))
+            continue;
+
+        /* the data field follows within the gap 2 self-sync bytes */
+        if (!_clem_nib_scan_prologue(&decoder, 0xad, 64))
+            continue;
+        if (is_35) {
+            if (!_clem_nib_decode_one_6_2(&decoder, &field[0]) || field[0] != logical_sector)
+                continue;
+            if (!_clem_nib_decode_data_35(&decoder, sector_data))
+                continue;
+            memcpy(data_out + logical_sector * 512, sector_data, 512);
+        } else {
+            if (!_clem_nib_decode_data_525(&decoder, sector_data))
+                continue;
+            memcpy(data_out + logical_sector * 256, sector_data, 256);
         }
+        sectors_found |= (1U << logical_sector);
+    }
 
-        if (nib_track_index + 1 >= disk->nib->track_count) {
-            track_increment = CLEM_DISK_LIMIT_QTR_TRACKS - nib_track_index;
+    return sectors_found == sectors_mask;
+}
+
+bool clem_2img_decode_nibblized_data(struct Clemens2IMGDisk *disk) {
+    const unsigned(*to_logical_sector_map)[16] = NULL;
+    unsigned data_out_size = disk->data_end - disk->data;
+    unsigned track_count, track_increment, qtr_track_index;
+    unsigned current_region = 0;
+    unsigned sector_size, sector_count;
+    uint8_t *data_out = disk->data;
+
+    if (!disk->nib || !disk->nib->bits_data)
+        return false;
+
+    switch (disk->nib->disk_type) {
+    case CLEM_DISK_TYPE_3_5:
+        if (disk->format != CLEM_2IMG_FORMAT_PRODOS)
+            return false;
+        if (data_out_size != (disk->nib->is_double_sided ? 1600 : 800) * 512)
+            return false;
+        to_logical_sector_map = prodos_to_logical_sector_map_35;
+        track_count = disk->nib->is_double_sided ? 160 : 80;
+        track_increment = disk->nib->is_double_sided ? 1 : 2;
+        sector_size = 512;
+        break;
+    case CLEM_DISK_TYPE_5_25:
+        if (disk->format == CLEM_2IMG_FORMAT_PRODOS) {
+            to_logical_sector_map = prodos_to_logical_sector_map_525;
+        } else if (disk->format == CLEM_2IMG_FORMAT_DOS) {
+            to_logical_sector_map = dos_to_logical_sector_map_525;
+        } else {
+            return false;
         }
+        if (data_out_size != 35 * CLEM_DISK_525_NUM_SECTORS_PER_TRACK * 256)
+            return false;
+        track_count = 35;
+        track_increment = 4;
+        sector_size = 256;
+        break;
+    default:
+        return false;
+    }
 
-        qtr_track_index += track_increment;
-        if (qtr_track_index >= clem_track_start_per_region[current_region + 1]) {
-            ++current_region;
+    /* same traversal as clem_2img_nibblize_data - the 3.5" track index counts
+       sides (track 0 side 0, track 0 side 1, ...) for double sided disks */
+    for (qtr_track_index = 0; qtr_track_index < track_count * track_increment;
+         qtr_track_index += track_increment) {
+        unsigned track_index, side_index;
+        if (disk->nib->disk_type == CLEM_DISK_TYPE_3_5) {
+            while (qtr_track_index >= g_clem_track_start_per_region_35[current_region + 1]) {
+                ++current_region;
+            }
+            sector_count = g_clem_max_sectors_per_region_35[current_region];
+            track_index = qtr_track_index / 2;
+            side_index = qtr_track_index & 1;
+        } else {
+            sector_count = CLEM_DISK_525_NUM_SECTORS_PER_TRACK;
+            track_index = qtr_track_index / 4;
+            side_index = 0;
         }
-        track_byte_offset += track_size;
+        if (!_clem_nib_decode_track(disk->nib, disk->nib->meta_track_map[qtr_track_index],
+                                    track_index, side_index, sector_count,
+                                    to_logical_sector_map[current_region], data_out)) {
+            return false;
+        }
+        data_out += sector_count * sector_size;
     }
 
-    return true;
+    return data_out == disk->data_end;
 }
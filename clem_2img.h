@@ -66,6 +66,13 @@ struct ClemensNibEncoder {
     unsigned bit_index_end;
 };
 
+struct ClemensNibDecoder {
+    const uint8_t *begin;
+    unsigned bit_index;
+    unsigned bit_index_end; /**< Track length in bits */
+    unsigned bits_left;     /**< Bits remaining before the scan gives up */
+};
+
 /**
  * @brief Obtains information from a 2IMG disk image used for processing
  *
@@ -126,6 +133,51 @@ bool clem_2img_build_image(struct Clemens2IMGDisk *disk, uint8_t *image, uint8_t
  */
 bool clem_2img_nibblize_data(struct Clemens2IMGDisk *disk);
 
+/**
+ * @brief Lays out the nibbilized tracks without encoding them.
+ *
+ * This is the first half of clem_2img_nibblize_data.  On success, every
+ * track's location in the bits buffer and the disk metadata are assigned.
+ * Tracks are then encoded with clem_2img_nibblize_track.
+ *
+ * @param disk A parsed disk image with an attached ClemensNibbleDisk buffer
+ * @return true
+ * @return false See clem_2img_nibblize_data
+ */
+bool clem_2img_nibblize_prepare(struct Clemens2IMGDisk *disk);
+
+/**
+ * @brief Encodes a single track after clem_2img_nibblize_prepare.
+ *
+ * Each track writes only to its own region of the bits buffer and its own
+ * track metadata entries, so different tracks may be encoded concurrently.
+ *
+ * @param disk A disk prepared by clem_2img_nibblize_prepare
+ * @param nib_track_index Index into the nibble disk's track list (less than
+ *      track_count)
+ * @return true
+ * @return false
+ */
+bool clem_2img_nibblize_track(const struct Clemens2IMGDisk *disk, unsigned nib_track_index);
+
+/**
+ * @brief Reverses the nibbilization pass, rebuilding sector data from tracks.
+ *
+ * The disk's data buffer receives the sectors in the order specified by the
+ * disk format (DOS or ProDOS), and can be obtained from clem_2img_generate_header
+ * on a buffer of the correct size (140K for 5.25" disks, 400K/800K for 3.5"
+ * disks.)  The attached ClemensNibbleDisk supplies the track bitstreams, which
+ * may come from either a WOZ image or clem_2img_nibblize_data.
+ *
+ * Only standard 16 sector 5.25" and ProDOS 3.5" layouts are supported.
+ *
+ * @param disk A disk with an output data buffer and an attached ClemensNibbleDisk
+ * @return true
+ * @return false A sector could not be found or failed its checksum, or the
+ *      output buffer does not match the disk's size
+ */
+bool clem_2img_decode_nibblized_data(struct Clemens2IMGDisk *disk);
+
 #ifdef __cplusplus
 }
 #endif
@@ -137,7 +137,9 @@ void clem_adb_reset(struct ClemensDeviceADB *adb) {
     adb->mode_flags = CLEM_ADB_MODE_AUTOPOLL_KEYB | CLEM_ADB_MODE_AUTOPOLL_MOUSE;
     adb->keyb.reset_key = false;
     adb->keyb.size = 0;
+    adb->keyb.text_head = adb->keyb.text_tail;
     adb->mouse.size = 0;
+    adb->mouse.dx = adb->mouse.dy = 0;
     adb->gameport.ann_mask = 0;
     adb->gameport.btn_mask[0] = adb->gameport.btn_mask[1] = 0;
     adb->irq_dispatch = 0;
@@ -1294,6 +1296,21 @@ static inline void _clem_adb_glu_queue_key(struct ClemensDeviceADB *adb, uint8_t
     adb->keyb.keys[adb->keyb.size++] = key;
 }
 
+static void _clem_adb_glu_type_text(struct ClemensDeviceADB *adb) {
+    /* typed text is latched only once the guest has taken the last character
+       and keys from the keyboard itself have been handled */
+    uint8_t ascii;
+    if (!(adb->mode_flags & CLEM_ADB_MODE_AUTOPOLL_KEYB))
+        return;
+    if ((adb->io_key_last_ascii & 0x80) || adb->keyb.size > 0)
+        return;
+    if (adb->keyb.text_head == adb->keyb.text_tail)
+        return;
+    ascii = adb->keyb.text[adb->keyb.text_head++ & (CLEM_ADB_TEXT_QUEUE_SIZE - 1)];
+    adb->io_key_last_ascii = 0x80 | (ascii & 0x7f);
+    adb->cmd_status |= CLEM_ADB_C027_KEY_FULL;
+}
+
 static uint8_t _clem_adb_glu_unqueue_key(struct ClemensDeviceADB *adb) {
     uint8_t i;
     uint8_t key;
@@ -1512,6 +1529,43 @@ static void _clem_adb_glu_queue_mouse(struct ClemensDeviceADB *adb, int16_t dx,
     adb->mouse.pos[adb->mouse.size++] = mouse;
 }
 
+static int _clem_adb_glu_take_mouse_delta(int *accum) {
+    /* removes what fits into a single report from the accumulated motion */
+    int delta = *accum;
+    if (delta < -63) {
+        delta = -63;
+    } else if (delta > 63) {
+        delta = 63;
+    }
+    *accum -= delta;
+    return delta;
+}
+
+static void _clem_adb_glu_queue_mouse_motion(struct ClemensDeviceADB *adb) {
+    /* queue accumulated motion ahead of a button change so that the button
+       is reported where it happened */
+    while ((adb->mouse.dx || adb->mouse.dy) && adb->mouse.size < CLEM_ADB_KEYB_BUFFER_LIMIT) {
+        int16_t dx = (int16_t)_clem_adb_glu_take_mouse_delta(&adb->mouse.dx);
+        int16_t dy = (int16_t)_clem_adb_glu_take_mouse_delta(&adb->mouse.dy);
+        _clem_adb_glu_queue_mouse(adb, dx, dy);
+    }
+}
+
+static void _clem_adb_glu_add_mouse_motion(struct ClemensDeviceADB *adb, int dx, int dy) {
+    adb->mouse.dx += dx;
+    if (adb->mouse.dx < -CLEM_ADB_MOUSE_DELTA_LIMIT) {
+        adb->mouse.dx = -CLEM_ADB_MOUSE_DELTA_LIMIT;
+    } else if (adb->mouse.dx > CLEM_ADB_MOUSE_DELTA_LIMIT) {
+        adb->mouse.dx = CLEM_ADB_MOUSE_DELTA_LIMIT;
+    }
+    adb->mouse.dy += dy;
+    if (adb->mouse.dy < -CLEM_ADB_MOUSE_DELTA_LIMIT) {
+        adb->mouse.dy = -CLEM_ADB_MOUSE_DELTA_LIMIT;
+    } else if (adb->mouse.dy > CLEM_ADB_MOUSE_DELTA_LIMIT) {
+        adb->mouse.dy = CLEM_ADB_MOUSE_DELTA_LIMIT;
+    }
+}
+
 static unsigned _clem_adb_glu_unqueue_mouse(struct ClemensDeviceADB *adb) {
     unsigned i;
     unsigned mouse;
@@ -1527,24 +1581,23 @@ static unsigned _clem_adb_glu_unqueue_mouse(struct ClemensDeviceADB *adb) {
 }
 
 static void _clem_adb_glu_mouse_talk(struct ClemensDeviceADB *adb) {
-    //  populate our mouse data register - this will pull all events from the
-    //  queue, compressing multiple events over the frame into a single event
-    //  to be saved onto the data register.
+    //  populate our mouse data register - queued button changes are reported
+    //  first, otherwise the motion accumulated since the last report.
     //  if mouse interrupts are enabled *and* a valid mouse event is avaiable,
     //  then issue the IRQ (CLEM_IRQ_ADB_MOUSE_EVT)
     uint16_t mouse_reg;
 
-    //  this approach will result in lost events if they are not consumed
-    //  fase enough.  reevaluate
-    if (adb->mouse.size <= 0) {
-        _clem_adb_glu_queue_mouse(adb, 0, 0);
-    }
-    mouse_reg = _clem_adb_glu_unqueue_mouse(adb);
     //  do not populate the data register until our client has had some time
-    //  to read in the X,Y.
+    //  to read in the X,Y.  motion keeps accumulating until then.
     if (adb->cmd_status & CLEM_ADB_C027_MOUSE_FULL)
         return;
 
+    if (adb->mouse.size <= 0) {
+        int16_t dx = (int16_t)_clem_adb_glu_take_mouse_delta(&adb->mouse.dx);
+        int16_t dy = (int16_t)_clem_adb_glu_take_mouse_delta(&adb->mouse.dy);
+        _clem_adb_glu_queue_mouse(adb, dx, dy);
+    }
+    mouse_reg = _clem_adb_glu_unqueue_mouse(adb);
     adb->mouse_reg[0] = mouse_reg;
 
     adb->cmd_status |= CLEM_ADB_C027_MOUSE_FULL;
@@ -1969,15 +2022,17 @@ void clem_adb_device_input(struct ClemensDeviceADB *adb, const struct ClemensInp
         }
         break;
     case kClemensInputType_MouseButtonDown:
+        _clem_adb_glu_queue_mouse_motion(adb);
         adb->mouse.btn_down = true;
         _clem_adb_glu_queue_mouse(adb, 0, 0);
         break;
     case kClemensInputType_MouseButtonUp:
+        _clem_adb_glu_queue_mouse_motion(adb);
         adb->mouse.btn_down = false;
         _clem_adb_glu_queue_mouse(adb, 0, 0);
         break;
     case kClemensInputType_MouseMove:
-        _clem_adb_glu_queue_mouse(adb, input->value_a, input->value_b);
+        _clem_adb_glu_add_mouse_motion(adb, input->value_a, input->value_b);
         break;
     case kClemensInputType_Paddle:
         _clem_adb_gameport_paddle(
@@ -1996,6 +2051,22 @@ void clem_adb_device_input(struct ClemensDeviceADB *adb, const struct ClemensInp
     }
 }
 
+unsigned clem_adb_device_text(struct ClemensDeviceADB *adb, const uint8_t *text, unsigned count) {
+    uint32_t queued = adb->keyb.text_tail - adb->keyb.text_head;
+    unsigned available = CLEM_ADB_TEXT_QUEUE_SIZE - queued;
+    unsigned i;
+    if (count > available)
+        count = available;
+    for (i = 0; i < count; ++i) {
+        adb->keyb.text[adb->keyb.text_tail++ & (CLEM_ADB_TEXT_QUEUE_SIZE - 1)] = text[i];
+    }
+    return count;
+}
+
+void clem_adb_device_text_clear(struct ClemensDeviceADB *adb) {
+    adb->keyb.text_head = adb->keyb.text_tail;
+}
+
 void clem_adb_device_key_toggle(struct ClemensDeviceADB *adb, unsigned enabled) {
     if (enabled & CLEM_ADB_KEYB_TOGGLE_CAPS_LOCK) {
         adb->keyb_reg[2] |= CLEM_ADB_GLU_REG2_KEY_CAPS_TOGGLE;
@@ -2269,6 +2340,8 @@ uint8_t clem_adb_read_mega2_switch(struct ClemensDeviceADB *adb, uint8_t ioreg,
     switch (ioreg) {
     case CLEM_MMIO_REG_KEYB_READ:
         if (!is_noop) {
+            /* a guest polling an empty latch takes the next typed character */
+            _clem_adb_glu_type_text(adb);
             adb->cmd_status &= ~CLEM_ADB_C027_KEY_FULL;
             // CLEM_LOG("c0%02x: %02X", ioreg, adb->io_key_last_ascii);
         }
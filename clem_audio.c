@@ -423,6 +423,13 @@ void clem_sound_consume_frames(struct ClemensDeviceAudio *glu,
   if (consumed > glu->mix_frame_index) {
     consumed = glu->mix_frame_index;
   }
+  if (glu->capture && consumed > 0) {
+    /* consumed frames include anything the host mixed in (i.e. cards) */
+    glu->capture->callback(glu->capture->user_ptr, glu->mix_buffer.data,
+                           consumed, glu->mix_buffer.stride,
+                           glu->mix_buffer.frames_per_second);
+    glu->capture->frame_total += consumed;
+  }
   if (consumed < glu->mix_frame_index) {
     memcpy(glu->mix_buffer.data,
            glu->mix_buffer.data + consumed * glu->mix_buffer.stride,
@@ -16,11 +16,142 @@ static char s_log_buffer[CLEM_DEBUG_LOG_BUFFER_SIZE];
 //        instance will take some work due to how the logger works.
 void clem_debug_context(ClemensMachine *context) { s_clem_machine = context; }
 
+/* Describes the printf conversion starting at fmt (just past the '%') and
+   returns the character following it.  The argument type is one of
+   'i' (signed), 'u' (unsigned), 'f' (double), 's' (string), 'p' (pointer) or
+   '%' for a literal percent sign.  size is the argument size for integers.
+   star_count is the number of '*' widths and precisions, each taking an int
+   argument ahead of the converted one.
+*/
+static const char *_clem_debug_parse_conversion(const char *fmt, char *type, unsigned *size,
+                                                unsigned *star_count) {
+    *size = sizeof(int);
+    *star_count = 0;
+    while (*fmt && strchr("-+ #0123456789.*", *fmt)) {
+        if (*fmt == '*')
+            ++*star_count;
+        ++fmt;
+    }
+    while (*fmt && strchr("hlzjt", *fmt)) {
+        if (*fmt == 'l') {
+            *size = *size == sizeof(long) && fmt[-1] == 'l' ? sizeof(int64_t) : sizeof(long);
+        } else if (*fmt != 'h') {
+            *size = sizeof(int64_t);
+        }
+        ++fmt;
+    }
+    switch (*fmt) {
+    case 'd':
+    case 'i':
+    case 'c':
+        *type = 'i';
+        break;
+    case 'f':
+    case 'F':
+    case 'e':
+    case 'E':
+    case 'g':
+    case 'G':
+        *type = 'f';
+        break;
+    case 's':
+        *type = 's';
+        break;
+    case 'p':
+        *type = 'p';
+        break;
+    case '%':
+        *type = '%';
+        break;
+    case '\0':
+        *type = '\0';
+        return fmt;
+    default:
+        *type = 'u';
+        break;
+    }
+    return fmt + 1;
+}
+
+static void _clem_debug_log_record(struct ClemensLogRing *ring, int log_level, const char *fmt,
+                                   va_list arg_list) {
+    /*  arguments are stored by type without formatting - the consumer formats
+        the record with clem_debug_format_record()
+    */
+    struct ClemensLogRecord *record;
+    unsigned text_used = 0;
+    unsigned size, star_count;
+    char type;
+
+    if (ring->head - ring->tail >= ring->record_limit) {
+        ++ring->dropped;
+        return;
+    }
+    record = &ring->records[ring->head & (ring->record_limit - 1)];
+    record->clocks = s_clem_machine->tspec.clocks_spent;
+    record->fmt = fmt;
+    record->level = (uint8_t)log_level;
+    record->arg_count = 0;
+    while (*fmt && record->arg_count < CLEM_DEBUG_LOG_ARG_LIMIT) {
+        if (*fmt++ != '%')
+            continue;
+        fmt = _clem_debug_parse_conversion(fmt, &type, &size, &star_count);
+        if (type != '%' && type != '\0' &&
+            record->arg_count + star_count >= CLEM_DEBUG_LOG_ARG_LIMIT)
+            break;
+        while (star_count-- > 0) {
+            record->args[record->arg_count++].i = va_arg(arg_list, int);
+        }
+        switch (type) {
+        case 'i':
+            record->args[record->arg_count++].i =
+                size == sizeof(int) ? va_arg(arg_list, int) : va_arg(arg_list, int64_t);
+            break;
+        case 'u':
+            record->args[record->arg_count++].u =
+                size == sizeof(int) ? va_arg(arg_list, unsigned) : va_arg(arg_list, uint64_t);
+            break;
+        case 'f':
+            record->args[record->arg_count++].f = va_arg(arg_list, double);
+            break;
+        case 'p':
+            record->args[record->arg_count++].p = va_arg(arg_list, const void *);
+            break;
+        case 's': {
+            /* strings may not outlive the call, so copy them (truncated) */
+            const char *str = va_arg(arg_list, const char *);
+            unsigned len = str ? (unsigned)strlen(str) : 0;
+            if (text_used + len >= CLEM_DEBUG_LOG_TEXT_LIMIT) {
+                len = CLEM_DEBUG_LOG_TEXT_LIMIT - 1 - text_used;
+            }
+            memcpy(record->text + text_used, str, len);
+            record->text[text_used + len] = '\0';
+            record->args[record->arg_count++].u = text_used;
+            text_used += len + 1;
+            if (text_used > CLEM_DEBUG_LOG_TEXT_LIMIT - 1) {
+                text_used = CLEM_DEBUG_LOG_TEXT_LIMIT - 1;
+            }
+        } break;
+        default:
+            break;
+        }
+    }
+    ++ring->head;
+}
+
 void clem_debug_log(int log_level, const char *fmt, ...) {
     char *buffer;
     va_list arg_list;
     if (!s_clem_machine)
         return;
+    if (s_clem_machine->log_ring) {
+        if (log_level < s_clem_machine->log_ring->min_level)
+            return;
+        va_start(arg_list, fmt);
+        _clem_debug_log_record(s_clem_machine->log_ring, log_level, fmt, arg_list);
+        va_end(arg_list);
+        return;
+    }
     buffer = s_log_buffer;
     va_start(arg_list, fmt);
     vsnprintf(buffer, CLEM_DEBUG_LOG_BUFFER_SIZE, fmt, arg_list);
@@ -28,6 +159,87 @@ void clem_debug_log(int log_level, const char *fmt, ...) {
     s_clem_machine->logger_fn(log_level, s_clem_machine, buffer);
 }
 
+unsigned clem_debug_format_record(const struct ClemensLogRecord *record, char *out,
+                                  unsigned out_size) {
+    const char *fmt = record->fmt;
+    unsigned out_len = 0;
+    unsigned arg_idx = 0;
+    unsigned size, star_count, spec_len;
+    char spec[32];
+    char type;
+    int amt;
+
+    if (!out_size)
+        return 0;
+    out[0] = '\0';
+    if (!fmt) {
+        return (unsigned)snprintf(out, out_size, "%s", record->text);
+    }
+    while (*fmt && out_len + 1 < out_size) {
+        const char *spec_start = fmt;
+        if (*fmt != '%') {
+            out[out_len++] = *fmt++;
+            continue;
+        }
+        fmt = _clem_debug_parse_conversion(fmt + 1, &type, &size, &star_count);
+        if (type == '%') {
+            out[out_len++] = '%';
+            continue;
+        }
+        if (type == '\0' || arg_idx + star_count >= record->arg_count)
+            break;
+        /* '*' widths and precisions are replaced by their recorded values */
+        spec_len = 0;
+        for (; spec_start < fmt && spec_len + 12 < sizeof(spec); ++spec_start) {
+            if (*spec_start == '*') {
+                spec_len += (unsigned)snprintf(spec + spec_len, sizeof(spec) - spec_len, "%d",
+                                               (int)record->args[arg_idx++].i);
+            } else {
+                spec[spec_len++] = *spec_start;
+            }
+        }
+        if (spec_start < fmt)
+            break;
+        spec[spec_len] = '\0';
+        switch (type) {
+        case 'i':
+            amt = size == sizeof(int) ? snprintf(out + out_len, out_size - out_len, spec,
+                                                 (int)record->args[arg_idx].i)
+                                      : snprintf(out + out_len, out_size - out_len, spec,
+                                                 record->args[arg_idx].i);
+            break;
+        case 'u':
+            amt = size == sizeof(int) ? snprintf(out + out_len, out_size - out_len, spec,
+                                                 (unsigned)record->args[arg_idx].u)
+                                      : snprintf(out + out_len, out_size - out_len, spec,
+                                                 record->args[arg_idx].u);
+            break;
+        case 'f':
+            amt = snprintf(out + out_len, out_size - out_len, spec, record->args[arg_idx].f);
+            break;
+        case 'p':
+            amt = snprintf(out + out_len, out_size - out_len, spec, record->args[arg_idx].p);
+            break;
+        case 's':
+            amt = snprintf(out + out_len, out_size - out_len, spec,
+                           record->text + record->args[arg_idx].u);
+            break;
+        default:
+            amt = 0;
+            break;
+        }
+        ++arg_idx;
+        if (amt < 0)
+            break;
+        out_len += (unsigned)amt;
+        if (out_len >= out_size) {
+            out_len = out_size - 1;
+        }
+    }
+    out[out_len] = '\0';
+    return out_len;
+}
+
 char *clem_debug_acquire_trace(unsigned amt) {
     char *next;
     unsigned next_debug_cnt = s_clem_debug_cnt + amt;
@@ -36,6 +36,7 @@ extern "C" {
 
 typedef struct ClemensMachine ClemensMachine;
 struct ClemensDeviceDebugger;
+struct ClemensLogRecord;
 
 void clem_debug_reset(struct ClemensDeviceDebugger *dbg);
 void clem_debug_break(struct ClemensDeviceDebugger *dbg, unsigned debug_reason, unsigned param0,
@@ -44,6 +45,8 @@ void clem_debug_break(struct ClemensDeviceDebugger *dbg, unsigned debug_reason,
 void clem_debug_context(ClemensMachine *context);
 
 void clem_debug_log(int log_level, const char *fmt, ...);
+unsigned clem_debug_format_record(const struct ClemensLogRecord *record, char *out,
+                                  unsigned out_size);
 
 char *clem_debug_acquire_trace(unsigned amt);
 void clem_debug_trace_flush();
@@ -22,6 +22,7 @@
 #define CLEM_IIGS_EXPANSION_ROM_SIZE      2048
 #define CLEM_IIGS_FPI_MAIN_RAM_BANK_LIMIT 64
 #define CLEM_IIGS_EMPTY_RAM_BANK          0x81
+#define CLEM_IIGS_PAGE_COUNT              (256 * 256)
 
 /** Vector addresses */
 #define CLEM_6502_COP_VECTOR_LO_ADDR    (0xFFF4U)
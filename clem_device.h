@@ -26,15 +26,25 @@ void clem_rtc_command(struct ClemensDeviceRTC *rtc, clem_clocks_time_t ts, unsig
  */
 void clem_timer_reset(struct ClemensDeviceTimer *timer);
 
+/**
+ * @brief Schedules the 1 sec and 0.266667 sec interrupts from a 60 Hz tick
+ *
+ * @param timer
+ * @param mega2_cycles The tick the timer periods start from
+ */
+void clem_timer_start(struct ClemensDeviceTimer *timer, uint64_t mega2_cycles);
+
 /**
  * @brief Issues interrupts for the 1 sec and 0.266667 timer
  *
+ * Called on every 60 Hz tick.  Interrupts are raised on the first tick at or
+ * past their period, which is precomputed so that ticks in between cost a
+ * compare per timer.
+ *
  * @param timer
- * @param delta_us Microsecond increment since last sync
- * @param irq_line
- * @return uint32_t modified irq_line
+ * @param mega2_cycles The mega2 cycle of this 60 Hz tick
  */
-void clem_timer_sync(struct ClemensDeviceTimer *timer, uint32_t delta_us);
+void clem_timer_sync(struct ClemensDeviceTimer *timer, uint64_t mega2_cycles);
 
 /**
  * @brief Resets the ADB state
@@ -62,6 +72,26 @@ void clem_adb_device_input(struct ClemensDeviceADB *adb, const struct ClemensInp
  */
 void clem_adb_device_key_toggle(struct ClemensDeviceADB *adb, unsigned enabled);
 
+/**
+ * @brief Queues ASCII to be typed into the keyboard latch
+ *
+ * A character is latched each time the guest polls $C000 after clearing the
+ * strobe, so text arrives as fast as the guest reads it.
+ *
+ * @param adb
+ * @param text
+ * @param count
+ * @return unsigned The number of characters accepted
+ */
+unsigned clem_adb_device_text(struct ClemensDeviceADB *adb, const uint8_t *text, unsigned count);
+
+/**
+ * @brief Discards text not yet typed
+ *
+ * @param adb
+ */
+void clem_adb_device_text_clear(struct ClemensDeviceADB *adb);
+
 /**
  * @brief
  *
@@ -279,14 +309,29 @@ bool clem_smartport_bus(struct ClemensSmartPortUnit *unit, unsigned unit_count,
                         unsigned *out_phase, unsigned delta_ns);
 
 /**
- * @brief
+ * @brief Whether the unit is handling a command addressed to it
+ *
+ * Every resident on an enabled bus sees each packet, so this (rather than the
+ * bus being enabled) tells which unit is busy.
+ *
+ * @param unit
+ * @return true from the end of a command packet for this unit until its
+ *         response has been read
+ */
+bool clem_smartport_unit_is_active(const struct ClemensSmartPortUnit *unit);
+
+/**
+ * @brief Hardware reset of both channels.  Host queued bytes are kept.
  *
  * @param scc
+ * @param mega2_clocks_step Clocks per mega2 cycle, used to time characters
  */
-void clem_scc_reset(struct ClemensDeviceSCC *scc);
+void clem_scc_reset(struct ClemensDeviceSCC *scc, clem_clocks_duration_t mega2_clocks_step);
 
 /**
- * @brief
+ * @brief Completes transmitted and received characters that are due.
+ *
+ * Returns immediately if nothing is due before ts_next_event.
  *
  * @param scc
  * @param clock
@@ -312,6 +357,40 @@ void clem_scc_write_switch(struct ClemensDeviceSCC *scc, uint8_t ioreg, uint8_t
  */
 uint8_t clem_scc_read_switch(struct ClemensDeviceSCC *scc, uint8_t ioreg, uint8_t flags);
 
+/**
+ * @brief Removes bytes transmitted by the guest on a channel
+ *
+ * @param scc
+ * @param ch_index See CLEM_SCC_CHANNEL_xxx
+ * @param data
+ * @param limit
+ * @return unsigned The number of bytes copied into data
+ */
+unsigned clem_scc_host_drain(struct ClemensDeviceSCC *scc, unsigned ch_index, uint8_t *data,
+                             unsigned limit);
+
+/**
+ * @brief Queues bytes to be received by the guest on a channel
+ *
+ * @param scc
+ * @param ch_index See CLEM_SCC_CHANNEL_xxx
+ * @param data
+ * @param count
+ * @return unsigned The number of bytes queued, which is less than count if
+ *  the queue is full
+ */
+unsigned clem_scc_host_feed(struct ClemensDeviceSCC *scc, unsigned ch_index, const uint8_t *data,
+                            unsigned count);
+
+/**
+ * @brief Sets the DCD and CTS inputs for a channel
+ *
+ * @param scc
+ * @param ch_index See CLEM_SCC_CHANNEL_xxx
+ * @param connected
+ */
+void clem_scc_host_connect(struct ClemensDeviceSCC *scc, unsigned ch_index, bool connected);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,174 @@
+#include "clem_2img.h"
+#include "clem_woz.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*  Exports a WOZ disk image to a sector image (PO, DO/DSK or 2MG)
+
+    Usage: clemens_disk_export <input.woz> <output.(po|do|dsk|2mg)>
+
+    The output format is chosen from the output file's extension.  DO and DSK
+    images use DOS 3.3 sector order and are only valid for 5.25" disks.
+*/
+
+static uint8_t *read_file(const char *pathname, size_t *size) {
+    uint8_t *data;
+    long file_size;
+    FILE *fp = fopen(pathname, "rb");
+    if (!fp)
+        return NULL;
+    fseek(fp, 0, SEEK_END);
+    file_size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    data = (uint8_t *)malloc(file_size > 0 ? file_size : 1);
+    if (fread(data, 1, file_size, fp) != (size_t)file_size) {
+        free(data);
+        data = NULL;
+    }
+    fclose(fp);
+    *size = (size_t)file_size;
+    return data;
+}
+
+static bool parse_woz(struct ClemensWOZDisk *woz, const uint8_t *image, size_t image_size) {
+    struct ClemensWOZChunkHeader header;
+    const uint8_t *cur = clem_woz_check_header(image, image_size);
+    if (!cur)
+        return false;
+    while ((cur = clem_woz_parse_chunk_header(&header, cur, image + image_size - cur)) != NULL) {
+        switch (header.type) {
+        case CLEM_WOZ_CHUNK_INFO:
+            cur = clem_woz_parse_info_chunk(woz, &header, cur, header.data_size);
+            break;
+        case CLEM_WOZ_CHUNK_TMAP:
+            cur = clem_woz_parse_tmap_chunk(woz, &header, cur, header.data_size);
+            break;
+        case CLEM_WOZ_CHUNK_TRKS:
+            cur = clem_woz_parse_trks_chunk(woz, &header, cur, header.data_size);
+            break;
+        case CLEM_WOZ_CHUNK_META:
+            cur = clem_woz_parse_meta_chunk(woz, &header, cur, header.data_size);
+            break;
+        default:
+            cur += header.data_size;
+            break;
+        }
+        if (!cur)
+            return false;
+    }
+    return true;
+}
+
+static const char *file_extension(const char *pathname) {
+    const char *ext = strrchr(pathname, '.');
+    return ext ? ext + 1 : "";
+}
+
+static bool extension_is(const char *ext, const char *match) {
+    while (*ext && *match) {
+        char ch = *ext++;
+        if (ch >= 'A' && ch <= 'Z')
+            ch += 'a' - 'A';
+        if (ch != *match++)
+            return false;
+    }
+    return *ext == *match;
+}
+
+int main(int argc, char *argv[]) {
+    struct ClemensNibbleDisk nib;
+    struct ClemensWOZDisk woz;
+    struct Clemens2IMGDisk disk;
+    uint8_t *woz_image, *out_image;
+    size_t woz_image_size, sector_data_size, out_image_size;
+    const char *ext;
+    uint32_t format;
+    bool is_2mg;
+    clock_t t0, t1;
+    FILE *fp;
+
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s <input.woz> <output.(po|do|dsk|2mg)>\n", argv[0]);
+        return 1;
+    }
+    ext = file_extension(argv[2]);
+    is_2mg = extension_is(ext, "2mg");
+    if (is_2mg || extension_is(ext, "po")) {
+        format = CLEM_2IMG_FORMAT_PRODOS;
+    } else if (extension_is(ext, "do") || extension_is(ext, "dsk")) {
+        format = CLEM_2IMG_FORMAT_DOS;
+    } else {
+        fprintf(stderr, "unsupported output format '%s'\n", ext);
+        return 1;
+    }
+
+    woz_image = read_file(argv[1], &woz_image_size);
+    if (!woz_image) {
+        fprintf(stderr, "unable to read '%s'\n", argv[1]);
+        return 1;
+    }
+    memset(&nib, 0, sizeof(nib));
+    memset(&woz, 0, sizeof(woz));
+    nib.bits_data = (uint8_t *)malloc(CLEM_DISK_35_MAX_DATA_SIZE);
+    nib.bits_data_end = nib.bits_data + CLEM_DISK_35_MAX_DATA_SIZE;
+    woz.nib = &nib;
+    if (!parse_woz(&woz, woz_image, woz_image_size)) {
+        fprintf(stderr, "'%s' is not a valid WOZ image\n", argv[1]);
+        return 1;
+    }
+
+    if (nib.disk_type == CLEM_DISK_TYPE_3_5) {
+        sector_data_size = (nib.is_double_sided ? 1600 : 800) * 512;
+    } else {
+        sector_data_size = 280 * 512;
+    }
+    //  the 2MG header precedes the sector data so that the image can be built
+    //  in place
+    out_image_size = sector_data_size + CLEM_2IMG_HEADER_BYTE_SIZE;
+    out_image = (uint8_t *)malloc(out_image_size);
+    memset(&disk, 0, sizeof(disk));
+    if (!clem_2img_generate_header(&disk, format, out_image, out_image + out_image_size,
+                                   CLEM_2IMG_HEADER_BYTE_SIZE)) {
+        fprintf(stderr, "unable to create the output image\n");
+        return 1;
+    }
+    disk.nib = &nib;
+    disk.is_write_protected = woz.flags & CLEM_WOZ_IMAGE_WRITE_PROTECT;
+
+    t0 = clock();
+    if (!clem_2img_decode_nibblized_data(&disk)) {
+        fprintf(stderr, "unable to decode all sectors from '%s'\n", argv[1]);
+        return 1;
+    }
+    t1 = clock();
+
+    if (is_2mg) {
+        if (!clem_2img_build_image(&disk, out_image, out_image + out_image_size)) {
+            fprintf(stderr, "unable to build the 2MG image\n");
+            return 1;
+        }
+    }
+
+    fp = fopen(argv[2], "wb");
+    if (!fp) {
+        fprintf(stderr, "unable to write '%s'\n", argv[2]);
+        return 1;
+    }
+    if (is_2mg) {
+        fwrite(out_image, 1, out_image_size, fp);
+    } else {
+        fwrite(disk.data, 1, sector_data_size, fp);
+    }
+    fclose(fp);
+
+    printf("%s: %u bytes decoded in %.2f ms\n", argv[2], (unsigned)sector_data_size,
+           (double)(t1 - t0) * 1000.0 / CLOCKS_PER_SEC);
+
+    free(out_image);
+    free(nib.bits_data);
+    free(woz_image);
+    return 0;
+}
@@ -365,10 +365,12 @@ static void _clem_drive_off(struct ClemensDeviceIWM *iwm, struct ClemensDriveBay
 void clem_iwm_glu_sync(struct ClemensDeviceIWM *iwm, struct ClemensDriveBay *drives,
                        struct ClemensClock *clock) {
     unsigned delta_ns, lss_time_left_ns;
+    clem_clocks_duration_t lss_update_dt_clocks;
     struct ClemensClock next_clock;
 
     delta_ns = clem_calc_ns_step_from_clocks((clock->ts - iwm->last_clocks_ts), clock->ref_step);
     lss_time_left_ns = delta_ns;
+    lss_update_dt_clocks = clem_calc_clocks_step_from_ns(iwm->lss_update_dt_ns, clock->ref_step);
 
     /* Move shared _clem_iwm_lss logic up here. */
     /* catch up the LSS from the last sync to the current time */
@@ -399,8 +401,8 @@ void clem_iwm_glu_sync(struct ClemensDeviceIWM *iwm, struct ClemensDriveBay *dri
             //  /ENABLE2 handling for SmartPort and Disk II is handled implicitly
             //  by the drive pointer. Basically if the SmartPort bus is enabled,
             //  the 5.25" disk is disabled.
-            iwm->enable2 = clem_smartport_bus(drives->smartport, 1, &iwm->io_flags, &iwm->out_phase,
-                                              disk_delta_ns);
+            iwm->enable2 = clem_smartport_bus(drives->smartport, CLEM_SMARTPORT_DRIVE_LIMIT,
+                                              &iwm->io_flags, &iwm->out_phase, disk_delta_ns);
             if (iwm->enable2) {
                 /*
                 if (iwm->state == CLEM_IWM_STATE_WRITE_DATA &&
@@ -466,7 +468,7 @@ void clem_iwm_glu_sync(struct ClemensDeviceIWM *iwm, struct ClemensDriveBay *dri
             }
         }
         lss_time_left_ns -= iwm->lss_update_dt_ns;
-        next_clock.ts += clem_calc_clocks_step_from_ns(iwm->lss_update_dt_ns, next_clock.ref_step);
+        next_clock.ts += lss_update_dt_clocks;
     }
     /* handle the 1 second drive motor timer */
     if (iwm->ns_drive_hold > 0) {
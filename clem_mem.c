@@ -8,6 +8,21 @@ static inline void _clem_mem_cycle(ClemensMachine *clem, bool mega2_access) {
     ++clem->cpu.cycles_spent;
 }
 
+static void _clem_mem_count_access(struct ClemensMemoryAccessCounters *counters, uint16_t adr,
+                                   uint8_t bank, uint8_t flags, bool is_write) {
+    unsigned page_idx = ((unsigned)bank << 8) | (adr >> 8);
+    if (is_write) {
+        ++counters->writes[page_idx];
+    } else if (flags == CLEM_MEM_FLAG_OPCODE_FETCH) {
+        ++counters->executes[page_idx];
+    } else {
+        ++counters->reads[page_idx];
+    }
+    if (counters->bytes && bank == counters->byte_bank) {
+        ++counters->bytes[adr];
+    }
+}
+
 void clem_mem_create_page_mapping(struct ClemensMemoryPageInfo *page, uint8_t page_idx,
                                   uint8_t bank_read_idx, uint8_t bank_write_idx) {
     page->flags = CLEM_MEM_PAGE_WRITEOK_FLAG;
@@ -25,6 +40,10 @@ void clem_read(ClemensMachine *clem, uint8_t *data, uint16_t adr, uint8_t bank,
     bool mega2_access = false;
     bool io_access = false;
 
+    if (clem->mem.access_counters && !read_only) {
+        _clem_mem_count_access(clem->mem.access_counters, adr, bank, flags, false);
+    }
+
     // TODO: store off if read_reg has a read_count of 1 here
     //       reset it automatically if true at the end of this function
     if (page->flags & CLEM_MEM_IO_MEMORY_MASK) {
@@ -92,6 +111,18 @@ void clem_write(ClemensMachine *clem, uint8_t data, uint16_t adr, uint8_t bank,
     bool mega2_access = false;
     bool io_access = false;
 
+    if (clem->mem.access_counters && mem_flags != CLEM_MEM_FLAG_NULL) {
+        _clem_mem_count_access(clem->mem.access_counters, adr, bank, mem_flags, true);
+    }
+    if (clem->mem.write_log && mem_flags != CLEM_MEM_FLAG_NULL) {
+        struct ClemensMemoryWriteLog *write_log = clem->mem.write_log;
+        if (write_log->count < CLEM_MEM_WRITE_LOG_LIMIT) {
+            write_log->addr[write_log->count] = ((uint32_t)bank << 16) | adr;
+            write_log->data[write_log->count] = data;
+        }
+        ++write_log->count;
+    }
+
     if (page->flags & CLEM_MEM_IO_MEMORY_MASK) {
         unsigned slot_idx;
         if (page->flags & CLEM_MEM_PAGE_IOADDR_FLAG) {
@@ -124,11 +155,19 @@ void clem_write(ClemensMachine *clem, uint8_t data, uint16_t adr, uint8_t bank,
         bank_mem = _clem_get_memory_bank(clem, bank_actual, &mega2_access);
         if (page->flags & CLEM_MEM_PAGE_WRITEOK_FLAG) {
             bank_mem[offset] = data;
+            if (clem->mem.page_write_gen) {
+                clem->mem.page_write_gen[((unsigned)bank_actual << 8) | page->write] =
+                    clem->mem.write_generation;
+            }
         }
         if (shadow_map && shadow_map->pages[page->write]) {
             bank_mem = _clem_get_memory_bank(clem, (0xE0) | (bank_actual & 0x1), &mega2_access);
             if (page->flags & CLEM_MEM_PAGE_WRITEOK_FLAG) {
                 bank_mem[offset] = data;
+                if (clem->mem.page_write_gen) {
+                    clem->mem.page_write_gen[((0xe0U | (bank_actual & 0x1)) << 8) | page->write] =
+                        clem->mem.write_generation;
+                }
             }
         }
         if (bank_actual == 0xe0 || bank_actual == 0xe1) {
@@ -148,3 +187,25 @@ void clem_write(ClemensMachine *clem, uint8_t data, uint16_t adr, uint8_t bank,
         _clem_mem_cycle(clem, mega2_access);
     }
 }
+
+const uint8_t *clem_mem_get_read_page(ClemensMachine *clem, uint8_t bank, uint8_t page_idx,
+                                      uint16_t *physical_page) {
+    struct ClemensMemoryPageInfo *page = &clem->mem.bank_page_map[bank]->pages[page_idx];
+    uint8_t bank_actual;
+    bool mega2_access;
+
+    if ((page->flags & CLEM_MEM_IO_MEMORY_MASK) ||
+        ((page->flags & CLEM_MEM_PAGE_TYPE_MASK) && !(page->flags & CLEM_MEM_PAGE_BANK_MASK))) {
+        return NULL;
+    }
+    if (page->flags & CLEM_MEM_PAGE_DIRECT_FLAG) {
+        bank_actual = bank;
+    } else if (page->flags & CLEM_MEM_PAGE_MAINAUX_FLAG) {
+        bank_actual = (bank & 0xfe) | (page->bank_read & 0x1);
+    } else {
+        bank_actual = page->bank_read;
+    }
+    *physical_page = ((uint16_t)bank_actual << 8) | page->read;
+    return _clem_get_memory_bank(clem, bank_actual, &mega2_access) +
+           ((unsigned)page->read << 8);
+}
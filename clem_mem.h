@@ -44,6 +44,14 @@ void clem_mem_create_page_mapping(struct ClemensMemoryPageInfo *page, uint8_t pa
 void clem_read(ClemensMachine *clem, uint8_t *data, uint16_t adr, uint8_t bank, uint8_t flags);
 void clem_write(ClemensMachine *clem, uint8_t data, uint16_t adr, uint8_t bank, uint8_t flags);
 
+/* Resolves the RAM/ROM page that clem_read() would access for the logical bank
+   and page, returning a pointer to its 256 bytes and its physical page index
+   ((bank << 8) | page.)  Returns NULL for I/O and card pages, which must be
+   read through clem_read().
+*/
+const uint8_t *clem_mem_get_read_page(ClemensMachine *clem, uint8_t bank, uint8_t page_idx,
+                                      uint16_t *physical_page);
+
 #ifdef __cplusplus
 }
 #endif
@@ -84,7 +84,7 @@
  */
 
 static void _clem_mmio_memory_map(ClemensMMIO *mmio, uint32_t memory_flags);
-static void _clem_mmio_shadow_map(ClemensMMIO *mmio, uint32_t shadow_flags);
+static void _clem_mmio_shadow_map(ClemensMMIO *mmio, uint32_t remap_flags, uint32_t shadow_flags);
 
 static void _clem_mmio_create_page_direct_mapping(struct ClemensMemoryPageInfo *page,
                                                   uint8_t page_idx) {
@@ -1118,12 +1118,11 @@ void clem_mmio_write(ClemensMMIO *mmio, struct ClemensTimeSpec *tspec, uint8_t d
     }
 }
 
-static void _clem_mmio_shadow_map(ClemensMMIO *mmio, uint32_t shadow_flags) {
+static void _clem_mmio_shadow_map(ClemensMMIO *mmio, uint32_t remap_flags, uint32_t shadow_flags) {
     /* Sets up which pages are shadowed on banks 00, 01.  Flags tested inside
        _clem_write determine if the write operation actual performs the copy to
        E0, E1
     */
-    unsigned remap_flags = mmio->mmap_register ^ shadow_flags;
     unsigned page_idx;
     bool inhibit_hgr_bank_01 = (shadow_flags & CLEM_MEM_IO_MMAP_NSHADOW_AUX) != 0;
     bool inhibit_shgr_bank_01 = (shadow_flags & CLEM_MEM_IO_MMAP_NSHADOW_SHGR) != 0;
@@ -1188,8 +1187,15 @@ static void _clem_mmio_shadow_map(ClemensMMIO *mmio, uint32_t shadow_flags) {
     Strategy is to apply //e softswitches first, and then apply shadow (iigs)
     switches (iolc inhibit)
 
+    The page maps for banks 00, 01, E0, E1 are kept in sets, one for each
+    recently used switch setting.  A set is built once by remapping a copy of
+    the set in use, and afterwards switching back to its setting only swaps the
+    bank page map pointers.  Shadowing has its own maps that are shared by all
+    sets.
 */
-static void _clem_mmio_memory_map(ClemensMMIO *mmio, uint32_t memory_flags) {
+static void _clem_mmio_remap_page_map_set(ClemensMMIO *mmio,
+                                          struct ClemensMMIOPageMapSet *page_map_set,
+                                          uint32_t last_flags, uint32_t memory_flags) {
     struct ClemensMemoryPageMap *page_map_B00;
     struct ClemensMemoryPageMap *page_map_B01;
     struct ClemensMemoryPageMap *page_map_BE0;
@@ -1198,13 +1204,13 @@ static void _clem_mmio_memory_map(ClemensMMIO *mmio, uint32_t memory_flags) {
     struct ClemensMemoryPageInfo *page_B01;
     struct ClemensMemoryPageInfo *page_BE0;
     struct ClemensMemoryPageInfo *page_BE1;
-    unsigned remap_flags = mmio->mmap_register ^ memory_flags;
+    unsigned remap_flags = last_flags ^ memory_flags;
     unsigned page_idx;
 
-    page_map_B00 = &mmio->fpi_main_page_map;
-    page_map_B01 = &mmio->fpi_aux_page_map;
-    page_map_BE0 = &mmio->mega2_main_page_map;
-    page_map_BE1 = &mmio->mega2_aux_page_map;
+    page_map_B00 = &page_map_set->fpi_main_page_map;
+    page_map_B01 = &page_map_set->fpi_aux_page_map;
+    page_map_BE0 = &page_map_set->mega2_main_page_map;
+    page_map_BE1 = &page_map_set->mega2_aux_page_map;
 
     //  ALTZPLC is a main bank-only softswitch.  As a result 01, E0, E1 bank
     //      maps for page 0, 1 remain unchanged
@@ -1257,7 +1263,6 @@ static void _clem_mmio_memory_map(ClemensMMIO *mmio, uint32_t memory_flags) {
 
     //  RAMRD/RAMWRT minus the page 1 Apple //e video regions
     if (remap_flags & (CLEM_MEM_IO_MMAP_RAMRD + CLEM_MEM_IO_MMAP_RAMWRT)) {
-        remap_flags |= CLEM_MEM_IO_MMAP_NSHADOW;
         for (page_idx = 0x02; page_idx < 0x04; ++page_idx) {
             page_B00 = &page_map_B00->pages[page_idx];
             page_B00->bank_read = ((memory_flags & CLEM_MEM_IO_MMAP_RAMRD) ? 0x01 : 00);
@@ -1275,11 +1280,6 @@ static void _clem_mmio_memory_map(ClemensMMIO *mmio, uint32_t memory_flags) {
         }
     }
 
-    //  Shadowing
-    if (remap_flags & CLEM_MEM_IO_MMAP_NSHADOW) {
-        _clem_mmio_shadow_map(mmio, memory_flags & CLEM_MEM_IO_MMAP_NSHADOW);
-    }
-
     //  I/O space mapping
     //  IOLC switch changed, which requires remapping the entire language card
     //  region + the I/O region (for FPI memory - Mega2 doesn't deal with
@@ -1516,47 +1516,81 @@ static void _clem_mmio_memory_map(ClemensMMIO *mmio, uint32_t memory_flags) {
             }
         }
     }
+}
+
+static void _clem_mmio_bind_page_map_set(ClemensMMIO *mmio, unsigned set_idx) {
+    struct ClemensMMIOPageMapSet *page_map_set = &mmio->page_map_sets[set_idx];
+    mmio->page_map_set_index = set_idx;
+    mmio->bank_page_map[0x00] = &page_map_set->fpi_main_page_map;
+    mmio->bank_page_map[0x01] = &page_map_set->fpi_aux_page_map;
+    mmio->bank_page_map[0xE0] = &page_map_set->mega2_main_page_map;
+    mmio->bank_page_map[0xE1] = &page_map_set->mega2_aux_page_map;
+}
+
+static void _clem_mmio_select_page_map_set(ClemensMMIO *mmio, uint32_t memory_flags) {
+    uint32_t page_map_flags = memory_flags & CLEM_MEM_IO_MMAP_PAGE_MAP_MASK;
+    unsigned set_idx;
+    unsigned lru_set_idx = CLEM_MMIO_PAGE_MAP_SET_LIMIT;
+
+    for (set_idx = 0; set_idx < mmio->page_map_set_count; ++set_idx) {
+        if (mmio->page_map_set_flags[set_idx] == page_map_flags)
+            break;
+        if (set_idx == mmio->page_map_set_index)
+            continue;
+        if (lru_set_idx == CLEM_MMIO_PAGE_MAP_SET_LIMIT ||
+            mmio->page_map_set_used[set_idx] < mmio->page_map_set_used[lru_set_idx]) {
+            lru_set_idx = set_idx;
+        }
+    }
+    if (set_idx == mmio->page_map_set_count) {
+        if (set_idx < CLEM_MMIO_PAGE_MAP_SET_LIMIT) {
+            ++mmio->page_map_set_count;
+        } else {
+            set_idx = lru_set_idx;
+        }
+        memcpy(&mmio->page_map_sets[set_idx], &mmio->page_map_sets[mmio->page_map_set_index],
+               sizeof(struct ClemensMMIOPageMapSet));
+        _clem_mmio_remap_page_map_set(mmio, &mmio->page_map_sets[set_idx], mmio->mmap_register,
+                                      memory_flags);
+        mmio->page_map_set_flags[set_idx] = page_map_flags;
+    }
+    mmio->page_map_set_used[set_idx] = ++mmio->page_map_set_clock;
+    _clem_mmio_bind_page_map_set(mmio, set_idx);
+}
+
+static void _clem_mmio_memory_map(ClemensMMIO *mmio, uint32_t memory_flags) {
+    unsigned remap_flags = mmio->mmap_register ^ memory_flags;
+
+    if (remap_flags & CLEM_MEM_IO_MMAP_PAGE_MAP_MASK) {
+        _clem_mmio_select_page_map_set(mmio, memory_flags);
+    }
+    if (remap_flags & CLEM_MEM_IO_MMAP_NSHADOW) {
+        _clem_mmio_shadow_map(mmio, remap_flags, memory_flags & CLEM_MEM_IO_MMAP_NSHADOW);
+    }
 
     mmio->mmap_register = memory_flags;
 }
 
-void _clem_mmio_init_page_maps(ClemensMMIO *mmio, uint32_t memory_flags) {
+static void _clem_mmio_init_page_map_set(ClemensMMIO *mmio,
+                                         struct ClemensMMIOPageMapSet *page_map_set) {
     struct ClemensMemoryPageMap *page_map;
     struct ClemensMemoryPageInfo *page;
     unsigned page_idx;
-    unsigned bank_idx;
 
     //  Bank 00, 01 as RAM
     //  TODO need to mask bank for main and aux page maps
-
-    page_map = &mmio->empty_page_map;
-    page_map->shadow_map = NULL;
-    for (page_idx = 0x00; page_idx < 0x100; ++page_idx) {
-        /* using a non-valid IIgs bank here that's not writable. */
-        page = &page_map->pages[page_idx];
-        clem_mem_create_page_mapping(page, page_idx, CLEM_IIGS_EMPTY_RAM_BANK,
-                                     CLEM_IIGS_EMPTY_RAM_BANK);
-        page->flags &= ~CLEM_MEM_PAGE_WRITEOK_FLAG;
-    }
-
-    page_map = &mmio->fpi_main_page_map;
+    page_map = &page_map_set->fpi_main_page_map;
     page_map->shadow_map = &mmio->fpi_mega2_main_shadow_map;
     for (page_idx = 0x00; page_idx < 0x100; ++page_idx) {
         _clem_mmio_create_page_mainaux_mapping(&page_map->pages[page_idx], page_idx, 0x00);
     }
-    page_map = &mmio->fpi_aux_page_map;
+    page_map = &page_map_set->fpi_aux_page_map;
     page_map->shadow_map = &mmio->fpi_mega2_aux_shadow_map;
     for (page_idx = 0x00; page_idx < 0x100; ++page_idx) {
         _clem_mmio_create_page_mainaux_mapping(&page_map->pages[page_idx], page_idx, 0x01);
     }
-    //  Banks 02-7f typically (if expanded memory is available)
-    page_map = &mmio->fpi_direct_page_map;
-    page_map->shadow_map = NULL;
-    for (page_idx = 0x00; page_idx < 0x100; ++page_idx) {
-        _clem_mmio_create_page_direct_mapping(&page_map->pages[page_idx], page_idx);
-    }
     //  Banks E0 - C000-CFFF mapped as IO, Internal ROM
-    page_map = &mmio->mega2_main_page_map;
+    page_map = &page_map_set->mega2_main_page_map;
     page_map->shadow_map = NULL;
     for (page_idx = 0x00; page_idx < 0x100; ++page_idx) {
         _clem_mmio_create_page_direct_mapping(&page_map->pages[page_idx], page_idx);
@@ -1569,7 +1603,7 @@ void _clem_mmio_init_page_maps(ClemensMMIO *mmio, uint32_t memory_flags) {
         page->flags &= ~CLEM_MEM_PAGE_WRITEOK_FLAG;
     }
     //  Banks E1 - C000-CFFF mapped as IO, Internal ROM
-    page_map = &mmio->mega2_aux_page_map;
+    page_map = &page_map_set->mega2_aux_page_map;
     page_map->shadow_map = NULL;
     for (page_idx = 0x00; page_idx < 0x100; ++page_idx) {
         _clem_mmio_create_page_direct_mapping(&page_map->pages[page_idx], page_idx);
@@ -1581,6 +1615,30 @@ void _clem_mmio_init_page_maps(ClemensMMIO *mmio, uint32_t memory_flags) {
         clem_mem_create_page_mapping(page, page_idx, 0xff, 0xe1);
         page->flags &= ~CLEM_MEM_PAGE_WRITEOK_FLAG;
     }
+}
+
+void _clem_mmio_init_page_maps(ClemensMMIO *mmio, uint32_t memory_flags) {
+    struct ClemensMemoryPageMap *page_map;
+    struct ClemensMemoryPageInfo *page;
+    unsigned page_idx;
+    unsigned bank_idx;
+
+    page_map = &mmio->empty_page_map;
+    page_map->shadow_map = NULL;
+    for (page_idx = 0x00; page_idx < 0x100; ++page_idx) {
+        /* using a non-valid IIgs bank here that's not writable. */
+        page = &page_map->pages[page_idx];
+        clem_mem_create_page_mapping(page, page_idx, CLEM_IIGS_EMPTY_RAM_BANK,
+                                     CLEM_IIGS_EMPTY_RAM_BANK);
+        page->flags &= ~CLEM_MEM_PAGE_WRITEOK_FLAG;
+    }
+
+    //  Banks 02-7f typically (if expanded memory is available)
+    page_map = &mmio->fpi_direct_page_map;
+    page_map->shadow_map = NULL;
+    for (page_idx = 0x00; page_idx < 0x100; ++page_idx) {
+        _clem_mmio_create_page_direct_mapping(&page_map->pages[page_idx], page_idx);
+    }
     //  Banks FC-FF ROM access is read-only of course.
     page_map = &mmio->fpi_rom_page_map;
     page_map->shadow_map = NULL;
@@ -1590,10 +1648,8 @@ void _clem_mmio_init_page_maps(ClemensMMIO *mmio, uint32_t memory_flags) {
         page->flags &= ~CLEM_MEM_PAGE_WRITEOK_FLAG;
     }
 
-    //  set up the default page mappings
-    mmio->bank_page_map[0x00] = &mmio->fpi_main_page_map;
-    mmio->bank_page_map[0x01] = &mmio->fpi_aux_page_map;
-
+    //  set up the default page mappings - banks 00, 01, E0, E1 are bound to
+    //  their page map set in clem_mmio_restore()
     for (bank_idx = 0x02; bank_idx < mmio->fpi_ram_bank_count; ++bank_idx) {
         mmio->bank_page_map[bank_idx] = &mmio->fpi_direct_page_map;
     }
@@ -1605,9 +1661,6 @@ void _clem_mmio_init_page_maps(ClemensMMIO *mmio, uint32_t memory_flags) {
     for (bank_idx = 0x80; bank_idx < 0xF0; ++bank_idx) {
         mmio->bank_page_map[bank_idx] = &mmio->empty_page_map;
     }
-    /* Mega II banks */
-    mmio->bank_page_map[0xE0] = &mmio->mega2_main_page_map;
-    mmio->bank_page_map[0xE1] = &mmio->mega2_aux_page_map;
     /* TODO: handle expansion ROM and 128K firmware ROM 01*/
     for (bank_idx = 0xF0; bank_idx < 0xFC; ++bank_idx) {
         mmio->bank_page_map[bank_idx] = &mmio->empty_page_map;
@@ -1632,14 +1685,24 @@ void clem_mmio_reset(ClemensMMIO *mmio, clem_clocks_duration_t mega2_clocks_step
     clem_sound_reset(&mmio->dev_audio);
     clem_vgc_reset(&mmio->vgc);
     clem_iwm_reset(&mmio->dev_iwm);
-    clem_scc_reset(&mmio->dev_scc);
+    clem_scc_reset(&mmio->dev_scc, mega2_clocks_step);
 }
 
 void clem_mmio_restore(ClemensMMIO *mmio) {
     uint32_t memory_flags = mmio->mmap_register;
-    mmio->mmap_register = 0xffffffff;
-    _clem_mmio_memory_map(mmio, 0x0000000000);
-    _clem_mmio_memory_map(mmio, memory_flags);
+
+    //  the page maps also depend on card_expansion_rom_index, so every set is
+    //  thrown out and the one in use is built from scratch
+    _clem_mmio_init_page_map_set(mmio, &mmio->page_map_sets[0]);
+    _clem_mmio_remap_page_map_set(mmio, &mmio->page_map_sets[0], 0xffffffff, 0x00000000);
+    _clem_mmio_remap_page_map_set(mmio, &mmio->page_map_sets[0], 0x00000000, memory_flags);
+    _clem_mmio_shadow_map(mmio, 0xffffffff, 0x00000000);
+    _clem_mmio_shadow_map(mmio, memory_flags, memory_flags & CLEM_MEM_IO_MMAP_NSHADOW);
+    mmio->page_map_set_flags[0] = memory_flags & CLEM_MEM_IO_MMAP_PAGE_MAP_MASK;
+    mmio->page_map_set_used[0] = 0;
+    mmio->page_map_set_clock = 0;
+    mmio->page_map_set_count = 1;
+    _clem_mmio_bind_page_map_set(mmio, 0);
 }
 
 void clem_mmio_init(ClemensMMIO *mmio, struct ClemensDeviceDebugger *dev_debug,
@@ -1658,6 +1721,8 @@ void clem_mmio_init(ClemensMMIO *mmio, struct ClemensDeviceDebugger *dev_debug,
     mmio->clocks_step_mega2 = mega2_clocks_step;
     mmio->speed_c036 = CLEM_MMIO_SPEED_FAST_ENABLED | CLEM_MMIO_SPEED_POWERED_ON;
     mmio->mega2_cycles = 0;
+    mmio->mega2_cycles_60hz = CLEM_MEGA2_CYCLES_PER_60TH;
+    clem_timer_start(&mmio->dev_timer, 0);
     mmio->last_data_address = 0xffffffff;
     mmio->bank_page_map = bank_page_map;
     mmio->emulator_detect = CLEM_MMIO_EMULATOR_DETECT_IDLE;
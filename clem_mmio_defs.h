@@ -27,6 +27,7 @@
 #define CLEM_IRQ_ADB_DATA       (0x00000800)
 #define CLEM_IRQ_ADB_MASK       (0x00000f00)
 #define CLEM_IRQ_AUDIO_OSC      (0x00001000)
+#define CLEM_IRQ_SCC            (0x00002000)
 #define CLEM_IRQ_SLOT_1         (0x00100000)
 #define CLEM_IRQ_SLOT_2         (0x00200000)
 #define CLEM_IRQ_SLOT_3         (0x00400000)
@@ -95,6 +96,14 @@
 //  0 = Bank 00: I/O enabled + LC enabled,  1 = I/O disabled + LC disabled
 #define CLEM_MEM_IO_MMAP_NIOLC 0x04000000
 
+//  The switches that select page maps for banks 00, 01, E0 and E1 (shadowing
+//  uses its own maps)
+#define CLEM_MEM_IO_MMAP_PAGE_MAP_MASK                                                           \
+    (CLEM_MEM_IO_MMAP_ALTZPLC | CLEM_MEM_IO_MMAP_OLDVIDEO | CLEM_MEM_IO_MMAP_LC |                \
+     CLEM_MEM_IO_MMAP_CROM | CLEM_MEM_IO_MMAP_NIOLC)
+//  Page map sets kept for recently used switch settings - see ClemensMMIO
+#define CLEM_MMIO_PAGE_MAP_SET_LIMIT 16
+
 //  Bits 24-31 deal with memory mapped features not covered above
 
 /**
@@ -393,6 +402,11 @@
  */
 #define CLEM_ADB_KEYB_BUFFER_LIMIT     8
 #define CLEM_ADB_KEYB_TOGGLE_CAPS_LOCK 0x0000001
+/** Setting: characters waiting to be typed into the keyboard latch (see
+ *  clemens_input_text.)  Must be a power of two */
+#define CLEM_ADB_TEXT_QUEUE_SIZE 256
+/** Mouse motion not yet reported to the guest saturates at this distance */
+#define CLEM_ADB_MOUSE_DELTA_LIMIT 4096
 
 /** Gameport support - note that paddle axis values range from 0 to 1023, and
  *  there's support for up to 8 buttons.  Of course the Apple 2 only supports
@@ -671,6 +685,89 @@
 #define CLEM_SCC_PORT_RX_DATA_HI 0x20
 #define CLEM_SCC_PORT_GPI        0x40
 
+/* Z8530 SCC - channel A is the printer port (slot 1), B is the modem port (slot 2) */
+#define CLEM_SCC_CHANNEL_A 0
+#define CLEM_SCC_CHANNEL_B 1
+
+/* Z8530 clock inputs on the IIgs - PCLK is the 14M clock / 4 and RTxC is a
+   3.6864 Mhz crystal */
+#define CLEM_SCC_PCLK_HZ 3579545U
+#define CLEM_SCC_RTXC_HZ 3686400U
+
+/* Write register 0 - commands and the register pointer */
+#define CLEM_SCC_WR0_REG_MASK        0x07
+#define CLEM_SCC_WR0_CMD_MASK        0x38
+#define CLEM_SCC_WR0_CMD_POINT_HIGH  0x08
+#define CLEM_SCC_WR0_CMD_RESET_EXT   0x10
+#define CLEM_SCC_WR0_CMD_RX_INT_NEXT 0x20
+#define CLEM_SCC_WR0_CMD_RESET_TX_IP 0x28
+#define CLEM_SCC_WR0_CMD_RESET_ERROR 0x30
+#define CLEM_SCC_WR0_CMD_RESET_IUS   0x38
+/* Write register 1 - interrupt enables */
+#define CLEM_SCC_WR1_EXT_IE          0x01
+#define CLEM_SCC_WR1_TX_IE           0x02
+#define CLEM_SCC_WR1_RX_IE_MASK      0x18
+#define CLEM_SCC_WR1_RX_IE_FIRST     0x08
+#define CLEM_SCC_WR1_RX_IE_ALL       0x10
+#define CLEM_SCC_WR1_RX_IE_SPECIAL   0x18
+/* Write register 3 - receiver */
+#define CLEM_SCC_WR3_RX_ENABLE       0x01
+#define CLEM_SCC_WR3_AUTO_ENABLES    0x20
+#define CLEM_SCC_WR3_RX_BITS_MASK    0xc0
+/* Write register 4 - async mode */
+#define CLEM_SCC_WR4_PARITY_ENABLE   0x01
+#define CLEM_SCC_WR4_STOP_BITS_MASK  0x0c
+#define CLEM_SCC_WR4_CLOCK_MODE_MASK 0xc0
+/* Write register 5 - transmitter */
+#define CLEM_SCC_WR5_RTS             0x02
+#define CLEM_SCC_WR5_TX_ENABLE       0x08
+#define CLEM_SCC_WR5_TX_BITS_MASK    0x60
+#define CLEM_SCC_WR5_DTR             0x80
+/* Write register 9 - master interrupt control (shared) */
+#define CLEM_SCC_WR9_VIS             0x01
+#define CLEM_SCC_WR9_NV              0x02
+#define CLEM_SCC_WR9_MIE             0x08
+#define CLEM_SCC_WR9_STATUS_HIGH     0x10
+#define CLEM_SCC_WR9_RESET_MASK      0xc0
+#define CLEM_SCC_WR9_RESET_B         0x40
+#define CLEM_SCC_WR9_RESET_A         0x80
+#define CLEM_SCC_WR9_RESET_HW        0xc0
+/* Write register 11 - clock sources */
+#define CLEM_SCC_WR11_TX_CLOCK_MASK  0x18
+#define CLEM_SCC_WR11_TX_CLOCK_BRG   0x10
+#define CLEM_SCC_WR11_RX_CLOCK_MASK  0x60
+#define CLEM_SCC_WR11_RX_CLOCK_BRG   0x40
+/* Write register 14 - baud rate generator and loopback */
+#define CLEM_SCC_WR14_BRG_ENABLE     0x01
+#define CLEM_SCC_WR14_BRG_PCLK       0x02
+#define CLEM_SCC_WR14_LOCAL_LOOPBACK 0x10
+/* Write register 15 - external/status interrupt enables */
+#define CLEM_SCC_WR15_DCD_IE         0x08
+#define CLEM_SCC_WR15_CTS_IE         0x20
+
+/* Read register 0 - status */
+#define CLEM_SCC_RR0_RX_AVAIL        0x01
+#define CLEM_SCC_RR0_TX_EMPTY        0x04
+#define CLEM_SCC_RR0_DCD             0x08
+#define CLEM_SCC_RR0_CTS             0x20
+#define CLEM_SCC_RR0_TX_UNDERRUN     0x40
+/* Read register 1 - special receive conditions */
+#define CLEM_SCC_RR1_ALL_SENT        0x01
+#define CLEM_SCC_RR1_RX_OVERRUN      0x20
+/* Read register 3 - interrupt pending (channel A only) */
+#define CLEM_SCC_RR3_B_EXT_IP        0x01
+#define CLEM_SCC_RR3_B_TX_IP         0x02
+#define CLEM_SCC_RR3_B_RX_IP         0x04
+#define CLEM_SCC_RR3_A_EXT_IP        0x08
+#define CLEM_SCC_RR3_A_TX_IP         0x10
+#define CLEM_SCC_RR3_A_RX_IP         0x20
+
+/* The receive FIFO is 3 bytes deep on the Z8530 */
+#define CLEM_SCC_RX_FIFO_SIZE 3
+/* Bytes buffered in each direction between a channel and its host endpoint.
+   Must be a power of two */
+#define CLEM_SCC_HOST_QUEUE_SIZE 256
+
 #define CLEM_ENSONIQ_OSC_CTL_FREE_MODE 0x00
 #define CLEM_ENSONIQ_OSC_CTL_M0        0x02
 #define CLEM_ENSONIQ_OSC_CTL_SYNC      0x04
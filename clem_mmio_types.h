@@ -42,12 +42,21 @@ struct ClemensDeviceKeyboard {
     int repeat_count;
     uint8_t last_a2_key_down;
     bool reset_key;
+    /* ASCII typed directly into the keyboard latch as the guest clears the
+       strobe, bypassing the key queue */
+    uint8_t text[CLEM_ADB_TEXT_QUEUE_SIZE];
+    uint32_t text_head; /**< next character typed, wraps at 2^32 */
+    uint32_t text_tail; /**< next character queued, wraps at 2^32 */
 };
 
 struct ClemensDeviceMouse {
     unsigned pos[CLEM_ADB_KEYB_BUFFER_LIMIT];
     int size;
     bool btn_down;
+    /* motion accumulated since the last report, which is coalesced into the
+       next poll rather than queued per host event */
+    int dx;
+    int dy;
 };
 
 struct ClemensDeviceGameport {
@@ -100,13 +109,66 @@ struct ClemensDeviceADB {
     uint32_t irq_line;     /**< IRQ flags passed to machine */
 };
 
+/**
+ * @brief A ring of bytes passed between an SCC channel and the host
+ *
+ * The emulator and host exchange bytes through these in batches (i.e. once
+ * per emulated timeslice) rather than per character or per bit.
+ */
+struct ClemensSCCHostQueue {
+    uint8_t data[CLEM_SCC_HOST_QUEUE_SIZE];
+    uint32_t head; /**< next byte read, wraps at 2^32 */
+    uint32_t tail; /**< next byte written, wraps at 2^32 */
+};
+
+/**
+ * @brief One Z8530 channel
+ *
+ * Character timing is derived from the baud rate generator and framing
+ * registers.  Transmit and receive completion times are absolute clock
+ * timestamps, so the sync only does work when a character is due.
+ */
+struct ClemensSCCChannel {
+    uint8_t wr[16]; /**< write registers (WR2 and WR9 are shared, see device) */
+    uint8_t rr0;    /**< status bits that are latched (see CLEM_SCC_RR0_xxx) */
+    uint8_t rr1;    /**< special receive condition bits */
+    uint8_t ip;     /**< pending interrupts for this channel (A bits of RR3) */
+
+    uint8_t tx_buffer;   /**< byte written by the guest */
+    uint8_t tx_shift;    /**< byte being transmitted */
+    bool tx_buffer_full; /**< tx_buffer is waiting for the shifter */
+    bool tx_shifting;    /**< tx_shift is on the wire until ts_tx_done */
+    bool rx_int_next;    /**< RX interrupt on first character is armed */
+    bool rx_receiving;   /**< a host byte is on the wire until ts_rx_done */
+
+    uint8_t rx_fifo[CLEM_SCC_RX_FIFO_SIZE];
+    unsigned rx_fifo_count;
+
+    clem_clocks_time_t ts_tx_done; /**< when tx_shift finishes */
+    clem_clocks_time_t ts_rx_done; /**< when the next host byte is received */
+    clem_clocks_time_t dt_tx_char; /**< clocks per character, 0 if stalled */
+    clem_clocks_time_t dt_rx_char;
+
+    bool host_connected; /**< DCD and CTS are asserted by the host endpoint */
+
+    struct ClemensSCCHostQueue to_host;   /**< bytes sent by the guest */
+    struct ClemensSCCHostQueue from_host; /**< bytes to be received by the guest */
+};
+
 struct ClemensDeviceSCC {
     clem_clocks_time_t ts_last_frame;
+    /** The earliest pending TX/RX completion for either channel.  The sync
+     *  returns immediately until then. */
+    clem_clocks_time_t ts_next_event;
+    clem_clocks_duration_t clocks_step_mega2; /**< clocks per mega2 cycle for baud timing */
 
-    /** Internal state that drives how the cmd/data registers are interpreted */
-    unsigned state;
+    /** Register pointer per channel for the next command register access */
     unsigned selected_reg[2];
 
+    struct ClemensSCCChannel channel[2]; /**< See CLEM_SCC_CHANNEL_xxx */
+    uint8_t wr2;                         /**< interrupt vector */
+    uint8_t wr9;                         /**< master interrupt control */
+
     uint8_t serial[2]; /**< See CLEM_SCC_PORT_xxx */
 
     uint32_t irq_line; /**< IRQ flags passed to machine */
@@ -127,6 +189,26 @@ struct ClemensAudioMixBuffer {
     unsigned frames_per_second; /**< target audio frequency */
 };
 
+/**
+ * @brief Receives mixed audio frames as they are consumed by the host
+ *
+ * Frames are 32-bit float stereo, laid out as in ClemensAudioMixBuffer.
+ */
+typedef void (*ClemensAudioCaptureCallback)(void *user_ptr, const uint8_t *data,
+                                            unsigned frame_count, unsigned frame_stride,
+                                            unsigned frames_per_second);
+
+/**
+ * @brief A host supplied sink for the mixed audio output
+ *
+ * See clemens_audio_capture()
+ */
+struct ClemensAudioCapture {
+    ClemensAudioCaptureCallback callback;
+    void *user_ptr;
+    uint64_t frame_total; /**< Frames passed to the callback since attached */
+};
+
 struct ClemensDeviceEnsoniq {
     /** Clocks budget for oscillator sync */
     clem_clocks_duration_t dt_budget;
@@ -162,6 +244,8 @@ struct ClemensDeviceAudio {
 
     /* host supplied mix buffer */
     struct ClemensAudioMixBuffer mix_buffer;
+    /* host supplied capture sink (optional) */
+    struct ClemensAudioCapture *capture;
     clem_clocks_time_t ts_last_frame;
     clem_clocks_duration_t dt_mix_frame;
     clem_clocks_duration_t dt_mix_sample;
@@ -186,8 +270,10 @@ struct ClemensDeviceAudio {
  *  pulling out into its own component
  */
 struct ClemensDeviceTimer {
-    uint32_t irq_1sec_us;   /**< used to trigger IRQ one sec */
-    uint32_t irq_qtrsec_us; /**< used to trigger IRQ quarter sec */
+    uint64_t mega2_cycles_1sec;   /**< 60 Hz tick that triggers the one sec IRQ */
+    uint64_t mega2_cycles_qtrsec; /**< 60 Hz tick that triggers the quarter sec IRQ */
+    uint32_t irq_1sec_us;         /**< overshoot of that tick past one sec */
+    uint32_t irq_qtrsec_us;       /**< overshoot of that tick past a quarter sec */
     uint32_t flags;         /**< interrupt  */
     uint32_t irq_line;      /**< IRQ flags passed to machine */
 };
@@ -253,6 +339,8 @@ struct ClemensVGC {
     /* Used for precise-ish timing of vertical blank and scanline irqs */
     clem_clocks_time_t ts_last_frame;
     clem_clocks_time_t ts_scanline_0;
+    clem_clocks_time_t ts_scanline_dt; /**< when dt_scanline was last updated */
+    clem_clocks_time_t ts_next_event;  /**< next scanline, VBL or frame edge */
     clem_clocks_duration_t dt_scanline;
     unsigned vbl_counter;
 
@@ -364,6 +452,17 @@ enum ClemensMMIOStateType {
     kClemensMMIOStateType_Active
 };
 
+/**
+ * @brief Bank 00, 01, E0 and E1 page maps for one memory switch setting
+ *
+ */
+struct ClemensMMIOPageMapSet {
+    struct ClemensMemoryPageMap fpi_main_page_map;
+    struct ClemensMemoryPageMap fpi_aux_page_map;
+    struct ClemensMemoryPageMap mega2_main_page_map;
+    struct ClemensMemoryPageMap mega2_aux_page_map;
+};
+
 /**
  * @brief FPI + MEGA2 MMIO Interface
  *
@@ -381,12 +480,18 @@ typedef struct ClemensMMIO {
     struct ClemensMemoryPageMap **bank_page_map;
     /* The different page mapping types */
     struct ClemensMemoryPageMap fpi_direct_page_map;
-    struct ClemensMemoryPageMap fpi_main_page_map;
-    struct ClemensMemoryPageMap fpi_aux_page_map;
     struct ClemensMemoryPageMap fpi_rom_page_map;
-    struct ClemensMemoryPageMap mega2_main_page_map;
-    struct ClemensMemoryPageMap mega2_aux_page_map;
     struct ClemensMemoryPageMap empty_page_map;
+    /* Bank 00, 01, E0, E1 maps are built once for each switch setting (see
+       CLEM_MEM_IO_MMAP_PAGE_MAP_MASK) and kept, so that a soft switch flip back
+       to a recent setting only swaps the bank page map pointers.  The least
+       recently used set is rebuilt when all are taken. */
+    struct ClemensMMIOPageMapSet page_map_sets[CLEM_MMIO_PAGE_MAP_SET_LIMIT];
+    uint32_t page_map_set_flags[CLEM_MMIO_PAGE_MAP_SET_LIMIT];
+    uint32_t page_map_set_used[CLEM_MMIO_PAGE_MAP_SET_LIMIT];
+    uint32_t page_map_set_clock;
+    unsigned page_map_set_count;
+    unsigned page_map_set_index; /* the set in use */
 
     /* Shadow maps for bank 00, 01 */
     struct ClemensMemoryShadowMap fpi_mega2_main_shadow_map;
@@ -415,7 +520,7 @@ typedef struct ClemensMMIO {
 
     clem_clocks_duration_t clocks_step_mega2;
     uint64_t mega2_cycles;            // number of mega2 pulses/ticks since startup
-    uint32_t timer_60hz_us;           // used for executing logic per 1/60th second
+    uint64_t mega2_cycles_60hz;       // mega2 cycle of the next 1/60th second tick
     int32_t card_expansion_rom_index; // card slot has the mutex on C800-CFFF
 
     /* All ticks are mega2 cycles */
@@ -3,47 +3,491 @@
 #include "clem_mmio_defs.h"
 #include "clem_mmio_types.h"
 
-#define CLEM_SCC_STATE_REGISTER_WAIT     0
-#define CLEM_SCC_STATE_REGISTER_SELECTED 1
+#include <string.h>
 
-void clem_scc_reset(struct ClemensDeviceSCC *scc) {}
+/*  Zilog Z8530 SCC - asynchronous mode only
+ *
+ *  Characters are timed, not bits.  When the guest writes a byte, the
+ *  transmitter computes when the whole character (start, data, parity and stop
+ *  bits) will have left the shifter from the baud rate generator settings, and
+ *  the byte is handed to the host queue at that time.  Received bytes are
+ *  paced the same way from the host queue into the 3 byte receive FIFO.
+ *
+ *  The device tracks the earliest of these completion times.  Until then the
+ *  per-instruction sync is a single compare, so idle channels cost nothing.
+ *
+ *  Not emulated: synchronous/SDLC modes, the DPLL, CRC, break detection and the
+ *  interrupt daisy chain (IUS) - 'reset highest IUS' is accepted and ignored.
+ */
+
+#define CLEM_SCC_IP_EXT 0x01
+#define CLEM_SCC_IP_TX  0x02
+#define CLEM_SCC_IP_RX  0x04
+
+/* indexed by the WR3/WR5 bits per character field */
+static const unsigned s_scc_bits_per_char[4] = {5, 7, 6, 8};
+/* indexed by the WR4 clock mode field */
+static const unsigned s_scc_clock_mode[4] = {1, 16, 32, 64};
+/* indexed by the WR4 stop bits field, in half bits */
+static const unsigned s_scc_stop_half_bits[4] = {2, 2, 3, 4};
+
+static unsigned _clem_scc_queue_count(const struct ClemensSCCHostQueue *queue) {
+    return queue->tail - queue->head;
+}
+
+static clem_clocks_time_t _clem_scc_calc_char_clocks(struct ClemensDeviceSCC *scc,
+                                                     struct ClemensSCCChannel *ch,
+                                                     unsigned data_bits, bool use_brg) {
+    uint64_t clocks_per_second = (uint64_t)scc->clocks_step_mega2 * CLEM_MEGA2_CYCLES_PER_SECOND;
+    unsigned mode = s_scc_clock_mode[(ch->wr[4] & CLEM_SCC_WR4_CLOCK_MODE_MASK) >> 6];
+    unsigned half_bits = 2 * (1 + data_bits + (ch->wr[4] & CLEM_SCC_WR4_PARITY_ENABLE)) +
+                         s_scc_stop_half_bits[(ch->wr[4] & CLEM_SCC_WR4_STOP_BITS_MASK) >> 2];
+    uint64_t source_hz, divisor;
+
+    if (use_brg) {
+        if (!(ch->wr[14] & CLEM_SCC_WR14_BRG_ENABLE))
+            return 0;
+        source_hz = (ch->wr[14] & CLEM_SCC_WR14_BRG_PCLK) ? CLEM_SCC_PCLK_HZ : CLEM_SCC_RTXC_HZ;
+        divisor = 2 * (((unsigned)ch->wr[13] << 8 | ch->wr[12]) + 2) * (uint64_t)mode;
+    } else {
+        /* RTxC and TRxC pins are both treated as the crystal */
+        source_hz = CLEM_SCC_RTXC_HZ;
+        divisor = mode;
+    }
+    return (clocks_per_second * divisor * half_bits) / (2 * source_hz);
+}
+
+static void _clem_scc_update_timing(struct ClemensDeviceSCC *scc, struct ClemensSCCChannel *ch) {
+    ch->dt_tx_char = _clem_scc_calc_char_clocks(
+        scc, ch, s_scc_bits_per_char[(ch->wr[5] & CLEM_SCC_WR5_TX_BITS_MASK) >> 5],
+        (ch->wr[11] & CLEM_SCC_WR11_TX_CLOCK_MASK) == CLEM_SCC_WR11_TX_CLOCK_BRG);
+    ch->dt_rx_char = _clem_scc_calc_char_clocks(
+        scc, ch, s_scc_bits_per_char[(ch->wr[3] & CLEM_SCC_WR3_RX_BITS_MASK) >> 6],
+        (ch->wr[11] & CLEM_SCC_WR11_RX_CLOCK_MASK) == CLEM_SCC_WR11_RX_CLOCK_BRG);
+}
+
+static void _clem_scc_update(struct ClemensDeviceSCC *scc) {
+    clem_clocks_time_t ts_next = CLEM_TIME_UNINITIALIZED;
+    unsigned i;
+    uint8_t ip = 0;
+    for (i = 0; i < 2; ++i) {
+        struct ClemensSCCChannel *ch = &scc->channel[i];
+        if (ch->tx_shifting && ch->ts_tx_done < ts_next)
+            ts_next = ch->ts_tx_done;
+        if (ch->rx_receiving && ch->ts_rx_done < ts_next)
+            ts_next = ch->ts_rx_done;
+        ip |= ch->ip;
+    }
+    scc->ts_next_event = ts_next;
+    scc->irq_line = ((scc->wr9 & CLEM_SCC_WR9_MIE) && ip) ? CLEM_IRQ_SCC : 0;
+}
+
+static void _clem_scc_tx_start(struct ClemensSCCChannel *ch, clem_clocks_time_t ts) {
+    unsigned data_bits;
+    if (!ch->tx_buffer_full || ch->tx_shifting)
+        return;
+    if (!(ch->wr[5] & CLEM_SCC_WR5_TX_ENABLE) || ch->dt_tx_char == 0)
+        return;
+    if ((ch->wr[3] & CLEM_SCC_WR3_AUTO_ENABLES) && !ch->host_connected)
+        return;
+    data_bits = s_scc_bits_per_char[(ch->wr[5] & CLEM_SCC_WR5_TX_BITS_MASK) >> 5];
+    ch->tx_shift = ch->tx_buffer & (uint8_t)((1u << data_bits) - 1);
+    ch->tx_buffer_full = false;
+    ch->tx_shifting = true;
+    ch->ts_tx_done = ts + ch->dt_tx_char;
+    if (ch->wr[1] & CLEM_SCC_WR1_TX_IE) {
+        ch->ip |= CLEM_SCC_IP_TX;
+    }
+}
+
+static void _clem_scc_rx_start(struct ClemensSCCChannel *ch, clem_clocks_time_t ts) {
+    if (ch->rx_receiving || !_clem_scc_queue_count(&ch->from_host))
+        return;
+    if (!(ch->wr[3] & CLEM_SCC_WR3_RX_ENABLE) || ch->dt_rx_char == 0)
+        return;
+    ch->rx_receiving = true;
+    ch->ts_rx_done = ts + ch->dt_rx_char;
+}
+
+static void _clem_scc_rx_push(struct ClemensSCCChannel *ch, uint8_t value) {
+    uint8_t rx_ie = ch->wr[1] & CLEM_SCC_WR1_RX_IE_MASK;
+    unsigned data_bits;
+    if (!(ch->wr[3] & CLEM_SCC_WR3_RX_ENABLE))
+        return;
+    data_bits = s_scc_bits_per_char[(ch->wr[3] & CLEM_SCC_WR3_RX_BITS_MASK) >> 6];
+    value &= (uint8_t)((1u << data_bits) - 1);
+    if (ch->rx_fifo_count == CLEM_SCC_RX_FIFO_SIZE) {
+        /* the newest character overwrites the last FIFO entry */
+        ch->rx_fifo[CLEM_SCC_RX_FIFO_SIZE - 1] = value;
+        ch->rr1 |= CLEM_SCC_RR1_RX_OVERRUN;
+        if (rx_ie) {
+            ch->ip |= CLEM_SCC_IP_RX;
+        }
+        return;
+    }
+    ch->rx_fifo[ch->rx_fifo_count++] = value;
+    if (rx_ie == CLEM_SCC_WR1_RX_IE_ALL) {
+        ch->ip |= CLEM_SCC_IP_RX;
+    } else if (rx_ie == CLEM_SCC_WR1_RX_IE_FIRST && ch->rx_int_next) {
+        ch->ip |= CLEM_SCC_IP_RX;
+        ch->rx_int_next = false;
+    }
+}
+
+/* returns false if the host queue is full, which holds the character in the
+   shifter until the host drains the queue */
+static bool _clem_scc_tx_complete(struct ClemensSCCChannel *ch) {
+    struct ClemensSCCHostQueue *queue = &ch->to_host;
+    if (ch->wr[14] & CLEM_SCC_WR14_LOCAL_LOOPBACK) {
+        _clem_scc_rx_push(ch, ch->tx_shift);
+        return true;
+    }
+    if (_clem_scc_queue_count(queue) >= CLEM_SCC_HOST_QUEUE_SIZE)
+        return false;
+    queue->data[queue->tail++ & (CLEM_SCC_HOST_QUEUE_SIZE - 1)] = ch->tx_shift;
+    return true;
+}
+
+static void _clem_scc_channel_sync(struct ClemensSCCChannel *ch, clem_clocks_time_t ts) {
+    struct ClemensSCCHostQueue *queue = &ch->from_host;
+    while (ch->tx_shifting && ts >= ch->ts_tx_done) {
+        if (!_clem_scc_tx_complete(ch))
+            break;
+        ch->tx_shifting = false;
+        _clem_scc_tx_start(ch, ch->ts_tx_done);
+    }
+    while (ch->rx_receiving && ts >= ch->ts_rx_done) {
+        _clem_scc_rx_push(ch, queue->data[queue->head++ & (CLEM_SCC_HOST_QUEUE_SIZE - 1)]);
+        ch->rx_receiving = false;
+        _clem_scc_rx_start(ch, ch->ts_rx_done);
+    }
+}
+
+static void _clem_scc_channel_reset(struct ClemensDeviceSCC *scc, struct ClemensSCCChannel *ch,
+                                    bool hardware) {
+    /* values per the Z8530 reset table - the host queues and connection
+       survive a reset */
+    ch->wr[0] = 0x00;
+    ch->wr[1] &= 0x24;
+    ch->wr[3] &= 0xfe;
+    ch->wr[4] |= 0x04;
+    ch->wr[5] &= 0x61;
+    ch->wr[10] &= 0x60;
+    ch->wr[14] = (ch->wr[14] & 0xc3) | 0x20;
+    ch->wr[15] = 0xf8;
+    if (hardware) {
+        ch->wr[10] = 0x00;
+        ch->wr[11] = 0x08;
+        ch->wr[14] = (ch->wr[14] & 0xc0) | 0x20;
+    }
+    ch->rr0 = CLEM_SCC_RR0_TX_UNDERRUN;
+    ch->rr1 = 0x06;
+    ch->ip = 0;
+    ch->tx_buffer_full = false;
+    ch->tx_shifting = false;
+    ch->rx_int_next = false;
+    ch->rx_receiving = false;
+    ch->rx_fifo_count = 0;
+    _clem_scc_update_timing(scc, ch);
+}
+
+static void _clem_scc_ext_status_change(struct ClemensSCCChannel *ch, uint8_t changed_rr0) {
+    uint8_t enabled = 0;
+    if (!(ch->wr[1] & CLEM_SCC_WR1_EXT_IE))
+        return;
+    if (ch->wr[15] & CLEM_SCC_WR15_DCD_IE)
+        enabled |= CLEM_SCC_RR0_DCD;
+    if (ch->wr[15] & CLEM_SCC_WR15_CTS_IE)
+        enabled |= CLEM_SCC_RR0_CTS;
+    if (changed_rr0 & enabled) {
+        ch->ip |= CLEM_SCC_IP_EXT;
+    }
+}
+
+static uint8_t _clem_scc_read_rr0(struct ClemensSCCChannel *ch) {
+    uint8_t value = ch->rr0;
+    if (ch->rx_fifo_count > 0)
+        value |= CLEM_SCC_RR0_RX_AVAIL;
+    if (!ch->tx_buffer_full)
+        value |= CLEM_SCC_RR0_TX_EMPTY;
+    if (ch->host_connected)
+        value |= CLEM_SCC_RR0_DCD | CLEM_SCC_RR0_CTS;
+    return value;
+}
+
+static uint8_t _clem_scc_modified_vector(struct ClemensDeviceSCC *scc) {
+    uint8_t ip_a = scc->channel[CLEM_SCC_CHANNEL_A].ip;
+    uint8_t ip_b = scc->channel[CLEM_SCC_CHANNEL_B].ip;
+    uint8_t code;
+    /* in priority order - the special receive condition codes (3, 7) are
+       reported as 'no interrupt' and 'channel A receive' */
+    if (ip_a & CLEM_SCC_IP_RX)
+        code = 6;
+    else if (ip_a & CLEM_SCC_IP_TX)
+        code = 4;
+    else if (ip_a & CLEM_SCC_IP_EXT)
+        code = 5;
+    else if (ip_b & CLEM_SCC_IP_RX)
+        code = 2;
+    else if (ip_b & CLEM_SCC_IP_TX)
+        code = 0;
+    else if (ip_b & CLEM_SCC_IP_EXT)
+        code = 1;
+    else
+        code = 3;
+    if (scc->wr9 & CLEM_SCC_WR9_STATUS_HIGH) {
+        code = ((code & 1) << 2) | (code & 2) | ((code & 4) >> 2);
+        return (scc->wr2 & 0x8f) | (code << 4);
+    }
+    return (scc->wr2 & 0xf1) | (code << 1);
+}
+
+static uint8_t _clem_scc_read_data(struct ClemensSCCChannel *ch, bool is_noop) {
+    uint8_t value = ch->rx_fifo[0];
+    if (is_noop || ch->rx_fifo_count == 0)
+        return value;
+    --ch->rx_fifo_count;
+    memmove(&ch->rx_fifo[0], &ch->rx_fifo[1], ch->rx_fifo_count);
+    if (ch->rx_fifo_count == 0) {
+        ch->ip &= ~CLEM_SCC_IP_RX;
+    }
+    return value;
+}
+
+static void _clem_scc_write_data(struct ClemensDeviceSCC *scc, struct ClemensSCCChannel *ch,
+                                 uint8_t value) {
+    /* overwrites a byte still waiting in the buffer, as on hardware */
+    ch->tx_buffer = value;
+    ch->tx_buffer_full = true;
+    ch->ip &= ~CLEM_SCC_IP_TX;
+    ch->rr0 &= ~CLEM_SCC_RR0_TX_UNDERRUN;
+    _clem_scc_tx_start(ch, scc->ts_last_frame);
+}
+
+static void _clem_scc_write_wr0(struct ClemensDeviceSCC *scc, unsigned ch_index, uint8_t value) {
+    struct ClemensSCCChannel *ch = &scc->channel[ch_index];
+    uint8_t cmd = value & CLEM_SCC_WR0_CMD_MASK;
+    scc->selected_reg[ch_index] = value & CLEM_SCC_WR0_REG_MASK;
+    switch (cmd) {
+    case CLEM_SCC_WR0_CMD_POINT_HIGH:
+        scc->selected_reg[ch_index] |= 0x08;
+        break;
+    case CLEM_SCC_WR0_CMD_RESET_EXT:
+        ch->ip &= ~CLEM_SCC_IP_EXT;
+        break;
+    case CLEM_SCC_WR0_CMD_RX_INT_NEXT:
+        ch->rx_int_next = true;
+        break;
+    case CLEM_SCC_WR0_CMD_RESET_TX_IP:
+        ch->ip &= ~CLEM_SCC_IP_TX;
+        break;
+    case CLEM_SCC_WR0_CMD_RESET_ERROR:
+        ch->rr1 &= ~CLEM_SCC_RR1_RX_OVERRUN;
+        if (!ch->rx_fifo_count) {
+            ch->ip &= ~CLEM_SCC_IP_RX;
+        }
+        break;
+    case CLEM_SCC_WR0_CMD_RESET_IUS:
+        break;
+    }
+}
+
+static void _clem_scc_write_reg(struct ClemensDeviceSCC *scc, unsigned ch_index, unsigned reg,
+                                uint8_t value) {
+    struct ClemensSCCChannel *ch = &scc->channel[ch_index];
+    switch (reg) {
+    case 0:
+        _clem_scc_write_wr0(scc, ch_index, value);
+        break;
+    case 2:
+        scc->wr2 = value;
+        break;
+    case 8:
+        _clem_scc_write_data(scc, ch, value);
+        break;
+    case 9:
+        switch (value & CLEM_SCC_WR9_RESET_MASK) {
+        case CLEM_SCC_WR9_RESET_A:
+            _clem_scc_channel_reset(scc, &scc->channel[CLEM_SCC_CHANNEL_A], false);
+            break;
+        case CLEM_SCC_WR9_RESET_B:
+            _clem_scc_channel_reset(scc, &scc->channel[CLEM_SCC_CHANNEL_B], false);
+            break;
+        case CLEM_SCC_WR9_RESET_HW:
+            _clem_scc_channel_reset(scc, &scc->channel[CLEM_SCC_CHANNEL_A], true);
+            _clem_scc_channel_reset(scc, &scc->channel[CLEM_SCC_CHANNEL_B], true);
+            value = scc->wr9 & (CLEM_SCC_WR9_VIS | CLEM_SCC_WR9_NV);
+            break;
+        }
+        scc->wr9 = value & ~CLEM_SCC_WR9_RESET_MASK;
+        break;
+    case 1:
+    case 10:
+    case 15:
+        ch->wr[reg] = value;
+        break;
+    default:
+        /* framing, clock and enable registers */
+        ch->wr[reg] = value;
+        _clem_scc_update_timing(scc, ch);
+        _clem_scc_tx_start(ch, scc->ts_last_frame);
+        _clem_scc_rx_start(ch, scc->ts_last_frame);
+        break;
+    }
+}
+
+static uint8_t _clem_scc_read_reg(struct ClemensDeviceSCC *scc, unsigned ch_index, unsigned reg,
+                                  bool is_noop) {
+    struct ClemensSCCChannel *ch = &scc->channel[ch_index];
+    uint8_t value = 0;
+    switch (reg) {
+    case 0:
+    case 4:
+        value = _clem_scc_read_rr0(ch);
+        break;
+    case 1:
+    case 5:
+        value = ch->rr1;
+        if (!ch->tx_buffer_full && !ch->tx_shifting) {
+            value |= CLEM_SCC_RR1_ALL_SENT;
+        }
+        break;
+    case 2:
+    case 6:
+        value = (ch_index == CLEM_SCC_CHANNEL_A) ? scc->wr2 : _clem_scc_modified_vector(scc);
+        break;
+    case 3:
+    case 7:
+        if (ch_index == CLEM_SCC_CHANNEL_A) {
+            value = (scc->channel[CLEM_SCC_CHANNEL_A].ip << 3) |
+                    scc->channel[CLEM_SCC_CHANNEL_B].ip;
+        }
+        break;
+    case 8:
+        value = _clem_scc_read_data(ch, is_noop);
+        break;
+    case 12:
+        value = ch->wr[12];
+        break;
+    case 9:
+    case 13:
+        value = ch->wr[13];
+        break;
+    case 11:
+    case 15:
+        value = ch->wr[15];
+        break;
+    }
+    return value;
+}
+
+void clem_scc_reset(struct ClemensDeviceSCC *scc, clem_clocks_duration_t mega2_clocks_step) {
+    scc->clocks_step_mega2 = mega2_clocks_step;
+    scc->selected_reg[0] = 0;
+    scc->selected_reg[1] = 0;
+    _clem_scc_channel_reset(scc, &scc->channel[CLEM_SCC_CHANNEL_A], true);
+    _clem_scc_channel_reset(scc, &scc->channel[CLEM_SCC_CHANNEL_B], true);
+    scc->wr9 &= (CLEM_SCC_WR9_VIS | CLEM_SCC_WR9_NV);
+    _clem_scc_update(scc);
+}
 
 void clem_scc_glu_sync(struct ClemensDeviceSCC *scc, struct ClemensClock *clock) {
     scc->ts_last_frame = clock->ts;
+    if (clock->ts < scc->ts_next_event)
+        return;
+    _clem_scc_channel_sync(&scc->channel[CLEM_SCC_CHANNEL_A], clock->ts);
+    _clem_scc_channel_sync(&scc->channel[CLEM_SCC_CHANNEL_B], clock->ts);
+    _clem_scc_update(scc);
 }
 
 void clem_scc_write_switch(struct ClemensDeviceSCC *scc, uint8_t ioreg, uint8_t value) {
+    unsigned ch_index;
+    unsigned reg;
 
     switch (ioreg) {
     case CLEM_MMIO_REG_SCC_B_CMD:
     case CLEM_MMIO_REG_SCC_A_CMD:
+        ch_index = CLEM_MMIO_REG_SCC_A_CMD - ioreg;
+        reg = scc->selected_reg[ch_index];
+        scc->selected_reg[ch_index] = 0;
+        _clem_scc_write_reg(scc, ch_index, reg, value);
         break;
     case CLEM_MMIO_REG_SCC_B_DATA:
     case CLEM_MMIO_REG_SCC_A_DATA:
-        if (scc->state == CLEM_SCC_STATE_REGISTER_WAIT) {
-            scc->selected_reg[CLEM_MMIO_REG_SCC_A_DATA - ioreg] = value;
-            scc->state = CLEM_SCC_STATE_REGISTER_SELECTED;
-        } else {
-            scc->state = CLEM_SCC_STATE_REGISTER_WAIT;
-        }
+        ch_index = CLEM_MMIO_REG_SCC_A_DATA - ioreg;
+        _clem_scc_write_data(scc, &scc->channel[ch_index], value);
         break;
     }
+    _clem_scc_update(scc);
     // CLEM_LOG("clem_scc: %02X <- %02X", ioreg, value);
 }
 
 uint8_t clem_scc_read_switch(struct ClemensDeviceSCC *scc, uint8_t ioreg, uint8_t flags) {
     uint8_t value = 0;
     bool is_noop = (flags & CLEM_OP_IO_NO_OP) != 0;
+    unsigned ch_index;
+    unsigned reg;
+
     switch (ioreg) {
     case CLEM_MMIO_REG_SCC_B_CMD:
     case CLEM_MMIO_REG_SCC_A_CMD:
+        ch_index = CLEM_MMIO_REG_SCC_A_CMD - ioreg;
+        reg = scc->selected_reg[ch_index];
+        if (!is_noop) {
+            scc->selected_reg[ch_index] = 0;
+        }
+        value = _clem_scc_read_reg(scc, ch_index, reg, is_noop);
         break;
     case CLEM_MMIO_REG_SCC_B_DATA:
     case CLEM_MMIO_REG_SCC_A_DATA:
+        ch_index = CLEM_MMIO_REG_SCC_A_DATA - ioreg;
+        value = _clem_scc_read_data(&scc->channel[ch_index], is_noop);
         break;
     }
+    if (!is_noop) {
+        _clem_scc_update(scc);
+    }
     // if (!is_noop) {
     //     CLEM_LOG("clem_scc: %02X -> %02X", ioreg, value);
     // }
     return value;
 }
+
+unsigned clem_scc_host_drain(struct ClemensDeviceSCC *scc, unsigned ch_index, uint8_t *data,
+                             unsigned limit) {
+    struct ClemensSCCHostQueue *queue = &scc->channel[ch_index].to_host;
+    unsigned count = _clem_scc_queue_count(queue);
+    unsigned i;
+    if (count > limit)
+        count = limit;
+    for (i = 0; i < count; ++i) {
+        data[i] = queue->data[queue->head++ & (CLEM_SCC_HOST_QUEUE_SIZE - 1)];
+    }
+    return count;
+}
+
+unsigned clem_scc_host_feed(struct ClemensDeviceSCC *scc, unsigned ch_index, const uint8_t *data,
+                            unsigned count) {
+    struct ClemensSCCChannel *ch = &scc->channel[ch_index];
+    struct ClemensSCCHostQueue *queue = &ch->from_host;
+    unsigned available = CLEM_SCC_HOST_QUEUE_SIZE - _clem_scc_queue_count(queue);
+    unsigned i;
+    if (count > available)
+        count = available;
+    for (i = 0; i < count; ++i) {
+        queue->data[queue->tail++ & (CLEM_SCC_HOST_QUEUE_SIZE - 1)] = data[i];
+    }
+    _clem_scc_rx_start(ch, scc->ts_last_frame);
+    _clem_scc_update(scc);
+    return count;
+}
+
+void clem_scc_host_connect(struct ClemensDeviceSCC *scc, unsigned ch_index, bool connected) {
+    struct ClemensSCCChannel *ch = &scc->channel[ch_index];
+    if (ch->host_connected == connected)
+        return;
+    ch->host_connected = connected;
+    _clem_scc_ext_status_change(ch, CLEM_SCC_RR0_DCD | CLEM_SCC_RR0_CTS);
+    _clem_scc_tx_start(ch, scc->ts_last_frame);
+    _clem_scc_update(scc);
+}
@@ -68,15 +68,79 @@ struct ClemensClock {
 #define clem_calc_secs_from_clocks(_clock_)                                                        \
     ((CLEM_MEGA2_CYCLE_NS * (uint64_t)((_clock_)->ts / (_clock_)->ref_step)) * 1.0e-9)
 
+/* Converting between the clocks timebase and nanoseconds happens on every
+   emulated instruction (VGC, IWM and MMIO syncs.)  A 64-bit divide by a
+   runtime reference step is one of the most expensive instructions on that
+   path.  A machine only ever steps at CLEM_CLOCKS_FAST_CYCLE or
+   CLEM_CLOCKS_MEGA2_CYCLE (clocks_step switches between the two, and
+   ref_step is one or the other), so their reciprocals are precomputed here
+   and dividing becomes a multiply, a shift and at most one correction.  This
+   is exact for any dividend below 2^32 clocks (over a second of emulated time,
+   well beyond the sub-second intervals these are used for.)  Larger values,
+   and steps a ClemensClock was never given by the machine, fall back to a
+   divide.
+*/
+
+/** floor(2^32 / step), or 0 for a step without a precomputed reciprocal */
+static inline uint64_t clem_calc_clocks_step_reciprocal(clem_clocks_duration_t step) {
+    switch (step) {
+    case CLEM_CLOCKS_MEGA2_CYCLE:
+        return 0x100000000ULL / CLEM_CLOCKS_MEGA2_CYCLE;
+    case CLEM_CLOCKS_FAST_CYCLE:
+        return 0x100000000ULL / CLEM_CLOCKS_FAST_CYCLE;
+    }
+    return 0;
+}
+
+/** floor(value / step) using the step's reciprocal.  value * reciprocal can
+ *  undershoot the quotient by one, never more, for value < 2^32. */
+static inline uint64_t clem_calc_div_step_reciprocal(uint64_t value, clem_clocks_duration_t step,
+                                                     uint64_t reciprocal) {
+    uint64_t quotient;
+    if (!reciprocal || (value >> 32)) {
+        return value / step;
+    }
+    quotient = (value * reciprocal) >> 32;
+    if (value - quotient * step >= step) {
+        ++quotient;
+    }
+    return quotient;
+}
+
+/** floor(clocks / step) */
+static inline uint64_t clem_calc_clocks_div_step(uint64_t clocks, clem_clocks_duration_t step) {
+    return clem_calc_div_step_reciprocal(clocks, step, clem_calc_clocks_step_reciprocal(step));
+}
+
+/** floor(CLEM_MEGA2_CYCLE_NS * clocks / step)
+ *
+ *  Split as NS * (clocks / step) + NS * (clocks % step) / step so that both
+ *  divides stay within the reciprocal's range.
+ */
+static inline uint32_t clem_calc_ns_from_clocks_step(uint64_t clocks,
+                                                     clem_clocks_duration_t step) {
+    uint64_t reciprocal = clem_calc_clocks_step_reciprocal(step);
+    uint64_t cycles, remainder;
+    if (!reciprocal || (clocks >> 32)) {
+        return (uint32_t)(CLEM_MEGA2_CYCLE_NS * clocks / step);
+    }
+    cycles = clem_calc_div_step_reciprocal(clocks, step, reciprocal);
+    remainder = clocks - cycles * step;
+    return (uint32_t)(CLEM_MEGA2_CYCLE_NS * cycles +
+                      clem_calc_div_step_reciprocal(CLEM_MEGA2_CYCLE_NS * remainder, step,
+                                                    reciprocal));
+}
+
 /* BEWARE - these macros act on sub second time intervals (per frame deltas.)
    Do not use these utilities to calculate values over long time intervals
 */
 /** _clocks_step_ and _clocks_step_reference_ is of type clem_clocks_duration_t
  */
 #define clem_calc_ns_step_from_clocks(_clocks_step_, _clocks_step_reference_)                      \
-    ((uint32_t)(CLEM_MEGA2_CYCLE_NS * (uint64_t)(_clocks_step_) / (_clocks_step_reference_)))
+    clem_calc_ns_from_clocks_step((uint64_t)(_clocks_step_), (_clocks_step_reference_))
 
-/** _ns_ is of type uint64_t */
+/** _ns_ is of type uint64_t.  The divisor is a compile time constant, which
+ *  compilers reduce to a multiply. */
 #define clem_calc_clocks_step_from_ns(_ns_, _clocks_step_reference_)                               \
     ((clem_clocks_duration_t)((_ns_) * (_clocks_step_reference_)) / CLEM_MEGA2_CYCLE_NS)
 
@@ -248,6 +248,9 @@ static unsigned _clem_smartport_handle_packet(struct ClemensSmartPortUnit *unit,
                                               unsigned delta_ns) {
     //  Parse the decoded packet based on the packet type (For commands, obtain the command type
     //  and parameter count, for example)
+    //  Returning the current (executing) state keeps ACK low so that the command
+    //  is retried on the next bus cycle, which is how devices report that they
+    //  are still busy with CLEM_SMARTPORT_STATUS_CODE_WAIT.
     unsigned next_state = unit->packet_state;
     unsigned u32;
     uint8_t call_status;
@@ -275,6 +278,8 @@ static unsigned _clem_smartport_handle_packet(struct ClemensSmartPortUnit *unit,
             } else {
                 call_status = CLEM_SMARTPORT_STATUS_CODE_BAD_CTL;
             }
+            if (call_status == CLEM_SMARTPORT_STATUS_CODE_WAIT)
+                break;
             unit->packet.type = kClemensSmartPortPacketType_Status;
             next_state = _clem_smartport_packet_encode_response(unit, unit->packet.source_unit_id,
                                                                 call_status);
@@ -289,6 +294,9 @@ static unsigned _clem_smartport_handle_packet(struct ClemensSmartPortUnit *unit,
             } else {
                 call_status = CLEM_SMARTPORT_STATUS_CODE_OFFLINE;
             }
+            /* the block isn't available yet - poll again on the next bus cycle */
+            if (call_status == CLEM_SMARTPORT_STATUS_CODE_WAIT)
+                break;
             if (call_status == CLEM_SMARTPORT_STATUS_CODE_OK) {
                 unit->packet.type = kClemensSmartPortPacketType_Data;
             } else {
@@ -315,6 +323,8 @@ static unsigned _clem_smartport_handle_packet(struct ClemensSmartPortUnit *unit,
             } else {
                 call_status = CLEM_SMARTPORT_STATUS_CODE_OK;
             }
+            if (call_status == CLEM_SMARTPORT_STATUS_CODE_WAIT)
+                break;
             next_state = _clem_smartport_packet_encode_response(unit, unit->packet.source_unit_id,
                                                                 call_status);
             break;
@@ -334,6 +344,8 @@ static unsigned _clem_smartport_handle_packet(struct ClemensSmartPortUnit *unit,
             } else {
                 call_status = CLEM_SMARTPORT_STATUS_CODE_OFFLINE;
             }
+            if (call_status == CLEM_SMARTPORT_STATUS_CODE_WAIT)
+                break;
             unit->packet.type = kClemensSmartPortPacketType_Status;
             next_state = _clem_smartport_packet_encode_response(unit, unit->packet.source_unit_id,
                                                                 call_status);
@@ -498,11 +510,9 @@ static unsigned _clem_smartport_bus_handshake(struct ClemensSmartPortUnit *unit,
             } else if (unit->unit_id && unit->packet.dest_unit_id == unit->unit_id) {
                 _clem_smartport_packet_state(unit, CLEM_SMARTPORT_UNIT_STATE_EXECUTING);
             } else {
-                //  TODO: implement logic to ignore the remaining command as this state
-                //        change will still result in reading packet data.  Fortunately
-                //        we only support one device on this bus, so it won't matter...
-                //        YET
-                //  unit->packet_ours = false;
+                //  Not for this unit - any data packet that follows (i.e. for
+                //  WriteBlock) is parsed and dropped the same way since it also
+                //  carries the destination unit ID.
                 _clem_smartport_packet_state(unit, CLEM_SMARTPORT_UNIT_STATE_READY);
             }
         } else {
@@ -546,7 +556,7 @@ bool clem_smartport_bus(struct ClemensSmartPortUnit *unit, unsigned unit_count,
     unsigned select_bits = *out_phase;
     unsigned bus_state = 0;
     bool is_bus_enabled = false;
-    bool is_ack_hi = false;
+    bool is_ack_hi = true;
 
     for (; unit < unit_end; unit++) {
         if (unit->device.device_id == 0)
@@ -587,9 +597,14 @@ bool clem_smartport_bus(struct ClemensSmartPortUnit *unit, unsigned unit_count,
             // received its ID from the hsot
             select_bits &= ~8;
         }
-        is_bus_enabled = unit->bus_enabled;
-        is_ack_hi = unit->ack_hi;
-        unit++;
+        if (unit->bus_enabled) {
+            //  ACK is shared by all residents, and the unit executing a command
+            //  holds it low while the others leave it high
+            is_bus_enabled = true;
+            if (!unit->ack_hi) {
+                is_ack_hi = false;
+            }
+        }
     }
 
     if (!is_bus_enabled) {
@@ -620,3 +635,10 @@ bool clem_smartport_bus(struct ClemensSmartPortUnit *unit, unsigned unit_count,
 
     return is_bus_enabled;
 }
+
+bool clem_smartport_unit_is_active(const struct ClemensSmartPortUnit *unit) {
+    //  units go back to ready (clearing the command) at the end of a packet
+    //  that isn't theirs, and after their response has been read
+    return unit->device.device_id != CLEM_SMARTPORT_DEVICE_ID_NONE && unit->bus_enabled &&
+           unit->command_id != 0xff;
+}
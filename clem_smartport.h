@@ -3,8 +3,9 @@
 
 #include <stdint.h>
 
-/** Number of drives supported at one time on the system */
-#define CLEM_SMARTPORT_DRIVE_LIMIT 1
+/** Number of drives supported at one time on the system.  Units are daisy
+ *  chained in this order, and the host assigns IDs to them in the same order. */
+#define CLEM_SMARTPORT_DRIVE_LIMIT 4
 
 /* SmartPort devices by ID */
 #define CLEM_SMARTPORT_DEVICE_ID_NONE         0
@@ -29,13 +30,15 @@
 /** Status codes returned from SmartPort calls - 0x7f is reserved for async wait
  *  by the SmartPort emulator for device implementations to return that the operation
  *  is imcomplete and to keep polling until its finished with one of the other
- *  result codes.
+ *  result codes.  The unit holds ACK low while waiting, as a real drive does
+ *  while it seeks.
  */
 #define CLEM_SMARTPORT_STATUS_CODE_OK            0x00
 #define CLEM_SMARTPORT_STATUS_CODE_BAD_CMD       0x01
 #define CLEM_SMARTPORT_STATUS_CODE_BUS_ERR       0x06
 #define CLEM_SMARTPORT_STATUS_CODE_BAD_CTL       0x21
 #define CLEM_SMARTPORT_STATUS_CODE_IO_ERR        0x27
+#define CLEM_SMARTPORT_STATUS_CODE_NO_WRITE      0x2B
 #define CLEM_SMARTPORT_STATUS_CODE_INVALID_BLOCK 0x2D
 #define CLEM_SMARTPORT_STATUS_CODE_OFFLINE       0x2f
 #define CLEM_SMARTPORT_STATUS_CODE_WAIT          0x7f
@@ -1,26 +1,47 @@
 #include "clem_device.h"
 #include "clem_mmio_defs.h"
 
+/* The 1 sec and quarter second timers count 60 Hz ticks against periods that
+   are not a multiple of a tick.  Rather than accumulating every tick, the
+   timer computes which tick crosses the next period and the overshoot carried
+   into the period after it, so a sync is a single compare per source.
+*/
+
+static uint64_t _clem_timer_schedule(uint64_t mega2_cycles, uint32_t *overshoot,
+                                     uint32_t period) {
+    uint32_t ticks = (period - *overshoot + CLEM_MEGA2_CYCLES_PER_60TH - 1) /
+                     CLEM_MEGA2_CYCLES_PER_60TH;
+    *overshoot = *overshoot + ticks * CLEM_MEGA2_CYCLES_PER_60TH - period;
+    return mega2_cycles + (uint64_t)ticks * CLEM_MEGA2_CYCLES_PER_60TH;
+}
 
 void clem_timer_reset(struct ClemensDeviceTimer* timer) {
     timer->flags = 0;
 }
 
+void clem_timer_start(struct ClemensDeviceTimer *timer, uint64_t mega2_cycles) {
+    timer->irq_1sec_us = 0;
+    timer->irq_qtrsec_us = 0;
+    timer->mega2_cycles_1sec = _clem_timer_schedule(mega2_cycles, &timer->irq_1sec_us,
+                                                    CLEM_MEGA2_TIMER_1SEC_US);
+    timer->mega2_cycles_qtrsec = _clem_timer_schedule(mega2_cycles, &timer->irq_qtrsec_us,
+                                                      CLEM_MEGA2_TIMER_QSEC_US);
+}
+
 void clem_timer_sync(
     struct ClemensDeviceTimer* timer,
-    uint32_t delta_us
+    uint64_t mega2_cycles
 ) {
-    timer->irq_1sec_us += delta_us;
-    timer->irq_qtrsec_us += delta_us;
-
-    while (timer->irq_1sec_us >= CLEM_MEGA2_TIMER_1SEC_US) {
-        timer->irq_1sec_us -= CLEM_MEGA2_TIMER_1SEC_US;
+    if (mega2_cycles >= timer->mega2_cycles_1sec) {
+        timer->mega2_cycles_1sec = _clem_timer_schedule(
+            timer->mega2_cycles_1sec, &timer->irq_1sec_us, CLEM_MEGA2_TIMER_1SEC_US);
         if (timer->flags & CLEM_MMIO_TIMER_1SEC_ENABLED) {
             timer->irq_line |= CLEM_IRQ_TIMER_RTC_1SEC;
         }
     }
-    while (timer->irq_qtrsec_us >= CLEM_MEGA2_TIMER_QSEC_US) {
-        timer->irq_qtrsec_us -= CLEM_MEGA2_TIMER_QSEC_US;
+    if (mega2_cycles >= timer->mega2_cycles_qtrsec) {
+        timer->mega2_cycles_qtrsec = _clem_timer_schedule(
+            timer->mega2_cycles_qtrsec, &timer->irq_qtrsec_us, CLEM_MEGA2_TIMER_QSEC_US);
         if (timer->flags & CLEM_MMIO_TIMER_QSEC_ENABLED) {
             timer->irq_line |= CLEM_IRQ_TIMER_QSEC;
         }
@@ -174,6 +174,34 @@ enum {
 
 typedef void (*ClemensOpcodeCallback)(struct ClemensInstruction *, const char *, void *);
 
+/* Optional memory access accounting supplied by the host.  Counts are kept
+   per logical bank and page ((bank << 8) | page) as accessed by the CPU, and
+   optionally per byte for a single selected bank.  Hosts decay these counts
+   periodically (see clemens_decay_memory_access_counters) so that they
+   reflect recent activity.
+*/
+struct ClemensMemoryAccessCounters {
+    uint32_t reads[CLEM_IIGS_PAGE_COUNT];
+    uint32_t writes[CLEM_IIGS_PAGE_COUNT];
+    uint32_t executes[CLEM_IIGS_PAGE_COUNT]; /* opcode fetches */
+    /* if not NULL, CLEM_IIGS_BANK_SIZE counts of all accesses within byte_bank */
+    uint32_t *bytes;
+    uint8_t byte_bank;
+};
+
+#define CLEM_MEM_WRITE_LOG_LIMIT 8
+
+/* Optional log of CPU writes supplied by the host, which clears it after
+   consuming the entries (i.e. per instruction from the opcode callback.)
+   count may exceed CLEM_MEM_WRITE_LOG_LIMIT, in which case only the first
+   writes are kept.
+*/
+struct ClemensMemoryWriteLog {
+    uint32_t addr[CLEM_MEM_WRITE_LOG_LIMIT]; /* (bank << 16) | address */
+    uint8_t data[CLEM_MEM_WRITE_LOG_LIMIT];
+    unsigned count;
+};
+
 struct ClemensMemory {
     /* each used bank MUST be 64K (65536) bytes */
     uint8_t *fpi_bank_map[256]; // $00 - $ff
@@ -194,6 +222,20 @@ struct ClemensMemory {
     uint8_t (*mmio_read)(struct ClemensMemory *, struct ClemensTimeSpec *, uint16_t /* addr */,
                          uint8_t /* flags*/, bool *);
     bool (*mmio_niolc)(struct ClemensMemory *);
+
+    /* Optional per page write stamps supplied by the host (CLEM_IIGS_PAGE_COUNT
+       entries indexed by physical bank and page.)  Writes to RAM stamp the
+       physical page (and its shadow) with write_generation so that debuggers
+       can detect which pages changed since they last looked.  NULL disables
+       tracking.
+    */
+    uint32_t *page_write_gen;
+    uint32_t write_generation;
+
+    /* Optional access counters (NULL disables accounting) */
+    struct ClemensMemoryAccessCounters *access_counters;
+    /* Optional write log (NULL disables logging) */
+    struct ClemensMemoryWriteLog *write_log;
 };
 
 struct ClemensDeviceDebugger {
@@ -202,6 +244,88 @@ struct ClemensDeviceDebugger {
     uint8_t pbr;
 };
 
+#define CLEM_DEBUG_LOG_ARG_LIMIT  6
+#define CLEM_DEBUG_LOG_TEXT_LIMIT 128
+
+/* A log message stored unformatted.  Messages from the core keep their
+   printf-style format string (which must be a string literal) and arguments,
+   with any %s arguments copied into text.  Host messages have a NULL fmt and
+   carry their formatted text.  See clemens_format_log_record().
+*/
+struct ClemensLogRecord {
+    clem_clocks_time_t clocks;
+    const char *fmt;
+    union {
+        int64_t i;
+        uint64_t u;
+        double f;
+        const void *p;
+    } args[CLEM_DEBUG_LOG_ARG_LIMIT];
+    uint8_t level;
+    uint8_t arg_count;
+    char text[CLEM_DEBUG_LOG_TEXT_LIMIT];
+};
+
+/* Optional log ring supplied by the host.  When attached, messages at or above
+   min_level are appended at head without formatting and consumed by the host
+   from tail; messages are dropped if the ring is full.  record_limit must be a
+   power of two.  Without a ring, messages are formatted and passed to the
+   logger callback.
+*/
+struct ClemensLogRing {
+    struct ClemensLogRecord *records;
+    unsigned record_limit;
+    unsigned head;
+    unsigned tail;
+    unsigned dropped;
+    int min_level;
+};
+
+#define CLEM_TOOLBOX_PARAM_LIMIT 16
+#define CLEM_TOOLBOX_CALL_DEPTH  16
+
+enum ClemensToolboxRecordType {
+    kClemensToolboxRecord_Call,  /* JSL to the tool dispatcher */
+    kClemensToolboxRecord_Return /* RTL back to the caller of a logged call */
+};
+
+struct ClemensToolboxRecord {
+    /* Call: clocks_spent at entry, Return: clocks spent inside the call */
+    clem_clocks_time_t clocks;
+    uint32_t caller;   /* (PBR << 16) | address of the JSL */
+    uint16_t call;     /* X register, (function << 8) | tool set */
+    uint16_t stack;    /* S prior to the JSL */
+    uint8_t type;      /* See enum ClemensToolboxRecordType */
+    uint8_t entry;     /* dispatcher entry offset ($00 or $04) */
+    uint8_t param_count;
+    uint8_t params[CLEM_TOOLBOX_PARAM_LIMIT]; /* from S + 1 at the call */
+};
+
+struct ClemensToolboxPendingCall {
+    clem_clocks_time_t clocks;
+    uint32_t return_addr; /* (PBR << 16) | address after the JSL */
+    uint16_t call;
+    uint16_t stack;
+};
+
+/* Optional log of toolbox calls supplied by the host.  The CPU appends records
+   to the ring at head, which the host consumes from tail in batches (i.e.
+   after each emulation timeslice.)  Records are dropped if the ring is full.
+   record_limit must be a power of two.
+*/
+struct ClemensToolboxLog {
+    struct ClemensToolboxRecord *records;
+    unsigned record_limit;
+    unsigned head;
+    unsigned tail;
+    unsigned dropped;
+    /* stack parameter bytes to capture per call (up to CLEM_TOOLBOX_PARAM_LIMIT) */
+    unsigned param_count;
+    /* calls awaiting their RTL, innermost last */
+    struct ClemensToolboxPendingCall pending[CLEM_TOOLBOX_CALL_DEPTH];
+    unsigned pending_count;
+};
+
 /**
  * @brief
  *
@@ -224,8 +348,12 @@ typedef struct ClemensMachine {
     void *debug_user_ptr;
     /* opcode print callback */
     ClemensOpcodeCallback opcode_post;
+    /* Optional toolbox call log (NULL disables logging) */
+    struct ClemensToolboxLog *toolbox_log;
     /* logger callback (if NULL, uses stdout) */
     LoggerFn logger_fn;
+    /* Optional log ring, replacing logger_fn if set */
+    struct ClemensLogRing *log_ring;
 } ClemensMachine;
 
 #ifdef __cplusplus
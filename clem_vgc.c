@@ -32,6 +32,44 @@ static inline unsigned _clem_vgc_calc_h_counter(unsigned scanline_ns) {
   return (scanline_ns / 980) & 0x7f; /* 7 bits */
 }
 
+/* The smallest clocks duration that clem_calc_ns_step_from_clocks() converts
+   to at least ns nanoseconds */
+static inline clem_clocks_duration_t
+_clem_vgc_calc_clocks_reaching_ns(unsigned ns, clem_clocks_duration_t ref_step) {
+  return (clem_clocks_duration_t)(((uint64_t)ns * ref_step + CLEM_MEGA2_CYCLE_NS - 1) /
+                                  CLEM_MEGA2_CYCLE_NS);
+}
+
+/* Finds the earliest time that a sync would change state - the end of the
+   current scanline, the start of VBL or the end of the frame.  Syncs before
+   then only need to note the time, which keeps the IRQs at exactly the clocks
+   they would have fired at if every sync evaluated the counters. */
+static void _clem_vgc_schedule(struct ClemensVGC *vgc,
+                               clem_clocks_duration_t ref_step) {
+  clem_clocks_duration_t dt_line_end =
+      _clem_vgc_calc_clocks_reaching_ns(CLEM_VGC_HORIZ_SCAN_TIME_NS + 1, ref_step);
+  clem_clocks_time_t ts_event;
+
+  if (vgc->dt_scanline < dt_line_end) {
+    vgc->ts_next_event = vgc->ts_scanline_dt + (dt_line_end - vgc->dt_scanline);
+  } else {
+    vgc->ts_next_event = vgc->ts_scanline_dt;
+  }
+  ts_event = vgc->ts_scanline_0 + _clem_vgc_calc_clocks_reaching_ns(
+                                      CLEM_VGC_NTSC_SCAN_TIME_NS, ref_step);
+  if (ts_event < vgc->ts_next_event) {
+    vgc->ts_next_event = ts_event;
+  }
+  if (!vgc->vbl_started) {
+    ts_event = vgc->ts_scanline_0 +
+               _clem_vgc_calc_clocks_reaching_ns(
+                   CLEM_VGC_VBL_NTSC_LOWER_BOUND * CLEM_VGC_HORIZ_SCAN_TIME_NS, ref_step);
+    if (ts_event < vgc->ts_next_event) {
+      vgc->ts_next_event = ts_event;
+    }
+  }
+}
+
 static bool _clem_vgc_is_scanline_int_enabled(const uint8_t *mega2_e1,
                                               unsigned v_counter) {
   if (v_counter >= CLEM_VGC_FIRST_VISIBLE_SCANLINE_CNTR) {
@@ -52,6 +90,7 @@ void clem_vgc_reset(struct ClemensVGC *vgc) {
   unsigned row, inner;
 
   vgc->mode_flags = CLEM_VGC_INIT;
+  vgc->ts_next_event = 0;
   vgc->text_fg_color = CLEM_VGC_COLOR_WHITE;
   vgc->text_bg_color = CLEM_VGC_COLOR_MEDIUM_BLUE;
   vgc->scanline_irq_enable = false;
@@ -203,6 +242,11 @@ void clem_vgc_sync(struct ClemensVGC *vgc, struct ClemensClock *clock,
   unsigned frame_ns;
   unsigned v_counter;
 
+  if (clock->ts < vgc->ts_next_event) {
+    vgc->ts_last_frame = clock->ts;
+    return;
+  }
+
   if (vgc->mode_flags & CLEM_VGC_INIT) {
     vgc->ts_last_frame = clock->ts;
     vgc->ts_scanline_0 = clock->ts;
@@ -213,7 +257,7 @@ void clem_vgc_sync(struct ClemensVGC *vgc, struct ClemensClock *clock,
                                              clock->ref_step);
     v_counter = _clem_vgc_calc_v_counter(frame_ns);
 
-    vgc->dt_scanline += (clock->ts - vgc->ts_last_frame);
+    vgc->dt_scanline += (clock->ts - vgc->ts_scanline_dt);
     scanline_ns =
         clem_calc_ns_step_from_clocks(vgc->dt_scanline, clock->ref_step);
     if (scanline_ns > CLEM_VGC_HORIZ_SCAN_TIME_NS) {
@@ -245,6 +289,8 @@ void clem_vgc_sync(struct ClemensVGC *vgc, struct ClemensClock *clock,
   }
 
   vgc->ts_last_frame = clock->ts;
+  vgc->ts_scanline_dt = clock->ts;
+  _clem_vgc_schedule(vgc, clock->ref_step);
 }
 
 uint8_t clem_vgc_read_switch(struct ClemensVGC *vgc, struct ClemensClock *clock,
@@ -258,8 +304,10 @@ uint8_t clem_vgc_read_switch(struct ClemensVGC *vgc, struct ClemensClock *clock,
                                                clock->ref_step);
   /* 65 cycles per horizontal scanline, 980 ns per horizontal count = 63.7us*/
   v_counter = _clem_vgc_calc_v_counter(scan_time_ns);
-  h_counter = _clem_vgc_calc_h_counter(
-      clem_calc_ns_step_from_clocks(vgc->dt_scanline, clock->ref_step));
+  /* the scanline time as of the last sync */
+  h_counter = _clem_vgc_calc_h_counter(clem_calc_ns_step_from_clocks(
+      vgc->dt_scanline + (vgc->ts_last_frame - vgc->ts_scanline_dt),
+      clock->ref_step));
 
   switch (ioreg) {
   case CLEM_MMIO_REG_VBLBAR:
@@ -381,6 +381,74 @@ clem_woz_parse_trks_chunk(struct ClemensWOZDisk *disk,
   return woz_iter.end;
 }
 
+uint8_t *
+clem_woz_map_trks_chunk(struct ClemensWOZDisk *disk,
+                        const struct ClemensWOZChunkHeader *header,
+                        uint8_t *data, size_t data_sz) {
+  struct _ClemBufferIterator woz_iter;
+  unsigned param, idx;
+
+  /* the track bits are referenced directly from the chunk instead of copied
+     into a caller supplied buffer.  offsets are relative to the first byte
+     of track data which differs between V1 (inline with track metadata) and
+     V2 (a fixed table followed by block aligned bits.)
+  */
+  if (data_sz < header->data_size)
+    return NULL;
+
+  woz_iter.cur = data;
+  woz_iter.end = data + header->data_size;
+
+  if (disk->version == 1) {
+    disk->nib->bits_data = data;
+    disk->nib->bits_data_end = data + header->data_size;
+    for (idx = 0; idx < disk->nib->track_count; ++idx) {
+      /* bits, byte count, bit count and write hints */
+      param = idx * (disk->max_track_size_bytes + 10);
+      if (data + param + disk->max_track_size_bytes + 4 >
+          disk->nib->bits_data_end) {
+        CLEM_ASSERT(false);
+        return NULL;
+      }
+      woz_iter.cur = data + param + disk->max_track_size_bytes;
+      disk->nib->track_initialized[idx] = 1;
+      disk->nib->track_byte_offset[idx] = param;
+      disk->nib->track_byte_count[idx] = _clem_woz_read_u16(&woz_iter);
+      disk->nib->track_bits_count[idx] = _clem_woz_read_u16(&woz_iter);
+    }
+    for (; idx < CLEM_DISK_LIMIT_QTR_TRACKS; ++idx) {
+      disk->nib->track_initialized[idx] = 0;
+    }
+  } else {
+    if (header->data_size < CLEM_DISK_LIMIT_QTR_TRACKS * 8) {
+      return NULL;
+    }
+    disk->nib->bits_data = data + CLEM_DISK_LIMIT_QTR_TRACKS * 8;
+    disk->nib->bits_data_end = data + header->data_size;
+    for (idx = 0; idx < CLEM_DISK_LIMIT_QTR_TRACKS; ++idx) {
+      param = (uint32_t)_clem_woz_read_u16(&woz_iter) * 512;
+      disk->nib->track_byte_count[idx] =
+          ((uint32_t)_clem_woz_read_u16(&woz_iter) * 512);
+      disk->nib->track_bits_count[idx] = _clem_woz_read_u32(&woz_iter);
+      disk->nib->track_initialized[idx] = 0;
+      if (param == 0 || disk->nib->track_byte_count[idx] == 0) {
+        continue;
+      }
+      if (param < CLEM_WOZ_OFFSET_TRACK_DATA_V2 ||
+          disk->nib->bits_data + (param - CLEM_WOZ_OFFSET_TRACK_DATA_V2) +
+                  disk->nib->track_byte_count[idx] >
+              disk->nib->bits_data_end) {
+        CLEM_ASSERT(false);
+        return NULL;
+      }
+      disk->nib->track_byte_offset[idx] = param - CLEM_WOZ_OFFSET_TRACK_DATA_V2;
+      disk->nib->track_initialized[idx] = 1;
+    }
+  }
+
+  return data + header->data_size;
+}
+
 // uint8_t* clem_woz_parse_writ_chunk(uint8_t* data, size_t data_sz);
 
 const uint8_t *
@@ -124,6 +124,18 @@ clem_woz_parse_trks_chunk(struct ClemensWOZDisk *disk,
                           const struct ClemensWOZChunkHeader *header,
                           const uint8_t *data, size_t data_sz);
 
+/*
+    Alternative to clem_woz_parse_trks_chunk that avoids copying track data.
+    The nibble disk's bits_data and bits_data_end are pointed into the supplied
+    buffer, which must outlive the disk (i.e. a writable file mapping or the
+    loaded image.)  Writes from the emulated drive land directly in this
+    buffer.
+ */
+uint8_t *
+clem_woz_map_trks_chunk(struct ClemensWOZDisk *disk,
+                        const struct ClemensWOZChunkHeader *header,
+                        uint8_t *data, size_t data_sz);
+
 // uint8_t* clem_woz_parse_writ_chunk(uint8_t* data, size_t data_sz);
 
 const uint8_t *
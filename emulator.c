@@ -696,6 +696,20 @@ void clemens_host_setup(ClemensMachine *clem, LoggerFn logger, void *debug_user_
     clemens_debug_context(clem);
 }
 
+void clemens_log_ring(ClemensMachine *clem, struct ClemensLogRing *ring) {
+    if (ring) {
+        ring->head = 0;
+        ring->tail = 0;
+        ring->dropped = 0;
+    }
+    clem->log_ring = ring;
+}
+
+unsigned clemens_format_log_record(const struct ClemensLogRecord *record, char *out,
+                                   unsigned out_size) {
+    return clem_debug_format_record(record, out, out_size);
+}
+
 void clemens_opcode_callback(ClemensMachine *clem, ClemensOpcodeCallback callback) {
     if (callback) {
         clem->debug_flags |= kClemensDebugFlag_OpcodeCallback;
@@ -705,6 +719,64 @@ void clemens_opcode_callback(ClemensMachine *clem, ClemensOpcodeCallback callbac
     clem->opcode_post = callback;
 }
 
+void clemens_page_write_tracking(ClemensMachine *clem, uint32_t *page_write_gen) {
+    clem->mem.page_write_gen = page_write_gen;
+    clem->mem.write_generation = 1;
+    clemens_touch_all_pages(clem);
+}
+
+uint32_t clemens_next_write_generation(ClemensMachine *clem) {
+    return clem->mem.write_generation++;
+}
+
+void clemens_touch_all_pages(ClemensMachine *clem) {
+    unsigned i;
+    if (!clem->mem.page_write_gen)
+        return;
+    for (i = 0; i < CLEM_IIGS_PAGE_COUNT; ++i) {
+        clem->mem.page_write_gen[i] = clem->mem.write_generation;
+    }
+}
+
+void clemens_memory_access_counters(ClemensMachine *clem,
+                                    struct ClemensMemoryAccessCounters *counters) {
+    clem->mem.access_counters = counters;
+}
+
+void clemens_memory_write_log(ClemensMachine *clem, struct ClemensMemoryWriteLog *write_log) {
+    if (write_log) {
+        write_log->count = 0;
+    }
+    clem->mem.write_log = write_log;
+}
+
+void clemens_toolbox_log(ClemensMachine *clem, struct ClemensToolboxLog *log) {
+    if (log) {
+        log->head = 0;
+        log->tail = 0;
+        log->dropped = 0;
+        log->pending_count = 0;
+    }
+    clem->toolbox_log = log;
+}
+
+void clemens_decay_memory_access_counters(struct ClemensMemoryAccessCounters *counters,
+                                          unsigned shift) {
+    /* rounding the decrement up lets small counts reach zero */
+    uint32_t round = (1U << shift) - 1;
+    unsigned i;
+    for (i = 0; i < CLEM_IIGS_PAGE_COUNT; ++i) {
+        counters->reads[i] -= (counters->reads[i] + round) >> shift;
+        counters->writes[i] -= (counters->writes[i] + round) >> shift;
+        counters->executes[i] -= (counters->executes[i] + round) >> shift;
+    }
+    if (counters->bytes) {
+        for (i = 0; i < CLEM_IIGS_BANK_SIZE; ++i) {
+            counters->bytes[i] -= (counters->bytes[i] + round) >> shift;
+        }
+    }
+}
+
 void clemens_create_page_mapping(struct ClemensMemoryPageInfo *page, uint8_t page_idx,
                                  uint8_t bank_read_idx, uint8_t bank_write_idx) {
     clem_mem_create_page_mapping(page, page_idx, bank_read_idx, bank_write_idx);
@@ -998,6 +1070,72 @@ void clemens_out_bin_data(const ClemensMachine *clem, uint8_t *out, unsigned out
     memcpy(out, memory + left0, right0 - left0);
 }
 
+static void _clem_toolbox_call(ClemensMachine *clem, uint8_t entry, uint8_t pbr, uint16_t addr,
+                               uint16_t stack) {
+    struct ClemensToolboxLog *log = clem->toolbox_log;
+    struct ClemensToolboxRecord *record;
+    struct Clemens65C816 *cpu = &clem->cpu;
+    unsigned i;
+
+    if (log->pending_count < CLEM_TOOLBOX_CALL_DEPTH) {
+        struct ClemensToolboxPendingCall *pending = &log->pending[log->pending_count++];
+        pending->clocks = clem->tspec.clocks_spent;
+        pending->return_addr = ((uint32_t)pbr << 16) | (uint16_t)(addr + 4);
+        pending->call = cpu->regs.X;
+        pending->stack = stack;
+    }
+    if (log->head - log->tail >= log->record_limit) {
+        ++log->dropped;
+        return;
+    }
+    record = &log->records[log->head & (log->record_limit - 1)];
+    record->clocks = clem->tspec.clocks_spent;
+    record->caller = ((uint32_t)pbr << 16) | addr;
+    record->call = cpu->regs.X;
+    record->stack = stack;
+    record->type = kClemensToolboxRecord_Call;
+    record->entry = entry;
+    record->param_count = (uint8_t)(log->param_count < CLEM_TOOLBOX_PARAM_LIMIT
+                                        ? log->param_count
+                                        : CLEM_TOOLBOX_PARAM_LIMIT);
+    for (i = 0; i < record->param_count; ++i) {
+        clem_read(clem, &record->params[i], (uint16_t)(stack + 1 + i), 0x00, CLEM_MEM_FLAG_NULL);
+    }
+    ++log->head;
+}
+
+static void _clem_toolbox_return(ClemensMachine *clem, uint8_t pbr, uint16_t pc, uint16_t stack) {
+    /*  tools pop their inputs before returning, so the stack is at or above
+        where it was at the call.  calls that never return (i.e. a tool that
+        longjmps out) are discarded once an outer call returns.
+    */
+    struct ClemensToolboxLog *log = clem->toolbox_log;
+    struct ClemensToolboxRecord *record;
+    uint32_t return_addr = ((uint32_t)pbr << 16) | pc;
+    unsigned i = log->pending_count;
+
+    while (i > 0) {
+        struct ClemensToolboxPendingCall *pending = &log->pending[--i];
+        if (pending->return_addr != return_addr || (uint16_t)(stack - pending->stack) >= 0x100)
+            continue;
+        log->pending_count = i;
+        if (log->head - log->tail >= log->record_limit) {
+            ++log->dropped;
+            return;
+        }
+        record = &log->records[log->head & (log->record_limit - 1)];
+        record->clocks = clem->tspec.clocks_spent - pending->clocks;
+        record->caller = (return_addr & 0xff0000) | (uint16_t)(return_addr - 4);
+        record->call = pending->call;
+        record->stack = pending->stack;
+        record->type = kClemensToolboxRecord_Return;
+        record->entry = 0;
+        record->param_count = 0;
+        ++log->head;
+        return;
+    }
+}
+
 void cpu_execute(struct Clemens65C816 *cpu, ClemensMachine *clem) {
     uint16_t tmp_addr;
     uint16_t tmp_eaddr;
@@ -2977,6 +3115,11 @@ void cpu_execute(struct Clemens65C816 *cpu, ClemensMachine *clem) {
         _cpu_sp_dec3(cpu);
         _opcode_instruction_define_long(&opc_inst, IR, tmp_bnk0, tmp_addr);
         CLEM_CPU_I_JSL_LOG(cpu, tmp_addr, tmp_bnk0);
+        //  toolbox dispatcher and its alternate entry
+        if (clem->toolbox_log && tmp_bnk0 == 0xe1 && (tmp_addr == 0x0000 || tmp_addr == 0x0004)) {
+            _clem_toolbox_call(clem, (uint8_t)tmp_addr, opc_pbr, opc_addr,
+                               (uint16_t)(cpu->regs.S + 3));
+        }
         tmp_pc = tmp_addr; // set next PC to the JSL routine
         cpu->regs.PBR = tmp_bnk0;
         break;
@@ -2993,6 +3136,9 @@ void cpu_execute(struct Clemens65C816 *cpu, ClemensMachine *clem) {
         tmp_pc = tmp_addr + 1;
         CLEM_CPU_I_RTL_LOG(cpu, tmp_pc, tmp_data);
         cpu->regs.PBR = tmp_data;
+        if (clem->toolbox_log && clem->toolbox_log->pending_count) {
+            _clem_toolbox_return(clem, tmp_data, tmp_pc, cpu->regs.S);
+        }
         break;
 
     //  interrupt opcodes (RESET is handled separately)
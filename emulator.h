@@ -104,6 +104,30 @@ void clemens_emulate_cpu(ClemensMachine *clem);
  */
 void clemens_host_setup(ClemensMachine *clem, LoggerFn logger, void *debug_user_ptr);
 
+/**
+ * @brief Routes emulator log messages into a ring instead of the logger
+ *
+ * Messages are stored unformatted so that logging costs little on the
+ * emulation thread.  The host consumes records from the ring's tail and
+ * formats them with clemens_format_log_record(), which may be done on any
+ * thread.
+ *
+ * @param clem
+ * @param ring Host owned ring, or NULL to use the logger callback
+ */
+void clemens_log_ring(ClemensMachine *clem, struct ClemensLogRing *ring);
+
+/**
+ * @brief Formats a log record
+ *
+ * @param record
+ * @param out
+ * @param out_size
+ * @return unsigned The length of the (possibly truncated) message
+ */
+unsigned clemens_format_log_record(const struct ClemensLogRecord *record, char *out,
+                                   unsigned out_size);
+
 /**
  * @brief
  *
@@ -115,6 +139,86 @@ void clemens_host_setup(ClemensMachine *clem, LoggerFn logger, void *debug_user_
  */
 void clemens_opcode_callback(ClemensMachine *clem, ClemensOpcodeCallback callback);
 
+/**
+ * @brief Enables per page write tracking for debuggers
+ *
+ * Every write to RAM stamps the written physical page with the current write
+ * generation.  Hosts compare these stamps against the generation they last
+ * copied to transfer only modified pages.
+ *
+ * @param clem
+ * @param page_write_gen CLEM_IIGS_PAGE_COUNT entries, or NULL to disable
+ */
+void clemens_page_write_tracking(ClemensMachine *clem, uint32_t *page_write_gen);
+
+/**
+ * @brief Starts a new write generation
+ *
+ * @param clem
+ * @return uint32_t The generation that just ended.  Pages with stamps greater
+ *         than this value were written after this call.
+ */
+uint32_t clemens_next_write_generation(ClemensMachine *clem);
+
+/**
+ * @brief Stamps every page as written in the current generation
+ *
+ * Used when memory is replaced wholesale (i.e. loading a snapshot.)
+ *
+ * @param clem
+ */
+void clemens_touch_all_pages(ClemensMachine *clem);
+
+/**
+ * @brief Enables memory access accounting
+ *
+ * CPU reads, writes and opcode fetches increment the matching page counters
+ * in the supplied structure.  Debugger (CLEM_MEM_FLAG_NULL) accesses are not
+ * counted.
+ *
+ * @param clem
+ * @param counters  Host owned counters, or NULL to disable accounting
+ */
+void clemens_memory_access_counters(ClemensMachine *clem,
+                                    struct ClemensMemoryAccessCounters *counters);
+
+/**
+ * @brief Decays all access counts by roughly count >> shift
+ *
+ * Called once per host frame, this keeps the counters weighted to recent
+ * accesses (a shift of 1 halves all counts per call.)  The decrement is
+ * rounded up so that idle pages eventually return to zero.
+ *
+ * @param counters
+ * @param shift
+ */
+void clemens_decay_memory_access_counters(struct ClemensMemoryAccessCounters *counters,
+                                          unsigned shift);
+
+/**
+ * @brief Enables logging of CPU writes
+ *
+ * Used with the opcode callback to record the memory written by each
+ * instruction.  The host resets write_log->count after reading the entries.
+ *
+ * @param clem
+ * @param write_log Host owned log, or NULL to disable logging
+ */
+void clemens_memory_write_log(ClemensMachine *clem, struct ClemensMemoryWriteLog *write_log);
+
+/**
+ * @brief Enables logging of toolbox calls
+ *
+ * The CPU appends a record to the log when a JSL to the toolbox dispatcher
+ * ($E1/0000 or $E1/0004) executes, and another when the call returns to its
+ * caller.  Attaching a log resets its ring and pending calls; the host must
+ * set records, record_limit and param_count beforehand.
+ *
+ * @param clem
+ * @param log Host owned log, or NULL to disable logging
+ */
+void clemens_toolbox_log(ClemensMachine *clem, struct ClemensToolboxLog *log);
+
 /**
  * @brief
  *
@@ -292,6 +292,26 @@ void clemens_audio_next_frame(ClemensMMIO *mmio, unsigned consumed) {
     clem_sound_consume_frames(&mmio->dev_audio, consumed);
 }
 
+void clemens_audio_capture(ClemensMMIO *mmio, struct ClemensAudioCapture *capture) {
+    if (capture) {
+        capture->frame_total = 0;
+    }
+    mmio->dev_audio.capture = capture;
+}
+
+unsigned clemens_serial_drain(ClemensMMIO *mmio, unsigned channel, uint8_t *data, unsigned limit) {
+    return clem_scc_host_drain(&mmio->dev_scc, channel, data, limit);
+}
+
+unsigned clemens_serial_feed(ClemensMMIO *mmio, unsigned channel, const uint8_t *data,
+                             unsigned count) {
+    return clem_scc_host_feed(&mmio->dev_scc, channel, data, count);
+}
+
+void clemens_serial_connect(ClemensMMIO *mmio, unsigned channel, bool connected) {
+    clem_scc_host_connect(&mmio->dev_scc, channel, connected);
+}
+
 void clemens_input(ClemensMMIO *mmio, const struct ClemensInputEvent *input) {
     clem_adb_device_input(&mmio->dev_adb, input);
 }
@@ -300,6 +320,14 @@ void clemens_input_key_toggle(ClemensMMIO *mmio, unsigned enabled) {
     clem_adb_device_key_toggle(&mmio->dev_adb, enabled);
 }
 
+unsigned clemens_input_text(ClemensMMIO *mmio, const uint8_t *text, unsigned count) {
+    return clem_adb_device_text(&mmio->dev_adb, text, count);
+}
+
+void clemens_input_text_clear(ClemensMMIO *mmio) {
+    clem_adb_device_text_clear(&mmio->dev_adb);
+}
+
 const uint8_t *clemens_get_ascii_from_a2code(unsigned input) {
     return clem_adb_ascii_from_a2code(input);
 }
@@ -396,10 +424,13 @@ void clemens_emulate_mmio(ClemensMachine *clem, ClemensMMIO *mmio) {
 
     // TODO: calculate delta_ns per emulate call to call 'real-time' systems
     //      like VGC
-    delta_mega2_cycles =
-        (uint32_t)((clem->tspec.clocks_spent / clem->tspec.clocks_step_mega2) - mmio->mega2_cycles);
+    //  mega2_cycles is always floor(clocks_spent / step) from the last call, so
+    //  the delta only needs to divide the clocks spent since that cycle, which
+    //  is small enough for the reciprocal fast path in clem_shared.h
+    delta_mega2_cycles = (uint32_t)clem_calc_clocks_div_step(
+        clem->tspec.clocks_spent - mmio->mega2_cycles * clem->tspec.clocks_step_mega2,
+        clem->tspec.clocks_step_mega2);
     mmio->mega2_cycles += delta_mega2_cycles;
-    mmio->timer_60hz_us += delta_mega2_cycles;
 
     clock.ts = clem->tspec.clocks_spent;
     clock.ref_step = clem->tspec.clocks_step_mega2;
@@ -423,19 +454,19 @@ void clemens_emulate_mmio(ClemensMachine *clem, ClemensMMIO *mmio) {
     clem_gameport_sync(&mmio->dev_adb.gameport, &clock);
 
     /* background execution of some async devices on the 60 hz timer */
-    while (mmio->timer_60hz_us >= CLEM_MEGA2_CYCLES_PER_60TH) {
-        clem_timer_sync(&mmio->dev_timer, CLEM_MEGA2_CYCLES_PER_60TH);
+    while (mmio->mega2_cycles >= mmio->mega2_cycles_60hz) {
+        clem_timer_sync(&mmio->dev_timer, mmio->mega2_cycles_60hz);
         clem_adb_glu_sync(&mmio->dev_adb, CLEM_MEGA2_CYCLES_PER_60TH);
         if (clem->resb_counter <= 0 && mmio->dev_adb.keyb.reset_key) {
             /* TODO: move into its own utility */
             clem->resb_counter = 2;
             clem->cpu.pins.resbIn = false;
         }
-        mmio->timer_60hz_us -= CLEM_MEGA2_CYCLES_PER_60TH;
+        mmio->mega2_cycles_60hz += CLEM_MEGA2_CYCLES_PER_60TH;
     }
 
     mmio->irq_line = (mmio->dev_adb.irq_line | mmio->dev_timer.irq_line | mmio->dev_audio.irq_line |
-                      mmio->vgc.irq_line | card_irqs);
+                      mmio->vgc.irq_line | mmio->dev_scc.irq_line | card_irqs);
     mmio->nmi_line = card_nmis;
     clem_iwm_speed_disk_gate(mmio, &clem->tspec);
 
@@ -56,6 +56,61 @@ ClemensAudio *clemens_get_audio(ClemensAudio *audio, ClemensMMIO *mmio);
  */
 void clemens_audio_next_frame(ClemensMMIO *mmio, unsigned consumed);
 
+/**
+ * @brief Attaches a sink that receives the mixed audio output
+ *
+ * Consumed frames are passed to the capture's callback from
+ * clemens_audio_next_frame(), so they include the Ensoniq, speaker and any
+ * card audio the host mixed into the buffer, at the mix buffer's rate and
+ * before any host resampling.  Every frame is captured exactly once, in
+ * order.
+ *
+ * @param mmio
+ * @param capture Pass NULL to detach.  The capture must remain valid while
+ *  attached.
+ */
+void clemens_audio_capture(ClemensMMIO *mmio, struct ClemensAudioCapture *capture);
+
+/**
+ * @brief Returns bytes the guest transmitted on a serial port
+ *
+ * Bytes are queued once their character time on the wire has elapsed.  Hosts
+ * should drain each port once per emulated timeslice.  If the queue fills,
+ * the SCC transmitter holds further characters until it is drained.
+ *
+ * @param mmio
+ * @param channel CLEM_SCC_CHANNEL_A (printer) or CLEM_SCC_CHANNEL_B (modem)
+ * @param data
+ * @param limit
+ * @return unsigned The number of bytes returned in data
+ */
+unsigned clemens_serial_drain(ClemensMMIO *mmio, unsigned channel, uint8_t *data, unsigned limit);
+
+/**
+ * @brief Queues bytes for the guest to receive on a serial port
+ *
+ * The SCC receives the bytes one character time apart at the port's baud
+ * rate.
+ *
+ * @param mmio
+ * @param channel CLEM_SCC_CHANNEL_A (printer) or CLEM_SCC_CHANNEL_B (modem)
+ * @param data
+ * @param count
+ * @return unsigned The number of bytes accepted - the remainder should be
+ *  retried on a later timeslice
+ */
+unsigned clemens_serial_feed(ClemensMMIO *mmio, unsigned channel, const uint8_t *data,
+                             unsigned count);
+
+/**
+ * @brief Asserts or drops the DCD and CTS handshake inputs for a serial port
+ *
+ * @param mmio
+ * @param channel CLEM_SCC_CHANNEL_A (printer) or CLEM_SCC_CHANNEL_B (modem)
+ * @param connected
+ */
+void clemens_serial_connect(ClemensMMIO *mmio, unsigned channel, bool connected);
+
 /**
  * @brief
  *
@@ -158,6 +213,27 @@ void clemens_input(ClemensMMIO *mmio, const struct ClemensInputEvent *input);
  */
 void clemens_input_key_toggle(ClemensMMIO *mmio, unsigned enabled);
 
+/**
+ * @brief Types ASCII text into the keyboard latch
+ *
+ * Characters bypass the ADB key queue and are latched at $C000 as the guest
+ * consumes them, so a paste is not limited by the keyboard buffer.  Hosts
+ * should offer the remainder again on a later timeslice.
+ *
+ * @param mmio
+ * @param text ASCII characters (i.e. CR for Return)
+ * @param count
+ * @return unsigned The number of characters accepted
+ */
+unsigned clemens_input_text(ClemensMMIO *mmio, const uint8_t *text, unsigned count);
+
+/**
+ * @brief Discards text queued by clemens_input_text and not yet typed
+ *
+ * @param mmio
+ */
+void clemens_input_text_clear(ClemensMMIO *mmio);
+
 /**
  * @brief
  *
@@ -9,13 +9,21 @@
 
 ClemensAudioDevice::ClemensAudioDevice()
     : queuedFrameBuffer_(nullptr), queuedFrameHead_(0), queuedFrameTail_(0),
-      queuedFrameLimit_(0), queuedFrameStride_(0) {
+      queuedFrameLimit_(0), queuedFrameStride_(0),
+      threadPriority_(kClemensHostThreadPriority_Normal), isThreadConfigured_(false) {
 
 }
 
 ClemensAudioDevice::~ClemensAudioDevice() { stop(); }
 
+void ClemensAudioDevice::setThreadConfig(std::optional<unsigned> processor,
+                                         ClemensHostThreadPriority priority) {
+  threadProcessor_ = processor;
+  threadPriority_ = priority;
+}
+
 void ClemensAudioDevice::start() {
+  isThreadConfigured_ = false;
   saudio_desc audioDesc = {};
   audioDesc.sample_rate = 48000;
   audioDesc.num_channels = 2;
@@ -147,5 +155,16 @@ void ClemensAudioDevice::mixClemensAudio(float* audioOut, int num_frames, int nu
 void ClemensAudioDevice::mixAudio(float* buffer, int num_frames, int num_channels,
                                   void* user_data) {
   auto *audio = reinterpret_cast<ClemensAudioDevice *>(user_data);
+  if (!audio->isThreadConfigured_) {
+    //  the audio backend owns its thread, so this is the first chance to
+    //  place it
+    if (audio->threadProcessor_.has_value()) {
+      clem_host_thread_set_processor(*audio->threadProcessor_);
+    }
+    if (audio->threadPriority_ != kClemensHostThreadPriority_Normal) {
+      clem_host_thread_set_priority(audio->threadPriority_);
+    }
+    audio->isThreadConfigured_ = true;
+  }
   audio->mixClemensAudio(buffer, num_frames, num_channels);
 }
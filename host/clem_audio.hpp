@@ -1,9 +1,11 @@
 #ifndef CLEM_HOST_AUDIO_H
 #define CLEM_HOST_AUDIO_H
 
+#include "clem_host_platform.h"
 #include "clem_mmio_types.h"
 
 #include <mutex>
+#include <optional>
 #include <vector>
 
 class ClemensAudioDevice {
@@ -14,6 +16,10 @@ class ClemensAudioDevice {
     unsigned getAudioFrequency() const;
     unsigned getBufferStride() const;
 
+    //  Placement of the host's audio thread, applied from its first callback.
+    //  Must be set before start().
+    void setThreadConfig(std::optional<unsigned> processor, ClemensHostThreadPriority priority);
+
     void start();
     void stop();
     unsigned queue(ClemensAudio &audio, float deltaTime);
@@ -30,6 +36,11 @@ class ClemensAudioDevice {
     uint32_t queuedFrameStride_;
 
     std::mutex queuedFrameMutex_;
+
+    std::optional<unsigned> threadProcessor_;
+    ClemensHostThreadPriority threadPriority_;
+    //  only accessed from the audio thread once started
+    bool isThreadConfigured_;
 };
 
 #endif
@@ -0,0 +1,117 @@
+#include "clem_audio_recorder.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+constexpr unsigned kChannelCount = 2;
+constexpr unsigned kBytesPerFrame = kChannelCount * sizeof(float);
+//  RIFF + fmt (WAVE_FORMAT_IEEE_FLOAT) + fact + data chunk headers
+constexpr unsigned kWAVHeaderSize = 12 + (8 + 18) + (8 + 4) + 8;
+
+uint8_t *putU16(uint8_t *out, uint16_t v) {
+    out[0] = (uint8_t)v;
+    out[1] = (uint8_t)(v >> 8);
+    return out + 2;
+}
+
+uint8_t *putU32(uint8_t *out, uint32_t v) {
+    out[0] = (uint8_t)v;
+    out[1] = (uint8_t)(v >> 8);
+    out[2] = (uint8_t)(v >> 16);
+    out[3] = (uint8_t)(v >> 24);
+    return out + 4;
+}
+
+uint8_t *putTag(uint8_t *out, const char *tag) {
+    memcpy(out, tag, 4);
+    return out + 4;
+}
+
+} // namespace
+
+ClemensAudioRecorder::ClemensAudioRecorder(Format format, std::string path)
+    : format_(format), path_(std::move(path)), stream_(nullptr), capture_{},
+      framesPerSecond_(0), dataBytes_(0), writeFailed_(false) {
+    capture_.callback = &ClemensAudioRecorder::captureCallback;
+    capture_.user_ptr = this;
+    stream_ = fopen(path_.c_str(), "wb");
+    if (stream_ && format_ == Format::WAV) {
+        //  sizes and rate are filled in by finish()
+        if (!writeWAVHeader()) {
+            fclose(stream_);
+            stream_ = nullptr;
+        }
+    }
+}
+
+ClemensAudioRecorder::~ClemensAudioRecorder() { finish(); }
+
+void ClemensAudioRecorder::captureCallback(void *userPtr, const uint8_t *data,
+                                           unsigned frameCount, unsigned frameStride,
+                                           unsigned framesPerSecond) {
+    auto *recorder = reinterpret_cast<ClemensAudioRecorder *>(userPtr);
+    recorder->framesPerSecond_ = framesPerSecond;
+    recorder->write(data, frameCount, frameStride);
+}
+
+void ClemensAudioRecorder::write(const uint8_t *data, unsigned frameCount, unsigned frameStride) {
+    if (!stream_ || writeFailed_)
+        return;
+    if (frameStride != kBytesPerFrame) {
+        //  pack the frames if the mix buffer has padding
+        frameBuffer_.resize(frameCount * kBytesPerFrame);
+        for (unsigned i = 0; i < frameCount; ++i) {
+            memcpy(&frameBuffer_[i * kBytesPerFrame], data + i * frameStride,
+                   std::min(frameStride, kBytesPerFrame));
+        }
+        data = frameBuffer_.data();
+    }
+    size_t byteCount = size_t(frameCount) * kBytesPerFrame;
+    if (fwrite(data, 1, byteCount, stream_) != byteCount) {
+        writeFailed_ = true;
+        return;
+    }
+    dataBytes_ += byteCount;
+}
+
+bool ClemensAudioRecorder::writeWAVHeader() {
+    //  RIFF sizes are 32-bit; longer recordings are truncated in the header
+    //  though all samples remain in the file.
+    uint32_t dataBytes = (uint32_t)std::min<uint64_t>(dataBytes_, 0xffffffffu - kWAVHeaderSize);
+    uint8_t header[kWAVHeaderSize];
+    uint8_t *out = header;
+    out = putTag(out, "RIFF");
+    out = putU32(out, kWAVHeaderSize - 8 + dataBytes);
+    out = putTag(out, "WAVE");
+    out = putTag(out, "fmt ");
+    out = putU32(out, 18);
+    out = putU16(out, 3); // WAVE_FORMAT_IEEE_FLOAT
+    out = putU16(out, kChannelCount);
+    out = putU32(out, framesPerSecond_);
+    out = putU32(out, framesPerSecond_ * kBytesPerFrame);
+    out = putU16(out, kBytesPerFrame);
+    out = putU16(out, 32);
+    out = putU16(out, 0);
+    out = putTag(out, "fact");
+    out = putU32(out, 4);
+    out = putU32(out, dataBytes / kBytesPerFrame);
+    out = putTag(out, "data");
+    out = putU32(out, dataBytes);
+    return fwrite(header, 1, sizeof(header), stream_) == sizeof(header);
+}
+
+void ClemensAudioRecorder::finish() {
+    if (!stream_)
+        return;
+    if (format_ == Format::WAV) {
+        if (fseek(stream_, 0, SEEK_SET) != 0 || !writeWAVHeader()) {
+            writeFailed_ = true;
+        }
+    }
+    if (fclose(stream_) != 0) {
+        writeFailed_ = true;
+    }
+    stream_ = nullptr;
+}
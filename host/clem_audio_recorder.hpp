@@ -0,0 +1,51 @@
+#ifndef CLEM_HOST_AUDIO_RECORDER_HPP
+#define CLEM_HOST_AUDIO_RECORDER_HPP
+
+#include "clem_mmio_types.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+//  Records the emulator's mixed audio output to a 32-bit float stereo WAV file
+//  or a headerless raw file of the same samples.
+//
+//  Attach getCapture() with clemens_audio_capture().  Frames arrive on the
+//  emulator thread as the host consumes the mix buffer, at the emulator's mix
+//  rate and before any resampling by the audio device, so a recording is
+//  sample accurate and does not need a sound card.
+//
+class ClemensAudioRecorder {
+  public:
+    enum class Format { WAV, Raw };
+
+    ClemensAudioRecorder(Format format, std::string path);
+    ~ClemensAudioRecorder();
+
+    bool isOpen() const { return stream_ != nullptr; }
+    const std::string &getPath() const { return path_; }
+    ClemensAudioCapture *getCapture() { return &capture_; }
+    uint64_t getFrameCount() const { return capture_.frame_total; }
+    bool hasWriteFailed() const { return writeFailed_; }
+
+    //  Completes the WAV header and closes the file.
+    void finish();
+
+  private:
+    static void captureCallback(void *userPtr, const uint8_t *data, unsigned frameCount,
+                                unsigned frameStride, unsigned framesPerSecond);
+    void write(const uint8_t *data, unsigned frameCount, unsigned frameStride);
+    bool writeWAVHeader();
+
+    Format format_;
+    std::string path_;
+    FILE *stream_;
+    ClemensAudioCapture capture_;
+    unsigned framesPerSecond_;
+    uint64_t dataBytes_;
+    bool writeFailed_;
+    std::vector<uint8_t> frameBuffer_;
+};
+
+#endif
@@ -1,146 +1,90 @@
 #include "clem_backend.hpp"
+#include "clem_audio_recorder.hpp"
+#include "clem_device.h"
 #include "clem_disk_utils.hpp"
 #include "clem_host_platform.h"
+#include "clem_host_utils.hpp"
 #include "clem_mem.h"
 #include "clem_program_trace.hpp"
+#include "clem_run_sampler.hpp"
+#include "clem_serial_port.hpp"
 #include "clem_serializer.hpp"
+#include "clem_trace_index.hpp"
+#include "clem_video_capture.hpp"
 #include "emulator.h"
 #include "emulator_mmio.h"
 #include "iocards/mockingboard.h"
 
+#include <algorithm>
 #include <charconv>
 #include <chrono>
+#include <cmath>
 #include <cstdarg>
 #include <cstdlib>
 #include <filesystem>
 #include <fstream>
+#include <iterator>
 #include <optional>
 
-#include "cinek/circular_buffer.hpp"
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
 #include "fmt/format.h"
 
 static constexpr unsigned kSlabMemorySize = 32 * 1024 * 1024;
+//  access counts lose 1/8th of their value per published frame
+static constexpr unsigned kMemoryHeatmapDecayShift = 3;
+//  limits the frames written for a single published image (i.e. after the
+//  vertical blank counter is reset)
+static constexpr unsigned kVideoCaptureFrameLimit = 600;
 static constexpr unsigned kInterpreterMemorySize = 1 * 1024 * 1024;
-static constexpr unsigned kLogOutputLineLimit = 1024;
+static constexpr unsigned kLogRecordLimit = 1024;
 static constexpr unsigned kSmartPortDiskBlockCount = 32 * 1024 * 2; // 32 MB blocks
 
-struct ClemensRunSampler {
-    //  our method of keeping the simulation in sync with real time is to rely
-    //  on two counters
-    //    - sDT = simulation counter that ticks at a fixed rate, and
-    //    - aDT = real-time timer that counts the actual time passed
-    //
-    //  if aDT < sDT, then sleep the amount of time needed to catch up with sDT
-    //  if aDT >= sDT, then clamp aDT to sDT
-    std::chrono::microseconds fixedTimeInterval;
-    std::chrono::microseconds actualTimeInterval;
-    std::chrono::microseconds sampledFrameTime;
-
-    double sampledFramesPerSecond;
-
-    cinek::CircularBuffer<std::chrono::microseconds, 120> frameTimeBuffer;
-
-    clem_clocks_time_t sampledClocksSpent;
-    uint64_t sampledCyclesSpent;
-    cinek::CircularBuffer<clem_clocks_duration_t, 120> clocksBuffer;
-    cinek::CircularBuffer<clem_clocks_duration_t, 120> cyclesBuffer;
-
-    double sampledEmulatorSpeedMhz;
-
-    ClemensRunSampler() { reset(); }
-
-    void reset() {
-        fixedTimeInterval = std::chrono::microseconds::zero();
-        actualTimeInterval = std::chrono::microseconds::zero();
-        sampledFrameTime = std::chrono::microseconds::zero();
-        sampledClocksSpent = 0;
-        sampledCyclesSpent = 0;
-        sampledFramesPerSecond = 0.0f;
-        sampledEmulatorSpeedMhz = 0.0f;
-        frameTimeBuffer.clear();
-        clocksBuffer.clear();
-        cyclesBuffer.clear();
-    }
-
-    void update(std::chrono::microseconds fixedFrameInterval,
-                std::chrono::microseconds actualFrameInterval, clem_clocks_duration_t clocksSpent,
-                unsigned cyclesSpent) {
-        fixedTimeInterval += fixedFrameInterval;
-        actualTimeInterval += actualFrameInterval;
-        //  see notes at the head of this class for how delta times are calculated
-        //  in an attempt to maintain a fixed frame rate on systems where sleep()
-        //  delays can overshoot the desired sleep time (Windows especially.)
-        if (actualTimeInterval < fixedTimeInterval) {
-            std::this_thread::sleep_for(fixedTimeInterval - actualTimeInterval);
-            fixedTimeInterval -= actualTimeInterval;
-            actualTimeInterval = std::chrono::microseconds::zero();
-        } else {
-            std::this_thread::yield();
-            if (actualTimeInterval - fixedFrameInterval > std::chrono::microseconds(500000)) {
-                actualTimeInterval = fixedTimeInterval = std::chrono::microseconds::zero();
-            }
-        }
-
-        if (frameTimeBuffer.isFull()) {
-            decltype(frameTimeBuffer)::ValueType lruFrametime;
-            frameTimeBuffer.pop(lruFrametime);
-            sampledFrameTime -= lruFrametime;
-        }
-        frameTimeBuffer.push(actualFrameInterval);
-        sampledFrameTime += actualFrameInterval;
-
-        if (sampledFrameTime >= std::chrono::microseconds(100000)) {
-            sampledFramesPerSecond = frameTimeBuffer.size() * 1e6 / sampledFrameTime.count();
-        }
-
-        //  calculate emulator speed by using cycles_spent * CLEM_CLOCKS_MEGA2_CYCLE
-        //  as a reference for 1.023mhz where
-        //    reference_clocks = cycles_spent * CLEM_CLOCKS_MEGA2_CYCLE
-        //    acutal_clocks = sampledClocksSpent
-        //    (reference / actual) * 1.023mhz is the emulator speed
-        if (clocksBuffer.isFull()) {
-            decltype(clocksBuffer)::ValueType lruClocksSpent = 0;
-            clocksBuffer.pop(lruClocksSpent);
-            sampledClocksSpent -= lruClocksSpent;
-        }
-        clocksBuffer.push(clocksSpent);
-        sampledClocksSpent += clocksSpent;
-
-        if (cyclesBuffer.isFull()) {
-            decltype(cyclesBuffer)::ValueType lruCycles = 0;
-            cyclesBuffer.pop(lruCycles);
-            sampledCyclesSpent -= lruCycles;
-        }
-        cyclesBuffer.push(cyclesSpent);
-        sampledCyclesSpent += cyclesSpent;
-        if (sampledClocksSpent > (CLEM_CLOCKS_MEGA2_CYCLE * CLEM_MEGA2_CYCLES_PER_SECOND / 10)) {
-            sampledEmulatorSpeedMhz =
-                1.023 * double(CLEM_CLOCKS_MEGA2_CYCLE * sampledCyclesSpent) / sampledClocksSpent;
-        }
-    }
-};
-
 template <typename... Args>
 void ClemensBackend::localLog(int log_level, const char *msg, Args... args) {
-    if (logOutput_.size() >= kLogOutputLineLimit)
+    //  host messages are formatted into the record's text (truncated) so that
+    //  they share the emulator's log ring without allocating
+    auto *record = acquireLogRecord(log_level);
+    if (!record)
         return;
-    ClemensBackendOutputText logLine{
-        log_level,
-    };
-    logLine.text = fmt::format(msg, args...);
-    logOutput_.emplace_back(logLine);
+    auto result = fmt::format_to_n(record->text, sizeof(record->text) - 1, msg, args...);
+    *result.out = '\0';
+    ++logRing_.head;
+}
+
+ClemensLogRecord *ClemensBackend::acquireLogRecord(int log_level) {
+    if (logRing_.head - logRing_.tail >= logRing_.record_limit) {
+        ++logRing_.dropped;
+        return nullptr;
+    }
+    auto *record = &logRecords_[logRing_.head & (logRing_.record_limit - 1)];
+    record->clocks = machine_.tspec.clocks_spent;
+    record->fmt = nullptr;
+    record->level = uint8_t(log_level);
+    record->arg_count = 0;
+    return record;
 }
 
 ClemensBackend::ClemensBackend(std::string romPathname, const Config &config,
                                PublishStateDelegate publishDelegate)
-    : config_(config), slabMemory_(kSlabMemorySize, malloc(kSlabMemorySize)),
+    : config_(config), slabMemory_(kSlabMemorySize, malloc(kSlabMemorySize)), guestPages_{},
       interpreter_(cinek::FixedStack(kInterpreterMemorySize, malloc(kInterpreterMemorySize))),
-      breakpoints_(std::move(config_.breakpoints)), logLevel_(CLEM_DEBUG_LOG_INFO),
-      debugMemoryPage_(0x00), areInstructionsLogged_(false) {
+      logRecords_(kLogRecordLimit), breakpoints_(std::move(config_.breakpoints)),
+      videoCaptureVBLCounter_(0),
+      bramStore_(config_.bramPathname.empty() ? std::string("clem.bram") : config_.bramPathname),
+      inputTextOffset_(0), scriptWaitClocks_(0), scriptTimeoutClocks_(0),
+      scriptWaitVBLCounter_(0), scriptTimeoutCycles_(0),
+      logLevel_(CLEM_DEBUG_LOG_INFO), debugMemoryPage_(0x00),
+      areInstructionsLogged_(false) {
 
     diskContainers_.fill(ClemensWOZDisk{});
     diskDrives_.fill(ClemensBackendDiskDriveState{});
     smartPortDrives_.fill(ClemensBackendDiskDriveState{});
+    diskOverlayActions_.fill(DiskOverlayAction::None);
 
     loggedInstructions_.reserve(10000);
 
@@ -157,6 +101,11 @@ ClemensBackend::ClemensBackend(std::string romPathname, const Config &config,
     memset(&machine_, 0, sizeof(machine_));
     memset(&mmio_, 0, sizeof(mmio_));
     clemens_host_setup(&machine_, &ClemensBackend::emulatorLog, this);
+    memset(&logRing_, 0, sizeof(logRing_));
+    logRing_.records = logRecords_.data();
+    logRing_.record_limit = unsigned(logRecords_.size());
+    logRing_.min_level = logLevel_;
+    clemens_log_ring(&machine_, &logRing_);
 
     switch (config_.type) {
     case ClemensBackendConfig::Type::Apple2GS:
@@ -185,9 +134,14 @@ ClemensBackend::ClemensBackend(std::string romPathname, const Config &config,
     for (size_t driveIndex = 0; driveIndex < smartPortDrives_.size(); ++driveIndex) {
         if (smartPortDrives_[driveIndex].imagePath.empty())
             continue;
-        loadSmartPortDisk(driveIndex);
-        fmt::print("Loaded SmartPort image '{}' into drive {}\n",
-                   smartPortDrives_[driveIndex].imagePath, driveIndex);
+        if (!loadSmartPortDisk(driveIndex)) {
+            fmt::print("Failed to load SmartPort image '{}' into drive {}\n",
+                       smartPortDrives_[driveIndex].imagePath, driveIndex + 1);
+            smartPortDrives_[driveIndex].imagePath.clear();
+        } else {
+            fmt::print("Loaded SmartPort image '{}' into drive {}\n",
+                       smartPortDrives_[driveIndex].imagePath, driveIndex + 1);
+        }
     }
 
     //  Everything is ready for the main thread
@@ -198,6 +152,11 @@ ClemensBackend::~ClemensBackend() {
     terminate();
     runner_.join();
 
+    for (auto &mapping : diskMappings_) {
+        clem_host_unmap_file(&mapping);
+    }
+
+    clem_host_free_pages(&guestPages_);
     free(slabMemory_.getHead());
 }
 
@@ -264,6 +223,114 @@ void ClemensBackend::ejectDisk(const std::string_view &inputParam) {
     diskDrives_[driveType].isEjecting = true;
 }
 
+//  SmartPort units are hdd1 to hdd4
+//  Writes a new file and renames it over pathname, so that a failed write
+//  leaves the old file intact and anything mapping the old file (i.e. another
+//  drive or machine with the same image) keeps seeing its contents.
+static bool replaceFile(const std::string &pathname, const uint8_t *data, size_t dataSize) {
+    auto tempPathname = pathname + ".tmp";
+    FILE *fp = fopen(tempPathname.c_str(), "wb");
+    if (!fp)
+        return false;
+    bool isWritten = fwrite(data, 1, dataSize, fp) == dataSize && fflush(fp) == 0;
+#if defined(_WIN32)
+    isWritten = isWritten && _commit(_fileno(fp)) == 0;
+#else
+    isWritten = isWritten && fsync(fileno(fp)) == 0;
+#endif
+    isWritten = fclose(fp) == 0 && isWritten;
+    std::error_code errc;
+    if (isWritten) {
+        std::filesystem::rename(tempPathname, pathname, errc);
+        isWritten = !errc;
+    }
+    if (!isWritten) {
+        std::filesystem::remove(tempPathname, errc);
+    }
+    return isWritten;
+}
+
+static std::optional<unsigned> getSmartPortDriveIndex(const std::string_view &driveName) {
+    if (driveName.size() != 4 || driveName.substr(0, 3) != "hdd")
+        return std::nullopt;
+    unsigned unit = unsigned(driveName[3] - '0');
+    if (unit < 1 || unit > CLEM_SMARTPORT_DRIVE_LIMIT)
+        return std::nullopt;
+    return unit - 1;
+}
+
+void ClemensBackend::loadSymbols(std::string pathname) {
+    queue(Command{Command::LoadSymbols, std::move(pathname)});
+}
+
+void ClemensBackend::commitDisk(std::string driveName) {
+    queue(Command{Command::CommitDisk, std::move(driveName)});
+}
+
+void ClemensBackend::discardDisk(std::string driveName) {
+    queue(Command{Command::DiscardDisk, std::move(driveName)});
+}
+
+bool ClemensBackend::commitDiskOverlay(const std::string_view &driveName) {
+    return startDiskOverlayAction(driveName, DiskOverlayAction::Commit);
+}
+
+bool ClemensBackend::discardDiskOverlay(const std::string_view &driveName) {
+    return startDiskOverlayAction(driveName, DiskOverlayAction::Discard);
+}
+
+bool ClemensBackend::startDiskOverlayAction(const std::string_view &driveName,
+                                            DiskOverlayAction action) {
+    if (auto driveIndex = getSmartPortDriveIndex(driveName); driveIndex.has_value()) {
+        //  the guest isn't running, so the unit is between requests
+        auto &disk = smartPortDisks_[*driveIndex];
+        if (!disk.isOverlay())
+            return false;
+        return action == DiskOverlayAction::Commit ? disk.commit() : disk.discard();
+    }
+    auto driveType = ClemensDiskUtilities::getDriveType(driveName);
+    if (driveType == kClemensDrive_Invalid || !diskOverlays_[driveType].isAttached())
+        return false;
+    //  the drive must let go of the disk first, which can take a while for a
+    //  3.5" drive.  The disk is reinserted once the delta is dealt with.
+    diskOverlayActions_[driveType] = action;
+    diskDrives_[driveType].isEjecting = true;
+    return true;
+}
+
+bool ClemensBackend::finishDiskOverlayAction(ClemensDriveType driveType) {
+    auto action = diskOverlayActions_[driveType];
+    diskOverlayActions_[driveType] = DiskOverlayAction::None;
+    auto &overlay = diskOverlays_[driveType];
+    bool isDone;
+    if (action == DiskOverlayAction::Commit) {
+        //  the delta is brought up to date first, so nothing is lost if the
+        //  image can't be replaced
+        isDone = overlay.save(disks_[driveType]);
+        if (isDone) {
+            diskBuffer_.reset();
+            auto writeOut = diskBuffer_.forwardSize(diskBuffer_.getCapacity());
+            size_t writeOutCount = cinek::length(writeOut);
+            diskContainers_[driveType].nib = &disks_[driveType];
+            isDone = clem_woz_serialize(&diskContainers_[driveType], writeOut.first,
+                                        &writeOutCount);
+            unmapDisk(driveType);
+            if (isDone) {
+                auto imagePath = std::filesystem::path(config_.diskLibraryRootPath) /
+                                 diskDrives_[driveType].imagePath;
+                isDone = overlay.commit(imagePath.string(), writeOut.first, writeOutCount);
+            }
+        }
+    } else {
+        isDone = overlay.discard();
+    }
+    overlay.detach();
+    resetDisk(driveType);
+    if (!loadDisk(driveType, false))
+        return false;
+    return isDone;
+}
+
 void ClemensBackend::writeProtectDisk(ClemensDriveType driveType, bool wp) {
     queue(Command{Command::WriteProtectDisk,
                   fmt::format("{},{}", ClemensDiskUtilities::getDriveName(driveType), wp ? 1 : 0)});
@@ -309,6 +376,59 @@ void ClemensBackend::writeMemory(const std::string_view &inputParam) {
     clem_write(&machine_, value, addr, debugMemoryPage_, CLEM_MEM_FLAG_NULL);
 }
 
+void ClemensBackend::debugMemoryWriteBlock(uint32_t address, const uint8_t *data, size_t count) {
+    std::string operand = fmt::format("{:06X}:", address & 0xffffff);
+    operand.reserve(operand.size() + count * 2);
+    for (size_t index = 0; index < count; ++index) {
+        fmt::format_to(std::back_inserter(operand), "{:02X}", data[index]);
+    }
+    queue(Command{Command::WriteMemoryBlock, std::move(operand)});
+}
+
+bool ClemensBackend::writeMemoryBlock(const std::string_view &inputParam) {
+    auto sepPos = inputParam.find(':');
+    if (sepPos == std::string_view::npos)
+        return false;
+    uint32_t address;
+    if (std::from_chars(inputParam.data(), inputParam.data() + sepPos, address, 16).ec !=
+        std::errc{})
+        return false;
+    auto hex = inputParam.substr(sepPos + 1);
+    if (hex.size() % 2)
+        return false;
+    for (size_t index = 0; index < hex.size(); index += 2, ++address) {
+        uint8_t value;
+        if (std::from_chars(hex.data() + index, hex.data() + index + 2, value, 16).ec !=
+            std::errc{})
+            return false;
+        clem_write(&machine_, value, (uint16_t)(address & 0xffff), (uint8_t)(address >> 16),
+                   CLEM_MEM_FLAG_NULL);
+    }
+    return true;
+}
+
+void ClemensBackend::debugRegisterWrite(ClemensBackendMachineProperty property, uint32_t value) {
+    queue(Command{Command::WriteRegister, fmt::format("{}={}", unsigned(property), value)});
+}
+
+bool ClemensBackend::writeRegister(const std::string_view &inputParam) {
+    auto sepPos = inputParam.find('=');
+    if (sepPos == std::string_view::npos)
+        return false;
+    unsigned property;
+    uint32_t value;
+    if (std::from_chars(inputParam.data(), inputParam.data() + sepPos, property).ec !=
+            std::errc{} ||
+        property > unsigned(MachineProperty::RegPC))
+        return false;
+    auto valueStr = inputParam.substr(sepPos + 1);
+    if (std::from_chars(valueStr.data(), valueStr.data() + valueStr.size(), value).ec !=
+        std::errc{})
+        return false;
+    assignPropertyToU32(static_cast<MachineProperty>(property), value);
+    return true;
+}
+
 void ClemensBackend::debugLogLevel(int logLevel) {
     queue(Command{Command::DebugLogLevel, fmt::format("{}", logLevel)});
 }
@@ -322,6 +442,242 @@ void ClemensBackend::debugProgramTrace(std::string op, std::string path) {
                   fmt::format("{},{}", op, path.empty() ? "#" : path.c_str())});
 }
 
+void ClemensBackend::debugMemoryHeatmap(bool enable, int byteBank) {
+    if (!enable) {
+        queue(Command{Command::DebugMemoryHeatmap, "off"});
+    } else if (byteBank >= 0) {
+        queue(Command{Command::DebugMemoryHeatmap, fmt::format("on,{}", byteBank & 0xff)});
+    } else {
+        queue(Command{Command::DebugMemoryHeatmap, "on"});
+    }
+}
+
+bool ClemensBackend::memoryHeatmap(const std::string_view &inputParam) {
+    auto sepPos = inputParam.find(',');
+    auto op = inputParam.substr(0, sepPos);
+    if (op == "off") {
+        clemens_memory_access_counters(&machine_, nullptr);
+        accessCounters_ = nullptr;
+        accessByteCounters_ = nullptr;
+        return true;
+    }
+    if (op != "on") {
+        return false;
+    }
+    if (!accessCounters_) {
+        accessCounters_ = std::make_unique<ClemensMemoryAccessCounters>();
+    }
+    if (sepPos != std::string_view::npos) {
+        auto param = inputParam.substr(sepPos + 1);
+        unsigned bank;
+        if (std::from_chars(param.data(), param.data() + param.size(), bank).ec != std::errc{} ||
+            bank > 0xff) {
+            return false;
+        }
+        if (!accessByteCounters_) {
+            accessByteCounters_ = std::make_unique<uint32_t[]>(CLEM_IIGS_BANK_SIZE);
+        }
+        accessCounters_->byte_bank = (uint8_t)bank;
+        accessCounters_->bytes = accessByteCounters_.get();
+    } else {
+        accessCounters_->bytes = nullptr;
+        accessByteCounters_ = nullptr;
+    }
+    clemens_memory_access_counters(&machine_, accessCounters_.get());
+    return true;
+}
+
+void ClemensBackend::captureVideo(std::string format, std::string path) {
+    if (format == "off") {
+        queue(Command{Command::CaptureVideo, "off"});
+    } else {
+        queue(Command{Command::CaptureVideo, fmt::format("{},{}", format, path)});
+    }
+}
+
+bool ClemensBackend::videoCapture(const std::string_view &inputParam) {
+    auto sepPos = inputParam.find(',');
+    auto op = inputParam.substr(0, sepPos);
+    if (op == "off") {
+        if (!videoCapture_)
+            return false;
+        stopVideoCapture();
+        return true;
+    }
+    ClemensVideoCapture::Format format;
+    if (op == "png") {
+        format = ClemensVideoCapture::Format::PNG;
+    } else if (op == "y4m") {
+        format = ClemensVideoCapture::Format::Y4M;
+    } else {
+        return false;
+    }
+    if (sepPos == std::string_view::npos || sepPos + 1 == inputParam.size()) {
+        localLog(CLEM_DEBUG_LOG_WARN, "Video capture requires a path.");
+        return false;
+    }
+    if (videoCapture_) {
+        stopVideoCapture();
+    }
+    auto path = std::string(inputParam.substr(sepPos + 1));
+    videoCapture_ = std::make_unique<ClemensVideoCapture>(
+        format, path, config_.systemFontLoData, config_.systemFontHiData);
+    if (!videoCapture_->isOpen()) {
+        localLog(CLEM_DEBUG_LOG_WARN, "Unable to open {} for video capture.", path);
+        videoCapture_ = nullptr;
+        return false;
+    }
+    videoCaptureVBLCounter_ = mmio_.vgc.vbl_counter;
+    localLog(CLEM_DEBUG_LOG_INFO, "Capturing video to {}.", path);
+    return true;
+}
+
+void ClemensBackend::stopVideoCapture() {
+    videoCapture_->finish();
+    auto stats = videoCapture_->getStats();
+    if (stats.writeFailed) {
+        localLog(CLEM_DEBUG_LOG_WARN, "Video capture to {} failed writing frames.",
+                 videoCapture_->getPath());
+    }
+    uint64_t images = std::max<uint64_t>(stats.imagesSubmitted, 1);
+    localLog(CLEM_DEBUG_LOG_INFO, "Captured {} frames ({} images) to {}.", stats.framesWritten,
+             stats.imagesSubmitted, videoCapture_->getPath());
+    localLog(CLEM_DEBUG_LOG_INFO,
+             "Per image: {:.3f} ms submit, {:.3f} ms stalled, {:.3f} ms encode",
+             stats.submitNs * 1e-6 / images, stats.stallNs * 1e-6 / images,
+             stats.encodeNs * 1e-6 / images);
+    videoCapture_ = nullptr;
+}
+
+void ClemensBackend::captureAudio(std::string format, std::string path) {
+    if (format == "off") {
+        queue(Command{Command::CaptureAudio, "off"});
+    } else {
+        queue(Command{Command::CaptureAudio, fmt::format("{},{}", format, path)});
+    }
+}
+
+bool ClemensBackend::audioCapture(const std::string_view &inputParam) {
+    auto sepPos = inputParam.find(',');
+    auto op = inputParam.substr(0, sepPos);
+    if (op == "off") {
+        if (audioRecorder_) {
+            stopAudioCapture();
+        }
+        return true;
+    }
+    ClemensAudioRecorder::Format format;
+    if (op == "wav") {
+        format = ClemensAudioRecorder::Format::WAV;
+    } else if (op == "raw") {
+        format = ClemensAudioRecorder::Format::Raw;
+    } else {
+        return false;
+    }
+    if (sepPos == std::string_view::npos || sepPos + 1 == inputParam.size()) {
+        localLog(CLEM_DEBUG_LOG_WARN, "Audio capture requires a path.");
+        return false;
+    }
+    if (audioRecorder_) {
+        stopAudioCapture();
+    }
+    auto path = std::string(inputParam.substr(sepPos + 1));
+    audioRecorder_ = std::make_unique<ClemensAudioRecorder>(format, path);
+    if (!audioRecorder_->isOpen()) {
+        localLog(CLEM_DEBUG_LOG_WARN, "Unable to open {} for audio capture.", path);
+        audioRecorder_ = nullptr;
+        return false;
+    }
+    clemens_audio_capture(&mmio_, audioRecorder_->getCapture());
+    localLog(CLEM_DEBUG_LOG_INFO, "Capturing audio to {}.", path);
+    return true;
+}
+
+void ClemensBackend::stopAudioCapture() {
+    clemens_audio_capture(&mmio_, nullptr);
+    audioRecorder_->finish();
+    if (audioRecorder_->hasWriteFailed()) {
+        localLog(CLEM_DEBUG_LOG_WARN, "Audio capture to {} failed writing frames.",
+                 audioRecorder_->getPath());
+    }
+    localLog(CLEM_DEBUG_LOG_INFO, "Captured {} audio frames to {}.",
+             audioRecorder_->getFrameCount(), audioRecorder_->getPath());
+    audioRecorder_ = nullptr;
+}
+
+void ClemensBackend::serialPort(std::string port, std::string endpoint, std::string target) {
+    if (target.empty()) {
+        queue(Command{Command::SerialPort, fmt::format("{},{}", port, endpoint)});
+    } else {
+        queue(Command{Command::SerialPort, fmt::format("{},{},{}", port, endpoint, target)});
+    }
+}
+
+bool ClemensBackend::connectSerialPort(const std::string_view &inputParam) {
+    auto sepPos = inputParam.find(',');
+    if (sepPos == std::string_view::npos)
+        return false;
+    auto port = inputParam.substr(0, sepPos);
+    unsigned channel;
+    if (port == "a") {
+        channel = CLEM_SCC_CHANNEL_A;
+    } else if (port == "b") {
+        channel = CLEM_SCC_CHANNEL_B;
+    } else {
+        return false;
+    }
+    auto endpoint = inputParam.substr(sepPos + 1);
+    sepPos = endpoint.find(',');
+    auto target = sepPos != std::string_view::npos ? endpoint.substr(sepPos + 1) : "";
+    endpoint = endpoint.substr(0, sepPos);
+
+    ClemensSerialPort::Type type;
+    if (endpoint == "off") {
+        if (serialPorts_[channel]) {
+            disconnectSerialPort(channel);
+        }
+        return true;
+    } else if (endpoint == "loopback") {
+        type = ClemensSerialPort::Type::Loopback;
+    } else if (endpoint == "pty") {
+        type = ClemensSerialPort::Type::Pty;
+    } else if (endpoint == "file") {
+        type = ClemensSerialPort::Type::File;
+    } else if (endpoint == "tcp") {
+        type = ClemensSerialPort::Type::Socket;
+    } else {
+        return false;
+    }
+    if ((type == ClemensSerialPort::Type::File || type == ClemensSerialPort::Type::Socket) &&
+        target.empty()) {
+        localLog(CLEM_DEBUG_LOG_WARN, "Serial {} endpoint requires a target.", endpoint);
+        return false;
+    }
+    if (serialPorts_[channel]) {
+        disconnectSerialPort(channel);
+    }
+    auto serialPort = std::make_unique<ClemensSerialPort>(type, std::string(target));
+    if (!serialPort->isOpen()) {
+        localLog(CLEM_DEBUG_LOG_WARN, "Unable to open serial {} endpoint {}.", endpoint, target);
+        return false;
+    }
+    localLog(CLEM_DEBUG_LOG_INFO, "Serial port {} connected to {} {}.", port, endpoint,
+             serialPort->getName());
+    serialPorts_[channel] = std::move(serialPort);
+    return true;
+}
+
+void ClemensBackend::disconnectSerialPort(unsigned channel) {
+    auto &serialPort = serialPorts_[channel];
+    //  pass along anything the guest sent before disconnecting
+    serialPort->transfer(mmio_, channel);
+    clemens_serial_connect(&mmio_, channel, false);
+    localLog(CLEM_DEBUG_LOG_INFO, "Serial port {} sent {}, received {} and dropped {} bytes.",
+             channel == CLEM_SCC_CHANNEL_A ? "a" : "b", serialPort->getBytesSent(),
+             serialPort->getBytesReceived(), serialPort->getBytesDropped());
+    serialPort = nullptr;
+}
+
 bool ClemensBackend::programTrace(const std::string_view &inputParam) {
     auto sepPos = inputParam.find(',');
     auto op = inputParam.substr(0, sepPos);
@@ -334,10 +690,19 @@ bool ClemensBackend::programTrace(const std::string_view &inputParam) {
         param = std::string_view();
     }
     auto path = param;
+    if (programTrace_ != nullptr &&
+        (op == "index" || op == "seek" || op == "pc" || op == "write")) {
+        return programTraceQuery(op, param);
+    }
+    if (programTrace_ != nullptr && op == "toolbox") {
+        return programTraceToolbox(param);
+    }
     if (programTrace_ == nullptr && op == "on") {
         nextTraceSeq_ = 0;
         programTrace_ = std::make_unique<ClemensProgramTrace>();
+        programTrace_->setSymbols(&symbols_);
         programTrace_->enableToolboxLogging(true);
+        clemens_toolbox_log(&machine_, programTrace_->getToolboxLog());
         fmt::print("Program trace enabled\n");
         return true;
     }
@@ -356,6 +721,8 @@ bool ClemensBackend::programTrace(const std::string_view &inputParam) {
     }
     if (programTrace_ != nullptr && op == "off") {
         fmt::print("Program trace disabled\n");
+        clemens_memory_write_log(&machine_, nullptr);
+        clemens_toolbox_log(&machine_, nullptr);
         programTrace_ = nullptr;
     }
     if (programTrace_) {
@@ -369,6 +736,133 @@ bool ClemensBackend::programTrace(const std::string_view &inputParam) {
     return ok;
 }
 
+//  accepts BB:AAAA, BB/AAAA or a 24-bit hex address
+static bool parseTraceAddress(std::string_view token, uint32_t &addr) {
+    auto sepPos = token.find_first_of(":/");
+    if (sepPos != std::string_view::npos) {
+        uint8_t bank;
+        uint16_t adr;
+        auto adrToken = token.substr(sepPos + 1);
+        if (std::from_chars(token.data(), token.data() + sepPos, bank, 16).ec != std::errc{} ||
+            std::from_chars(adrToken.data(), adrToken.data() + adrToken.size(), adr, 16).ec !=
+                std::errc{}) {
+            return false;
+        }
+        addr = (uint32_t(bank) << 16) | adr;
+        return true;
+    }
+    return std::from_chars(token.data(), token.data() + token.size(), addr, 16).ec ==
+               std::errc{} &&
+           addr < 0x1000000;
+}
+
+bool ClemensBackend::programTraceQuery(const std::string_view &op, const std::string_view &param) {
+    if (op == "index") {
+        if (programTrace_->getIndex()) {
+            clemens_memory_write_log(&machine_, nullptr);
+            programTrace_->disableIndex();
+            localLog(CLEM_DEBUG_LOG_INFO, "Trace index disabled");
+            return true;
+        }
+        auto indexPath = std::filesystem::path(CLEM_HOST_TRACES_DIR) / "index";
+        auto *index = programTrace_->enableIndex(indexPath.string().c_str());
+        if (!index) {
+            localLog(CLEM_DEBUG_LOG_WARN, "Unable to create the trace index in {}",
+                     indexPath.string());
+            return false;
+        }
+        clemens_memory_write_log(&machine_, index->getWriteLog());
+        localLog(CLEM_DEBUG_LOG_INFO, "Trace index enabled");
+        return true;
+    }
+    auto *index = programTrace_->getIndex();
+    if (!index) {
+        localLog(CLEM_DEBUG_LOG_WARN, "Trace index is not enabled");
+        return false;
+    }
+
+    auto sepPos = param.find(',');
+    auto first = param.substr(0, sepPos);
+    auto second = sepPos != std::string_view::npos ? param.substr(sepPos + 1) : std::string_view();
+    std::optional<uint64_t> seq;
+    if (op == "seek") {
+        uint64_t value;
+        if (std::from_chars(first.data(), first.data() + first.size(), value).ec != std::errc{})
+            return false;
+        seq = value;
+    } else {
+        uint32_t addr;
+        if (!parseTraceAddress(first, addr))
+            return false;
+        if (op == "pc") {
+            uint64_t nth = 1;
+            if (!second.empty() &&
+                std::from_chars(second.data(), second.data() + second.size(), nth).ec !=
+                    std::errc{}) {
+                return false;
+            }
+            seq = index->findExecution(addr, nth);
+        } else {
+            uint64_t before = UINT64_MAX;
+            if (!second.empty() &&
+                std::from_chars(second.data(), second.data() + second.size(), before).ec !=
+                    std::errc{}) {
+                return false;
+            }
+            seq = index->findLastWrite(addr, before);
+        }
+    }
+
+    ClemensTraceIndex::Record record;
+    if (!seq.has_value() || !index->seek(*seq, record)) {
+        localLog(CLEM_DEBUG_LOG_INFO, "No matching instruction in {} traced",
+                 index->getInstructionCount());
+        return true;
+    }
+    auto line = fmt::format("{}: {:02X}:{:04X} {} ${:04X} A={:04X} X={:04X} Y={:04X} D={:04X} "
+                            "S={:04X} P={:02X} DBR={:02X} e={}",
+                            record.seq, record.regs.PBR, record.regs.PC,
+                            index->getOpcodeName(record.opcode), record.value, record.regs.A,
+                            record.regs.X, record.regs.Y, record.regs.D, record.regs.S,
+                            record.regs.P, record.regs.DBR, record.emulation ? 1 : 0);
+    for (unsigned i = 0; i < record.writeCount; ++i) {
+        line += fmt::format(" {:02X}/{:04X}={:02X}", record.writeAddrs[i] >> 16,
+                            record.writeAddrs[i] & 0xffff, record.writeData[i]);
+    }
+    localLog(CLEM_DEBUG_LOG_INFO, "{}", line);
+    return true;
+}
+
+bool ClemensBackend::programTraceToolbox(const std::string_view &param) {
+    if (!param.empty()) {
+        unsigned paramCount;
+        if (std::from_chars(param.data(), param.data() + param.size(), paramCount).ec !=
+            std::errc{}) {
+            localLog(CLEM_DEBUG_LOG_WARN, "Invalid toolbox parameter byte count '{}'", param);
+            return false;
+        }
+        programTrace_->setToolboxParamCount(paramCount);
+        localLog(CLEM_DEBUG_LOG_INFO, "Capturing {} stack bytes per toolbox call",
+                 programTrace_->getToolboxLog()->param_count);
+        return true;
+    }
+    programTrace_->consumeToolboxLog();
+    auto profile = programTrace_->getToolboxProfile();
+    if (profile.empty()) {
+        localLog(CLEM_DEBUG_LOG_INFO, "No toolbox calls traced");
+        return true;
+    }
+    constexpr size_t kToolboxProfileLines = 16;
+    localLog(CLEM_DEBUG_LOG_INFO, "  CALL    COUNT      FAST CYCLES TOOLSET");
+    for (size_t i = 0; i < std::min(profile.size(), kToolboxProfileLines); ++i) {
+        auto &entry = profile[i];
+        localLog(CLEM_DEBUG_LOG_INFO, " #{:04X} {:8} {:16} {}", entry.call, entry.count,
+                 entry.clocks / CLEM_CLOCKS_FAST_CYCLE,
+                 ClemensProgramTrace::getToolsetName(entry.call));
+    }
+    return true;
+}
+
 void ClemensBackend::saveMachine(std::string path) {
     queue(Command{Command::SaveMachine, std::move(path)});
 }
@@ -387,10 +881,33 @@ void ClemensBackend::loadMachine(std::string path) {
 
 bool ClemensBackend::loadSnapshot(const std::string_view &inputParam) {
     auto outputPath = std::filesystem::path(CLEM_HOST_SNAPSHOT_DIR) / inputParam;
+    if (!ClemensSerializer::isCompatible(outputPath.string())) {
+        localLog(CLEM_DEBUG_LOG_WARN, "Snapshot {} is missing or from another version.",
+                 outputPath.string());
+        return false;
+    }
+    //  the snapshot's disks are unserialized into each drive's local storage,
+    //  so mapped images are released first rather than written over and left
+    //  behind the restored tracks
+    for (size_t driveIndex = 0; driveIndex < diskDrives_.size(); ++driveIndex) {
+        unmapDisk(static_cast<ClemensDriveType>(driveIndex));
+    }
     bool res = ClemensSerializer::load(
         outputPath.string(), &machine_, &mmio_, diskContainers_.size(), diskContainers_.data(),
         diskDrives_.data(), CLEM_SMARTPORT_DRIVE_LIMIT, smartPortDisks_.data(),
         smartPortDrives_.data(), breakpoints_, &ClemensBackend::unserializeAllocate, this);
+    //  the restored disks are written to their deltas in full, since what
+    //  changed relative to the images isn't known
+    for (size_t driveIndex = 0; driveIndex < diskDrives_.size(); ++driveIndex) {
+        diskOverlays_[driveIndex].detach();
+        diskOverlayActions_[driveIndex] = DiskOverlayAction::None;
+        if (!res || config_.overlayPath.empty() || diskDrives_[driveIndex].imagePath.empty())
+            continue;
+        diskOverlays_[driveIndex].reattach(ClemensDiskTrackOverlay::getDeltaPathname(
+            config_.overlayPath, diskDrives_[driveIndex].imagePath));
+    }
+    //  all of memory was replaced and must be resent to the frontend
+    clemens_touch_all_pages(&machine_);
     saveBRAM();
     return res;
 }
@@ -402,7 +919,7 @@ void ClemensBackend::runScript(std::string command) {
 bool ClemensBackend::runScriptCommand(const std::string_view &command) {
     auto result = interpreter_.parse(command);
     if (result.type == ClemensInterpreter::Result::Ok) {
-        interpreter_.execute(this);
+        return interpreter_.execute(this);
     } else if (result.type == ClemensInterpreter::Result::SyntaxError) {
         // CLEM_TERM_COUT.print(TerminalLine::Error, "Syntax Error");
         return false;
@@ -412,6 +929,139 @@ bool ClemensBackend::runScriptCommand(const std::string_view &command) {
     }
     return true;
 }
+
+void ClemensBackend::runScriptFile(std::string pathname) {
+    queue(Command{Command::RunScriptFile, std::move(pathname)});
+}
+
+bool ClemensBackend::startScriptFile(const std::string_view &pathname) {
+    auto script = std::make_unique<ClemensBatchScript>();
+    if (!script->load(std::string(pathname))) {
+        localLog(CLEM_DEBUG_LOG_WARN, "Unable to load script {}", pathname);
+        finishScriptFile(false);
+        return false;
+    }
+    batchScript_ = std::move(script);
+    scriptWait_ = std::nullopt;
+    scriptTimeoutCycles_ = 0;
+    localLog(CLEM_DEBUG_LOG_INFO, "Running script {}", pathname);
+    return true;
+}
+
+void ClemensBackend::continueScriptFile() {
+    //  statements run back to back until one waits on the machine
+    std::string_view statement;
+    while (batchScript_ && !scriptWait_.has_value()) {
+        if (!batchScript_->next(statement)) {
+            localLog(CLEM_DEBUG_LOG_INFO, "Script {} finished", batchScript_->getName());
+            finishScriptFile(true);
+            break;
+        }
+        if (!runScriptCommand(statement)) {
+            localLog(CLEM_DEBUG_LOG_WARN, "{}:{}: failed '{}'", batchScript_->getName(),
+                     batchScript_->getLineNumber(), statement);
+            finishScriptFile(false);
+        }
+    }
+}
+
+void ClemensBackend::finishScriptFile(bool succeeded) {
+    batchScript_ = nullptr;
+    scriptWait_ = std::nullopt;
+    scriptResult_ = succeeded;
+}
+
+bool ClemensBackend::checkScriptWait() {
+    //  called after every instruction while waiting, so only the text condition
+    //  (checked once per frame) does more than a compare
+    auto &condition = *scriptWait_;
+    bool isMet = false;
+    switch (condition.type) {
+    case ClemensScriptCondition::Type::PC:
+        isMet = ((uint32_t(machine_.cpu.regs.PBR) << 16) | machine_.cpu.regs.PC) ==
+                condition.address;
+        break;
+    case ClemensScriptCondition::Type::Memory: {
+        uint8_t value;
+        isMet = peekMemory(&machine_, condition.address, value) && value == condition.value;
+        break;
+    }
+    case ClemensScriptCondition::Type::Cycles:
+        isMet = machine_.tspec.clocks_spent >= scriptWaitClocks_;
+        break;
+    case ClemensScriptCondition::Type::Text:
+        if (mmio_.vgc.vbl_counter != scriptWaitVBLCounter_) {
+            scriptWaitVBLCounter_ = mmio_.vgc.vbl_counter;
+            readScreenText(&machine_, &mmio_, scriptScreenRows_);
+            for (auto &row : scriptScreenRows_) {
+                if (row.find(condition.text) != std::string::npos) {
+                    isMet = true;
+                    break;
+                }
+            }
+        }
+        break;
+    }
+    if (isMet) {
+        scriptWait_ = std::nullopt;
+        return true;
+    }
+    if (scriptTimeoutCycles_ > 0 && machine_.tspec.clocks_spent >= scriptTimeoutClocks_) {
+        localLog(CLEM_DEBUG_LOG_WARN, "{}:{}: wait timed out",
+                 batchScript_ ? batchScript_->getName() : std::string("script"),
+                 batchScript_ ? batchScript_->getLineNumber() : 0);
+        if (batchScript_) {
+            finishScriptFile(false);
+        } else {
+            scriptWait_ = std::nullopt;
+        }
+        return true;
+    }
+    return false;
+}
+
+bool ClemensBackend::scriptWait(const ClemensScriptCondition &condition) {
+    if (condition.type == ClemensScriptCondition::Type::Memory) {
+        uint8_t value;
+        if (!peekMemory(&machine_, condition.address, value))
+            return false;
+    } else if (condition.type == ClemensScriptCondition::Type::Text) {
+        if (condition.text.empty())
+            return false;
+    }
+    const clem_clocks_duration_t kClocksPerCycle = CLEM_CLOCKS_MEGA2_CYCLE;
+    scriptWait_ = condition;
+    scriptWaitClocks_ = machine_.tspec.clocks_spent + condition.cycles * kClocksPerCycle;
+    scriptTimeoutClocks_ = machine_.tspec.clocks_spent + scriptTimeoutCycles_ * kClocksPerCycle;
+    //  the text already on screen counts
+    scriptWaitVBLCounter_ = mmio_.vgc.vbl_counter - 1;
+    return true;
+}
+
+void ClemensBackend::scriptTimeout(uint64_t cycles) { scriptTimeoutCycles_ = cycles; }
+
+void ClemensBackend::scriptType(std::string text) { typeText(text); }
+
+void ClemensBackend::scriptKey(uint8_t adbKeyCode) {
+    ClemensInputEvent input{};
+    input.type = kClemensInputType_KeyDown;
+    input.value_a = adbKeyCode;
+    clemens_input(&mmio_, &input);
+    input.type = kClemensInputType_KeyUp;
+    clemens_input(&mmio_, &input);
+}
+
+bool ClemensBackend::scriptExpect(uint32_t address, uint8_t value) {
+    uint8_t actual;
+    if (!peekMemory(&machine_, address, actual))
+        return false;
+    if (actual != value) {
+        localLog(CLEM_DEBUG_LOG_WARN, "expected {:02X} at {:02X}/{:04X}, found {:02X}", value,
+                 address >> 16, address & 0xffff, actual);
+        return false;
+    }
+    return true;
+}
 //  TODO: Move into Clemens API clemens_mmio_find_card_name()
 static ClemensCard *findMockingboardCard(ClemensMMIO *mmio) {
     for (int cardIdx = 0; cardIdx < 7; ++cardIdx) {
@@ -436,28 +1086,37 @@ uint8_t *ClemensBackend::unserializeAllocate(unsigned sz, void *context) {
 }
 
 bool ClemensBackend::loadDisk(ClemensDriveType driveType, bool allowBlank) {
-    diskBuffer_.reset();
+    unmapDisk(driveType);
     auto imagePath =
         std::filesystem::path(config_.diskLibraryRootPath) / diskDrives_[driveType].imagePath;
-    std::ifstream input(imagePath, std::ios_base::in | std::ios_base::binary);
-    if (input.is_open()) {
-        input.seekg(0, std::ios_base::end);
-        size_t inputImageSize = input.tellg();
-        if (inputImageSize <= (size_t)diskBuffer_.getCapacity()) {
-            auto bits = diskBuffer_.forwardSize(inputImageSize);
-            input.seekg(0);
-            input.read((char *)bits.first, inputImageSize);
-            if (input.good()) {
-                diskContainers_[driveType].nib = &disks_[driveType];
-                auto parseBuffer = cinek::ConstCastRange<uint8_t>(bits);
-                if (ClemensDiskUtilities::parseWOZ(&diskContainers_[driveType], parseBuffer)) {
-                    if (clemens_assign_disk(&mmio_, driveType, &disks_[driveType])) {
-                        return true;
-                    }
+    //  The image is mapped copy-on-write rather than read into a buffer so that
+    //  track data is only paged in as the drive head visits it.  Emulated writes
+    //  dirty private pages and are committed to the file by saveDisk on eject.
+    auto &mapping = diskMappings_[driveType];
+    if (clem_host_map_file_private(&mapping, imagePath.string().c_str())) {
+        //  saveDisk serializes into diskBuffer_, so the image must fit there
+        if (mapping.size <= (size_t)diskBuffer_.getCapacity()) {
+            diskContainers_[driveType].nib = &disks_[driveType];
+            cinek::Range<uint8_t> mapBuffer(mapping.data, mapping.data + mapping.size);
+            if (ClemensDiskUtilities::mapWOZ(&diskContainers_[driveType], mapBuffer)) {
+                //  with an overlay, the delta's tracks replace the mapped ones
+                //  and the image is never written
+                bool isAttached =
+                    config_.overlayPath.empty() ||
+                    diskOverlays_[driveType].attach(
+                        ClemensDiskTrackOverlay::getDeltaPathname(
+                            config_.overlayPath, diskDrives_[driveType].imagePath),
+                        disks_[driveType]);
+                if (isAttached && clemens_assign_disk(&mmio_, driveType, &disks_[driveType])) {
+                    return true;
                 }
+                diskOverlays_[driveType].detach();
             }
         }
-    } else if (allowBlank) {
+        unmapDisk(driveType);
+    }
+    //  a blank disk is requested for a missing image or one that isn't usable
+    if (allowBlank) {
         resetDisk(driveType);
         if (ClemensDiskUtilities::createWOZ(&diskContainers_[driveType], &disks_[driveType])) {
             if (clemens_assign_disk(&mmio_, driveType, &disks_[driveType])) {
@@ -470,7 +1129,23 @@ bool ClemensBackend::loadDisk(ClemensDriveType driveType, bool allowBlank) {
     return false;
 }
 
+void ClemensBackend::unmapDisk(ClemensDriveType driveType) {
+    auto &mapping = diskMappings_[driveType];
+    if (!mapping.data)
+        return;
+    clem_host_unmap_file(&mapping);
+    //  point the disk back at its local storage for blank disks and the next load
+    disks_[driveType].bits_data = diskLocalStorage_[driveType].first;
+    disks_[driveType].bits_data_end = diskLocalStorage_[driveType].second;
+}
+
 bool ClemensBackend::saveDisk(ClemensDriveType driveType) {
+    if (diskOverlays_[driveType].isAttached()) {
+        bool isSaved = diskOverlays_[driveType].save(disks_[driveType]);
+        diskOverlays_[driveType].detach();
+        unmapDisk(driveType);
+        return isSaved;
+    }
     diskBuffer_.reset();
     auto writeOut = diskBuffer_.forwardSize(diskBuffer_.getCapacity());
 
@@ -479,20 +1154,17 @@ bool ClemensBackend::saveDisk(ClemensDriveType driveType) {
     if (!clem_woz_serialize(&diskContainers_[driveType], writeOut.first, &writeOutCount)) {
         return false;
     }
+    //  the image has been copied out of the mapping, which is released before
+    //  its file is replaced (required on Windows)
+    unmapDisk(driveType);
 
     auto imagePath =
         std::filesystem::path(config_.diskLibraryRootPath) / diskDrives_[driveType].imagePath;
-
-    std::ofstream out(imagePath, std::ios_base::out | std::ios_base::binary);
-    if (out.fail())
-        return false;
-    out.write((char *)writeOut.first, writeOutCount);
-    if (out.fail() || out.bad())
-        return false;
-    return true;
+    return replaceFile(imagePath.string(), writeOut.first, writeOutCount);
 }
 
 void ClemensBackend::resetDisk(ClemensDriveType driveType) {
+    unmapDisk(driveType);
     auto &nib = disks_[driveType];
     unsigned max_track_size_bytes = 0, track_byte_offset = 0;
 
@@ -570,54 +1242,104 @@ void ClemensBackend::resetDisk(ClemensDriveType driveType) {
     }
 }
 
-void ClemensBackend::loadSmartPortDisk(unsigned driveIndex) {
-    //  load into our HDD slot
+bool ClemensBackend::loadSmartPortDisk(unsigned driveIndex) {
+    //  load into our HDD slot - blocks are read in by the disk's I/O thread, and
+    //  a missing image is created.  A directory is mounted as a ProDOS volume.
     auto imagePath =
         std::filesystem::path(config_.diskLibraryRootPath) / smartPortDrives_[driveIndex].imagePath;
-    std::ifstream input(imagePath, std::ios_base::in | std::ios_base::binary);
-    if (input.is_open()) {
-        auto sz = input.seekg(0, std::ios_base::end).tellg();
-        std::vector<uint8_t> buffer(sz);
-        input.seekg(0);
-        input.read((char *)buffer.data(), sz);
-        smartPortDisks_[driveIndex] = ClemensSmartPortDisk(std::move(buffer));
-    } else {
-        smartPortDisks_[driveIndex] = ClemensSmartPortDisk(
-            std::move(ClemensSmartPortDisk::createData(kSmartPortDiskBlockCount)));
+    std::error_code errc;
+    if (std::filesystem::is_directory(imagePath, errc)) {
+        if (!smartPortDisks_[driveIndex].openDirectory(imagePath.string(),
+                                                       config_.smartPortWriteBack))
+            return false;
+    } else if (!config_.overlayPath.empty() && std::filesystem::exists(imagePath, errc)) {
+        //  a new image is still created as usual, since there is no master yet
+        if (!smartPortDisks_[driveIndex].openOverlay(
+                imagePath.string(),
+                ClemensDiskTrackOverlay::getDeltaPathname(config_.overlayPath,
+                                                          smartPortDrives_[driveIndex].imagePath)))
+            return false;
+    } else if (!smartPortDisks_[driveIndex].open(imagePath.string(), kSmartPortDiskBlockCount)) {
+        return false;
     }
     ClemensSmartPortDevice device;
     clemens_assign_smartport_disk(&mmio_, driveIndex,
                                   smartPortDisks_[driveIndex].createSmartPortDevice(&device));
+    return true;
 }
 
 bool ClemensBackend::saveSmartPortDisk(unsigned driveIndex) {
-    auto &drive = smartPortDrives_[driveIndex];
-    auto &disk = smartPortDisks_[driveIndex].getDisk();
-    auto imagePath = std::filesystem::path(config_.diskLibraryRootPath) / drive.imagePath;
-    std::ofstream out(imagePath, std::ios_base::out | std::ios_base::binary);
-    if (out.fail())
-        return false;
-    out.write((char *)disk.image_buffer, disk.image_buffer_length);
-    if (out.fail() || out.bad())
-        return false;
-    return true;
+    //  modified blocks are written back as the guest goes, so this only waits
+    //  on the ones still in flight
+    return smartPortDisks_[driveIndex].close();
 }
 
 static const char *sInputKeys[] = {"",      "keyD", "keyU",   "mouseD", "mouseU",
                                    "mouse", "padl", "nopadl", NULL};
 
+static int16_t addMouseDelta(int16_t a, int16_t b) {
+    return int16_t(std::clamp(int(a) + int(b), int(INT16_MIN), int(INT16_MAX)));
+}
+
 void ClemensBackend::inputEvent(const ClemensInputEvent &input) {
     CK_ASSERT_RETURN(*sInputKeys[input.type] != '\0');
-    Command cmd{Command::Input};
-    if (input.type == kClemensInputType_Paddle ||
-        input.type == kClemensInputType_PaddleDisconnected) {
-        cmd.operand = fmt::format("{}={},{},{}", sInputKeys[input.type], input.value_a,
-                                  input.value_b, input.gameport_button_mask);
-    } else {
-        cmd.operand = fmt::format("{}={},{},{}", sInputKeys[input.type], input.value_a,
-                                  input.value_b, input.adb_key_toggle_mask);
+    {
+        std::lock_guard<std::mutex> queuelock(commandQueueMutex_);
+        //  the emulator accumulates motion between ADB polls anyway, so a burst
+        //  of host mouse moves only needs one event
+        if (input.type == kClemensInputType_MouseMove && !inputEvents_.empty()) {
+            auto &last = inputEvents_.back();
+            if (last.type == kClemensInputType_MouseMove &&
+                last.adb_key_toggle_mask == input.adb_key_toggle_mask) {
+                last.value_a = addMouseDelta(last.value_a, input.value_a);
+                last.value_b = addMouseDelta(last.value_b, input.value_b);
+                return;
+            }
+        }
+        inputEvents_.emplace_back(input);
+    }
+    commandQueueCondition_.notify_one();
+}
+
+void ClemensBackend::inputText(std::string text) {
+    queue(Command{Command::InputText, std::move(text)});
+}
+
+void ClemensBackend::typeText(const std::string_view &text) {
+    if (text.empty()) {
+        inputText_.clear();
+        inputTextOffset_ = 0;
+        clemens_input_text_clear(&mmio_);
+        return;
+    }
+    //  a paste is typed after any text still in progress
+    inputText_.erase(0, inputTextOffset_);
+    inputTextOffset_ = 0;
+    inputText_.reserve(inputText_.size() + text.size());
+    for (size_t i = 0; i < text.size(); ++i) {
+        char ch = text[i];
+        if (ch == '\r' || ch == '\n') {
+            if (ch == '\r' && i + 1 < text.size() && text[i + 1] == '\n') {
+                ++i;
+            }
+            inputText_.push_back('\r');
+        } else if (ch == '\t') {
+            inputText_.push_back(' ');
+        } else if (ch >= 0x20 && ch < 0x7f) {
+            inputText_.push_back(ch);
+        }
+    }
+}
+
+void ClemensBackend::transferInputText() {
+    if (inputTextOffset_ >= inputText_.size())
+        return;
+    auto *text = (const uint8_t *)inputText_.data() + inputTextOffset_;
+    inputTextOffset_ += clemens_input_text(&mmio_, text, unsigned(inputText_.size() - inputTextOffset_));
+    if (inputTextOffset_ >= inputText_.size()) {
+        inputText_.clear();
+        inputTextOffset_ = 0;
     }
-    queue(cmd);
 }
 
 #if defined(__GNUC__)
@@ -763,6 +1485,28 @@ static int64_t calculateClocksPerTimeslice(ClemensMMIO *mmio, unsigned hz) {
 #pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
 #endif
 
+void ClemensBackend::applyThreadConfig() {
+    if (config_.runnerProcessor.has_value()) {
+        if (clem_host_thread_set_processor(*config_.runnerProcessor)) {
+            localLog(CLEM_DEBUG_LOG_INFO, "Emulator thread pinned to CPU {}",
+                     *config_.runnerProcessor);
+        } else {
+            localLog(CLEM_DEBUG_LOG_WARN, "Unable to pin the emulator thread to CPU {}",
+                     *config_.runnerProcessor);
+        }
+    }
+    if (config_.runnerPriority != kClemensHostThreadPriority_Normal) {
+        auto priority = clem_host_thread_set_priority(config_.runnerPriority);
+        if (priority != config_.runnerPriority) {
+            localLog(CLEM_DEBUG_LOG_WARN, "Emulator thread priority limited to {}",
+                     getThreadPriorityName(priority));
+        } else {
+            localLog(CLEM_DEBUG_LOG_INFO, "Emulator thread priority is {}",
+                     getThreadPriorityName(priority));
+        }
+    }
+}
+
 void ClemensBackend::main(PublishStateDelegate publishDelegate) {
     int64_t clocksRemainingInTimeslice = 0;
     std::optional<int> stepsRemaining = 0;
@@ -782,6 +1526,7 @@ void ClemensBackend::main(PublishStateDelegate publishDelegate) {
     }
 
     fmt::print("Starting backend thread.\n");
+    applyThreadConfig();
 
     ClemensCard *mockingboard = findMockingboardCard(&mmio_);
     uint64_t publishSeqNo = 0;
@@ -798,11 +1543,14 @@ void ClemensBackend::main(PublishStateDelegate publishDelegate) {
         bool isRunning = !stepsRemaining.has_value() || *stepsRemaining > 0;
         bool publishState = false;
         bool updateSeqNo = false;
+        bool wasScriptWaiting = scriptWait_.has_value();
 
         std::unique_lock<std::mutex> queuelock(commandQueueMutex_);
         if (!isRunning) {
             //  waiting for commands
-            commandQueueCondition_.wait(queuelock, [this] { return !commandQueue_.empty(); });
+            commandQueueCondition_.wait(queuelock, [this] {
+                return !commandQueue_.empty() || !inputEvents_.empty();
+            });
         }
         //  TODO: we may just be able to use a vector for the command queue and
         //        create a local copy of the queue to minimize time spent executing
@@ -864,6 +1612,9 @@ void ClemensBackend::main(PublishStateDelegate publishDelegate) {
             case Command::Input:
                 inputMachine(command.operand);
                 break;
+            case Command::InputText:
+                typeText(command.operand);
+                break;
             case Command::Break:
                 stepsRemaining = 0;
                 break;
@@ -881,8 +1632,17 @@ void ClemensBackend::main(PublishStateDelegate publishDelegate) {
             case Command::WriteMemory:
                 writeMemory(command.operand);
                 break;
+            case Command::WriteMemoryBlock:
+                if (!writeMemoryBlock(command.operand))
+                    commandFailed = true;
+                break;
+            case Command::WriteRegister:
+                if (!writeRegister(command.operand))
+                    commandFailed = true;
+                break;
             case Command::DebugLogLevel:
                 logLevel_ = (int)(std::stol(command.operand));
+                logRing_.min_level = logLevel_;
                 break;
             case Command::DebugMessage:
                 debugMessage = std::move(command.operand);
@@ -891,6 +1651,22 @@ void ClemensBackend::main(PublishStateDelegate publishDelegate) {
                 if (!programTrace(command.operand))
                     commandFailed = true;
                 break;
+            case Command::DebugMemoryHeatmap:
+                if (!memoryHeatmap(command.operand))
+                    commandFailed = true;
+                break;
+            case Command::CaptureVideo:
+                if (!videoCapture(command.operand))
+                    commandFailed = true;
+                break;
+            case Command::CaptureAudio:
+                if (!audioCapture(command.operand))
+                    commandFailed = true;
+                break;
+            case Command::SerialPort:
+                if (!connectSerialPort(command.operand))
+                    commandFailed = true;
+                break;
             case Command::SaveMachine:
                 if (!saveSnapshot(command.operand))
                     commandFailed = true;
@@ -910,6 +1686,28 @@ void ClemensBackend::main(PublishStateDelegate publishDelegate) {
                     commandFailed = true;
                 }
                 break;
+            case Command::RunScriptFile:
+                if (!startScriptFile(command.operand)) {
+                    commandFailed = true;
+                }
+                break;
+            case Command::CommitDisk:
+                if (!commitDiskOverlay(command.operand)) {
+                    commandFailed = true;
+                }
+                break;
+            case Command::DiscardDisk:
+                if (!discardDiskOverlay(command.operand)) {
+                    commandFailed = true;
+                }
+                break;
+            case Command::LoadSymbols:
+                if (command.operand.empty()) {
+                    symbols_.clear();
+                } else if (!symbols_.load(command.operand)) {
+                    commandFailed = true;
+                }
+                break;
             case Command::Undefined:
                 break;
             }
@@ -917,6 +1715,12 @@ void ClemensBackend::main(PublishStateDelegate publishDelegate) {
                 commandType = command.type;
             }
         }
+        if (clemens_is_initialized_simple(&machine_)) {
+            for (auto &input : inputEvents_) {
+                clemens_input(&mmio_, &input);
+            }
+        }
+        inputEvents_.clear();
         queuelock.unlock();
 
         //  TODO: these edge cases seem sloppy - but we'll need to prevent the
@@ -925,6 +1729,14 @@ void ClemensBackend::main(PublishStateDelegate publishDelegate) {
             std::this_thread::sleep_for(std::chrono::milliseconds(15));
             continue;
         }
+        if (batchScript_ && !isTerminated) {
+            continueScriptFile();
+        }
+        if (scriptWait_.has_value() && !wasScriptWaiting) {
+            //  a new wait runs the machine, but a break during a wait holds it
+            stepsRemaining = std::nullopt;
+            isRunning = true;
+        }
         //  if isRunning is false, we use a condition var/wait to hold the thread
         if (isRunning && !isTerminated) {
             //  Run the emulator in either 'step' or 'run' mode.
@@ -940,11 +1752,16 @@ void ClemensBackend::main(PublishStateDelegate publishDelegate) {
             areInstructionsLogged_ = stepsRemaining.has_value() && (*stepsRemaining > 0);
 
             const time_t kEpoch1904To1970Seconds = 2082844800;
-            auto epoch_time_1904 =
-                (std::chrono::system_clock::to_time_t(std::chrono::system_clock::now()) +
-                 kEpoch1904To1970Seconds);
-
-            clemens_rtc_set(&mmio_, (unsigned)epoch_time_1904);
+            const uint64_t kClocksPerSecond =
+                uint64_t(CLEM_CLOCKS_MEGA2_CYCLE) * CLEM_MEGA2_CYCLES_PER_SECOND;
+            time_t epochTime;
+            if (config_.rtcEpochTime.has_value()) {
+                epochTime = time_t(*config_.rtcEpochTime +
+                                   int64_t(machine_.tspec.clocks_spent / kClocksPerSecond));
+            } else {
+                epochTime = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+            }
+            clemens_rtc_set(&mmio_, (unsigned)(epochTime + kEpoch1904To1970Seconds));
 
             auto lastClocksSpent = machine_.tspec.clocks_spent;
             int64_t clocksPerTimeslice =
@@ -970,8 +1787,35 @@ void ClemensBackend::main(PublishStateDelegate publishDelegate) {
                         break;
                     }
                 }
+                if (scriptWait_.has_value() && checkScriptWait()) {
+                    //  the script continues at the next statement without
+                    //  waiting for the rest of the timeslice
+                    break;
+                }
             } // clocksRemainingInTimeslice
 
+            if (programTrace_ != nullptr) {
+                programTrace_->consumeToolboxLog();
+            }
+
+            transferInputText();
+
+            //  serial traffic crosses to the host once per timeslice
+            for (unsigned channel = 0; channel < serialPorts_.size(); ++channel) {
+                if (serialPorts_[channel]) {
+                    serialPorts_[channel]->transfer(mmio_, channel);
+                }
+            }
+
+            {
+                bool isBRAMDirty = false;
+                const uint8_t *bram = clemens_rtc_get_bram(&mmio_, &isBRAMDirty);
+                if (!bramStore_.update(bram, isBRAMDirty, ClemensBRAMStore::Clock::now())) {
+                    localLog(CLEM_DEBUG_LOG_WARN, "Unable to save BRAM to {}, will retry.",
+                             bramStore_.getPathname());
+                }
+            }
+
             if (stepsRemaining.has_value() && *stepsRemaining == 0) {
                 //  if we've finished stepping through code, we are also done with our
                 //  timeslice and will wait for a new step/run request
@@ -985,8 +1829,11 @@ void ClemensBackend::main(PublishStateDelegate publishDelegate) {
                 currentFrameTimePoint - lastFrameTimePoint);
             lastFrameTimePoint = currentFrameTimePoint;
 
+            //  scripts waiting on the machine run it as fast as the host allows
+            bool isUnpaced = (batchScript_ || scriptWait_.has_value()) && !config_.pacedScripts;
             runSampler.update(
-                fixedFrameInterval, actualFrameInterval,
+                isUnpaced ? std::chrono::microseconds::zero() : fixedFrameInterval,
+                actualFrameInterval,
                 (clem_clocks_duration_t)(machine_.tspec.clocks_spent - lastClocksSpent),
                 machine_.cpu.cycles_spent);
 
@@ -1002,24 +1849,26 @@ void ClemensBackend::main(PublishStateDelegate publishDelegate) {
                 if (diskDrive.isEjecting) {
                     if (clemens_eject_disk_async(&mmio_, driveType, &disks_[driveIndex])) {
                         diskDrive.isEjecting = false;
-                        if (!saveDisk(driveType))
-                            diskDrive.saveFailed = true;
-                        diskDrive.imagePath.clear();
-                        resetDisk(driveType);
+                        if (diskOverlayActions_[driveIndex] != DiskOverlayAction::None) {
+                            if (!finishDiskOverlayAction(driveType))
+                                diskDrive.saveFailed = true;
+                        } else {
+                            if (!saveDisk(driveType))
+                                diskDrive.saveFailed = true;
+                            diskDrive.imagePath.clear();
+                            resetDisk(driveType);
+                        }
                     }
                 }
             }
             for (auto diskDriveIt = smartPortDrives_.begin(); diskDriveIt != smartPortDrives_.end();
                  ++diskDriveIt) {
                 auto &diskDrive = *diskDriveIt;
-                // auto driveIndex = unsigned(diskDriveIt - smartPortDrives_.begin());
-                //  auto *clemensUnit = clemens_smartport_unit_get(&mmio_, driveIndex);
-                //   TODO: detect SmartPort drive status - enable2 only detects if the
-                //         whole bus is active - which may be fine for now since we just support
-                //         one SmartPort drive!
-                diskDrive.isSpinning = mmio_.dev_iwm.enable2;
-                diskDrive.isWriteProtected = false;
-                diskDrive.saveFailed = false;
+                auto driveIndex = unsigned(diskDriveIt - smartPortDrives_.begin());
+                auto *clemensUnit = clemens_smartport_unit_get(&mmio_, driveIndex);
+                diskDrive.isSpinning = clem_smartport_unit_is_active(clemensUnit);
+                diskDrive.isWriteProtected = smartPortDisks_[driveIndex].isWriteProtected();
+                diskDrive.saveFailed = smartPortDisks_[driveIndex].isWriteFailing();
                 if (diskDrive.isEjecting) {
                     //  TODO: SmartPort drive ejection
                 }
@@ -1051,8 +1900,12 @@ void ClemensBackend::main(PublishStateDelegate publishDelegate) {
                 ClemensSmartPortDevice device;
                 clemens_remove_smartport_disk(&mmio_, driveIndex, &device);
                 smartPortDisks_[driveIndex].destroySmartPortDevice(&device);
-                saveSmartPortDisk(driveIndex);
-                localLog(CLEM_DEBUG_LOG_INFO, "Saved {}", drive.imagePath);
+                if (saveSmartPortDisk(driveIndex)) {
+                    localLog(CLEM_DEBUG_LOG_INFO, "Saved {}", drive.imagePath);
+                } else {
+                    drive.saveFailed = true;
+                    localLog(CLEM_DEBUG_LOG_WARN, "Failed to save {}", drive.imagePath);
+                }
             }
             publishState = true;
             updateSeqNo = true;
@@ -1075,6 +1928,20 @@ void ClemensBackend::main(PublishStateDelegate publishDelegate) {
                 clemens_get_monitor(&publishedState.monitor, &mmio_);
                 clemens_get_text_video(&publishedState.text, &mmio_);
                 clemens_get_graphics_video(&publishedState.graphics, &machine_, &mmio_);
+                if (videoCapture_) {
+                    //  an image is captured per publish, standing in for the
+                    //  60hz frames since the last one
+                    unsigned vblCounter = mmio_.vgc.vbl_counter;
+                    unsigned frameCount = vblCounter - videoCaptureVBLCounter_;
+                    if (vblCounter < videoCaptureVBLCounter_) {
+                        frameCount = 1;
+                    }
+                    videoCaptureVBLCounter_ = vblCounter;
+                    videoCapture_->submit(publishedState.monitor, publishedState.text,
+                                          publishedState.graphics, machine_.mem.mega2_bank_map[0],
+                                          machine_.mem.mega2_bank_map[1], mmio_.vgc.mode_flags,
+                                          std::min(frameCount, kVideoCaptureFrameLimit));
+                }
                 if (clemens_get_audio(&publishedState.audio, &mmio_)) {
                     if (mockingboard) {
                         auto &audio = publishedState.audio;
@@ -1100,8 +1967,7 @@ void ClemensBackend::main(PublishStateDelegate publishDelegate) {
             publishedState.fps = runSampler.sampledFramesPerSecond;
             publishedState.hostCPUID = clem_host_get_processor_number();
             publishedState.logLevel = logLevel_;
-            publishedState.logBufferStart = logOutput_.data();
-            publishedState.logBufferEnd = logOutput_.data() + logOutput_.size();
+            publishedState.logRing = &logRing_;
             publishedState.logInstructionStart = loggedInstructions_.data();
             publishedState.logInstructionEnd =
                 loggedInstructions_.data() + loggedInstructions_.size();
@@ -1115,6 +1981,8 @@ void ClemensBackend::main(PublishStateDelegate publishDelegate) {
             publishedState.commandFailed = std::move(commandFailed);
             publishedState.commandType = std::move(commandType);
             publishedState.message = std::move(debugMessage);
+            publishedState.scriptResult = scriptResult_;
+            scriptResult_ = std::nullopt;
             if (isTerminated) {
                 publishedState.terminated = isTerminated;
             }
@@ -1125,12 +1993,20 @@ void ClemensBackend::main(PublishStateDelegate publishDelegate) {
             }
             publishedState.debugMemoryPage = debugMemoryPage_;
             publishedState.emulatorSpeedMhz = runSampler.sampledEmulatorSpeedMhz;
+            publishedState.frameStats = runSampler.getFrameStats();
 
             publishDelegate(publishedState);
+            //  pages written from here on are newer than what the frontend has
+            //  copied so far
+            clemens_next_write_generation(&machine_);
+            if (accessCounters_) {
+                clemens_decay_memory_access_counters(accessCounters_.get(),
+                                                     kMemoryHeatmapDecayShift);
+            }
             if (publishedState.mmio_was_initialized) {
                 clemens_audio_next_frame(&mmio_, publishedState.audio.frame_count);
             }
-            logOutput_.clear();
+            logRing_.tail = logRing_.head;
             loggedInstructions_.clear();
             hitBreakpoint = std::nullopt;
             commandFailed = std::nullopt;
@@ -1139,6 +2015,17 @@ void ClemensBackend::main(PublishStateDelegate publishDelegate) {
         }
     } // !isTerminated
 
+    if (videoCapture_) {
+        stopVideoCapture();
+    }
+    if (audioRecorder_) {
+        stopAudioCapture();
+    }
+    for (unsigned channel = 0; channel < serialPorts_.size(); ++channel) {
+        if (serialPorts_[channel]) {
+            disconnectSerialPort(channel);
+        }
+    }
     saveBRAM();
 
     //  TODO: clemens_mmio_card_eject() will clear the slot but it still needs
@@ -1215,6 +2102,12 @@ void ClemensBackend::initEmulatedDiskLocalStorage() {
     disks_[kClemensDrive_5_25_D2].bits_data_end =
         disks_[kClemensDrive_5_25_D2].bits_data + CLEM_DISK_525_MAX_DATA_SIZE;
 
+    for (size_t driveIndex = 0; driveIndex < disks_.size(); ++driveIndex) {
+        diskLocalStorage_[driveIndex] =
+            cinek::Range<uint8_t>(disks_[driveIndex].bits_data, disks_[driveIndex].bits_data_end);
+        diskMappings_[driveIndex] = ClemensHostMappedFile{};
+    }
+
     //  some sanity values to initialize
     for (size_t driveIndex = 0; driveIndex < diskDrives_.size(); ++driveIndex) {
         auto &diskDrive = diskDrives_[driveIndex];
@@ -1251,17 +2144,51 @@ cinek::ByteBuffer ClemensBackend::loadROM(const char *romPathname) {
     return romBuffer;
 }
 
+unsigned ClemensBackend::getFPIBankCount(unsigned ramSizeKB) {
+    constexpr unsigned kBankSizeKB = CLEM_IIGS_BANK_SIZE / 1024;
+    if (ramSizeKB == 0)
+        return CLEM_IIGS_FPI_MAIN_RAM_BANK_LIMIT;
+    return std::clamp(ramSizeKB / kBankSizeKB, 256 / kBankSizeKB, 8192 / kBankSizeKB);
+}
+
+void ClemensBackend::initGuestMemory(unsigned fpiBankCount) {
+    //  banks first so that each stays 64K aligned within the arena
+    const size_t kGuestMemorySize = CLEM_IIGS_BANK_SIZE * (fpiBankCount + 2) +
+                                    CLEM_IIGS_PAGE_COUNT * sizeof(uint32_t) +
+                                    CLEM_IIGS_EXPANSION_ROM_SIZE * 7;
+    if (clem_host_alloc_pages(&guestPages_, kGuestMemorySize)) {
+        guestMemory_ = cinek::FixedStack(guestPages_.size, guestPages_.data);
+    } else {
+        guestMemory_ = cinek::FixedStack(
+            kGuestMemorySize, slabMemory_.allocate(kGuestMemorySize, CLEM_IIGS_BANK_SIZE));
+    }
+    const char *pageTypeName = "normal";
+    if (guestPages_.pageType == kClemensHostPages_Huge) {
+        pageTypeName = "huge";
+    } else if (guestPages_.pageType == kClemensHostPages_Advised) {
+        pageTypeName = "transparent huge";
+    }
+    localLog(CLEM_DEBUG_LOG_INFO, "Guest RAM is {}K on {} pages",
+             fpiBankCount * (CLEM_IIGS_BANK_SIZE / 1024), pageTypeName);
+}
+
 void ClemensBackend::initApple2GS() {
-    const unsigned kFPIBankCount = CLEM_IIGS_FPI_MAIN_RAM_BANK_LIMIT;
+    const unsigned kFPIBankCount = getFPIBankCount(config_.ramSizeKB);
     const uint32_t kClocksPerFastCycle = CLEM_CLOCKS_FAST_CYCLE;
     const uint32_t kClocksPerSlowCycle = CLEM_CLOCKS_MEGA2_CYCLE;
-    int result =
-        clemens_init(&machine_, kClocksPerSlowCycle, kClocksPerFastCycle, romBuffer_.getHead(),
-                     romBuffer_.getSize(), slabMemory_.allocate(CLEM_IIGS_BANK_SIZE),
-                     slabMemory_.allocate(CLEM_IIGS_BANK_SIZE),
-                     slabMemory_.allocate(CLEM_IIGS_BANK_SIZE * kFPIBankCount), kFPIBankCount);
+    initGuestMemory(kFPIBankCount);
+    void *fpiRAM = guestMemory_.allocate(CLEM_IIGS_BANK_SIZE * kFPIBankCount);
+    void *e0Bank = guestMemory_.allocate(CLEM_IIGS_BANK_SIZE);
+    void *e1Bank = guestMemory_.allocate(CLEM_IIGS_BANK_SIZE);
+    int result = clemens_init(&machine_, kClocksPerSlowCycle, kClocksPerFastCycle,
+                              romBuffer_.getHead(), romBuffer_.getSize(), e0Bank, e1Bank, fpiRAM,
+                              kFPIBankCount);
+    auto *pageWriteGen =
+        (uint32_t *)guestMemory_.allocate(CLEM_IIGS_PAGE_COUNT * sizeof(uint32_t));
     clem_mmio_init(&mmio_, &machine_.dev_debug, machine_.mem.bank_page_map,
-                   machine_.tspec.clocks_step_mega2, slabMemory_.allocate(2048 * 7), kFPIBankCount);
+                   machine_.tspec.clocks_step_mega2,
+                   guestMemory_.allocate(CLEM_IIGS_EXPANSION_ROM_SIZE * 7), kFPIBankCount);
+    clemens_page_write_tracking(&machine_, pageWriteGen);
     if (result < 0) {
         fmt::print("Clemens library failed to initialize with err code (%d)\n", result);
         return;
@@ -1282,23 +2209,17 @@ void ClemensBackend::initApple2GS() {
 void ClemensBackend::saveBRAM() {
     bool isDirty = false;
     const uint8_t *bram = clemens_rtc_get_bram(&mmio_, &isDirty);
-    if (!isDirty)
+    if (!isDirty && !bramStore_.hasPendingChanges())
         return;
 
-    std::ofstream bramFile("clem.bram", std::ios::binary);
-    if (bramFile.is_open()) {
-        bramFile.write((char *)bram, CLEM_RTC_BRAM_SIZE);
-    } else {
-        //  TODO: display error?
+    if (!bramStore_.save(bram)) {
+        fmt::print("Unable to save BRAM to {}\n", bramStore_.getPathname());
     }
 }
 
 void ClemensBackend::loadBRAM() {
-    std::ifstream bramFile("clem.bram", std::ios::binary);
-    if (bramFile.is_open()) {
-        bramFile.read((char *)mmio_.dev_rtc.bram, CLEM_RTC_BRAM_SIZE);
-    } else {
-        //  TODO: display warning?
+    if (!bramStore_.load(mmio_.dev_rtc.bram)) {
+        fmt::print("No BRAM loaded from {}\n", bramStore_.getPathname());
     }
 }
 
@@ -1306,10 +2227,12 @@ void ClemensBackend::emulatorLog(int log_level, ClemensMachine *machine, const c
     auto *host = reinterpret_cast<ClemensBackend *>(machine->debug_user_ptr);
     if (host->logLevel_ > log_level)
         return;
-    if (host->logOutput_.size() >= kLogOutputLineLimit)
+    auto *record = host->acquireLogRecord(log_level);
+    if (!record)
         return;
-
-    host->logOutput_.emplace_back(ClemensBackendOutputText{log_level, msg});
+    strncpy(record->text, msg, sizeof(record->text) - 1);
+    record->text[sizeof(record->text) - 1] = '\0';
+    ++host->logRing_.head;
 }
 
 //  If enabled, this emulator issues this callback per instruction
@@ -1390,7 +2313,7 @@ void ClemensBackend::assignPropertyToU32(MachineProperty property, uint32_t valu
         machine_.cpu.regs.PBR = (uint8_t)(value & 0xff);
         break;
     case MachineProperty::RegPC:
-        machine_.cpu.regs.PC = (uint16_t)(value & 0xff);
+        machine_.cpu.regs.PC = (uint16_t)(value & 0xffff);
         break;
     };
 }
@@ -1,25 +1,34 @@
 #ifndef CLEM_HOST_BACKEND_HPP
 #define CLEM_HOST_BACKEND_HPP
 
+#include "clem_batch_script.hpp"
+#include "clem_bram_store.hpp"
+#include "clem_disk_overlay.hpp"
 #include "clem_host_shared.hpp"
 #include "clem_interpreter.hpp"
 #include "clem_smartport_disk.hpp"
+#include "clem_symbol_table.hpp"
 
 #include "cinek/buffer.hpp"
 #include "cinek/fixedstack.hpp"
+#include "clem_host_platform.h"
 #include "clem_woz.h"
 
 #include <array>
 #include <condition_variable>
 #include <deque>
 #include <functional>
+#include <memory>
 #include <mutex>
 #include <string>
 #include <string_view>
 #include <thread>
 #include <vector>
 
+class ClemensAudioRecorder;
+class ClemensSerialPort;
 class ClemensProgramTrace;
+class ClemensVideoCapture;
 
 //  TODO: Machine type logic could be subclassed into an Apple2GS backend, etc.
 class ClemensBackend {
@@ -53,14 +62,24 @@ class ClemensBackend {
     void step(unsigned count);
     //  Will issue the publish delegate on the next machine iteration
     void publish();
-    //  Send host input to the emulator
+    //  Send host input to the emulator.  Events bypass the command queue and
+    //  consecutive mouse moves are merged until the runner picks them up.
     void inputEvent(const ClemensInputEvent &inputEvent);
+    //  Type text into the machine as fast as the guest reads the keyboard.
+    //  Newlines become Return and other control characters are dropped.  Empty
+    //  text cancels typing that is still in progress.
+    void inputText(std::string text);
     //  Insert disk
     void insertDisk(ClemensDriveType driveType, std::string diskPath);
     //  Insert blank disk
     void insertBlankDisk(ClemensDriveType driveType, std::string diskPath);
     //  Eject disk
     void ejectDisk(ClemensDriveType driveType);
+    //  With an overlay directory configured, writes the changes in a drive's
+    //  delta to its image, or throws them away.  Drives are named as in the
+    //  disk utilities (s6d1, etc.) or hdd1 to hdd4 for SmartPort units.
+    void commitDisk(std::string driveName);
+    void discardDisk(std::string driveName);
     //  Break
     void breakExecution();
     //  Add a breakpoint
@@ -74,17 +93,42 @@ class ClemensBackend {
     void debugMemoryPage(uint8_t pageIndex);
     //  Write a single byte to machine memory at the current debugMemoryPage
     void debugMemoryWrite(uint16_t addr, uint8_t value);
+    //  Write bytes to machine memory starting at a 24-bit address, continuing
+    //  into the next bank past $FFFF
+    void debugMemoryWriteBlock(uint32_t address, const uint8_t *data, size_t count);
+    //  Set a register (see assignPropertyToU32)
+    void debugRegisterWrite(ClemensBackendMachineProperty property, uint32_t value);
     //  Set logging level
     void debugLogLevel(int logLevel);
     //  Send a message to the publish delegate from the frontend
     void debugMessage(std::string msg);
     //  Enable a program trace
     void debugProgramTrace(std::string op, std::string path);
+    //  Adds the symbols in an assembler or linker output file (see
+    //  ClemensSymbolTable) to exported traces.  An empty pathname clears them.
+    void loadSymbols(std::string pathname);
+    //  Enable memory access counters for the heatmap.  If byteBank is not
+    //  negative, accesses within that bank are also counted per byte.
+    void debugMemoryHeatmap(bool enable, int byteBank = -1);
+    //  Capture video frames to a PNG sequence (path is a directory) or a Y4M
+    //  stream.  A format of "off" stops the capture.
+    void captureVideo(std::string format, std::string path = "");
+    //  Record the mixed audio output to a WAV or raw (32-bit float stereo)
+    //  file.  A format of "off" stops the recording.
+    void captureAudio(std::string format, std::string path = "");
+    //  Connect a serial port ("a" = printer, "b" = modem) to an endpoint:
+    //  "loopback", "pty", "file" (path) or "tcp" (host:port).  An endpoint of
+    //  "off" disconnects the port.
+    void serialPort(std::string port, std::string endpoint, std::string target = "");
     //  Save and load the machine
     void saveMachine(std::string path);
     void loadMachine(std::string path);
 
     void runScript(std::string command);
+    //  Runs the statements in a script file in order.  Statements that wait on
+    //  the machine run it at full speed until their condition is met.  The
+    //  outcome is published as ClemensBackendState::scriptResult.
+    void runScriptFile(std::string pathname);
 
     //  these methods do not queue instructions to execute on the runner
     //  and must be executed instead on the runner thread.  They are made public
@@ -93,6 +137,20 @@ class ClemensBackend {
     //  Properties can be 8/16 or 32-bit.   Registers are 8/16 bit.  The incoming
     //  value is truncated by masking/downcast from 32-bit accordingly.
     void assignPropertyToU32(MachineProperty property, uint32_t value);
+    //  Runs the machine until the condition is met before executing the next
+    //  statement.  Returns false if the condition can never be met.
+    bool scriptWait(const ClemensScriptCondition &condition);
+    //  Waits lasting more than this many 1.023 MHz cycles fail the script
+    void scriptTimeout(uint64_t cycles);
+    void scriptType(std::string text);
+    void scriptKey(uint8_t adbKeyCode);
+    //  Returns false if the byte in RAM or ROM does not hold the value
+    bool scriptExpect(uint32_t address, uint8_t value);
+    //  Returns false if the drive has no overlay.  Floppies are ejected and
+    //  reinserted to finish the operation, so a failure there is reported in
+    //  the drive's saveFailed state instead.
+    bool commitDiskOverlay(const std::string_view &driveName);
+    bool discardDiskOverlay(const std::string_view &driveName);
 
   private:
     using Command = ClemensBackendCommand;
@@ -107,13 +165,30 @@ class ClemensBackend {
     void ejectDisk(const std::string_view &inputParam);
     bool writeProtectDisk(const std::string_view &inputParam);
     void writeMemory(const std::string_view &inputParam);
+    bool writeMemoryBlock(const std::string_view &inputParam);
+    bool writeRegister(const std::string_view &inputParam);
     void inputMachine(const std::string_view &inputParam);
+    void typeText(const std::string_view &text);
+    void transferInputText();
     bool addBreakpoint(const std::string_view &inputParam);
     bool delBreakpoint(const std::string_view &inputParam);
     bool programTrace(const std::string_view &inputParam);
+    bool programTraceQuery(const std::string_view &op, const std::string_view &param);
+    bool programTraceToolbox(const std::string_view &param);
+    bool memoryHeatmap(const std::string_view &inputParam);
+    bool videoCapture(const std::string_view &inputParam);
+    void stopVideoCapture();
+    bool audioCapture(const std::string_view &inputParam);
+    void stopAudioCapture();
+    bool connectSerialPort(const std::string_view &inputParam);
+    void disconnectSerialPort(unsigned channel);
     bool saveSnapshot(const std::string_view &inputParam);
     bool loadSnapshot(const std::string_view &inputParam);
     bool runScriptCommand(const std::string_view &command);
+    bool startScriptFile(const std::string_view &pathname);
+    void continueScriptFile();
+    void finishScriptFile(bool succeeded);
+    bool checkScriptWait();
 
     std::optional<unsigned> checkHitBreakpoint();
 
@@ -121,19 +196,27 @@ class ClemensBackend {
     bool loadDisk(ClemensDriveType driveType, bool allowBlank);
     bool saveDisk(ClemensDriveType driveType);
     void resetDisk(ClemensDriveType driveType);
+    void unmapDisk(ClemensDriveType driveType);
+    enum class DiskOverlayAction { None, Commit, Discard };
+    bool startDiskOverlayAction(const std::string_view &driveName, DiskOverlayAction action);
+    bool finishDiskOverlayAction(ClemensDriveType driveType);
 
-    void loadSmartPortDisk(unsigned driveIndex);
+    bool loadSmartPortDisk(unsigned driveIndex);
     bool saveSmartPortDisk(unsigned driveIndex);
 
     cinek::ByteBuffer loadROM(const char *romPathname);
 
     //  TODO: These methods could be moved into a subclass as they are specific
     //        to machine type
+    static unsigned getFPIBankCount(unsigned ramSizeKB);
+    void initGuestMemory(unsigned fpiBankCount);
     void initApple2GS();
+    void applyThreadConfig();
     void loadBRAM();
     void saveBRAM();
 
     template <typename... Args> void localLog(int log_level, const char *msg, Args... args);
+    ClemensLogRecord *acquireLogRecord(int log_level);
 
     static void emulatorLog(int log_level, ClemensMachine *machine, const char *msg);
     static void emulatorOpcodeCallback(struct ClemensInstruction *inst, const char *operand,
@@ -147,9 +230,16 @@ class ClemensBackend {
     std::deque<Command> commandQueue_;
     std::mutex commandQueueMutex_;
     std::condition_variable commandQueueCondition_;
+    //  host input events, guarded by the command queue mutex
+    std::vector<ClemensInputEvent> inputEvents_;
 
     //  memory allocated once for the machine
     cinek::FixedStack slabMemory_;
+    //  guest RAM (FPI and Mega II banks), the page write table and card memory
+    //  share one huge page backed arena so that the scattered bank accesses
+    //  of clem_read/clem_write touch as few TLB entries as possible
+    ClemensHostPages guestPages_;
+    cinek::FixedStack guestMemory_;
     //  the actual machine object
     cinek::ByteBuffer romBuffer_;
     cinek::ByteBuffer diskBuffer_;
@@ -158,17 +248,48 @@ class ClemensBackend {
 
     ClemensInterpreter interpreter_;
 
-    std::vector<ClemensBackendOutputText> logOutput_;
+    //  emulator and backend log messages, formatted by the frontend
+    std::vector<ClemensLogRecord> logRecords_;
+    ClemensLogRing logRing_;
     std::vector<ClemensBackendBreakpoint> breakpoints_;
     std::vector<ClemensBackendExecutedInstruction> loggedInstructions_;
     std::array<ClemensWOZDisk, kClemensDrive_Count> diskContainers_;
     std::array<ClemensNibbleDisk, kClemensDrive_Count> disks_;
+    //  disk images are mapped from their files while inserted; the local storage
+    //  holds track data for blank disks
+    std::array<ClemensHostMappedFile, kClemensDrive_Count> diskMappings_;
+    std::array<cinek::Range<uint8_t>, kClemensDrive_Count> diskLocalStorage_;
     std::array<ClemensBackendDiskDriveState, kClemensDrive_Count> diskDrives_;
-    std::array<ClemensBackendDiskDriveState, 1> smartPortDrives_;
-    std::array<ClemensSmartPortDisk, 1> smartPortDisks_;
+    std::array<ClemensBackendDiskDriveState, CLEM_SMARTPORT_DRIVE_LIMIT> smartPortDrives_;
+    //  each open disk runs its own I/O thread
+    std::array<ClemensSmartPortDisk, CLEM_SMARTPORT_DRIVE_LIMIT> smartPortDisks_;
+    //  deltas for inserted disks when config_.overlayPath is set, and the
+    //  commit or discard waiting on a disk's ejection
+    std::array<ClemensDiskTrackOverlay, kClemensDrive_Count> diskOverlays_;
+    std::array<DiskOverlayAction, kClemensDrive_Count> diskOverlayActions_;
 
     uint64_t nextTraceSeq_;
     std::unique_ptr<ClemensProgramTrace> programTrace_;
+    ClemensSymbolTable symbols_;
+    std::unique_ptr<ClemensMemoryAccessCounters> accessCounters_;
+    std::unique_ptr<uint32_t[]> accessByteCounters_;
+    std::unique_ptr<ClemensVideoCapture> videoCapture_;
+    unsigned videoCaptureVBLCounter_;
+    std::unique_ptr<ClemensAudioRecorder> audioRecorder_;
+    std::array<std::unique_ptr<ClemensSerialPort>, 2> serialPorts_;
+    ClemensBRAMStore bramStore_;
+    //  text waiting to be typed, see inputText()
+    std::string inputText_;
+    size_t inputTextOffset_;
+    //  the script file being run and the condition it is waiting on
+    std::unique_ptr<ClemensBatchScript> batchScript_;
+    std::optional<ClemensScriptCondition> scriptWait_;
+    clem_clocks_time_t scriptWaitClocks_;
+    clem_clocks_time_t scriptTimeoutClocks_;
+    unsigned scriptWaitVBLCounter_;
+    uint64_t scriptTimeoutCycles_;
+    std::optional<bool> scriptResult_;
+    std::vector<std::string> scriptScreenRows_;
 
     int logLevel_;
     uint8_t debugMemoryPage_;
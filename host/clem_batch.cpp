@@ -0,0 +1,301 @@
+//  Runs a script file against a headless machine and exits with its result,
+//  for regression runs that have no display or audio device (i.e. CI.)
+//
+//  The machine runs unpaced while the script waits on it, and at the normal
+//  rate otherwise.  See clem_interpreter.cpp for the script commands.
+//
+//  With --debug-socket, a debugger can attach over a Unix-domain socket (see
+//  clem_debug_server.hpp.)  The script is optional then, and without one the
+//  machine runs until the debugger kills it.
+//
+//  Exit codes: 0 if the script finished, 1 if it failed, 2 on a usage error
+//  or when the host time limit ran out.
+
+#include "clem_backend.hpp"
+#include "clem_debug_server.hpp"
+#include "clem_disk_utils.hpp"
+#include "clem_host_utils.hpp"
+#include "emulator.h"
+#include "render.h"
+
+#include "fmt/format.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+constexpr int kExitFinished = 0;
+constexpr int kExitFailed = 1;
+constexpr int kExitError = 2;
+
+//  the backend only publishes state (and so log output and the script result)
+//  on request
+constexpr auto kPublishInterval = std::chrono::milliseconds(50);
+
+void printUsage(const char *program) {
+    fmt::print(stderr,
+               "usage: {} [options] <script>\n"
+               "       {} [options] --debug-socket <path> [<script>]\n"
+               "  --rom <path>          ROM 03 image (default gs_rom_3.rom)\n"
+               "  --bram <path>         battery RAM image (default clem.bram)\n"
+               "  --rtc-epoch <secs>    start the clock at this Unix time\n"
+               "  --ram <KB>            RAM size from 256 to 8192 (default 4096)\n"
+               "  --disk <drive>=<path> insert a disk (s5d1, s5d2, s6d1, s6d2)\n"
+               "  --hdd <path>          SmartPort hard drive image or directory (repeat for up\n"
+               "                        to {} units)\n"
+               "  --hdd-write-back      write guest changes back to --hdd directories\n"
+               "  --overlay <dir>       leave disk images as they are and keep changes in\n"
+               "                        delta files in this directory\n"
+               "  --cpu <index>         pin the emulator thread to a processor\n"
+               "  --priority <level>    emulator thread priority (normal, high, realtime)\n"
+               "  --paced               run at the normal rate and report frame pacing\n"
+               "  --time-limit <secs>   give up after this much host time\n"
+               "  --debug-socket <path> serve the debugger on a Unix-domain socket\n"
+               "  --symbols <path>      name addresses in exported traces from an ld65\n"
+               "                        .dbg or label file, Merlin or 'addr name' text\n"
+               "  --verbose             show debug log output\n",
+               program, program, CLEM_SMARTPORT_DRIVE_LIMIT);
+}
+
+class BatchRunner {
+  public:
+    void publish(const ClemensBackendState &state) {
+        if (state.logRing) {
+            printLog(*state.logRing);
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (state.scriptResult.has_value()) {
+            result_ = state.scriptResult;
+        }
+        if (state.terminated.has_value() && *state.terminated) {
+            terminated_ = true;
+        }
+        if (state.frameStats.frameCount > 0) {
+            frameStats_ = state.frameStats;
+        }
+        published_.notify_all();
+    }
+
+    //  Returns the script result, or nothing if the time limit ran out or the
+    //  backend stopped
+    std::optional<bool> wait(ClemensBackend &backend,
+                             std::optional<std::chrono::steady_clock::time_point> deadline) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!result_.has_value() && !terminated_) {
+            auto now = std::chrono::steady_clock::now();
+            if (deadline.has_value() && now >= *deadline)
+                break;
+            lock.unlock();
+            backend.publish();
+            lock.lock();
+            published_.wait_for(lock, kPublishInterval);
+        }
+        return result_;
+    }
+
+    bool isTerminated() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return terminated_;
+    }
+
+    void setLogLevel(int logLevel) { logLevel_ = logLevel; }
+
+    //  Pacing of the last frames run at the normal rate, if any
+    void printFrameStats() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (frameStats_.frameCount == 0)
+            return;
+        fmt::print("frame time {:.3f} ms, std dev {:.3f} ms, worst error {:.3f} ms, "
+                   "wake latency {:.3f} ms (worst {:.3f} ms) over {} frames\n",
+                   frameStats_.meanFrameTime / 1000.0f, frameStats_.frameTimeDeviation / 1000.0f,
+                   frameStats_.maxFrameTimeError / 1000.0f, frameStats_.meanWakeLatency / 1000.0f,
+                   frameStats_.maxWakeLatency / 1000.0f, frameStats_.frameCount);
+    }
+
+  private:
+    void printLog(const ClemensLogRing &logRing) {
+        char logText[CLEM_DEBUG_LOG_BUFFER_SIZE];
+        for (unsigned index = logRing.tail; index != logRing.head; ++index) {
+            auto &record = logRing.records[index & (logRing.record_limit - 1)];
+            if (record.level < logLevel_)
+                continue;
+            clemens_format_log_record(&record, logText, sizeof(logText));
+            fmt::print(record.level >= CLEM_DEBUG_LOG_WARN ? stderr : stdout, "{}\n", logText);
+        }
+    }
+
+    std::mutex mutex_;
+    std::condition_variable published_;
+    std::optional<bool> result_;
+    bool terminated_ = false;
+    ClemensBackendFrameStats frameStats_{};
+    int logLevel_ = CLEM_DEBUG_LOG_INFO;
+};
+
+bool parseDrive(std::string_view name, ClemensDriveType &driveType) {
+    if (name == "s5d1") {
+        driveType = kClemensDrive_3_5_D1;
+    } else if (name == "s5d2") {
+        driveType = kClemensDrive_3_5_D2;
+    } else if (name == "s6d1") {
+        driveType = kClemensDrive_5_25_D1;
+    } else if (name == "s6d2") {
+        driveType = kClemensDrive_5_25_D2;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    ClemensBackend::Config config{};
+    config.type = ClemensBackendConfig::Type::Apple2GS;
+    config.audioSamplesPerSecond = 48000;
+    std::string romPathname = "gs_rom_3.rom";
+    std::string scriptPathname;
+    std::string debugSocketPathname;
+    std::vector<std::string> symbolPathnames;
+    std::optional<std::chrono::seconds> timeLimit;
+    unsigned hddCount = 0;
+    BatchRunner runner;
+
+    for (int argi = 1; argi < argc; ++argi) {
+        std::string_view arg = argv[argi];
+        const char *value = argi + 1 < argc ? argv[argi + 1] : nullptr;
+        if (arg == "--verbose") {
+            runner.setLogLevel(CLEM_DEBUG_LOG_DEBUG);
+            continue;
+        }
+        if (arg == "--paced") {
+            config.pacedScripts = true;
+            continue;
+        }
+        if (arg == "--hdd-write-back") {
+            config.smartPortWriteBack = true;
+            continue;
+        }
+        if (arg.size() < 2 || arg.substr(0, 2) != "--") {
+            if (!scriptPathname.empty()) {
+                printUsage(argv[0]);
+                return kExitError;
+            }
+            scriptPathname = arg;
+            continue;
+        }
+        if (!value) {
+            printUsage(argv[0]);
+            return kExitError;
+        }
+        ++argi;
+        if (arg == "--rom") {
+            romPathname = value;
+        } else if (arg == "--bram") {
+            config.bramPathname = value;
+        } else if (arg == "--rtc-epoch") {
+            config.rtcEpochTime = std::strtoll(value, nullptr, 10);
+        } else if (arg == "--ram") {
+            config.ramSizeKB = unsigned(std::strtoul(value, nullptr, 10));
+        } else if (arg == "--hdd") {
+            if (hddCount >= config.smartPortDriveStates.size()) {
+                printUsage(argv[0]);
+                return kExitError;
+            }
+            config.smartPortDriveStates[hddCount++].imagePath = value;
+        } else if (arg == "--overlay") {
+            config.overlayPath = value;
+        } else if (arg == "--cpu") {
+            config.runnerProcessor = unsigned(std::strtoul(value, nullptr, 10));
+        } else if (arg == "--priority") {
+            if (!parseThreadPriority(value, config.runnerPriority)) {
+                printUsage(argv[0]);
+                return kExitError;
+            }
+        } else if (arg == "--symbols") {
+            symbolPathnames.emplace_back(value);
+        } else if (arg == "--debug-socket") {
+            debugSocketPathname = value;
+        } else if (arg == "--time-limit") {
+            timeLimit = std::chrono::seconds(std::strtol(value, nullptr, 10));
+        } else if (arg == "--disk") {
+            std::string_view disk = value;
+            auto sepPos = disk.find('=');
+            ClemensDriveType driveType;
+            if (sepPos == std::string_view::npos || !parseDrive(disk.substr(0, sepPos), driveType)) {
+                printUsage(argv[0]);
+                return kExitError;
+            }
+            config.diskDriveStates[driveType].imagePath = disk.substr(sepPos + 1);
+        } else {
+            printUsage(argv[0]);
+            return kExitError;
+        }
+    }
+    if (scriptPathname.empty() && debugSocketPathname.empty()) {
+        printUsage(argv[0]);
+        return kExitError;
+    }
+
+    std::unique_ptr<ClemensDebugServer> debugServer;
+    if (!debugSocketPathname.empty()) {
+        debugServer = std::make_unique<ClemensDebugServer>(debugSocketPathname);
+        if (!debugServer->isListening()) {
+            fmt::print(stderr, "{}: could not listen for a debugger\n", debugSocketPathname);
+            return kExitError;
+        }
+    }
+
+    std::optional<std::chrono::steady_clock::time_point> deadline;
+    if (timeLimit.has_value()) {
+        deadline = std::chrono::steady_clock::now() + *timeLimit;
+    }
+
+    //  video capture renders on its own thread
+    clemens_render_init();
+
+    std::optional<bool> result;
+    {
+        ClemensBackend backend(romPathname, config,
+                               [&runner, &debugServer](const ClemensBackendState &state) {
+                                   runner.publish(state);
+                                   if (debugServer) {
+                                       debugServer->publish(state);
+                                   }
+                               });
+        backend.setRefreshFrequency(60);
+        backend.reset();
+        for (auto &pathname : symbolPathnames) {
+            backend.loadSymbols(pathname);
+        }
+        backend.run();
+        if (debugServer) {
+            debugServer->start(backend);
+        }
+        if (!scriptPathname.empty()) {
+            backend.runScriptFile(scriptPathname);
+        }
+        result = runner.wait(backend, deadline);
+        if (scriptPathname.empty() && runner.isTerminated()) {
+            result = true;
+        }
+        if (debugServer) {
+            debugServer->stop();
+        }
+    }
+    runner.printFrameStats();
+    if (!result.has_value()) {
+        fmt::print(stderr, "{}: did not finish\n",
+                   scriptPathname.empty() ? debugSocketPathname : scriptPathname);
+        return kExitError;
+    }
+    return *result ? kExitFinished : kExitFailed;
+}
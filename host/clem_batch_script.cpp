@@ -0,0 +1,127 @@
+#include "clem_batch_script.hpp"
+
+#include "clem_mem.h"
+#include "clem_mmio_defs.h"
+#include "emulator_mmio.h"
+
+#include <cctype>
+#include <fstream>
+#include <iterator>
+
+namespace {
+
+std::string_view trim(std::string_view token) {
+    while (!token.empty() && std::isspace((unsigned char)token.front()))
+        token.remove_prefix(1);
+    while (!token.empty() && std::isspace((unsigned char)token.back()))
+        token.remove_suffix(1);
+    return token;
+}
+
+char decodeScreenCharacter(uint8_t ch) {
+    if (ch >= 0x80)
+        return char(ch & 0x7f);
+    //  inverse and flashing characters map $00-$1F to '@' through '_'
+    ch &= 0x3f;
+    return char(ch < 0x20 ? ch + 0x40 : ch);
+}
+
+} // namespace
+
+bool ClemensBatchScript::load(const std::string &pathname) {
+    std::ifstream in(pathname, std::ios_base::in | std::ios_base::binary);
+    if (in.fail())
+        return false;
+    std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (in.bad())
+        return false;
+    loadText(text, pathname);
+    return true;
+}
+
+void ClemensBatchScript::loadText(std::string_view text, std::string name) {
+    name_ = std::move(name);
+    statements_.clear();
+    nextStatementIndex_ = 0;
+    lineNumber_ = 0;
+    unsigned lineNumber = 1;
+    while (!text.empty()) {
+        auto eolPos = text.find('\n');
+        addLine(text.substr(0, eolPos), lineNumber);
+        if (eolPos == std::string_view::npos)
+            break;
+        text.remove_prefix(eolPos + 1);
+        ++lineNumber;
+    }
+}
+
+void ClemensBatchScript::addLine(std::string_view line, unsigned lineNumber) {
+    //  splits on ';' and stops at '//' when outside of a string literal
+    bool inString = false;
+    size_t statementPos = 0;
+    size_t i = 0;
+    for (; i < line.size(); ++i) {
+        if (inString) {
+            if (line[i] == '\\') {
+                ++i;
+            } else if (line[i] == '"') {
+                inString = false;
+            }
+        } else if (line[i] == '"') {
+            inString = true;
+        } else if (line[i] == ';') {
+            addStatement(line.substr(statementPos, i - statementPos), lineNumber);
+            statementPos = i + 1;
+        } else if (line[i] == '/' && i + 1 < line.size() && line[i + 1] == '/') {
+            break;
+        }
+    }
+    addStatement(line.substr(statementPos, i - statementPos), lineNumber);
+}
+
+void ClemensBatchScript::addStatement(std::string_view statement, unsigned lineNumber) {
+    statement = trim(statement);
+    if (!statement.empty()) {
+        statements_.emplace_back(lineNumber, std::string(statement));
+    }
+}
+
+bool ClemensBatchScript::next(std::string_view &statement) {
+    if (isDone())
+        return false;
+    auto &entry = statements_[nextStatementIndex_++];
+    lineNumber_ = entry.first;
+    statement = entry.second;
+    return true;
+}
+
+void readScreenText(ClemensMachine *machine, ClemensMMIO *mmio, std::vector<std::string> &rows) {
+    ClemensVideo video{};
+    rows.clear();
+    if (!clemens_get_text_video(&video, mmio))
+        return;
+    bool is80Column = (mmio->vgc.mode_flags & CLEM_VGC_80COLUMN_TEXT) != 0;
+    const uint8_t *mainBank = machine->mem.mega2_bank_map[0];
+    const uint8_t *auxBank = machine->mem.mega2_bank_map[1];
+    for (int row = video.scanline_start; row < video.scanline_limit; ++row) {
+        unsigned offset = video.scanlines[row].offset;
+        std::string &text = rows.emplace_back();
+        for (int column = 0; column < video.scanline_byte_cnt; ++column) {
+            //  80 column text interleaves auxillary and main memory
+            if (is80Column) {
+                text.push_back(decodeScreenCharacter(auxBank[offset + column]));
+            }
+            text.push_back(decodeScreenCharacter(mainBank[offset + column]));
+        }
+    }
+}
+
+bool peekMemory(ClemensMachine *machine, uint32_t address, uint8_t &value) {
+    uint16_t physicalPage;
+    const uint8_t *page = clem_mem_get_read_page(machine, uint8_t(address >> 16),
+                                                 uint8_t((address >> 8) & 0xff), &physicalPage);
+    if (!page)
+        return false;
+    value = page[address & 0xff];
+    return true;
+}
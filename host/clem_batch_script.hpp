@@ -0,0 +1,73 @@
+#ifndef CLEM_HOST_BATCH_SCRIPT_HPP
+#define CLEM_HOST_BATCH_SCRIPT_HPP
+
+#include "clem_mmio_types.h"
+#include "clem_types.h"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+//  A condition that a script waits on with the wait command.
+//
+//  The backend runs the machine unpaced while waiting.  PC, memory and cycle
+//  conditions are checked after every instruction, and text conditions once
+//  per frame (the display only changes then.)
+//
+struct ClemensScriptCondition {
+    enum class Type { PC, Memory, Cycles, Text };
+    Type type = Type::PC;
+    //  (bank << 16) | address for PC and Memory conditions
+    uint32_t address = 0;
+    //  Memory conditions wait for this byte value
+    uint8_t value = 0;
+    //  Cycles conditions wait for this many 1.023 MHz reference cycles
+    uint64_t cycles = 0;
+    //  Text conditions wait for this text to appear within a row of the
+    //  displayed text page
+    std::string text;
+};
+
+//  The lines of a script file, handed to the interpreter one statement at a
+//  time as the backend finishes the previous one.
+//
+//  Lines may hold several statements separated by ';', which run one at a time
+//  like statements on separate lines.  Text from '//' to the end of a line
+//  (outside of a string literal) is a comment.
+//
+class ClemensBatchScript {
+  public:
+    bool load(const std::string &pathname);
+    void loadText(std::string_view text, std::string name);
+
+    const std::string &getName() const { return name_; }
+    //  The line number of the last statement returned by next()
+    unsigned getLineNumber() const { return lineNumber_; }
+    bool isDone() const { return nextStatementIndex_ >= statements_.size(); }
+
+    //  Returns false once the script is done.  The statement is valid until the
+    //  script is loaded again.
+    bool next(std::string_view &statement);
+
+  private:
+    void addLine(std::string_view line, unsigned lineNumber);
+    void addStatement(std::string_view statement, unsigned lineNumber);
+
+    std::string name_;
+    std::vector<std::pair<unsigned, std::string>> statements_;
+    size_t nextStatementIndex_ = 0;
+    unsigned lineNumber_ = 0;
+};
+
+//  Decodes the displayed text page into rows of ASCII (40 or 80 columns.)
+//  Inverse and flashing characters are returned as their normal equivalents.
+void readScreenText(ClemensMachine *machine, ClemensMMIO *mmio,
+                    std::vector<std::string> &rows);
+
+//  Reads a byte from RAM or ROM without side effects.  Returns false for I/O
+//  and card addresses.
+bool peekMemory(ClemensMachine *machine, uint32_t address, uint8_t &value);
+
+#endif
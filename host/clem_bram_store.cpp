@@ -0,0 +1,126 @@
+#include "clem_bram_store.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+
+//  A write happens once the BRAM is unchanged for kQuietTime, or kMaxDelay
+//  after the first unsaved change
+constexpr auto kQuietTime = std::chrono::seconds(1);
+constexpr auto kMaxDelay = std::chrono::seconds(5);
+//  A failed write is retried after kRetryDelay, doubling with each failure in a
+//  row up to kRetryDelayLimit
+constexpr auto kRetryDelay = std::chrono::seconds(1);
+constexpr auto kRetryDelayLimit = std::chrono::seconds(32);
+
+bool syncFile(FILE *fp) {
+    if (fflush(fp) != 0)
+        return false;
+#if defined(_WIN32)
+    return _commit(_fileno(fp)) == 0;
+#else
+    return fsync(fileno(fp)) == 0;
+#endif
+}
+
+} // namespace
+
+ClemensBRAMStore::ClemensBRAMStore(std::string pathname)
+    : pathname_(std::move(pathname)), isSaved_(false), isPending_(false), failureCount_(0) {
+    saved_.fill(0);
+    pending_.fill(0);
+}
+
+bool ClemensBRAMStore::load(uint8_t *bram) {
+    //  a short or overlong file is not a BRAM image
+    std::error_code errc;
+    if (std::filesystem::file_size(pathname_, errc) != CLEM_RTC_BRAM_SIZE || errc)
+        return false;
+    FILE *fp = fopen(pathname_.c_str(), "rb");
+    if (!fp)
+        return false;
+    bool isLoaded = fread(pending_.data(), 1, pending_.size(), fp) == pending_.size();
+    fclose(fp);
+    if (!isLoaded)
+        return false;
+    memcpy(bram, pending_.data(), pending_.size());
+    saved_ = pending_;
+    isSaved_ = true;
+    isPending_ = false;
+    return true;
+}
+
+bool ClemensBRAMStore::save(const uint8_t *bram) {
+    if (isSaved_ && memcmp(saved_.data(), bram, saved_.size()) == 0) {
+        isPending_ = false;
+        return true;
+    }
+
+    auto tempPathname = pathname_ + ".tmp";
+    bool isWritten = false;
+    FILE *fp = fopen(tempPathname.c_str(), "wb");
+    if (fp) {
+        isWritten = fwrite(bram, 1, CLEM_RTC_BRAM_SIZE, fp) == CLEM_RTC_BRAM_SIZE;
+        isWritten = syncFile(fp) && isWritten;
+        isWritten = fclose(fp) == 0 && isWritten;
+    }
+    std::error_code errc;
+    if (isWritten) {
+        std::filesystem::rename(tempPathname, pathname_, errc);
+        isWritten = !errc;
+    }
+    if (!isWritten) {
+        std::filesystem::remove(tempPathname, errc);
+        //  the image stays pending so that the next update() tries again
+        if (bram != pending_.data()) {
+            memcpy(pending_.data(), bram, pending_.size());
+        }
+        isPending_ = true;
+        return false;
+    }
+    memcpy(saved_.data(), bram, saved_.size());
+    isSaved_ = true;
+    isPending_ = false;
+    failureCount_ = 0;
+    return true;
+}
+
+bool ClemensBRAMStore::update(const uint8_t *bram, bool isDirty, Clock::time_point now) {
+    if (isDirty) {
+        if (!isPending_) {
+            firstChangeTime_ = now;
+        }
+        memcpy(pending_.data(), bram, pending_.size());
+        lastChangeTime_ = now;
+        isPending_ = true;
+    }
+    if (!isPending_)
+        return true;
+    if (failureCount_ > 0) {
+        if (now < retryTime_)
+            return true;
+    } else if (now - lastChangeTime_ < kQuietTime && now - firstChangeTime_ < kMaxDelay) {
+        return true;
+    }
+    if (flush())
+        return true;
+    auto retryDelay = kRetryDelay * (1 << std::min(failureCount_, 5u));
+    retryTime_ = now + std::min<Clock::duration>(retryDelay, kRetryDelayLimit);
+    //  only the first failure of a run is reported
+    return failureCount_++ > 0;
+}
+
+bool ClemensBRAMStore::flush() {
+    if (!isPending_)
+        return true;
+    return save(pending_.data());
+}
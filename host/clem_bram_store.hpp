@@ -0,0 +1,59 @@
+#ifndef CLEM_HOST_BRAM_STORE_HPP
+#define CLEM_HOST_BRAM_STORE_HPP
+
+#include "clem_mmio_defs.h"
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+//  Persists a machine's battery RAM to a file.
+//
+//  save() writes the image to a temporary file next to the target, flushes it
+//  to disk and renames it over the target, so the file on disk is always either
+//  the previous image or the new one, even if the process is killed mid-write.
+//
+//  While the machine runs, update() is called with the BRAM after every
+//  timeslice.  Changes are written once the BRAM has been left alone for a
+//  moment, or after a bounded delay if the guest keeps changing it, so that
+//  a control panel session does not turn into a write per keystroke.  A
+//  failed write is retried with a growing delay between attempts.
+//
+class ClemensBRAMStore {
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit ClemensBRAMStore(std::string pathname);
+
+    const std::string &getPathname() const { return pathname_; }
+
+    //  Returns false if there is no valid image, leaving bram untouched
+    bool load(uint8_t *bram);
+    //  Writes the image immediately, replacing any pending write.  If the
+    //  write fails, the image is left pending for update() to retry.
+    bool save(const uint8_t *bram);
+
+    //  isDirty is the BRAM dirty flag since the last update.  Returns false if
+    //  a write was due and failed after the last one succeeded, so that a run
+    //  of failures is reported once.
+    bool update(const uint8_t *bram, bool isDirty, Clock::time_point now);
+    //  Writes a pending change immediately
+    bool flush();
+
+    bool hasPendingChanges() const { return isPending_; }
+
+  private:
+    std::string pathname_;
+    std::array<uint8_t, CLEM_RTC_BRAM_SIZE> saved_;
+    std::array<uint8_t, CLEM_RTC_BRAM_SIZE> pending_;
+    bool isSaved_;
+    bool isPending_;
+    Clock::time_point firstChangeTime_;
+    Clock::time_point lastChangeTime_;
+    //  failed writes from update() since the last successful one
+    unsigned failureCount_;
+    Clock::time_point retryTime_;
+};
+
+#endif
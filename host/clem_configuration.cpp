@@ -1,12 +1,18 @@
 #include "clem_configuration.hpp"
+#include "clem_host_utils.hpp"
 #include "fmt/format.h"
 #include "ini.h"
 
+#include <algorithm>
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
 
 ClemensConfiguration::ClemensConfiguration(std::string iniPathname)
-    : majorVersion(0), minorVersion(0), iniPathname_(std::move(iniPathname)) {
+    : majorVersion(0), minorVersion(0), ramSizeKB(0),
+      emulatorPriority(kClemensHostThreadPriority_Normal),
+      audioPriority(kClemensHostThreadPriority_Normal), smartPortWriteBack(false),
+      iniPathname_(std::move(iniPathname)) {
 
     if (ini_parse(iniPathname_.c_str(), &ClemensConfiguration::handler, this)) {
         return;
@@ -23,6 +29,56 @@ void ClemensConfiguration::save() {
     fprintf(fp, "major=%u\n", majorVersion);
     fprintf(fp, "minor=%u\n", minorVersion);
     fprintf(fp, "\n");
+    if (!bramPathname.empty() || rtcEpochTime.has_value() || ramSizeKB != 0 ||
+        !overlayPath.empty()) {
+        fprintf(fp, "[machine]\n");
+        if (!bramPathname.empty()) {
+            fprintf(fp, "bram=%s\n", bramPathname.c_str());
+        }
+        if (rtcEpochTime.has_value()) {
+            fprintf(fp, "rtc_epoch=%lld\n", (long long)*rtcEpochTime);
+        }
+        if (ramSizeKB != 0) {
+            fprintf(fp, "ram_kb=%u\n", ramSizeKB);
+        }
+        if (!overlayPath.empty()) {
+            fprintf(fp, "overlay=%s\n", overlayPath.c_str());
+        }
+        fprintf(fp, "\n");
+    }
+    if (emulatorProcessor.has_value() || audioProcessor.has_value() ||
+        emulatorPriority != kClemensHostThreadPriority_Normal ||
+        audioPriority != kClemensHostThreadPriority_Normal) {
+        fprintf(fp, "[threads]\n");
+        if (emulatorProcessor.has_value()) {
+            fprintf(fp, "emulator_cpu=%u\n", *emulatorProcessor);
+        }
+        fprintf(fp, "emulator_priority=%s\n", getThreadPriorityName(emulatorPriority));
+        if (audioProcessor.has_value()) {
+            fprintf(fp, "audio_cpu=%u\n", *audioProcessor);
+        }
+        fprintf(fp, "audio_priority=%s\n", getThreadPriorityName(audioPriority));
+        fprintf(fp, "\n");
+    }
+    if (smartPortWriteBack ||
+        std::any_of(smartPortImagePaths.begin(), smartPortImagePaths.end(),
+                    [](const std::string &path) { return !path.empty(); })) {
+        fprintf(fp, "[smartport]\n");
+        for (size_t unitIndex = 0; unitIndex < smartPortImagePaths.size(); ++unitIndex) {
+            if (smartPortImagePaths[unitIndex].empty())
+                continue;
+            fprintf(fp, "hdd%zu=%s\n", unitIndex + 1, smartPortImagePaths[unitIndex].c_str());
+        }
+        if (smartPortWriteBack) {
+            fprintf(fp, "write_back=1\n");
+        }
+        fprintf(fp, "\n");
+    }
+    if (!debugSocketPath.empty()) {
+        fprintf(fp, "[debug]\n");
+        fprintf(fp, "socket=%s\n", debugSocketPath.c_str());
+        fprintf(fp, "\n");
+    }
 
     fclose(fp);
 }
@@ -36,6 +92,45 @@ int ClemensConfiguration::handler(void *user, const char *section, const char *n
         } else if (strncmp(name, "minor", 16) == 0) {
             config->minorVersion = (unsigned)(atoi(value));
         }
+    } else if (strncmp(section, "machine", 16) == 0) {
+        if (strncmp(name, "bram", 16) == 0) {
+            config->bramPathname = value;
+        } else if (strncmp(name, "rtc_epoch", 16) == 0) {
+            config->rtcEpochTime = (int64_t)strtoll(value, nullptr, 10);
+        } else if (strncmp(name, "ram_kb", 16) == 0) {
+            config->ramSizeKB = (unsigned)(atoi(value));
+        } else if (strncmp(name, "overlay", 16) == 0) {
+            config->overlayPath = value;
+        }
+    } else if (strncmp(section, "threads", 16) == 0) {
+        if (strncmp(name, "emulator_cpu", 16) == 0) {
+            config->emulatorProcessor = (unsigned)(atoi(value));
+        } else if (strncmp(name, "emulator_priority", 32) == 0) {
+            if (!parseThreadPriority(value, config->emulatorPriority)) {
+                fmt::print("ClemensConfiguration: unknown priority '{}'\n", value);
+            }
+        } else if (strncmp(name, "audio_cpu", 16) == 0) {
+            config->audioProcessor = (unsigned)(atoi(value));
+        } else if (strncmp(name, "audio_priority", 16) == 0) {
+            if (!parseThreadPriority(value, config->audioPriority)) {
+                fmt::print("ClemensConfiguration: unknown priority '{}'\n", value);
+            }
+        }
+    } else if (strncmp(section, "smartport", 16) == 0) {
+        if (strncmp(name, "hdd", 3) == 0) {
+            unsigned unit = (unsigned)(atoi(name + 3));
+            if (unit >= 1 && unit <= config->smartPortImagePaths.size()) {
+                config->smartPortImagePaths[unit - 1] = value;
+            } else {
+                fmt::print("ClemensConfiguration: no SmartPort unit '{}'\n", name);
+            }
+        } else if (strncmp(name, "write_back", 16) == 0) {
+            config->smartPortWriteBack = atoi(value) != 0;
+        }
+    } else if (strncmp(section, "debug", 16) == 0) {
+        if (strncmp(name, "socket", 16) == 0) {
+            config->debugSocketPath = value;
+        }
     }
     return 1;
 }
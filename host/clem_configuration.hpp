@@ -1,11 +1,41 @@
 #ifndef CLEM_HOST_CONFIGURATION_HPP
 #define CLEM_HOST_CONFIGURATION_HPP
 
+#include "clem_host_platform.h"
+#include "clem_smartport.h"
+
+#include <array>
+#include <cstdint>
+#include <optional>
 #include <string>
 
 struct ClemensConfiguration {
     unsigned majorVersion;
     unsigned minorVersion;
+    //  [machine] bram - the battery RAM image, clem.bram if empty
+    std::string bramPathname;
+    //  [machine] rtc_epoch - Unix time the RTC starts from for repeatable runs
+    std::optional<int64_t> rtcEpochTime;
+    //  [machine] ram_kb - RAM size from 256 to 8192 (0 for the default 4096)
+    unsigned ramSizeKB;
+    //  [machine] overlay - a directory for delta files, which makes disk images
+    //  read-only masters that several machines can share
+    std::string overlayPath;
+    //  [threads] emulator_cpu, audio_cpu - pin the thread to this processor
+    //  [threads] emulator_priority, audio_priority - normal, high or realtime
+    std::optional<unsigned> emulatorProcessor;
+    ClemensHostThreadPriority emulatorPriority;
+    std::optional<unsigned> audioProcessor;
+    ClemensHostThreadPriority audioPriority;
+    //  [smartport] hdd1 to hdd4 - hard drive images in the disk library by unit.
+    //  Unit 1 is smartport.2mg if none are given.
+    //  A directory is mounted as a ProDOS volume.
+    std::array<std::string, CLEM_SMARTPORT_DRIVE_LIMIT> smartPortImagePaths;
+    //  [smartport] write_back - guest changes to mounted directories are
+    //  written back to them
+    bool smartPortWriteBack;
+    //  [debug] socket - serve the debugger on this Unix-domain socket path
+    std::string debugSocketPath;
 
     ClemensConfiguration(std::string iniPathname);
 
@@ -0,0 +1,685 @@
+#include "clem_debug_server.hpp"
+#include "clem_backend.hpp"
+#include "clem_mem.h"
+
+#include "fmt/format.h"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <functional>
+
+#if !defined(_WIN32)
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+//  The largest packet is an 'm' reply, so reads are capped to fit one
+constexpr unsigned kPacketSize = 0x4000;
+constexpr uint32_t kMemoryReadLimit = kPacketSize / 2 - 16;
+constexpr uint32_t kAddressLimit = 0x1000000;
+constexpr uint32_t kWatchLengthLimit = 16;
+constexpr uint32_t kIOPageKey = 0x10000;
+//  how often a running machine is checked for a stop
+constexpr auto kStopPollInterval = std::chrono::milliseconds(50);
+//  a machine that doesn't publish for this long is considered gone
+constexpr auto kSyncTimeout = std::chrono::seconds(2);
+
+bool parseHex(std::string_view text, uint32_t &value) {
+    if (text.empty())
+        return false;
+    auto result = std::from_chars(text.data(), text.data() + text.size(), value, 16);
+    return result.ec == std::errc{} && result.ptr == text.data() + text.size();
+}
+
+//  "<addr>,<len>" with anything after the length left in rest
+bool parseAddressLength(std::string_view text, uint32_t &address, uint32_t &length,
+                        std::string_view *rest = nullptr) {
+    auto sepPos = text.find(',');
+    if (sepPos == std::string_view::npos)
+        return false;
+    auto lengthText = text.substr(sepPos + 1);
+    if (rest) {
+        auto endPos = lengthText.find_first_of(":;");
+        *rest = endPos != std::string_view::npos ? lengthText.substr(endPos + 1) : "";
+        lengthText = lengthText.substr(0, endPos);
+    }
+    return parseHex(text.substr(0, sepPos), address) && parseHex(lengthText, length);
+}
+
+int hexDigit(char c) {
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+bool decodeHex(std::string_view text, std::vector<uint8_t> &bytes) {
+    if (text.size() % 2)
+        return false;
+    bytes.clear();
+    for (size_t index = 0; index < text.size(); index += 2) {
+        int hi = hexDigit(text[index]);
+        int lo = hexDigit(text[index + 1]);
+        if (hi < 0 || lo < 0)
+            return false;
+        bytes.push_back(uint8_t((hi << 4) | lo));
+    }
+    return true;
+}
+
+void appendHex(std::string &text, uint32_t value, unsigned byteCount) {
+    //  little-endian, as registers are sent
+    for (unsigned index = 0; index < byteCount; ++index, value >>= 8) {
+        fmt::format_to(std::back_inserter(text), "{:02x}", value & 0xff);
+    }
+}
+
+} // namespace
+
+void ClemensDebugPacketReader::feed(const uint8_t *data, size_t size) {
+    if (offset_ > 0 && offset_ == buffer_.size()) {
+        buffer_.clear();
+        offset_ = 0;
+    }
+    buffer_.append(reinterpret_cast<const char *>(data), size);
+}
+
+ClemensDebugPacketReader::Event ClemensDebugPacketReader::next(std::string &payload) {
+    while (offset_ < buffer_.size()) {
+        char c = buffer_[offset_];
+        if (c == '\x03') {
+            ++offset_;
+            return Event::Interrupt;
+        }
+        if (c != '$') {
+            //  acks and line noise between packets
+            ++offset_;
+            continue;
+        }
+        auto endPos = buffer_.find('#', offset_ + 1);
+        if (endPos == std::string::npos || endPos + 2 >= buffer_.size())
+            return Event::None;
+        uint8_t checksum = 0;
+        payload.clear();
+        for (size_t index = offset_ + 1; index < endPos; ++index) {
+            checksum += uint8_t(buffer_[index]);
+            if (buffer_[index] == '}' && index + 1 < endPos) {
+                ++index;
+                checksum += uint8_t(buffer_[index]);
+                payload.push_back(char(buffer_[index] ^ 0x20));
+            } else {
+                payload.push_back(buffer_[index]);
+            }
+        }
+        int hi = hexDigit(buffer_[endPos + 1]);
+        int lo = hexDigit(buffer_[endPos + 2]);
+        offset_ = endPos + 3;
+        if (hi < 0 || lo < 0 || uint8_t((hi << 4) | lo) != checksum)
+            return Event::BadPacket;
+        return Event::Packet;
+    }
+    return Event::None;
+}
+
+std::string ClemensDebugPacketReader::frame(std::string_view payload) {
+    std::string packet;
+    packet.reserve(payload.size() + 4);
+    packet.push_back('$');
+    uint8_t checksum = 0;
+    for (char c : payload) {
+        if (c == '$' || c == '#' || c == '}' || c == '*') {
+            packet.push_back('}');
+            checksum += uint8_t('}');
+            c = char(c ^ 0x20);
+        }
+        packet.push_back(c);
+        checksum += uint8_t(c);
+    }
+    fmt::format_to(std::back_inserter(packet), "#{:02x}", checksum);
+    return packet;
+}
+
+ClemensDebugServer::ClemensDebugServer(std::string socketPath)
+    : socketPath_(std::move(socketPath)), listenFd_(-1), wakeFds_{-1, -1}, backend_(nullptr),
+      isStopping_(false), isClientConnected_(false), publishCount_(0), isRunning_(false),
+      isTerminated_(false), regs_{}, isEmulation_(false), memoryGeneration_(0),
+      isMemoryValid_(false), isNoAckMode_(false), isWaitingForStop_(false),
+      stopPublishCount_(0) {
+#if !defined(_WIN32)
+    struct sockaddr_un addr {};
+    if (socketPath_.size() >= sizeof(addr.sun_path))
+        return;
+    if (pipe(wakeFds_) != 0) {
+        wakeFds_[0] = wakeFds_[1] = -1;
+        return;
+    }
+    fcntl(wakeFds_[0], F_SETFL, O_NONBLOCK);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return;
+    //  a socket left behind by an earlier run would fail the bind.  Anything
+    //  else at the path is left alone and fails the bind instead.
+    struct stat pathStat;
+    if (lstat(socketPath_.c_str(), &pathStat) == 0 && S_ISSOCK(pathStat.st_mode)) {
+        unlink(socketPath_.c_str());
+    }
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path, socketPath_.data(), socketPath_.size());
+    if (bind(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) != 0 ||
+        listen(fd, 1) != 0) {
+        close(fd);
+        return;
+    }
+    listenFd_ = fd;
+#endif
+}
+
+ClemensDebugServer::~ClemensDebugServer() {
+    stop();
+#if !defined(_WIN32)
+    if (listenFd_ >= 0) {
+        close(listenFd_);
+        unlink(socketPath_.c_str());
+    }
+    if (wakeFds_[0] >= 0) {
+        close(wakeFds_[0]);
+        close(wakeFds_[1]);
+    }
+#endif
+}
+
+void ClemensDebugServer::start(ClemensBackend &backend) {
+    stop();
+    backend_ = &backend;
+    if (!isListening())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(stateMutex_);
+        isTerminated_ = false;
+        isMemoryValid_ = false;
+    }
+    thread_ = std::thread(&ClemensDebugServer::serve, this);
+}
+
+void ClemensDebugServer::stop() {
+    if (!thread_.joinable())
+        return;
+#if !defined(_WIN32)
+    isStopping_ = true;
+    uint8_t wake = 1;
+    (void)!write(wakeFds_[1], &wake, 1);
+    thread_.join();
+    while (read(wakeFds_[0], &wake, 1) == 1) {
+    }
+    isStopping_ = false;
+#endif
+    backend_ = nullptr;
+}
+
+void ClemensDebugServer::publish(const ClemensBackendState &state) {
+    //  the emulator moves on rather than wait for a client that is reading
+    std::unique_lock<std::mutex> lock(stateMutex_, std::try_to_lock);
+    if (!lock.owns_lock())
+        return;
+    isRunning_ = state.isRunning;
+    if (state.terminated.has_value() && *state.terminated) {
+        isTerminated_ = true;
+    }
+    regs_ = state.machine->cpu.regs;
+    isEmulation_ = state.machine->cpu.pins.emulation;
+    breakpoints_.assign(state.bpBufferStart, state.bpBufferEnd);
+    if (isClientConnected_ && state.mmio_was_initialized) {
+        copyMemory(state.machine);
+    }
+    ++publishCount_;
+    lock.unlock();
+    statePublished_.notify_all();
+}
+
+void ClemensDebugServer::copyMemory(ClemensMachine *machine) {
+    if (!memory_) {
+        memory_ = std::make_unique<uint8_t[]>(kAddressLimit);
+        memoryPageKeys_ = std::make_unique<uint32_t[]>(CLEM_IIGS_PAGE_COUNT);
+    }
+    //  as with the frontend's memory views, only pages written since the last
+    //  copy (or that now map elsewhere) are copied again
+    const uint32_t *pageWriteGen = machine->mem.page_write_gen;
+    bool copyAll = !isMemoryValid_ || !pageWriteGen ||
+                   machine->mem.write_generation <= memoryGeneration_;
+    for (unsigned bank = 0; bank < 256; ++bank) {
+        for (unsigned page = 0; page < 256; ++page) {
+            unsigned pageIndex = (bank << 8) | page;
+            uint8_t *dest = memory_.get() + (pageIndex << 8);
+            uint16_t physicalPage;
+            const uint8_t *source =
+                clem_mem_get_read_page(machine, uint8_t(bank), uint8_t(page), &physicalPage);
+            if (source) {
+                if (!copyAll && memoryPageKeys_[pageIndex] == physicalPage &&
+                    pageWriteGen[physicalPage] <= memoryGeneration_)
+                    continue;
+                memcpy(dest, source, 256);
+                memoryPageKeys_[pageIndex] = physicalPage;
+            } else {
+                //  I/O and card pages aren't tracked and are always read
+                for (unsigned offset = 0; offset < 256; ++offset) {
+                    clem_read(machine, &dest[offset], uint16_t((page << 8) | offset),
+                              uint8_t(bank), CLEM_MEM_FLAG_NULL);
+                }
+                memoryPageKeys_[pageIndex] = kIOPageKey;
+            }
+        }
+    }
+    memoryGeneration_ = machine->mem.write_generation;
+    isMemoryValid_ = true;
+}
+
+#if !defined(_WIN32)
+
+void ClemensDebugServer::serve() {
+    while (!isStopping_) {
+        struct pollfd fds[2] = {{listenFd_, POLLIN, 0}, {wakeFds_[0], POLLIN, 0}};
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        if (fds[1].revents)
+            break;
+        if (!(fds[0].revents & POLLIN))
+            continue;
+        int clientFd = accept(listenFd_, nullptr, nullptr);
+        if (clientFd < 0)
+            continue;
+        serveClient(clientFd);
+        close(clientFd);
+    }
+}
+
+void ClemensDebugServer::serveClient(int clientFd) {
+    {
+        std::lock_guard<std::mutex> lock(stateMutex_);
+        isMemoryValid_ = false;
+    }
+    isClientConnected_ = true;
+    isNoAckMode_ = false;
+    isWaitingForStop_ = false;
+
+    ClemensDebugPacketReader reader;
+    std::string payload;
+    uint8_t chunk[4096];
+    bool isConnected = true;
+    while (isConnected && !isStopping_) {
+        struct pollfd fds[2] = {{clientFd, POLLIN, 0}, {wakeFds_[0], POLLIN, 0}};
+        int timeout = isWaitingForStop_ ? int(kStopPollInterval.count()) : -1;
+        if (poll(fds, 2, timeout) < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        if (fds[1].revents)
+            break;
+        if (fds[0].revents) {
+            ssize_t readCount = recv(clientFd, chunk, sizeof(chunk), 0);
+            if (readCount <= 0)
+                break;
+            reader.feed(chunk, size_t(readCount));
+            ClemensDebugPacketReader::Event event;
+            while (isConnected && (event = reader.next(payload)) !=
+                                      ClemensDebugPacketReader::Event::None) {
+                switch (event) {
+                case ClemensDebugPacketReader::Event::Interrupt:
+                    if (isWaitingForStop_) {
+                        backend_->breakExecution();
+                    }
+                    break;
+                case ClemensDebugPacketReader::Event::BadPacket:
+                    if (!isNoAckMode_) {
+                        isConnected = send(clientFd, "-", 1, MSG_NOSIGNAL) == 1;
+                    }
+                    break;
+                case ClemensDebugPacketReader::Event::Packet:
+                    if (!isNoAckMode_ && send(clientFd, "+", 1, MSG_NOSIGNAL) != 1) {
+                        isConnected = false;
+                    } else {
+                        isConnected = handlePacket(clientFd, payload);
+                    }
+                    break;
+                default:
+                    break;
+                }
+            }
+        }
+        if (isConnected && isWaitingForStop_ && checkStopped()) {
+            isWaitingForStop_ = false;
+            bool isTerminated;
+            {
+                std::lock_guard<std::mutex> lock(stateMutex_);
+                isTerminated = isTerminated_;
+            }
+            isConnected = sendPacket(clientFd, isTerminated ? "W00" : "S05");
+        }
+    }
+    isClientConnected_ = false;
+}
+
+bool ClemensDebugServer::sendPacket(int clientFd, std::string_view payload) {
+    auto packet = ClemensDebugPacketReader::frame(payload);
+    size_t sentCount = 0;
+    while (sentCount < packet.size()) {
+        ssize_t result =
+            send(clientFd, packet.data() + sentCount, packet.size() - sentCount, MSG_NOSIGNAL);
+        if (result < 0 && errno == EINTR)
+            continue;
+        if (result <= 0)
+            return false;
+        sentCount += size_t(result);
+    }
+    return true;
+}
+
+#else
+
+void ClemensDebugServer::serve() {}
+
+void ClemensDebugServer::serveClient(int) {}
+
+bool ClemensDebugServer::sendPacket(int, std::string_view) { return false; }
+
+#endif
+
+bool ClemensDebugServer::handlePacket(int clientFd, const std::string &payload) {
+    if (payload.empty())
+        return sendPacket(clientFd, "");
+    std::string_view args = std::string_view(payload).substr(1);
+    uint32_t address, length, value;
+    switch (payload[0]) {
+    case '?':
+        backend_->breakExecution();
+        return sendPacket(clientFd, syncState() ? "S05" : "E01");
+    case 'g': {
+        //  the last published registers do if the sync times out
+        bool isSynced = syncState();
+        std::string registers = readRegisters();
+        if (!isSynced && registers.empty())
+            return sendPacket(clientFd, "E01");
+        return sendPacket(clientFd, registers);
+    }
+    case 'G': {
+        std::vector<uint8_t> bytes;
+        if (!decodeHex(args, bytes) || bytes.size() < 15)
+            return sendPacket(clientFd, "E01");
+        //  the 16-bit registers, then P, DBR and PBR.  E can't be written.
+        for (unsigned index = 0; index < 6; ++index) {
+            writeRegister(index, bytes[index * 2] | (uint32_t(bytes[index * 2 + 1]) << 8));
+        }
+        for (unsigned index = 6; index < 9; ++index) {
+            writeRegister(index, bytes[6 + index]);
+        }
+        return sendPacket(clientFd, syncState() ? "OK" : "E01");
+    }
+    case 'p': {
+        if (!parseHex(args, value) || value >= unsigned(Register::Count))
+            return sendPacket(clientFd, "E01");
+        auto regs = readRegisters();
+        size_t offset = value < 6 ? value * 4 : 24 + (value - 6) * 2;
+        return sendPacket(clientFd, regs.substr(offset, value < 6 ? 4 : 2));
+    }
+    case 'P': {
+        auto sepPos = args.find('=');
+        std::vector<uint8_t> bytes;
+        if (sepPos == std::string_view::npos || !parseHex(args.substr(0, sepPos), address) ||
+            !decodeHex(args.substr(sepPos + 1), bytes) || bytes.empty() || bytes.size() > 4)
+            return sendPacket(clientFd, "E01");
+        value = 0;
+        for (size_t index = 0; index < bytes.size(); ++index) {
+            value |= uint32_t(bytes[index]) << (index * 8);
+        }
+        if (!writeRegister(address, value))
+            return sendPacket(clientFd, "E01");
+        return sendPacket(clientFd, syncState() ? "OK" : "E01");
+    }
+    case 'm':
+        if (!parseAddressLength(args, address, length) || length > kMemoryReadLimit ||
+            address >= kAddressLimit || length > kAddressLimit - address)
+            return sendPacket(clientFd, "E01");
+        return sendPacket(clientFd, readMemory(address, length));
+    case 'M': {
+        std::string_view data;
+        std::vector<uint8_t> bytes;
+        if (!parseAddressLength(args, address, length, &data) || !decodeHex(data, bytes) ||
+            bytes.size() != length || address >= kAddressLimit ||
+            length > kAddressLimit - address)
+            return sendPacket(clientFd, "E01");
+        if (!bytes.empty()) {
+            backend_->debugMemoryWriteBlock(address, bytes.data(), bytes.size());
+        }
+        return sendPacket(clientFd, syncState() ? "OK" : "E01");
+    }
+    case 'Z':
+    case 'z': {
+        if (args.size() < 2 || args[1] != ',' ||
+            !parseAddressLength(args.substr(2), address, length) || address >= kAddressLimit)
+            return sendPacket(clientFd, "E01");
+        bool isDone = payload[0] == 'Z' ? addBreakpoint(args[0], address, length)
+                                        : removeBreakpoint(args[0], address, length);
+        //  an unknown kind gets an empty reply so the client knows it isn't supported
+        if (args[0] < '0' || args[0] > '4')
+            return sendPacket(clientFd, "");
+        return sendPacket(clientFd, isDone ? "OK" : "E01");
+    }
+    case 'c':
+    case 's':
+        resume(payload[0] == 's', args);
+        return true;
+    case 'D':
+        backend_->run();
+        sendPacket(clientFd, "OK");
+        return false;
+    case 'k':
+        backend_->terminate();
+        return false;
+    case 'H':
+        //  there is only the one thread
+        return sendPacket(clientFd, "OK");
+    case 'q':
+        if (args.substr(0, 9) == "Supported")
+            return sendPacket(clientFd,
+                              fmt::format("PacketSize={:x};QStartNoAckMode+", kPacketSize));
+        if (args == "Attached")
+            return sendPacket(clientFd, "1");
+        return sendPacket(clientFd, "");
+    case 'Q':
+        if (args == "StartNoAckMode") {
+            bool isSent = sendPacket(clientFd, "OK");
+            isNoAckMode_ = true;
+            return isSent;
+        }
+        return sendPacket(clientFd, "");
+    default:
+        return sendPacket(clientFd, "");
+    }
+}
+
+bool ClemensDebugServer::syncState() {
+    //  a publish in progress when the commands were queued may predate them, so
+    //  the one after it is the first that is sure to include them
+    std::unique_lock<std::mutex> lock(stateMutex_);
+    uint64_t targetCount = publishCount_ + 2;
+    auto deadline = std::chrono::steady_clock::now() + kSyncTimeout;
+    while (publishCount_ < targetCount && !isTerminated_) {
+        if (std::chrono::steady_clock::now() >= deadline)
+            return false;
+        lock.unlock();
+        backend_->publish();
+        lock.lock();
+        statePublished_.wait_for(lock, kStopPollInterval);
+    }
+    return !isTerminated_;
+}
+
+bool ClemensDebugServer::checkStopped() {
+    backend_->publish();
+    std::lock_guard<std::mutex> lock(stateMutex_);
+    if (isTerminated_)
+        return true;
+    return publishCount_ >= stopPublishCount_ && !isRunning_;
+}
+
+std::string ClemensDebugServer::readRegisters() {
+    std::lock_guard<std::mutex> lock(stateMutex_);
+    std::string text;
+    if (publishCount_ == 0)
+        return text;
+    appendHex(text, regs_.A, 2);
+    appendHex(text, regs_.X, 2);
+    appendHex(text, regs_.Y, 2);
+    appendHex(text, regs_.S, 2);
+    appendHex(text, regs_.D, 2);
+    appendHex(text, regs_.PC, 2);
+    appendHex(text, regs_.P, 1);
+    appendHex(text, regs_.DBR, 1);
+    appendHex(text, regs_.PBR, 1);
+    appendHex(text, isEmulation_ ? 1 : 0, 1);
+    return text;
+}
+
+bool ClemensDebugServer::writeRegister(unsigned index, uint32_t value) {
+    using MachineProperty = ClemensBackendMachineProperty;
+    static const MachineProperty kProperties[] = {
+        MachineProperty::RegC,  MachineProperty::RegX,   MachineProperty::RegY,
+        MachineProperty::RegSP, MachineProperty::RegD,   MachineProperty::RegPC,
+        MachineProperty::RegP,  MachineProperty::RegDBR, MachineProperty::RegPBR};
+    if (index >= sizeof(kProperties) / sizeof(kProperties[0]))
+        return false;
+    backend_->debugRegisterWrite(kProperties[index], value);
+    return true;
+}
+
+std::string ClemensDebugServer::readMemory(uint32_t address, uint32_t length) {
+    std::unique_lock<std::mutex> lock(stateMutex_);
+    if (!isMemoryValid_) {
+        lock.unlock();
+        if (!syncState())
+            return "E01";
+        lock.lock();
+        if (!isMemoryValid_)
+            return "E01";
+    }
+    std::string text;
+    text.reserve(length * 2);
+    for (uint32_t index = 0; index < length; ++index) {
+        fmt::format_to(std::back_inserter(text), "{:02x}", memory_[address + index]);
+    }
+    return text;
+}
+
+bool ClemensDebugServer::addBreakpoint(char kind, uint32_t address, uint32_t length) {
+    ClemensBackendBreakpoint breakpoint{};
+    breakpoint.address = address;
+    switch (kind) {
+    case '0':
+    case '1':
+        breakpoint.type = ClemensBackendBreakpoint::Execute;
+        backend_->addBreakpoint(breakpoint);
+        break;
+    case '2':
+    case '3':
+    case '4':
+        //  watched bytes are separate breakpoints in the backend
+        if (length == 0 || length > kWatchLengthLimit || address + length > kAddressLimit)
+            return false;
+        for (uint32_t index = 0; index < length; ++index) {
+            breakpoint.address = address + index;
+            if (kind != '3') {
+                breakpoint.type = ClemensBackendBreakpoint::Write;
+                backend_->addBreakpoint(breakpoint);
+            }
+            if (kind != '2') {
+                breakpoint.type = ClemensBackendBreakpoint::DataRead;
+                backend_->addBreakpoint(breakpoint);
+            }
+        }
+        break;
+    default:
+        return false;
+    }
+    //  so that a removal right after finds it in the published list
+    return syncState();
+}
+
+bool ClemensDebugServer::removeBreakpoint(char kind, uint32_t address, uint32_t length) {
+    if (kind < '0' || kind > '4')
+        return false;
+    if (kind == '0' || kind == '1') {
+        length = 1;
+    }
+    if (!syncState())
+        return false;
+    //  removal is by index, highest first so the lower indices stay put
+    std::vector<unsigned> indices;
+    {
+        std::lock_guard<std::mutex> lock(stateMutex_);
+        for (unsigned index = 0; index < breakpoints_.size(); ++index) {
+            auto &breakpoint = breakpoints_[index];
+            if (breakpoint.address < address || breakpoint.address - address >= length)
+                continue;
+            bool isMatch;
+            switch (breakpoint.type) {
+            case ClemensBackendBreakpoint::Execute:
+                isMatch = kind == '0' || kind == '1';
+                break;
+            case ClemensBackendBreakpoint::Write:
+                isMatch = kind == '2' || kind == '4';
+                break;
+            case ClemensBackendBreakpoint::DataRead:
+                isMatch = kind == '3' || kind == '4';
+                break;
+            default:
+                isMatch = false;
+                break;
+            }
+            if (isMatch) {
+                indices.push_back(index);
+            }
+        }
+    }
+    if (indices.empty())
+        return false;
+    std::sort(indices.begin(), indices.end(), std::greater<unsigned>());
+    for (unsigned index : indices) {
+        backend_->removeBreakpoint(index);
+    }
+    return syncState();
+}
+
+void ClemensDebugServer::resume(bool step, const std::string_view &addressParam) {
+    uint32_t address;
+    if (parseHex(addressParam, address)) {
+        writeRegister(unsigned(Register::PBR), (address >> 16) & 0xff);
+        writeRegister(unsigned(Register::PC), address & 0xffff);
+    }
+    {
+        //  states published before the run was picked up still show the
+        //  machine stopped
+        std::lock_guard<std::mutex> lock(stateMutex_);
+        stopPublishCount_ = publishCount_ + 2;
+    }
+    if (step) {
+        backend_->step(1);
+    } else {
+        backend_->run();
+    }
+    isWaitingForStop_ = true;
+}
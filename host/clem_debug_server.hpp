@@ -0,0 +1,138 @@
+#ifndef CLEM_HOST_DEBUG_SERVER_HPP
+#define CLEM_HOST_DEBUG_SERVER_HPP
+
+#include "clem_host_shared.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+class ClemensBackend;
+
+//  Splits a GDB remote serial protocol stream into packets.  Bytes are fed in
+//  as they arrive and complete packets (or interrupts) are taken out.
+//
+//  A packet is '$' <payload> '#' <two hex digit checksum>, where the checksum
+//  is the sum of the payload bytes.  '}' escapes the next byte (XOR 0x20) and
+//  a lone 0x03 outside a packet asks the target to stop.
+//
+class ClemensDebugPacketReader {
+  public:
+    enum class Event { None, Packet, BadPacket, Interrupt };
+
+    void feed(const uint8_t *data, size_t size);
+    //  Returns the next event, with the packet payload in payload
+    Event next(std::string &payload);
+
+    static std::string frame(std::string_view payload);
+
+  private:
+    std::string buffer_;
+    size_t offset_ = 0;
+};
+
+//  Lets external tools drive the debugger over a Unix-domain socket using a
+//  subset of the GDB remote serial protocol.  One client is served at a time.
+//
+//  Supported packets:
+//      ?                   halts the machine and reports the stop (S05)
+//      g / G <regs>        reads or writes all registers
+//      p <n> / P <n>=<v>   reads or writes register n
+//      m <addr>,<len>      reads memory (24-bit address)
+//      M <addr>,<len>:<hex> writes memory
+//      Z0/Z1 <addr>,<kind> sets an execute breakpoint (z removes)
+//      Z2/Z3/Z4 <addr>,<len> sets a write, read or access watchpoint
+//      c [addr] / s [addr] continues or steps one instruction, optionally
+//                          from a new PBR:PC, and reports the next stop
+//      D                   detaches, leaving the machine running
+//      k                   terminates the machine
+//      0x03                stops the machine
+//
+//  Registers are numbered A, X, Y, S, D, PC (16-bit), P, DBR, PBR, E (8-bit),
+//  and are sent in that order as little-endian hex.  E is read-only.
+//
+//  Register and memory reads are served from the last published state, which
+//  publish() copies on the emulator thread while a client is connected.  The
+//  copy skips pages unchanged since the last one, and is skipped entirely if
+//  the client happens to be reading it, so the emulator never waits on a
+//  client.  Writes, breakpoints and run control go through the backend's
+//  command queue.
+//
+//  POSIX only.
+//
+class ClemensDebugServer {
+  public:
+    enum class Register { A, X, Y, S, D, PC, P, DBR, PBR, E, Count };
+
+    explicit ClemensDebugServer(std::string socketPath);
+    ~ClemensDebugServer();
+
+    ClemensDebugServer(const ClemensDebugServer &) = delete;
+    ClemensDebugServer &operator=(const ClemensDebugServer &) = delete;
+
+    bool isListening() const { return listenFd_ >= 0; }
+    const std::string &getSocketPath() const { return socketPath_; }
+
+    //  Serves clients using this backend until stop().  Calling start() again
+    //  moves clients over to a new backend.
+    void start(ClemensBackend &backend);
+    //  Must be called before the backend is destroyed
+    void stop();
+
+    //  Called from the backend's publish delegate
+    void publish(const ClemensBackendState &state);
+
+  private:
+    void serve();
+    void serveClient(int clientFd);
+    bool handlePacket(int clientFd, const std::string &payload);
+    bool sendPacket(int clientFd, std::string_view payload);
+
+    //  Waits until a publish reflects every command queued before the call
+    bool syncState();
+    void copyMemory(ClemensMachine *machine);
+    //  Empty if no state was published yet
+    std::string readRegisters();
+    bool writeRegister(unsigned index, uint32_t value);
+    std::string readMemory(uint32_t address, uint32_t length);
+    bool addBreakpoint(char kind, uint32_t address, uint32_t length);
+    bool removeBreakpoint(char kind, uint32_t address, uint32_t length);
+    void resume(bool step, const std::string_view &addressParam);
+    bool checkStopped();
+
+    std::string socketPath_;
+    int listenFd_;
+    int wakeFds_[2];
+    std::thread thread_;
+    ClemensBackend *backend_;
+    std::atomic<bool> isStopping_;
+    std::atomic<bool> isClientConnected_;
+
+    //  the published state, guarded by stateMutex_.  Memory pages are kept in
+    //  a mirror of all 256 banks along with the physical page each came from.
+    std::mutex stateMutex_;
+    std::condition_variable statePublished_;
+    uint64_t publishCount_;
+    bool isRunning_;
+    bool isTerminated_;
+    ClemensCPURegs regs_;
+    bool isEmulation_;
+    std::vector<ClemensBackendBreakpoint> breakpoints_;
+    std::unique_ptr<uint8_t[]> memory_;
+    std::unique_ptr<uint32_t[]> memoryPageKeys_;
+    uint32_t memoryGeneration_;
+    bool isMemoryValid_;
+
+    //  run control on the server thread
+    bool isNoAckMode_;
+    bool isWaitingForStop_;
+    uint64_t stopPublishCount_;
+};
+
+#endif
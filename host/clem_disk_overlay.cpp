@@ -0,0 +1,237 @@
+#include "clem_disk_overlay.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <vector>
+
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+
+//  Header: magic, version, track count, record count
+//  Record: track index, bit count, byte count, initialized, then the bytes
+constexpr uint8_t kDeltaMagic[4] = {'C', 'T', 'D', 'L'};
+constexpr uint32_t kDeltaVersion = 1;
+constexpr size_t kDeltaHeaderSize = 16;
+constexpr size_t kDeltaRecordHeaderSize = 16;
+
+void putU32(uint8_t *data, uint32_t value) {
+    data[0] = uint8_t(value & 0xff);
+    data[1] = uint8_t((value >> 8) & 0xff);
+    data[2] = uint8_t((value >> 16) & 0xff);
+    data[3] = uint8_t((value >> 24) & 0xff);
+}
+
+uint32_t getU32(const uint8_t *data) {
+    return data[0] | (uint32_t(data[1]) << 8) | (uint32_t(data[2]) << 16) |
+           (uint32_t(data[3]) << 24);
+}
+
+bool syncFile(FILE *fp) {
+    if (fflush(fp) != 0)
+        return false;
+#if defined(_WIN32)
+    return _commit(_fileno(fp)) == 0;
+#else
+    return fsync(fileno(fp)) == 0;
+#endif
+}
+
+} // namespace
+
+std::string ClemensDiskTrackOverlay::getDeltaPathname(const std::string &overlayDirectory,
+                                                      const std::string &imagePathname) {
+    std::string filename;
+    for (char c : imagePathname) {
+        if (c == '/' || c == '\\' || c == ':') {
+            //  runs of separators (and a leading one) add nothing
+            if (!filename.empty() && filename.back() != '_') {
+                filename.push_back('_');
+            }
+        } else {
+            filename.push_back(c);
+        }
+    }
+    filename += ".delta";
+    return (std::filesystem::path(overlayDirectory) / filename).string();
+}
+
+ClemensDiskTrackOverlay::ClemensDiskTrackOverlay() {
+    trackHashes_.fill(0);
+    trackBitCounts_.fill(0);
+}
+
+uint64_t ClemensDiskTrackOverlay::hashTrack(const ClemensNibbleDisk &disk, unsigned trackIndex) {
+    //  FNV-1a
+    const uint8_t *data = disk.bits_data + disk.track_byte_offset[trackIndex];
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (uint32_t i = 0; i < disk.track_byte_count[trackIndex]; ++i) {
+        hash = (hash ^ data[i]) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+bool ClemensDiskTrackOverlay::attach(const std::string &deltaPathname, ClemensNibbleDisk &disk) {
+    detach();
+
+    struct Record {
+        uint32_t trackIndex;
+        uint32_t bitCount;
+        uint8_t initialized;
+        std::vector<uint8_t> data;
+    };
+    std::vector<Record> records;
+    if (FILE *fp = fopen(deltaPathname.c_str(), "rb"); fp) {
+        uint8_t header[kDeltaHeaderSize];
+        bool isValid = fread(header, 1, sizeof(header), fp) == sizeof(header) &&
+                       memcmp(header, kDeltaMagic, sizeof(kDeltaMagic)) == 0 &&
+                       getU32(header + 4) == kDeltaVersion &&
+                       getU32(header + 8) == disk.track_count;
+        uint32_t recordCount = isValid ? getU32(header + 12) : 0;
+        for (uint32_t recordIndex = 0; isValid && recordIndex < recordCount; ++recordIndex) {
+            uint8_t recordHeader[kDeltaRecordHeaderSize];
+            Record record;
+            isValid = fread(recordHeader, 1, sizeof(recordHeader), fp) == sizeof(recordHeader);
+            if (!isValid)
+                break;
+            record.trackIndex = getU32(recordHeader);
+            record.bitCount = getU32(recordHeader + 4);
+            uint32_t byteCount = getU32(recordHeader + 8);
+            record.initialized = uint8_t(getU32(recordHeader + 12) != 0);
+            //  tracks are rewritten in place, so their space in the image must match
+            isValid = record.trackIndex < disk.track_count &&
+                      byteCount == disk.track_byte_count[record.trackIndex] &&
+                      record.bitCount <= byteCount * 8;
+            if (!isValid)
+                break;
+            record.data.resize(byteCount);
+            isValid = fread(record.data.data(), 1, byteCount, fp) == byteCount;
+            records.emplace_back(std::move(record));
+        }
+        fclose(fp);
+        if (!isValid)
+            return false;
+    }
+
+    for (auto &record : records) {
+        memcpy(disk.bits_data + disk.track_byte_offset[record.trackIndex], record.data.data(),
+               record.data.size());
+        disk.track_bits_count[record.trackIndex] = record.bitCount;
+        disk.track_initialized[record.trackIndex] = record.initialized;
+        deltaTracks_.set(record.trackIndex);
+    }
+    for (unsigned trackIndex = 0; trackIndex < disk.track_count; ++trackIndex) {
+        trackHashes_[trackIndex] = hashTrack(disk, trackIndex);
+        trackBitCounts_[trackIndex] = disk.track_bits_count[trackIndex];
+    }
+    path_ = deltaPathname;
+    return true;
+}
+
+bool ClemensDiskTrackOverlay::save(const ClemensNibbleDisk &disk) {
+    if (!isAttached())
+        return false;
+    for (unsigned trackIndex = 0; trackIndex < disk.track_count; ++trackIndex) {
+        if (deltaTracks_.test(trackIndex))
+            continue;
+        if (disk.track_bits_count[trackIndex] != trackBitCounts_[trackIndex] ||
+            hashTrack(disk, trackIndex) != trackHashes_[trackIndex]) {
+            deltaTracks_.set(trackIndex);
+        }
+    }
+    uint32_t recordCount = 0;
+    for (unsigned trackIndex = 0; trackIndex < disk.track_count; ++trackIndex) {
+        if (deltaTracks_.test(trackIndex)) {
+            ++recordCount;
+        }
+    }
+    std::error_code errc;
+    if (recordCount == 0) {
+        std::filesystem::remove(path_, errc);
+        return !errc;
+    }
+
+    //  replaced as a whole so that a failed save leaves the last delta intact
+    auto tempPathname = path_ + ".tmp";
+    FILE *fp = fopen(tempPathname.c_str(), "wb");
+    if (!fp)
+        return false;
+    uint8_t header[kDeltaHeaderSize];
+    memcpy(header, kDeltaMagic, sizeof(kDeltaMagic));
+    putU32(header + 4, kDeltaVersion);
+    putU32(header + 8, disk.track_count);
+    putU32(header + 12, recordCount);
+    bool isWritten = fwrite(header, 1, sizeof(header), fp) == sizeof(header);
+    for (unsigned trackIndex = 0; isWritten && trackIndex < disk.track_count; ++trackIndex) {
+        if (!deltaTracks_.test(trackIndex))
+            continue;
+        uint8_t recordHeader[kDeltaRecordHeaderSize];
+        uint32_t byteCount = disk.track_byte_count[trackIndex];
+        putU32(recordHeader, trackIndex);
+        putU32(recordHeader + 4, disk.track_bits_count[trackIndex]);
+        putU32(recordHeader + 8, byteCount);
+        putU32(recordHeader + 12, disk.track_initialized[trackIndex] ? 1 : 0);
+        isWritten = fwrite(recordHeader, 1, sizeof(recordHeader), fp) == sizeof(recordHeader) &&
+                    fwrite(disk.bits_data + disk.track_byte_offset[trackIndex], 1, byteCount,
+                           fp) == byteCount;
+    }
+    isWritten = syncFile(fp) && isWritten;
+    isWritten = fclose(fp) == 0 && isWritten;
+    if (isWritten) {
+        std::filesystem::rename(tempPathname, path_, errc);
+        isWritten = !errc;
+    }
+    if (!isWritten) {
+        std::filesystem::remove(tempPathname, errc);
+        return false;
+    }
+    return true;
+}
+
+bool ClemensDiskTrackOverlay::commit(const std::string &imagePathname, const uint8_t *data,
+                                     size_t dataSize) {
+    auto tempPathname = imagePathname + ".tmp";
+    FILE *fp = fopen(tempPathname.c_str(), "wb");
+    if (!fp)
+        return false;
+    bool isWritten = fwrite(data, 1, dataSize, fp) == dataSize;
+    isWritten = syncFile(fp) && isWritten;
+    isWritten = fclose(fp) == 0 && isWritten;
+    std::error_code errc;
+    if (isWritten) {
+        std::filesystem::rename(tempPathname, imagePathname, errc);
+        isWritten = !errc;
+    }
+    if (!isWritten) {
+        std::filesystem::remove(tempPathname, errc);
+        return false;
+    }
+    return discard();
+}
+
+bool ClemensDiskTrackOverlay::discard() {
+    if (!isAttached())
+        return true;
+    std::error_code errc;
+    std::filesystem::remove(path_, errc);
+    deltaTracks_.reset();
+    return !errc;
+}
+
+void ClemensDiskTrackOverlay::reattach(const std::string &deltaPathname) {
+    detach();
+    path_ = deltaPathname;
+    deltaTracks_.set();
+}
+
+void ClemensDiskTrackOverlay::detach() {
+    path_.clear();
+    deltaTracks_.reset();
+    trackHashes_.fill(0);
+    trackBitCounts_.fill(0);
+}
@@ -0,0 +1,61 @@
+#ifndef CLEM_HOST_DISK_OVERLAY_HPP
+#define CLEM_HOST_DISK_OVERLAY_HPP
+
+#include "clem_disk.h"
+
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <string>
+
+//  Keeps guest changes to a floppy image in a delta file of whole tracks, so
+//  the image itself is only ever read.
+//
+//  The disk is mapped from its image as usual and attach() applies the delta
+//  on top.  Tracks are hashed as attached, and save() writes the tracks that
+//  changed since then along with those already in the delta.  The delta holds
+//  track indices rather than image offsets, so it still applies after the
+//  image is rewritten by a commit.
+//
+class ClemensDiskTrackOverlay {
+  public:
+    //  Where an image's delta lives in the overlay directory.  The image path
+    //  (i.e. relative to the disk library) is flattened into the filename so
+    //  that images with the same name in different folders don't collide.
+    static std::string getDeltaPathname(const std::string &overlayDirectory,
+                                        const std::string &imagePathname);
+
+    ClemensDiskTrackOverlay();
+
+    //  Applies the delta at pathname (if there is one) to the disk.  Fails
+    //  without changing the disk if the delta is unreadable or is for a
+    //  different disk layout.
+    bool attach(const std::string &deltaPathname, ClemensNibbleDisk &disk);
+    //  Writes the changed tracks to the delta, which is replaced as a whole.
+    //  No delta is left behind if no tracks differ from the image.
+    bool save(const ClemensNibbleDisk &disk);
+    //  Replaces the image with the serialized disk (the delta applied) and
+    //  removes the delta.  The image is written to a new file that is renamed
+    //  over the old one, so other machines reading it are unaffected.
+    bool commit(const std::string &imagePathname, const uint8_t *data, size_t dataSize);
+    //  Removes the delta file
+    bool discard();
+    void detach();
+
+    //  Keeps the delta at pathname for a disk restored from elsewhere (i.e. a
+    //  snapshot), so every track is saved to it
+    void reattach(const std::string &deltaPathname);
+
+    bool isAttached() const { return !path_.empty(); }
+    const std::string &getDeltaPathname() const { return path_; }
+
+  private:
+    static uint64_t hashTrack(const ClemensNibbleDisk &disk, unsigned trackIndex);
+
+    std::string path_;
+    std::array<uint64_t, CLEM_DISK_LIMIT_QTR_TRACKS> trackHashes_;
+    std::array<uint32_t, CLEM_DISK_LIMIT_QTR_TRACKS> trackBitCounts_;
+    std::bitset<CLEM_DISK_LIMIT_QTR_TRACKS> deltaTracks_;
+};
+
+#endif
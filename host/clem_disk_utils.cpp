@@ -12,14 +12,17 @@ static std::array<std::string_view, 4> sDriveNames = {
   "s5d1", "s5d2", "s6d1", "s6d2"
 };
 
-struct ClemensWOZDisk* parseWOZ(
-  struct ClemensWOZDisk* woz, cinek::ConstRange<uint8_t>& image) {
+//  If mappedImage is supplied, it must alias the same bytes as image and track
+//  data will reference it instead of being copied into the WOZ nibble buffer.
+static struct ClemensWOZDisk* parseWOZChunks(
+  struct ClemensWOZDisk* woz, cinek::ConstRange<uint8_t>& image, uint8_t* mappedImage) {
   const uint8_t* bits_data_current = clem_woz_check_header(
     image.first, cinek::length(image));
   if (!bits_data_current) {
     return nullptr;
   }
   const uint8_t* bits_data_end = image.second;
+  const uint8_t* bits_data_start = image.first;
 
   struct ClemensWOZChunkHeader chunkHeader;
   bool hasError = false;
@@ -37,9 +40,15 @@ struct ClemensWOZDisk* parseWOZ(
                                                     chunkHeader.data_size);
       break;
     case CLEM_WOZ_CHUNK_TRKS:
-      bits_data_current = clem_woz_parse_trks_chunk(woz, &chunkHeader,
-                                                    bits_data_current,
-                                                    chunkHeader.data_size);
+      if (mappedImage) {
+        bits_data_current = clem_woz_map_trks_chunk(
+          woz, &chunkHeader, mappedImage + (bits_data_current - bits_data_start),
+          chunkHeader.data_size);
+      } else {
+        bits_data_current = clem_woz_parse_trks_chunk(woz, &chunkHeader,
+                                                      bits_data_current,
+                                                      chunkHeader.data_size);
+      }
       break;
     case CLEM_WOZ_CHUNK_WRIT:
       break;
@@ -58,6 +67,17 @@ struct ClemensWOZDisk* parseWOZ(
   return !hasError ? woz : nullptr;
 }
 
+struct ClemensWOZDisk* parseWOZ(
+  struct ClemensWOZDisk* woz, cinek::ConstRange<uint8_t>& image) {
+  return parseWOZChunks(woz, image, nullptr);
+}
+
+struct ClemensWOZDisk* mapWOZ(
+  struct ClemensWOZDisk* woz, cinek::Range<uint8_t>& image) {
+  cinek::ConstRange<uint8_t> constImage(image.first, image.second);
+  return parseWOZChunks(woz, constImage, image.first);
+}
+
 size_t calculateNibRequiredMemory(ClemensDriveType driveType) {
   size_t size = 0;
   switch (driveType) {
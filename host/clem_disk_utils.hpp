@@ -11,6 +11,10 @@ size_t calculateNibRequiredMemory(ClemensDriveType driveType);
 
 struct ClemensWOZDisk* parseWOZ(struct ClemensWOZDisk* woz, cinek::ConstRange<uint8_t>& image);
 
+//  Like parseWOZ but the disk's track data references the image directly.  The
+//  image must remain valid (and writable) while the disk is in use.
+struct ClemensWOZDisk* mapWOZ(struct ClemensWOZDisk* woz, cinek::Range<uint8_t>& image);
+
 std::string_view getDriveName(ClemensDriveType driveType);
 
 ClemensDriveType getDriveType(std::string_view driveName);
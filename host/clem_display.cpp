@@ -49,39 +49,9 @@ static int kRenderTargetHeight = 512;
 
 namespace {
 
-//  NTSC and IIgs versions
-//  source from https://www.mrob.com/pub/xapple2/colors.html
-//  RGBA (ABGR in little endian)
+//  Palettes are shared with the software renderer in render.c so that
+//  captures and the display agree.  See clemens_render_get_palette.
 //
-//  TODO: might be nice to configure "Apple II" hires colors as IIgs vs original
-//
-
-/*
-//  Apple ][ colors
-static const float kHiresColors[8][4] = {
-  { 0x00, 0x00, 0x00, 0xFF },       // black group 1
-  { 0x14, 0xF5, 0x3C, 0xFF },       // green
-  { 0xFF, 0x44, 0xFC, 0xFF },       // purple/violet
-  { 0xFF, 0xFF, 0xFF, 0xFF },       // white group 1
-  { 0x00, 0x00, 0x00, 0xFF },       // black group 2
-  { 0xFF, 0x6A, 0x3C, 0xFF },       // orange
-  { 0x14, 0xCF, 0xFC, 0xFF },       // blue
-  { 0xFF, 0xFF, 0xFF, 0xFF }        // white group 2
-};
-*/
-
-//  Apple IIgs colors
-static const uint8_t kHiresColors[8][4] = {
-    {0x00, 0x00, 0x00, 0xFF}, // black group 1
-    {0x11, 0xDD, 0x00, 0xFF}, // green (light green)
-    {0xDD, 0x22, 0xDD, 0xFF}, // purple
-    {0xFF, 0xFF, 0xFF, 0xFF}, // white group 1
-    {0x00, 0x00, 0x00, 0xFF}, // black group 2
-    {0xFF, 0x66, 0x00, 0xFF}, // orange
-    {0x22, 0x22, 0xFF, 0xFF}, // medium blue
-    {0xFF, 0xFF, 0xFF, 0xFF}  // white group 2
-};
-
 //  Double Hi-Res Graphics (better explanation than the reference books which
 //  skirt the softswitches and video details)
 //  http://www.1000bit.it/support/manuali/apple/technotes/aiie/tn.aiie.03.html
@@ -98,46 +68,13 @@ static const uint8_t kHiresColors[8][4] = {
 //  double hi-res plotter for details on the eventual implementation.
 //
 
-static const uint8_t kDblHiresColors[16][4] = {
-    {0, 0, 0, 255},       // black
-    {221, 0, 51, 255},    // deep red
-    {136, 85, 0, 255},    // brown
-    {255, 102, 0, 255},   // orange
-    {0, 119, 34, 255},    // dark green
-    {85, 85, 85, 255},    // dark gray
-    {17, 221, 0, 255},    // lt. green
-    {255, 255, 0, 255},   // yellow
-    {0, 0, 153, 255},     // dark blue
-    {221, 34, 221, 255},  // purple
-    {170, 170, 170, 255}, // lt. gray
-    {255, 153, 136, 255}, // pink
-    {34, 34, 255, 255},   // med blue
-    {102, 170, 255, 255}, // light blue
-    {68, 255, 153, 255},  // aquamarine
-    {255, 255, 255, 255}  // white
-};
-
-static const uint8_t kGr16Colors[16][4] = {
-    {0, 0, 0, 255},       // black
-    {221, 0, 51, 255},    // deep red
-    {0, 0, 153, 255},     // dark blue
-    {221, 34, 221, 255},  // purple
-    {0, 119, 34, 255},    // dark green
-    {85, 85, 85, 255},    // dark gray
-    {34, 34, 255, 255},   // med blue
-    {102, 170, 255, 255}, // light blue
-    {136, 85, 0, 255},    // brown
-    {255, 102, 0, 255},   // orange
-    {170, 170, 170, 255}, // lt. gray
-    {255, 153, 136, 255}, // pink
-    {17, 221, 0, 255},    // lt. green
-    {255, 255, 0, 255},   // yellow
-    {68, 255, 153, 255},  // aquamarine
-    {255, 255, 255, 255}  // white
-};
+const uint8_t *getPalette(ClemensVideoFormat format) {
+    unsigned count;
+    return clemens_render_get_palette(format, &count);
+}
 
 uint32_t grColorToABGR(unsigned color) {
-    const uint8_t *grColor = &kGr16Colors[color][0];
+    const uint8_t *grColor = getPalette(kClemensVideoFormat_Lores) + color * 4;
     unsigned abgr = ((unsigned)grColor[3] << 24) | ((unsigned)grColor[2] << 16) |
                     ((unsigned)grColor[1] << 8) | grColor[0];
     return abgr;
@@ -359,13 +296,14 @@ ClemensDisplay::ClemensDisplay(ClemensDisplayProvider &provider) : provider_(pro
     //  sokol doesn't support Texture1D out of the box, so fake it with a 2D
     //  abgr color texture of 8 vertical lines, 8 pixels high.
     uint8_t hiresColorData[32 * 8];
+    const uint8_t *hiresColors = getPalette(kClemensVideoFormat_Hires);
     for (int y = 0; y < 8; ++y) {
         uint8_t *texdata = &hiresColorData[32 * y];
         for (int x = 0; x < 8; ++x) {
-            texdata[x * 4] = kHiresColors[x][0];
-            texdata[x * 4 + 1] = kHiresColors[x][1];
-            texdata[x * 4 + 2] = kHiresColors[x][2];
-            texdata[x * 4 + 3] = kHiresColors[x][3];
+            texdata[x * 4] = hiresColors[x * 4];
+            texdata[x * 4 + 1] = hiresColors[x * 4 + 1];
+            texdata[x * 4 + 2] = hiresColors[x * 4 + 2];
+            texdata[x * 4 + 3] = hiresColors[x * 4 + 3];
         }
     }
 
@@ -384,13 +322,14 @@ ClemensDisplay::ClemensDisplay(ClemensDisplayProvider &provider) : provider_(pro
     hgrColorArray_ = sg_make_image(imageDesc);
 
     uint8_t dblHiresColorData[64 * 8];
+    const uint8_t *dblHiresColors = getPalette(kClemensVideoFormat_Double_Hires);
     for (int y = 0; y < 8; ++y) {
         uint8_t *texdata = &dblHiresColorData[64 * y];
         for (int x = 0; x < 16; ++x) {
-            texdata[x * 4] = kDblHiresColors[x][0];
-            texdata[x * 4 + 1] = kDblHiresColors[x][1];
-            texdata[x * 4 + 2] = kDblHiresColors[x][2];
-            texdata[x * 4 + 3] = kDblHiresColors[x][3];
+            texdata[x * 4] = dblHiresColors[x * 4];
+            texdata[x * 4 + 1] = dblHiresColors[x * 4 + 1];
+            texdata[x * 4 + 2] = dblHiresColors[x * 4 + 2];
+            texdata[x * 4 + 3] = dblHiresColors[x * 4 + 3];
         }
     }
 
@@ -469,7 +408,8 @@ ClemensDisplay::~ClemensDisplay() {
 void ClemensDisplay::start(const ClemensMonitor &monitor, int screen_w, int screen_h) {
     sg_pass_action passAction = {};
     passAction.colors[0].action = SG_ACTION_CLEAR;
-    const uint8_t *borderColor = &kGr16Colors[monitor.border_color & 0xf][0];
+    const uint8_t *borderColor =
+        getPalette(kClemensVideoFormat_Lores) + (monitor.border_color & 0xf) * 4;
     passAction.colors[0].value = {borderColor[0] / 255.0f, borderColor[1] / 255.0f,
                                   borderColor[2] / 255.0f, 1.0f};
 
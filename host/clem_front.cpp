@@ -1,5 +1,6 @@
 #include "clem_front.hpp"
 #include "clem_backend.hpp"
+#include "clem_debug_server.hpp"
 #include "clem_disk_utils.hpp"
 #include "clem_host_platform.h"
 #include "clem_host_utils.hpp"
@@ -15,8 +16,10 @@
 #include "fmt/format.h"
 #include "imgui_filedialog/ImGuiFileDialog.h"
 
+#include <algorithm>
 #include <charconv>
 #include <filesystem>
+#include <fstream>
 #include <tuple>
 
 //  TODO: Platform specific user data directory (ROM, disk images, traces, etc)
@@ -524,6 +527,31 @@ void initDebugIODescriptors() {
 static constexpr size_t kFrameMemorySize = 4 * 1024 * 1024;
 static constexpr size_t kLogMemorySize = 4 * 1024 * 1024;
 
+//  Access counts are shown on a log4 scale so that a handful of accesses are
+//  still visible next to pages hit by tight loops
+static uint8_t getHeatFromAccessCount(uint32_t count) {
+    unsigned level = 0;
+    while (count) {
+        ++level;
+        count >>= 2;
+    }
+    return level >= 16 ? 255 : (uint8_t)(level * 16);
+}
+
+static sg_image createHeatmapImage() {
+    sg_image_desc imageDesc = {};
+    imageDesc.width = 256;
+    imageDesc.height = 256;
+    imageDesc.type = SG_IMAGETYPE_2D;
+    imageDesc.pixel_format = SG_PIXELFORMAT_RGBA8;
+    imageDesc.min_filter = SG_FILTER_NEAREST;
+    imageDesc.mag_filter = SG_FILTER_NEAREST;
+    imageDesc.wrap_u = SG_WRAP_CLAMP_TO_EDGE;
+    imageDesc.wrap_v = SG_WRAP_CLAMP_TO_EDGE;
+    imageDesc.usage = SG_USAGE_STREAM;
+    return sg_make_image(imageDesc);
+}
+
 static std::string getCommandTypeName(ClemensBackendCommand::Type type) {
     switch (type) {
     case ClemensBackendCommand::AddBreakpoint:
@@ -538,6 +566,18 @@ static std::string getCommandTypeName(ClemensBackendCommand::Type type) {
         return "InsertDisk";
     case ClemensBackendCommand::ResetMachine:
         return "ResetMachine";
+    case ClemensBackendCommand::RunScriptFile:
+        return "RunScriptFile";
+    case ClemensBackendCommand::CommitDisk:
+        return "CommitDisk";
+    case ClemensBackendCommand::DiscardDisk:
+        return "DiscardDisk";
+    case ClemensBackendCommand::LoadSymbols:
+        return "LoadSymbols";
+    case ClemensBackendCommand::WriteRegister:
+        return "WriteRegister";
+    case ClemensBackendCommand::WriteMemoryBlock:
+        return "WriteMemoryBlock";
     case ClemensBackendCommand::RunMachine:
         return "RunMachine";
     case ClemensBackendCommand::SetHostUpdateFrequency:
@@ -557,6 +597,23 @@ void ClemensFrontend::DOCStatus::copyFrom(const ClemensDeviceEnsoniq &doc) {
     memcpy(osc_flags, doc.osc_flags, sizeof(osc_flags));
 }
 
+ClemensFrontend::MemoryBankMirror::MemoryBankMirror()
+    : data(std::make_unique<uint8_t[]>(CLEM_IIGS_BANK_SIZE)) {
+    sourceKeys.fill(kInvalidKey);
+}
+
+void ClemensFrontend::MemoryBankMirror::apply(const MemoryBankDelta &delta) {
+    if (!delta.pages)
+        return;
+    for (unsigned i = 0; i < delta.pageCount; ++i) {
+        const MemoryPageDelta &pageDelta = delta.pages[i];
+        memcpy(&data[(unsigned)pageDelta.page << 8], pageDelta.data, 256);
+        sourceKeys[pageDelta.page] = pageDelta.sourceKey;
+    }
+    ackGeneration = delta.generation;
+    isValid = true;
+}
+
 const uint64_t ClemensFrontend::kFrameSeqNoInvalid = std::numeric_limits<uint64_t>::max();
 
 ClemensFrontend::ClemensFrontend(const cinek::ByteBuffer &systemFontLoBuffer,
@@ -582,9 +639,18 @@ ClemensFrontend::ClemensFrontend(const cinek::ByteBuffer &systemFontLoBuffer,
     initDebugIODescriptors();
     clem_joystick_open_devices(CLEM_HOST_JOYSTICK_PROVIDER_DEFAULT);
 
+    audio_.setThreadConfig(config_.audioProcessor, config_.audioPriority);
     audio_.start();
     backendConfig_.type = ClemensBackend::Config::Type::Apple2GS;
+    backendConfig_.systemFontLoData = systemFontLoBuffer.getHead();
+    backendConfig_.systemFontHiData = systemFontHiBuffer.getHead();
     backendConfig_.audioSamplesPerSecond = audio_.getAudioFrequency();
+    backendConfig_.bramPathname = config_.bramPathname;
+    backendConfig_.rtcEpochTime = config_.rtcEpochTime;
+    backendConfig_.ramSizeKB = config_.ramSizeKB;
+    backendConfig_.runnerProcessor = config_.emulatorProcessor;
+    backendConfig_.runnerPriority = config_.emulatorPriority;
+    backendConfig_.pacedScripts = false;
 
     auto audioBufferSize = backendConfig_.audioSamplesPerSecond * audio_.getBufferStride() / 2;
     lastCommandState_.audioBuffer =
@@ -596,8 +662,25 @@ ClemensFrontend::ClemensFrontend(const cinek::ByteBuffer &systemFontLoBuffer,
     backendConfig_.diskLibraryRootPath = diskLibraryRootPath_;
     // TODO: This should be selectable like regular drives - this will require some
     //       UI to make it happen
-    backendConfig_.smartPortDriveStates[0].imagePath =
-        std::filesystem::path("smartport.2mg").string();
+    for (size_t unitIndex = 0; unitIndex < config_.smartPortImagePaths.size(); ++unitIndex) {
+        backendConfig_.smartPortDriveStates[unitIndex].imagePath =
+            config_.smartPortImagePaths[unitIndex];
+    }
+    backendConfig_.smartPortWriteBack = config_.smartPortWriteBack;
+    backendConfig_.overlayPath = config_.overlayPath;
+    if (std::all_of(config_.smartPortImagePaths.begin(), config_.smartPortImagePaths.end(),
+                    [](const std::string &path) { return path.empty(); })) {
+        backendConfig_.smartPortDriveStates[0].imagePath =
+            std::filesystem::path("smartport.2mg").string();
+    }
+
+    if (!config_.debugSocketPath.empty()) {
+        debugServer_ = std::make_unique<ClemensDebugServer>(config_.debugSocketPath);
+        if (!debugServer_->isListening()) {
+            fmt::print("Could not serve the debugger on {}\n", config_.debugSocketPath);
+            debugServer_ = nullptr;
+        }
+    }
 
     debugMemoryEditor_.ReadFn = &ClemensFrontend::imguiMemoryEditorRead;
     debugMemoryEditor_.WriteFn = &ClemensFrontend::imguiMemoryEditorWrite;
@@ -606,6 +689,9 @@ ClemensFrontend::ClemensFrontend(const cinek::ByteBuffer &systemFontLoBuffer,
 }
 
 ClemensFrontend::~ClemensFrontend() {
+    if (debugServer_) {
+        debugServer_->stop();
+    }
     backend_ = nullptr;
     audio_.stop();
     clem_joystick_close_devices();
@@ -613,6 +699,12 @@ ClemensFrontend::~ClemensFrontend() {
     delete[] lastCommandState_.audioBuffer.getHead();
     free(frameWriteMemory_.getHead());
     free(frameReadMemory_.getHead());
+    if (heatmapBytesImage_.id != SG_INVALID_ID) {
+        sg_destroy_image(heatmapBytesImage_);
+    }
+    if (heatmapImage_.id != SG_INVALID_ID) {
+        sg_destroy_image(heatmapImage_);
+    }
 }
 
 void ClemensFrontend::input(ClemensInputEvent input) {
@@ -648,15 +740,66 @@ std::unique_ptr<ClemensBackend> ClemensFrontend::createBackend() {
     backend->setRefreshFrequency(refreshFrequency_);
     backend->reset();
     backend->run();
+    for (auto &pathname : symbolPathnames_) {
+        backend->loadSymbols(pathname);
+    }
+    if (debugServer_) {
+        debugServer_->start(*backend);
+    }
     fmt::print("Creating new backend emulator refreshing @ {} Hz.\n", refreshFrequency_);
     return backend;
 }
 
 void ClemensFrontend::backendStateDelegate(const ClemensBackendState &state) {
+    if (debugServer_) {
+        debugServer_->publish(state);
+    }
     copyState(state);
     framePublished_.notify_all();
 }
 
+void ClemensFrontend::copyMemoryDelta(MemoryBankDelta &delta, const MemoryBankMirror &mirror,
+                                      ClemensMachine *machine, uint8_t bank, bool isMega2Bank) {
+    const uint32_t *pageWriteGen = machine->mem.page_write_gen;
+    //  a generation at or behind the acknowledged one means the machine was
+    //  recreated, so the mirror is refreshed in full (as is a mirror that was
+    //  never filled or a machine without write tracking)
+    bool sendAll =
+        !mirror.isValid || !pageWriteGen || machine->mem.write_generation <= mirror.ackGeneration;
+
+    delta.generation = machine->mem.write_generation;
+    delta.pages = frameWriteMemory_.allocateArray<MemoryPageDelta>(256);
+    delta.pageCount = 0;
+    for (unsigned page = 0; page < 256; ++page) {
+        MemoryPageDelta &pageDelta = delta.pages[delta.pageCount];
+        const uint8_t *source;
+        uint16_t physicalPage;
+        if (isMega2Bank) {
+            source = machine->mem.mega2_bank_map[bank & 0x1] + (page << 8);
+            physicalPage = (uint16_t)((bank << 8) | page);
+        } else {
+            source = clem_mem_get_read_page(machine, bank, (uint8_t)page, &physicalPage);
+        }
+        if (source) {
+            if (!sendAll && mirror.sourceKeys[page] == physicalPage &&
+                pageWriteGen[physicalPage] <= mirror.ackGeneration) {
+                continue;
+            }
+            memcpy(pageDelta.data, source, 256);
+            pageDelta.sourceKey = physicalPage;
+        } else {
+            //  I/O and card pages aren't tracked and are always sent
+            for (unsigned offset = 0; offset < 256; ++offset) {
+                clem_read(machine, &pageDelta.data[offset], (uint16_t)((page << 8) | offset), bank,
+                          CLEM_MEM_FLAG_NULL);
+            }
+            pageDelta.sourceKey = MemoryBankMirror::kIOKey;
+        }
+        pageDelta.page = (uint8_t)page;
+        ++delta.pageCount;
+    }
+}
+
 void ClemensFrontend::copyState(const ClemensBackendState &state) {
     std::lock_guard<std::mutex> frameLock(frameMutex_);
 
@@ -687,6 +830,7 @@ void ClemensFrontend::copyState(const ClemensBackendState &state) {
     frameWriteState_.audioFrame = state.audio;
     frameWriteState_.backendCPUID = state.hostCPUID;
     frameWriteState_.fps = state.fps;
+    frameWriteState_.frameStats = state.frameStats;
     frameWriteState_.mmioWasInitialized = state.mmio_was_initialized;
     frameWriteState_.isTracing = state.isTracing;
     frameWriteState_.isRunning = state.isRunning;
@@ -769,11 +913,9 @@ void ClemensFrontend::copyState(const ClemensBackendState &state) {
         }
     }
 
-    //  copy over memory banks as needed
-    frameWriteState_.bankE0 = (uint8_t *)frameWriteMemory_.allocate(CLEM_IIGS_BANK_SIZE);
-    memcpy(frameWriteState_.bankE0, state.machine->mem.mega2_bank_map[0], CLEM_IIGS_BANK_SIZE);
-    frameWriteState_.bankE1 = (uint8_t *)frameWriteMemory_.allocate(CLEM_IIGS_BANK_SIZE);
-    memcpy(frameWriteState_.bankE1, state.machine->mem.mega2_bank_map[1], CLEM_IIGS_BANK_SIZE);
+    //  copy over memory pages changed since the UI last updated its mirrors
+    copyMemoryDelta(frameWriteState_.bankE0, bankE0Mirror_, state.machine, 0xe0, true);
+    copyMemoryDelta(frameWriteState_.bankE1, bankE1Mirror_, state.machine, 0xe1, true);
 
     frameWriteState_.ioPage = (uint8_t *)frameWriteMemory_.allocate(256);
     memcpy(frameWriteState_.ioPage, state.ioPageValues, 256);
@@ -781,26 +923,33 @@ void ClemensFrontend::copyState(const ClemensBackendState &state) {
     frameWriteState_.bram = (uint8_t *)frameWriteMemory_.allocate(CLEM_RTC_BRAM_SIZE);
     memcpy(frameWriteState_.bram, state.mmio->dev_rtc.bram, CLEM_RTC_BRAM_SIZE);
 
-    frameWriteState_.memoryViewBank = state.debugMemoryPage;
-    if (!state.isRunning) {
-        frameWriteState_.memoryView = (uint8_t *)frameWriteMemory_.allocate(CLEM_IIGS_BANK_SIZE);
-        //  read every byte from the memory controller - which can be 'slow' enough
-        //  to effect framerate on some systems.   so we only update memory state
-        //  when the emulator isn't actively running instructions
-        uint8_t *memoryView = reinterpret_cast<uint8_t *>(frameWriteState_.memoryView);
-        for (unsigned addr = 0; addr < 0x10000; ++addr) {
-            clem_read(state.machine, &memoryView[addr], addr, state.debugMemoryPage,
-                      CLEM_MEM_FLAG_NULL);
+    if (state.machine->mem.access_counters) {
+        const ClemensMemoryAccessCounters *counters = state.machine->mem.access_counters;
+        uint8_t *heat = (uint8_t *)frameWriteMemory_.allocate(CLEM_IIGS_PAGE_COUNT * 3);
+        frameWriteState_.heatmap = heat;
+        for (unsigned pageIdx = 0; pageIdx < CLEM_IIGS_PAGE_COUNT; ++pageIdx, heat += 3) {
+            heat[0] = getHeatFromAccessCount(counters->reads[pageIdx]);
+            heat[1] = getHeatFromAccessCount(counters->writes[pageIdx]);
+            heat[2] = getHeatFromAccessCount(counters->executes[pageIdx]);
+        }
+        if (counters->bytes) {
+            heat = (uint8_t *)frameWriteMemory_.allocate(CLEM_IIGS_BANK_SIZE);
+            frameWriteState_.heatmapBytes = heat;
+            frameWriteState_.heatmapByteBank = counters->byte_bank;
+            for (unsigned addr = 0; addr < CLEM_IIGS_BANK_SIZE; ++addr) {
+                heat[addr] = getHeatFromAccessCount(counters->bytes[addr]);
+            }
+        } else {
+            frameWriteState_.heatmapBytes = nullptr;
         }
-
-        constexpr size_t kDOCRAMSize = 65536;
-
-        frameWriteState_.docRAM = (uint8_t *)frameWriteMemory_.allocate(kDOCRAMSize);
-        memcpy(frameWriteState_.docRAM, &state.mmio->dev_audio.doc.sound_ram, kDOCRAMSize);
     } else {
-        frameWriteState_.memoryView = nullptr;
-        frameWriteState_.docRAM = nullptr;
+        frameWriteState_.heatmap = nullptr;
+        frameWriteState_.heatmapBytes = nullptr;
     }
+
+    frameWriteState_.memoryViewBank = state.debugMemoryPage;
+    copyMemoryDelta(frameWriteState_.memoryView, memoryViewMirror_, state.machine,
+                    state.debugMemoryPage, false);
     frameWriteState_.doc.copyFrom(state.mmio->dev_audio.doc);
 
     const ClemensBackendDiskDriveState *driveState = state.diskDrives;
@@ -838,19 +987,27 @@ void ClemensFrontend::copyState(const ClemensBackendState &state) {
     if (!lastCommandState_.terminated.has_value()) {
         lastCommandState_.terminated = state.terminated;
     }
+    if (!lastCommandState_.scriptResult.has_value()) {
+        lastCommandState_.scriptResult = state.scriptResult;
+    }
 
     auto audioBufferSize = int32_t(state.audio.frame_count * state.audio.frame_stride);
     auto audioBufferRange = lastCommandState_.audioBuffer.forwardSize(audioBufferSize);
     memcpy(audioBufferRange.first, state.audio.data, cinek::length(audioBufferRange));
 
     frameWriteState_.logLevel = state.logLevel;
-    for (auto *logItem = state.logBufferStart; logItem != state.logBufferEnd; ++logItem) {
-        LogOutputNode *logMemory = reinterpret_cast<LogOutputNode *>(frameMemory_.allocate(
-            sizeof(LogOutputNode) + CK_ALIGN_SIZE_TO_ARCH(logItem->text.size())));
-        logMemory->logLevel = logItem->level;
-        logMemory->sz = unsigned(logItem->text.size());
-        logItem->text.copy(reinterpret_cast<char *>(logMemory) + sizeof(LogOutputNode),
-                           std::string::npos);
+    if (state.logRing && state.logRing->head != state.logRing->tail) {
+        //  records are copied as is and formatted by the UI frame
+        auto *logRing = state.logRing;
+        unsigned recordCount = logRing->head - logRing->tail;
+        LogOutputNode *logMemory =
+            reinterpret_cast<LogOutputNode *>(frameMemory_.allocate(sizeof(LogOutputNode)));
+        logMemory->begin = frameMemory_.allocateArray<ClemensLogRecord>(recordCount);
+        logMemory->end = logMemory->begin + recordCount;
+        for (unsigned recordIdx = 0; recordIdx < recordCount; ++recordIdx) {
+            logMemory->begin[recordIdx] =
+                logRing->records[(logRing->tail + recordIdx) & (logRing->record_limit - 1)];
+        }
         logMemory->next = nullptr;
         if (!lastCommandState_.logNode) {
             lastCommandState_.logNode = logMemory;
@@ -970,15 +1127,26 @@ void ClemensFrontend::frame(int width, int height, double deltaTime, FrameAppInt
         }
         std::swap(frameWriteMemory_, frameReadMemory_);
         std::swap(frameWriteState_, frameReadState_);
+        bankE0Mirror_.apply(frameReadState_.bankE0);
+        bankE1Mirror_.apply(frameReadState_.bankE1);
+        memoryViewMirror_.apply(frameReadState_.memoryView);
         //  display log lines
         LogOutputNode *logNode = lastCommandState_.logNode;
+        ClemensLogRecord *logRecord = logNode ? logNode->begin : nullptr;
         while (logNode) {
+            if (logRecord == logNode->end) {
+                logNode = logNode->next;
+                logRecord = logNode ? logNode->begin : nullptr;
+                continue;
+            }
             if (consoleLines_.isFull()) {
                 consoleLines_.pop();
             }
+            char logText[CLEM_DEBUG_LOG_BUFFER_SIZE];
             TerminalLine logLine;
-            logLine.text.assign((char *)logNode + sizeof(LogOutputNode), logNode->sz);
-            switch (logNode->logLevel) {
+            logLine.text.assign(logText,
+                                clemens_format_log_record(logRecord, logText, sizeof(logText)));
+            switch (logRecord->level) {
             case CLEM_DEBUG_LOG_DEBUG:
                 logLine.type = TerminalLine::Debug;
                 break;
@@ -997,7 +1165,7 @@ void ClemensFrontend::frame(int width, int height, double deltaTime, FrameAppInt
                 break;
             }
             consoleLines_.push(std::move(logLine));
-            logNode = logNode->next;
+            ++logRecord;
             consoleChanged_ = true;
         }
         lastCommandState_.logNode = lastCommandState_.logNodeTail = nullptr;
@@ -1009,10 +1177,13 @@ void ClemensFrontend::frame(int width, int height, double deltaTime, FrameAppInt
             ClemensTraceExecutedInstruction instruction;
             while (execInstruction != logInstructionNode->end) {
                 instruction.fromInstruction(execInstruction->data, execInstruction->operand);
-                CLEM_TERM_COUT.format(TerminalLine::Opcode, "({}) {:02X}/{:04X} {} {}",
+                char symbol[64];
+                size_t symbolLength = symbols_.format(symbol, sizeof(symbol), instruction.pc);
+                CLEM_TERM_COUT.format(TerminalLine::Opcode, "({}) {:02X}/{:04X} {} {}{}{}",
                                       instruction.cycles_spent, instruction.pc >> 16,
                                       instruction.pc & 0xffff, instruction.opcode,
-                                      instruction.operand);
+                                      instruction.operand, symbolLength ? "  ; " : "",
+                                      std::string_view(symbol, symbolLength));
                 ++execInstruction;
             }
             logInstructionNode = logInstructionNode->next;
@@ -1035,6 +1206,14 @@ void ClemensFrontend::frame(int width, int height, double deltaTime, FrameAppInt
             lastCommandState_.commandFailed = std::nullopt;
             lastCommandState_.commandType = std::nullopt;
         }
+        if (lastCommandState_.scriptResult.has_value()) {
+            if (*lastCommandState_.scriptResult) {
+                CLEM_TERM_COUT.print(TerminalLine::Info, "Script finished.");
+            } else {
+                CLEM_TERM_COUT.print(TerminalLine::Error, "Script failed.");
+            }
+            lastCommandState_.scriptResult = std::nullopt;
+        }
         if (lastCommandState_.hitBreakpoint.has_value()) {
             unsigned bpIndex = *lastCommandState_.hitBreakpoint;
             CLEM_TERM_COUT.format(TerminalLine::Info, "Breakpoint {} hit {:02X}/{:04X}.", bpIndex,
@@ -1070,8 +1249,8 @@ void ClemensFrontend::frame(int width, int height, double deltaTime, FrameAppInt
     float screenUVs[2]{0.0f, 0.0f};
 
     if (frameReadState_.mmioWasInitialized && guiMode_ != GUIMode::RebootEmulator) {
-        const uint8_t *e0mem = frameReadState_.bankE0;
-        const uint8_t *e1mem = frameReadState_.bankE1;
+        const uint8_t *e0mem = bankE0Mirror_.data.get();
+        const uint8_t *e1mem = bankE1Mirror_.data.get();
         bool altCharSet = frameReadState_.vgcModeFlags & CLEM_VGC_ALTCHARSET;
         bool text80col = frameReadState_.vgcModeFlags & CLEM_VGC_80COLUMN_TEXT;
         display_.start(frameReadState_.monitorFrame, kClemensScreenWidth, kClemensScreenHeight);
@@ -1239,6 +1418,10 @@ void ClemensFrontend::doMachineStateLayout(ImVec2 rootAnchor, ImVec2 rootSize) {
             doMachineDebugDOCDisplay();
             ImGui::EndTabItem();
         }
+        if (ImGui::BeginTabItem("Heatmap")) {
+            doMachineDebugHeatmapDisplay();
+            ImGui::EndTabItem();
+        }
         ImGui::EndTabBar();
     }
     ImGui::EndChild();
@@ -1281,6 +1464,23 @@ void ClemensFrontend::doMachineDiagnosticsDisplay() {
     ImGui::TableNextColumn();
     ImGui::TextUnformatted("");
     ImGui::TableNextColumn();
+    ImGui::Text("JIT");
+    ImGui::TableNextColumn();
+    const auto &frameStats = frameReadState_.frameStats;
+    ImGui::Text("%2.2f ms", frameStats.frameTimeDeviation / 1000.0f);
+    if (ImGui::IsItemHovered() && frameStats.frameCount > 0) {
+        ImGui::SetTooltip("%u frames\nmean %.2f ms, std dev %.3f ms\nworst error %.3f ms\n"
+                          "wake latency %.3f ms (worst %.3f ms)",
+                          frameStats.frameCount, frameStats.meanFrameTime / 1000.0f,
+                          frameStats.frameTimeDeviation / 1000.0f,
+                          frameStats.maxFrameTimeError / 1000.0f,
+                          frameStats.meanWakeLatency / 1000.0f,
+                          frameStats.maxWakeLatency / 1000.0f);
+    }
+    ImGui::TableNextRow();
+    ImGui::TableNextColumn();
+    ImGui::TextUnformatted("");
+    ImGui::TableNextColumn();
     ImGui::Text("TIME");
     ImGui::TableNextColumn();
     unsigned hours = emulatorTime / 3600000;
@@ -1318,11 +1518,16 @@ void ClemensFrontend::doMachineDiskDisplay() {
     ImGui::TableNextColumn();
     doMachineDiskSelection(kClemensDrive_5_25_D2);
     //  TODO: Hard drive selection
-    ImGui::TableNextRow();
-    ImGui::TableNextColumn();
-    doMachineSmartDriveStatus(0);
-    ImGui::TableNextColumn();
-    doMachineSmartDriveSelection(0);
+    for (unsigned driveIndex = 0; driveIndex < CLEM_SMARTPORT_DRIVE_LIMIT; ++driveIndex) {
+        //  empty units past the first are left out
+        if (driveIndex > 0 && frameReadState_.smartDrives[driveIndex].imagePath.empty())
+            continue;
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn();
+        doMachineSmartDriveStatus(driveIndex);
+        ImGui::TableNextColumn();
+        doMachineSmartDriveSelection(driveIndex);
+    }
     ImGui::EndTable();
 }
 
@@ -1586,7 +1791,7 @@ void ClemensFrontend::doMachineCPUInfoDisplay() {
 
 void ClemensFrontend::doMachineDebugMemoryDisplay() {
     // float localContentWidth = ImGui::GetWindowContentRegionWidth();
-    if (!frameReadState_.memoryView)
+    if (!memoryViewMirror_.isValid)
         return;
     uint8_t bank = frameReadState_.memoryViewBank;
     if (ImGui::InputScalar("Bank", ImGuiDataType_U8, &bank, NULL, NULL, "%02X",
@@ -1598,6 +1803,84 @@ void ClemensFrontend::doMachineDebugMemoryDisplay() {
     debugMemoryEditor_.DrawContents(this, CLEM_IIGS_BANK_SIZE, (size_t)(bank) << 16);
 }
 
+void ClemensFrontend::doMachineDebugHeatmapDisplay() {
+    bool isEnabled = frameReadState_.heatmap != nullptr;
+    bool isByteHeatmap = frameReadState_.heatmapBytes != nullptr;
+    if (ImGui::Checkbox("Enabled", &isEnabled)) {
+        backend_->debugMemoryHeatmap(isEnabled);
+    }
+    if (!isEnabled)
+        return;
+    ImGui::SameLine();
+    if (ImGui::Checkbox("Bytes in Memory View Bank", &isByteHeatmap)) {
+        backend_->debugMemoryHeatmap(true, isByteHeatmap ? frameReadState_.memoryViewBank : -1);
+    }
+    ImGui::TextColored(ImVec4(1.0f, 0.25f, 0.25f, 1.0f), "Read");
+    ImGui::SameLine();
+    ImGui::TextColored(ImVec4(0.25f, 1.0f, 0.25f, 1.0f), "Write");
+    ImGui::SameLine();
+    ImGui::TextColored(ImVec4(0.25f, 0.25f, 1.0f, 1.0f), "Execute");
+
+    if (heatmapImage_.id == SG_INVALID_ID) {
+        heatmapImage_ = createHeatmapImage();
+        heatmapPixels_ = std::make_unique<uint8_t[]>(256 * 256 * 4);
+    }
+    //  bank per row, page per column
+    const uint8_t *heat = frameReadState_.heatmap;
+    uint8_t *pixel = heatmapPixels_.get();
+    for (unsigned pageIdx = 0; pageIdx < CLEM_IIGS_PAGE_COUNT; ++pageIdx, heat += 3, pixel += 4) {
+        pixel[0] = heat[0];
+        pixel[1] = heat[1];
+        pixel[2] = heat[2];
+        pixel[3] = 0xff;
+    }
+    sg_image_data imageData = {};
+    imageData.subimage[0][0].ptr = heatmapPixels_.get();
+    imageData.subimage[0][0].size = 256 * 256 * 4;
+    sg_update_image(heatmapImage_, imageData);
+
+    ImVec2 contentSize = ImGui::GetContentRegionAvail();
+    float side = std::min(isByteHeatmap ? contentSize.x * 0.5f : contentSize.x, contentSize.y);
+    ImVec2 imageOrigin = ImGui::GetCursorScreenPos();
+    ImGui::Image((ImTextureID)(uintptr_t)heatmapImage_.id, ImVec2(side, side));
+    if (ImGui::IsItemHovered() && side > 0.0f) {
+        ImVec2 mousePos = ImGui::GetMousePos();
+        unsigned page = std::min(255u, unsigned((mousePos.x - imageOrigin.x) * 256 / side));
+        unsigned bank = std::min(255u, unsigned((mousePos.y - imageOrigin.y) * 256 / side));
+        heat = frameReadState_.heatmap + ((bank << 8) | page) * 3;
+        ImGui::SetTooltip("$%02X/%02X00 R:%u W:%u X:%u", bank, page, heat[0], heat[1], heat[2]);
+    }
+    if (!isByteHeatmap)
+        return;
+
+    if (heatmapBytesImage_.id == SG_INVALID_ID) {
+        heatmapBytesImage_ = createHeatmapImage();
+    }
+    //  page per row, byte per column (the page heatmap was uploaded above so
+    //  its pixel buffer can be reused)
+    heat = frameReadState_.heatmapBytes;
+    pixel = heatmapPixels_.get();
+    for (unsigned addr = 0; addr < CLEM_IIGS_BANK_SIZE; ++addr, ++heat, pixel += 4) {
+        pixel[0] = *heat;
+        pixel[1] = *heat;
+        pixel[2] = *heat;
+        pixel[3] = 0xff;
+    }
+    sg_update_image(heatmapBytesImage_, imageData);
+
+    ImGui::SameLine();
+    imageOrigin = ImGui::GetCursorScreenPos();
+    ImGui::Image((ImTextureID)(uintptr_t)heatmapBytesImage_.id, ImVec2(side, side));
+    if (ImGui::IsItemHovered() && side > 0.0f) {
+        ImVec2 mousePos = ImGui::GetMousePos();
+        unsigned offset = std::min(255u, unsigned((mousePos.x - imageOrigin.x) * 256 / side));
+        unsigned page = std::min(255u, unsigned((mousePos.y - imageOrigin.y) * 256 / side));
+        unsigned addr = (page << 8) | offset;
+        ImGui::SetTooltip("$%02X/%04X: %u", frameReadState_.heatmapByteBank, addr,
+                          frameReadState_.heatmapBytes[addr]);
+    }
+}
+
 void ClemensFrontend::doMachineDebugDOCDisplay() {
 
     auto &doc = frameReadState_.doc;
@@ -1675,9 +1958,9 @@ void ClemensFrontend::doMachineDebugDOCDisplay() {
 
 ImU8 ClemensFrontend::imguiMemoryEditorRead(const ImU8 *mem_ptr, size_t off) {
     const auto *self = reinterpret_cast<const ClemensFrontend *>(mem_ptr);
-    if (!self->frameReadState_.memoryView)
+    if (!self->memoryViewMirror_.isValid)
         return 0x00;
-    return self->frameReadState_.memoryView[off & 0xffff];
+    return self->memoryViewMirror_.data[off & 0xffff];
 }
 
 void ClemensFrontend::imguiMemoryEditorWrite(ImU8 *mem_ptr, size_t off, ImU8 value) {
@@ -2799,6 +3082,18 @@ void ClemensFrontend::executeCommand(std::string_view command) {
         cmdDump(operand);
     } else if (action == "trace") {
         cmdTrace(operand);
+    } else if (action == "heatmap") {
+        cmdHeatmap(operand);
+    } else if (action == "capture") {
+        cmdCapture(operand);
+    } else if (action == "serial") {
+        cmdSerial(operand);
+    } else if (action == "paste") {
+        cmdPaste(operand);
+    } else if (action == "script") {
+        cmdRunScript(operand);
+    } else if (action == "symbols") {
+        cmdSymbols(operand);
     } else if (action == "save") {
         cmdSave(operand);
     } else if (action == "load") {
@@ -2824,6 +3119,10 @@ void ClemensFrontend::cmdHelp(std::string_view operand) {
     CLEM_TERM_COUT.print(TerminalLine::Info, "disk <drive>,file=<image>   - insert disk");
     CLEM_TERM_COUT.print(TerminalLine::Info, "disk <drive>,wprot=<off|on> - write protect");
     CLEM_TERM_COUT.print(TerminalLine::Info, "disk <drive>,eject          - eject disk");
+    CLEM_TERM_COUT.print(TerminalLine::Info,
+                         "disk <drive>,commit         - write overlay changes to the image");
+    CLEM_TERM_COUT.print(TerminalLine::Info,
+                         "disk <drive>,discard        - drop overlay changes");
     CLEM_TERM_COUT.print(TerminalLine::Info,
                          "r]un                        - execute emulator until break");
     CLEM_TERM_COUT.print(TerminalLine::Info, "s]tep                       - steps one instruction");
@@ -2836,7 +3135,8 @@ void ClemensFrontend::cmdHelp(std::string_view operand) {
     CLEM_TERM_COUT.print(TerminalLine::Info,
                          "b]reak r:<address>          - break on data read from address");
     CLEM_TERM_COUT.print(TerminalLine::Info,
-                         "b]reak w:<address>          - break on write to address");
+                         "b]reak w:<address>          - break on write to address\n"
+                         "                              (addresses may be symbol names)");
     CLEM_TERM_COUT.print(TerminalLine::Info,
                          "b]reak erase,<index>        - remove breakpoint with index");
     CLEM_TERM_COUT.print(TerminalLine::Info, "b]reak irq                  - break on IRQ");
@@ -2853,6 +3153,37 @@ void ClemensFrontend::cmdHelp(std::string_view operand) {
                          "     <filename>, {bin|hex}    output format");
     CLEM_TERM_COUT.print(TerminalLine::Info,
                          "trace {on|off},<pathname>   - toggle program tracing and output to file");
+    CLEM_TERM_COUT.print(TerminalLine::Info,
+                         "trace index                 - toggle the queryable trace index\n"
+                         "trace seek,<seq>            - show the traced instruction at seq\n"
+                         "trace pc,<bb:addr>[,<n>]    - find the nth execution of an address\n"
+                         "trace write,<bb:addr>[,<seq>] - find the last write at or before seq\n"
+                         "trace toolbox[,<bytes>]     - show the toolbox call profile (or set\n"
+                         "                              the stack bytes captured per call)");
+    CLEM_TERM_COUT.print(TerminalLine::Info,
+                         "heatmap {on|off}[,<bank>]   - toggle memory access counters (and\n"
+                         "                              per byte counts for a bank)");
+    CLEM_TERM_COUT.print(TerminalLine::Info,
+                         "capture {png|y4m},<pathname> - capture video to a PNG sequence\n"
+                         "                              (directory) or a Y4M stream\n"
+                         "capture {wav|raw},<pathname> - capture the mixed audio output\n"
+                         "capture off                 - stop capturing video and audio");
+    CLEM_TERM_COUT.print(TerminalLine::Info,
+                         "serial {a|b},{loopback|pty|off} - connect the printer (a) or modem\n"
+                         "                              (b) port to a loopback or pty\n"
+                         "serial {a|b},file,<pathname> - send serial output to a file\n"
+                         "serial {a|b},tcp,<host:port> - connect a serial port to a socket");
+    CLEM_TERM_COUT.print(TerminalLine::Info,
+                         "paste                       - type the clipboard into the machine\n"
+                         "paste <pathname>            - type a text file into the machine\n"
+                         "paste off                   - stop typing");
+    CLEM_TERM_COUT.print(TerminalLine::Info,
+                         "script <pathname>           - run a script file (see\n"
+                         "                              clem_interpreter.cpp for commands)");
+    CLEM_TERM_COUT.print(TerminalLine::Info,
+                         "symbols <pathname>          - load symbols (ld65 .dbg or labels,\n"
+                         "                              Merlin or 'addr name' text)\n"
+                         "symbols clear               - remove all symbols");
     CLEM_TERM_COUT.print(
         TerminalLine::Info,
         "save <pathname>             - saves a snapshot into the snapshots folder");
@@ -2907,9 +3238,12 @@ void ClemensFrontend::cmdBreak(std::string_view operand) {
             if (bp.type == ClemensBackendBreakpoint::IRQ) {
                 CLEM_TERM_COUT.format(TerminalLine::Info, "bp #{}: {}", i, bpType[bp.type]);
             } else {
-                CLEM_TERM_COUT.format(TerminalLine::Info, "bp #{}: {:02X}/{:04X} {}", i,
+                char symbol[64];
+                size_t symbolLength = symbols_.format(symbol, sizeof(symbol), bp.address);
+                CLEM_TERM_COUT.format(TerminalLine::Info, "bp #{}: {:02X}/{:04X} {}{}{}", i,
                                       (bp.address >> 16) & 0xff, bp.address & 0xffff,
-                                      bpType[bp.type]);
+                                      bpType[bp.type], symbolLength ? " " : "",
+                                      std::string_view(symbol, symbolLength));
             }
         }
         return;
@@ -2944,6 +3278,11 @@ void ClemensFrontend::cmdBreak(std::string_view operand) {
         breakpoint.type = ClemensBackendBreakpoint::Execute;
     }
 
+    if (auto symbolAddress = symbols_.findAddress(operand); symbolAddress.has_value()) {
+        breakpoint.address = *symbolAddress;
+        backend_->addBreakpoint(breakpoint);
+        return;
+    }
     char address[16];
     auto bankSepPos = operand.find('/');
     if (bankSepPos == std::string_view::npos) {
@@ -3003,6 +3342,7 @@ void ClemensFrontend::cmdDisk(std::string_view operand) {
     // disk
     // disk <drive>,file=<image>
     // disk <drive>,wprot=off|on
+    // disk <drive>,commit|discard (drive can be hdd1 to hdd4)
     if (operand.empty()) {
         for (auto it = frameReadState_.diskDrives.begin(); it != frameReadState_.diskDrives.end();
              ++it) {
@@ -3015,7 +3355,22 @@ void ClemensFrontend::cmdDisk(std::string_view operand) {
         return;
     }
     auto sepPos = operand.find(',');
-    auto driveType = ClemensDiskUtilities::getDriveType(trimToken(operand, 0, sepPos));
+    auto driveName = trimToken(operand, 0, sepPos);
+    if (driveName.substr(0, 3) == "hdd") {
+        //  SmartPort drives only support the overlay operations
+        auto diskOpType =
+            sepPos == std::string_view::npos ? std::string_view() : trimToken(operand, sepPos + 1);
+        if (diskOpType == "commit") {
+            backend_->commitDisk(std::string(driveName));
+        } else if (diskOpType == "discard") {
+            backend_->discardDisk(std::string(driveName));
+        } else {
+            CLEM_TERM_COUT.format(TerminalLine::Error, "Invalid or unsupported operation {}.",
+                                  diskOpType);
+        }
+        return;
+    }
+    auto driveType = ClemensDiskUtilities::getDriveType(driveName);
     if (driveType == kClemensDrive_Invalid) {
         CLEM_TERM_COUT.format(TerminalLine::Error, "Invalid drive name {} specified.", operand);
         return;
@@ -3039,6 +3394,10 @@ void ClemensFrontend::cmdDisk(std::string_view operand) {
     if (sepPos == std::string_view::npos) {
         if (diskOpType == "eject") {
             backend_->ejectDisk(driveType);
+        } else if (diskOpType == "commit") {
+            backend_->commitDisk(std::string(ClemensDiskUtilities::getDriveName(driveType)));
+        } else if (diskOpType == "discard") {
+            backend_->discardDisk(std::string(ClemensDiskUtilities::getDriveName(driveType)));
         } else {
             validOp = false;
         }
@@ -3149,11 +3508,140 @@ void ClemensFrontend::cmdDump(std::string_view operand) {
     backend_->debugMessage(std::move(message));
 }
 
+void ClemensFrontend::cmdHeatmap(std::string_view operand) {
+    auto [params, cmd, paramCount] = gatherMessageParams(operand);
+    if (paramCount == 0) {
+        CLEM_TERM_COUT.format(TerminalLine::Info, "Heatmap is {}",
+                              frameReadState_.heatmap ? "active" : "inactive");
+        return;
+    }
+    if (paramCount > 2 || (params[0] != "on" && params[0] != "off")) {
+        CLEM_TERM_COUT.print(TerminalLine::Error, "Usage: heatmap {on|off}[,<bank>]");
+        return;
+    }
+    int byteBank = -1;
+    if (paramCount > 1) {
+        if (std::from_chars(params[1].data(), params[1].data() + params[1].size(), byteBank, 16)
+                    .ec != std::errc{} ||
+            byteBank < 0 || byteBank > 0xff) {
+            CLEM_TERM_COUT.format(TerminalLine::Error, "Invalid bank {}", params[1]);
+            return;
+        }
+    }
+    backend_->debugMemoryHeatmap(params[0] == "on", byteBank);
+}
+
+void ClemensFrontend::cmdCapture(std::string_view operand) {
+    auto [params, cmd, paramCount] = gatherMessageParams(operand);
+    if (paramCount == 1 && params[0] == "off") {
+        backend_->captureVideo("off");
+        backend_->captureAudio("off");
+        return;
+    }
+    if (paramCount == 2 && (params[0] == "png" || params[0] == "y4m")) {
+        backend_->captureVideo(std::string(params[0]), std::string(params[1]));
+    } else if (paramCount == 2 && (params[0] == "wav" || params[0] == "raw")) {
+        backend_->captureAudio(std::string(params[0]), std::string(params[1]));
+    } else {
+        CLEM_TERM_COUT.print(TerminalLine::Error,
+                             "Usage: capture {png|y4m|wav|raw},<pathname> | off");
+    }
+}
+
+void ClemensFrontend::cmdSerial(std::string_view operand) {
+    auto [params, cmd, paramCount] = gatherMessageParams(operand);
+    if (paramCount >= 2 && (params[0] == "a" || params[0] == "b")) {
+        if (paramCount == 2 &&
+            (params[1] == "loopback" || params[1] == "pty" || params[1] == "off")) {
+            backend_->serialPort(std::string(params[0]), std::string(params[1]));
+            return;
+        }
+        if (paramCount == 3 && (params[1] == "file" || params[1] == "tcp")) {
+            backend_->serialPort(std::string(params[0]), std::string(params[1]),
+                                 std::string(params[2]));
+            return;
+        }
+    }
+    CLEM_TERM_COUT.print(TerminalLine::Error,
+                         "Usage: serial {a|b},{loopback|pty|off|file,<pathname>|tcp,<host:port>}");
+}
+
+void ClemensFrontend::cmdPaste(std::string_view operand) {
+    auto [params, cmd, paramCount] = gatherMessageParams(operand);
+    if (paramCount > 1) {
+        CLEM_TERM_COUT.print(TerminalLine::Error, "Usage: paste [<pathname>|off]");
+        return;
+    }
+    if (paramCount == 1 && params[0] == "off") {
+        backend_->inputText("");
+        return;
+    }
+    std::string text;
+    if (paramCount == 0) {
+        const char *clipboardText = ImGui::GetClipboardText();
+        if (clipboardText != nullptr) {
+            text = clipboardText;
+        }
+    } else {
+        std::string pathname(params[0]);
+        std::ifstream in(pathname, std::ios_base::in | std::ios_base::binary);
+        if (in.fail()) {
+            CLEM_TERM_COUT.format(TerminalLine::Error, "Unable to open {}", params[0]);
+            return;
+        }
+        text.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    if (text.empty()) {
+        CLEM_TERM_COUT.print(TerminalLine::Warn, "Nothing to paste.");
+        return;
+    }
+    CLEM_TERM_COUT.format(TerminalLine::Info, "Typing {} characters.", text.size());
+    backend_->inputText(std::move(text));
+}
+
+void ClemensFrontend::cmdRunScript(std::string_view operand) {
+    auto [params, cmd, paramCount] = gatherMessageParams(operand);
+    if (paramCount != 1) {
+        CLEM_TERM_COUT.print(TerminalLine::Error, "Usage: script <pathname>");
+        return;
+    }
+    backend_->runScriptFile(std::string(params[0]));
+}
+
+void ClemensFrontend::cmdSymbols(std::string_view operand) {
+    auto [params, cmd, paramCount] = gatherMessageParams(operand);
+    if (paramCount == 0) {
+        CLEM_TERM_COUT.format(TerminalLine::Info, "{} symbols loaded.", symbols_.size());
+        return;
+    }
+    if (paramCount != 1) {
+        CLEM_TERM_COUT.print(TerminalLine::Error, "Usage: symbols {<pathname>|clear}");
+        return;
+    }
+    if (params[0] == "clear") {
+        symbols_.clear();
+        symbolPathnames_.clear();
+        backend_->loadSymbols("");
+        CLEM_TERM_COUT.print(TerminalLine::Info, "Symbols cleared.");
+        return;
+    }
+    std::string pathname(params[0]);
+    auto oldCount = symbols_.size();
+    if (!symbols_.load(pathname)) {
+        CLEM_TERM_COUT.format(TerminalLine::Error, "Unable to read symbols from {}", pathname);
+        return;
+    }
+    CLEM_TERM_COUT.format(TerminalLine::Info, "Loaded {} symbols from {}.",
+                          symbols_.size() - oldCount, pathname);
+    backend_->loadSymbols(pathname);
+    symbolPathnames_.emplace_back(std::move(pathname));
+}
+
 void ClemensFrontend::cmdTrace(std::string_view operand) {
     auto [params, cmd, paramCount] = gatherMessageParams(operand);
-    if (paramCount > 2) {
+    if (paramCount > 3) {
         CLEM_TERM_COUT.format(TerminalLine::Error, "Trace command doesn't recognize parameter {}",
-                              params[paramCount]);
+                              params[paramCount - 1]);
         return;
     }
     if (paramCount == 0) {
@@ -3167,9 +3655,15 @@ void ClemensFrontend::cmdTrace(std::string_view operand) {
     } else if (params[0] == "off") {
         enable = false;
     }
+    bool isIndexQuery = params[0] == "seek" || params[0] == "pc" || params[0] == "write";
     std::string path;
     if (paramCount > 1) {
         path = params[1];
+        //  index queries pass all of their parameters to the backend
+        for (size_t paramIdx = 2; isIndexQuery && paramIdx < paramCount; ++paramIdx) {
+            path += ',';
+            path += params[paramIdx];
+        }
     }
     if (enable.has_value()) {
         if (!frameReadState_.isTracing) {
@@ -3198,6 +3692,12 @@ void ClemensFrontend::cmdTrace(std::string_view operand) {
             } else {
                 CLEM_TERM_COUT.print(TerminalLine::Info, "IWM tracing activated");
             }
+        } else if (params[0] == "index" || params[0] == "toolbox" || isIndexQuery) {
+            if (isIndexQuery && path.empty()) {
+                CLEM_TERM_COUT.format(TerminalLine::Error, "Trace {} requires a parameter",
+                                      params[0]);
+                return;
+            }
         } else {
             CLEM_TERM_COUT.format(TerminalLine::Error, "Invalid tracing option '{}'", params[0]);
         }
@@ -9,6 +9,7 @@
 #include "clem_disk_library.hpp"
 #include "clem_display.hpp"
 #include "clem_host_shared.hpp"
+#include "clem_symbol_table.hpp"
 #include "imgui.h"
 #include "imgui_memory_editor.h"
 
@@ -22,6 +23,7 @@
 struct ImFont;
 
 class ClemensBackend;
+class ClemensDebugServer;
 class ClemensPreamble;
 
 class ClemensFrontend {
@@ -82,6 +84,12 @@ class ClemensFrontend {
     void cmdLog(std::string_view operand);
     void cmdDump(std::string_view operand);
     void cmdTrace(std::string_view operand);
+    void cmdHeatmap(std::string_view operand);
+    void cmdCapture(std::string_view operand);
+    void cmdSerial(std::string_view operand);
+    void cmdPaste(std::string_view operand);
+    void cmdRunScript(std::string_view operand);
+    void cmdSymbols(std::string_view operand);
     std::string cmdMessageFromBackend(std::string_view operand, const ClemensMachine *machine);
     bool cmdMessageLocal(std::string_view operand);
     void cmdSave(std::string_view operand);
@@ -97,6 +105,7 @@ class ClemensFrontend {
     ClemensDisplay display_;
     ClemensAudioDevice audio_;
     std::unique_ptr<ClemensBackend> backend_;
+    std::unique_ptr<ClemensDebugServer> debugServer_;
 
     //  These buffers are populated when the backend publishes the current
     //  emulator state.   Their contents are refreshed for every publish
@@ -109,8 +118,9 @@ class ClemensFrontend {
     //  write to and read from separate buffers, to minimize the time we need to
     //  keep the frame mutex between the two threads.
     struct LogOutputNode {
-        int logLevel;
-        unsigned sz; // size of log text following this struct in memory
+        //  unformatted records copied from the backend's log ring
+        ClemensLogRecord *begin;
+        ClemensLogRecord *end;
         LogOutputNode *next;
     };
 
@@ -144,17 +154,46 @@ class ClemensFrontend {
         void copyFrom(const ClemensDeviceEnsoniq &doc);
     };
 
+    //  Memory pages are streamed to the UI as deltas against a UI owned mirror.
+    //  Only pages written since the mirror's acknowledged generation (or whose
+    //  physical source changed, or that map to I/O) are copied per frame.
+    struct MemoryPageDelta {
+        uint32_t sourceKey;
+        uint8_t page;
+        uint8_t data[256];
+    };
+    struct MemoryBankDelta {
+        MemoryPageDelta *pages = nullptr;
+        unsigned pageCount = 0;
+        uint32_t generation = 0;
+    };
+    struct MemoryBankMirror {
+        static constexpr uint32_t kInvalidKey = 0xffffffff;
+        static constexpr uint32_t kIOKey = 0x10000;
+        std::array<uint32_t, 256> sourceKeys;
+        uint32_t ackGeneration = 0;
+        bool isValid = false;
+        std::unique_ptr<uint8_t[]> data;
+
+        MemoryBankMirror();
+        void apply(const MemoryBankDelta &delta);
+    };
+
     // This state comes in for any update to the emulator per frame.  As such
     // its possible to "lose" state if the emulator runs faster than the UI.
     // This is OK in most cases as the UI will only present this data per frame
     struct FrameState {
         unsigned mark = 0;
-        uint8_t *bankE0 = nullptr;
-        uint8_t *bankE1 = nullptr;
-        uint8_t *memoryView = nullptr;
+        MemoryBankDelta bankE0;
+        MemoryBankDelta bankE1;
+        MemoryBankDelta memoryView;
         uint8_t *ioPage = nullptr;
-        uint8_t *docRAM = nullptr;
         uint8_t *bram = nullptr;
+        //  per page (reads, writes, executes) and per byte access heat if the
+        //  backend's access counters are enabled
+        uint8_t *heatmap = nullptr;
+        uint8_t *heatmapBytes = nullptr;
+        uint8_t heatmapByteBank = 0;
         LogOutputNode *logNode = nullptr;
         ClemensBackendBreakpoint *breakpoints = nullptr;
         unsigned breakpointCount = 0;
@@ -183,6 +222,7 @@ class ClemensFrontend {
 
         unsigned backendCPUID;
         float fps;
+        ClemensBackendFrameStats frameStats;
         bool mmioWasInitialized = false;
         bool isTracing = false;
         bool isIWMTracing = false;
@@ -198,6 +238,7 @@ class ClemensFrontend {
         std::optional<ClemensBackendCommand::Type> commandType;
         std::optional<unsigned> hitBreakpoint;
         std::optional<std::string> message;
+        std::optional<bool> scriptResult;
         LogOutputNode *logNode = nullptr;
         LogOutputNode *logNodeTail = nullptr;
         LogInstructionNode *logInstructionNode = nullptr;
@@ -215,6 +256,14 @@ class ClemensFrontend {
     cinek::FixedStack frameMemory_;
     FrameState frameWriteState_;
     FrameState frameReadState_;
+    //  Updated from frameReadState_ on the UI thread while the frame lock is
+    //  held; copyState() reads the keys and generations to build its deltas
+    MemoryBankMirror bankE0Mirror_;
+    MemoryBankMirror bankE1Mirror_;
+    MemoryBankMirror memoryViewMirror_;
+
+    void copyMemoryDelta(MemoryBankDelta &delta, const MemoryBankMirror &mirror,
+                         ClemensMachine *machine, uint8_t bank, bool isMega2Bank);
     LastCommandState lastCommandState_;
     cinek::ByteBuffer thisFrameAudioBuffer_;
 
@@ -241,6 +290,10 @@ class ClemensFrontend {
     TerminalMode terminalMode_;
 
     std::vector<ClemensBackendBreakpoint> breakpoints_;
+    //  loaded by the symbols command, which the backend loads as well for its
+    //  traces (and again on reboot)
+    ClemensSymbolTable symbols_;
+    std::vector<std::string> symbolPathnames_;
 
     std::string diskLibraryRootPath_;
     ClemensDiskLibrary diskLibrary_;
@@ -250,6 +303,7 @@ class ClemensFrontend {
   private:
     void doMachineDebugMemoryDisplay();
     void doMachineDebugDOCDisplay();
+    void doMachineDebugHeatmapDisplay();
     void doMachineDebugCoreIODisplay();
     void doMachineDebugVideoIODisplay();
     void doMachineDebugDiskIODisplay();
@@ -265,6 +319,11 @@ class ClemensFrontend {
     static ImU8 imguiMemoryEditorRead(const ImU8 *mem_ptr, size_t off);
     static void imguiMemoryEditorWrite(ImU8 *mem_ptr, size_t off, ImU8 value);
 
+    //  256 x 256 RGBA textures for the bank/page and per byte heatmaps
+    sg_image heatmapImage_{};
+    sg_image heatmapBytesImage_{};
+    std::unique_ptr<uint8_t[]> heatmapPixels_;
+
     std::array<int, 4> validJoystickIds_;
 
     void pollJoystickDevices();
@@ -19,6 +19,7 @@
 #include <filesystem>
 
 #include "clem_front.hpp"
+#include "render.h"
 
 #define SOKOL_IMPL
 #include "sokol/sokol_app.h"
@@ -211,6 +212,8 @@ static void initDirectories() {
 static void onInit() {
     stm_setup();
     initDirectories();
+    //  before the frontend, backend or capture threads can render
+    clemens_render_init();
 
 #if CLEMENS_PLATFORM_WINDOWS
     CoInitializeEx(NULL, COINIT_MULTITHREADED);
@@ -453,6 +456,9 @@ sapp_desc sokol_main(int /*argc*/, char *[] /*argv[]*/) {
     sapp.window_title = "Clemens IIgs Developer";
     sapp.win32_console_create = true;
     sapp.win32_console_attach = true;
+    //  large enough to paste a program listing (see the paste command)
+    sapp.enable_clipboard = true;
+    sapp.clipboard_size = 256 * 1024;
 
     return sapp;
 }
@@ -2,6 +2,7 @@
 #define CLEMENS_HOST_PLATFORM_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #if defined(_WIN32)
@@ -44,6 +45,33 @@ typedef struct {
     unsigned char data[16];
 } ClemensHostUUID;
 
+typedef struct {
+    uint8_t *data;
+    size_t size;
+} ClemensHostMappedFile;
+
+typedef enum {
+    kClemensHostPages_Normal,
+    //  huge pages advised (Linux transparent huge pages) but not guaranteed
+    kClemensHostPages_Advised,
+    //  backed by reserved huge or large pages
+    kClemensHostPages_Huge
+} ClemensHostPageType;
+
+typedef struct {
+    uint8_t *data;
+    size_t size;
+    ClemensHostPageType pageType;
+} ClemensHostPages;
+
+typedef enum {
+    kClemensHostThreadPriority_Normal,
+    //  above other user threads (a negative nice value on Linux)
+    kClemensHostThreadPriority_High,
+    //  preempts normal threads (SCHED_FIFO on Linux, time critical on Windows)
+    kClemensHostThreadPriority_Realtime
+} ClemensHostThreadPriority;
+
 typedef struct {
     unsigned buttons;
     int16_t x[2];
@@ -60,6 +88,43 @@ typedef struct {
  */
 unsigned clem_host_get_processor_number();
 
+/**
+ * @brief Restricts the calling thread to a single processor
+ *
+ * @param processor Index of the logical processor
+ * @return true if the thread was pinned
+ */
+bool clem_host_thread_set_processor(unsigned processor);
+
+/**
+ * @brief Raises the priority of the calling thread
+ *
+ * Each priority the host does not permit (i.e. SCHED_FIFO without
+ * CAP_SYS_NICE or an rtprio limit) is tried at the next lower level.
+ *
+ * @param priority
+ * @return The priority actually set
+ */
+ClemensHostThreadPriority clem_host_thread_set_priority(ClemensHostThreadPriority priority);
+
+/**
+ * @brief Returns a monotonic time in nanoseconds for clem_host_sleep_until
+ *
+ * @return uint64_t
+ */
+uint64_t clem_host_timer_ns();
+
+/**
+ * @brief Sleeps until an absolute clem_host_timer_ns() time
+ *
+ * Unlike a relative sleep, time lost to preemption before the call does not
+ * push the wake up later.  Linux uses clock_nanosleep(TIMER_ABSTIME) and
+ * Windows a high resolution waitable timer.
+ *
+ * @param deadline
+ */
+void clem_host_sleep_until(uint64_t deadline);
+
 /**
  * @brief Generates a UUID using the preferred OS method
  *
@@ -70,6 +135,47 @@ unsigned clem_host_get_processor_number();
  */
 void clem_host_uuid_gen(ClemensHostUUID *uuid);
 
+/**
+ * @brief Maps a file into memory as a private copy-on-write view
+ *
+ * Pages are faulted in on first access and writes are never flushed back to
+ * the file.  Under Linux, mmap(MAP_PRIVATE); under Windows, a FILE_MAP_COPY
+ * view.
+ *
+ * @param mapped Receives the view
+ * @param pathname
+ * @return true if the file was mapped
+ */
+bool clem_host_map_file_private(ClemensHostMappedFile *mapped, const char *pathname);
+
+/**
+ * @brief Releases a view created by clem_host_map_file_private
+ *
+ * @param mapped
+ */
+void clem_host_unmap_file(ClemensHostMappedFile *mapped);
+
+/**
+ * @brief Allocates zeroed memory backed by huge pages when the host allows
+ *
+ * The size is rounded up to the huge page size (2MB on x86-64.)  Under Linux
+ * this tries mmap(MAP_HUGETLB), then an aligned mapping advised with
+ * madvise(MADV_HUGEPAGE).  Under Windows, VirtualAlloc(MEM_LARGE_PAGES) which
+ * needs the Lock Pages in Memory privilege.  Either falls back to normal pages.
+ *
+ * @param pages Receives the allocation and the kind of pages backing it
+ * @param size
+ * @return true if the memory was allocated
+ */
+bool clem_host_alloc_pages(ClemensHostPages *pages, size_t size);
+
+/**
+ * @brief Releases memory from clem_host_alloc_pages
+ *
+ * @param pages
+ */
+void clem_host_free_pages(ClemensHostPages *pages);
+
 /**
  * @brief Initializes the joystick system
  *
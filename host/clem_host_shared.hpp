@@ -1,6 +1,7 @@
 #ifndef CLEM_HOST_SHARED_HPP
 #define CLEM_HOST_SHARED_HPP
 
+#include "clem_host_platform.h"
 #include "clem_mmio_types.h"
 
 #include <array>
@@ -15,11 +16,6 @@
 
 constexpr const char *kClemensCardMockingboardName = "mockingboard_c";
 
-struct ClemensBackendOutputText {
-    int level;
-    std::string text;
-};
-
 struct ClemensBackendExecutedInstruction {
     ClemensInstruction data;
     char operand[32];
@@ -31,6 +27,20 @@ struct ClemensBackendBreakpoint {
     uint32_t address;
 };
 
+//  Frame pacing of the emulator thread over the last couple of seconds of run
+//  time, in microseconds.  Frames run unpaced (i.e. by a waiting script) are
+//  not counted.
+struct ClemensBackendFrameStats {
+    unsigned frameCount;
+    float meanFrameTime;
+    float frameTimeDeviation;
+    //  largest difference between a frame's time and the refresh interval
+    float maxFrameTimeError;
+    //  how long after its deadline the thread woke, on average and at worst
+    float meanWakeLatency;
+    float maxWakeLatency;
+};
+
 struct ClemensBackendDiskDriveState {
     std::string imagePath;
     bool isWriteProtected;
@@ -43,10 +53,35 @@ struct ClemensBackendConfig {
     enum class Type { Apple2GS };
     std::string diskLibraryRootPath;
     std::array<ClemensBackendDiskDriveState, kClemensDrive_Count> diskDriveStates;
-    std::array<ClemensBackendDiskDriveState, 1> smartPortDriveStates;
+    //  SmartPort units in daisy chain order
+    std::array<ClemensBackendDiskDriveState, CLEM_SMARTPORT_DRIVE_LIMIT> smartPortDriveStates;
+    //  SmartPort units that are host directories write guest changes back to them
+    bool smartPortWriteBack;
+    //  If set, disk images are opened read-only and guest writes go to delta
+    //  files in this directory, until committed to the image or discarded
+    std::string overlayPath;
     std::array<std::string, 7> cardNames;
     std::vector<ClemensBackendBreakpoint> breakpoints;
     unsigned audioSamplesPerSecond;
+    //  FPI RAM in KB from 256 to 8192, rounded down to whole 64KB banks.  Zero
+    //  selects the default of 4096.
+    unsigned ramSizeKB;
+    //  Battery RAM image for this machine, clem.bram if empty
+    std::string bramPathname;
+    //  If set, the RTC starts at this Unix time and advances with emulated time
+    //  instead of following the host clock, so that runs are repeatable
+    std::optional<int64_t> rtcEpochTime;
+    //  Pins the emulator thread to this processor
+    std::optional<unsigned> runnerProcessor;
+    //  The emulator thread's priority.  A priority the host does not permit
+    //  falls back to the next lower one.
+    ClemensHostThreadPriority runnerPriority;
+    //  Scripts run the machine at the normal rate instead of as fast as
+    //  possible (i.e. to measure frame pacing from a script)
+    bool pacedScripts;
+    //  TTF images for 40 and 80 column text, used when capturing video
+    const uint8_t *systemFontLoData;
+    const uint8_t *systemFontHiData;
     Type type;
 };
 
@@ -63,6 +98,7 @@ struct ClemensBackendCommand {
         InsertBlankDisk,
         EjectDisk,
         Input,
+        InputText,
         Break,
         AddBreakpoint,
         DelBreakpoint,
@@ -72,12 +108,22 @@ struct ClemensBackendCommand {
         DebugLogLevel,
         DebugMessage,
         DebugProgramTrace,
+        DebugMemoryHeatmap,
+        CaptureVideo,
+        CaptureAudio,
+        SerialPort,
         SaveMachine,
         LoadMachine,
-        RunScript
+        RunScript,
+        RunScriptFile,
+        CommitDisk,
+        DiscardDisk,
+        WriteRegister,
+        WriteMemoryBlock,
+        LoadSymbols
     };
     Type type = Undefined;
-    std::string operand;
+    std::string operand{};
 };
 
 enum class ClemensBackendMachineProperty {
@@ -136,6 +182,8 @@ struct ClemensBackendState {
     std::optional<ClemensBackendCommand::Type> commandType;
     // valid if a debugMessage() command was issued from the frontend
     std::optional<std::string> message;
+    // valid once a script file has finished (true) or failed (false)
+    std::optional<bool> scriptResult;
 
     ClemensMonitor monitor;
     ClemensVideo text;
@@ -145,8 +193,8 @@ struct ClemensBackendState {
     unsigned hostCPUID;
     int logLevel;
 
-    const ClemensBackendOutputText *logBufferStart;
-    const ClemensBackendOutputText *logBufferEnd;
+    //  records from tail to head are new since the last publish
+    const ClemensLogRing *logRing;
     const ClemensBackendBreakpoint *bpBufferStart;
     const ClemensBackendBreakpoint *bpBufferEnd;
     std::optional<unsigned> bpHitIndex;
@@ -159,6 +207,7 @@ struct ClemensBackendState {
     uint8_t debugMemoryPage;
 
     float emulatorSpeedMhz;
+    ClemensBackendFrameStats frameStats;
 };
 
 #endif
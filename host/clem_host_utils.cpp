@@ -47,6 +47,35 @@ ClemensTraceExecutedInstruction::fromInstruction(const ClemensInstruction &instr
     cycles_spent = instruction.cycles_spent;
     pc = (uint32_t(instruction.pbr) << 16) | instruction.addr;
     size = kAddrModeSizes[instruction.desc->addr_mode];
+    switch (instruction.desc->addr_mode) {
+    case kClemensCPUAddrMode_PC:
+        target = (uint32_t(instruction.pbr) << 16) | instruction.value;
+        break;
+    case kClemensCPUAddrMode_PCRelative:
+        target = (uint32_t(instruction.pbr) << 16) |
+                 uint16_t(instruction.addr + 2 + int8_t(instruction.value));
+        break;
+    case kClemensCPUAddrMode_PCRelativeLong:
+        target = (uint32_t(instruction.pbr) << 16) |
+                 uint16_t(instruction.addr + 3 + int16_t(instruction.value));
+        break;
+    case kClemensCPUAddrMode_PCLong:
+    case kClemensCPUAddrMode_AbsoluteLong:
+    case kClemensCPUAddrMode_AbsoluteLong_X:
+        target = (uint32_t(instruction.bank) << 16) | instruction.value;
+        break;
+    case kClemensCPUAddrMode_Absolute:
+        //  other absolute operands are in the data bank, which isn't recorded
+        if (!strcmp(instruction.desc->name, "JSR")) {
+            target = (uint32_t(instruction.pbr) << 16) | instruction.value;
+        } else {
+            target = kNoTarget;
+        }
+        break;
+    default:
+        target = kNoTarget;
+        break;
+    }
 
     return *this;
 }
@@ -71,3 +100,27 @@ void destroyCard(ClemensCard *card) {
     }
     delete card;
 }
+
+const char *getThreadPriorityName(ClemensHostThreadPriority priority) {
+    switch (priority) {
+    case kClemensHostThreadPriority_High:
+        return "high";
+    case kClemensHostThreadPriority_Realtime:
+        return "realtime";
+    default:
+        return "normal";
+    }
+}
+
+bool parseThreadPriority(std::string_view name, ClemensHostThreadPriority &priority) {
+    if (name == "normal") {
+        priority = kClemensHostThreadPriority_Normal;
+    } else if (name == "high") {
+        priority = kClemensHostThreadPriority_High;
+    } else if (name == "realtime") {
+        priority = kClemensHostThreadPriority_Realtime;
+    } else {
+        return false;
+    }
+    return true;
+}
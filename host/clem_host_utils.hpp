@@ -1,14 +1,21 @@
 #ifndef CLEM_HOST_UTILS_HPP
 #define CLEM_HOST_UTILS_HPP
 
+#include "clem_host_platform.h"
 #include "clem_types.h"
 
 #include <cstdint>
+#include <string_view>
 
 struct ClemensTraceExecutedInstruction {
+    static constexpr uint32_t kNoTarget = 0xffffffff;
+
     uint64_t seq;
     uint32_t cycles_spent;
     uint32_t pc;
+    //  the jump or branch destination, or long operand address (kNoTarget if
+    //  the instruction has neither)
+    uint32_t target;
     uint16_t size;
     char opcode[4];
     char operand[24];
@@ -22,4 +29,8 @@ struct ClemensTraceExecutedInstruction {
 ClemensCard *createCard(const char *name);
 void destroyCard(ClemensCard *card);
 
+//  "normal", "high" or "realtime"
+const char *getThreadPriorityName(ClemensHostThreadPriority priority);
+bool parseThreadPriority(std::string_view name, ClemensHostThreadPriority &priority);
+
 #endif
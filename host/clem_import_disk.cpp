@@ -4,11 +4,14 @@
 #include "clem_disk_utils.hpp"
 #include "clem_woz.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cstdlib>
 #include <cstring>
 #include <filesystem>
 #include <fstream>
+#include <thread>
 
 size_t ClemensDiskImporter::calculateRequiredMemory(ClemensDriveType driveType,
                                                     size_t count) const {
@@ -120,6 +123,33 @@ auto ClemensDiskImporter::parseImage(uint8_t *bits_data, uint8_t *bits_data_end,
     return nibblizeImage(&disk);
 }
 
+bool ClemensDiskImporter::nibblizeTracks(Clemens2IMGDisk *disk) {
+    if (!clem_2img_nibblize_prepare(disk))
+        return false;
+
+    //  tracks are independent once laid out, so split them across threads with
+    //  each worker encoding every Nth track.
+    unsigned trackCount = disk->nib->track_count;
+    unsigned workerCount = std::min(std::max(std::thread::hardware_concurrency(), 1U), trackCount);
+    std::vector<std::thread> workers;
+    std::atomic_bool failed{false};
+    workers.reserve(workerCount);
+    for (unsigned workerIndex = 0; workerIndex < workerCount; ++workerIndex) {
+        workers.emplace_back([disk, trackCount, workerCount, workerIndex, &failed]() {
+            for (unsigned trackIndex = workerIndex; trackIndex < trackCount;
+                 trackIndex += workerCount) {
+                if (!clem_2img_nibblize_track(disk, trackIndex)) {
+                    failed = true;
+                }
+            }
+        });
+    }
+    for (auto &worker : workers) {
+        worker.join();
+    }
+    return !failed;
+}
+
 auto ClemensDiskImporter::nibblizeImage(Clemens2IMGDisk *disk) -> DiskRecord * {
     if (!disk->nib)
         return nullptr;
@@ -135,7 +165,7 @@ auto ClemensDiskImporter::nibblizeImage(Clemens2IMGDisk *disk) -> DiskRecord * {
         disk->nib->disk_type = CLEM_DISK_TYPE_NONE;
     }
 
-    if (!clem_2img_nibblize_data(disk))
+    if (!nibblizeTracks(disk))
         return nullptr;
 
     DiskRecord *record = memory_.newItem<DiskRecord>();
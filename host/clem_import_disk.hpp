@@ -29,6 +29,7 @@ private:
   DiskRecord* parse2IMG(uint8_t* bits_data, uint8_t* bits_data_end);
   DiskRecord* parseImage(uint8_t* bits_data, uint8_t* bits_data_end, unsigned type);
   DiskRecord* nibblizeImage(Clemens2IMGDisk* disk);
+  bool nibblizeTracks(Clemens2IMGDisk* disk);
 
   cinek::FixedStack memory_;
   DiskRecord* head_;
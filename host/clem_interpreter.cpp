@@ -1,7 +1,10 @@
 #include "clem_interpreter.hpp"
 #include "clem_backend.hpp"
+#include "clem_batch_script.hpp"
 
+#include <array>
 #include <charconv>
+#include <string>
 
 namespace {
 
@@ -135,6 +138,31 @@ std::string_view extractInt(std::string_view &script) {
       statement := assignment
       statement_list := statement (';' statement_list)
 
+    v2 (scripts):
+      string_literal := '"' (character | '\' character)* '"'
+      word := ALPHA (ALNUM | '_')*      (with at least one non-hex character)
+      expression := string_literal
+                 | memory_address
+                 | word
+                 | number_operand
+      command := action (SPC expression_list)
+      statement := assignment
+                | command
+
+    Commands:
+      wait pc,<address>             run until the PC reaches the address
+      wait mem,<address>,<value>    run until a byte in RAM/ROM holds the value
+      wait cycles,<count>           run for a number of 1.023 MHz cycles
+      wait text,"<text>"            run until the text is shown on screen
+      timeout <count>               fail waits lasting longer than this many
+                                    cycles (0 to wait forever)
+      type "<text>"                 types text into the keyboard
+      key <adb keycode>             presses and releases a key
+      expect <address>,<value>      fails unless the byte holds the value
+      commit <drive>                writes the drive's overlay delta into its
+                                    image (s5d1 to s6d2, hdd1 to hdd4)
+      discard <drive>               throws away the drive's overlay delta
+
 */
 
 struct ClemensInterpreter::ASTNode {
@@ -239,6 +267,17 @@ auto ClemensInterpreter::destroyASTNode(ASTNode *node) -> ASTNode * {
     return sibling;
 }
 
+std::string_view ClemensInterpreter::allocateString(std::string_view token) {
+    //  string literals keep their whitespace
+    std::string_view result;
+    if (!token.empty()) {
+        char *data = (char *)slab_.allocate(token.size());
+        token.copy(data, token.size());
+        result = std::string_view(data, token.size());
+    }
+    return result;
+}
+
 std::string_view ClemensInterpreter::allocate(std::string_view token) {
     std::string_view result;
     token = trimToken(token);
@@ -344,11 +383,153 @@ auto ClemensInterpreter::parseIdentifier(std::string_view script) -> ParseResult
     return result;
 }
 
+auto ClemensInterpreter::parseStringLiteral(std::string_view script) -> ParseResult {
+    ParseResult result(script);
+    auto input = trimLeft(script);
+    if (!expect(input, "\"")) {
+        return result;
+    }
+    std::string text;
+    size_t index = 0;
+    for (; index < input.size() && input[index] != '"'; ++index) {
+        char ch = input[index];
+        if (ch == '\\' && index + 1 < input.size()) {
+            ch = input[++index];
+            if (ch == 'n') {
+                ch = '\n';
+            } else if (ch == 'r') {
+                ch = '\r';
+            } else if (ch == 't') {
+                ch = '\t';
+            }
+        }
+        text.push_back(ch);
+    }
+    if (index >= input.size()) {
+        //  unterminated string
+        return result.fail(input);
+    }
+    result.node = createASTNode(ASTNodeType::StringValue);
+    result.node->token = allocateString(text);
+    return result.accept(input.substr(index + 1));
+}
+
+auto ClemensInterpreter::parseMemoryAddress(std::string_view script) -> ParseResult {
+    //  input conforms to $[digithex]{1,6} | $[digithex]{1,2}/[digithex]{1,4}
+    ParseResult result(script);
+    auto input = trimLeft(script);
+    if (!expect(input, "$")) {
+        return result;
+    }
+    auto first = extractHex(input);
+    if (first.empty()) {
+        return result.fail(input);
+    }
+    std::string address(first);
+    if (expect(input, "/")) {
+        auto second = extractHex(input);
+        if (first.size() > 2 || second.empty() || second.size() > 4) {
+            return result.fail(input);
+        }
+        address += std::string(4 - second.size(), '0');
+        address += second;
+    } else if (first.size() > 6) {
+        return result.fail(input);
+    }
+    result.node = createASTNode(ASTNodeType::MemoryAddress);
+    result.node->token = allocate(address);
+    return result.accept(input);
+}
+
+auto ClemensInterpreter::parseWord(std::string_view script) -> ParseResult {
+    //  words that are also valid hex numbers are left to parseNumber
+    ParseResult result(script);
+    auto input = trimLeft(script);
+    if (input.empty() || !std::isalpha((unsigned char)input[0])) {
+        return result;
+    }
+    size_t length = 0;
+    bool isHex = true;
+    for (; length < input.size(); ++length) {
+        unsigned char ch = (unsigned char)input[length];
+        if (!std::isalnum(ch) && ch != '_')
+            break;
+        if (!std::isxdigit(ch))
+            isHex = false;
+    }
+    if (isHex) {
+        return result;
+    }
+    result.node = createASTNode(ASTNodeType::Word);
+    result.node->token = allocate(input.substr(0, length));
+    return result.accept(input.substr(length));
+}
+
 auto ClemensInterpreter::parseExpression(std::string_view script) -> ParseResult {
-    //  expression := number_operand
+    //  expression := string_literal | memory_address | word | number_operand
+    auto expression = parseStringLiteral(script);
+    if (!expression.nomatch()) {
+        return expression;
+    }
+    expression = parseMemoryAddress(script);
+    if (!expression.nomatch()) {
+        return expression;
+    }
+    expression = parseWord(script);
+    if (!expression.nomatch()) {
+        return expression;
+    }
     return parseNumberOperand(script);
 }
 
+auto ClemensInterpreter::parseExpressionList(std::string_view script) -> ParseResult {
+    auto expression = parseExpression(script);
+    if (!expression.ok()) {
+        return expression.revert(script);
+    }
+    auto righthand = expression.script();
+    if (!expect(righthand, ",")) {
+        return expression;
+    }
+    auto expressionList = parseExpressionList(righthand);
+    if (!expressionList.ok()) {
+        //  a trailing comma is an error
+        return expressionList.fail();
+    }
+    expressionList.node = addASTNodeToSibling(expressionList.node, expression.node);
+    return expressionList;
+}
+
+auto ClemensInterpreter::parseCommand(std::string_view script) -> ParseResult {
+    //  command := action (SPC expression_list)
+    ParseResult result(script);
+    auto input = trimLeft(script);
+    size_t length = 0;
+    while (length < input.size() && std::isalpha((unsigned char)input[length])) {
+        ++length;
+    }
+    if (length == 0) {
+        return result;
+    }
+    if (length < input.size() && !std::isspace((unsigned char)input[length]) &&
+        input[length] != ';') {
+        return result;
+    }
+    ParseResult command(Result{Result::Ok, input.substr(length)});
+    command.node = createASTNode(ASTNodeType::Command);
+    command.node->token = allocate(input.substr(0, length));
+    auto operands = trimLeft(command.script());
+    if (!operands.empty() && operands[0] != ';') {
+        auto expressionList = parseExpressionList(operands);
+        if (!expressionList.ok()) {
+            return expressionList.fail();
+        }
+        addASTNodeToParent(expressionList.node, command.node);
+        command.accept(expressionList.script());
+    }
+    return command;
+}
+
 auto ClemensInterpreter::parseAssignment(std::string_view script) -> ParseResult {
     //  assignment := identifier (':'|'=') expression
     ParseResult identifier = parseIdentifier(script);
@@ -375,10 +556,14 @@ auto ClemensInterpreter::parseAssignment(std::string_view script) -> ParseResult
 
 auto ClemensInterpreter::parseStatement(std::string_view script) -> ParseResult {
     auto assignment = parseAssignment(script);
-    if (!assignment.ok()) {
-        return assignment.revert(script);
+    if (!assignment.nomatch()) {
+        return assignment;
     }
-    return assignment;
+    auto command = parseCommand(script);
+    if (!command.ok()) {
+        return command.revert(script);
+    }
+    return command;
 }
 
 auto ClemensInterpreter::parseStatementList(std::string_view script) -> ParseResult {
@@ -409,11 +594,12 @@ auto ClemensInterpreter::parse(std::string_view script) -> Result {
     return statementList.result;
 }
 
-void ClemensInterpreter::execute(ClemensBackend *backend) {
-    execute(ast_, backend);
+bool ClemensInterpreter::execute(ClemensBackend *backend) {
+    bool result = execute(ast_, backend);
     slab_.reset();
     astFreed_ = nullptr;
     ast_ = createASTNode(ASTNodeType::Root);
+    return result;
 }
 
 bool ClemensInterpreter::execute(ASTNode *node, ClemensBackend *backend) {
@@ -421,12 +607,13 @@ bool ClemensInterpreter::execute(ASTNode *node, ClemensBackend *backend) {
     switch (node->type) {
     case ASTNodeType::Root:
     case ASTNodeType::Chain:
-        if (child) {
-            do {
-                if (!execute(child, backend))
-                    return false;
-                child = child->sibling;
-            } while (child != node->child);
+        //  node->child is the last child in the list
+        while (child) {
+            if (!execute(child, backend))
+                return false;
+            if (child == node->child)
+                break;
+            child = child->sibling;
         }
         break;
     case ASTNodeType::Assignment:
@@ -443,21 +630,8 @@ bool ClemensInterpreter::execute(ASTNode *node, ClemensBackend *backend) {
                 return false;
             if (!execute(right, backend))
                 return false;
-            if (right->type == ASTNodeType::IntegerValue) {
-                int i32;
-                if (std::from_chars(right->token.data(), right->token.data() + right->token.size(),
-                                    i32, 10)
-                        .ec != std::errc{}) {
-                    return false;
-                }
-                u32 = (uint32_t)i32;
-            } else {
-                if (std::from_chars(right->token.data(), right->token.data() + right->token.size(),
-                                    u32, 16)
-                        .ec != std::errc{}) {
-                    return false;
-                }
-            }
+            if (!evaluateU32(right, u32))
+                return false;
             auto machinePropertyIt = machineProperties_.find(left->token);
             if (machinePropertyIt != machineProperties_.end()) {
                 backend->assignPropertyToU32(machinePropertyIt->second, u32);
@@ -466,11 +640,108 @@ bool ClemensInterpreter::execute(ASTNode *node, ClemensBackend *backend) {
             }
         }
         break;
+    case ASTNodeType::Command:
+        return executeCommand(node, backend);
     case ASTNodeType::Identifier:
     case ASTNodeType::AnyIntegerValue:
     case ASTNodeType::HexIntegerValue:
     case ASTNodeType::IntegerValue:
+    case ASTNodeType::StringValue:
+    case ASTNodeType::MemoryAddress:
+    case ASTNodeType::Word:
         break;
     }
     return true;
 }
+
+bool ClemensInterpreter::evaluateU32(ASTNode *node, uint32_t &value) {
+    //  integer values are by default hex (with #decimal supported)
+    const char *first = node->token.data();
+    const char *last = node->token.data() + node->token.size();
+    switch (node->type) {
+    case ASTNodeType::IntegerValue: {
+        int i32;
+        if (std::from_chars(first, last, i32, 10).ec != std::errc{})
+            return false;
+        value = (uint32_t)i32;
+        return true;
+    }
+    case ASTNodeType::AnyIntegerValue:
+    case ASTNodeType::HexIntegerValue:
+    case ASTNodeType::MemoryAddress:
+        return std::from_chars(first, last, value, 16).ec == std::errc{};
+    default:
+        return false;
+    }
+}
+
+bool ClemensInterpreter::executeCommand(ASTNode *node, ClemensBackend *backend) {
+    std::array<ASTNode *, 4> operands;
+    size_t operandCount = 0;
+    ASTNode *operand = node->child ? node->child->sibling : nullptr;
+    while (operand) {
+        if (operandCount >= operands.size())
+            return false;
+        operands[operandCount++] = operand;
+        if (operand == node->child)
+            break;
+        operand = operand->sibling;
+    }
+    auto action = node->token;
+    uint32_t address, value;
+    if (action == "wait") {
+        if (operandCount < 2 || operands[0]->type != ASTNodeType::Word)
+            return false;
+        ClemensScriptCondition condition;
+        auto kind = operands[0]->token;
+        if (kind == "pc" && operandCount == 2) {
+            condition.type = ClemensScriptCondition::Type::PC;
+            if (!evaluateU32(operands[1], condition.address))
+                return false;
+        } else if (kind == "mem" && operandCount == 3) {
+            condition.type = ClemensScriptCondition::Type::Memory;
+            if (!evaluateU32(operands[1], condition.address) || !evaluateU32(operands[2], value))
+                return false;
+            condition.value = uint8_t(value);
+        } else if (kind == "cycles" && operandCount == 2) {
+            condition.type = ClemensScriptCondition::Type::Cycles;
+            if (!evaluateU32(operands[1], value))
+                return false;
+            condition.cycles = value;
+        } else if (kind == "text" && operandCount == 2 &&
+                   operands[1]->type == ASTNodeType::StringValue) {
+            condition.type = ClemensScriptCondition::Type::Text;
+            condition.text = std::string(operands[1]->token);
+        } else {
+            return false;
+        }
+        return backend->scriptWait(condition);
+    } else if (action == "timeout") {
+        if (operandCount != 1 || !evaluateU32(operands[0], value))
+            return false;
+        backend->scriptTimeout(value);
+        return true;
+    } else if (action == "type") {
+        if (operandCount != 1 || operands[0]->type != ASTNodeType::StringValue)
+            return false;
+        backend->scriptType(std::string(operands[0]->token));
+        return true;
+    } else if (action == "key") {
+        if (operandCount != 1 || !evaluateU32(operands[0], value))
+            return false;
+        backend->scriptKey(uint8_t(value));
+        return true;
+    } else if (action == "expect") {
+        if (operandCount != 2 || !evaluateU32(operands[0], address) ||
+            !evaluateU32(operands[1], value))
+            return false;
+        return backend->scriptExpect(address, uint8_t(value));
+    } else if (action == "commit" || action == "discard") {
+        if (operandCount != 1 || operands[0]->type != ASTNodeType::Word)
+            return false;
+        if (action == "commit")
+            return backend->commitDiskOverlay(operands[0]->token);
+        return backend->discardDiskOverlay(operands[0]->token);
+    }
+    return false;
+}
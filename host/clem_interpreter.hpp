@@ -14,8 +14,8 @@ class ClemensBackend;
 class ClemensInterpreter {
   public:
     struct Result {
-        enum { Ok, NoMatch, SyntaxError, Undefined } type;
-        std::string_view script;
+        enum { Ok, NoMatch, SyntaxError, Undefined } type = Undefined;
+        std::string_view script{};
     };
 
   public:
@@ -24,7 +24,8 @@ class ClemensInterpreter {
 
     //  Builds the AST for this script
     Result parse(std::string_view expression);
-    void execute(ClemensBackend *backend);
+    //  Returns false if a statement failed (later statements are not run)
+    bool execute(ClemensBackend *backend);
 
   private:
     struct ASTNode;
@@ -34,6 +35,8 @@ class ClemensInterpreter {
         Chain,
         // assignment(identifier, value)
         Assignment,
+        // command(expression list), the token is the action
+        Command,
         // identifies a variable or attribute
         Identifier,
         //  always regard as a decimal value
@@ -41,7 +44,13 @@ class ClemensInterpreter {
         //  always regard as an integer
         HexIntegerValue,
         //  depends on the context
-        AnyIntegerValue
+        AnyIntegerValue,
+        //  unescaped contents of a string literal
+        StringValue,
+        //  (bank << 16) | address, always hex
+        MemoryAddress,
+        //  a bare word (i.e. a command's option)
+        Word
     };
 
     struct ParseResult {
@@ -86,13 +95,21 @@ class ClemensInterpreter {
     ASTNode *addASTNodeToSibling(ASTNode *node, ASTNode *sibling);
     ASTNode *destroyASTNode(ASTNode *node);
     std::string_view allocate(std::string_view token);
+    std::string_view allocateString(std::string_view token);
 
     bool execute(ASTNode *node, ClemensBackend *backend);
+    bool executeCommand(ASTNode *node, ClemensBackend *backend);
+    bool evaluateU32(ASTNode *node, uint32_t &value);
 
     ParseResult parseStatementList(std::string_view script);
     ParseResult parseStatement(std::string_view script);
     ParseResult parseAssignment(std::string_view script);
+    ParseResult parseCommand(std::string_view script);
+    ParseResult parseExpressionList(std::string_view script);
     ParseResult parseExpression(std::string_view script);
+    ParseResult parseStringLiteral(std::string_view script);
+    ParseResult parseMemoryAddress(std::string_view script);
+    ParseResult parseWord(std::string_view script);
     ParseResult parseNumberOperand(std::string_view script);
     ParseResult parseIdentifier(std::string_view script);
     ParseResult parseNumber(std::string_view script);
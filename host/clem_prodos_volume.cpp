@@ -0,0 +1,861 @@
+#include "clem_prodos_volume.hpp"
+
+#include "clem_smartport.h"
+#include "external/mpack.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <string_view>
+#include <unordered_set>
+
+namespace {
+
+constexpr uint32_t kSlotFree = 0xffffffff;
+constexpr uint32_t kSlotFile = 0xfffffffe;
+
+constexpr unsigned kVolumeKeyBlock = 2;
+constexpr unsigned kVolumeDirectoryMinBlocks = 4;
+constexpr unsigned kBitmapBlockCount =
+    (ClemensProDOSHostVolume::kBlockCount + ClemensProDOSHostVolume::kBlockSize * 8 - 1) /
+    (ClemensProDOSHostVolume::kBlockSize * 8);
+
+constexpr unsigned kEntryLength = 0x27;
+constexpr unsigned kEntriesPerBlock = 0x0d;
+constexpr unsigned kNameLimit = 15;
+constexpr uint32_t kEOFLimit = 0xffffff;
+//  guards against symbolic link loops on the host and bad links on the volume
+constexpr unsigned kDirectoryDepthLimit = 32;
+
+constexpr uint8_t kStorageSeedling = 0x1;
+constexpr uint8_t kStorageSapling = 0x2;
+constexpr uint8_t kStorageTree = 0x3;
+constexpr uint8_t kStorageSubdirectory = 0xd;
+constexpr uint8_t kStorageSubdirectoryHeader = 0xe;
+constexpr uint8_t kStorageVolumeHeader = 0xf;
+
+constexpr uint8_t kFileTypeDirectory = 0x0f;
+constexpr uint8_t kFileTypeBinary = 0x06;
+//  destroy, rename, backup, write and read
+constexpr uint8_t kAccessUnlocked = 0xe3;
+
+void put16(uint8_t *data, unsigned value) {
+    data[0] = uint8_t(value & 0xff);
+    data[1] = uint8_t((value >> 8) & 0xff);
+}
+
+void put24(uint8_t *data, unsigned value) {
+    put16(data, value);
+    data[2] = uint8_t((value >> 16) & 0xff);
+}
+
+unsigned get16(const uint8_t *data) { return data[0] | (unsigned(data[1]) << 8); }
+
+unsigned get24(const uint8_t *data) { return get16(data) | (unsigned(data[2]) << 16); }
+
+bool isNameChar(char c) { return (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '.'; }
+
+bool isValidName(std::string_view name) {
+    if (name.empty() || name.size() > kNameLimit || !(name[0] >= 'A' && name[0] <= 'Z'))
+        return false;
+    return std::all_of(name.begin(), name.end(), isNameChar);
+}
+
+//  Upper case with anything else replaced by periods, starting with a letter
+std::string toProDOSName(std::string_view hostName) {
+    std::string name;
+    for (char c : hostName) {
+        if (c >= 'a' && c <= 'z') {
+            c = char(c - 'a' + 'A');
+        }
+        name.push_back(isNameChar(c) ? c : '.');
+    }
+    if (name.empty() || !(name[0] >= 'A' && name[0] <= 'Z')) {
+        name.insert(name.begin(), 'A');
+    }
+    if (name.size() > kNameLimit) {
+        name.resize(kNameLimit);
+    }
+    return name;
+}
+
+//  Strips a "#tt" or "#ttaaaa" type suffix from the host name
+bool parseTypeSuffix(std::string &hostName, uint8_t &fileType, uint16_t &auxType) {
+    auto pos = hostName.rfind('#');
+    if (pos == std::string::npos)
+        return false;
+    std::string_view digits(hostName.c_str() + pos + 1);
+    if (digits.size() != 2 && digits.size() != 6)
+        return false;
+    if (!std::all_of(digits.begin(), digits.end(), [](char c) { return isxdigit(c) != 0; }))
+        return false;
+    auto value = strtoul(hostName.c_str() + pos + 1, nullptr, 16);
+    if (digits.size() == 6) {
+        fileType = uint8_t(value >> 16);
+        auxType = uint16_t(value & 0xffff);
+    } else {
+        fileType = uint8_t(value);
+        auxType = 0;
+    }
+    hostName.resize(pos);
+    return true;
+}
+
+void typeFromExtension(const std::string &name, uint8_t &fileType, uint16_t &auxType) {
+    struct ExtensionType {
+        const char *extension;
+        uint8_t fileType;
+        uint16_t auxType;
+    };
+    static const ExtensionType kExtensionTypes[] = {{"TXT", 0x04, 0x0000},    {"TEXT", 0x04, 0x0000},
+                                                    {"BAS", 0xfc, 0x0801},    {"S16", 0xb3, 0x0000},
+                                                    {"SYSTEM", 0xff, 0x2000}, {"SHK", 0xe0, 0x8002}};
+    fileType = kFileTypeBinary;
+    auxType = 0x0000;
+    auto pos = name.rfind('.');
+    if (pos == std::string::npos)
+        return;
+    std::string_view extension(name.c_str() + pos + 1);
+    for (auto &extensionType : kExtensionTypes) {
+        if (extension == extensionType.extension) {
+            fileType = extensionType.fileType;
+            auxType = extensionType.auxType;
+            return;
+        }
+    }
+}
+
+//  New files keep their ProDOS name, with a type suffix unless the extension
+//  gives the same type
+std::string toHostFileName(const std::string &name, uint8_t fileType, uint16_t auxType) {
+    uint8_t extensionFileType;
+    uint16_t extensionAuxType;
+    typeFromExtension(name, extensionFileType, extensionAuxType);
+    if (extensionFileType == fileType && extensionAuxType == auxType)
+        return name;
+    char suffix[8];
+    snprintf(suffix, sizeof(suffix), "#%02x%04x", fileType, auxType);
+    return name + suffix;
+}
+
+//  ProDOS date in the low word, time in the high word
+uint32_t toProDOSDateTime(std::filesystem::file_time_type fileTime) {
+    auto systemTime = std::chrono::time_point_cast<std::chrono::system_clock::duration>(
+        fileTime - std::filesystem::file_time_type::clock::now() + std::chrono::system_clock::now());
+    time_t t = std::chrono::system_clock::to_time_t(systemTime);
+    //  localtime() checks the time zone on every call, which adds up over
+    //  thousands of files
+    struct tm localTimeStorage;
+#if defined(_WIN32)
+    const struct tm *localTime =
+        localtime_s(&localTimeStorage, &t) == 0 ? &localTimeStorage : nullptr;
+#else
+    const struct tm *localTime = localtime_r(&t, &localTimeStorage);
+#endif
+    if (!localTime)
+        return 0;
+    //  ProDOS 2.4 reads years 0-39 as 2000-2039
+    unsigned date = (unsigned(localTime->tm_year % 100) << 9) |
+                    (unsigned(localTime->tm_mon + 1) << 5) | unsigned(localTime->tm_mday);
+    unsigned time = (unsigned(localTime->tm_hour) << 8) | unsigned(localTime->tm_min);
+    return date | (time << 16);
+}
+
+void putDateTime(uint8_t *data, uint32_t dateTime) {
+    put16(data, dateTime & 0xffff);
+    data[2] = uint8_t((dateTime >> 16) & 0xff);
+    data[3] = uint8_t((dateTime >> 24) & 0xff);
+}
+
+unsigned getDirectoryBlockCount(size_t entryCount) {
+    //  the header takes the first entry
+    return unsigned((entryCount + 1 + kEntriesPerBlock - 1) / kEntriesPerBlock);
+}
+
+} // namespace
+
+struct ClemensProDOSHostVolume::Entry {
+    std::string name;
+    std::filesystem::path hostPath;
+    std::vector<Entry> children;
+    uint32_t size = 0;
+    uint32_t modifiedDateTime = 0;
+    uint8_t fileType = 0;
+    uint16_t auxType = 0;
+    bool isDirectory = false;
+    //  directories are laid out from their key block, and files are their
+    //  index blocks (if any) followed by their data blocks
+    unsigned keyBlock = 0;
+    unsigned blockCount = 0;
+    unsigned dataBlock = 0;
+    unsigned dataBlockCount = 0;
+};
+
+ClemensProDOSHostVolume::ClemensProDOSHostVolume()
+    : isWriteBack_(false), skippedCount_(0), nextBlock_(0), bitmapBlock_(0),
+      hasDirtyBlocks_(false), openFile_(nullptr), openFileIndex_(0) {}
+
+ClemensProDOSHostVolume::~ClemensProDOSHostVolume() { unmount(); }
+
+bool ClemensProDOSHostVolume::mount(const std::string &directoryPath, bool writeBack) {
+    unmount();
+
+    std::error_code errc;
+    Entry root;
+    root.hostPath = directoryPath;
+    root.isDirectory = true;
+    if (!std::filesystem::is_directory(root.hostPath, errc))
+        return false;
+    if (!scanDirectory(root, 0))
+        return false;
+    root.name = toProDOSName(std::filesystem::absolute(root.hostPath, errc).filename().string());
+    root.modifiedDateTime =
+        toProDOSDateTime(std::filesystem::last_write_time(root.hostPath, errc));
+
+    blockSlots_.assign(kBlockCount, kSlotFree);
+    dirtyBlocks_.assign(kBlockCount, false);
+    root.keyBlock = kVolumeKeyBlock;
+    root.blockCount =
+        std::max(kVolumeDirectoryMinBlocks, getDirectoryBlockCount(root.children.size()));
+    bitmapBlock_ = root.keyBlock + root.blockCount;
+    nextBlock_ = bitmapBlock_ + kBitmapBlockCount;
+    if (!allocateDirectory(root)) {
+        unmount();
+        return false;
+    }
+    buildDirectory(root, 0, 0);
+    buildBitmap();
+    std::sort(extents_.begin(), extents_.end(),
+              [](const FileExtent &a, const FileExtent &b) { return a.firstBlock < b.firstBlock; });
+
+    path_ = directoryPath;
+    isWriteBack_ = writeBack;
+    return true;
+}
+
+bool ClemensProDOSHostVolume::unmount() {
+    bool isSaved = flush();
+    if (openFile_) {
+        fclose(openFile_);
+        openFile_ = nullptr;
+    }
+    path_.clear();
+    isWriteBack_ = false;
+    skippedCount_ = 0;
+    nextBlock_ = 0;
+    bitmapBlock_ = 0;
+    hasDirtyBlocks_ = false;
+    blockSlots_.clear();
+    blockPool_.clear();
+    dirtyBlocks_.clear();
+    extents_.clear();
+    files_.clear();
+    directories_.clear();
+    return isSaved;
+}
+
+bool ClemensProDOSHostVolume::scanDirectory(Entry &directory, unsigned depth) {
+    std::error_code errc;
+    std::filesystem::directory_iterator it(directory.hostPath, errc);
+    if (errc)
+        return false;
+    for (; it != std::filesystem::directory_iterator(); it.increment(errc)) {
+        if (errc)
+            return false;
+        auto hostName = it->path().filename().string();
+        if (hostName.empty() || hostName[0] == '.')
+            continue;
+        Entry entry;
+        entry.hostPath = it->path();
+        entry.modifiedDateTime = toProDOSDateTime(it->last_write_time(errc));
+        if (it->is_directory(errc)) {
+            entry.isDirectory = true;
+            entry.fileType = kFileTypeDirectory;
+            entry.name = toProDOSName(hostName);
+            if (depth + 1 >= kDirectoryDepthLimit || !scanDirectory(entry, depth + 1)) {
+                ++skippedCount_;
+                continue;
+            }
+        } else if (it->is_regular_file(errc)) {
+            auto fileSize = it->file_size(errc);
+            if (errc || fileSize > kEOFLimit) {
+                ++skippedCount_;
+                continue;
+            }
+            entry.size = uint32_t(fileSize);
+            bool hasTypeSuffix = parseTypeSuffix(hostName, entry.fileType, entry.auxType);
+            entry.name = toProDOSName(hostName);
+            if (!hasTypeSuffix) {
+                typeFromExtension(entry.name, entry.fileType, entry.auxType);
+            }
+        } else {
+            ++skippedCount_;
+            continue;
+        }
+        directory.children.emplace_back(std::move(entry));
+    }
+
+    //  listing order is up to the host, and snapshots rely on the same tree
+    //  giving the same layout
+    std::sort(directory.children.begin(), directory.children.end(),
+              [](const Entry &a, const Entry &b) { return a.hostPath < b.hostPath; });
+    std::unordered_set<std::string> names;
+    for (auto &entry : directory.children) {
+        //  i.e. LONG.FILE.NAME1 and LONG.FILE.NAME2 become LONG.FILE.NAME and
+        //  LONG.FILE.NA.2
+        std::string name = entry.name;
+        for (unsigned suffixIndex = 2; names.count(name) > 0; ++suffixIndex) {
+            auto suffix = "." + std::to_string(suffixIndex);
+            name = entry.name.substr(0, kNameLimit - suffix.size()) + suffix;
+        }
+        entry.name = name;
+        names.insert(std::move(name));
+    }
+    return true;
+}
+
+bool ClemensProDOSHostVolume::allocateDirectory(Entry &directory) {
+    for (auto &entry : directory.children) {
+        entry.keyBlock = nextBlock_;
+        if (entry.isDirectory) {
+            entry.blockCount = getDirectoryBlockCount(entry.children.size());
+        } else {
+            //  an empty file still has a (blank) key block
+            entry.dataBlockCount = std::max(1U, (entry.size + kBlockSize - 1) / kBlockSize);
+            unsigned indexBlockCount = 0;
+            if (entry.dataBlockCount > 256) {
+                indexBlockCount = 1 + (entry.dataBlockCount + 255) / 256;
+            } else if (entry.dataBlockCount > 1) {
+                indexBlockCount = 1;
+            }
+            entry.dataBlock = entry.keyBlock + indexBlockCount;
+            entry.blockCount = indexBlockCount + entry.dataBlockCount;
+        }
+        nextBlock_ += entry.blockCount;
+        if (nextBlock_ > kBlockCount)
+            return false;
+    }
+    for (auto &entry : directory.children) {
+        if (entry.isDirectory && !allocateDirectory(entry))
+            return false;
+    }
+    return true;
+}
+
+uint8_t *ClemensProDOSHostVolume::allocateBlock(unsigned blockIndex) {
+    uint32_t slot = blockSlots_[blockIndex];
+    if (slot >= kSlotFile) {
+        slot = uint32_t(blockPool_.size() / kBlockSize);
+        blockPool_.resize(blockPool_.size() + kBlockSize, 0);
+        blockSlots_[blockIndex] = slot;
+    }
+    return blockPool_.data() + size_t(slot) * kBlockSize;
+}
+
+void ClemensProDOSHostVolume::buildDirectory(const Entry &directory, unsigned parentBlock,
+                                             unsigned parentEntryNumber) {
+    bool isVolume = directory.keyBlock == kVolumeKeyBlock;
+    uint8_t *block;
+    for (unsigned blockIndex = 0; blockIndex < directory.blockCount; ++blockIndex) {
+        block = allocateBlock(directory.keyBlock + blockIndex);
+        put16(block, blockIndex > 0 ? directory.keyBlock + blockIndex - 1 : 0);
+        put16(block + 2, blockIndex + 1 < directory.blockCount ? directory.keyBlock + blockIndex + 1 : 0);
+    }
+
+    uint8_t *header = allocateBlock(directory.keyBlock) + 4;
+    uint8_t storageType = isVolume ? kStorageVolumeHeader : kStorageSubdirectoryHeader;
+    header[0] = uint8_t((storageType << 4) | directory.name.size());
+    memcpy(header + 1, directory.name.data(), directory.name.size());
+    if (!isVolume) {
+        header[0x10] = 0x75;
+    }
+    putDateTime(header + 0x18, directory.modifiedDateTime);
+    header[0x1e] = kAccessUnlocked;
+    header[0x1f] = kEntryLength;
+    header[0x20] = kEntriesPerBlock;
+    put16(header + 0x21, unsigned(directory.children.size()));
+    if (isVolume) {
+        put16(header + 0x23, bitmapBlock_);
+        put16(header + 0x25, kBlockCount);
+    } else {
+        put16(header + 0x23, parentBlock);
+        header[0x25] = uint8_t(parentEntryNumber);
+        header[0x26] = kEntryLength;
+    }
+
+    for (size_t childIndex = 0; childIndex < directory.children.size(); ++childIndex) {
+        const Entry &child = directory.children[childIndex];
+        unsigned entrySlot = unsigned(childIndex + 1);
+        unsigned entryBlock = directory.keyBlock + entrySlot / kEntriesPerBlock;
+        uint8_t *entry = allocateBlock(entryBlock) + 4 + (entrySlot % kEntriesPerBlock) * kEntryLength;
+        uint8_t storageType;
+        if (child.isDirectory) {
+            storageType = kStorageSubdirectory;
+        } else if (child.dataBlockCount > 256) {
+            storageType = kStorageTree;
+        } else if (child.dataBlockCount > 1) {
+            storageType = kStorageSapling;
+        } else {
+            storageType = kStorageSeedling;
+        }
+        entry[0] = uint8_t((storageType << 4) | child.name.size());
+        memcpy(entry + 1, child.name.data(), child.name.size());
+        entry[0x10] = child.fileType;
+        put16(entry + 0x11, child.keyBlock);
+        put16(entry + 0x13, child.blockCount);
+        put24(entry + 0x15, child.isDirectory ? child.blockCount * kBlockSize : child.size);
+        putDateTime(entry + 0x18, child.modifiedDateTime);
+        entry[0x1e] = kAccessUnlocked;
+        put16(entry + 0x1f, child.auxType);
+        putDateTime(entry + 0x21, child.modifiedDateTime);
+        put16(entry + 0x25, directory.keyBlock);
+        //  entries are numbered from 1 in each block, counting the header
+        if (child.isDirectory) {
+            directories_.push_back({child.hostPath, child.name, child.keyBlock});
+            buildDirectory(child, entryBlock, entrySlot % kEntriesPerBlock + 1);
+        } else {
+            buildFile(child);
+        }
+    }
+}
+
+void ClemensProDOSHostVolume::buildFile(const Entry &file) {
+    unsigned fileIndex = unsigned(files_.size());
+    files_.push_back({file.hostPath, file.name, file.size, file.keyBlock});
+    extents_.push_back({file.dataBlock, file.dataBlockCount, fileIndex});
+    for (unsigned blockIndex = 0; blockIndex < file.dataBlockCount; ++blockIndex) {
+        blockSlots_[file.dataBlock + blockIndex] = kSlotFile;
+    }
+    if (file.dataBlockCount == 1)
+        return;
+    if (file.dataBlockCount <= 256) {
+        uint8_t *indexBlock = allocateBlock(file.keyBlock);
+        for (unsigned blockIndex = 0; blockIndex < file.dataBlockCount; ++blockIndex) {
+            indexBlock[blockIndex] = uint8_t((file.dataBlock + blockIndex) & 0xff);
+            indexBlock[256 + blockIndex] = uint8_t((file.dataBlock + blockIndex) >> 8);
+        }
+        return;
+    }
+    unsigned indexBlockCount = (file.dataBlockCount + 255) / 256;
+    for (unsigned indexIndex = 0; indexIndex < indexBlockCount; ++indexIndex) {
+        unsigned indexBlockIndex = file.keyBlock + 1 + indexIndex;
+        uint8_t *masterBlock = allocateBlock(file.keyBlock);
+        masterBlock[indexIndex] = uint8_t(indexBlockIndex & 0xff);
+        masterBlock[256 + indexIndex] = uint8_t(indexBlockIndex >> 8);
+        uint8_t *indexBlock = allocateBlock(indexBlockIndex);
+        unsigned dataBlock = file.dataBlock + indexIndex * 256;
+        unsigned dataBlockCount = std::min(256U, file.dataBlockCount - indexIndex * 256);
+        for (unsigned blockIndex = 0; blockIndex < dataBlockCount; ++blockIndex) {
+            indexBlock[blockIndex] = uint8_t((dataBlock + blockIndex) & 0xff);
+            indexBlock[256 + blockIndex] = uint8_t((dataBlock + blockIndex) >> 8);
+        }
+    }
+}
+
+void ClemensProDOSHostVolume::buildBitmap() {
+    //  a set bit is a free block
+    for (unsigned bitmapIndex = 0; bitmapIndex < kBitmapBlockCount; ++bitmapIndex) {
+        allocateBlock(bitmapBlock_ + bitmapIndex);
+    }
+    for (unsigned blockIndex = nextBlock_; blockIndex < kBlockCount; ++blockIndex) {
+        uint8_t *bitmap = allocateBlock(bitmapBlock_ + blockIndex / (kBlockSize * 8));
+        unsigned bitIndex = blockIndex % (kBlockSize * 8);
+        bitmap[bitIndex / 8] |= uint8_t(0x80 >> (bitIndex % 8));
+    }
+}
+
+uint8_t ClemensProDOSHostVolume::readBlock(unsigned blockIndex, uint8_t *buffer) {
+    if (blockIndex >= getBlockCount())
+        return CLEM_SMARTPORT_STATUS_CODE_INVALID_BLOCK;
+    uint32_t slot = blockSlots_[blockIndex];
+    if (slot == kSlotFree) {
+        memset(buffer, 0, kBlockSize);
+        return CLEM_SMARTPORT_STATUS_CODE_OK;
+    }
+    if (slot == kSlotFile) {
+        auto extentIt = std::upper_bound(
+            extents_.begin(), extents_.end(), blockIndex,
+            [](unsigned index, const FileExtent &extent) { return index < extent.firstBlock; });
+        assert(extentIt != extents_.begin());
+        return readFileBlock(*(extentIt - 1), blockIndex, buffer);
+    }
+    memcpy(buffer, blockPool_.data() + size_t(slot) * kBlockSize, kBlockSize);
+    return CLEM_SMARTPORT_STATUS_CODE_OK;
+}
+
+uint8_t ClemensProDOSHostVolume::readFileBlock(const FileExtent &extent, unsigned blockIndex,
+                                               uint8_t *buffer) {
+    //  the last file stays open since reads mostly run through a file
+    if (!openFile_ || openFileIndex_ != extent.fileIndex) {
+        if (openFile_) {
+            fclose(openFile_);
+        }
+        openFile_ = fopen(files_[extent.fileIndex].hostPath.string().c_str(), "rb");
+        openFileIndex_ = extent.fileIndex;
+        if (!openFile_)
+            return CLEM_SMARTPORT_STATUS_CODE_IO_ERR;
+    }
+    size_t readCount = 0;
+    if (fseek(openFile_, long(blockIndex - extent.firstBlock) * kBlockSize, SEEK_SET) == 0) {
+        readCount = fread(buffer, 1, kBlockSize, openFile_);
+    }
+    if (ferror(openFile_)) {
+        clearerr(openFile_);
+        return CLEM_SMARTPORT_STATUS_CODE_IO_ERR;
+    }
+    //  past the end of the file (i.e. it shrank on the host since mounting)
+    memset(buffer + readCount, 0, kBlockSize - readCount);
+    return CLEM_SMARTPORT_STATUS_CODE_OK;
+}
+
+uint8_t ClemensProDOSHostVolume::writeBlock(unsigned blockIndex, const uint8_t *buffer) {
+    if (blockIndex >= getBlockCount())
+        return CLEM_SMARTPORT_STATUS_CODE_INVALID_BLOCK;
+    //  the whole block is replaced, so a file block never needs reading first
+    memcpy(allocateBlock(blockIndex), buffer, kBlockSize);
+    dirtyBlocks_[blockIndex] = true;
+    hasDirtyBlocks_ = true;
+    return CLEM_SMARTPORT_STATUS_CODE_OK;
+}
+
+void ClemensProDOSHostVolume::detachHostFile(unsigned fileIndex) {
+    //  blocks still read from the file are copied in before it is replaced
+    uint8_t buffer[kBlockSize];
+    for (auto extentIt = extents_.begin(); extentIt != extents_.end();) {
+        if (extentIt->fileIndex != fileIndex) {
+            ++extentIt;
+            continue;
+        }
+        for (unsigned blockIndex = extentIt->firstBlock;
+             blockIndex < extentIt->firstBlock + extentIt->blockCount; ++blockIndex) {
+            if (blockSlots_[blockIndex] != kSlotFile)
+                continue;
+            if (readFileBlock(*extentIt, blockIndex, buffer) != CLEM_SMARTPORT_STATUS_CODE_OK) {
+                memset(buffer, 0, kBlockSize);
+            }
+            memcpy(allocateBlock(blockIndex), buffer, kBlockSize);
+        }
+        extentIt = extents_.erase(extentIt);
+    }
+    if (openFile_ && openFileIndex_ == fileIndex) {
+        fclose(openFile_);
+        openFile_ = nullptr;
+    }
+}
+
+bool ClemensProDOSHostVolume::flush() {
+    if (!isMounted() || !isWriteBack_ || !hasDirtyBlocks_)
+        return true;
+    if (!writeBackDirectory(kVolumeKeyBlock, path_, 0))
+        return false;
+    dirtyBlocks_.assign(kBlockCount, false);
+    hasDirtyBlocks_ = false;
+    return true;
+}
+
+bool ClemensProDOSHostVolume::writeBackDirectory(unsigned keyBlock,
+                                                 const std::filesystem::path &hostPath,
+                                                 unsigned depth) {
+    if (depth >= kDirectoryDepthLimit)
+        return false;
+    uint8_t block[kBlockSize];
+    unsigned blockIndex = keyBlock;
+    unsigned entrySlot = 1;
+    unsigned blockLimit = kBlockCount;
+    bool isSaved = true;
+    while (blockIndex != 0 && blockLimit-- > 0) {
+        if (readBlock(blockIndex, block) != CLEM_SMARTPORT_STATUS_CODE_OK)
+            return false;
+        for (; entrySlot < kEntriesPerBlock; ++entrySlot) {
+            const uint8_t *entry = block + 4 + entrySlot * kEntryLength;
+            uint8_t storageType = entry[0] >> 4;
+            std::string name((const char *)entry + 1, entry[0] & 0xf);
+            //  the name becomes a host path, so anything odd is left out
+            if (storageType == 0 || !isValidName(name))
+                continue;
+            if (storageType == kStorageSubdirectory) {
+                unsigned subdirectoryKeyBlock = get16(entry + 0x11);
+                auto directoryIt =
+                    std::find_if(directories_.begin(), directories_.end(),
+                                 [&](const HostDirectory &directory) {
+                                     return directory.keyBlock == subdirectoryKeyBlock &&
+                                            directory.name == name &&
+                                            directory.hostPath.parent_path() == hostPath;
+                                 });
+                std::filesystem::path subdirectoryPath;
+                if (directoryIt != directories_.end()) {
+                    subdirectoryPath = directoryIt->hostPath;
+                } else {
+                    subdirectoryPath = hostPath / name;
+                    std::error_code errc;
+                    std::filesystem::create_directory(subdirectoryPath, errc);
+                    if (errc) {
+                        isSaved = false;
+                        continue;
+                    }
+                    directories_.push_back({subdirectoryPath, name, subdirectoryKeyBlock});
+                }
+                if (!writeBackDirectory(subdirectoryKeyBlock, subdirectoryPath, depth + 1)) {
+                    isSaved = false;
+                }
+            } else if (storageType >= kStorageSeedling && storageType <= kStorageTree) {
+                if (!writeBackFile(entry, hostPath)) {
+                    isSaved = false;
+                }
+            }
+        }
+        blockIndex = get16(block + 2);
+        entrySlot = 0;
+    }
+    return isSaved;
+}
+
+bool ClemensProDOSHostVolume::writeBackFile(const uint8_t *entry,
+                                            const std::filesystem::path &hostPath) {
+    uint8_t storageType = entry[0] >> 4;
+    std::string name((const char *)entry + 1, entry[0] & 0xf);
+    uint8_t fileType = entry[0x10];
+    unsigned keyBlock = get16(entry + 0x11);
+    unsigned eof = get24(entry + 0x15);
+    uint16_t auxType = uint16_t(get16(entry + 0x1f));
+    unsigned dataBlockCount = (eof + kBlockSize - 1) / kBlockSize;
+    uint8_t buffer[kBlockSize];
+
+    //  data blocks by position in the file, where 0 is a sparse block
+    std::vector<unsigned> dataBlocks;
+    bool isChanged = keyBlock < kBlockCount && dirtyBlocks_[keyBlock];
+    if (storageType == kStorageSeedling) {
+        dataBlocks.push_back(keyBlock);
+    } else {
+        std::vector<unsigned> indexBlocks;
+        if (storageType == kStorageTree) {
+            if (readBlock(keyBlock, buffer) != CLEM_SMARTPORT_STATUS_CODE_OK)
+                return false;
+            for (unsigned indexIndex = 0; indexIndex < 128; ++indexIndex) {
+                indexBlocks.push_back(buffer[indexIndex] | (unsigned(buffer[256 + indexIndex]) << 8));
+            }
+        } else {
+            indexBlocks.push_back(keyBlock);
+        }
+        for (unsigned indexBlock : indexBlocks) {
+            if (dataBlocks.size() >= dataBlockCount)
+                break;
+            if (indexBlock == 0) {
+                dataBlocks.resize(dataBlocks.size() + 256, 0);
+                continue;
+            }
+            if (readBlock(indexBlock, buffer) != CLEM_SMARTPORT_STATUS_CODE_OK)
+                return false;
+            isChanged = isChanged || dirtyBlocks_[indexBlock];
+            for (unsigned blockIndex = 0; blockIndex < 256; ++blockIndex) {
+                dataBlocks.push_back(buffer[blockIndex] | (unsigned(buffer[256 + blockIndex]) << 8));
+            }
+        }
+    }
+    dataBlocks.resize(dataBlockCount, 0);
+    for (unsigned dataBlock : dataBlocks) {
+        if (dataBlock != 0 && dataBlock < kBlockCount && dirtyBlocks_[dataBlock]) {
+            isChanged = true;
+        }
+    }
+
+    auto fileIt = std::find_if(files_.begin(), files_.end(), [&](const HostFile &file) {
+        return file.keyBlock == keyBlock && file.name == name &&
+               file.hostPath.parent_path() == hostPath;
+    });
+    if (fileIt != files_.end() && !isChanged && fileIt->size == eof)
+        return true;
+
+    std::vector<uint8_t> data(eof);
+    for (unsigned blockIndex = 0; blockIndex < dataBlockCount; ++blockIndex) {
+        if (dataBlocks[blockIndex] == 0)
+            continue;
+        if (readBlock(dataBlocks[blockIndex], buffer) != CLEM_SMARTPORT_STATUS_CODE_OK)
+            return false;
+        unsigned byteOffset = blockIndex * kBlockSize;
+        memcpy(data.data() + byteOffset, buffer, std::min(kBlockSize, eof - byteOffset));
+    }
+
+    std::filesystem::path filePath;
+    if (fileIt != files_.end()) {
+        filePath = fileIt->hostPath;
+    } else {
+        filePath = hostPath / toHostFileName(name, fileType, auxType);
+    }
+    //  the volume may still read other blocks from the file being replaced
+    for (unsigned fileIndex = 0; fileIndex < files_.size(); ++fileIndex) {
+        if (files_[fileIndex].hostPath == filePath) {
+            detachHostFile(fileIndex);
+        }
+    }
+    FILE *fp = fopen(filePath.string().c_str(), "wb");
+    if (!fp)
+        return false;
+    bool isWritten = fwrite(data.data(), 1, data.size(), fp) == data.size();
+    if (fclose(fp) != 0 || !isWritten)
+        return false;
+
+    //  the lookup is done again as detaching doesn't change files_, but the
+    //  new file may have been added by an earlier pass
+    fileIt = std::find_if(files_.begin(), files_.end(), [&](const HostFile &file) {
+        return file.keyBlock == keyBlock && file.name == name &&
+               file.hostPath.parent_path() == hostPath;
+    });
+    if (fileIt != files_.end()) {
+        fileIt->size = eof;
+    } else {
+        files_.push_back({filePath, name, eof, keyBlock});
+    }
+    return true;
+}
+
+void ClemensProDOSHostVolume::serialize(mpack_writer_t *writer) const {
+    mpack_build_map(writer);
+    mpack_write_cstr(writer, "path");
+    mpack_write_cstr(writer, path_.c_str());
+    mpack_write_cstr(writer, "write_back");
+    mpack_write_bool(writer, isWriteBack_);
+    mpack_write_cstr(writer, "files");
+    mpack_start_array(writer, unsigned(files_.size()));
+    for (auto &file : files_) {
+        mpack_start_array(writer, 4);
+        mpack_write_cstr(writer, file.hostPath.string().c_str());
+        mpack_write_cstr(writer, file.name.c_str());
+        mpack_write_uint(writer, file.size);
+        mpack_write_uint(writer, file.keyBlock);
+        mpack_finish_array(writer);
+    }
+    mpack_finish_array(writer);
+    mpack_write_cstr(writer, "directories");
+    mpack_start_array(writer, unsigned(directories_.size()));
+    for (auto &directory : directories_) {
+        mpack_start_array(writer, 3);
+        mpack_write_cstr(writer, directory.hostPath.string().c_str());
+        mpack_write_cstr(writer, directory.name.c_str());
+        mpack_write_uint(writer, directory.keyBlock);
+        mpack_finish_array(writer);
+    }
+    mpack_finish_array(writer);
+    mpack_write_cstr(writer, "extents");
+    mpack_start_array(writer, unsigned(extents_.size()));
+    for (auto &extent : extents_) {
+        mpack_start_array(writer, 3);
+        mpack_write_uint(writer, extent.firstBlock);
+        mpack_write_uint(writer, extent.blockCount);
+        mpack_write_uint(writer, extent.fileIndex);
+        mpack_finish_array(writer);
+    }
+    mpack_finish_array(writer);
+    //  the generated and written blocks, with those that are not yet written
+    //  back to the host
+    mpack_write_cstr(writer, "blocks");
+    unsigned blockCount = unsigned(blockPool_.size() / kBlockSize);
+    mpack_start_array(writer, blockCount);
+    for (unsigned blockIndex = 0; blockIndex < blockSlots_.size(); ++blockIndex) {
+        uint32_t slot = blockSlots_[blockIndex];
+        if (slot >= kSlotFile)
+            continue;
+        mpack_start_array(writer, 3);
+        mpack_write_uint(writer, blockIndex);
+        mpack_write_bool(writer, dirtyBlocks_[blockIndex]);
+        mpack_write_bin(writer, (const char *)blockPool_.data() + size_t(slot) * kBlockSize,
+                        kBlockSize);
+        mpack_finish_array(writer);
+    }
+    mpack_finish_array(writer);
+    mpack_complete_map(writer);
+}
+
+bool ClemensProDOSHostVolume::unserialize(mpack_reader_t *reader) {
+    char str[1024];
+    unmount();
+
+    mpack_expect_map(reader);
+    mpack_expect_cstr_match(reader, "path");
+    mpack_expect_cstr(reader, str, sizeof(str));
+    std::string path = str;
+    mpack_expect_cstr_match(reader, "write_back");
+    bool isWriteBack = mpack_expect_bool(reader);
+    mpack_expect_cstr_match(reader, "files");
+    unsigned count = mpack_expect_array(reader);
+    for (unsigned index = 0; index < count; ++index) {
+        HostFile file;
+        mpack_expect_array_match(reader, 4);
+        mpack_expect_cstr(reader, str, sizeof(str));
+        file.hostPath = str;
+        mpack_expect_cstr(reader, str, sizeof(str));
+        file.name = str;
+        file.size = mpack_expect_u32(reader);
+        file.keyBlock = mpack_expect_u32(reader);
+        mpack_done_array(reader);
+        files_.emplace_back(std::move(file));
+    }
+    mpack_done_array(reader);
+    mpack_expect_cstr_match(reader, "directories");
+    count = mpack_expect_array(reader);
+    for (unsigned index = 0; index < count; ++index) {
+        HostDirectory directory;
+        mpack_expect_array_match(reader, 3);
+        mpack_expect_cstr(reader, str, sizeof(str));
+        directory.hostPath = str;
+        mpack_expect_cstr(reader, str, sizeof(str));
+        directory.name = str;
+        directory.keyBlock = mpack_expect_u32(reader);
+        mpack_done_array(reader);
+        directories_.emplace_back(std::move(directory));
+    }
+    mpack_done_array(reader);
+
+    blockSlots_.assign(kBlockCount, kSlotFree);
+    dirtyBlocks_.assign(kBlockCount, false);
+    mpack_expect_cstr_match(reader, "extents");
+    count = mpack_expect_array(reader);
+    for (unsigned index = 0; index < count; ++index) {
+        FileExtent extent;
+        mpack_expect_array_match(reader, 3);
+        extent.firstBlock = mpack_expect_u32(reader);
+        extent.blockCount = mpack_expect_u32(reader);
+        extent.fileIndex = mpack_expect_u32(reader);
+        mpack_done_array(reader);
+        if (extent.fileIndex >= files_.size() || extent.firstBlock >= kBlockCount ||
+            extent.blockCount > kBlockCount - extent.firstBlock) {
+            mpack_reader_flag_error(reader, mpack_error_data);
+            break;
+        }
+        for (unsigned blockIndex = 0; blockIndex < extent.blockCount; ++blockIndex) {
+            blockSlots_[extent.firstBlock + blockIndex] = kSlotFile;
+        }
+        extents_.push_back(extent);
+    }
+    mpack_done_array(reader);
+    mpack_expect_cstr_match(reader, "blocks");
+    count = mpack_expect_array(reader);
+    for (unsigned index = 0; index < count; ++index) {
+        mpack_expect_array_match(reader, 3);
+        unsigned blockIndex = mpack_expect_u32_max(reader, kBlockCount - 1);
+        bool isDirty = mpack_expect_bool(reader);
+        mpack_expect_bin_size(reader, kBlockSize);
+        if (mpack_reader_error(reader) != mpack_ok)
+            break;
+        mpack_read_bytes(reader, (char *)allocateBlock(blockIndex), kBlockSize);
+        mpack_done_bin(reader);
+        mpack_done_array(reader);
+        dirtyBlocks_[blockIndex] = isDirty;
+        hasDirtyBlocks_ = hasDirtyBlocks_ || isDirty;
+    }
+    mpack_done_array(reader);
+    mpack_done_map(reader);
+
+    if (mpack_reader_error(reader) != mpack_ok) {
+        hasDirtyBlocks_ = false;
+        unmount();
+        return false;
+    }
+    std::sort(extents_.begin(), extents_.end(),
+              [](const FileExtent &a, const FileExtent &b) { return a.firstBlock < b.firstBlock; });
+    path_ = path;
+    isWriteBack_ = isWriteBack;
+    return true;
+}
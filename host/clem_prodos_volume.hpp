@@ -0,0 +1,118 @@
+#ifndef CLEM_HOST_PRODOS_VOLUME_HPP
+#define CLEM_HOST_PRODOS_VOLUME_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+typedef struct mpack_writer_t mpack_writer_t;
+typedef struct mpack_reader_t mpack_reader_t;
+
+//  A ProDOS block device synthesized from a host directory.
+//
+//  Mounting only lists the directory tree.  The volume directory, the
+//  subdirectories, index blocks and the volume bitmap are generated in memory,
+//  and each file's data blocks are laid out contiguously and read from the
+//  host file when the guest asks for them.  Nothing is copied.
+//
+//  Blocks the guest writes are kept in memory.  With write-back enabled,
+//  flush() walks the volume as the guest left it and writes every file with
+//  changed blocks (or a new file) into the host directory.  Files and
+//  directories the guest deletes or renames are left alone on the host.
+//
+//  Host files are named as they are, or with a "#ttaaaa" suffix (file type
+//  and auxiliary type in hex) that sets their ProDOS type.  Without a suffix
+//  the type comes from the extension, and is BIN otherwise.
+//
+class ClemensProDOSHostVolume {
+  public:
+    static constexpr unsigned kBlockSize = 512;
+    //  Every volume has the ProDOS maximum, so the guest has room for new files
+    static constexpr unsigned kBlockCount = 65535;
+
+    ClemensProDOSHostVolume();
+    ~ClemensProDOSHostVolume();
+
+    ClemensProDOSHostVolume(const ClemensProDOSHostVolume &) = delete;
+    ClemensProDOSHostVolume &operator=(const ClemensProDOSHostVolume &) = delete;
+
+    //  Fails if the path isn't a directory or its files don't fit on a volume
+    bool mount(const std::string &directoryPath, bool writeBack);
+    //  Writes back changes if enabled and forgets the volume.  Returns false
+    //  if any of them could not be written.
+    bool unmount();
+    //  Writes back changes if enabled.  Returns false on a write error.
+    bool flush();
+
+    bool isMounted() const { return !path_.empty(); }
+    bool isWriteBack() const { return isWriteBack_; }
+    const std::string &getPathname() const { return path_; }
+    unsigned getBlockCount() const { return isMounted() ? kBlockCount : 0; }
+    //  Files and directories skipped because their names or sizes don't fit
+    unsigned getSkippedCount() const { return skippedCount_; }
+
+    //  These return a CLEM_SMARTPORT_STATUS_CODE
+    uint8_t readBlock(unsigned blockIndex, uint8_t *buffer);
+    uint8_t writeBlock(unsigned blockIndex, const uint8_t *buffer);
+
+    //  Snapshots hold the generated layout and every block in memory, so the
+    //  volume restores as it was even if the host directory has changed since
+    void serialize(mpack_writer_t *writer) const;
+    bool unserialize(mpack_reader_t *reader);
+
+  private:
+    struct Entry;
+    struct HostFile {
+        std::filesystem::path hostPath;
+        std::string name;
+        uint32_t size;
+        unsigned keyBlock;
+    };
+    struct FileExtent {
+        unsigned firstBlock;
+        unsigned blockCount;
+        unsigned fileIndex;
+    };
+    struct HostDirectory {
+        std::filesystem::path hostPath;
+        std::string name;
+        unsigned keyBlock;
+    };
+
+    bool scanDirectory(Entry &directory, unsigned depth);
+    bool allocateDirectory(Entry &directory);
+    void buildDirectory(const Entry &directory, unsigned parentBlock, unsigned parentEntryNumber);
+    void buildFile(const Entry &file);
+    void buildBitmap();
+    uint8_t *allocateBlock(unsigned blockIndex);
+
+    uint8_t readFileBlock(const FileExtent &extent, unsigned blockIndex, uint8_t *buffer);
+    void detachHostFile(unsigned fileIndex);
+    bool writeBackDirectory(unsigned keyBlock, const std::filesystem::path &hostPath,
+                            unsigned depth);
+    bool writeBackFile(const uint8_t *entry, const std::filesystem::path &hostPath);
+
+  private:
+    std::string path_;
+    bool isWriteBack_;
+    unsigned skippedCount_;
+    unsigned nextBlock_;
+    unsigned bitmapBlock_;
+    bool hasDirtyBlocks_;
+
+    //  Per block: free, file data (see extents_) or a block in blockPool_
+    std::vector<uint32_t> blockSlots_;
+    std::vector<uint8_t> blockPool_;
+    std::vector<bool> dirtyBlocks_;
+    //  sorted by first block
+    std::vector<FileExtent> extents_;
+    std::vector<HostFile> files_;
+    std::vector<HostDirectory> directories_;
+
+    FILE *openFile_;
+    unsigned openFileIndex_;
+};
+
+#endif
@@ -1,7 +1,10 @@
 #include "clem_program_trace.hpp"
+#include "clem_symbol_table.hpp"
+#include "clem_trace_index.hpp"
 
 #include "clem_mmio_defs.h"
 
+#include <algorithm>
 #include <array>
 #include <cstdint>
 #include <cstdio>
@@ -41,15 +44,79 @@ static std::array<const char *, 0x20> kToolsetNames = {"Tool Locator",
                                                        "Unknown",
                                                        "Unknown"};
 
+namespace {
+
+constexpr unsigned kToolboxRecordLimit = 4096;
+constexpr unsigned kToolboxDefaultParamCount = 8;
+
+} // namespace
+
 ClemensProgramTrace::ClemensProgramTrace()
-    : enableToolboxLogging_(false), enableIWMLogging_(false) {
+    : toolboxRecords_(kToolboxRecordLimit), symbols_(nullptr), enableToolboxLogging_(false),
+      enableIWMLogging_(false) {
+    memset(&toolboxLog_, 0, sizeof(toolboxLog_));
+    toolboxLog_.records = toolboxRecords_.data();
+    toolboxLog_.record_limit = kToolboxRecordLimit;
+    toolboxLog_.param_count = kToolboxDefaultParamCount;
     reset();
 }
 
+ClemensProgramTrace::~ClemensProgramTrace() = default;
+
 void ClemensProgramTrace::enableToolboxLogging(bool enable) { enableToolboxLogging_ = enable; }
 
+void ClemensProgramTrace::setToolboxParamCount(unsigned count) {
+    toolboxLog_.param_count = std::min(count, unsigned(CLEM_TOOLBOX_PARAM_LIMIT));
+}
+
+void ClemensProgramTrace::consumeToolboxLog() {
+    //  the log is filled and consumed on the emulator thread, so the ring needs
+    //  no synchronization
+    while (toolboxLog_.tail != toolboxLog_.head) {
+        auto &record = toolboxRecords_[toolboxLog_.tail & (toolboxLog_.record_limit - 1)];
+        auto &profile = toolboxProfile_[record.call];
+        profile.call = record.call;
+        if (record.type == kClemensToolboxRecord_Call) {
+            ++profile.count;
+            toolboxCalls_.emplace_back(record);
+        } else {
+            ++profile.returns;
+            profile.clocks += record.clocks;
+        }
+        ++toolboxLog_.tail;
+    }
+}
+
+std::vector<ClemensProgramTrace::ToolboxProfile> ClemensProgramTrace::getToolboxProfile() const {
+    std::vector<ToolboxProfile> profile;
+    profile.reserve(toolboxProfile_.size());
+    for (auto &entry : toolboxProfile_) {
+        profile.emplace_back(entry.second);
+    }
+    std::sort(profile.begin(), profile.end(),
+              [](const ToolboxProfile &a, const ToolboxProfile &b) {
+                  return a.clocks != b.clocks ? a.clocks > b.clocks : a.count > b.count;
+              });
+    return profile;
+}
+
+const char *ClemensProgramTrace::getToolsetName(uint16_t call) {
+    unsigned toolset = (call & 0xff) - 1;
+    return toolset < kToolsetNames.size() ? kToolsetNames[toolset] : "???";
+}
+
 void ClemensProgramTrace::enableIWMLogging(bool enable) { enableIWMLogging_ = enable; }
 
+ClemensTraceIndex *ClemensProgramTrace::enableIndex(const char *directory) {
+    index_ = std::make_unique<ClemensTraceIndex>(directory);
+    if (!index_->isOk()) {
+        index_ = nullptr;
+    }
+    return index_.get();
+}
+
+void ClemensProgramTrace::disableIndex() { index_ = nullptr; }
+
 ClemensTraceExecutedInstruction &
 ClemensProgramTrace::addExecutedInstruction(uint64_t seq, const ClemensInstruction &instruction,
                                             const char *operand,
@@ -127,14 +194,8 @@ ClemensProgramTrace::addExecutedInstruction(uint64_t seq, const ClemensInstructi
     }
 
     current = &actions_[newCurrentActionIdx];
-    if (enableToolboxLogging_) {
-        if (instruction.opc == CLEM_OPC_JSL && instruction.bank == 0xe1 &&
-            instruction.value == 0x0000) {
-            toolboxCalls_.emplace_back();
-            toolboxCalls_.back().call = machineState.cpu.regs.X;
-            toolboxCalls_.back().pc = instruction.addr;
-            toolboxCalls_.back().pbr = instruction.pbr;
-        }
+    if (index_) {
+        index_->addInstruction(seq, instruction, machineState);
     }
     if (enableIWMLogging_ && machineState.cpu.pins.ioOut) {
         if (machineState.cpu.pins.vdaOut &&
@@ -158,6 +219,8 @@ ClemensProgramTrace::addExecutedInstruction(uint64_t seq, const ClemensInstructi
 void ClemensProgramTrace::reset() {
     actions_.clear();
     freeActionIndices_.clear();
+    toolboxCalls_.clear();
+    toolboxProfile_.clear();
 
     actions_.emplace_back();
     actionAnchor_ = uint32_t(actions_.size() - 1);
@@ -184,6 +247,26 @@ bool ClemensProgramTrace::exportTrace(const char *filename) {
                                action.inst.cycles_spent, action.inst.opcode, action.inst.operand);
             outLeft -= amt;
             out += amt;
+            if (symbols_ && !symbols_->empty()) {
+                //  <symbol+offset> [-> <target symbol>]
+                char *annotation = out;
+                size_t len = symbols_->format(out, std::min<size_t>(outLeft, 64), action.inst.pc);
+                out += len;
+                outLeft -= len;
+                if (action.inst.target != ClemensTraceExecutedInstruction::kNoTarget) {
+                    char targetName[64];
+                    if (symbols_->format(targetName, sizeof(targetName), action.inst.target)) {
+                        amt = snprintf(out, outLeft, "%s-> %s", out == annotation ? "" : " ",
+                                       targetName);
+                        out += amt;
+                        outLeft -= amt;
+                    }
+                }
+                amt = snprintf(out, outLeft, "%*s| ", std::max(0, 40 - int(out - annotation)),
+                               "");
+                out += amt;
+                outLeft -= amt;
+            }
             amt = snprintf(out, outLeft, "PC=%04X, PBR=%02X, DBR=%02X, S=%04X, D=%04X, e=%u, ",
                            action.regs.PC, action.regs.PBR, action.regs.DBR, action.regs.S,
                            action.regs.D, action.emulation ? 1 : 0);
@@ -239,23 +322,36 @@ bool ClemensProgramTrace::exportTrace(const char *filename) {
             for (auto &tbc : toolboxCalls_) {
                 char *out = &line[0];
                 size_t outLeft = sizeof(line);
-                int amt;
-                unsigned toolset = tbc.call - 1;
-                if ((toolset & 0xff) >= kToolsetNames.size()) {
-                    amt = snprintf(out, outLeft, "%02X:%04X CALL #%04X ???", tbc.pbr, tbc.pc,
-                                   tbc.call);
-                } else {
-                    amt = snprintf(out, outLeft, "%02X:%04X CALL #%04X %s", tbc.pbr, tbc.pc,
-                                   tbc.call, kToolsetNames[toolset & 0xff]);
-                }
+                int amt = snprintf(out, outLeft, "%02X:%04X CALL #%04X%s S=%04X %-24s",
+                                   tbc.caller >> 16, tbc.caller & 0xffff, tbc.call,
+                                   tbc.entry ? " ALT" : "", tbc.stack, getToolsetName(tbc.call));
                 outLeft -= amt;
                 out += amt;
+                for (unsigned i = 0; i < tbc.param_count; ++i) {
+                    amt = snprintf(out, outLeft, " %02X", tbc.params[i]);
+                    outLeft -= amt;
+                    out += amt;
+                }
                 out[0] = '\n';
                 out[1] = '\0';
                 fputs(line, fp);
             }
         }
 
+        if (!toolboxProfile_.empty()) {
+            fputs("\nTOOLBOX PROFILE:\n=================================================\n", fp);
+            fputs("    CALL    COUNT  RETURNED      FAST CYCLES TOOLSET\n", fp);
+            for (auto &profile : getToolboxProfile()) {
+                fprintf(fp, "   #%04X %8" PRIu64 "  %8" PRIu64 " %16" PRIu64 " %s\n", profile.call,
+                        profile.count, profile.returns,
+                        uint64_t(profile.clocks / CLEM_CLOCKS_FAST_CYCLE),
+                        getToolsetName(profile.call));
+            }
+            if (toolboxLog_.dropped) {
+                fprintf(fp, "(%u records dropped)\n", toolboxLog_.dropped);
+            }
+        }
+
         if (!memoryOps_.empty()) {
             fputs("\nOPS:\n=================================================\n", fp);
 
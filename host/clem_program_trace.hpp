@@ -5,13 +5,19 @@
 #include <utility>
 
 #include <array>
+#include <memory>
+#include <unordered_map>
 #include <vector>
 
 #include "clem_host_utils.hpp"
 
+class ClemensSymbolTable;
+class ClemensTraceIndex;
+
 class ClemensProgramTrace {
   public:
     ClemensProgramTrace();
+    ~ClemensProgramTrace();
 
     void enableToolboxLogging(bool enable);
     void enableIWMLogging(bool enable);
@@ -19,6 +25,32 @@ class ClemensProgramTrace {
     bool isToolboxLoggingEnabled() const { return enableToolboxLogging_; }
     bool isIWMLoggingEnabled() const { return enableIWMLogging_; }
 
+    //  The log to attach to the machine with clemens_toolbox_log() (nullptr if
+    //  toolbox logging is disabled.)  Records are collected from the log by
+    //  consumeToolboxLog(), which should be called after each timeslice.
+    ClemensToolboxLog *getToolboxLog() {
+        return enableToolboxLogging_ ? &toolboxLog_ : nullptr;
+    }
+    void setToolboxParamCount(unsigned count);
+    void consumeToolboxLog();
+
+    struct ToolboxProfile {
+        uint16_t call;
+        uint64_t count;
+        uint64_t returns;
+        clem_clocks_time_t clocks; //  spent inside the calls that returned
+    };
+    //  Per tool call counts and time, ordered by time spent
+    std::vector<ToolboxProfile> getToolboxProfile() const;
+    static const char *getToolsetName(uint16_t call);
+
+    //  Records every instruction into an on-disk index that can be queried
+    //  while tracing (see ClemensTraceIndex.)  Returns the index or nullptr if
+    //  disabled or the index files could not be created.
+    ClemensTraceIndex *enableIndex(const char *directory);
+    void disableIndex();
+    ClemensTraceIndex *getIndex() { return index_.get(); }
+
     ClemensTraceExecutedInstruction &addExecutedInstruction(uint64_t seq,
                                                             const ClemensInstruction &instruction,
                                                             const char *operand,
@@ -26,6 +58,8 @@ class ClemensProgramTrace {
 
     void reset();
 
+    //  Exported traces show instruction addresses and targets by symbol
+    void setSymbols(const ClemensSymbolTable *symbols) { symbols_ = symbols; }
     bool exportTrace(const char *filename);
 
   private:
@@ -44,12 +78,10 @@ class ClemensProgramTrace {
     std::vector<Action> actions_;
     std::vector<uint32_t> freeActionIndices_;
 
-    struct Toolbox {
-        uint16_t call;
-        uint16_t pc;
-        uint8_t pbr;
-    };
-    std::vector<Toolbox> toolboxCalls_;
+    std::vector<ClemensToolboxRecord> toolboxCalls_;
+    std::unordered_map<uint16_t, ToolboxProfile> toolboxProfile_;
+    std::vector<ClemensToolboxRecord> toolboxRecords_;
+    ClemensToolboxLog toolboxLog_;
 
     struct MemoryOperation {
         uint64_t seq;
@@ -62,6 +94,9 @@ class ClemensProgramTrace {
     };
     std::vector<MemoryOperation> memoryOps_;
 
+    std::unique_ptr<ClemensTraceIndex> index_;
+    const ClemensSymbolTable *symbols_;
+
     bool enableToolboxLogging_;
     bool enableIWMLogging_;
 };
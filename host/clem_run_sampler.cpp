@@ -0,0 +1,123 @@
+#include "clem_run_sampler.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+void ClemensRunSampler::reset() {
+    frameDeadline = 0;
+    sampledFrameTime = std::chrono::microseconds::zero();
+    sampledClocksSpent = 0;
+    sampledCyclesSpent = 0;
+    sampledFramesPerSecond = 0.0f;
+    sampledEmulatorSpeedMhz = 0.0f;
+    frameTimeBuffer.clear();
+    clocksBuffer.clear();
+    cyclesBuffer.clear();
+    jitterFrameInterval = std::chrono::microseconds::zero();
+    jitterFrameCount = 0;
+    jitterWakeCount = 0;
+}
+
+void ClemensRunSampler::update(std::chrono::microseconds fixedFrameInterval,
+                               std::chrono::microseconds actualFrameInterval,
+                               clem_clocks_duration_t clocksSpent, unsigned cyclesSpent) {
+    if (fixedFrameInterval > std::chrono::microseconds::zero()) {
+        uint64_t now = clem_host_timer_ns();
+        if (frameDeadline == 0) {
+            frameDeadline = now;
+        } else {
+            //  the frame just finished was paced
+            if (jitterFrameInterval != fixedFrameInterval) {
+                jitterFrameInterval = fixedFrameInterval;
+                jitterFrameCount = 0;
+                jitterWakeCount = 0;
+            }
+            jitterFrameTimes[jitterFrameCount++ % kJitterSampleLimit] =
+                float(actualFrameInterval.count());
+        }
+        frameDeadline += uint64_t(fixedFrameInterval.count()) * 1000;
+        if (now < frameDeadline) {
+            clem_host_sleep_until(frameDeadline);
+            uint64_t wakeTime = clem_host_timer_ns();
+            jitterWakeLatencies[jitterWakeCount++ % kJitterSampleLimit] =
+                wakeTime > frameDeadline ? float(wakeTime - frameDeadline) / 1000 : 0.0f;
+        } else {
+            std::this_thread::yield();
+            if (now - frameDeadline > 500000000) {
+                frameDeadline = now;
+            }
+        }
+    } else {
+        //  unpaced
+        frameDeadline = 0;
+    }
+
+    if (frameTimeBuffer.isFull()) {
+        decltype(frameTimeBuffer)::ValueType lruFrametime;
+        frameTimeBuffer.pop(lruFrametime);
+        sampledFrameTime -= lruFrametime;
+    }
+    frameTimeBuffer.push(actualFrameInterval);
+    sampledFrameTime += actualFrameInterval;
+
+    if (sampledFrameTime >= std::chrono::microseconds(100000)) {
+        sampledFramesPerSecond = frameTimeBuffer.size() * 1e6 / sampledFrameTime.count();
+    }
+
+    //  calculate emulator speed by using cycles_spent * CLEM_CLOCKS_MEGA2_CYCLE
+    //  as a reference for 1.023mhz where
+    //    reference_clocks = cycles_spent * CLEM_CLOCKS_MEGA2_CYCLE
+    //    acutal_clocks = sampledClocksSpent
+    //    (reference / actual) * 1.023mhz is the emulator speed
+    if (clocksBuffer.isFull()) {
+        decltype(clocksBuffer)::ValueType lruClocksSpent = 0;
+        clocksBuffer.pop(lruClocksSpent);
+        sampledClocksSpent -= lruClocksSpent;
+    }
+    clocksBuffer.push(clocksSpent);
+    sampledClocksSpent += clocksSpent;
+
+    if (cyclesBuffer.isFull()) {
+        decltype(cyclesBuffer)::ValueType lruCycles = 0;
+        cyclesBuffer.pop(lruCycles);
+        sampledCyclesSpent -= lruCycles;
+    }
+    cyclesBuffer.push(cyclesSpent);
+    sampledCyclesSpent += cyclesSpent;
+    if (sampledClocksSpent > (CLEM_CLOCKS_MEGA2_CYCLE * CLEM_MEGA2_CYCLES_PER_SECOND / 10)) {
+        sampledEmulatorSpeedMhz =
+            1.023 * double(CLEM_CLOCKS_MEGA2_CYCLE * sampledCyclesSpent) / sampledClocksSpent;
+    }
+}
+
+ClemensBackendFrameStats ClemensRunSampler::getFrameStats() const {
+    ClemensBackendFrameStats stats{};
+    unsigned frameCount = std::min(jitterFrameCount, kJitterSampleLimit);
+    if (frameCount > 0) {
+        float target = float(jitterFrameInterval.count());
+        double sum = 0.0, sumSquares = 0.0;
+        for (unsigned i = 0; i < frameCount; ++i) {
+            float frameTime = jitterFrameTimes[i];
+            sum += frameTime;
+            sumSquares += double(frameTime) * frameTime;
+            stats.maxFrameTimeError =
+                std::max(stats.maxFrameTimeError, std::fabs(frameTime - target));
+        }
+        double mean = sum / frameCount;
+        stats.frameCount = frameCount;
+        stats.meanFrameTime = float(mean);
+        stats.frameTimeDeviation =
+            float(std::sqrt(std::max(0.0, sumSquares / frameCount - mean * mean)));
+    }
+    unsigned wakeCount = std::min(jitterWakeCount, kJitterSampleLimit);
+    if (wakeCount > 0) {
+        double sum = 0.0;
+        for (unsigned i = 0; i < wakeCount; ++i) {
+            sum += jitterWakeLatencies[i];
+            stats.maxWakeLatency = std::max(stats.maxWakeLatency, jitterWakeLatencies[i]);
+        }
+        stats.meanWakeLatency = float(sum / wakeCount);
+    }
+    return stats;
+}
@@ -0,0 +1,58 @@
+#ifndef CLEM_HOST_RUN_SAMPLER_HPP
+#define CLEM_HOST_RUN_SAMPLER_HPP
+
+#include "clem_host_shared.hpp"
+
+#include "cinek/circular_buffer.hpp"
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+
+//  Paces the emulator thread's frames and samples how fast it runs.
+//
+//  The simulation is kept in sync with real time by ending each frame on an
+//  absolute deadline one fixed interval after the last.  A late wake up
+//  shortens the next sleep instead of delaying every frame after it, which is
+//  what accumulated with relative sleeps on loaded hosts.
+//
+//  If the host falls far behind (i.e. a debugger stop), the deadline is moved
+//  to the present rather than running frames back to back to catch up.
+//
+struct ClemensRunSampler {
+    uint64_t frameDeadline;
+    std::chrono::microseconds sampledFrameTime;
+
+    double sampledFramesPerSecond;
+
+    cinek::CircularBuffer<std::chrono::microseconds, 120> frameTimeBuffer;
+
+    clem_clocks_time_t sampledClocksSpent;
+    uint64_t sampledCyclesSpent;
+    cinek::CircularBuffer<clem_clocks_duration_t, 120> clocksBuffer;
+    cinek::CircularBuffer<clem_clocks_duration_t, 120> cyclesBuffer;
+
+    double sampledEmulatorSpeedMhz;
+
+    //  jitter samples from paced frames only
+    static constexpr unsigned kJitterSampleLimit = 120;
+    std::chrono::microseconds jitterFrameInterval;
+    std::array<float, kJitterSampleLimit> jitterFrameTimes;
+    std::array<float, kJitterSampleLimit> jitterWakeLatencies;
+    unsigned jitterFrameCount;
+    unsigned jitterWakeCount;
+
+    ClemensRunSampler() { reset(); }
+
+    void reset();
+    //  Called once per frame, sleeping until the frame's deadline if paced (a
+    //  non-zero fixedFrameInterval.)
+    void update(std::chrono::microseconds fixedFrameInterval,
+                std::chrono::microseconds actualFrameInterval, clem_clocks_duration_t clocksSpent,
+                unsigned cyclesSpent);
+    //  Pacing over the last kJitterSampleLimit paced frames at the current
+    //  interval
+    ClemensBackendFrameStats getFrameStats() const;
+};
+
+#endif
@@ -0,0 +1,219 @@
+#include "clem_serial_port.hpp"
+
+#include "emulator_mmio.h"
+
+#include <algorithm>
+#include <array>
+
+#if !defined(_WIN32)
+#include <cerrno>
+#include <cstdlib>
+#include <fcntl.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <termios.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+//  At 19200 baud the guest sends under 2K per second, so anything past this
+//  means nobody is reading the endpoint.
+constexpr size_t kOutgoingLimit = 64 * 1024;
+constexpr size_t kReadChunkSize = 1024;
+
+#if !defined(_WIN32)
+//  A write to a socket the peer has closed raises SIGPIPE, which would kill
+//  the emulator.  Sends ask for EPIPE instead (or, where MSG_NOSIGNAL isn't
+//  available, the socket is opened with SO_NOSIGPIPE.)
+#if defined(MSG_NOSIGNAL)
+constexpr int kSendFlags = MSG_NOSIGNAL;
+#else
+constexpr int kSendFlags = 0;
+#endif
+#endif
+
+#if !defined(_WIN32)
+int openPty(std::string &name) {
+    int fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if (fd < 0)
+        return -1;
+    if (grantpt(fd) != 0 || unlockpt(fd) != 0) {
+        close(fd);
+        return -1;
+    }
+    //  the guest sees a raw 8-bit line
+    struct termios tio;
+    if (tcgetattr(fd, &tio) == 0) {
+        cfmakeraw(&tio);
+        tcsetattr(fd, TCSANOW, &tio);
+    }
+    const char *slaveName = ptsname(fd);
+    name = slaveName ? slaveName : "";
+    return fd;
+}
+
+int openSocket(const std::string &address) {
+    auto sepPos = address.rfind(':');
+    if (sepPos == std::string::npos)
+        return -1;
+    auto host = address.substr(0, sepPos);
+    auto port = address.substr(sepPos + 1);
+    struct addrinfo hints {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo *results = nullptr;
+    if (getaddrinfo(host.empty() ? "localhost" : host.c_str(), port.c_str(), &hints, &results) !=
+        0)
+        return -1;
+    int fd = -1;
+    for (auto *ai = results; ai != nullptr; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0)
+            continue;
+        if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+#if defined(SO_NOSIGPIPE)
+            int noSigPipe = 1;
+            setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &noSigPipe, sizeof(noSigPipe));
+#endif
+            break;
+        }
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(results);
+    return fd;
+}
+#endif
+
+} // namespace
+
+ClemensSerialPort::ClemensSerialPort(Type type, std::string target)
+    : type_(type), name_(std::move(target)), isOpen_(false), isConnected_(false), fp_(nullptr),
+      fd_(-1), bytesSent_(0), bytesReceived_(0), bytesDropped_(0) {
+    switch (type_) {
+    case Type::Loopback:
+        isOpen_ = true;
+        break;
+    case Type::File:
+        fp_ = fopen(name_.c_str(), "ab");
+        isOpen_ = fp_ != nullptr;
+        break;
+#if !defined(_WIN32)
+    case Type::Pty:
+        fd_ = openPty(name_);
+        break;
+    case Type::Socket:
+        fd_ = openSocket(name_);
+        break;
+#else
+    default:
+        break;
+#endif
+    }
+#if !defined(_WIN32)
+    if (fd_ >= 0) {
+        fcntl(fd_, F_SETFL, fcntl(fd_, F_GETFL) | O_NONBLOCK);
+        isOpen_ = true;
+    }
+#endif
+    isConnected_ = isOpen_;
+}
+
+ClemensSerialPort::~ClemensSerialPort() {
+    if (fp_) {
+        fclose(fp_);
+    }
+#if !defined(_WIN32)
+    if (fd_ >= 0) {
+        close(fd_);
+    }
+#endif
+}
+
+void ClemensSerialPort::transfer(ClemensMMIO &mmio, unsigned channel) {
+    std::array<uint8_t, CLEM_SCC_HOST_QUEUE_SIZE> buffer;
+    unsigned count;
+    while ((count = clemens_serial_drain(&mmio, channel, buffer.data(), buffer.size())) > 0) {
+        writeOut(buffer.data(), count);
+    }
+    readIn();
+
+    if (!incoming_.empty()) {
+        count = clemens_serial_feed(&mmio, channel, incoming_.data(), unsigned(incoming_.size()));
+        incoming_.erase(incoming_.begin(), incoming_.begin() + count);
+    }
+    clemens_serial_connect(&mmio, channel, isConnected_);
+}
+
+void ClemensSerialPort::writeOut(const uint8_t *data, size_t count) {
+    if (type_ == Type::Loopback) {
+        incoming_.insert(incoming_.end(), data, data + count);
+        bytesSent_ += count;
+        return;
+    }
+    if (type_ == Type::File) {
+        if (fwrite(data, 1, count, fp_) == count) {
+            fflush(fp_);
+            bytesSent_ += count;
+        } else {
+            bytesDropped_ += count;
+        }
+        return;
+    }
+#if !defined(_WIN32)
+    if (!outgoing_.empty() || !isConnected_) {
+        size_t available = kOutgoingLimit - std::min(kOutgoingLimit, outgoing_.size());
+        size_t accepted = std::min(count, available);
+        outgoing_.insert(outgoing_.end(), data, data + accepted);
+        bytesDropped_ += count - accepted;
+        if (!isConnected_)
+            return;
+        data = outgoing_.data();
+        count = outgoing_.size();
+    }
+    ssize_t written = type_ == Type::Socket ? send(fd_, data, count, kSendFlags)
+                                             : write(fd_, data, count);
+    size_t remaining = written < 0 ? count : count - size_t(written);
+    if (written > 0) {
+        bytesSent_ += size_t(written);
+    } else if (written < 0 && errno == EPIPE) {
+        //  the peer closed its end; output is held (up to the limit) as it is
+        //  for any other disconnect
+        isConnected_ = false;
+    }
+    if (!outgoing_.empty()) {
+        outgoing_.erase(outgoing_.begin(), outgoing_.end() - remaining);
+    } else if (remaining > 0) {
+        outgoing_.assign(data + (count - remaining), data + count);
+    }
+#endif
+}
+
+void ClemensSerialPort::readIn() {
+#if !defined(_WIN32)
+    if (fd_ < 0)
+        return;
+    //  keep at most a chunk waiting on the SCC so a fast endpoint is throttled
+    //  by the kernel rather than by an unbounded buffer here
+    if (incoming_.size() >= kReadChunkSize)
+        return;
+    uint8_t buffer[kReadChunkSize];
+    ssize_t amount = read(fd_, buffer, sizeof(buffer));
+    if (amount > 0) {
+        incoming_.insert(incoming_.end(), buffer, buffer + amount);
+        bytesReceived_ += size_t(amount);
+        isConnected_ = true;
+    } else if (amount == 0) {
+        //  the peer closed the socket
+        if (type_ == Type::Socket)
+            isConnected_ = false;
+    } else if (errno == EIO) {
+        //  no process has the pty open
+        isConnected_ = false;
+    } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        if (type_ == Type::Pty)
+            isConnected_ = true;
+    }
+#endif
+}
@@ -0,0 +1,65 @@
+#ifndef CLEM_HOST_SERIAL_PORT_HPP
+#define CLEM_HOST_SERIAL_PORT_HPP
+
+#include "clem_mmio_types.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+//  Connects an emulated SCC channel to a host endpoint.
+//
+//  transfer() is called once per emulator timeslice on the emulator thread.  It
+//  drains the bytes the guest transmitted since the last call and writes them
+//  to the endpoint in one write, then reads whatever the endpoint has available
+//  without blocking and queues it for the guest.  The SCC paces delivery at the
+//  port's baud rate, so the endpoint never sees per-character traffic.
+//
+//  Endpoints:
+//      Loopback - transmitted bytes are received back by the guest
+//      File     - transmitted bytes are appended to a file (i.e. a printer)
+//      Pty      - a pseudo terminal; getName() is the device for other
+//                 programs to open (POSIX only)
+//      Socket   - a TCP connection to host:port (POSIX only)
+//
+class ClemensSerialPort {
+  public:
+    enum class Type { Loopback, File, Pty, Socket };
+
+    ClemensSerialPort(Type type, std::string target);
+    ~ClemensSerialPort();
+
+    bool isOpen() const { return isOpen_; }
+    Type getType() const { return type_; }
+    //  The file path, pty device or socket address
+    const std::string &getName() const { return name_; }
+    uint64_t getBytesSent() const { return bytesSent_; }
+    uint64_t getBytesReceived() const { return bytesReceived_; }
+    uint64_t getBytesDropped() const { return bytesDropped_; }
+
+    //  channel is CLEM_SCC_CHANNEL_xxx
+    void transfer(ClemensMMIO &mmio, unsigned channel);
+
+  private:
+    void writeOut(const uint8_t *data, size_t count);
+    void readIn();
+
+    Type type_;
+    std::string name_;
+    bool isOpen_;
+    bool isConnected_;
+    FILE *fp_;
+    int fd_;
+
+    //  guest bytes not yet accepted by the endpoint and endpoint bytes not yet
+    //  accepted by the SCC
+    std::vector<uint8_t> outgoing_;
+    std::vector<uint8_t> incoming_;
+
+    uint64_t bytesSent_;
+    uint64_t bytesReceived_;
+    uint64_t bytesDropped_;
+};
+
+#endif
@@ -13,6 +13,24 @@
 
 namespace ClemensSerializer {
 
+//  Bumped whenever the machine or host layout of a snapshot changes, since a
+//  snapshot of another version can't be read.  Snapshots from before the
+//  version was recorded have none.
+constexpr uint32_t kSnapshotVersion = 2;
+
+//  Reads the start of the snapshot, flagging an error on the reader if the
+//  snapshot isn't of this version
+bool expectVersion(mpack_reader_t *reader) {
+    char key[16];
+    mpack_expect_map(reader);
+    mpack_expect_cstr(reader, key, sizeof(key));
+    if (mpack_reader_error(reader) == mpack_ok &&
+        (strcmp(key, "version") != 0 || mpack_expect_u32(reader) != kSnapshotVersion)) {
+        mpack_reader_flag_error(reader, mpack_error_data);
+    }
+    return mpack_reader_error(reader) == mpack_ok;
+}
+
 void saveBackendDiskDriveState(mpack_writer_t *writer, const ClemensBackendDiskDriveState &state) {
     mpack_write_cstr(writer, "image");
     mpack_write_cstr(writer, state.imagePath.c_str());
@@ -136,6 +154,8 @@ bool save(std::string outputPath, ClemensMachine *machine, ClemensMMIO *mmio, si
     }
 
     mpack_build_map(&writer);
+    mpack_write_cstr(&writer, "version");
+    mpack_write_u32(&writer, kSnapshotVersion);
     mpack_write_cstr(&writer, "machine");
     //  TODO: ROM1 machine ROM version needs to be serialized.. in the clemens
     //        library so remember to do this
@@ -230,7 +250,11 @@ bool load(std::string outputPath, ClemensMachine *machine, ClemensMMIO *mmio, si
     if (mpack_reader_error(&reader) != mpack_ok) {
         return false;
     }
-    mpack_expect_map(&reader);
+    if (!expectVersion(&reader)) {
+        fmt::print("snapshot {} is not of version {}\n", outputPath, kSnapshotVersion);
+        mpack_reader_destroy(&reader);
+        return false;
+    }
     //  "machine"
     mpack_expect_cstr_match(&reader, "machine");
     if (!clemens_unserialize_machine(&reader, machine, alloc_cb, context)) {
@@ -323,8 +347,12 @@ bool load(std::string outputPath, ClemensMachine *machine, ClemensMMIO *mmio, si
     mpack_expect_cstr_match(&reader, "smartport");
     {
         unsigned count = mpack_expect_array(&reader);
-        count = std::min(count, (unsigned)smartPortCount);
         for (size_t driveIndex = 0; driveIndex < count; ++driveIndex) {
+            //  drives this build doesn't have are skipped
+            if (driveIndex >= smartPortCount) {
+                mpack_discard(&reader);
+                continue;
+            }
             if (!loadSmartPortMetadata(&reader, &mmio->active_drives.smartport[driveIndex].device,
                                        smartPortDisks[driveIndex], smartPortStates[driveIndex],
                                        alloc_cb, context)) {
@@ -365,4 +393,14 @@ bool load(std::string outputPath, ClemensMachine *machine, ClemensMMIO *mmio, si
     return (readerError == mpack_ok);
 }
 
+bool isCompatible(const std::string &path) {
+    mpack_reader_t reader;
+    mpack_reader_init_filename(&reader, path.c_str());
+    bool isCompatible = mpack_reader_error(&reader) == mpack_ok && expectVersion(&reader);
+    //  the rest of the snapshot is left unread
+    mpack_reader_flag_error(&reader, mpack_error_data);
+    mpack_reader_destroy(&reader);
+    return isCompatible;
+}
+
 } // namespace ClemensSerializer
@@ -21,6 +21,10 @@ bool load(std::string outputPath, ClemensMachine *machine, ClemensMMIO *mmio, si
           ClemensBackendDiskDriveState *smartPortStates,
           std::vector<ClemensBackendBreakpoint> &breakpoints, ClemensSerializerAllocateCb alloc_cb,
           void *context);
+
+//  Whether the snapshot was saved with the version that load() expects,
+//  checked before any machine state is replaced
+bool isCompatible(const std::string &path);
 } // namespace ClemensSerializer
 
 #endif
@@ -2,7 +2,81 @@
 
 #include "external/mpack.h"
 
+#include <algorithm>
 #include <cassert>
+#include <climits>
+#include <cstring>
+#include <filesystem>
+
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+
+constexpr unsigned kBlockSize = 512;
+//  Blocks are read and written in runs of up to this many contiguous blocks
+constexpr unsigned kIORunBlockCount = 64;
+constexpr unsigned kNoBlock = UINT_MAX;
+constexpr uint32_t kNoSlot = UINT32_MAX;
+
+//  Delta header: magic, version, block size, block count
+//  Records: block index, sequence number, checksum, then the block
+constexpr uint8_t kDeltaMagic[4] = {'C', 'B', 'D', 'L'};
+constexpr uint32_t kDeltaVersion = 2;
+constexpr unsigned kDeltaHeaderSize = 16;
+constexpr unsigned kDeltaRecordHeaderSize = 12;
+constexpr unsigned kDeltaRecordSize = kDeltaRecordHeaderSize + kBlockSize;
+
+//  Modified blocks are written once the disk is left alone for kQuietTime, or
+//  kMaxDelay after the first unwritten change
+constexpr auto kQuietTime = std::chrono::milliseconds(250);
+constexpr auto kMaxDelay = std::chrono::seconds(2);
+//  Failed runs stay dirty and are written again kRetryDelay later, with the
+//  delay doubled per consecutive failure (capped at kRetryDelayLimit.)  The
+//  kWriteFailureLimit-th failure in a row marks the disk as failing.
+constexpr auto kRetryDelay = std::chrono::seconds(1);
+constexpr auto kRetryDelayLimit = std::chrono::seconds(32);
+constexpr unsigned kWriteFailureLimit = 3;
+
+void putU32(uint8_t *data, uint32_t value) {
+    data[0] = uint8_t(value & 0xff);
+    data[1] = uint8_t((value >> 8) & 0xff);
+    data[2] = uint8_t((value >> 16) & 0xff);
+    data[3] = uint8_t((value >> 24) & 0xff);
+}
+
+uint32_t getU32(const uint8_t *data) {
+    return data[0] | (uint32_t(data[1]) << 8) | (uint32_t(data[2]) << 16) |
+           (uint32_t(data[3]) << 24);
+}
+
+//  FNV-1a over the record's block index, sequence number and block
+uint32_t getDeltaRecordChecksum(const uint8_t *recordHeader, const uint8_t *block) {
+    uint32_t hash = 2166136261u;
+    auto hashBytes = [&hash](const uint8_t *data, unsigned size) {
+        for (unsigned index = 0; index < size; ++index) {
+            hash = (hash ^ data[index]) * 16777619u;
+        }
+    };
+    hashBytes(recordHeader, 8);
+    hashBytes(block, kBlockSize);
+    return hash;
+}
+
+bool syncFile(FILE *fp) {
+    if (fflush(fp) != 0)
+        return false;
+#if defined(_WIN32)
+    return _commit(_fileno(fp)) == 0;
+#else
+    return fsync(fileno(fp)) == 0;
+#endif
+}
+
+} // namespace
 
 std::vector<uint8_t> ClemensSmartPortDisk::createData(unsigned block_count) {
     std::vector<uint8_t> data(block_count * 512 + CLEM_2IMG_HEADER_BYTE_SIZE);
@@ -18,77 +92,358 @@ std::vector<uint8_t> ClemensSmartPortDisk::createData(unsigned block_count) {
     return data;
 }
 
-ClemensSmartPortDisk::ClemensSmartPortDisk() : disk_{} {}
+ClemensSmartPortDisk::ClemensSmartPortDisk()
+    : disk_{}, clemensHDD_{}, deltaFile_(nullptr), deltaSlotCount_(0), deltaSequence_(0),
+      ioFile_(nullptr),
+      pendingBlockCount_(0), dirtyBlockCount_(0), demandBlockIndex_(kNoBlock),
+      prefetchBlockIndex_(0), writeBlockIndex_(0), writeFailureCount_(0), isFlushRequested_(false),
+      isWriteFailed_(false), isWriteInFlight_(false), isStopping_(false),
+      isWriteProtected_(false) {}
+
+ClemensSmartPortDisk::~ClemensSmartPortDisk() { close(); }
+
+bool ClemensSmartPortDisk::open(const std::string &pathname, unsigned createBlockCount) {
+    close();
 
-ClemensSmartPortDisk::ClemensSmartPortDisk(ClemensSmartPortDisk &&other)
-    : image_(std::move(other.image_)) {
-    clem_2img_parse_header(&disk_, image_.data(), image_.data() + image_.size());
+    //  only an image that doesn't exist is created - one that can't be opened
+    //  for writing (i.e. a read-only file) is opened write-protected instead
+    std::error_code errc;
+    if (std::filesystem::exists(pathname, errc) || errc) {
+        FILE *fp = fopen(pathname.c_str(), "r+b");
+        if (!fp) {
+            fp = fopen(pathname.c_str(), "rb");
+            if (!fp)
+                return false;
+            isWriteProtected_ = true;
+        }
+        if (!readHeader(fp, pathname)) {
+            fclose(fp);
+            close();
+            return false;
+        }
+        startIO(fp, kBlockMissing);
+    } else {
+        //  the blank blocks are written out by the I/O thread
+        image_ = createData(createBlockCount);
+        if (image_.empty() ||
+            !clem_2img_parse_header(&disk_, image_.data(), image_.data() + image_.size())) {
+            close();
+            return false;
+        }
+        FILE *fp = fopen(pathname.c_str(), "w+b");
+        if (!fp) {
+            close();
+            return false;
+        }
+        if (!writeHeader(fp)) {
+            fclose(fp);
+            close();
+            return false;
+        }
+        startIO(fp, kBlockResident | kBlockDirty);
+    }
+    path_ = pathname;
+    return true;
 }
 
-ClemensSmartPortDisk &ClemensSmartPortDisk::operator=(ClemensSmartPortDisk &&other) {
-    image_ = std::move(other.image_);
-    clem_2img_parse_header(&disk_, image_.data(), image_.data() + image_.size());
-    return *this;
+bool ClemensSmartPortDisk::openOverlay(const std::string &pathname,
+                                       const std::string &deltaPathname) {
+    close();
+
+    FILE *fp = fopen(pathname.c_str(), "rb");
+    if (!fp)
+        return false;
+    if (!readHeader(fp, pathname)) {
+        fclose(fp);
+        close();
+        return false;
+    }
+    //  blocks from an earlier run replace the image's once the I/O thread is
+    //  up, as it only fills in blocks that are still missing
+    std::vector<std::pair<unsigned, uint32_t>> deltaBlocks;
+    std::vector<uint8_t> deltaData;
+    deltaPath_ = deltaPathname;
+    deltaFile_ = fopen(deltaPathname.c_str(), "r+b");
+    bool isValid;
+    if (deltaFile_) {
+        isValid = readDelta(deltaBlocks, deltaData);
+    } else {
+        isValid = createDelta();
+    }
+    if (!isValid) {
+        fclose(fp);
+        close();
+        return false;
+    }
+    deltaSlots_.assign(disk_.block_count, kNoSlot);
+    startIO(fp, kBlockMissing);
+    {
+        std::lock_guard<std::mutex> lock(ioMutex_);
+        for (size_t index = 0; index < deltaBlocks.size(); ++index) {
+            unsigned blockIndex = deltaBlocks[index].first;
+            memcpy(disk_.data + blockIndex * kBlockSize, deltaData.data() + index * kBlockSize,
+                   kBlockSize);
+            if (blockStates_[blockIndex] == kBlockMissing) {
+                --pendingBlockCount_;
+            }
+            blockStates_[blockIndex] = kBlockResident;
+            deltaSlots_[blockIndex] = deltaBlocks[index].second;
+        }
+    }
+    path_ = pathname;
+    return true;
 }
 
-ClemensSmartPortDisk::ClemensSmartPortDisk(std::vector<uint8_t> data)
-    : disk_{}, image_(std::move(data)) {
+bool ClemensSmartPortDisk::openDirectory(const std::string &pathname, bool writeBack) {
+    close();
 
-    clem_2img_parse_header(&disk_, image_.data(), image_.data() + image_.size());
+    if (!volume_.mount(pathname, writeBack))
+        return false;
+    path_ = pathname;
+    return true;
 }
 
-ClemensSmartPortDisk::~ClemensSmartPortDisk() {}
+bool ClemensSmartPortDisk::close() {
+    bool isSaved = true;
+    if (volume_.isMounted()) {
+        isSaved = volume_.unmount();
+    }
+    if (ioThread_.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(ioMutex_);
+            isStopping_ = true;
+            isWriteFailed_ = false;
+        }
+        ioRequested_.notify_one();
+        ioThread_.join();
+        isSaved = dirtyBlockCount_ == 0;
+        if (ioFile_ && fclose(ioFile_) != 0) {
+            isSaved = false;
+        }
+        ioFile_ = nullptr;
+    }
+    if (deltaFile_) {
+        if (fclose(deltaFile_) != 0) {
+            isSaved = false;
+        }
+        deltaFile_ = nullptr;
+    }
+    deltaPath_.clear();
+    deltaSlots_.clear();
+    deltaSlotCount_ = 0;
+    deltaSequence_ = 0;
+    blockStates_.clear();
+    ioBuffer_.clear();
+    pendingBlockCount_ = 0;
+    dirtyBlockCount_ = 0;
+    demandBlockIndex_ = kNoBlock;
+    writeFailureCount_ = 0;
+    isFlushRequested_ = false;
+    isWriteFailed_ = false;
+    isStopping_ = false;
+    isWriteProtected_ = false;
+
+    image_.clear();
+    memset(&disk_, 0, sizeof(disk_));
+    clemensHDD_.block_limit = 0;
+    path_.clear();
+    return isSaved;
+}
+
+bool ClemensSmartPortDisk::flush() {
+    if (volume_.isMounted())
+        return volume_.flush();
+    if (!ioThread_.joinable())
+        return true;
+    std::unique_lock<std::mutex> lock(ioMutex_);
+    isWriteFailed_ = false;
+    isFlushRequested_ = true;
+    ioRequested_.notify_one();
+    ioCompleted_.wait(lock, [this]() {
+        return (dirtyBlockCount_ == 0 && !isWriteInFlight_) || isWriteFailed_;
+    });
+    isFlushRequested_ = false;
+    //  the I/O thread goes back to retrying on its own after a failure
+    ioRequested_.notify_one();
+    return !isWriteFailed_;
+}
+
+bool ClemensSmartPortDisk::isWriteFailing() const {
+    if (!ioThread_.joinable())
+        return false;
+    std::lock_guard<std::mutex> lock(ioMutex_);
+    return writeFailureCount_ >= kWriteFailureLimit;
+}
+
+bool ClemensSmartPortDisk::commit() {
+    if (!isOverlay() || !ioThread_.joinable())
+        return false;
+    //  the whole image is written to a new file that replaces the old one, so
+    //  that a failure part way leaves the image as it was
+    waitForAllBlocks();
+    if (!flush())
+        return false;
+    std::unique_lock<std::mutex> lock(ioMutex_);
+    ioCompleted_.wait(lock, [this]() { return !isWriteInFlight_; });
+    if (std::any_of(blockStates_.begin(), blockStates_.end(),
+                    [](uint8_t blockState) { return blockState & kBlockFailed; }))
+        return false;
+    auto tempPathname = path_ + ".tmp";
+    FILE *fp = fopen(tempPathname.c_str(), "wb");
+    if (!fp)
+        return false;
+    bool isWritten = fwrite(image_.data(), 1, image_.size(), fp) == image_.size();
+    isWritten = syncFile(fp) && isWritten;
+    isWritten = fclose(fp) == 0 && isWritten;
+    std::error_code errc;
+    if (isWritten) {
+        //  all blocks are resident, so the I/O thread won't read the image
+        //  until the file is reopened
+        fclose(ioFile_);
+        std::filesystem::rename(tempPathname, path_, errc);
+        isWritten = !errc;
+        ioFile_ = fopen(path_.c_str(), "rb");
+    }
+    if (!isWritten) {
+        //  a failed commit keeps the delta, so a retry writes the same blocks
+        std::filesystem::remove(tempPathname, errc);
+        return false;
+    }
+    return resetDelta() && ioFile_ != nullptr;
+}
+
+bool ClemensSmartPortDisk::discard() {
+    if (!isOverlay() || !ioThread_.joinable())
+        return false;
+    std::unique_lock<std::mutex> lock(ioMutex_);
+    ioCompleted_.wait(lock, [this]() { return !isWriteInFlight_; });
+    //  the I/O thread reads these blocks from the image again
+    for (unsigned blockIndex = 0; blockIndex < disk_.block_count; ++blockIndex) {
+        uint8_t &blockState = blockStates_[blockIndex];
+        if (deltaSlots_[blockIndex] == kNoSlot && !(blockState & kBlockDirty))
+            continue;
+        if (blockState & kBlockDirty) {
+            --dirtyBlockCount_;
+        }
+        if (blockState != kBlockMissing) {
+            ++pendingBlockCount_;
+        }
+        blockState = kBlockMissing;
+    }
+    prefetchBlockIndex_ = 0;
+    writeFailureCount_ = 0;
+    isWriteFailed_ = false;
+    ioRequested_.notify_one();
+    return resetDelta();
+}
 
 void ClemensSmartPortDisk::write(unsigned block_index, const uint8_t *data) {
+    if (volume_.isMounted()) {
+        volume_.writeBlock(block_index, data);
+        return;
+    }
     if (block_index >= disk_.block_count)
         return;
     if (disk_.format != CLEM_2IMG_FORMAT_PRODOS)
         return;
-
-    memcpy(disk_.data + block_index * 512, data, 512);
+    doWriteBlock(this, 0, block_index, data);
 }
 
 void ClemensSmartPortDisk::read(unsigned block_index, uint8_t *data) {
+    if (volume_.isMounted()) {
+        volume_.readBlock(block_index, data);
+        return;
+    }
     if (block_index >= disk_.block_count)
         return;
     if (disk_.format != CLEM_2IMG_FORMAT_PRODOS)
         return;
-
-    memcpy(data, disk_.data + block_index * 512, 512);
+    if (!ioThread_.joinable()) {
+        memcpy(data, disk_.data + block_index * kBlockSize, kBlockSize);
+        return;
+    }
+    std::unique_lock<std::mutex> lock(ioMutex_);
+    while (!(blockStates_[block_index] & (kBlockResident | kBlockFailed))) {
+        demandBlockIndex_ = block_index;
+        ioRequested_.notify_one();
+        ioCompleted_.wait(lock);
+    }
+    if (blockStates_[block_index] & kBlockResident) {
+        memcpy(data, disk_.data + block_index * kBlockSize, kBlockSize);
+    } else {
+        memset(data, 0, kBlockSize);
+    }
 }
 
 uint8_t ClemensSmartPortDisk::doReadBlock(void *userContext, unsigned /*driveIndex */,
                                           unsigned blockIndex, uint8_t *buffer) {
     auto *self = reinterpret_cast<ClemensSmartPortDisk *>(userContext);
+    if (self->volume_.isMounted())
+        return self->volume_.readBlock(blockIndex, buffer);
     const uint8_t *data_head = self->disk_.data;
     if (blockIndex >= self->disk_.block_count)
         return CLEM_SMARTPORT_STATUS_CODE_INVALID_BLOCK;
-    memcpy(buffer, data_head + blockIndex * 512, 512);
-    return CLEM_SMARTPORT_STATUS_CODE_OK;
+    if (!self->ioThread_.joinable()) {
+        memcpy(buffer, data_head + blockIndex * kBlockSize, kBlockSize);
+        return CLEM_SMARTPORT_STATUS_CODE_OK;
+    }
+    std::lock_guard<std::mutex> lock(self->ioMutex_);
+    uint8_t blockState = self->blockStates_[blockIndex];
+    if (blockState & kBlockResident) {
+        memcpy(buffer, data_head + blockIndex * kBlockSize, kBlockSize);
+        return CLEM_SMARTPORT_STATUS_CODE_OK;
+    }
+    if (blockState & kBlockFailed)
+        return CLEM_SMARTPORT_STATUS_CODE_IO_ERR;
+    //  the bus polls until the I/O thread has read the block
+    if (self->demandBlockIndex_ != blockIndex) {
+        self->demandBlockIndex_ = blockIndex;
+        self->ioRequested_.notify_one();
+    }
+    return CLEM_SMARTPORT_STATUS_CODE_WAIT;
 }
 
 uint8_t ClemensSmartPortDisk::doWriteBlock(void *userContext, unsigned /*driveIndex*/,
                                            unsigned blockIndex, const uint8_t *buffer) {
     auto *self = reinterpret_cast<ClemensSmartPortDisk *>(userContext);
+    if (self->volume_.isMounted())
+        return self->volume_.writeBlock(blockIndex, buffer);
     uint8_t *data_head = self->disk_.data;
     if (blockIndex >= self->disk_.block_count)
         return CLEM_SMARTPORT_STATUS_CODE_INVALID_BLOCK;
-    memcpy(data_head + blockIndex * 512, buffer, 512);
+    if (self->isWriteProtected_)
+        return CLEM_SMARTPORT_STATUS_CODE_NO_WRITE;
+    if (!self->ioThread_.joinable()) {
+        memcpy(data_head + blockIndex * kBlockSize, buffer, kBlockSize);
+        return CLEM_SMARTPORT_STATUS_CODE_OK;
+    }
+    //  the whole block is replaced, so writes never wait on the file
+    std::lock_guard<std::mutex> lock(self->ioMutex_);
+    if (self->writeFailureCount_ >= kWriteFailureLimit)
+        return CLEM_SMARTPORT_STATUS_CODE_IO_ERR;
+    memcpy(data_head + blockIndex * kBlockSize, buffer, kBlockSize);
+    self->markDirty(blockIndex, Clock::now());
     return CLEM_SMARTPORT_STATUS_CODE_OK;
 }
 
-uint8_t ClemensSmartPortDisk::doFlush(void * /*userContext*/, unsigned /*driveIndex*/) {
-    return CLEM_SMARTPORT_STATUS_CODE_OFFLINE;
+uint8_t ClemensSmartPortDisk::doFlush(void *userContext, unsigned /*driveIndex*/) {
+    auto *self = reinterpret_cast<ClemensSmartPortDisk *>(userContext);
+    return self->flush() ? CLEM_SMARTPORT_STATUS_CODE_OK : CLEM_SMARTPORT_STATUS_CODE_IO_ERR;
 }
 
-ClemensSmartPortDevice *
-ClemensSmartPortDisk::createSmartPortDevice(ClemensSmartPortDevice *device) {
-    clemensHDD_.block_limit = disk_.block_count;
+void ClemensSmartPortDisk::initHDD() {
+    clemensHDD_.block_limit =
+        volume_.isMounted() ? volume_.getBlockCount() : disk_.block_count;
     clemensHDD_.drive_index = 0;
     clemensHDD_.user_context = this;
     clemensHDD_.read_block = &ClemensSmartPortDisk::doReadBlock;
     clemensHDD_.write_block = &ClemensSmartPortDisk::doWriteBlock;
     clemensHDD_.flush = &ClemensSmartPortDisk::doFlush;
+}
+
+ClemensSmartPortDevice *
+ClemensSmartPortDisk::createSmartPortDevice(ClemensSmartPortDevice *device) {
+    initHDD();
     clem_smartport_prodos_hdd32_initialize(device, &clemensHDD_);
     return device;
 }
@@ -98,7 +453,332 @@ void ClemensSmartPortDisk::destroySmartPortDevice(ClemensSmartPortDevice *device
     clem_smartport_prodos_hdd32_uninitialize(device);
 }
 
+bool ClemensSmartPortDisk::writeHeader(FILE *fp) {
+    //  the 2IMG header and any chunks outside of the blocks
+    size_t headerSize = size_t(disk_.data - image_.data());
+    size_t trailerSize = size_t(image_.data() + image_.size() - disk_.data_end);
+    if (fseek(fp, 0, SEEK_SET) != 0 || fwrite(image_.data(), 1, headerSize, fp) != headerSize)
+        return false;
+    if (trailerSize > 0) {
+        if (fseek(fp, long(image_.size() - trailerSize), SEEK_SET) != 0 ||
+            fwrite(disk_.data_end, 1, trailerSize, fp) != trailerSize)
+            return false;
+    }
+    return fflush(fp) == 0;
+}
+
+bool ClemensSmartPortDisk::readHeader(FILE *fp, const std::string &pathname) {
+    //  only the header and any chunks outside of the blocks are read now
+    std::error_code errc;
+    auto fileSize = std::filesystem::file_size(pathname, errc);
+    bool isValid = !errc && fileSize >= CLEM_2IMG_HEADER_BYTE_SIZE;
+    if (isValid) {
+        image_.resize(fileSize);
+        isValid = fread(image_.data(), 1, CLEM_2IMG_HEADER_BYTE_SIZE, fp) ==
+                      CLEM_2IMG_HEADER_BYTE_SIZE &&
+                  clem_2img_parse_header(&disk_, image_.data(), image_.data() + image_.size()) &&
+                  disk_.format == CLEM_2IMG_FORMAT_PRODOS;
+    }
+    if (isValid) {
+        size_t headerSize = size_t(disk_.data - image_.data());
+        size_t trailerSize = size_t(image_.data() + image_.size() - disk_.data_end);
+        if (headerSize > CLEM_2IMG_HEADER_BYTE_SIZE) {
+            isValid = fread(image_.data() + CLEM_2IMG_HEADER_BYTE_SIZE, 1,
+                            headerSize - CLEM_2IMG_HEADER_BYTE_SIZE,
+                            fp) == headerSize - CLEM_2IMG_HEADER_BYTE_SIZE;
+        }
+        if (isValid && trailerSize > 0) {
+            isValid = fseek(fp, long(image_.size() - trailerSize), SEEK_SET) == 0 &&
+                      fread(disk_.data_end, 1, trailerSize, fp) == trailerSize;
+        }
+    }
+    return isValid;
+}
+
+bool ClemensSmartPortDisk::createDelta() {
+    uint8_t header[kDeltaHeaderSize];
+    memcpy(header, kDeltaMagic, sizeof(kDeltaMagic));
+    putU32(header + 4, kDeltaVersion);
+    putU32(header + 8, kBlockSize);
+    putU32(header + 12, disk_.block_count);
+    if (!deltaFile_) {
+        deltaFile_ = fopen(deltaPath_.c_str(), "w+b");
+        if (!deltaFile_)
+            return false;
+    }
+    return fwrite(header, 1, sizeof(header), deltaFile_) == sizeof(header) &&
+           syncFile(deltaFile_);
+}
+
+bool ClemensSmartPortDisk::readDelta(std::vector<std::pair<unsigned, uint32_t>> &blocks,
+                                     std::vector<uint8_t> &data) {
+    uint8_t header[kDeltaHeaderSize];
+    if (fread(header, 1, sizeof(header), deltaFile_) != sizeof(header) ||
+        memcmp(header, kDeltaMagic, sizeof(kDeltaMagic)) != 0 ||
+        getU32(header + 4) != kDeltaVersion || getU32(header + 8) != kBlockSize ||
+        getU32(header + 12) != disk_.block_count)
+        return false;
+    //  Records that fail their check (i.e. torn by a crash, or a slot that was
+    //  never written) are skipped, and the newest valid record of a block wins.
+    //  Since a block's writes alternate between the two slots of its pair, the
+    //  record before a torn one is still there.
+    std::vector<uint32_t> blockSequences(disk_.block_count, 0);
+    std::vector<uint32_t> blockEntries(disk_.block_count, kNoSlot);
+    uint8_t record[kDeltaRecordSize];
+    uint32_t slot = 0;
+    for (; fread(record, 1, sizeof(record), deltaFile_) == sizeof(record); ++slot) {
+        unsigned blockIndex = getU32(record);
+        uint32_t sequence = getU32(record + 4);
+        if (blockIndex >= disk_.block_count || sequence == 0 ||
+            getU32(record + 8) != getDeltaRecordChecksum(record, record + kDeltaRecordHeaderSize))
+            continue;
+        deltaSequence_ = std::max(deltaSequence_, sequence);
+        if (sequence <= blockSequences[blockIndex])
+            continue;
+        blockSequences[blockIndex] = sequence;
+        if (blockEntries[blockIndex] == kNoSlot) {
+            blockEntries[blockIndex] = uint32_t(blocks.size());
+            blocks.emplace_back(blockIndex, slot);
+            data.resize(data.size() + kBlockSize);
+        }
+        blocks[blockEntries[blockIndex]].second = slot;
+        memcpy(data.data() + size_t(blockEntries[blockIndex]) * kBlockSize,
+               record + kDeltaRecordHeaderSize, kBlockSize);
+    }
+    //  new pairs go after the pair of the last whole record - a record cut
+    //  short at the end of the file is never valid
+    deltaSlotCount_ = (slot + 1) & ~1u;
+    return !ferror(deltaFile_);
+}
+
+bool ClemensSmartPortDisk::resetDelta() {
+    //  called with the I/O thread idle or locked out
+    if (deltaFile_) {
+        fclose(deltaFile_);
+        deltaFile_ = nullptr;
+    }
+    std::fill(deltaSlots_.begin(), deltaSlots_.end(), kNoSlot);
+    deltaSlotCount_ = 0;
+    deltaSequence_ = 0;
+    return createDelta();
+}
+
+long ClemensSmartPortDisk::getDeltaFileOffset(uint32_t slot) const {
+    return long(kDeltaHeaderSize) + long(slot) * long(kDeltaRecordSize);
+}
+
+void ClemensSmartPortDisk::startIO(FILE *fp, uint8_t blockState) {
+    ioFile_ = fp;
+    blockStates_.assign(disk_.block_count, blockState);
+    ioBuffer_.resize(kIORunBlockCount * kBlockSize);
+    ioSlots_.resize(kIORunBlockCount);
+    pendingBlockCount_ = (blockState & kBlockResident) ? 0 : disk_.block_count;
+    dirtyBlockCount_ = (blockState & kBlockDirty) ? disk_.block_count : 0;
+    demandBlockIndex_ = kNoBlock;
+    prefetchBlockIndex_ = 0;
+    writeBlockIndex_ = 0;
+    isWriteInFlight_ = false;
+    //  blocks that start out dirty are written right away
+    firstWriteTime_ = Clock::time_point();
+    lastWriteTime_ = Clock::time_point();
+    writeFailureCount_ = 0;
+    isFlushRequested_ = false;
+    isWriteFailed_ = false;
+    isStopping_ = false;
+    ioThread_ = std::thread(&ClemensSmartPortDisk::ioMain, this);
+}
+
+void ClemensSmartPortDisk::waitForAllBlocks() const {
+    if (!ioThread_.joinable())
+        return;
+    std::unique_lock<std::mutex> lock(ioMutex_);
+    ioCompleted_.wait(lock, [this]() { return pendingBlockCount_ == 0; });
+}
+
+void ClemensSmartPortDisk::markDirty(unsigned blockIndex, Clock::time_point now) {
+    uint8_t &blockState = blockStates_[blockIndex];
+    if (blockState == kBlockMissing) {
+        --pendingBlockCount_;
+    }
+    if (!(blockState & kBlockDirty)) {
+        if (dirtyBlockCount_++ == 0) {
+            firstWriteTime_ = now;
+            ioRequested_.notify_one();
+        }
+    }
+    blockState = kBlockResident | kBlockDirty;
+    lastWriteTime_ = now;
+}
+
+long ClemensSmartPortDisk::getBlockFileOffset(unsigned blockIndex) const {
+    return long(disk_.data - image_.data()) + long(blockIndex) * kBlockSize;
+}
+
+bool ClemensSmartPortDisk::isWriteDue(Clock::time_point now) const {
+    //  a flush or close stops at the first failure, which is otherwise retried
+    //  once its delay has passed
+    if (isStopping_ || isFlushRequested_)
+        return !isWriteFailed_;
+    if (writeFailureCount_ > 0)
+        return now >= retryTime_;
+    return now - lastWriteTime_ >= kQuietTime || now - firstWriteTime_ >= kMaxDelay;
+}
+
+void ClemensSmartPortDisk::ioMain() {
+    //  Blocks the guest is waiting on come first, then writes that are due and
+    //  finally the prefetch, which runs front to back.  Once stopping, only
+    //  the remaining writes are done.
+    std::unique_lock<std::mutex> lock(ioMutex_);
+    for (;;) {
+        auto now = Clock::now();
+        if (demandBlockIndex_ != kNoBlock && !isStopping_) {
+            if (blockStates_[demandBlockIndex_] == kBlockMissing) {
+                readRun(lock, demandBlockIndex_);
+            } else {
+                demandBlockIndex_ = kNoBlock;
+            }
+        } else if (dirtyBlockCount_ > 0 && isWriteDue(now)) {
+            writeRun(lock);
+        } else if (pendingBlockCount_ > 0 && !isStopping_) {
+            //  missing blocks only come back on a discard(), which rewinds the
+            //  cursor, so it otherwise only moves forward
+            while (blockStates_[prefetchBlockIndex_] != kBlockMissing) {
+                ++prefetchBlockIndex_;
+            }
+            readRun(lock, prefetchBlockIndex_);
+        } else if (isStopping_) {
+            break;
+        } else if (dirtyBlockCount_ > 0 && !isFlushRequested_) {
+            ioRequested_.wait_until(
+                lock, writeFailureCount_ > 0
+                          ? retryTime_
+                          : std::min(lastWriteTime_ + kQuietTime, firstWriteTime_ + kMaxDelay));
+        } else {
+            ioRequested_.wait(lock);
+        }
+    }
+}
+
+void ClemensSmartPortDisk::readRun(std::unique_lock<std::mutex> &lock, unsigned blockIndex) {
+    unsigned blockEnd = blockIndex;
+    while (blockEnd < disk_.block_count && blockEnd - blockIndex < kIORunBlockCount &&
+           blockStates_[blockEnd] == kBlockMissing) {
+        ++blockEnd;
+    }
+    unsigned blockCount = blockEnd - blockIndex;
+    long fileOffset = getBlockFileOffset(blockIndex);
+
+    lock.unlock();
+    size_t readCount = 0;
+    if (ioFile_ && fseek(ioFile_, fileOffset, SEEK_SET) == 0) {
+        readCount = fread(ioBuffer_.data(), kBlockSize, blockCount, ioFile_);
+    }
+    lock.lock();
+
+    for (unsigned index = blockIndex; index < blockEnd; ++index) {
+        //  the guest may have written the block in the meantime
+        if (blockStates_[index] != kBlockMissing)
+            continue;
+        if (index - blockIndex < readCount) {
+            memcpy(disk_.data + index * kBlockSize,
+                   ioBuffer_.data() + (index - blockIndex) * kBlockSize, kBlockSize);
+            blockStates_[index] = kBlockResident;
+        } else {
+            blockStates_[index] = kBlockFailed;
+        }
+        --pendingBlockCount_;
+    }
+    if (demandBlockIndex_ >= blockIndex && demandBlockIndex_ < blockEnd) {
+        demandBlockIndex_ = kNoBlock;
+    }
+    ioCompleted_.notify_all();
+}
+
+void ClemensSmartPortDisk::writeRun(std::unique_lock<std::mutex> &lock) {
+    //  resume the scan where the last run ended so that a block that keeps
+    //  changing can't starve the others
+    unsigned blockIndex = writeBlockIndex_;
+    while (!(blockStates_[blockIndex] & kBlockDirty)) {
+        blockIndex = (blockIndex + 1) % disk_.block_count;
+    }
+    bool isOverlay = !deltaPath_.empty();
+    unsigned blockEnd = blockIndex;
+    while (blockEnd < disk_.block_count && blockEnd - blockIndex < kIORunBlockCount &&
+           (blockStates_[blockEnd] & kBlockDirty)) {
+        memcpy(ioBuffer_.data() + (blockEnd - blockIndex) * kBlockSize,
+               disk_.data + blockEnd * kBlockSize, kBlockSize);
+        blockStates_[blockEnd] &= ~kBlockDirty;
+        if (isOverlay) {
+            //  a block gets a pair of slots the first time it's written, and
+            //  each write goes to the slot that doesn't hold its last record
+            if (deltaSlots_[blockEnd] == kNoSlot) {
+                deltaSlots_[blockEnd] = deltaSlotCount_ + 1;
+                deltaSlotCount_ += 2;
+            }
+            ioSlots_[blockEnd - blockIndex] = deltaSlots_[blockEnd] ^ 1;
+        }
+        ++blockEnd;
+    }
+    unsigned blockCount = blockEnd - blockIndex;
+    long fileOffset = getBlockFileOffset(blockIndex);
+    uint32_t sequence = deltaSequence_;
+    if (isOverlay) {
+        deltaSequence_ += blockCount;
+    }
+    dirtyBlockCount_ -= blockCount;
+    writeBlockIndex_ = blockEnd % disk_.block_count;
+    isWriteInFlight_ = true;
+
+    lock.unlock();
+    bool isWritten;
+    if (isOverlay) {
+        isWritten = deltaFile_ != nullptr;
+        for (unsigned index = 0; isWritten && index < blockCount; ++index) {
+            const uint8_t *block = ioBuffer_.data() + index * kBlockSize;
+            uint8_t recordHeader[kDeltaRecordHeaderSize];
+            putU32(recordHeader, blockIndex + index);
+            putU32(recordHeader + 4, ++sequence);
+            putU32(recordHeader + 8, getDeltaRecordChecksum(recordHeader, block));
+            isWritten = fseek(deltaFile_, getDeltaFileOffset(ioSlots_[index]), SEEK_SET) == 0 &&
+                        fwrite(recordHeader, 1, sizeof(recordHeader), deltaFile_) ==
+                            sizeof(recordHeader) &&
+                        fwrite(block, kBlockSize, 1, deltaFile_) == 1;
+        }
+        isWritten = isWritten && fflush(deltaFile_) == 0;
+    } else {
+        isWritten = fseek(ioFile_, fileOffset, SEEK_SET) == 0 &&
+                    fwrite(ioBuffer_.data(), kBlockSize, blockCount, ioFile_) == blockCount &&
+                    fflush(ioFile_) == 0;
+    }
+    lock.lock();
+    isWriteInFlight_ = false;
+
+    if (isWritten) {
+        if (isOverlay) {
+            for (unsigned index = blockIndex; index < blockEnd; ++index) {
+                deltaSlots_[index] = ioSlots_[index - blockIndex];
+            }
+        }
+        writeFailureCount_ = 0;
+    } else {
+        for (unsigned index = blockIndex; index < blockEnd; ++index) {
+            if (!(blockStates_[index] & kBlockDirty)) {
+                blockStates_[index] |= kBlockDirty;
+                ++dirtyBlockCount_;
+            }
+        }
+        auto retryDelay = kRetryDelay * (1 << std::min(writeFailureCount_, 5u));
+        retryTime_ = Clock::now() + std::min<Clock::duration>(retryDelay, kRetryDelayLimit);
+        ++writeFailureCount_;
+        isWriteFailed_ = true;
+    }
+    //  flush() and discard() also wait for the write to finish
+    ioCompleted_.notify_all();
+}
+
 void ClemensSmartPortDisk::serialize(mpack_writer_t *writer, ClemensSmartPortDevice *device) const {
+    waitForAllBlocks();
+
     mpack_build_map(writer);
 
     mpack_write_cstr(writer, "path");
@@ -126,6 +806,40 @@ void ClemensSmartPortDisk::serialize(mpack_writer_t *writer, ClemensSmartPortDev
         }
         mpack_finish_array(writer);
     }
+
+    mpack_write_cstr(writer, "volume");
+    if (volume_.isMounted()) {
+        volume_.serialize(writer);
+    } else {
+        mpack_write_nil(writer);
+    }
+
+    //  blocks that differ from the image, so a restored overlay writes only
+    //  those to its delta
+    mpack_write_cstr(writer, "overlay");
+    if (isOverlay()) {
+        std::vector<unsigned> deltaBlocks;
+        {
+            std::lock_guard<std::mutex> lock(ioMutex_);
+            for (unsigned blockIndex = 0; blockIndex < disk_.block_count; ++blockIndex) {
+                if (deltaSlots_[blockIndex] != kNoSlot || (blockStates_[blockIndex] & kBlockDirty)) {
+                    deltaBlocks.push_back(blockIndex);
+                }
+            }
+        }
+        mpack_build_map(writer);
+        mpack_write_cstr(writer, "path");
+        mpack_write_cstr(writer, deltaPath_.c_str());
+        mpack_write_cstr(writer, "blocks");
+        mpack_start_array(writer, unsigned(deltaBlocks.size()));
+        for (unsigned blockIndex : deltaBlocks) {
+            mpack_write_uint(writer, blockIndex);
+        }
+        mpack_finish_array(writer);
+        mpack_complete_map(writer);
+    } else {
+        mpack_write_nil(writer);
+    }
     mpack_complete_map(writer);
 }
 
@@ -133,32 +847,111 @@ void ClemensSmartPortDisk::unserialize(mpack_reader_t *reader, ClemensSmartPortD
                                        ClemensSerializerAllocateCb alloc_cb, void *context) {
     char path[1024];
 
-    mpack_expect_map(reader);
-    mpack_expect_cstr_match(reader, "path");
-    mpack_expect_cstr(reader, path, sizeof(path));
-    path_ = path;
-    mpack_expect_cstr_match(reader, "impl");
-    if (mpack_peek_tag(reader).type == mpack_type_nil) {
-        mpack_expect_nil(reader);
-    } else {
-        clem_smartport_prodos_hdd32_unserialize(reader, device, &clemensHDD_, alloc_cb, context);
-    }
-    mpack_expect_cstr_match(reader, "pages");
-    {
-        unsigned pageCount = mpack_expect_array(reader);
-        image_.clear();
-        image_.reserve(pageCount * 4096);
-        while (pageCount > 0) {
-            unsigned byteCount = mpack_expect_bin(reader);
-            unsigned byteOffset = (unsigned)image_.size();
-            image_.resize(byteOffset + byteCount);
-            mpack_read_bytes(reader, (char *)image_.data() + byteOffset, byteCount);
-            mpack_done_bin(reader);
-            pageCount--;
-        }
-        mpack_done_array(reader);
+    //  pending writes go to the current image before it's replaced
+    close();
+
+    //  keys are matched by name, so that ones missing from an older snapshot
+    //  are taken as nil
+    bool hasDevice = false;
+    bool isVolume = false;
+    std::string deltaPath;
+    std::vector<unsigned> deltaBlocks;
+    image_.clear();
+    unsigned keyCount = mpack_expect_map(reader);
+    for (unsigned keyIndex = 0; keyIndex < keyCount; ++keyIndex) {
+        char key[16];
+        mpack_expect_cstr(reader, key, sizeof(key));
+        if (mpack_reader_error(reader) != mpack_ok)
+            break;
+        if (mpack_peek_tag(reader).type == mpack_type_nil) {
+            mpack_expect_nil(reader);
+        } else if (!strcmp(key, "path")) {
+            mpack_expect_cstr(reader, path, sizeof(path));
+            path_ = path;
+        } else if (!strcmp(key, "impl")) {
+            hasDevice = clem_smartport_prodos_hdd32_unserialize(reader, device, &clemensHDD_,
+                                                                alloc_cb, context);
+        } else if (!strcmp(key, "pages")) {
+            unsigned pageCount = mpack_expect_array(reader);
+            image_.reserve(pageCount * 4096);
+            while (pageCount > 0) {
+                unsigned byteCount = mpack_expect_bin(reader);
+                unsigned byteOffset = (unsigned)image_.size();
+                image_.resize(byteOffset + byteCount);
+                mpack_read_bytes(reader, (char *)image_.data() + byteOffset, byteCount);
+                mpack_done_bin(reader);
+                pageCount--;
+            }
+            mpack_done_array(reader);
+        } else if (!strcmp(key, "volume")) {
+            isVolume = volume_.unserialize(reader);
+        } else if (!strcmp(key, "overlay")) {
+            mpack_expect_map(reader);
+            mpack_expect_cstr_match(reader, "path");
+            mpack_expect_cstr(reader, path, sizeof(path));
+            deltaPath = path;
+            mpack_expect_cstr_match(reader, "blocks");
+            unsigned blockCount = mpack_expect_array(reader);
+            for (unsigned index = 0; index < blockCount; ++index) {
+                deltaBlocks.push_back(mpack_expect_u32(reader));
+            }
+            mpack_done_array(reader);
+            mpack_done_map(reader);
+        } else {
+            mpack_discard(reader);
+        }
     }
     mpack_done_map(reader);
     memset(&disk_, 0, sizeof(disk_));
-    clem_2img_parse_header(&disk_, image_.data(), image_.data() + image_.size());
+    if (!isVolume &&
+        !clem_2img_parse_header(&disk_, image_.data(), image_.data() + image_.size()))
+        return;
+    if (hasDevice) {
+        //  the callbacks aren't part of the snapshot
+        unsigned currentBlockIndex = clemensHDD_.current_block_index;
+        initHDD();
+        clem_smartport_prodos_hdd32_initialize(device, &clemensHDD_);
+        clemensHDD_.current_block_index = currentBlockIndex;
+    }
+    if (isVolume || path_.empty())
+        return;
+    if (!deltaPath.empty()) {
+        //  the image is left alone, and the delta is rebuilt from the snapshot
+        FILE *fp = fopen(path_.c_str(), "rb");
+        if (!fp)
+            return;
+        deltaPath_ = deltaPath;
+        if (!createDelta()) {
+            fclose(fp);
+            deltaPath_.clear();
+            return;
+        }
+        deltaSlots_.assign(disk_.block_count, kNoSlot);
+        startIO(fp, kBlockResident);
+        std::lock_guard<std::mutex> lock(ioMutex_);
+        auto now = Clock::now();
+        for (unsigned blockIndex : deltaBlocks) {
+            if (blockIndex < disk_.block_count) {
+                markDirty(blockIndex, now);
+            }
+        }
+        return;
+    }
+    //  the image file is brought in line with the snapshot in the background,
+    //  though one that exists but can't be written to is left alone and the
+    //  disk works from memory
+    std::error_code errc;
+    FILE *fp = nullptr;
+    if (std::filesystem::exists(path_, errc) || errc) {
+        fp = fopen(path_.c_str(), "r+b");
+    } else {
+        fp = fopen(path_.c_str(), "w+b");
+    }
+    if (!fp)
+        return;
+    if (!writeHeader(fp)) {
+        fclose(fp);
+        return;
+    }
+    startIO(fp, kBlockResident | kBlockDirty);
 }
@@ -2,23 +2,91 @@
 #define CLEM_HOST_SMARTPORT_DISK_HPP
 
 #include "clem_2img.h"
+#include "clem_prodos_volume.hpp"
 #include "smartport/prodos_hdd32.h"
 
+#include <chrono>
+#include <condition_variable>
 #include <cstdint>
+#include <cstdio>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <utility>
 #include <vector>
 
+//  A ProDOS block device backed by a 2IMG file.
+//
+//  Each open disk has an I/O thread that streams the image into memory and
+//  writes modified blocks back to the file, so the emulator thread never
+//  touches the file.  Blocks the guest reads before the prefetch reaches them
+//  are fetched ahead of the prefetch, and the SmartPort bus waits only on
+//  those.  Writes land in memory and reach the file once the guest has left
+//  the disk alone for a moment (or after a bounded delay), in runs of
+//  contiguous blocks.  A write that fails is retried after a growing delay,
+//  and once it has failed a few times in a row the disk reports it (see
+//  isWriteFailing()) and refuses the guest's writes until one succeeds.
+//
+//  A disk that isn't backed by a file (i.e. a snapshot's disk whose image file
+//  can't be opened) works entirely from memory.
+//
+//  In overlay mode the image is only read, so that many machines can share
+//  it, and written blocks go to a delta file instead.  The delta holds a pair
+//  of record slots per written block, added the first time the block is
+//  written, that its writes alternate between.  Records are checksummed and
+//  numbered, so one torn by a crash is skipped for the one before it.
+//  Opening the image again with the same delta picks up where the last run
+//  left off.
+//
+//  A disk can instead be a host directory presented as a ProDOS volume (see
+//  ClemensProDOSHostVolume), which needs no I/O thread since its blocks are
+//  generated or read from single host files on demand.
+//
 class ClemensSmartPortDisk {
   public:
+    using Clock = std::chrono::steady_clock;
+
     static std::vector<uint8_t> createData(unsigned block_count);
 
     ClemensSmartPortDisk();
-    ClemensSmartPortDisk(std::vector<uint8_t> data);
-    ClemensSmartPortDisk(ClemensSmartPortDisk &&other);
     ~ClemensSmartPortDisk();
 
-    ClemensSmartPortDisk &operator=(ClemensSmartPortDisk &&other);
+    ClemensSmartPortDisk(const ClemensSmartPortDisk &) = delete;
+    ClemensSmartPortDisk &operator=(const ClemensSmartPortDisk &) = delete;
+
+    //  Opens the image at pathname, creating a blank one with createBlockCount
+    //  blocks if the file doesn't exist.  An image that can't be written to is
+    //  opened write-protected.  Only the header is read here.
+    bool open(const std::string &pathname, unsigned createBlockCount);
+    //  Opens an existing image read-only, with written blocks going to the delta
+    //  at deltaPathname (created if missing)
+    bool openOverlay(const std::string &pathname, const std::string &deltaPathname);
+    //  Overlay mode only - replaces the image with a copy that has the delta's
+    //  blocks written in, and empties the delta
+    bool commit();
+    //  Overlay mode only - empties the delta, so that the image's blocks are
+    //  read again.  The guest sees its changes disappear.
+    bool discard();
+    //  Mounts a host directory as a volume, writing changes back into it if
+    //  writeBack is set
+    bool openDirectory(const std::string &pathname, bool writeBack);
+    //  Writes back modified blocks and closes the file.  Returns false if any
+    //  of them could not be written.
+    bool close();
+    //  Blocks until modified blocks are written.  Returns false on a write error.
+    bool flush();
+    //  Whether writes to the file have kept failing, in which case the guest's
+    //  writes are refused until a retry succeeds
+    bool isWriteFailing() const;
+
+    bool isOpen() const { return ioThread_.joinable() || volume_.isMounted(); }
+    bool isDirectory() const { return volume_.isMounted(); }
+    bool isOverlay() const { return !deltaPath_.empty(); }
+    //  The guest's writes are refused with a write-protect error
+    bool isWriteProtected() const { return isWriteProtected_; }
+    const std::string &getPathname() const { return path_; }
 
+    //  These wait for the block if it hasn't been read from the file yet
     void write(unsigned block_index, const uint8_t *data);
     void read(unsigned block_index, uint8_t *data);
 
@@ -30,6 +98,7 @@ class ClemensSmartPortDisk {
     ClemensSmartPortDevice *createSmartPortDevice(ClemensSmartPortDevice *device);
     void destroySmartPortDevice(ClemensSmartPortDevice *device);
 
+    //  Snapshots hold the whole image, so saving one waits for the prefetch
     void serialize(mpack_writer_t *writer, ClemensSmartPortDevice *device) const;
     void unserialize(mpack_reader_t *reader, ClemensSmartPortDevice *device,
                      ClemensSerializerAllocateCb alloc_cb, void *context);
@@ -42,11 +111,68 @@ class ClemensSmartPortDisk {
                                 const uint8_t *buffer);
     static uint8_t doFlush(void *userCcontext, unsigned driveIndex);
 
+    void initHDD();
+
+    //  Block states - reads wait until a block is resident.  Dirty blocks
+    //  are also resident.
+    enum : uint8_t { kBlockMissing = 0, kBlockResident = 1, kBlockDirty = 2, kBlockFailed = 4 };
+
+    bool readHeader(FILE *fp, const std::string &pathname);
+    bool writeHeader(FILE *fp);
+    bool createDelta();
+    bool readDelta(std::vector<std::pair<unsigned, uint32_t>> &blocks, std::vector<uint8_t> &data);
+    bool resetDelta();
+    long getDeltaFileOffset(uint32_t slot) const;
+    void startIO(FILE *fp, uint8_t blockState);
+    void waitForAllBlocks() const;
+    void markDirty(unsigned blockIndex, Clock::time_point now);
+    long getBlockFileOffset(unsigned blockIndex) const;
+
+    void ioMain();
+    void readRun(std::unique_lock<std::mutex> &lock, unsigned blockIndex);
+    void writeRun(std::unique_lock<std::mutex> &lock);
+    bool isWriteDue(Clock::time_point now) const;
+
   private:
     Clemens2IMGDisk disk_;
     std::string path_;
     std::vector<uint8_t> image_;
     ClemensProdosHDD32 clemensHDD_;
+    ClemensProDOSHostVolume volume_;
+
+    //  Overlay mode - the slot of each block's last record in the delta file,
+    //  which the I/O thread assigns under ioMutex_
+    std::string deltaPath_;
+    FILE *deltaFile_;
+    std::vector<uint32_t> deltaSlots_;
+    uint32_t deltaSlotCount_;
+    uint32_t deltaSequence_;
+
+    //  All members below are guarded by ioMutex_ while the I/O thread runs,
+    //  except for image_ blocks which the I/O thread only fills while missing
+    //  and only reads while dirty.
+    FILE *ioFile_;
+    std::thread ioThread_;
+    mutable std::mutex ioMutex_;
+    std::condition_variable ioRequested_;
+    mutable std::condition_variable ioCompleted_;
+    std::vector<uint8_t> blockStates_;
+    std::vector<uint8_t> ioBuffer_;
+    std::vector<uint32_t> ioSlots_;
+    unsigned pendingBlockCount_;
+    unsigned dirtyBlockCount_;
+    unsigned demandBlockIndex_;
+    unsigned prefetchBlockIndex_;
+    unsigned writeBlockIndex_;
+    unsigned writeFailureCount_;
+    Clock::time_point firstWriteTime_;
+    Clock::time_point lastWriteTime_;
+    Clock::time_point retryTime_;
+    bool isFlushRequested_;
+    bool isWriteFailed_;
+    bool isWriteInFlight_;
+    bool isStopping_;
+    bool isWriteProtected_;
 };
 
 #endif
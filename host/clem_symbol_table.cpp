@@ -0,0 +1,269 @@
+#include "clem_symbol_table.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <numeric>
+
+namespace {
+
+constexpr uint32_t kAddressLimit = 0x1000000;
+//  Merlin prints several symbols to a line
+constexpr size_t kLineTokenLimit = 32;
+
+bool parseHex(std::string_view text, uint32_t &value) {
+    if (text.empty())
+        return false;
+    auto result = std::from_chars(text.data(), text.data() + text.size(), value, 16);
+    return result.ec == std::errc{} && result.ptr == text.data() + text.size();
+}
+
+//  $2000, 0x2000, 002000, 00/2000 or 00:2000
+bool parseAddress(std::string_view text, uint32_t &address) {
+    if (!text.empty() && text[0] == '$') {
+        text.remove_prefix(1);
+    } else if (text.size() > 2 && text[0] == '0' && (text[1] == 'x' || text[1] == 'X')) {
+        text.remove_prefix(2);
+    }
+    auto sepPos = text.find_first_of("/:");
+    if (sepPos != std::string_view::npos) {
+        uint32_t bank, offset;
+        if (sepPos > 2 || text.size() - sepPos - 1 > 4 || !parseHex(text.substr(0, sepPos), bank) ||
+            !parseHex(text.substr(sepPos + 1), offset))
+            return false;
+        address = (bank << 16) | offset;
+        return true;
+    }
+    return text.size() <= 6 && parseHex(text, address);
+}
+
+bool isSymbolName(std::string_view name) {
+    if (name.empty() || std::isdigit(static_cast<unsigned char>(name[0])))
+        return false;
+    return std::all_of(name.begin(), name.end(), [](char c) {
+        return std::isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '.' || c == '@' ||
+               c == ':';
+    });
+}
+
+size_t splitTokens(std::string_view line, std::array<std::string_view, kLineTokenLimit> &tokens) {
+    size_t count = 0;
+    size_t pos = 0;
+    while (count < tokens.size()) {
+        pos = line.find_first_not_of(" \t\r", pos);
+        if (pos == std::string_view::npos)
+            break;
+        auto endPos = line.find_first_of(" \t\r", pos);
+        tokens[count++] = line.substr(pos, endPos - pos);
+        if (endPos == std::string_view::npos)
+            break;
+        pos = endPos;
+    }
+    return count;
+}
+
+//  The value of key=value in an ld65 debug info line
+std::string_view findDebugInfoField(std::string_view line, std::string_view key) {
+    size_t pos = 0;
+    while ((pos = line.find(key, pos)) != std::string_view::npos) {
+        bool isFieldStart = pos == 0 || line[pos - 1] == ',' || line[pos - 1] == '\t' ||
+                            line[pos - 1] == ' ';
+        pos += key.size();
+        if (!isFieldStart || pos >= line.size() || line[pos] != '=')
+            continue;
+        ++pos;
+        if (pos < line.size() && line[pos] == '"') {
+            auto endPos = line.find('"', pos + 1);
+            if (endPos == std::string_view::npos)
+                return std::string_view();
+            return line.substr(pos + 1, endPos - pos - 1);
+        }
+        return line.substr(pos, line.find(',', pos) - pos);
+    }
+    return std::string_view();
+}
+
+} // namespace
+
+bool ClemensSymbolTable::load(const std::string &pathname) {
+    std::ifstream input(pathname, std::ios_base::in | std::ios_base::binary);
+    if (!input.is_open())
+        return false;
+    std::string text((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+    if (input.bad())
+        return false;
+    parse(text);
+    return true;
+}
+
+unsigned ClemensSymbolTable::parse(std::string_view text) {
+    size_t oldCount = symbols_.size();
+    std::array<std::string_view, kLineTokenLimit> tokens;
+    uint32_t address;
+    while (!text.empty()) {
+        auto endPos = text.find('\n');
+        auto line = text.substr(0, endPos);
+        text = endPos != std::string_view::npos ? text.substr(endPos + 1) : std::string_view();
+
+        size_t tokenCount = splitTokens(line, tokens);
+        if (tokenCount < 2 || tokens[0][0] == ';' || tokens[0][0] == '#' || tokens[0][0] == '*')
+            continue;
+        if (tokens[0] == "sym") {
+            //  ld65 debug info.  Imports have no value, and equates are
+            //  constants rather than addresses.
+            auto name = findDebugInfoField(line, "name");
+            auto value = findDebugInfoField(line, "val");
+            if (findDebugInfoField(line, "type") == "equ" || !isSymbolName(name) ||
+                !parseAddress(value, address))
+                continue;
+            add(name, address);
+            continue;
+        }
+        if (tokens[0] == "al") {
+            //  VICE labels, as written by ld65 -Ln
+            if (tokenCount < 3 || !parseAddress(tokens[1], address))
+                continue;
+            auto name = tokens[2];
+            if (!name.empty() && name[0] == '.') {
+                name.remove_prefix(1);
+            }
+            if (isSymbolName(name)) {
+                add(name, address);
+            }
+            continue;
+        }
+        bool isMerlinTable = false;
+        for (size_t index = 1; index < tokenCount; ++index) {
+            //  NAME =$2000, NAME = $2000 or NAME EQU $2000
+            auto value = tokens[index];
+            if (value[0] != '=' && value != "EQU" && value != "equ")
+                continue;
+            isMerlinTable = true;
+            auto name = tokens[index - 1];
+            if (value.size() == 1 || value[0] != '=') {
+                if (index + 1 >= tokenCount)
+                    break;
+                value = tokens[++index];
+            } else {
+                value.remove_prefix(1);
+            }
+            //  '?' marks a symbol that was never referenced
+            if (!name.empty() && name[0] == '?') {
+                name.remove_prefix(1);
+            }
+            //  ']' names are variables, which are reassigned throughout a source
+            if (name.empty() || name[0] == ']' || !isSymbolName(name) ||
+                !parseAddress(value, address))
+                continue;
+            add(name, address);
+        }
+        if (isMerlinTable)
+            continue;
+        if (parseAddress(tokens[0], address) && isSymbolName(tokens[1])) {
+            add(tokens[1], address);
+        }
+    }
+    sort();
+    return unsigned(symbols_.size() - oldCount);
+}
+
+void ClemensSymbolTable::clear() {
+    symbols_.clear();
+    nameIndex_.clear();
+    names_.clear();
+    cacheBegin_ = cacheEnd_ = cacheIndex_ = 0;
+}
+
+void ClemensSymbolTable::add(std::string_view name, uint32_t address) {
+    if (address >= kAddressLimit)
+        return;
+    symbols_.push_back(Entry{address, uint32_t(names_.size())});
+    names_.append(name);
+    names_.push_back('\0');
+}
+
+void ClemensSymbolTable::sort() {
+    //  symbols at the same address stay in the order loaded so that lookups
+    //  show the first of them
+    std::stable_sort(symbols_.begin(), symbols_.end(),
+                     [](const Entry &a, const Entry &b) { return a.address < b.address; });
+    //  drop repeats (i.e. the same file loaded twice)
+    auto last = symbols_.begin();
+    for (auto it = symbols_.begin(); it != symbols_.end(); ++it) {
+        bool isRepeat = false;
+        for (auto runIt = last; runIt != symbols_.begin();) {
+            --runIt;
+            if (runIt->address != it->address)
+                break;
+            if (!strcmp(getName(*runIt), getName(*it))) {
+                isRepeat = true;
+                break;
+            }
+        }
+        if (!isRepeat) {
+            *last++ = *it;
+        }
+    }
+    symbols_.erase(last, symbols_.end());
+
+    nameIndex_.resize(symbols_.size());
+    std::iota(nameIndex_.begin(), nameIndex_.end(), 0);
+    std::stable_sort(nameIndex_.begin(), nameIndex_.end(), [this](uint32_t a, uint32_t b) {
+        return strcmp(getName(symbols_[a]), getName(symbols_[b])) < 0;
+    });
+    cacheBegin_ = cacheEnd_ = cacheIndex_ = 0;
+}
+
+std::optional<uint32_t> ClemensSymbolTable::findAddress(std::string_view name) const {
+    auto it = std::lower_bound(nameIndex_.begin(), nameIndex_.end(), name,
+                               [this](uint32_t index, std::string_view name) {
+                                   return std::string_view(getName(symbols_[index])) < name;
+                               });
+    if (it == nameIndex_.end() || getName(symbols_[*it]) != name)
+        return std::nullopt;
+    return symbols_[*it].address;
+}
+
+bool ClemensSymbolTable::lookup(uint32_t address, Symbol &symbol) const {
+    address &= kAddressLimit - 1;
+    if (address < cacheBegin_ || address >= cacheEnd_) {
+        auto nextIt = std::upper_bound(
+            symbols_.begin(), symbols_.end(), address,
+            [](uint32_t address, const Entry &entry) { return address < entry.address; });
+        cacheEnd_ = nextIt != symbols_.end() ? nextIt->address : kAddressLimit;
+        if (nextIt == symbols_.begin()) {
+            cacheBegin_ = 0;
+            cacheIndex_ = uint32_t(symbols_.size());
+        } else {
+            cacheBegin_ = (nextIt - 1)->address;
+            auto firstIt = std::lower_bound(
+                symbols_.begin(), nextIt, cacheBegin_,
+                [](const Entry &entry, uint32_t address) { return entry.address < address; });
+            cacheIndex_ = uint32_t(firstIt - symbols_.begin());
+        }
+    }
+    if (cacheIndex_ >= symbols_.size())
+        return false;
+    const Entry &entry = symbols_[cacheIndex_];
+    if ((entry.address >> 16) != (address >> 16))
+        return false;
+    symbol.name = getName(entry);
+    symbol.offset = address - entry.address;
+    return true;
+}
+
+size_t ClemensSymbolTable::format(char *out, size_t outSize, uint32_t address) const {
+    Symbol symbol;
+    if (outSize == 0 || !lookup(address, symbol))
+        return 0;
+    int length = symbol.offset ? snprintf(out, outSize, "%s+$%X", symbol.name, symbol.offset)
+                               : snprintf(out, outSize, "%s", symbol.name);
+    if (length < 0)
+        return 0;
+    return std::min(size_t(length), outSize - 1);
+}
@@ -0,0 +1,73 @@
+#ifndef CLEM_HOST_SYMBOL_TABLE_HPP
+#define CLEM_HOST_SYMBOL_TABLE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+//  Names for guest addresses, loaded from assembler and linker output.
+//
+//  Files are read line by line, and each line may be in any of:
+//      ld65 debug info (--dbgfile)     sym id=0,name="main",...,val=0x2000,type=lab
+//      ld65 / VICE labels (-Ln)        al 002000 .main
+//      Merlin symbol tables            MAIN =$2000    LOOP =$2010
+//      plain text                      002000 main  (or $00/2000, 00:2000)
+//  Lines that aren't symbols are skipped, as are ld65 equates and Merlin
+//  variables, which aren't addresses.
+//
+//  Symbols are kept in one array sorted by address, eight bytes each, with the
+//  names packed into a single buffer.  Lookups by address are a binary search
+//  that is skipped when the address falls within the last symbol found, which
+//  is nearly always true for consecutive instructions.  That cache means a
+//  table shouldn't be shared between threads; each should load its own.
+//
+class ClemensSymbolTable {
+  public:
+    struct Symbol {
+        const char *name;
+        uint32_t offset; //  from the symbol's address
+    };
+
+    //  Adds the symbols in the file, returning false if it couldn't be read
+    bool load(const std::string &pathname);
+    //  Adds the symbols in text, returning how many were found
+    unsigned parse(std::string_view text);
+    void clear();
+
+    size_t size() const { return symbols_.size(); }
+    bool empty() const { return symbols_.empty(); }
+
+    //  The address of the named symbol (case sensitive)
+    std::optional<uint32_t> findAddress(std::string_view name) const;
+    //  The nearest symbol at or before the address in the same bank
+    bool lookup(uint32_t address, Symbol &symbol) const;
+    //  Writes "name" or "name+$offset" to out, returning the length written (0
+    //  if there is no symbol for the address)
+    size_t format(char *out, size_t outSize, uint32_t address) const;
+
+  private:
+    struct Entry {
+        uint32_t address;
+        uint32_t nameOffset;
+    };
+
+    void add(std::string_view name, uint32_t address);
+    void sort();
+    const char *getName(const Entry &entry) const { return names_.data() + entry.nameOffset; }
+
+    std::vector<Entry> symbols_;
+    //  indices into symbols_ sorted by name
+    std::vector<uint32_t> nameIndex_;
+    std::string names_;
+
+    //  the address range [cacheBegin_, cacheEnd_) maps to symbol cacheIndex_
+    //  (or to none if it is past the end)
+    mutable uint32_t cacheBegin_ = 0;
+    mutable uint32_t cacheEnd_ = 0;
+    mutable uint32_t cacheIndex_ = 0;
+};
+
+#endif
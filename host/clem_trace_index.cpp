@@ -0,0 +1,441 @@
+#include "clem_trace_index.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+
+namespace {
+
+constexpr uint64_t kCheckpointInterval = 4096;
+constexpr size_t kRecordBufferSize = 64 * 1024;
+constexpr size_t kRecordSizeLimit = 64;
+//  one sparse index entry per block of postings within a run file
+constexpr uint64_t kSparseStride = 256;
+constexpr size_t kMergeBufferCount = 64 * 1024;
+
+//  postings are (key << kSeqBits) | seq so that sorting orders them by key and
+//  then chronologically
+constexpr unsigned kSeqBits = 40;
+constexpr uint64_t kSeqMask = (uint64_t(1) << kSeqBits) - 1;
+constexpr uint32_t kKeyLimit = 1 << 24;
+
+//  record mask bits for registers that changed since the previous record
+enum {
+    kRecordA = 1 << 0,
+    kRecordX = 1 << 1,
+    kRecordY = 1 << 2,
+    kRecordD = 1 << 3,
+    kRecordS = 1 << 4,
+    kRecordP = 1 << 5,
+    kRecordDBR = 1 << 6,
+    kRecordEmulation = 1 << 7
+};
+
+uint8_t *putU16(uint8_t *out, uint16_t v) {
+    out[0] = uint8_t(v & 0xff);
+    out[1] = uint8_t(v >> 8);
+    return out + 2;
+}
+
+uint8_t *putU24(uint8_t *out, uint32_t v) {
+    out[0] = uint8_t(v & 0xff);
+    out[1] = uint8_t((v >> 8) & 0xff);
+    out[2] = uint8_t((v >> 16) & 0xff);
+    return out + 3;
+}
+
+uint16_t getU16(const uint8_t *&in) {
+    uint16_t v = uint16_t(in[0]) | (uint16_t(in[1]) << 8);
+    in += 2;
+    return v;
+}
+
+uint32_t getU24(const uint8_t *&in) {
+    uint32_t v = uint32_t(in[0]) | (uint32_t(in[1]) << 8) | (uint32_t(in[2]) << 16);
+    in += 3;
+    return v;
+}
+
+//  See ClemensTraceIndex::addInstruction() for the record layout
+const uint8_t *decodeRecord(const uint8_t *in, ClemensTraceIndex::Record &record) {
+    uint8_t mask = *in++;
+    record.opcode = *in++;
+    uint8_t flags = *in++;
+    record.opc8 = (flags & 1) != 0;
+    record.writeCount = flags >> 1;
+    record.pc = getU24(in);
+    record.value = getU16(in);
+    record.bank = *in++;
+    record.cycles = *in++;
+    if (mask & kRecordA)
+        record.regs.A = getU16(in);
+    if (mask & kRecordX)
+        record.regs.X = getU16(in);
+    if (mask & kRecordY)
+        record.regs.Y = getU16(in);
+    if (mask & kRecordD)
+        record.regs.D = getU16(in);
+    if (mask & kRecordS)
+        record.regs.S = getU16(in);
+    if (mask & kRecordP)
+        record.regs.P = *in++;
+    if (mask & kRecordDBR)
+        record.regs.DBR = *in++;
+    if (mask & kRecordEmulation)
+        record.emulation = !record.emulation;
+    for (unsigned i = 0; i < record.writeCount; ++i) {
+        record.writeAddrs[i] = getU24(in);
+        record.writeData[i] = *in++;
+    }
+    record.regs.PC = uint16_t(record.pc & 0xffff);
+    record.regs.PBR = uint8_t(record.pc >> 16);
+    record.regs.IR = record.opcode;
+    return in;
+}
+
+} // namespace
+
+ClemensTraceIndex::ClemensTraceIndex(std::string directory, size_t segmentPostings)
+    : recordsOffset_(0), recordCount_(0), firstSeq_(0), lastEmulation_(false),
+      pcPostings_((std::filesystem::path(directory) / "trace_pc_").string()),
+      writePostings_((std::filesystem::path(directory) / "trace_wr_").string()),
+      segmentPostings_(segmentPostings), isOk_(false) {
+    std::error_code ec;
+    std::filesystem::create_directories(directory, ec);
+    recordsPath_ = (std::filesystem::path(directory) / "trace_records.bin").string();
+    recordsOut_.open(recordsPath_, std::ios_base::out | std::ios_base::binary |
+                                       std::ios_base::trunc);
+    isOk_ = recordsOut_.is_open();
+    recordBuffer_.reserve(kRecordBufferSize + kRecordSizeLimit);
+    memset(&lastRegs_, 0, sizeof(lastRegs_));
+    memset(&writeLog_, 0, sizeof(writeLog_));
+    for (auto &name : opcodeNames_) {
+        name.fill('\0');
+    }
+}
+
+ClemensTraceIndex::~ClemensTraceIndex() {
+    recordsOut_.close();
+    std::error_code ec;
+    std::filesystem::remove(recordsPath_, ec);
+}
+
+void ClemensTraceIndex::addInstruction(uint64_t seq, const ClemensInstruction &instruction,
+                                       const ClemensMachine &machineState) {
+    if (!isOk_) {
+        writeLog_.count = 0;
+        return;
+    }
+    //  sequence numbers are contiguous from the first instruction so that a
+    //  record's index is its offset from firstSeq_
+    if (recordCount_ == 0) {
+        firstSeq_ = seq;
+    }
+    if ((recordCount_ % kCheckpointInterval) == 0) {
+        checkpoints_.push_back(Checkpoint{recordsOffset_, lastRegs_, lastEmulation_});
+    }
+    if (!opcodeNames_[instruction.opc][0]) {
+        strncpy(opcodeNames_[instruction.opc].data(), instruction.desc->name, 3);
+    }
+
+    //  record layout:
+    //      mask, opcode, flags (opc8 | write count << 1), pc (24-bit), value (16),
+    //      bank, cycles, changed registers in mask order, writes (24-bit address
+    //      and data byte)
+    const ClemensCPURegs &regs = machineState.cpu.regs;
+    bool emulation = machineState.cpu.pins.emulation;
+    unsigned writeCount = std::min(writeLog_.count, unsigned(CLEM_MEM_WRITE_LOG_LIMIT));
+    uint32_t pc = (uint32_t(instruction.pbr) << 16) | instruction.addr;
+    uint8_t mask = 0;
+    if (regs.A != lastRegs_.A)
+        mask |= kRecordA;
+    if (regs.X != lastRegs_.X)
+        mask |= kRecordX;
+    if (regs.Y != lastRegs_.Y)
+        mask |= kRecordY;
+    if (regs.D != lastRegs_.D)
+        mask |= kRecordD;
+    if (regs.S != lastRegs_.S)
+        mask |= kRecordS;
+    if (regs.P != lastRegs_.P)
+        mask |= kRecordP;
+    if (regs.DBR != lastRegs_.DBR)
+        mask |= kRecordDBR;
+    if (emulation != lastEmulation_)
+        mask |= kRecordEmulation;
+
+    uint8_t record[kRecordSizeLimit];
+    uint8_t *out = record;
+    *out++ = mask;
+    *out++ = instruction.opc;
+    *out++ = uint8_t((instruction.opc_8 ? 1 : 0) | (writeCount << 1));
+    out = putU24(out, pc);
+    out = putU16(out, instruction.value);
+    *out++ = instruction.bank;
+    *out++ = uint8_t(std::min(instruction.cycles_spent, 255u));
+    if (mask & kRecordA)
+        out = putU16(out, regs.A);
+    if (mask & kRecordX)
+        out = putU16(out, regs.X);
+    if (mask & kRecordY)
+        out = putU16(out, regs.Y);
+    if (mask & kRecordD)
+        out = putU16(out, regs.D);
+    if (mask & kRecordS)
+        out = putU16(out, regs.S);
+    if (mask & kRecordP)
+        *out++ = regs.P;
+    if (mask & kRecordDBR)
+        *out++ = regs.DBR;
+    for (unsigned i = 0; i < writeCount; ++i) {
+        out = putU24(out, writeLog_.addr[i]);
+        *out++ = writeLog_.data[i];
+    }
+    recordBuffer_.insert(recordBuffer_.end(), record, out);
+    recordsOffset_ += out - record;
+    if (recordBuffer_.size() >= kRecordBufferSize) {
+        flushRecords();
+    }
+
+    pcPostings_.add(pc, seq);
+    for (unsigned i = 0; i < writeCount; ++i) {
+        //  read-modify-write instructions in emulation mode write twice
+        if (std::find(writeLog_.addr, writeLog_.addr + i, writeLog_.addr[i]) ==
+            writeLog_.addr + i) {
+            writePostings_.add(writeLog_.addr[i], seq);
+        }
+    }
+    if (pcPostings_.getPendingCount() >= segmentPostings_) {
+        isOk_ = isOk_ && pcPostings_.flush();
+    }
+    if (writePostings_.getPendingCount() >= segmentPostings_) {
+        isOk_ = isOk_ && writePostings_.flush();
+    }
+
+    lastRegs_ = regs;
+    lastEmulation_ = emulation;
+    writeLog_.count = 0;
+    ++recordCount_;
+}
+
+void ClemensTraceIndex::flushRecords() {
+    if (recordBuffer_.empty())
+        return;
+    recordsOut_.write(reinterpret_cast<const char *>(recordBuffer_.data()),
+                      std::streamsize(recordBuffer_.size()));
+    recordsOut_.flush();
+    isOk_ = isOk_ && recordsOut_.good();
+    recordBuffer_.clear();
+}
+
+bool ClemensTraceIndex::seek(uint64_t seq, Record &record) {
+    if (seq < firstSeq_ || seq - firstSeq_ >= recordCount_)
+        return false;
+    flushRecords();
+    if (!isOk_)
+        return false;
+
+    uint64_t index = seq - firstSeq_;
+    size_t checkpointIndex = size_t(index / kCheckpointInterval);
+    const Checkpoint &checkpoint = checkpoints_[checkpointIndex];
+    uint64_t endOffset = checkpointIndex + 1 < checkpoints_.size()
+                             ? checkpoints_[checkpointIndex + 1].offset
+                             : recordsOffset_;
+    std::vector<uint8_t> data(size_t(endOffset - checkpoint.offset));
+    std::ifstream in(recordsPath_, std::ios_base::in | std::ios_base::binary);
+    in.seekg(std::streamoff(checkpoint.offset));
+    in.read(reinterpret_cast<char *>(data.data()), std::streamsize(data.size()));
+    if (!in.good())
+        return false;
+
+    record.regs = checkpoint.regs;
+    record.emulation = checkpoint.emulation;
+    const uint8_t *cur = data.data();
+    for (uint64_t i = checkpointIndex * kCheckpointInterval; i <= index; ++i) {
+        cur = decodeRecord(cur, record);
+    }
+    record.seq = seq;
+    return true;
+}
+
+std::optional<uint64_t> ClemensTraceIndex::findExecution(uint32_t pc, uint64_t nth) {
+    if (!isOk_ || pc >= kKeyLimit)
+        return std::nullopt;
+    return pcPostings_.findNth(pc, nth);
+}
+
+std::optional<uint64_t> ClemensTraceIndex::findLastWrite(uint32_t addr, uint64_t seq) {
+    if (!isOk_ || addr >= kKeyLimit)
+        return std::nullopt;
+    return writePostings_.findLast(addr, seq);
+}
+
+ClemensTraceIndex::Postings::Postings(std::string pathPrefix)
+    : pathPrefix_(std::move(pathPrefix)), nextRunId_(0) {}
+
+ClemensTraceIndex::Postings::~Postings() {
+    std::error_code ec;
+    for (auto &run : runs_) {
+        std::filesystem::remove(run.path, ec);
+    }
+}
+
+void ClemensTraceIndex::Postings::add(uint32_t key, uint64_t seq) {
+    pending_.push_back((uint64_t(key) << kSeqBits) | (seq & kSeqMask));
+}
+
+bool ClemensTraceIndex::Postings::flush() {
+    if (pending_.empty())
+        return true;
+    std::sort(pending_.begin(), pending_.end());
+    Run run;
+    if (!writeRun(run, pending_))
+        return false;
+    pending_.clear();
+    runs_.emplace_back(std::move(run));
+
+    //  keeping each run more than twice the size of the next newer one limits
+    //  the number of runs to O(log n)
+    while (runs_.size() >= 2 && runs_[runs_.size() - 2].count <= 2 * runs_.back().count) {
+        Run &older = runs_[runs_.size() - 2];
+        if (!mergeRuns(older, runs_.back()))
+            return false;
+        std::error_code ec;
+        std::filesystem::remove(runs_.back().path, ec);
+        runs_.pop_back();
+    }
+    return true;
+}
+
+bool ClemensTraceIndex::Postings::writeRun(Run &run, const std::vector<uint64_t> &entries) {
+    run.path = pathPrefix_ + std::to_string(nextRunId_++) + ".run";
+    run.count = entries.size();
+    run.sparse.clear();
+    for (uint64_t i = 0; i < run.count; i += kSparseStride) {
+        run.sparse.push_back(entries[i]);
+    }
+    std::ofstream out(run.path, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+    out.write(reinterpret_cast<const char *>(entries.data()),
+              std::streamsize(entries.size() * sizeof(uint64_t)));
+    return out.good();
+}
+
+bool ClemensTraceIndex::Postings::mergeRuns(Run &older, const Run &newer) {
+    struct Reader {
+        std::ifstream in;
+        std::vector<uint64_t> buffer;
+        size_t pos = 0;
+        uint64_t left;
+
+        Reader(const Run &run)
+            : in(run.path, std::ios_base::in | std::ios_base::binary), left(run.count) {}
+        bool fill() {
+            if (pos < buffer.size())
+                return true;
+            if (left == 0)
+                return false;
+            buffer.resize(size_t(std::min(left, uint64_t(kMergeBufferCount))));
+            in.read(reinterpret_cast<char *>(buffer.data()),
+                    std::streamsize(buffer.size() * sizeof(uint64_t)));
+            left -= buffer.size();
+            pos = 0;
+            return in.good();
+        }
+    };
+    Reader a(older), b(newer);
+    Run merged;
+    merged.path = pathPrefix_ + std::to_string(nextRunId_++) + ".run";
+    merged.count = 0;
+    std::ofstream out(merged.path,
+                      std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+    std::vector<uint64_t> outBuffer;
+    outBuffer.reserve(kMergeBufferCount);
+
+    bool hasA = a.fill(), hasB = b.fill();
+    while (hasA || hasB) {
+        uint64_t value;
+        if (hasA && (!hasB || a.buffer[a.pos] < b.buffer[b.pos])) {
+            value = a.buffer[a.pos++];
+            hasA = a.fill();
+        } else {
+            value = b.buffer[b.pos++];
+            hasB = b.fill();
+        }
+        if ((merged.count % kSparseStride) == 0) {
+            merged.sparse.push_back(value);
+        }
+        ++merged.count;
+        outBuffer.push_back(value);
+        if (outBuffer.size() == kMergeBufferCount) {
+            out.write(reinterpret_cast<const char *>(outBuffer.data()),
+                      std::streamsize(outBuffer.size() * sizeof(uint64_t)));
+            outBuffer.clear();
+        }
+    }
+    out.write(reinterpret_cast<const char *>(outBuffer.data()),
+              std::streamsize(outBuffer.size() * sizeof(uint64_t)));
+    if (!out.good() || merged.count != older.count + newer.count)
+        return false;
+    out.close();
+
+    std::error_code ec;
+    std::filesystem::remove(older.path, ec);
+    older = std::move(merged);
+    return true;
+}
+
+uint64_t ClemensTraceIndex::Postings::lowerBound(const Run &run, uint64_t value) const {
+    //  postings are unique, so the first entry >= value lies within the block
+    //  starting at the last sparse entry below value
+    auto it = std::upper_bound(run.sparse.begin(), run.sparse.end(), value);
+    if (it == run.sparse.begin())
+        return 0;
+    uint64_t blockStart = uint64_t(it - run.sparse.begin() - 1) * kSparseStride;
+    uint64_t blockCount = std::min(kSparseStride, run.count - blockStart);
+    uint64_t block[kSparseStride];
+    std::ifstream in(run.path, std::ios_base::in | std::ios_base::binary);
+    in.seekg(std::streamoff(blockStart * sizeof(uint64_t)));
+    in.read(reinterpret_cast<char *>(block), std::streamsize(blockCount * sizeof(uint64_t)));
+    if (!in.good())
+        return blockStart;
+    return blockStart + uint64_t(std::lower_bound(block, block + blockCount, value) - block);
+}
+
+uint64_t ClemensTraceIndex::Postings::readEntry(const Run &run, uint64_t index) const {
+    uint64_t value = 0;
+    std::ifstream in(run.path, std::ios_base::in | std::ios_base::binary);
+    in.seekg(std::streamoff(index * sizeof(uint64_t)));
+    in.read(reinterpret_cast<char *>(&value), sizeof(value));
+    return value;
+}
+
+std::optional<uint64_t> ClemensTraceIndex::Postings::findNth(uint32_t key, uint64_t nth) {
+    if (nth == 0 || !flush())
+        return std::nullopt;
+    uint64_t first = uint64_t(key) << kSeqBits;
+    for (auto &run : runs_) {
+        uint64_t lo = lowerBound(run, first);
+        uint64_t hi = key + 1 < kKeyLimit ? lowerBound(run, uint64_t(key + 1) << kSeqBits)
+                                          : run.count;
+        if (nth <= hi - lo) {
+            return readEntry(run, lo + nth - 1) & kSeqMask;
+        }
+        nth -= hi - lo;
+    }
+    return std::nullopt;
+}
+
+std::optional<uint64_t> ClemensTraceIndex::Postings::findLast(uint32_t key, uint64_t seq) {
+    if (!flush())
+        return std::nullopt;
+    uint64_t last = (uint64_t(key) << kSeqBits) | std::min(seq, kSeqMask);
+    for (auto it = runs_.rbegin(); it != runs_.rend(); ++it) {
+        uint64_t index = lowerBound(*it, last + 1);
+        if (index == 0)
+            continue;
+        uint64_t value = readEntry(*it, index - 1);
+        if ((value >> kSeqBits) == key)
+            return value & kSeqMask;
+    }
+    return std::nullopt;
+}
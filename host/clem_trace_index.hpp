@@ -0,0 +1,133 @@
+#ifndef CLEM_HOST_TRACE_INDEX_HPP
+#define CLEM_HOST_TRACE_INDEX_HPP
+
+#include "clem_types.h"
+
+#include <array>
+#include <cstdint>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <vector>
+
+//  An on-disk, indexed instruction trace
+//
+//  Instructions are appended to a delta encoded record file, with a checkpoint
+//  of the full register state kept in memory every kCheckpointInterval
+//  instructions.  Seeking to an instruction decodes forward from its
+//  checkpoint.
+//
+//  Executed PCs and written addresses are kept as posting lists of
+//  (address, sequence) pairs.  These are sorted into run files as they fill
+//  and runs of similar size are merged, so that there are O(log n) runs, each
+//  searched with a sparse in-memory index and a single block read.  Memory use
+//  is bounded by the pending postings and sparse indices regardless of the
+//  trace length.
+//
+class ClemensTraceIndex {
+  public:
+    struct Record {
+        uint64_t seq;
+        uint32_t pc; //  (PBR << 16) | PC of the instruction
+        uint16_t value;
+        uint8_t bank;
+        uint8_t opcode;
+        uint8_t cycles;
+        bool opc8;
+        bool emulation;
+        //  registers after the instruction executed (PC, PBR and IR are those of
+        //  the instruction itself)
+        ClemensCPURegs regs;
+        unsigned writeCount;
+        std::array<uint32_t, CLEM_MEM_WRITE_LOG_LIMIT> writeAddrs;
+        std::array<uint8_t, CLEM_MEM_WRITE_LOG_LIMIT> writeData;
+    };
+
+    //  pending postings are sorted into a run once this many are collected
+    static constexpr size_t kSegmentPostings = 1 << 20;
+
+    //  Index files are created within the directory and removed on destruction
+    explicit ClemensTraceIndex(std::string directory,
+                               size_t segmentPostings = kSegmentPostings);
+    ~ClemensTraceIndex();
+
+    bool isOk() const { return isOk_; }
+    //  The log to attach to the machine with clemens_memory_write_log()
+    ClemensMemoryWriteLog *getWriteLog() { return &writeLog_; }
+
+    void addInstruction(uint64_t seq, const ClemensInstruction &instruction,
+                        const ClemensMachine &machineState);
+
+    uint64_t getFirstSeq() const { return firstSeq_; }
+    uint64_t getInstructionCount() const { return recordCount_; }
+    const char *getOpcodeName(uint8_t opcode) const { return opcodeNames_[opcode].data(); }
+
+    //  Decodes the instruction with the given sequence number
+    bool seek(uint64_t seq, Record &record);
+    //  Returns the sequence number of the nth (starting from 1) execution of
+    //  the instruction at pc
+    std::optional<uint64_t> findExecution(uint32_t pc, uint64_t nth);
+    //  Returns the sequence number of the last instruction at or before seq that
+    //  wrote to addr ((bank << 16) | address)
+    std::optional<uint64_t> findLastWrite(uint32_t addr, uint64_t seq);
+
+  private:
+    struct Checkpoint {
+        uint64_t offset;
+        ClemensCPURegs regs;
+        bool emulation;
+    };
+
+    class Postings {
+      public:
+        Postings(std::string pathPrefix);
+        ~Postings();
+
+        void add(uint32_t key, uint64_t seq);
+        bool flush();
+        //  sequence numbers of the nth (from 1) entry for key, and of the last
+        //  entry for key at or before seq
+        std::optional<uint64_t> findNth(uint32_t key, uint64_t nth);
+        std::optional<uint64_t> findLast(uint32_t key, uint64_t seq);
+
+        size_t getPendingCount() const { return pending_.size(); }
+
+      private:
+        struct Run {
+            std::string path;
+            uint64_t count;
+            std::vector<uint64_t> sparse;
+        };
+        bool writeRun(Run &run, const std::vector<uint64_t> &entries);
+        bool mergeRuns(Run &older, const Run &newer);
+        uint64_t lowerBound(const Run &run, uint64_t value) const;
+        uint64_t readEntry(const Run &run, uint64_t index) const;
+
+        std::string pathPrefix_;
+        unsigned nextRunId_;
+        std::vector<uint64_t> pending_;
+        std::vector<Run> runs_; //  oldest first
+    };
+
+    void flushRecords();
+
+    std::string recordsPath_;
+    std::ofstream recordsOut_;
+    std::vector<uint8_t> recordBuffer_;
+    uint64_t recordsOffset_;
+    uint64_t recordCount_;
+    uint64_t firstSeq_;
+
+    ClemensCPURegs lastRegs_;
+    bool lastEmulation_;
+    std::vector<Checkpoint> checkpoints_;
+
+    Postings pcPostings_;
+    Postings writePostings_;
+    size_t segmentPostings_;
+    ClemensMemoryWriteLog writeLog_;
+    std::array<std::array<char, 4>, 256> opcodeNames_;
+    bool isOk_;
+};
+
+#endif
@@ -0,0 +1,617 @@
+#include "clem_video_capture.hpp"
+
+#include "render.h"
+
+#if defined(__GNUC__)
+//  removes a lot of unused STB Truetype functions
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-function"
+#endif
+
+#define STBTT_STATIC
+#define STB_TRUETYPE_IMPLEMENTATION
+#include "misc/stb_truetype.h"
+
+#if defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+
+namespace {
+
+constexpr unsigned kFontTextureWidth = 512;
+constexpr unsigned kFontTextureHeight = 256;
+
+//  Apple II modes occupy 560 x 384 pixels centered in the frame, surrounded
+//  by the border color (matching the display's layout)
+constexpr unsigned kA2Width = 560;
+constexpr unsigned kA2Height = 384;
+constexpr unsigned kA2OffsetX = (ClemensVideoCapture::kFrameWidth - kA2Width) / 2;
+constexpr unsigned kA2OffsetY = (ClemensVideoCapture::kFrameHeight - kA2Height) / 2;
+
+//  Same mapping as ClemensDisplayProvider - screen byte code to glyph index.
+//  The two 16-bit half-words differ if the character code is flashing.
+struct GlyphMaps {
+    unsigned primary[256];
+    unsigned alternate[256];
+    GlyphMaps() {
+        for (unsigned i = 0; i < 0x20; ++i) {
+            primary[i] = (0x140 + i) | ((0x140 + i) << 16);
+            primary[i + 0x20] = (0x120 + i) | ((0x120 + i) << 16);
+            primary[i + 0x40] = (0x40 + i) | ((0x140 + i) << 16);
+            primary[i + 0x60] = (0x20 + i) | ((0x120 + i) << 16);
+            primary[i + 0x80] = (0x40 + i) | ((0x40 + i) << 16);
+            primary[i + 0xA0] = (0x20 + i) | ((0x20 + i) << 16);
+            primary[i + 0xC0] = (0x40 + i) | ((0x40 + i) << 16);
+            primary[i + 0xE0] = (0x60 + i) | ((0x60 + i) << 16);
+
+            alternate[i] = (0x140 + i) | ((0x140 + i) << 16);
+            alternate[i + 0x20] = (0x120 + i) | ((0x120 + i) << 16);
+            alternate[i + 0x40] = (0x80 + i) | ((0x80 + i) << 16);
+            alternate[i + 0x60] = (0x160 + i) | ((0x160 + i) << 16);
+            alternate[i + 0x80] = (0x40 + i) | ((0x40 + i) << 16);
+            alternate[i + 0xA0] = (0x20 + i) | ((0x20 + i) << 16);
+            alternate[i + 0xC0] = (0x40 + i) | ((0x40 + i) << 16);
+            alternate[i + 0xE0] = (0x60 + i) | ((0x60 + i) << 16);
+        }
+    }
+};
+
+const GlyphMaps kGlyphMaps;
+
+uint64_t elapsedNs(std::chrono::steady_clock::time_point t0) {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now() - t0)
+        .count();
+}
+
+void fillRect(uint8_t *rgb, unsigned x0, unsigned y0, unsigned w, unsigned h,
+              const uint8_t *color) {
+    for (unsigned y = y0; y < y0 + h; ++y) {
+        uint8_t *pixout = rgb + (y * ClemensVideoCapture::kFrameWidth + x0) * 3;
+        for (unsigned x = 0; x < w; ++x, pixout += 3) {
+            pixout[0] = color[0];
+            pixout[1] = color[1];
+            pixout[2] = color[2];
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//  PNG encoding
+//
+//  A single fixed Huffman deflate block per image.  Matches are only searched
+//  at a distance of one pixel and one row back, which covers the runs and the
+//  doubled scanlines that make up nearly all of an emulated screen.  This
+//  keeps the encoder cheap while still compressing frames several times over.
+
+const std::array<uint32_t, 256> &crcTable() {
+    static const std::array<uint32_t, 256> table = []() {
+        std::array<uint32_t, 256> result;
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k) {
+                c = (c & 1) ? 0xedb88320 ^ (c >> 1) : (c >> 1);
+            }
+            result[i] = c;
+        }
+        return result;
+    }();
+    return table;
+}
+
+uint32_t crc32(uint32_t crc, const uint8_t *data, size_t len) {
+    const auto &table = crcTable();
+    crc = ~crc;
+    for (size_t i = 0; i < len; ++i) {
+        crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+uint32_t adler32(const uint8_t *data, size_t len) {
+    uint32_t a = 1, b = 0;
+    while (len > 0) {
+        size_t block = std::min<size_t>(len, 5552);
+        len -= block;
+        while (block--) {
+            a += *data++;
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+    }
+    return (b << 16) | a;
+}
+
+void putU32(std::vector<uint8_t> &out, uint32_t v) {
+    out.push_back((uint8_t)(v >> 24));
+    out.push_back((uint8_t)(v >> 16));
+    out.push_back((uint8_t)(v >> 8));
+    out.push_back((uint8_t)v);
+}
+
+class BitWriter {
+  public:
+    explicit BitWriter(std::vector<uint8_t> &out) : out_(out), bits_(0), bitCount_(0) {}
+
+    //  deflate packs values least significant bit first
+    void put(uint32_t value, unsigned count) {
+        bits_ |= value << bitCount_;
+        bitCount_ += count;
+        while (bitCount_ >= 8) {
+            out_.push_back((uint8_t)bits_);
+            bits_ >>= 8;
+            bitCount_ -= 8;
+        }
+    }
+    //  ...except Huffman codes, which are packed most significant bit first
+    void putCode(uint32_t code, unsigned count) {
+        uint32_t reversed = 0;
+        for (unsigned i = 0; i < count; ++i) {
+            reversed = (reversed << 1) | ((code >> i) & 1);
+        }
+        put(reversed, count);
+    }
+    void flush() {
+        if (bitCount_ > 0) {
+            out_.push_back((uint8_t)bits_);
+        }
+        bits_ = 0;
+        bitCount_ = 0;
+    }
+
+  private:
+    std::vector<uint8_t> &out_;
+    uint32_t bits_;
+    unsigned bitCount_;
+};
+
+constexpr uint16_t kLengthBase[29] = {3,  4,  5,  6,   7,   8,   9,   10,  11, 13,
+                                      15, 17, 19, 23,  27,  31,  35,  43,  51, 59,
+                                      67, 83, 99, 115, 131, 163, 195, 227, 258};
+constexpr uint8_t kLengthExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+                                      2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+constexpr uint16_t kDistanceBase[30] = {1,    2,    3,    4,    5,    7,     9,     13,
+                                        17,   25,   33,   49,   65,   97,    129,   193,
+                                        257,  385,  513,  769,  1025, 1537,  2049,  3073,
+                                        4097, 6145, 8193, 12289, 16385, 24577};
+constexpr uint8_t kDistanceExtra[30] = {0, 0, 0, 0, 1, 1, 2, 2,  3,  3,  4,  4,  5,  5,  6,
+                                        6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+void putLiteralLength(BitWriter &writer, unsigned symbol) {
+    if (symbol < 144) {
+        writer.putCode(0x30 + symbol, 8);
+    } else if (symbol < 256) {
+        writer.putCode(0x190 + symbol - 144, 9);
+    } else if (symbol < 280) {
+        writer.putCode(symbol - 256, 7);
+    } else {
+        writer.putCode(0xc0 + symbol - 280, 8);
+    }
+}
+
+void putMatch(BitWriter &writer, unsigned length, unsigned distance) {
+    unsigned code = 28;
+    while (kLengthBase[code] > length)
+        --code;
+    putLiteralLength(writer, 257 + code);
+    writer.put(length - kLengthBase[code], kLengthExtra[code]);
+    code = 29;
+    while (kDistanceBase[code] > distance)
+        --code;
+    writer.putCode(code, 5);
+    writer.put(distance - kDistanceBase[code], kDistanceExtra[code]);
+}
+
+void deflateFixed(std::vector<uint8_t> &out, const uint8_t *data, size_t len, unsigned rowBytes) {
+    out.push_back(0x78); // zlib header, 32K window
+    out.push_back(0x01);
+    BitWriter writer(out);
+    writer.put(1, 1); // final block
+    writer.put(1, 2); // fixed Huffman codes
+    const unsigned distances[2] = {3, rowBytes};
+    size_t pos = 0;
+    while (pos < len) {
+        unsigned bestLength = 0;
+        unsigned bestDistance = 0;
+        for (unsigned distance : distances) {
+            if (pos < distance)
+                continue;
+            unsigned length = 0;
+            size_t limit = std::min<size_t>(258, len - pos);
+            while (length < limit && data[pos + length] == data[pos + length - distance]) {
+                ++length;
+            }
+            if (length > bestLength) {
+                bestLength = length;
+                bestDistance = distance;
+            }
+        }
+        if (bestLength >= 3) {
+            putMatch(writer, bestLength, bestDistance);
+            pos += bestLength;
+        } else {
+            putLiteralLength(writer, data[pos]);
+            ++pos;
+        }
+    }
+    putLiteralLength(writer, 256);
+    writer.flush();
+    putU32(out, adler32(data, len));
+}
+
+void putChunk(std::vector<uint8_t> &out, const char *type, const uint8_t *data, size_t len) {
+    putU32(out, (uint32_t)len);
+    size_t typeStart = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data, data + len);
+    putU32(out, crc32(0, out.data() + typeStart, len + 4));
+}
+
+} // namespace
+
+struct ClemensVideoCapture::GlyphSet {
+    stbtt_bakedchar glyphs[512];
+    std::unique_ptr<uint8_t[]> bitmap;
+};
+
+ClemensVideoCapture::ClemensVideoCapture(Format format, std::string path,
+                                         const uint8_t *fontLoData, const uint8_t *fontHiData,
+                                         unsigned queueLimit)
+    : format_(format), path_(std::move(path)), isOpen_(false), stream_(nullptr), frameHead_(0),
+      frameTail_(0), frameCount_(0), stopping_(false), stats_{}, pngFrameIndex_(0) {
+
+    std::error_code ec;
+    if (format_ == Format::PNG) {
+        std::filesystem::create_directories(path_, ec);
+        isOpen_ = std::filesystem::is_directory(path_, ec);
+    } else {
+        stream_ = fopen(path_.c_str(), "wb");
+        if (stream_) {
+            fprintf(stream_, "YUV4MPEG2 W%u H%u F%u:1 Ip A1:1 C420jpeg\n", kFrameWidth,
+                    kFrameHeight, kFramesPerSecond);
+            isOpen_ = true;
+        }
+    }
+    if (!isOpen_)
+        return;
+
+    //  baked identically to the display's font textures so that glyph quads
+    //  land on the same pixels
+    const uint8_t *fontData[2] = {fontLoData, fontHiData};
+    for (unsigned i = 0; i < 2; ++i) {
+        if (!fontData[i])
+            continue;
+        glyphs_[i] = std::make_unique<GlyphSet>();
+        glyphs_[i]->bitmap = std::make_unique<uint8_t[]>(kFontTextureWidth * kFontTextureHeight);
+        stbtt_BakeFontBitmap(fontData[i], 0, 16.0f, glyphs_[i]->bitmap.get(), kFontTextureWidth,
+                             kFontTextureHeight, 0xe000, 512, glyphs_[i]->glyphs);
+    }
+
+    indexed_.resize(kFrameWidth * kFrameHeight);
+    rgb_.resize(kFrameWidth * kFrameHeight * 3);
+    frames_.resize(std::max(queueLimit, 1u));
+    for (auto &frame : frames_) {
+        frame.e0 = std::make_unique<uint8_t[]>(kVideoMemoryLimit);
+        frame.e1 = std::make_unique<uint8_t[]>(kVideoMemoryLimit);
+    }
+    worker_ = std::thread(&ClemensVideoCapture::run, this);
+}
+
+ClemensVideoCapture::~ClemensVideoCapture() { finish(); }
+
+void ClemensVideoCapture::submit(const ClemensMonitor &monitor, const ClemensVideo &text,
+                                 const ClemensVideo &graphics, const uint8_t *e0,
+                                 const uint8_t *e1, unsigned vgcModeFlags, unsigned frameCount) {
+    if (!worker_.joinable() || frameCount == 0)
+        return;
+
+    auto t0 = std::chrono::steady_clock::now();
+    std::unique_lock<std::mutex> lk(mutex_);
+    if (frameCount_ == frames_.size()) {
+        auto stallT0 = std::chrono::steady_clock::now();
+        notFull_.wait(lk, [this]() { return frameCount_ < frames_.size(); });
+        stats_.stallNs += elapsedNs(stallT0);
+    }
+    //  the slot at the head isn't visible to the worker until frameCount_ is
+    //  incremented, so it can be filled without holding the lock
+    Frame &frame = frames_[frameHead_];
+    lk.unlock();
+
+    frame.monitor = monitor;
+    frame.text = text;
+    frame.graphics = graphics;
+    frame.text.scanlines = frame.textScanlines.data();
+    frame.graphics.scanlines = frame.graphicsScanlines.data();
+    if (text.format != kClemensVideoFormat_None) {
+        frame.text.scanline_limit =
+            std::min(text.scanline_limit, (int)frame.textScanlines.size());
+        memcpy(frame.text.scanlines, text.scanlines,
+               sizeof(ClemensScanline) * frame.text.scanline_limit);
+    }
+    if (graphics.format != kClemensVideoFormat_None) {
+        frame.graphics.scanline_limit =
+            std::min(graphics.scanline_limit, (int)frame.graphicsScanlines.size());
+        memcpy(frame.graphics.scanlines, graphics.scanlines,
+               sizeof(ClemensScanline) * frame.graphics.scanline_limit);
+    }
+    memcpy(frame.e0.get(), e0, kVideoMemoryLimit);
+    memcpy(frame.e1.get(), e1, kVideoMemoryLimit);
+    frame.vgcModeFlags = vgcModeFlags;
+    frame.frameCount = frameCount;
+
+    lk.lock();
+    frameHead_ = (frameHead_ + 1) % frames_.size();
+    ++frameCount_;
+    ++stats_.imagesSubmitted;
+    stats_.submitNs += elapsedNs(t0);
+    lk.unlock();
+    notEmpty_.notify_one();
+}
+
+void ClemensVideoCapture::finish() {
+    if (worker_.joinable()) {
+        {
+            std::lock_guard<std::mutex> lk(mutex_);
+            stopping_ = true;
+        }
+        notEmpty_.notify_one();
+        worker_.join();
+    }
+    if (stream_) {
+        fclose(stream_);
+        stream_ = nullptr;
+    }
+}
+
+auto ClemensVideoCapture::getStats() const -> Stats {
+    std::lock_guard<std::mutex> lk(mutex_);
+    return stats_;
+}
+
+void ClemensVideoCapture::run() {
+    std::unique_lock<std::mutex> lk(mutex_);
+    for (;;) {
+        notEmpty_.wait(lk, [this]() { return frameCount_ > 0 || stopping_; });
+        if (frameCount_ == 0)
+            break;
+        const Frame &frame = frames_[frameTail_];
+        bool writeFailed = stats_.writeFailed;
+        lk.unlock();
+
+        auto t0 = std::chrono::steady_clock::now();
+        bool written = false;
+        if (!writeFailed) {
+            renderFrame(frame);
+            written = format_ == Format::PNG ? writePNG(frame.frameCount)
+                                             : writeY4M(frame.frameCount);
+        }
+        uint64_t encodeNs = elapsedNs(t0);
+
+        lk.lock();
+        if (written) {
+            stats_.framesWritten += frame.frameCount;
+        } else {
+            stats_.writeFailed = true;
+        }
+        stats_.encodeNs += encodeNs;
+        frameTail_ = (frameTail_ + 1) % frames_.size();
+        --frameCount_;
+        notFull_.notify_one();
+    }
+}
+
+void ClemensVideoCapture::renderFrame(const Frame &frame) {
+    unsigned paletteCount;
+    const uint8_t *grColors = clemens_render_get_palette(kClemensVideoFormat_Lores, &paletteCount);
+    const uint8_t kBlack[3] = {0, 0, 0};
+    uint8_t *rgb = rgb_.data();
+    const ClemensVideo &graphics = frame.graphics;
+
+    if (graphics.format == kClemensVideoFormat_Super_Hires) {
+        //  super hires fills the frame; rows are written every other line and
+        //  doubled here as the display does
+        unsigned rowCount = std::min((unsigned)graphics.scanline_count * 2, kFrameHeight);
+        fillRect(rgb, 0, 0, kFrameWidth, kFrameHeight, kBlack);
+        clemens_render_graphics(&graphics, frame.e1.get(), nullptr, indexed_.data(), kFrameWidth,
+                                kFrameHeight, kFrameWidth);
+        for (unsigned y = 0; y + 1 < rowCount; y += 2) {
+            memcpy(&indexed_[(y + 1) * kFrameWidth], &indexed_[y * kFrameWidth], kFrameWidth);
+        }
+        clemens_render_indexed_to_rgb(&graphics, indexed_.data(), kFrameWidth, rowCount,
+                                      kFrameWidth, rgb, kFrameWidth * 3);
+        return;
+    }
+
+    fillRect(rgb, 0, 0, kFrameWidth, kFrameHeight,
+             grColors + (frame.monitor.border_color & 0xf) * 4);
+    fillRect(rgb, kA2OffsetX, kA2OffsetY, kA2Width, kA2Height, kBlack);
+
+    unsigned rowCount = 0;
+    switch (graphics.format) {
+    case kClemensVideoFormat_Hires:
+    case kClemensVideoFormat_Double_Hires:
+        rowCount = graphics.scanline_count * 2;
+        break;
+    case kClemensVideoFormat_Lores:
+    case kClemensVideoFormat_Double_Lores:
+        rowCount = graphics.scanline_count * 16;
+        break;
+    default:
+        break;
+    }
+    rowCount = std::min(rowCount, kA2Height);
+    if (rowCount > 0) {
+        clemens_render_graphics(&graphics, frame.e0.get(), frame.e1.get(), indexed_.data(),
+                                kA2Width, kA2Height, kFrameWidth);
+        clemens_render_indexed_to_rgb(&graphics, indexed_.data(), kA2Width, rowCount, kFrameWidth,
+                                      rgb + (kA2OffsetY * kFrameWidth + kA2OffsetX) * 3,
+                                      kFrameWidth * 3);
+    }
+    if (frame.text.format == kClemensVideoFormat_Text) {
+        renderText(frame, rgb);
+    }
+}
+
+void ClemensVideoCapture::renderText(const Frame &frame, uint8_t *rgb) {
+    const ClemensVideo &text = frame.text;
+    bool text80col = (frame.vgcModeFlags & CLEM_VGC_80COLUMN_TEXT) != 0;
+    bool useAltCharSet = (frame.vgcModeFlags & CLEM_VGC_ALTCHARSET) != 0;
+    const unsigned *glyphMap = useAltCharSet ? kGlyphMaps.alternate : kGlyphMaps.primary;
+    const GlyphSet *glyphSet = glyphs_[text80col ? 1 : 0].get();
+    const unsigned columns = text80col ? 80 : 40;
+    const unsigned cellWidth = kA2Width / columns;
+    const unsigned cellHeight = kA2Height / CLEM_VGC_TEXT_SCANLINE_COUNT;
+
+    unsigned paletteCount;
+    const uint8_t *grColors = clemens_render_get_palette(kClemensVideoFormat_Text, &paletteCount);
+    const uint8_t *bgColor = grColors + ((frame.monitor.text_color >> 4) & 0xf) * 4;
+    const uint8_t *fgColor = grColors + (frame.monitor.text_color & 0xf) * 4;
+
+    unsigned refreshRate = frame.monitor.signal == CLEM_MONITOR_SIGNAL_PAL ? 50 : 60;
+    bool flashPhase = (text.vbl_counter % refreshRate) >= refreshRate / 2;
+
+    for (int i = 0; i < text.scanline_count; ++i) {
+        int row = i + text.scanline_start;
+        if (row >= CLEM_VGC_TEXT_SCANLINE_COUNT)
+            break;
+        unsigned cellY = kA2OffsetY + row * cellHeight;
+        fillRect(rgb, kA2OffsetX, cellY, kA2Width, cellHeight, bgColor);
+        if (!glyphSet)
+            continue;
+        for (unsigned column = 0; column < columns; ++column) {
+            //  80 column text interleaves aux (even) and main (odd) columns
+            const uint8_t *memory = frame.e0.get();
+            unsigned byteIndex = column;
+            if (text80col) {
+                memory = (column & 1) ? frame.e0.get() : frame.e1.get();
+                byteIndex = column >> 1;
+            }
+            if ((int)byteIndex >= text.scanline_byte_cnt)
+                break;
+            unsigned glyphIndex = glyphMap[memory[text.scanlines[row].offset + byteIndex]];
+            if (flashPhase) {
+                glyphIndex = (glyphIndex << 16) | (glyphIndex >> 16);
+            }
+            glyphIndex &= 0xffff;
+
+            stbtt_aligned_quad quad;
+            float xpos = float(column * cellWidth);
+            float ypos = float(row * cellHeight + cellHeight - 1);
+            stbtt_GetBakedQuad(glyphSet->glyphs, kFontTextureWidth, kFontTextureHeight,
+                               (int)glyphIndex, &xpos, &ypos, &quad, 1);
+            int x0 = (int)quad.x0, y0 = (int)quad.y0;
+            int s0 = (int)(quad.s0 * kFontTextureWidth), t0 = (int)(quad.t0 * kFontTextureHeight);
+            int w = (int)quad.x1 - x0, h = (int)quad.y1 - y0;
+            for (int y = 0; y < h; ++y) {
+                int py = y0 + y;
+                if (py < 0 || py >= (int)kA2Height)
+                    continue;
+                const uint8_t *alpha = &glyphSet->bitmap[(t0 + y) * kFontTextureWidth + s0];
+                uint8_t *pixout = rgb + ((kA2OffsetY + py) * kFrameWidth + kA2OffsetX) * 3;
+                for (int x = 0; x < w; ++x) {
+                    int px = x0 + x;
+                    if (px < 0 || px >= (int)kA2Width || !alpha[x])
+                        continue;
+                    uint8_t *pixel = pixout + px * 3;
+                    for (int c = 0; c < 3; ++c) {
+                        pixel[c] = (uint8_t)((pixel[c] * (255 - alpha[x]) +
+                                              fgColor[c] * alpha[x]) /
+                                             255);
+                    }
+                }
+            }
+        }
+    }
+}
+
+bool ClemensVideoCapture::writePNG(unsigned frameCount) {
+    //  PNG rows are prefixed by a filter type byte (0 = none), stored in
+    //  indexed_ which is free once the RGB frame is rendered
+    const unsigned rowBytes = kFrameWidth * 3 + 1;
+    std::vector<uint8_t> &raw = indexed_;
+    raw.resize(rowBytes * kFrameHeight);
+    for (unsigned y = 0; y < kFrameHeight; ++y) {
+        raw[y * rowBytes] = 0;
+        memcpy(&raw[y * rowBytes + 1], &rgb_[y * kFrameWidth * 3], kFrameWidth * 3);
+    }
+
+    std::vector<uint8_t> zdata;
+    zdata.reserve(raw.size() / 4);
+    deflateFixed(zdata, raw.data(), raw.size(), rowBytes);
+
+    static const uint8_t kSignature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    uint8_t ihdr[13];
+    for (unsigned i = 0; i < 4; ++i) {
+        ihdr[i] = (uint8_t)(kFrameWidth >> (24 - i * 8));
+        ihdr[4 + i] = (uint8_t)(kFrameHeight >> (24 - i * 8));
+    }
+    ihdr[8] = 8;  // bit depth
+    ihdr[9] = 2;  // truecolor RGB
+    ihdr[10] = 0; // deflate
+    ihdr[11] = 0; // adaptive filtering
+    ihdr[12] = 0; // no interlace
+    encoded_.clear();
+    encoded_.insert(encoded_.end(), kSignature, kSignature + sizeof(kSignature));
+    putChunk(encoded_, "IHDR", ihdr, sizeof(ihdr));
+    putChunk(encoded_, "IDAT", zdata.data(), zdata.size());
+    putChunk(encoded_, "IEND", nullptr, 0);
+
+    //  an image standing in for several frames is written once per frame so
+    //  that the sequence keeps a constant frame rate
+    for (unsigned i = 0; i < frameCount; ++i) {
+        char filename[32];
+        snprintf(filename, sizeof(filename), "frame_%06llu.png",
+                 (unsigned long long)pngFrameIndex_++);
+        auto filePath = std::filesystem::path(path_) / filename;
+        FILE *fp = fopen(filePath.string().c_str(), "wb");
+        if (!fp)
+            return false;
+        bool ok = fwrite(encoded_.data(), 1, encoded_.size(), fp) == encoded_.size();
+        fclose(fp);
+        if (!ok)
+            return false;
+    }
+    return true;
+}
+
+bool ClemensVideoCapture::writeY4M(unsigned frameCount) {
+    //  4:2:0 with full range BT.601 coefficients (C420jpeg), chroma sited at
+    //  the center of each 2x2 block
+    const unsigned lumaSize = kFrameWidth * kFrameHeight;
+    const unsigned chromaWidth = kFrameWidth / 2;
+    const unsigned chromaSize = chromaWidth * (kFrameHeight / 2);
+    encoded_.resize(lumaSize + chromaSize * 2);
+    uint8_t *lumaPlane = encoded_.data();
+    uint8_t *cbPlane = lumaPlane + lumaSize;
+    uint8_t *crPlane = cbPlane + chromaSize;
+    const uint8_t *rgb = rgb_.data();
+    for (unsigned i = 0; i < lumaSize; ++i, rgb += 3) {
+        lumaPlane[i] = (uint8_t)((77 * rgb[0] + 150 * rgb[1] + 29 * rgb[2] + 128) >> 8);
+    }
+    for (unsigned y = 0; y < kFrameHeight / 2; ++y) {
+        const uint8_t *row0 = rgb_.data() + (y * 2) * kFrameWidth * 3;
+        const uint8_t *row1 = row0 + kFrameWidth * 3;
+        for (unsigned x = 0; x < chromaWidth; ++x, row0 += 6, row1 += 6) {
+            int r = (row0[0] + row0[3] + row1[0] + row1[3] + 2) >> 2;
+            int g = (row0[1] + row0[4] + row1[1] + row1[4] + 2) >> 2;
+            int b = (row0[2] + row0[5] + row1[2] + row1[5] + 2) >> 2;
+            int cb = (-43 * r - 85 * g + 128 * b + 32768 + 128) >> 8;
+            int cr = (128 * r - 107 * g - 21 * b + 32768 + 128) >> 8;
+            cbPlane[y * chromaWidth + x] = (uint8_t)std::clamp(cb, 0, 255);
+            crPlane[y * chromaWidth + x] = (uint8_t)std::clamp(cr, 0, 255);
+        }
+    }
+    for (unsigned i = 0; i < frameCount; ++i) {
+        if (fputs("FRAME\n", stream_) < 0)
+            return false;
+        if (fwrite(encoded_.data(), 1, encoded_.size(), stream_) != encoded_.size())
+            return false;
+    }
+    return true;
+}
@@ -0,0 +1,117 @@
+#ifndef CLEM_HOST_VIDEO_CAPTURE_HPP
+#define CLEM_HOST_VIDEO_CAPTURE_HPP
+
+#include "clem_mmio_types.h"
+
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+//  Captures emulated video to disk as a numbered PNG sequence or a single
+//  YUV4MPEG2 (Y4M) stream at 60 frames per second.
+//
+//  submit() is called from the emulator thread and only snapshots the scanline
+//  tables and the video area of banks E0 and E1 into a preallocated slot.
+//  Rendering (clemens_render_graphics + clemens_render_indexed_to_rgb), text
+//  and encoding run on a worker thread.  The slot queue is bounded.  When it is
+//  full, submit() waits for the worker so that frames are never dropped - the
+//  time spent waiting is reported in Stats.
+//
+//  Each submitted image can stand for more than one 60hz frame (i.e. when the
+//  host publishes less often than the VGC's vertical blank), so the output
+//  stays in step with emulated time.
+//
+class ClemensVideoCapture {
+  public:
+    enum class Format { PNG, Y4M };
+
+    struct Stats {
+        uint64_t imagesSubmitted;
+        uint64_t framesWritten;
+        uint64_t submitNs; //  total time spent in submit(), including stalls
+        uint64_t stallNs;  //  time spent in submit() waiting on a full queue
+        uint64_t encodeNs; //  worker time spent rendering and encoding
+        bool writeFailed;
+    };
+
+    static constexpr unsigned kFrameWidth = 640;
+    static constexpr unsigned kFrameHeight = 400;
+    static constexpr unsigned kFramesPerSecond = 60;
+
+    //  For PNG, path is a directory receiving frame_NNNNNN.png files.  For Y4M,
+    //  path is the stream file.  The font data are the TTF images used by the
+    //  display for 40 and 80 column text.  If null, text is drawn without
+    //  glyphs.
+    ClemensVideoCapture(Format format, std::string path, const uint8_t *fontLoData,
+                        const uint8_t *fontHiData, unsigned queueLimit = 8);
+    ~ClemensVideoCapture();
+
+    bool isOpen() const { return isOpen_; }
+    Format getFormat() const { return format_; }
+    const std::string &getPath() const { return path_; }
+
+    //  e0 and e1 are the 64K Mega II banks.  frameCount is the number of 60hz
+    //  frames this image represents.
+    void submit(const ClemensMonitor &monitor, const ClemensVideo &text,
+                const ClemensVideo &graphics, const uint8_t *e0, const uint8_t *e1,
+                unsigned vgcModeFlags, unsigned frameCount);
+
+    //  Waits for queued images to be written and closes the output.
+    void finish();
+
+    Stats getStats() const;
+
+  private:
+    static constexpr unsigned kVideoMemoryLimit = 0xa000;
+
+    struct Frame {
+        ClemensMonitor monitor;
+        ClemensVideo text;
+        ClemensVideo graphics;
+        std::array<ClemensScanline, CLEM_VGC_SHGR_SCANLINE_COUNT> textScanlines;
+        std::array<ClemensScanline, CLEM_VGC_SHGR_SCANLINE_COUNT> graphicsScanlines;
+        std::unique_ptr<uint8_t[]> e0;
+        std::unique_ptr<uint8_t[]> e1;
+        unsigned vgcModeFlags;
+        unsigned frameCount;
+    };
+
+    struct GlyphSet;
+
+    void run();
+    void renderFrame(const Frame &frame);
+    void renderText(const Frame &frame, uint8_t *rgb);
+    bool writePNG(unsigned frameCount);
+    bool writeY4M(unsigned frameCount);
+
+    Format format_;
+    std::string path_;
+    bool isOpen_;
+    FILE *stream_;
+
+    std::vector<Frame> frames_;
+    unsigned frameHead_;
+    unsigned frameTail_;
+    unsigned frameCount_;
+    bool stopping_;
+    mutable std::mutex mutex_;
+    std::condition_variable notEmpty_;
+    std::condition_variable notFull_;
+    std::thread worker_;
+    Stats stats_;
+
+    //  worker owned
+    std::unique_ptr<GlyphSet> glyphs_[2];
+    std::vector<uint8_t> indexed_;
+    std::vector<uint8_t> rgb_;
+    std::vector<uint8_t> encoded_;
+    uint64_t pngFrameIndex_;
+};
+
+#endif
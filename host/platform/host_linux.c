@@ -1,3 +1,4 @@
+#define _GNU_SOURCE
 #include "clem_host_platform.h"
 
 #include <X11/XKBlib.h>
@@ -5,19 +6,23 @@
 
 #include <assert.h>
 
-#define _GNU_SOURCE
 #include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <linux/input.h>
+#include <pthread.h>
+#include <sched.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
 #include <sys/stat.h>
 #include <sys/syscall.h>
 #include <sys/types.h>
+#include <time.h>
 #include <unistd.h>
 #include <uuid/uuid.h>
 
@@ -34,11 +39,147 @@ static inline unsigned local_getcpu() {
 
 unsigned clem_host_get_processor_number() { return local_getcpu(); }
 
+bool clem_host_thread_set_processor(unsigned processor) {
+    cpu_set_t cpus;
+    if (processor >= CPU_SETSIZE)
+        return false;
+    CPU_ZERO(&cpus);
+    CPU_SET(processor, &cpus);
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) == 0;
+}
+
+ClemensHostThreadPriority clem_host_thread_set_priority(ClemensHostThreadPriority priority) {
+    if (priority == kClemensHostThreadPriority_Realtime) {
+        //  low within the FIFO range so that kernel and audio server threads
+        //  still preempt the emulator
+        struct sched_param param;
+        memset(&param, 0, sizeof(param));
+        param.sched_priority = sched_get_priority_min(SCHED_FIFO) + 10;
+        if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0)
+            return kClemensHostThreadPriority_Realtime;
+        priority = kClemensHostThreadPriority_High;
+    }
+    if (priority == kClemensHostThreadPriority_High) {
+        //  on Linux the nice value of a thread ID applies to that thread alone
+        if (setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), -10) == 0)
+            return kClemensHostThreadPriority_High;
+    }
+    return kClemensHostThreadPriority_Normal;
+}
+
+uint64_t clem_host_timer_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+void clem_host_sleep_until(uint64_t deadline) {
+    struct timespec ts;
+    ts.tv_sec = (time_t)(deadline / 1000000000);
+    ts.tv_nsec = (long)(deadline % 1000000000);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+    }
+}
+
 void clem_host_uuid_gen(ClemensHostUUID *uuid) {
     assert(sizeof(uuid_t) <= sizeof(uuid->data));
     uuid_generate(uuid->data);
 }
 
+bool clem_host_map_file_private(ClemensHostMappedFile *mapped, const char *pathname) {
+    struct stat st;
+    void *data;
+    int fd;
+
+    mapped->data = NULL;
+    mapped->size = 0;
+
+    fd = open(pathname, O_RDONLY);
+    if (fd < 0)
+        return false;
+    if (fstat(fd, &st) < 0 || st.st_size <= 0) {
+        close(fd);
+        return false;
+    }
+    //  PROT_WRITE with MAP_PRIVATE is allowed on a read-only descriptor since
+    //  modified pages are private copies.  The mapping holds its own reference
+    //  to the file so the descriptor can be closed immediately.
+    data = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return false;
+    mapped->data = (uint8_t *)data;
+    mapped->size = (size_t)st.st_size;
+    return true;
+}
+
+void clem_host_unmap_file(ClemensHostMappedFile *mapped) {
+    if (mapped->data) {
+        munmap(mapped->data, mapped->size);
+    }
+    mapped->data = NULL;
+    mapped->size = 0;
+}
+
+#define CLEM_HOST_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+bool clem_host_alloc_pages(ClemensHostPages *pages, size_t size) {
+    const size_t hugePageMask = CLEM_HOST_HUGE_PAGE_SIZE - 1;
+    size_t alignedSize = (size + hugePageMask) & ~hugePageMask;
+    size_t headSize, tailSize;
+    uint8_t *data;
+
+    pages->data = NULL;
+    pages->size = 0;
+    pages->pageType = kClemensHostPages_Normal;
+    if (size == 0)
+        return false;
+
+    //  reserved huge pages are only available if the administrator set aside
+    //  a pool (vm.nr_hugepages), which is rarely the case
+#ifdef MAP_HUGETLB
+    data = mmap(NULL, alignedSize, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (data != MAP_FAILED) {
+        pages->data = data;
+        pages->size = alignedSize;
+        pages->pageType = kClemensHostPages_Huge;
+        return true;
+    }
+#endif
+    //  transparent huge pages need a 2MB aligned range, so map an extra huge
+    //  page and trim the excess on either side
+    data = mmap(NULL, alignedSize + CLEM_HOST_HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (data == MAP_FAILED)
+        return false;
+    headSize = (CLEM_HOST_HUGE_PAGE_SIZE - ((uintptr_t)data & hugePageMask)) & hugePageMask;
+    tailSize = CLEM_HOST_HUGE_PAGE_SIZE - headSize;
+    if (headSize > 0) {
+        munmap(data, headSize);
+    }
+    if (tailSize > 0) {
+        munmap(data + headSize + alignedSize, tailSize);
+    }
+    pages->data = data + headSize;
+    pages->size = alignedSize;
+#ifdef MADV_HUGEPAGE
+    if (madvise(pages->data, alignedSize, MADV_HUGEPAGE) == 0) {
+        pages->pageType = kClemensHostPages_Advised;
+    }
+#endif
+    return true;
+}
+
+void clem_host_free_pages(ClemensHostPages *pages) {
+    if (pages->data) {
+        munmap(pages->data, pages->size);
+    }
+    pages->data = NULL;
+    pages->size = 0;
+    pages->pageType = kClemensHostPages_Normal;
+}
+
 //  evdev implementation
 //  using https://fossies.org/linux/stella/src/tools/evdev-joystick/evdev-joystick.c
 //  as an education of evdev and joystick input.
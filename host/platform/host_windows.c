@@ -20,6 +20,63 @@
 
 unsigned clem_host_get_processor_number() { return (unsigned)GetCurrentProcessorNumber(); }
 
+bool clem_host_thread_set_processor(unsigned processor) {
+    if (processor >= sizeof(DWORD_PTR) * 8)
+        return false;
+    return SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << processor) != 0;
+}
+
+ClemensHostThreadPriority clem_host_thread_set_priority(ClemensHostThreadPriority priority) {
+    if (priority == kClemensHostThreadPriority_Realtime) {
+        if (SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL))
+            return kClemensHostThreadPriority_Realtime;
+        priority = kClemensHostThreadPriority_High;
+    }
+    if (priority == kClemensHostThreadPriority_High) {
+        if (SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_HIGHEST))
+            return kClemensHostThreadPriority_High;
+    }
+    return kClemensHostThreadPriority_Normal;
+}
+
+uint64_t clem_host_timer_ns() {
+    static LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+    if (!frequency.QuadPart) {
+        QueryPerformanceFrequency(&frequency);
+    }
+    QueryPerformanceCounter(&counter);
+    return (uint64_t)(counter.QuadPart / frequency.QuadPart) * 1000000000 +
+           (uint64_t)(counter.QuadPart % frequency.QuadPart) * 1000000000 / frequency.QuadPart;
+}
+
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+void clem_host_sleep_until(uint64_t deadline) {
+    //  waitable timers take absolute times on the system clock, so the wait is
+    //  converted to a relative one (in 100ns units) just before sleeping
+    static __declspec(thread) HANDLE timer = NULL;
+    LARGE_INTEGER dueTime;
+    uint64_t now = clem_host_timer_ns();
+    if (now >= deadline)
+        return;
+    if (!timer) {
+        timer = CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION,
+                                       TIMER_ALL_ACCESS);
+        if (!timer) {
+            timer = CreateWaitableTimerExW(NULL, NULL, 0, TIMER_ALL_ACCESS);
+        }
+    }
+    dueTime.QuadPart = -(LONGLONG)((deadline - now) / 100);
+    if (timer && SetWaitableTimer(timer, &dueTime, 0, NULL, NULL, FALSE)) {
+        WaitForSingleObject(timer, INFINITE);
+    } else {
+        Sleep((DWORD)((deadline - now) / 1000000));
+    }
+}
+
 void clem_host_uuid_gen(ClemensHostUUID *uuid) {
     GUID guid;
     ZeroMemory(&guid, sizeof(guid));
@@ -42,6 +99,105 @@ void clem_host_uuid_gen(ClemensHostUUID *uuid) {
     uuid->data[15] = guid.Data4[7];
 }
 
+bool clem_host_map_file_private(ClemensHostMappedFile *mapped, const char *pathname) {
+    HANDLE file, mapping;
+    LARGE_INTEGER size;
+    void *data;
+
+    mapped->data = NULL;
+    mapped->size = 0;
+
+    file = CreateFileA(pathname, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                       FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart <= 0) {
+        CloseHandle(file);
+        return false;
+    }
+    //  PAGE_WRITECOPY + FILE_MAP_COPY gives private copy-on-write pages.  The
+    //  view keeps the mapping object alive so both handles can be closed now.
+    mapping = CreateFileMappingA(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+    CloseHandle(file);
+    if (!mapping)
+        return false;
+    data = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+    CloseHandle(mapping);
+    if (!data)
+        return false;
+    mapped->data = (uint8_t *)data;
+    mapped->size = (size_t)size.QuadPart;
+    return true;
+}
+
+void clem_host_unmap_file(ClemensHostMappedFile *mapped) {
+    if (mapped->data) {
+        UnmapViewOfFile(mapped->data);
+    }
+    mapped->data = NULL;
+    mapped->size = 0;
+}
+
+static bool enable_lock_memory_privilege() {
+    HANDLE token;
+    TOKEN_PRIVILEGES privileges;
+    BOOL result;
+
+    if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token))
+        return false;
+    privileges.PrivilegeCount = 1;
+    privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+    result = LookupPrivilegeValueA(NULL, "SeLockMemoryPrivilege", &privileges.Privileges[0].Luid);
+    if (result) {
+        //  succeeds without enabling anything if the account lacks the privilege
+        result = AdjustTokenPrivileges(token, FALSE, &privileges, 0, NULL, NULL) &&
+                 GetLastError() == ERROR_SUCCESS;
+    }
+    CloseHandle(token);
+    return result != FALSE;
+}
+
+bool clem_host_alloc_pages(ClemensHostPages *pages, size_t size) {
+    SIZE_T largePageSize = GetLargePageMinimum();
+    SIZE_T alignedSize;
+    void *data = NULL;
+
+    pages->data = NULL;
+    pages->size = 0;
+    pages->pageType = kClemensHostPages_Normal;
+    if (size == 0)
+        return false;
+
+    if (largePageSize == 0) {
+        largePageSize = 2 * 1024 * 1024;
+    } else if (enable_lock_memory_privilege()) {
+        alignedSize = (size + largePageSize - 1) & ~(largePageSize - 1);
+        data = VirtualAlloc(NULL, alignedSize, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES,
+                            PAGE_READWRITE);
+        if (data) {
+            pages->pageType = kClemensHostPages_Huge;
+        }
+    }
+    alignedSize = (size + largePageSize - 1) & ~(largePageSize - 1);
+    if (!data) {
+        data = VirtualAlloc(NULL, alignedSize, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+        if (!data)
+            return false;
+    }
+    pages->data = (uint8_t *)data;
+    pages->size = alignedSize;
+    return true;
+}
+
+void clem_host_free_pages(ClemensHostPages *pages) {
+    if (pages->data) {
+        VirtualFree(pages->data, 0, MEM_RELEASE);
+    }
+    pages->data = NULL;
+    pages->size = 0;
+    pages->pageType = kClemensHostPages_Normal;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 struct ClemensHostJoystickInfo {
     IDirectInputDevice8 *device;
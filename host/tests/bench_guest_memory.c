@@ -0,0 +1,308 @@
+#include "clem_host_platform.h"
+
+#include "clem_mem.h"
+#include "clem_mmio.h"
+#include "clem_mmio_defs.h"
+#include "emulator.h"
+#include "emulator_mmio.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if CLEMENS_PLATFORM_LINUX
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+//  Microbenchmark for guest RAM placement
+//
+//  Random reads and writes through clem_read/clem_write across every FPI bank
+//  model a memory heavy workload (i.e. a GS/OS application using most of an
+//  8MB machine.)  Each access touches a different 4K host page, so with normal
+//  pages nearly every access needs a new TLB entry.  The same machine is run
+//  with its RAM on normal pages and then on the huge page arena the backend
+//  uses.
+//
+//  Data TLB load and store misses are counted with perf events and the
+//  reduction on the arena is reported.  Where the counters can't be opened
+//  (no PMU in a VM, or perf_event_paranoid) the reason is printed and only
+//  timings are reported.  On Linux the amount of the arena actually backed by
+//  huge pages is also reported, since an advised arena may not get any.
+//
+//  Usage: bench_guest_memory [accesses] [ram KB]
+//
+
+#define BENCH_BATCH_COUNT 10
+
+static ClemensMachine machine;
+static ClemensMMIO mmio;
+static uint8_t *rom;
+static uint8_t *e0_bank;
+static uint8_t *e1_bank;
+static uint8_t *card_memory;
+
+//  dTLB load and store miss counters, either of which may be unsupported
+struct BenchTLBCounters {
+    int fds[2];
+    int error;
+};
+
+#if CLEMENS_PLATFORM_LINUX
+static int tlb_counter_open_event(unsigned op) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HW_CACHE;
+    attr.size = sizeof(attr);
+    attr.config =
+        PERF_COUNT_HW_CACHE_DTLB | (op << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static void tlb_counters_open(struct BenchTLBCounters *counters) {
+    counters->error = 0;
+    counters->fds[0] = tlb_counter_open_event(PERF_COUNT_HW_CACHE_OP_READ);
+    if (counters->fds[0] < 0) {
+        counters->error = errno;
+    }
+    counters->fds[1] = tlb_counter_open_event(PERF_COUNT_HW_CACHE_OP_WRITE);
+}
+
+static void tlb_counters_close(struct BenchTLBCounters *counters) {
+    unsigned i;
+    for (i = 0; i < 2; ++i) {
+        if (counters->fds[i] >= 0) {
+            close(counters->fds[i]);
+        }
+    }
+}
+
+static void tlb_counters_start(struct BenchTLBCounters *counters) {
+    unsigned i;
+    for (i = 0; i < 2; ++i) {
+        if (counters->fds[i] < 0)
+            continue;
+        ioctl(counters->fds[i], PERF_EVENT_IOC_RESET, 0);
+        ioctl(counters->fds[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+}
+
+//  Returns the misses counted since the start, or -1 if nothing was counted
+static long long tlb_counters_stop(struct BenchTLBCounters *counters) {
+    long long count, total = -1;
+    unsigned i;
+    for (i = 0; i < 2; ++i) {
+        if (counters->fds[i] < 0)
+            continue;
+        ioctl(counters->fds[i], PERF_EVENT_IOC_DISABLE, 0);
+        if (read(counters->fds[i], &count, sizeof(count)) != sizeof(count))
+            continue;
+        total = total < 0 ? count : total + count;
+    }
+    return total;
+}
+
+static void tlb_counters_print_skip(const struct BenchTLBCounters *counters) {
+    FILE *fp = fopen("/proc/sys/kernel/perf_event_paranoid", "r");
+    int paranoid = 0;
+    if (fp) {
+        if (fscanf(fp, "%d", &paranoid) != 1) {
+            paranoid = 0;
+        }
+        fclose(fp);
+    }
+    printf("SKIP dTLB counts: perf_event_open failed (%s), perf_event_paranoid is %d\n",
+           strerror(counters->error), paranoid);
+}
+
+//  The amount of the mapping at data backed by transparent huge pages, or -1
+static long huge_page_kb(const void *data) {
+    char line[256];
+    unsigned long start, end;
+    long kb = -1;
+    bool is_mapping = false;
+    FILE *fp = fopen("/proc/self/smaps", "r");
+    if (!fp)
+        return -1;
+    while (fgets(line, sizeof(line), fp)) {
+        if (sscanf(line, "%lx-%lx ", &start, &end) == 2) {
+            is_mapping = (uintptr_t)data >= start && (uintptr_t)data < end;
+        } else if (is_mapping && sscanf(line, "AnonHugePages: %ld kB", &kb) == 1) {
+            break;
+        }
+    }
+    fclose(fp);
+    return kb;
+}
+#else
+static void tlb_counters_open(struct BenchTLBCounters *counters) {
+    counters->fds[0] = counters->fds[1] = -1;
+    counters->error = 0;
+}
+static void tlb_counters_close(struct BenchTLBCounters *counters) { (void)counters; }
+static void tlb_counters_start(struct BenchTLBCounters *counters) { (void)counters; }
+static long long tlb_counters_stop(struct BenchTLBCounters *counters) {
+    (void)counters;
+    return -1;
+}
+static void tlb_counters_print_skip(const struct BenchTLBCounters *counters) {
+    (void)counters;
+    printf("SKIP dTLB counts: no perf event support on this platform\n");
+}
+static long huge_page_kb(const void *data) {
+    (void)data;
+    return -1;
+}
+#endif
+
+static void bench_setup(uint8_t *fpi_ram, unsigned bank_count) {
+    memset(&machine, 0, sizeof(machine));
+    memset(&mmio, 0, sizeof(mmio));
+    clemens_init(&machine, CLEM_CLOCKS_MEGA2_CYCLE, CLEM_CLOCKS_FAST_CYCLE, rom,
+                 CLEM_IIGS_ROM3_SIZE, e0_bank, e1_bank, fpi_ram, bank_count);
+    clem_mmio_init(&mmio, &machine.dev_debug, machine.mem.bank_page_map,
+                   machine.tspec.clocks_step_mega2, card_memory, bank_count);
+    mmio.state_type = kClemensMMIOStateType_Reset;
+    clemens_emulate_mmio(&machine, &mmio);
+}
+
+//  Returns the dTLB misses for all accesses, or -1 if they weren't counted
+static long long bench_run(const char *name, unsigned long accesses, unsigned bank_count) {
+    clock_t t0, t1;
+    double secs, best_secs = 0.0;
+    long long misses, best_misses = -1;
+    uint32_t seed = 0x2545f491;
+    unsigned long i;
+    unsigned batch;
+    uint8_t bank, value, sum = 0;
+    struct BenchTLBCounters counters;
+
+    tlb_counters_open(&counters);
+    for (batch = 0; batch < BENCH_BATCH_COUNT; ++batch) {
+        tlb_counters_start(&counters);
+        t0 = clock();
+        for (i = 0; i < accesses / BENCH_BATCH_COUNT; ++i) {
+            //  xorshift32 picks the bank and address
+            seed ^= seed << 13;
+            seed ^= seed >> 17;
+            seed ^= seed << 5;
+            //  banks 00 and 01 hold I/O and shadowed pages, so the rest of RAM
+            bank = (uint8_t)(2 + (seed >> 16) % (bank_count - 2));
+            if (seed & 0x80000000) {
+                clem_write(&machine, (uint8_t)i, (uint16_t)seed, bank, CLEM_MEM_FLAG_DATA);
+            } else {
+                clem_read(&machine, &value, (uint16_t)seed, bank, CLEM_MEM_FLAG_DATA);
+                sum += value;
+            }
+        }
+        t1 = clock();
+        misses = tlb_counters_stop(&counters);
+        secs = (double)(t1 - t0) / CLOCKS_PER_SEC;
+        if (batch == 0 || secs < best_secs) {
+            best_secs = secs;
+        }
+        if (misses >= 0 && (best_misses < 0 || misses < best_misses)) {
+            best_misses = misses;
+        }
+    }
+    if (best_misses < 0 && !strcmp(name, "normal pages")) {
+        tlb_counters_print_skip(&counters);
+    }
+    tlb_counters_close(&counters);
+    printf("%-24s %10lu accesses %8.2f ns/access", name, accesses,
+           best_secs * 1e9 * BENCH_BATCH_COUNT / accesses);
+    if (best_misses >= 0) {
+        best_misses *= BENCH_BATCH_COUNT;
+        printf(" %12lld dTLB misses", best_misses);
+    }
+    printf(" [%02x]\n", sum);
+    return best_misses;
+}
+
+int main(int argc, char *argv[]) {
+    unsigned long accesses = 50000000;
+    unsigned ram_kb = 8192;
+    unsigned bank_count;
+    size_t ram_size;
+    uint8_t *normal_ram;
+    ClemensHostPages pages;
+    const char *page_type_name;
+    long long normal_misses, arena_misses;
+    long normal_huge_kb, arena_huge_kb;
+
+    if (argc > 1) {
+        accesses = strtoul(argv[1], NULL, 10);
+    }
+    if (argc > 2) {
+        ram_kb = (unsigned)strtoul(argv[2], NULL, 10);
+    }
+    bank_count = ram_kb / 64;
+    if (bank_count < 4)
+        bank_count = 4;
+    if (bank_count > 128)
+        bank_count = 128;
+    ram_size = (size_t)bank_count * CLEM_IIGS_BANK_SIZE;
+
+    rom = calloc(CLEM_IIGS_ROM3_SIZE, 1);
+    e0_bank = malloc(CLEM_IIGS_BANK_SIZE);
+    e1_bank = malloc(CLEM_IIGS_BANK_SIZE);
+    card_memory = calloc(CLEM_IIGS_EXPANSION_ROM_SIZE * 7, 1);
+
+    //  the baseline opts out of transparent huge pages, which a host set to
+    //  "always" would otherwise apply to any large allocation
+#if CLEMENS_PLATFORM_LINUX
+    normal_ram = mmap(NULL, ram_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (normal_ram == MAP_FAILED)
+        return 1;
+#ifdef MADV_NOHUGEPAGE
+    madvise(normal_ram, ram_size, MADV_NOHUGEPAGE);
+#endif
+#else
+    normal_ram = malloc(ram_size);
+    if (!normal_ram)
+        return 1;
+#endif
+    bench_setup(normal_ram, bank_count);
+    normal_misses = bench_run("normal pages", accesses, bank_count);
+    normal_huge_kb = huge_page_kb(normal_ram);
+
+    if (!clem_host_alloc_pages(&pages, ram_size)) {
+        printf("huge page arena unavailable\n");
+        return 1;
+    }
+    switch (pages.pageType) {
+    case kClemensHostPages_Huge:
+        page_type_name = "huge pages";
+        break;
+    case kClemensHostPages_Advised:
+        page_type_name = "transparent huge pages";
+        break;
+    default:
+        page_type_name = "arena (normal pages)";
+        break;
+    }
+    bench_setup(pages.data, bank_count);
+    arena_misses = bench_run(page_type_name, accesses, bank_count);
+    //  pages are only backed once touched, so this is checked after the run
+    arena_huge_kb = huge_page_kb(pages.data);
+    clem_host_free_pages(&pages);
+
+    printf("%u KB RAM in %u banks\n", bank_count * 64, bank_count);
+    if (normal_huge_kb >= 0 && arena_huge_kb >= 0) {
+        printf("transparent huge pages backing RAM: %ld KB normal, %ld KB arena\n",
+               normal_huge_kb, arena_huge_kb);
+    }
+    if (normal_misses > 0 && arena_misses >= 0) {
+        printf("dTLB misses reduced by %.1f%%\n",
+               100.0 * (double)(normal_misses - arena_misses) / (double)normal_misses);
+    }
+    return 0;
+}
@@ -0,0 +1,125 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h.h"
+
+#include "clem_batch_script.hpp"
+
+#include "clem_mmio.h"
+#include "clem_mmio_defs.h"
+#include "emulator.h"
+#include "emulator_mmio.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::vector<std::pair<unsigned, std::string>> readAll(ClemensBatchScript &script) {
+    std::vector<std::pair<unsigned, std::string>> statements;
+    std::string_view statement;
+    while (script.next(statement)) {
+        statements.emplace_back(script.getLineNumber(), std::string(statement));
+    }
+    return statements;
+}
+
+//  A machine with blank ROM and RAM, enough for memory and video queries
+struct TestMachine {
+    ClemensMachine machine;
+    ClemensMMIO mmio;
+    std::vector<void *> allocations;
+
+    TestMachine() {
+        memset(&machine, 0, sizeof(machine));
+        memset(&mmio, 0, sizeof(mmio));
+        clemens_init(&machine, CLEM_CLOCKS_MEGA2_CYCLE, CLEM_CLOCKS_FAST_CYCLE,
+                     alloc(CLEM_IIGS_ROM3_SIZE), CLEM_IIGS_ROM3_SIZE, alloc(CLEM_IIGS_BANK_SIZE),
+                     alloc(CLEM_IIGS_BANK_SIZE), alloc(CLEM_IIGS_BANK_SIZE * 4), 4);
+        clem_mmio_init(&mmio, &machine.dev_debug, machine.mem.bank_page_map,
+                       machine.tspec.clocks_step_mega2, alloc(2048 * 7), 4);
+        mmio.state_type = kClemensMMIOStateType_Reset;
+        clemens_emulate_mmio(&machine, &mmio);
+    }
+    ~TestMachine() {
+        for (auto *allocation : allocations) {
+            free(allocation);
+        }
+    }
+
+    void *alloc(size_t size) { return allocations.emplace_back(calloc(size, 1)); }
+
+    //  Writes normal (high bit set) characters to the first text page
+    void writeText(unsigned row, unsigned column, const char *text) {
+        ClemensVideo video{};
+        REQUIRE(clemens_get_text_video(&video, &mmio));
+        uint8_t *bank = machine.mem.mega2_bank_map[0];
+        unsigned offset = video.scanlines[video.scanline_start + row].offset + column;
+        for (; *text; ++text) {
+            bank[offset++] = uint8_t(*text) | 0x80;
+        }
+    }
+};
+
+} // namespace
+
+TEST_CASE("Script comments, blank lines and statement separators") {
+    ClemensBatchScript script;
+    script.loadText("// boot the disk\n"
+                    "\n"
+                    "timeout #1000000\n"
+                    "  wait text,\"READY // ; \\\"OK\\\"\"  // comment\n"
+                    "type \"RUN\\r\"; wait pc,$00/0300 ;\n"
+                    "expect $e1/0400,c1",
+                    "test.script");
+    CHECK(script.getName() == "test.script");
+    auto statements = readAll(script);
+    REQUIRE(statements.size() == 5);
+    CHECK(statements[0] == std::make_pair(3u, std::string("timeout #1000000")));
+    CHECK(statements[1] ==
+          std::make_pair(4u, std::string("wait text,\"READY // ; \\\"OK\\\"\"")));
+    CHECK(statements[2] == std::make_pair(5u, std::string("type \"RUN\\r\"")));
+    CHECK(statements[3] == std::make_pair(5u, std::string("wait pc,$00/0300")));
+    CHECK(statements[4] == std::make_pair(6u, std::string("expect $e1/0400,c1")));
+    CHECK(script.isDone());
+}
+
+TEST_CASE("An empty script is done") {
+    ClemensBatchScript script;
+    script.loadText("// nothing to do\n\n", "empty");
+    CHECK(script.isDone());
+    std::string_view statement;
+    CHECK_FALSE(script.next(statement));
+    CHECK_FALSE(script.load("this/script/does/not/exist"));
+}
+
+TEST_CASE("Memory is read without side effects") {
+    TestMachine test;
+    uint8_t value = 0;
+    test.machine.mem.mega2_bank_map[1][0x0400] = 0xa5;
+    CHECK(peekMemory(&test.machine, 0xe10400, value));
+    CHECK(value == 0xa5);
+    test.machine.mem.mega2_bank_map[0][0x2000] = 0x3c;
+    CHECK(peekMemory(&test.machine, 0xe02000, value));
+    CHECK(value == 0x3c);
+    //  I/O reads are never peeked
+    CHECK_FALSE(peekMemory(&test.machine, 0x00c000, value));
+}
+
+TEST_CASE("The text page is decoded") {
+    TestMachine test;
+    test.writeText(0, 0, "APPLE IIGS");
+    test.writeText(23, 30, "]RUN");
+    //  inverse characters read as normal ones
+    ClemensVideo video{};
+    REQUIRE(clemens_get_text_video(&video, &test.mmio));
+    test.machine.mem.mega2_bank_map[0][video.scanlines[video.scanline_start + 1].offset] = 0x01;
+
+    std::vector<std::string> rows;
+    readScreenText(&test.machine, &test.mmio, rows);
+    REQUIRE(rows.size() == 24);
+    CHECK(rows[0].size() == 40);
+    CHECK(rows[0].rfind("APPLE IIGS", 0) == 0);
+    CHECK(rows[1][0] == 'A');
+    CHECK(rows[23].find("]RUN") == 30);
+}
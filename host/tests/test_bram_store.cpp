@@ -0,0 +1,208 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h.h"
+
+#include "clem_bram_store.hpp"
+
+#include <array>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+
+#if defined(_WIN32)
+#include <process.h>
+#define getpid _getpid
+#else
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+using BRAM = std::array<uint8_t, CLEM_RTC_BRAM_SIZE>;
+
+//  every image written by these tests is a single byte repeated, so a torn
+//  write shows up as a mix of bytes
+BRAM makeImage(uint8_t value) {
+    BRAM bram;
+    bram.fill(value);
+    return bram;
+}
+
+bool isWholeImage(const BRAM &bram) {
+    for (auto byte : bram) {
+        if (byte != bram[0])
+            return false;
+    }
+    return true;
+}
+
+std::string makeTestPath(const char *name) {
+    auto path = std::filesystem::temp_directory_path() /
+                (std::string(name) + "." + std::to_string(getpid()) + ".bram");
+    std::filesystem::remove(path);
+    std::filesystem::remove(path.string() + ".tmp");
+    return path.string();
+}
+
+} // namespace
+
+TEST_CASE("BRAM round trips through the store") {
+    auto path = makeTestPath("clem_bram_roundtrip");
+    BRAM image = makeImage(0x5a), loaded = makeImage(0);
+    {
+        ClemensBRAMStore store(path);
+        CHECK_FALSE(store.load(loaded.data()));
+        CHECK(loaded == makeImage(0));
+        CHECK(store.save(image.data()));
+    }
+    ClemensBRAMStore store(path);
+    CHECK(store.load(loaded.data()));
+    CHECK(loaded == image);
+    CHECK_FALSE(std::filesystem::exists(path + ".tmp"));
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("A truncated BRAM file is not loaded") {
+    auto path = makeTestPath("clem_bram_truncated");
+    {
+        std::ofstream out(path, std::ios::binary);
+        out.write("\x01\x02\x03", 3);
+    }
+    BRAM loaded = makeImage(0x11);
+    ClemensBRAMStore store(path);
+    CHECK_FALSE(store.load(loaded.data()));
+    CHECK(loaded == makeImage(0x11));
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("BRAM writes are debounced") {
+    using namespace std::chrono_literals;
+    auto path = makeTestPath("clem_bram_debounce");
+    ClemensBRAMStore store(path);
+    BRAM image = makeImage(0x01);
+    auto t0 = ClemensBRAMStore::Clock::time_point{};
+
+    //  a change waits for the BRAM to settle
+    CHECK(store.update(image.data(), true, t0));
+    CHECK(store.hasPendingChanges());
+    CHECK_FALSE(std::filesystem::exists(path));
+    image = makeImage(0x02);
+    CHECK(store.update(image.data(), true, t0 + 500ms));
+    CHECK(store.update(image.data(), false, t0 + 1200ms));
+    CHECK(store.hasPendingChanges());
+    CHECK(store.update(image.data(), false, t0 + 1500ms));
+    CHECK_FALSE(store.hasPendingChanges());
+    BRAM loaded;
+    CHECK(ClemensBRAMStore(path).load(loaded.data()));
+    CHECK(loaded == makeImage(0x02));
+
+    //  constant changes are still written within a bounded delay
+    auto t1 = t0 + 10s;
+    for (unsigned i = 0; i < 60; ++i) {
+        image = makeImage(uint8_t(0x10 + i));
+        CHECK(store.update(image.data(), true, t1 + i * 100ms));
+    }
+    CHECK(ClemensBRAMStore(path).load(loaded.data()));
+    CHECK(loaded[0] >= 0x10);
+    CHECK(isWholeImage(loaded));
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("A failed write stays pending and is retried") {
+    using namespace std::chrono_literals;
+    auto directory = std::filesystem::path(makeTestPath("clem_bram_retry")).replace_extension();
+    std::filesystem::remove_all(directory);
+    auto path = (directory / "bram.bram").string();
+    ClemensBRAMStore store(path);
+    BRAM image = makeImage(0x33);
+    auto t0 = ClemensBRAMStore::Clock::time_point{};
+
+    //  the directory doesn't exist yet, so the write fails
+    CHECK_FALSE(store.save(image.data()));
+    CHECK(store.hasPendingChanges());
+    CHECK_FALSE(store.update(image.data(), false, t0 + 10s));
+    CHECK(store.hasPendingChanges());
+    CHECK_FALSE(std::filesystem::exists(path + ".tmp"));
+
+    //  the next update once the file can be written saves the image
+    REQUIRE(std::filesystem::create_directories(directory));
+    image = makeImage(0x44);
+    CHECK(store.update(image.data(), false, t0 + 11s));
+    CHECK_FALSE(store.hasPendingChanges());
+    BRAM loaded = makeImage(0);
+    CHECK(ClemensBRAMStore(path).load(loaded.data()));
+    CHECK(loaded == makeImage(0x33));
+    std::filesystem::remove_all(directory);
+}
+
+TEST_CASE("Failed writes back off and are reported once") {
+    using namespace std::chrono_literals;
+    auto directory = std::filesystem::path(makeTestPath("clem_bram_backoff")).replace_extension();
+    std::filesystem::remove_all(directory);
+    auto path = (directory / "bram.bram").string();
+    ClemensBRAMStore store(path);
+    BRAM image = makeImage(0x55);
+    auto t0 = ClemensBRAMStore::Clock::time_point{} + 1h;
+
+    CHECK(store.update(image.data(), true, t0));
+    CHECK_FALSE(store.update(image.data(), false, t0 + 1s));
+    //  later failures in the same run are not reported again
+    CHECK(store.update(image.data(), false, t0 + 2s));
+    CHECK(store.update(image.data(), false, t0 + 4s));
+    CHECK(store.hasPendingChanges());
+
+    //  no write is tried until the retry delay, which has doubled twice
+    REQUIRE(std::filesystem::create_directories(directory));
+    CHECK(store.update(image.data(), false, t0 + 7s));
+    CHECK(store.hasPendingChanges());
+    CHECK_FALSE(std::filesystem::exists(path));
+    CHECK(store.update(image.data(), false, t0 + 8s));
+    CHECK_FALSE(store.hasPendingChanges());
+    BRAM loaded = makeImage(0);
+    CHECK(ClemensBRAMStore(path).load(loaded.data()));
+    CHECK(loaded == image);
+
+    //  a failure after a successful write is reported again
+    std::filesystem::remove_all(directory);
+    image = makeImage(0x66);
+    CHECK(store.update(image.data(), true, t0 + 20s));
+    CHECK_FALSE(store.update(image.data(), false, t0 + 21s));
+    std::filesystem::remove_all(directory);
+}
+
+#if !defined(_WIN32)
+TEST_CASE("Killing a writer never leaves a torn BRAM file") {
+    auto path = makeTestPath("clem_bram_kill");
+    {
+        auto initial = makeImage(0xff);
+        REQUIRE(ClemensBRAMStore(path).save(initial.data()));
+    }
+    std::mt19937 rng(1234);
+    std::uniform_int_distribution<int> delayUs(0, 3000);
+    for (unsigned round = 0; round < 40; ++round) {
+        pid_t child = fork();
+        REQUIRE(child >= 0);
+        if (child == 0) {
+            ClemensBRAMStore store(path);
+            for (unsigned value = 0;; ++value) {
+                auto image = makeImage(uint8_t(value));
+                store.save(image.data());
+            }
+        }
+        usleep(useconds_t(delayUs(rng)));
+        kill(child, SIGKILL);
+        int status = 0;
+        waitpid(child, &status, 0);
+
+        BRAM loaded = makeImage(0);
+        CHECK(std::filesystem::file_size(path) == CLEM_RTC_BRAM_SIZE);
+        REQUIRE(ClemensBRAMStore(path).load(loaded.data()));
+        CHECK(isWholeImage(loaded));
+    }
+    std::filesystem::remove(path);
+    std::filesystem::remove(path + ".tmp");
+}
+#endif
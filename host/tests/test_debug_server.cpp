@@ -0,0 +1,334 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h.h"
+
+#include "clem_backend.hpp"
+#include "clem_debug_server.hpp"
+
+#include "fmt/format.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+void feed(ClemensDebugPacketReader &reader, std::string_view data) {
+    reader.feed(reinterpret_cast<const uint8_t *>(data.data()), data.size());
+}
+
+#if !defined(_WIN32)
+
+constexpr int kReplyTimeoutMs = 10000;
+
+std::string makeTestPath(const char *name) {
+    auto path = std::filesystem::temp_directory_path() /
+                (std::string(name) + "." + std::to_string(getpid()));
+    std::filesystem::remove_all(path);
+    return path.string();
+}
+
+int connectTo(const std::string &socketPath) {
+    struct sockaddr_un addr {};
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path, socketPath.data(), socketPath.size());
+    if (connect(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+//  A headless machine without a ROM (its zeroed ROM leaves the CPU looping on
+//  BRK) served by a debug server, with a client connected to it
+class TestDebugSession {
+  public:
+    TestDebugSession()
+        : socketPath_(makeTestPath("clem_debug_server_socket")),
+          bramPath_(makeTestPath("clem_debug_server_bram")), server_(socketPath_),
+          backend_("", makeConfig(bramPath_),
+                   [this](const ClemensBackendState &state) { publish(state); }),
+          clientFd_(-1) {
+        backend_.setRefreshFrequency(60);
+        backend_.reset();
+        backend_.run();
+        server_.start(backend_);
+        clientFd_ = connectTo(socketPath_);
+    }
+    ~TestDebugSession() {
+        if (clientFd_ >= 0) {
+            close(clientFd_);
+        }
+        server_.stop();
+        std::filesystem::remove(bramPath_);
+    }
+
+    bool isConnected() const { return clientFd_ >= 0; }
+
+    //  Sends a packet and returns the reply's payload
+    std::string request(std::string_view payload) {
+        auto packet = ClemensDebugPacketReader::frame(payload);
+        if (send(clientFd_, packet.data(), packet.size(), MSG_NOSIGNAL) != ssize_t(packet.size()))
+            return "<send failed>";
+        std::string reply;
+        uint8_t chunk[4096];
+        while (reader_.next(reply) != ClemensDebugPacketReader::Event::Packet) {
+            struct pollfd fds = {clientFd_, POLLIN, 0};
+            if (poll(&fds, 1, kReplyTimeoutMs) <= 0)
+                return "<no reply>";
+            ssize_t readCount = recv(clientFd_, chunk, sizeof(chunk), 0);
+            if (readCount <= 0)
+                return "<disconnected>";
+            reader_.feed(chunk, size_t(readCount));
+        }
+        return reply;
+    }
+
+    //  The backend's breakpoints as of the last publish
+    std::vector<ClemensBackendBreakpoint> getBreakpoints() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return breakpoints_;
+    }
+
+    unsigned countBreakpoints(ClemensBackendBreakpoint::Type type, uint32_t address) {
+        auto breakpoints = getBreakpoints();
+        return unsigned(std::count_if(breakpoints.begin(), breakpoints.end(),
+                                      [type, address](const ClemensBackendBreakpoint &bp) {
+                                          return bp.type == type && bp.address == address;
+                                      }));
+    }
+
+  private:
+    static ClemensBackend::Config makeConfig(const std::string &bramPath) {
+        ClemensBackend::Config config{};
+        config.type = ClemensBackendConfig::Type::Apple2GS;
+        config.audioSamplesPerSecond = 48000;
+        config.bramPathname = bramPath;
+        config.rtcEpochTime = 0;
+        return config;
+    }
+
+    void publish(const ClemensBackendState &state) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            breakpoints_.assign(state.bpBufferStart, state.bpBufferEnd);
+        }
+        server_.publish(state);
+    }
+
+    std::string socketPath_;
+    std::string bramPath_;
+    std::mutex mutex_;
+    std::vector<ClemensBackendBreakpoint> breakpoints_;
+    ClemensDebugServer server_;
+    ClemensBackend backend_;
+    ClemensDebugPacketReader reader_;
+    int clientFd_;
+};
+
+#endif
+
+} // namespace
+
+TEST_CASE("Packets are framed with a checksum") {
+    CHECK(ClemensDebugPacketReader::frame("") == "$#00");
+    CHECK(ClemensDebugPacketReader::frame("OK") == "$OK#9a");
+    CHECK(ClemensDebugPacketReader::frame("S05") == "$S05#b8");
+}
+
+TEST_CASE("Packets are read as they arrive") {
+    ClemensDebugPacketReader reader;
+    std::string payload;
+    feed(reader, "+$m1000");
+    CHECK(reader.next(payload) == ClemensDebugPacketReader::Event::None);
+    feed(reader, ",10#");
+    CHECK(reader.next(payload) == ClemensDebugPacketReader::Event::None);
+    feed(reader, "bb$g#67");
+    CHECK(reader.next(payload) == ClemensDebugPacketReader::Event::Packet);
+    CHECK(payload == "m1000,10");
+    CHECK(reader.next(payload) == ClemensDebugPacketReader::Event::Packet);
+    CHECK(payload == "g");
+    CHECK(reader.next(payload) == ClemensDebugPacketReader::Event::None);
+}
+
+TEST_CASE("A bad checksum is reported and skipped") {
+    ClemensDebugPacketReader reader;
+    std::string payload;
+    feed(reader, "$g#00$?#3f");
+    CHECK(reader.next(payload) == ClemensDebugPacketReader::Event::BadPacket);
+    CHECK(reader.next(payload) == ClemensDebugPacketReader::Event::Packet);
+    CHECK(payload == "?");
+}
+
+TEST_CASE("Escaped bytes round trip") {
+    ClemensDebugPacketReader reader;
+    std::string payload;
+    std::string_view data = "M0,4:$#}*";
+    auto packet = ClemensDebugPacketReader::frame(data);
+    CHECK(packet.find('$', 1) == std::string::npos);
+    feed(reader, packet);
+    CHECK(reader.next(payload) == ClemensDebugPacketReader::Event::Packet);
+    CHECK(payload == data);
+}
+
+TEST_CASE("A break outside a packet is an interrupt") {
+    ClemensDebugPacketReader reader;
+    std::string payload;
+    feed(reader, "\x03$c#63");
+    CHECK(reader.next(payload) == ClemensDebugPacketReader::Event::Interrupt);
+    CHECK(reader.next(payload) == ClemensDebugPacketReader::Event::Packet);
+    CHECK(payload == "c");
+}
+
+#if !defined(_WIN32)
+
+TEST_CASE("Only a stale socket at the path is replaced") {
+    auto socketPath = makeTestPath("clem_debug_server_path");
+    {
+        //  a socket file left behind by a server that went away
+        struct sockaddr_un addr {};
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        REQUIRE(fd >= 0);
+        addr.sun_family = AF_UNIX;
+        memcpy(addr.sun_path, socketPath.data(), socketPath.size());
+        REQUIRE(bind(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) == 0);
+        close(fd);
+        ClemensDebugServer server(socketPath);
+        CHECK(server.isListening());
+    }
+    CHECK_FALSE(std::filesystem::exists(socketPath));
+    {
+        std::ofstream out(socketPath);
+        out << "not a socket";
+    }
+    {
+        ClemensDebugServer server(socketPath);
+        CHECK_FALSE(server.isListening());
+    }
+    struct stat pathStat;
+    REQUIRE(lstat(socketPath.c_str(), &pathStat) == 0);
+    CHECK(S_ISREG(pathStat.st_mode));
+    std::filesystem::remove(socketPath);
+}
+
+TEST_CASE("Registers are read and written at their packet offsets") {
+    TestDebugSession session;
+    REQUIRE(session.isConnected());
+    REQUIRE(session.request("?") == "S05");
+    //  the machine is in emulation mode after a reset, so X, Y and the low
+    //  byte of S are 8-bit and only M and X of P can be written
+    const char *kRegisterValues[] = {"3412", "5600", "7800", "f001", "0003",
+                                     "0020", "30",   "12",   "05",   "01"};
+    std::string regs;
+    for (auto *value : kRegisterValues) {
+        regs += value;
+    }
+    CHECK(session.request("G" + regs) == "OK");
+    CHECK(session.request("g") == regs);
+    for (unsigned index = 0; index < 10; ++index) {
+        CHECK(session.request(fmt::format("p{:x}", index)) == kRegisterValues[index]);
+    }
+    CHECK(session.request("pa") == "E01");
+    CHECK(session.request("G3412") == "E01");
+
+    CHECK(session.request("P0=cdab") == "OK");
+    CHECK(session.request("P5=0030") == "OK");
+    CHECK(session.request("P8=07") == "OK");
+    CHECK(session.request("p0") == "cdab");
+    CHECK(session.request("p5") == "0030");
+    CHECK(session.request("p8") == "07");
+    //  E is read-only
+    CHECK(session.request("P9=00") == "E01");
+    CHECK(session.request("p9") == "01");
+}
+
+TEST_CASE("Memory reads and writes stay within the address space") {
+    TestDebugSession session;
+    REQUIRE(session.isConnected());
+    REQUIRE(session.request("?") == "S05");
+    CHECK(session.request("M300,4:deadbeef") == "OK");
+    CHECK(session.request("m300,4") == "deadbeef");
+    CHECK(session.request("m2ff,6") == "00deadbeef00");
+    CHECK(session.request("M300,0:") == "OK");
+    CHECK(session.request("m300,0") == "");
+    //  the length must match the data
+    CHECK(session.request("M300,2:aabbcc") == "E01");
+    CHECK(session.request("M300,2:aa") == "E01");
+    CHECK(session.request("m300,4") == "deadbeef");
+
+    CHECK(session.request("mffffff,1").size() == 2);
+    CHECK(session.request("mffffff,2") == "E01");
+    CHECK(session.request("m1000000,1") == "E01");
+    CHECK(session.request("Mfffffe,4:00000000") == "E01");
+    CHECK(session.request("M1000000,1:00") == "E01");
+    //  reads are capped to fit a reply packet
+    CHECK(session.request("m0,1ff0").size() == 0x1ff0 * 2);
+    CHECK(session.request("m0,1ff1") == "E01");
+    CHECK(session.request("m300") == "E01");
+}
+
+TEST_CASE("Watchpoints cover each byte and are removed by index") {
+    using Breakpoint = ClemensBackendBreakpoint;
+    TestDebugSession session;
+    REQUIRE(session.isConnected());
+    REQUIRE(session.request("?") == "S05");
+
+    CHECK(session.request("Z0,2000,1") == "OK");
+    CHECK(session.request("Z2,300,3") == "OK");
+    CHECK(session.request("Z3,400,2") == "OK");
+    CHECK(session.request("Z4,e10500,2") == "OK");
+    CHECK(session.getBreakpoints().size() == 1 + 3 + 2 + 4);
+    CHECK(session.countBreakpoints(Breakpoint::Execute, 0x2000) == 1);
+    for (uint32_t address = 0x300; address < 0x303; ++address) {
+        CHECK(session.countBreakpoints(Breakpoint::Write, address) == 1);
+        CHECK(session.countBreakpoints(Breakpoint::DataRead, address) == 0);
+    }
+    CHECK(session.countBreakpoints(Breakpoint::Write, 0x303) == 0);
+    for (uint32_t address = 0x400; address < 0x402; ++address) {
+        CHECK(session.countBreakpoints(Breakpoint::Write, address) == 0);
+        CHECK(session.countBreakpoints(Breakpoint::DataRead, address) == 1);
+    }
+    for (uint32_t address = 0xe10500; address < 0xe10502; ++address) {
+        CHECK(session.countBreakpoints(Breakpoint::Write, address) == 1);
+        CHECK(session.countBreakpoints(Breakpoint::DataRead, address) == 1);
+    }
+    //  watched ranges are limited, and an unknown kind is unsupported
+    CHECK(session.request("Z2,300,0") == "E01");
+    CHECK(session.request("Z2,300,11") == "E01");
+    CHECK(session.request("Z2,fffffe,4") == "E01");
+    CHECK(session.request("Z5,300,1") == "");
+    CHECK(session.getBreakpoints().size() == 10);
+
+    //  removing from the middle of a range leaves the rest
+    CHECK(session.request("z2,301,1") == "OK");
+    CHECK(session.getBreakpoints().size() == 9);
+    CHECK(session.countBreakpoints(Breakpoint::Write, 0x300) == 1);
+    CHECK(session.countBreakpoints(Breakpoint::Write, 0x301) == 0);
+    CHECK(session.countBreakpoints(Breakpoint::Write, 0x302) == 1);
+    //  the kind must match
+    CHECK(session.request("z3,300,1") == "E01");
+    CHECK(session.request("z4,e10500,2") == "OK");
+    CHECK(session.getBreakpoints().size() == 5);
+    CHECK(session.request("z3,400,2") == "OK");
+    CHECK(session.request("z0,2000,1") == "OK");
+    CHECK(session.request("z2,300,3") == "OK");
+    CHECK(session.getBreakpoints().empty());
+    CHECK(session.request("z0,2000,1") == "E01");
+}
+
+#endif
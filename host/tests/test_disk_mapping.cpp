@@ -0,0 +1,137 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h.h"
+
+#include "clem_disk_utils.hpp"
+#include "clem_host_platform.h"
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+
+constexpr unsigned kTrackCount = 35;
+constexpr unsigned kTrackByteCount = CLEM_DISK_525_BYTES_PER_TRACK;
+
+//  Writes a 5.25" WOZ image where every byte of a track holds its track number
+std::string makeTestImage(const char *name) {
+    std::vector<uint8_t> bits(kTrackCount * kTrackByteCount);
+    ClemensNibbleDisk nib{};
+    nib.disk_type = CLEM_DISK_TYPE_5_25;
+    nib.bit_timing_ns = 4000;
+    nib.track_count = kTrackCount;
+    std::fill(std::begin(nib.meta_track_map), std::end(nib.meta_track_map), 0xff);
+    for (unsigned trackIndex = 0; trackIndex < kTrackCount; ++trackIndex) {
+        nib.meta_track_map[trackIndex * 4] = uint8_t(trackIndex);
+        nib.track_byte_offset[trackIndex] = trackIndex * kTrackByteCount;
+        nib.track_byte_count[trackIndex] = kTrackByteCount;
+        nib.track_bits_count[trackIndex] = kTrackByteCount * 8;
+        nib.track_initialized[trackIndex] = 1;
+        std::fill_n(bits.begin() + trackIndex * kTrackByteCount, kTrackByteCount,
+                    uint8_t(trackIndex));
+    }
+    nib.bits_data = bits.data();
+    nib.bits_data_end = bits.data() + bits.size();
+
+    ClemensWOZDisk woz{};
+    REQUIRE(ClemensDiskUtilities::createWOZ(&woz, &nib));
+    std::vector<uint8_t> image(CLEM_DISK_525_MAX_DATA_SIZE + 4096);
+    size_t imageSize = image.size();
+    REQUIRE(clem_woz_serialize(&woz, image.data(), &imageSize));
+
+    auto path = std::filesystem::temp_directory_path() /
+                (std::string(name) + "." + std::to_string(getpid()) + ".woz");
+    std::ofstream out(path, std::ios_base::out | std::ios_base::binary);
+    out.write(reinterpret_cast<const char *>(image.data()), std::streamsize(imageSize));
+    REQUIRE(out.good());
+    return path.string();
+}
+
+std::vector<uint8_t> readFile(const std::string &path) {
+    std::ifstream in(path, std::ios_base::in | std::ios_base::binary);
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(in),
+                                std::istreambuf_iterator<char>());
+}
+
+} // namespace
+
+TEST_CASE("Tracks reference the mapped image") {
+    auto imagePath = makeTestImage("clem_disk_mapping_tracks");
+    ClemensHostMappedFile mapping{};
+    REQUIRE(clem_host_map_file_private(&mapping, imagePath.c_str()));
+    CHECK(mapping.size == std::filesystem::file_size(imagePath));
+
+    ClemensNibbleDisk nib{};
+    ClemensWOZDisk woz{};
+    woz.nib = &nib;
+    cinek::Range<uint8_t> mapBuffer(mapping.data, mapping.data + mapping.size);
+    REQUIRE(ClemensDiskUtilities::mapWOZ(&woz, mapBuffer));
+    CHECK(nib.bits_data >= mapping.data);
+    CHECK(nib.bits_data_end <= mapping.data + mapping.size);
+    CHECK(nib.disk_type == CLEM_DISK_TYPE_5_25);
+    for (unsigned trackIndex = 0; trackIndex < kTrackCount; ++trackIndex) {
+        REQUIRE(nib.track_initialized[trackIndex]);
+        CHECK(nib.track_byte_count[trackIndex] == kTrackByteCount);
+        auto *track = nib.bits_data + nib.track_byte_offset[trackIndex];
+        CHECK(track[0] == trackIndex);
+        CHECK(track[kTrackByteCount - 1] == trackIndex);
+    }
+    CHECK_FALSE(nib.track_initialized[kTrackCount]);
+
+    clem_host_unmap_file(&mapping);
+    CHECK(mapping.data == nullptr);
+    CHECK(mapping.size == 0);
+    std::filesystem::remove(imagePath);
+}
+
+TEST_CASE("Writes to the mapping don't reach the image") {
+    auto imagePath = makeTestImage("clem_disk_mapping_writes");
+    auto original = readFile(imagePath);
+    ClemensHostMappedFile mapping{};
+    REQUIRE(clem_host_map_file_private(&mapping, imagePath.c_str()));
+
+    ClemensNibbleDisk nib{};
+    ClemensWOZDisk woz{};
+    woz.nib = &nib;
+    cinek::Range<uint8_t> mapBuffer(mapping.data, mapping.data + mapping.size);
+    REQUIRE(ClemensDiskUtilities::mapWOZ(&woz, mapBuffer));
+    auto *track = nib.bits_data + nib.track_byte_offset[17];
+    std::fill_n(track, kTrackByteCount, uint8_t(0xa5));
+    CHECK(track[100] == 0xa5);
+    //  the write is private to this view, so a second view and the file still
+    //  have the original track
+    ClemensHostMappedFile secondMapping{};
+    REQUIRE(clem_host_map_file_private(&secondMapping, imagePath.c_str()));
+    CHECK(secondMapping.data[track - mapping.data + 100] == 17);
+    clem_host_unmap_file(&secondMapping);
+    CHECK(readFile(imagePath) == original);
+
+    //  and the image is written only by serializing the disk once unmapped
+    std::vector<uint8_t> image(CLEM_DISK_525_MAX_DATA_SIZE + 4096);
+    size_t imageSize = image.size();
+    REQUIRE(clem_woz_serialize(&woz, image.data(), &imageSize));
+    clem_host_unmap_file(&mapping);
+    image.resize(imageSize);
+    CHECK(image.size() == original.size());
+    CHECK(image != original);
+    std::filesystem::remove(imagePath);
+}
+
+TEST_CASE("A missing image isn't mapped") {
+    ClemensHostMappedFile mapping{};
+    auto imagePath = std::filesystem::temp_directory_path() / "clem_disk_mapping_missing.woz";
+    std::filesystem::remove(imagePath);
+    CHECK_FALSE(clem_host_map_file_private(&mapping, imagePath.string().c_str()));
+    CHECK(mapping.data == nullptr);
+    //  releasing an unmapped view is harmless, as the backend does on every load
+    clem_host_unmap_file(&mapping);
+}
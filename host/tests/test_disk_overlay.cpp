@@ -0,0 +1,139 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h.h"
+
+#include "clem_disk_overlay.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <unistd.h>
+#endif
+
+namespace {
+
+constexpr unsigned kTrackCount = 35;
+constexpr unsigned kTrackByteCount = CLEM_DISK_525_BYTES_PER_TRACK;
+
+//  A 5.25" disk in memory, as it would be mapped from an image
+struct TestDisk {
+    ClemensNibbleDisk nib{};
+    std::vector<uint8_t> bits;
+
+    TestDisk(unsigned trackCount = kTrackCount) : bits(trackCount * kTrackByteCount) {
+        nib.disk_type = CLEM_DISK_TYPE_5_25;
+        nib.track_count = trackCount;
+        for (unsigned trackIndex = 0; trackIndex < trackCount; ++trackIndex) {
+            nib.track_byte_offset[trackIndex] = trackIndex * kTrackByteCount;
+            nib.track_byte_count[trackIndex] = kTrackByteCount;
+            nib.track_bits_count[trackIndex] = kTrackByteCount * 8 - 3;
+            nib.track_initialized[trackIndex] = 1;
+            fillTrack(trackIndex, uint8_t(trackIndex));
+        }
+        nib.bits_data = bits.data();
+        nib.bits_data_end = bits.data() + bits.size();
+    }
+
+    void fillTrack(unsigned trackIndex, uint8_t value) {
+        std::fill_n(bits.begin() + trackIndex * kTrackByteCount, kTrackByteCount, value);
+    }
+
+    uint8_t trackByte(unsigned trackIndex) const { return bits[trackIndex * kTrackByteCount]; }
+};
+
+std::string makeTestDirectory(const char *name) {
+    auto path = std::filesystem::temp_directory_path() /
+                (std::string(name) + "." + std::to_string(getpid()));
+    std::filesystem::remove_all(path);
+    std::filesystem::create_directories(path);
+    return path.string();
+}
+
+} // namespace
+
+TEST_CASE("Delta paths are named after the image path") {
+    auto deltaPath = ClemensDiskTrackOverlay::getDeltaPathname("deltas", "games/side a.woz");
+    CHECK(std::filesystem::path(deltaPath).filename() == "games_side a.woz.delta");
+    deltaPath = ClemensDiskTrackOverlay::getDeltaPathname("deltas", "/games//disk.woz");
+    CHECK(std::filesystem::path(deltaPath).filename() == "games_disk.woz.delta");
+}
+
+TEST_CASE("Only changed tracks are kept in the delta") {
+    auto directory = makeTestDirectory("clem_disk_overlay_save");
+    auto deltaPath = ClemensDiskTrackOverlay::getDeltaPathname(directory, "disk.woz");
+    {
+        TestDisk disk;
+        ClemensDiskTrackOverlay overlay;
+        REQUIRE(overlay.attach(deltaPath, disk.nib));
+        CHECK(overlay.isAttached());
+        //  nothing changed, so there is no delta
+        CHECK(overlay.save(disk.nib));
+        CHECK_FALSE(std::filesystem::exists(deltaPath));
+
+        disk.fillTrack(3, 0xa5);
+        disk.nib.track_bits_count[20] = 1000;
+        CHECK(overlay.save(disk.nib));
+        REQUIRE(std::filesystem::exists(deltaPath));
+        CHECK(std::filesystem::file_size(deltaPath) == 16 + 2 * (16 + kTrackByteCount));
+    }
+    TestDisk disk;
+    ClemensDiskTrackOverlay overlay;
+    REQUIRE(overlay.attach(deltaPath, disk.nib));
+    CHECK(disk.trackByte(3) == 0xa5);
+    CHECK(disk.nib.track_bits_count[20] == 1000);
+    CHECK(disk.trackByte(4) == 4);
+    CHECK(disk.nib.track_bits_count[4] == kTrackByteCount * 8 - 3);
+
+    //  tracks stay in the delta even when they change back
+    disk.fillTrack(3, 3);
+    disk.fillTrack(5, 0x5a);
+    CHECK(overlay.save(disk.nib));
+    CHECK(std::filesystem::file_size(deltaPath) == 16 + 3 * (16 + kTrackByteCount));
+
+    CHECK(overlay.discard());
+    CHECK_FALSE(std::filesystem::exists(deltaPath));
+    std::filesystem::remove_all(directory);
+}
+
+TEST_CASE("A delta for another disk layout is not applied") {
+    auto directory = makeTestDirectory("clem_disk_overlay_layout");
+    auto deltaPath = ClemensDiskTrackOverlay::getDeltaPathname(directory, "disk.woz");
+    {
+        TestDisk disk;
+        ClemensDiskTrackOverlay overlay;
+        REQUIRE(overlay.attach(deltaPath, disk.nib));
+        disk.fillTrack(0, 0xff);
+        CHECK(overlay.save(disk.nib));
+    }
+    TestDisk disk(40);
+    ClemensDiskTrackOverlay overlay;
+    CHECK_FALSE(overlay.attach(deltaPath, disk.nib));
+    CHECK_FALSE(overlay.isAttached());
+    CHECK(disk.trackByte(0) == 0);
+    std::filesystem::remove_all(directory);
+}
+
+TEST_CASE("Committing replaces the image and removes the delta") {
+    auto directory = makeTestDirectory("clem_disk_overlay_commit");
+    auto imagePath = (std::filesystem::path(directory) / "disk.woz").string();
+    auto deltaPath = ClemensDiskTrackOverlay::getDeltaPathname(directory, "disk.woz");
+    {
+        std::ofstream out(imagePath, std::ios::binary);
+        out << "master";
+    }
+    TestDisk disk;
+    ClemensDiskTrackOverlay overlay;
+    REQUIRE(overlay.attach(deltaPath, disk.nib));
+    disk.fillTrack(7, 0x77);
+    CHECK(overlay.save(disk.nib));
+    REQUIRE(std::filesystem::exists(deltaPath));
+
+    const uint8_t image[] = {'c', 'o', 'm', 'm', 'i', 't', 't', 'e', 'd'};
+    CHECK(overlay.commit(imagePath, image, sizeof(image)));
+    CHECK(std::filesystem::file_size(imagePath) == sizeof(image));
+    CHECK_FALSE(std::filesystem::exists(deltaPath));
+    CHECK_FALSE(std::filesystem::exists(imagePath + ".tmp"));
+    std::filesystem::remove_all(directory);
+}
@@ -0,0 +1,220 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h.h"
+
+#include "clem_backend.hpp"
+#include "clem_interpreter.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#if defined(_WIN32)
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+
+constexpr size_t kInterpreterMemorySize = 16 * 1024;
+constexpr auto kResultTimeLimit = std::chrono::seconds(30);
+constexpr auto kPublishInterval = std::chrono::milliseconds(20);
+
+std::string makeTestPath(const char *name) {
+    auto path = std::filesystem::temp_directory_path() /
+                (std::string(name) + "." + std::to_string(getpid()));
+    std::filesystem::remove_all(path);
+    return path.string();
+}
+
+ClemensInterpreter::Result parseScript(std::string_view script) {
+    ClemensInterpreter interpreter(
+        cinek::FixedStack(kInterpreterMemorySize, malloc(kInterpreterMemorySize)));
+    return interpreter.parse(script);
+}
+
+bool isParsed(std::string_view script) {
+    return parseScript(script).type == ClemensInterpreter::Result::Ok;
+}
+
+bool isSyntaxError(std::string_view script) {
+    return parseScript(script).type == ClemensInterpreter::Result::SyntaxError;
+}
+
+//  A headless machine without a ROM.  Its ROM is zeroed, so the CPU loops on
+//  BRK at $00/0000 with the rest of bank 0 left untouched.
+class TestBackend {
+  public:
+    TestBackend()
+        : bramPath_(makeTestPath("clem_interpreter_bram")),
+          backend_("", makeConfig(bramPath_),
+                   [this](const ClemensBackendState &state) { publish(state); }) {
+        backend_.setRefreshFrequency(60);
+        backend_.reset();
+        backend_.run();
+    }
+    ~TestBackend() { std::filesystem::remove(bramPath_); }
+
+    //  Returns whether a statement run outside of a script file succeeded
+    std::optional<bool> runScript(std::string command) {
+        clear(commandFailed_);
+        backend_.runScript(std::move(command));
+        auto failed = waitFor(commandFailed_);
+        if (!failed.has_value())
+            return std::nullopt;
+        return !*failed;
+    }
+
+    //  Returns the script result once the script finishes or fails
+    std::optional<bool> runScriptFile(const std::string &pathname) {
+        clear(scriptResult_);
+        backend_.runScriptFile(pathname);
+        return waitFor(scriptResult_);
+    }
+
+    //  Runs the lines as a script file
+    std::optional<bool> runScriptText(std::string_view text) {
+        auto scriptPath = makeTestPath("clem_interpreter_script");
+        {
+            std::ofstream out(scriptPath);
+            out << text;
+        }
+        auto result = runScriptFile(scriptPath);
+        std::filesystem::remove(scriptPath);
+        return result;
+    }
+
+  private:
+    static ClemensBackend::Config makeConfig(const std::string &bramPath) {
+        ClemensBackend::Config config{};
+        config.type = ClemensBackendConfig::Type::Apple2GS;
+        config.audioSamplesPerSecond = 48000;
+        config.bramPathname = bramPath;
+        config.rtcEpochTime = 0;
+        return config;
+    }
+
+    void publish(const ClemensBackendState &state) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (state.commandFailed.has_value() &&
+            state.commandType == ClemensBackendCommand::RunScript) {
+            commandFailed_ = state.commandFailed;
+        } else if (state.commandFailed.has_value() && !*state.commandFailed) {
+            //  commands only report their type on failure
+            commandFailed_ = false;
+        }
+        if (state.scriptResult.has_value()) {
+            scriptResult_ = state.scriptResult;
+        }
+        published_.notify_all();
+    }
+
+    void clear(std::optional<bool> &outcome) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        outcome = std::nullopt;
+    }
+
+    std::optional<bool> waitFor(std::optional<bool> &outcome) {
+        auto deadline = std::chrono::steady_clock::now() + kResultTimeLimit;
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!outcome.has_value() && std::chrono::steady_clock::now() < deadline) {
+            lock.unlock();
+            backend_.publish();
+            lock.lock();
+            published_.wait_for(lock, kPublishInterval);
+        }
+        return outcome;
+    }
+
+    std::string bramPath_;
+    std::mutex mutex_;
+    std::condition_variable published_;
+    std::optional<bool> commandFailed_;
+    std::optional<bool> scriptResult_;
+    ClemensBackend backend_;
+};
+
+} // namespace
+
+TEST_CASE("Commands parse with their operands") {
+    CHECK(isParsed("wait pc,$00/1234"));
+    CHECK(isParsed("wait pc, $fe1234"));
+    CHECK(isParsed("wait mem,$0300,5A"));
+    CHECK(isParsed("wait cycles,1000"));
+    CHECK(isParsed("wait text,\"READY\""));
+    CHECK(isParsed("timeout 0"));
+    CHECK(isParsed("type \"10 PRINT \\\"HI\\\"\\n\""));
+    CHECK(isParsed("type \"\""));
+    CHECK(isParsed("key 24"));
+    CHECK(isParsed("expect $e1/0400,a0"));
+    CHECK(isParsed("commit s5d1"));
+    CHECK(isParsed(".A=#10"));
+    CHECK(isParsed("timeout 100; wait cycles,10 ;expect $0300,0"));
+    //  the interpreter keeps the unconsumed text for errors
+    auto result = parseScript("type \"abc\" xyz");
+    CHECK(result.type == ClemensInterpreter::Result::SyntaxError);
+    CHECK(result.script == "xyz");
+}
+
+TEST_CASE("Malformed literals and addresses are syntax errors") {
+    CHECK(isSyntaxError("type \"abc"));
+    CHECK(isSyntaxError("type \"abc\\"));
+    CHECK(isSyntaxError("expect $/1234,0"));
+    CHECK(isSyntaxError("expect $123/4567,0"));
+    CHECK(isSyntaxError("expect $12/34567,0"));
+    CHECK(isSyntaxError("expect $123456789,0"));
+    CHECK(isSyntaxError("wait pc,"));
+    CHECK(isSyntaxError("wait pc $1234"));
+    CHECK_FALSE(isParsed("timeout 100;"));
+    CHECK(isSyntaxError("timeout 100; wait pc,$"));
+    CHECK(parseScript("").type != ClemensInterpreter::Result::Ok);
+}
+
+TEST_CASE("Script waits, expectations and timeouts run against the machine") {
+    TestBackend backend;
+
+    SUBCASE("Waits that are met let the script finish") {
+        CHECK(backend.runScriptText("wait cycles,1000\n"
+                                    "wait pc,$00/0000\n"
+                                    "wait mem,$00/0300,00\n"
+                                    "expect $00/0300,00\n") == true);
+    }
+    SUBCASE("Typing and key presses need no machine state") {
+        CHECK(backend.runScriptText("type \"abc\\n\"\nkey 24\n") == true);
+    }
+    SUBCASE("A failed expectation fails the script") {
+        CHECK(backend.runScriptText("expect $00/0300,01\n") == false);
+        CHECK(backend.runScriptText("expect $00/0300,00\nexpect $00/0300,FF\n") == false);
+    }
+    SUBCASE("Waits fail once the timeout passes") {
+        CHECK(backend.runScriptText("timeout 10000\nwait pc,$12/3456\n") == false);
+        CHECK(backend.runScriptText("timeout 10000\nwait mem,$00/0300,5A\n") == false);
+        CHECK(backend.runScriptText("timeout 10000\nwait text,\"READY\"\n") == false);
+        //  a wait that is met before the timeout does not fail
+        CHECK(backend.runScriptText("timeout 10000\nwait cycles,100\n") == true);
+    }
+    SUBCASE("Malformed and invalid statements fail the script") {
+        CHECK(backend.runScriptText("expect $123/4567,0\n") == false);
+        CHECK(backend.runScriptText("wait text,\"\"\n") == false);
+        CHECK(backend.runScriptText("wait sometime,10\n") == false);
+        CHECK(backend.runScriptFile(makeTestPath("clem_interpreter_missing")) == false);
+    }
+}
+
+TEST_CASE("Every statement of a chain runs") {
+    TestBackend backend;
+    CHECK(backend.runScript("expect $00/0300,00") == true);
+    CHECK(backend.runScript("expect $00/0300,01") == false);
+    CHECK(backend.runScript("timeout 0; expect $00/0300,00") == true);
+    //  the last statement decides the result when the others succeed
+    CHECK(backend.runScript("timeout 0; expect $00/0300,01") == false);
+    CHECK(backend.runScript("expect $00/0300,01; timeout 0") == false);
+    CHECK(backend.runScript("timeout 0; timeout 0; expect $00/0300,01") == false);
+}
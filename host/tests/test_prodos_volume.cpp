@@ -0,0 +1,299 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h.h"
+
+#include "clem_prodos_volume.hpp"
+#include "clem_smartport.h"
+#include "external/mpack.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <unistd.h>
+#endif
+
+namespace {
+
+using Block = std::vector<uint8_t>;
+
+struct DirectoryEntry {
+    uint8_t storageType;
+    std::string name;
+    uint8_t fileType;
+    unsigned keyBlock;
+    unsigned blocksUsed;
+    unsigned eof;
+    unsigned auxType;
+};
+
+std::filesystem::path makeTestDirectory(const char *name) {
+    auto path = std::filesystem::temp_directory_path() /
+                (std::string(name) + "." + std::to_string(getpid()));
+    std::filesystem::remove_all(path);
+    std::filesystem::create_directories(path);
+    return path;
+}
+
+std::vector<uint8_t> makeData(size_t size, uint8_t seed) {
+    std::vector<uint8_t> data(size);
+    for (size_t i = 0; i < size; ++i) {
+        data[i] = uint8_t((i * 7 + (i >> 9)) ^ seed);
+    }
+    return data;
+}
+
+void writeHostFile(const std::filesystem::path &path, const std::vector<uint8_t> &data) {
+    std::ofstream out(path, std::ios::binary);
+    out.write((const char *)data.data(), data.size());
+}
+
+std::vector<uint8_t> readHostFile(const std::filesystem::path &path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(in),
+                                std::istreambuf_iterator<char>());
+}
+
+unsigned get16(const uint8_t *data) { return data[0] | (unsigned(data[1]) << 8); }
+
+Block readBlock(ClemensProDOSHostVolume &volume, unsigned blockIndex) {
+    Block block(512);
+    REQUIRE(volume.readBlock(blockIndex, block.data()) == CLEM_SMARTPORT_STATUS_CODE_OK);
+    return block;
+}
+
+//  All entries in a directory, following its block chain
+std::vector<DirectoryEntry> listDirectory(ClemensProDOSHostVolume &volume, unsigned keyBlock) {
+    std::vector<DirectoryEntry> entries;
+    unsigned entrySlot = 1;
+    for (unsigned blockIndex = keyBlock; blockIndex != 0;) {
+        auto block = readBlock(volume, blockIndex);
+        for (; entrySlot < 13; ++entrySlot) {
+            const uint8_t *entry = block.data() + 4 + entrySlot * 39;
+            if ((entry[0] >> 4) == 0)
+                continue;
+            entries.push_back({uint8_t(entry[0] >> 4),
+                               std::string((const char *)entry + 1, entry[0] & 0xf), entry[0x10],
+                               get16(entry + 0x11), get16(entry + 0x13),
+                               get16(entry + 0x15) | (unsigned(entry[0x17]) << 16),
+                               get16(entry + 0x1f)});
+        }
+        blockIndex = get16(block.data() + 2);
+        entrySlot = 0;
+    }
+    return entries;
+}
+
+//  The data block numbers of a file in order
+std::vector<unsigned> getDataBlocks(ClemensProDOSHostVolume &volume, const DirectoryEntry &entry) {
+    std::vector<unsigned> dataBlocks;
+    if (entry.storageType == 1) {
+        dataBlocks.push_back(entry.keyBlock);
+        return dataBlocks;
+    }
+    std::vector<unsigned> indexBlocks;
+    if (entry.storageType == 3) {
+        auto master = readBlock(volume, entry.keyBlock);
+        for (unsigned i = 0; i < 256 && master[i] | master[256 + i]; ++i) {
+            indexBlocks.push_back(master[i] | (unsigned(master[256 + i]) << 8));
+        }
+    } else {
+        indexBlocks.push_back(entry.keyBlock);
+    }
+    for (unsigned indexBlock : indexBlocks) {
+        auto index = readBlock(volume, indexBlock);
+        for (unsigned i = 0; i < 256 && index[i] | index[256 + i]; ++i) {
+            dataBlocks.push_back(index[i] | (unsigned(index[256 + i]) << 8));
+        }
+    }
+    return dataBlocks;
+}
+
+std::vector<uint8_t> readFile(ClemensProDOSHostVolume &volume, const DirectoryEntry &entry) {
+    std::vector<uint8_t> data;
+    for (unsigned dataBlock : getDataBlocks(volume, entry)) {
+        auto block = readBlock(volume, dataBlock);
+        data.insert(data.end(), block.begin(), block.end());
+    }
+    data.resize(entry.eof);
+    return data;
+}
+
+bool isBlockFree(ClemensProDOSHostVolume &volume, unsigned bitmapBlock, unsigned blockIndex) {
+    auto bitmap = readBlock(volume, bitmapBlock + blockIndex / 4096);
+    return (bitmap[(blockIndex % 4096) / 8] & (0x80 >> (blockIndex % 8))) != 0;
+}
+
+} // namespace
+
+TEST_CASE("A host directory reads as a ProDOS volume") {
+    auto path = makeTestDirectory("clem_prodos_read");
+    auto small = makeData(100, 0x11);
+    auto medium = makeData(5000, 0x22);
+    auto large = makeData(200000, 0x33);
+    auto inner = makeData(1024, 0x44);
+    writeHostFile(path / "hello.txt", small);
+    writeHostFile(path / "data bin", medium);
+    writeHostFile(path / "big#062000", large);
+    writeHostFile(path / ".hidden", small);
+    std::filesystem::create_directory(path / "sub");
+    writeHostFile(path / "sub" / "inner.s16", inner);
+
+    ClemensProDOSHostVolume volume;
+    REQUIRE(volume.mount(path.string(), false));
+    CHECK(volume.getBlockCount() == 65535);
+
+    auto header = readBlock(volume, 2);
+    CHECK(get16(header.data()) == 0);
+    CHECK((header[4] >> 4) == 0xf);
+    CHECK(header[4 + 0x1f] == 0x27);
+    CHECK(header[4 + 0x20] == 0x0d);
+    CHECK(get16(header.data() + 4 + 0x21) == 4);
+    CHECK(get16(header.data() + 4 + 0x25) == 65535);
+    unsigned bitmapBlock = get16(header.data() + 4 + 0x23);
+
+    auto entries = listDirectory(volume, 2);
+    REQUIRE(entries.size() == 4);
+    CHECK(entries[0].name == "BIG");
+    CHECK(entries[1].name == "DATA.BIN");
+    CHECK(entries[2].name == "HELLO.TXT");
+    CHECK(entries[3].name == "SUB");
+
+    CHECK(entries[0].storageType == 3);
+    CHECK(entries[0].fileType == 0x06);
+    CHECK(entries[0].auxType == 0x2000);
+    CHECK(readFile(volume, entries[0]) == large);
+    CHECK(entries[1].storageType == 2);
+    CHECK(readFile(volume, entries[1]) == medium);
+    CHECK(entries[2].storageType == 1);
+    CHECK(entries[2].fileType == 0x04);
+    CHECK(readFile(volume, entries[2]) == small);
+
+    REQUIRE(entries[3].storageType == 0xd);
+    CHECK(entries[3].fileType == 0x0f);
+    auto subHeader = readBlock(volume, entries[3].keyBlock);
+    CHECK((subHeader[4] >> 4) == 0xe);
+    CHECK(get16(subHeader.data() + 4 + 0x23) == 2);
+    CHECK(subHeader[4 + 0x25] == 5);
+    auto subEntries = listDirectory(volume, entries[3].keyBlock);
+    REQUIRE(subEntries.size() == 1);
+    CHECK(subEntries[0].name == "INNER.S16");
+    CHECK(subEntries[0].fileType == 0xb3);
+    CHECK(readFile(volume, subEntries[0]) == inner);
+
+    //  everything used is allocated in the bitmap
+    for (unsigned blockIndex : {0u, 2u, bitmapBlock, entries[0].keyBlock, entries[3].keyBlock}) {
+        CHECK_FALSE(isBlockFree(volume, bitmapBlock, blockIndex));
+    }
+    for (unsigned dataBlock : getDataBlocks(volume, entries[0])) {
+        REQUIRE_FALSE(isBlockFree(volume, bitmapBlock, dataBlock));
+    }
+    CHECK(isBlockFree(volume, bitmapBlock, 65534));
+
+    Block block(512);
+    CHECK(volume.readBlock(65535, block.data()) == CLEM_SMARTPORT_STATUS_CODE_INVALID_BLOCK);
+    volume.unmount();
+    std::filesystem::remove_all(path);
+}
+
+TEST_CASE("Guest writes reach the host directory only with write-back") {
+    auto path = makeTestDirectory("clem_prodos_write");
+    auto medium = makeData(5000, 0x22);
+    writeHostFile(path / "data.bin", medium);
+    std::filesystem::create_directory(path / "sub");
+
+    for (bool writeBack : {false, true}) {
+        ClemensProDOSHostVolume volume;
+        REQUIRE(volume.mount(path.string(), writeBack));
+        auto entries = listDirectory(volume, 2);
+        REQUIRE(entries.size() == 2);
+        auto dataBlocks = getDataBlocks(volume, entries[0]);
+        REQUIRE(dataBlocks.size() == 10);
+
+        Block block(512, 0xa5);
+        CHECK(volume.writeBlock(dataBlocks[3], block.data()) == CLEM_SMARTPORT_STATUS_CODE_OK);
+        CHECK(readBlock(volume, dataBlocks[3]) == block);
+
+        //  a new seedling file in the subdirectory, as ProDOS would create it
+        unsigned newDataBlock = 60000;
+        Block newData(512, 0x5a);
+        volume.writeBlock(newDataBlock, newData.data());
+        auto subBlock = readBlock(volume, entries[1].keyBlock);
+        uint8_t *entry = subBlock.data() + 4 + 39;
+        const char *name = "NEW.FILE";
+        entry[0] = uint8_t(0x10 | strlen(name));
+        memcpy(entry + 1, name, strlen(name));
+        entry[0x10] = 0x06;
+        entry[0x11] = uint8_t(newDataBlock & 0xff);
+        entry[0x12] = uint8_t(newDataBlock >> 8);
+        entry[0x13] = 1;
+        entry[0x15] = 0x00;
+        entry[0x16] = 0x01;
+        volume.writeBlock(entries[1].keyBlock, subBlock.data());
+
+        CHECK(volume.flush());
+        auto modified = medium;
+        std::fill(modified.begin() + 3 * 512, modified.begin() + 4 * 512, 0xa5);
+        if (writeBack) {
+            CHECK(readHostFile(path / "data.bin") == modified);
+            CHECK(readHostFile(path / "sub" / "NEW.FILE") == Block(256, 0x5a));
+        } else {
+            CHECK(readHostFile(path / "data.bin") == medium);
+            CHECK_FALSE(std::filesystem::exists(path / "sub" / "NEW.FILE"));
+        }
+        //  the rest of the file still reads the same after it's replaced
+        CHECK(readFile(volume, entries[0]) == modified);
+        CHECK(volume.unmount());
+    }
+    std::filesystem::remove_all(path);
+}
+
+TEST_CASE("A snapshot restores the volume as the guest left it") {
+    auto path = makeTestDirectory("clem_prodos_snapshot");
+    auto medium = makeData(5000, 0x22);
+    writeHostFile(path / "data.bin", medium);
+
+    ClemensProDOSHostVolume volume;
+    REQUIRE(volume.mount(path.string(), false));
+    Block block(512, 0xa5);
+    volume.writeBlock(100, block.data());
+
+    char *buffer = nullptr;
+    size_t bufferSize = 0;
+    mpack_writer_t writer;
+    mpack_writer_init_growable(&writer, &buffer, &bufferSize);
+    volume.serialize(&writer);
+    REQUIRE(mpack_writer_destroy(&writer) == mpack_ok);
+
+    //  a file added afterwards doesn't change the restored layout
+    writeHostFile(path / "added.bin", medium);
+
+    ClemensProDOSHostVolume restored;
+    mpack_reader_t reader;
+    mpack_reader_init_data(&reader, buffer, bufferSize);
+    REQUIRE(restored.unserialize(&reader));
+    REQUIRE(mpack_reader_destroy(&reader) == mpack_ok);
+    free(buffer);
+
+    CHECK(restored.getPathname() == volume.getPathname());
+    for (unsigned blockIndex = 0; blockIndex < 200; ++blockIndex) {
+        REQUIRE(readBlock(restored, blockIndex) == readBlock(volume, blockIndex));
+    }
+    auto entries = listDirectory(restored, 2);
+    REQUIRE(entries.size() == 1);
+    CHECK(readFile(restored, entries[0]) == medium);
+    std::filesystem::remove_all(path);
+}
+
+TEST_CASE("A path that isn't a directory is not mounted") {
+    auto path = makeTestDirectory("clem_prodos_invalid");
+    writeHostFile(path / "file", makeData(16, 0));
+    ClemensProDOSHostVolume volume;
+    CHECK_FALSE(volume.mount((path / "file").string(), false));
+    CHECK_FALSE(volume.mount((path / "missing").string(), false));
+    CHECK_FALSE(volume.isMounted());
+    std::filesystem::remove_all(path);
+}
@@ -0,0 +1,80 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h.h"
+
+#include "clem_run_sampler.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <initializer_list>
+
+namespace {
+
+//  short enough that pacing doesn't slow the tests down
+constexpr std::chrono::microseconds kFrameInterval(1);
+
+void runFrame(ClemensRunSampler &sampler, std::chrono::microseconds frameTime,
+              std::chrono::microseconds frameInterval = kFrameInterval) {
+    sampler.update(frameInterval, frameTime, 0, 0);
+}
+
+//  the first paced frame only sets the deadline
+void startPacing(ClemensRunSampler &sampler) {
+    runFrame(sampler, std::chrono::microseconds(0));
+    REQUIRE(sampler.getFrameStats().frameCount == 0);
+}
+
+} // namespace
+
+TEST_CASE("Frame stats report the mean and deviation of paced frames") {
+    ClemensRunSampler sampler;
+    CHECK(sampler.getFrameStats().frameCount == 0);
+    startPacing(sampler);
+    for (unsigned i = 0; i < 10; ++i) {
+        runFrame(sampler, std::chrono::microseconds(i % 2 ? 30 : 10));
+    }
+    auto stats = sampler.getFrameStats();
+    CHECK(stats.frameCount == 10);
+    CHECK(stats.meanFrameTime == doctest::Approx(20.0f));
+    CHECK(stats.frameTimeDeviation == doctest::Approx(10.0f));
+    CHECK(stats.maxFrameTimeError == doctest::Approx(29.0f));
+    CHECK(stats.meanWakeLatency >= 0.0f);
+    CHECK(stats.maxWakeLatency >= stats.meanWakeLatency);
+}
+
+TEST_CASE("Frame stats cover the last 120 frames") {
+    ClemensRunSampler sampler;
+    startPacing(sampler);
+    for (unsigned i = 0; i < 150; ++i) {
+        runFrame(sampler, std::chrono::microseconds(i));
+    }
+    //  frames 30 to 149 are left in the ring
+    auto stats = sampler.getFrameStats();
+    CHECK(stats.frameCount == ClemensRunSampler::kJitterSampleLimit);
+    CHECK(stats.meanFrameTime == doctest::Approx(89.5f));
+    CHECK(stats.frameTimeDeviation == doctest::Approx(std::sqrt((120.0 * 120.0 - 1) / 12)));
+    CHECK(stats.maxFrameTimeError == doctest::Approx(148.0f));
+}
+
+TEST_CASE("Frame stats restart when the interval changes") {
+    ClemensRunSampler sampler;
+    startPacing(sampler);
+    for (unsigned i = 0; i < 5; ++i) {
+        runFrame(sampler, std::chrono::microseconds(10));
+    }
+    REQUIRE(sampler.getFrameStats().frameCount == 5);
+
+    runFrame(sampler, std::chrono::microseconds(50), std::chrono::microseconds(2));
+    auto stats = sampler.getFrameStats();
+    CHECK(stats.frameCount == 1);
+    CHECK(stats.meanFrameTime == doctest::Approx(50.0f));
+    CHECK(stats.frameTimeDeviation == doctest::Approx(0.0f));
+    CHECK(stats.maxFrameTimeError == doctest::Approx(48.0f));
+
+    //  unpaced frames aren't counted, nor is the paced frame that follows them
+    runFrame(sampler, std::chrono::microseconds(70), std::chrono::microseconds(0));
+    runFrame(sampler, std::chrono::microseconds(70), std::chrono::microseconds(2));
+    CHECK(sampler.getFrameStats().frameCount == 1);
+
+    sampler.reset();
+    CHECK(sampler.getFrameStats().frameCount == 0);
+}
@@ -0,0 +1,477 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h.h"
+
+#include "clem_smartport_disk.hpp"
+#include "external/mpack.h"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <csignal>
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+constexpr unsigned kBlockCount = 1024;
+
+std::string makeTestPath(const char *name) {
+    auto path = std::filesystem::temp_directory_path() /
+                (std::string(name) + "." + std::to_string(getpid()) + ".2mg");
+    std::filesystem::remove(path);
+    return path.string();
+}
+
+//  every block holds its index in each byte pair so a misplaced block shows up
+void fillBlock(uint8_t *block, unsigned blockIndex, uint8_t tag) {
+    for (unsigned i = 0; i < 512; i += 2) {
+        block[i] = uint8_t(blockIndex & 0xff) ^ tag;
+        block[i + 1] = uint8_t(blockIndex >> 8) ^ tag;
+    }
+}
+
+void writeTestImage(const std::string &path) {
+    auto data = ClemensSmartPortDisk::createData(kBlockCount);
+    for (unsigned blockIndex = 0; blockIndex < kBlockCount; ++blockIndex) {
+        fillBlock(data.data() + CLEM_2IMG_HEADER_BYTE_SIZE + blockIndex * 512, blockIndex, 0);
+    }
+    std::ofstream out(path, std::ios::binary);
+    out.write((const char *)data.data(), data.size());
+}
+
+std::vector<uint8_t> readFileBlock(const std::string &path, unsigned blockIndex) {
+    std::vector<uint8_t> block(512);
+    std::ifstream in(path, std::ios::binary);
+    in.seekg(CLEM_2IMG_HEADER_BYTE_SIZE + blockIndex * 512);
+    in.read((char *)block.data(), block.size());
+    return block;
+}
+
+//  Reads through the SmartPort device as the bus does, polling while the block
+//  is still on its way
+uint8_t readDeviceBlock(ClemensSmartPortDevice &device, unsigned blockIndex,
+                        ClemensSmartPortPacket &packet) {
+    uint8_t status;
+    do {
+        status = device.do_read_block(&device, &packet, blockIndex, 0);
+    } while (status == CLEM_SMARTPORT_STATUS_CODE_WAIT);
+    return status;
+}
+
+} // namespace
+
+TEST_CASE("Blocks are read from the image file through the device") {
+    auto path = makeTestPath("clem_smartport_read");
+    writeTestImage(path);
+
+    ClemensSmartPortDisk disk;
+    REQUIRE(disk.open(path, 0));
+    CHECK(disk.getDisk().block_count == kBlockCount);
+
+    ClemensSmartPortDevice device{};
+    disk.createSmartPortDevice(&device);
+    ClemensSmartPortPacket packet{};
+    std::vector<uint8_t> expected(512);
+    //  out of order, so that some reads land ahead of the prefetch
+    for (unsigned blockIndex : {1000u, 3u, 517u, 0u, 1023u}) {
+        REQUIRE(readDeviceBlock(device, blockIndex, packet) == CLEM_SMARTPORT_STATUS_CODE_OK);
+        CHECK(packet.contents_length == 512);
+        fillBlock(expected.data(), blockIndex, 0);
+        CHECK(std::equal(expected.begin(), expected.end(), packet.contents));
+    }
+    CHECK(readDeviceBlock(device, kBlockCount, packet) ==
+          CLEM_SMARTPORT_STATUS_CODE_INVALID_BLOCK);
+    disk.destroySmartPortDevice(&device);
+    CHECK(disk.close());
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("Written blocks reach the file") {
+    auto path = makeTestPath("clem_smartport_write");
+    writeTestImage(path);
+    std::vector<uint8_t> block(512);
+    {
+        ClemensSmartPortDisk disk;
+        REQUIRE(disk.open(path, 0));
+        //  a write to a block the prefetch hasn't reached yet must survive it
+        for (unsigned blockIndex = 700; blockIndex < 800; ++blockIndex) {
+            fillBlock(block.data(), blockIndex, 0xa5);
+            disk.write(blockIndex, block.data());
+        }
+        CHECK(disk.flush());
+        fillBlock(block.data(), 750, 0xa5);
+        CHECK(readFileBlock(path, 750) == block);
+
+        fillBlock(block.data(), 2, 0x5a);
+        disk.write(2, block.data());
+        CHECK(disk.close());
+    }
+    CHECK(readFileBlock(path, 2) == block);
+
+    //  untouched blocks are left alone
+    fillBlock(block.data(), 699, 0);
+    CHECK(readFileBlock(path, 699) == block);
+
+    ClemensSmartPortDisk disk;
+    REQUIRE(disk.open(path, 0));
+    std::vector<uint8_t> readBack(512);
+    for (unsigned blockIndex = 700; blockIndex < 800; ++blockIndex) {
+        fillBlock(block.data(), blockIndex, 0xa5);
+        disk.read(blockIndex, readBack.data());
+        CHECK(readBack == block);
+    }
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("A missing image is created") {
+    auto path = makeTestPath("clem_smartport_create");
+    {
+        ClemensSmartPortDisk disk;
+        REQUIRE(disk.open(path, kBlockCount));
+        CHECK(disk.getPathname() == path);
+        CHECK(disk.close());
+    }
+    CHECK(std::filesystem::file_size(path) == CLEM_2IMG_HEADER_BYTE_SIZE + kBlockCount * 512);
+    ClemensSmartPortDisk disk;
+    REQUIRE(disk.open(path, 0));
+    CHECK(disk.getDisk().block_count == kBlockCount);
+    disk.close();
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("An image that can't be written to is opened write-protected") {
+    auto path = makeTestPath("clem_smartport_readonly");
+    writeTestImage(path);
+    std::filesystem::permissions(path, std::filesystem::perms::owner_read);
+    std::vector<uint8_t> block(512);
+    {
+        //  a different block count shows up if the image is created again
+        ClemensSmartPortDisk disk;
+        REQUIRE(disk.open(path, kBlockCount * 2));
+        CHECK(disk.getDisk().block_count == kBlockCount);
+        if (disk.isWriteProtected()) {
+            ClemensSmartPortDevice device{};
+            disk.createSmartPortDevice(&device);
+            ClemensSmartPortPacket packet{};
+            REQUIRE(readDeviceBlock(device, 3, packet) == CLEM_SMARTPORT_STATUS_CODE_OK);
+            //  the bus sends the command, then the block
+            packet.type = kClemensSmartPortPacketType_Command;
+            REQUIRE(device.do_write_block(&device, &packet, 3, 0) == CLEM_SMARTPORT_STATUS_CODE_OK);
+            packet.type = kClemensSmartPortPacketType_Data;
+            fillBlock(packet.contents, 3, 0xa5);
+            CHECK(device.do_write_block(&device, &packet, 3, 0) ==
+                  CLEM_SMARTPORT_STATUS_CODE_NO_WRITE);
+            std::vector<uint8_t> readBack(512);
+            disk.read(3, readBack.data());
+            fillBlock(block.data(), 3, 0);
+            CHECK(readBack == block);
+            disk.destroySmartPortDevice(&device);
+        } else {
+            //  i.e. running as root
+            MESSAGE("the image is still writable, so only its contents are checked");
+        }
+        CHECK(disk.close());
+    }
+    CHECK(std::filesystem::file_size(path) == CLEM_2IMG_HEADER_BYTE_SIZE + kBlockCount * 512);
+    fillBlock(block.data(), 3, 0);
+    CHECK(readFileBlock(path, 3) == block);
+    std::filesystem::permissions(path, std::filesystem::perms::owner_read |
+                                           std::filesystem::perms::owner_write);
+    std::filesystem::remove(path);
+}
+
+#if !defined(_WIN32)
+TEST_CASE("Failed writes are retried until they succeed") {
+    //  writes past the file size limit fail, so the image can't be written
+    //  until the limit is lifted
+    auto path = makeTestPath("clem_smartport_retry");
+    writeTestImage(path);
+    rlimit fileSizeLimit;
+    REQUIRE(getrlimit(RLIMIT_FSIZE, &fileSizeLimit) == 0);
+    auto oldSignalHandler = signal(SIGXFSZ, SIG_IGN);
+    rlimit lowFileSizeLimit = fileSizeLimit;
+    lowFileSizeLimit.rlim_cur = 4096;
+    REQUIRE(setrlimit(RLIMIT_FSIZE, &lowFileSizeLimit) == 0);
+
+    std::vector<uint8_t> block(512);
+    ClemensSmartPortDisk disk;
+    REQUIRE(disk.open(path, 0));
+    fillBlock(block.data(), 900, 0xa5);
+    disk.write(900, block.data());
+    CHECK_FALSE(disk.flush());
+    CHECK_FALSE(disk.isWriteFailing());
+
+    //  the retries keep failing in the background until the disk reports it
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (!disk.isWriteFailing() && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    REQUIRE(disk.isWriteFailing());
+    ClemensSmartPortDevice device{};
+    disk.createSmartPortDevice(&device);
+    ClemensSmartPortPacket packet{};
+    packet.type = kClemensSmartPortPacketType_Command;
+    REQUIRE(device.do_write_block(&device, &packet, 901, 0) == CLEM_SMARTPORT_STATUS_CODE_OK);
+    packet.type = kClemensSmartPortPacketType_Data;
+    fillBlock(packet.contents, 901, 0xa5);
+    CHECK(device.do_write_block(&device, &packet, 901, 0) == CLEM_SMARTPORT_STATUS_CODE_IO_ERR);
+
+    REQUIRE(setrlimit(RLIMIT_FSIZE, &fileSizeLimit) == 0);
+    signal(SIGXFSZ, oldSignalHandler);
+    deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (disk.isWriteFailing() && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    CHECK_FALSE(disk.isWriteFailing());
+    CHECK(readFileBlock(path, 900) == block);
+    disk.destroySmartPortDevice(&device);
+    CHECK(disk.close());
+    std::filesystem::remove(path);
+}
+#endif
+
+TEST_CASE("A file that isn't a 2IMG image is not opened") {
+    auto path = makeTestPath("clem_smartport_invalid");
+    {
+        std::ofstream out(path, std::ios::binary);
+        std::vector<char> junk(4096, 'x');
+        out.write(junk.data(), junk.size());
+    }
+    ClemensSmartPortDisk disk;
+    CHECK_FALSE(disk.open(path, kBlockCount));
+    CHECK_FALSE(disk.isOpen());
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("A directory is opened as a volume") {
+    auto path = std::filesystem::temp_directory_path() /
+                ("clem_smartport_directory." + std::to_string(getpid()));
+    std::filesystem::create_directories(path);
+    {
+        std::ofstream out(path / "hello.txt", std::ios::binary);
+        out << "hello";
+    }
+    ClemensSmartPortDisk disk;
+    REQUIRE(disk.openDirectory(path.string(), false));
+    CHECK(disk.isOpen());
+    CHECK(disk.isDirectory());
+
+    ClemensSmartPortDevice device{};
+    disk.createSmartPortDevice(&device);
+    ClemensSmartPortPacket packet{};
+    //  the volume directory header
+    REQUIRE(readDeviceBlock(device, 2, packet) == CLEM_SMARTPORT_STATUS_CODE_OK);
+    CHECK((packet.contents[4] >> 4) == 0xf);
+    CHECK(packet.contents[4 + 0x21] == 1);
+    disk.destroySmartPortDevice(&device);
+    CHECK(disk.close());
+    CHECK_FALSE(disk.isOpen());
+    std::filesystem::remove_all(path);
+}
+
+TEST_CASE("An overlay leaves the image alone") {
+    auto path = makeTestPath("clem_smartport_overlay");
+    auto deltaPath = path + ".delta";
+    std::filesystem::remove(deltaPath);
+    writeTestImage(path);
+    std::vector<uint8_t> block(512);
+    std::vector<uint8_t> readBack(512);
+    {
+        ClemensSmartPortDisk disk;
+        REQUIRE(disk.openOverlay(path, deltaPath));
+        CHECK(disk.isOverlay());
+        for (unsigned blockIndex : {900u, 5u, 901u}) {
+            fillBlock(block.data(), blockIndex, 0xa5);
+            disk.write(blockIndex, block.data());
+        }
+        CHECK(disk.flush());
+        //  a block written twice uses the other slot of its pair
+        fillBlock(block.data(), 5, 0x3c);
+        disk.write(5, block.data());
+        CHECK(disk.close());
+    }
+    //  block 901's pair is the last, and only its first slot is written
+    CHECK(std::filesystem::file_size(deltaPath) == 16 + 5 * (12 + 512));
+    fillBlock(block.data(), 5, 0);
+    CHECK(readFileBlock(path, 5) == block);
+    fillBlock(block.data(), 900, 0);
+    CHECK(readFileBlock(path, 900) == block);
+
+    //  the next run picks up the delta
+    ClemensSmartPortDisk disk;
+    REQUIRE(disk.openOverlay(path, deltaPath));
+    ClemensSmartPortDevice device{};
+    disk.createSmartPortDevice(&device);
+    ClemensSmartPortPacket packet{};
+    REQUIRE(readDeviceBlock(device, 5, packet) == CLEM_SMARTPORT_STATUS_CODE_OK);
+    fillBlock(block.data(), 5, 0x3c);
+    CHECK(std::equal(block.begin(), block.end(), packet.contents));
+    disk.read(900, readBack.data());
+    fillBlock(block.data(), 900, 0xa5);
+    CHECK(readBack == block);
+    disk.read(6, readBack.data());
+    fillBlock(block.data(), 6, 0);
+    CHECK(readBack == block);
+    disk.destroySmartPortDevice(&device);
+    CHECK(disk.close());
+    std::filesystem::remove(path);
+    std::filesystem::remove(deltaPath);
+}
+
+TEST_CASE("Delta records that fail their check are skipped") {
+    auto path = makeTestPath("clem_smartport_torn");
+    auto deltaPath = path + ".delta";
+    std::filesystem::remove(deltaPath);
+    writeTestImage(path);
+    std::vector<uint8_t> block(512);
+    std::vector<uint8_t> readBack(512);
+    {
+        ClemensSmartPortDisk disk;
+        REQUIRE(disk.openOverlay(path, deltaPath));
+        fillBlock(block.data(), 5, 0xa5);
+        disk.write(5, block.data());
+        CHECK(disk.flush());
+        fillBlock(block.data(), 5, 0x3c);
+        disk.write(5, block.data());
+        CHECK(disk.close());
+    }
+    //  tear the second record of block 5, and add a zeroed record as left by a
+    //  write that never happened
+    {
+        std::fstream delta(deltaPath, std::ios::binary | std::ios::in | std::ios::out);
+        delta.seekp(16 + (12 + 512) + 12 + 100);
+        delta.put(0);
+        delta.seekp(0, std::ios::end);
+        std::vector<char> zeroes(12 + 512, 0);
+        delta.write(zeroes.data(), zeroes.size());
+    }
+    {
+        //  the first record of block 5 is still there, and block 0 is the
+        //  image's
+        ClemensSmartPortDisk disk;
+        REQUIRE(disk.openOverlay(path, deltaPath));
+        disk.read(5, readBack.data());
+        fillBlock(block.data(), 5, 0xa5);
+        CHECK(readBack == block);
+        disk.read(0, readBack.data());
+        fillBlock(block.data(), 0, 0);
+        CHECK(readBack == block);
+
+        //  the next write replaces the torn record rather than the good one
+        fillBlock(block.data(), 5, 0x5a);
+        disk.write(5, block.data());
+        CHECK(disk.close());
+    }
+    ClemensSmartPortDisk disk;
+    REQUIRE(disk.openOverlay(path, deltaPath));
+    disk.read(5, readBack.data());
+    CHECK(readBack == block);
+    CHECK(disk.close());
+    std::filesystem::remove(path);
+    std::filesystem::remove(deltaPath);
+}
+
+TEST_CASE("An overlay is committed to the image or discarded") {
+    auto path = makeTestPath("clem_smartport_commit");
+    auto deltaPath = path + ".delta";
+    std::filesystem::remove(deltaPath);
+    writeTestImage(path);
+    std::vector<uint8_t> block(512);
+    std::vector<uint8_t> readBack(512);
+
+    ClemensSmartPortDisk disk;
+    REQUIRE(disk.openOverlay(path, deltaPath));
+    fillBlock(block.data(), 10, 0xa5);
+    disk.write(10, block.data());
+#if !defined(_WIN32)
+    //  the image is replaced rather than written over, so a machine that still
+    //  has the old one open keeps reading it
+    std::ifstream oldImage(path, std::ios::binary);
+#endif
+    CHECK(disk.commit());
+    CHECK(readFileBlock(path, 10) == block);
+    CHECK(std::filesystem::file_size(deltaPath) == 16);
+    CHECK_FALSE(std::filesystem::exists(path + ".tmp"));
+#if !defined(_WIN32)
+    oldImage.seekg(CLEM_2IMG_HEADER_BYTE_SIZE + 10 * 512);
+    oldImage.read((char *)readBack.data(), readBack.size());
+    fillBlock(block.data(), 10, 0);
+    CHECK(readBack == block);
+    fillBlock(block.data(), 10, 0xa5);
+    oldImage.close();
+#endif
+
+    fillBlock(block.data(), 11, 0x5a);
+    disk.write(11, block.data());
+    CHECK(disk.flush());
+    CHECK(disk.discard());
+    CHECK(std::filesystem::file_size(deltaPath) == 16);
+    disk.read(11, readBack.data());
+    fillBlock(block.data(), 11, 0);
+    CHECK(readBack == block);
+    //  the committed block is the image's now
+    disk.read(10, readBack.data());
+    fillBlock(block.data(), 10, 0xa5);
+    CHECK(readBack == block);
+    CHECK(disk.close());
+
+    //  without a delta file, an image that doesn't exist can't be overlaid
+    std::filesystem::remove(path);
+    CHECK_FALSE(disk.openOverlay(path, deltaPath));
+    std::filesystem::remove(deltaPath);
+}
+
+TEST_CASE("A snapshot's disk without the newer keys is restored") {
+    //  snapshots from before directory volumes and overlays have neither key
+    auto path = makeTestPath("clem_smartport_snapshot");
+    writeTestImage(path);
+    std::vector<char> image;
+    {
+        std::ifstream in(path, std::ios::binary);
+        image.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    char *snapshot;
+    size_t snapshotSize;
+    mpack_writer_t writer;
+    mpack_writer_init_growable(&writer, &snapshot, &snapshotSize);
+    mpack_build_map(&writer);
+    mpack_write_cstr(&writer, "path");
+    mpack_write_cstr(&writer, path.c_str());
+    mpack_write_cstr(&writer, "impl");
+    mpack_write_nil(&writer);
+    mpack_write_cstr(&writer, "pages");
+    mpack_start_array(&writer, unsigned((image.size() + 4095) / 4096));
+    for (size_t offset = 0; offset < image.size(); offset += 4096) {
+        mpack_write_bin(&writer, image.data() + offset,
+                        unsigned(std::min<size_t>(image.size() - offset, 4096)));
+    }
+    mpack_finish_array(&writer);
+    mpack_complete_map(&writer);
+    REQUIRE(mpack_writer_destroy(&writer) == mpack_ok);
+
+    ClemensSmartPortDisk disk;
+    ClemensSmartPortDevice device{};
+    mpack_reader_t reader;
+    mpack_reader_init_data(&reader, snapshot, snapshotSize);
+    disk.unserialize(&reader, &device, nullptr, nullptr);
+    CHECK(mpack_reader_destroy(&reader) == mpack_ok);
+    MPACK_FREE(snapshot);
+    CHECK(disk.isOpen());
+    CHECK_FALSE(disk.isOverlay());
+    CHECK(disk.getDisk().block_count == kBlockCount);
+    std::vector<uint8_t> block(512);
+    std::vector<uint8_t> readBack(512);
+    disk.read(3, readBack.data());
+    fillBlock(block.data(), 3, 0);
+    CHECK(readBack == block);
+    CHECK(disk.close());
+    std::filesystem::remove(path);
+}
@@ -0,0 +1,86 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h.h"
+
+#include "clem_symbol_table.hpp"
+
+#include <string>
+
+TEST_CASE("ld65 debug info symbols are read") {
+    ClemensSymbolTable symbols;
+    CHECK(symbols.parse("version\tmajor=2,minor=0\n"
+                        "sym\tid=0,name=\"main\",addrsize=absolute,scope=0,def=1,val=0x2000,"
+                        "seg=0,type=lab\n"
+                        "sym\tid=1,name=\"COUNT\",addrsize=zeropage,scope=0,def=2,val=0x10,"
+                        "type=equ\n"
+                        "sym\tid=2,name=\"COUT\",addrsize=absolute,scope=0,ref=3,type=imp\n"
+                        "sym\tid=3,name=\"far\",addrsize=far,scope=0,def=4,val=0x12000F,"
+                        "seg=1,type=lab\n") == 2);
+    CHECK(symbols.findAddress("main") == 0x2000u);
+    CHECK(symbols.findAddress("far") == 0x12000fu);
+    CHECK_FALSE(symbols.findAddress("COUNT").has_value());
+    CHECK_FALSE(symbols.findAddress("COUT").has_value());
+}
+
+TEST_CASE("Label, Merlin and plain symbols are read") {
+    ClemensSymbolTable symbols;
+    CHECK(symbols.parse("al 002000 .start\n"
+                        "al 00200A .loop\n") == 2);
+    CHECK(symbols.parse("Symbol table - alphabetical order:\n"
+                        "  HOME    =$FC58    ?COUT    =$FDED\n"
+                        "  ]TEMP   =$06      BUF EQU $0200\n") == 3);
+    CHECK(symbols.parse("; comment\n"
+                        "$E1/0010 dispatch\n"
+                        "e10000 tool_entry\n"
+                        "not a symbol\n") == 2);
+    CHECK(symbols.size() == 7);
+    CHECK(symbols.findAddress("loop") == 0x200au);
+    CHECK(symbols.findAddress("COUT") == 0xfdedu);
+    CHECK(symbols.findAddress("BUF") == 0x0200u);
+    CHECK_FALSE(symbols.findAddress("]TEMP").has_value());
+    CHECK(symbols.findAddress("dispatch") == 0xe10010u);
+    CHECK(symbols.findAddress("tool_entry") == 0xe10000u);
+}
+
+TEST_CASE("Addresses resolve to the nearest symbol in the bank") {
+    ClemensSymbolTable symbols;
+    symbols.parse("002000 main\n"
+                  "002000 main_alias\n"
+                  "002010 loop\n"
+                  "01FF00 high\n");
+    ClemensSymbolTable::Symbol symbol;
+    REQUIRE(symbols.lookup(0x2000, symbol));
+    CHECK(std::string(symbol.name) == "main");
+    CHECK(symbol.offset == 0);
+    //  within the same symbol (the cached range) and then past it
+    REQUIRE(symbols.lookup(0x200f, symbol));
+    CHECK(std::string(symbol.name) == "main");
+    CHECK(symbol.offset == 0xf);
+    REQUIRE(symbols.lookup(0x2012, symbol));
+    CHECK(std::string(symbol.name) == "loop");
+    REQUIRE(symbols.lookup(0x2001, symbol));
+    CHECK(std::string(symbol.name) == "main");
+    CHECK_FALSE(symbols.lookup(0x1fff, symbol));
+    //  nothing in bank 2, so bank 1's last symbol doesn't carry over
+    CHECK_FALSE(symbols.lookup(0x020000, symbol));
+    REQUIRE(symbols.lookup(0x01ff80, symbol));
+    CHECK(std::string(symbol.name) == "high");
+
+    char text[32];
+    CHECK(symbols.format(text, sizeof(text), 0x2010) == 4);
+    CHECK(std::string(text) == "loop");
+    CHECK(symbols.format(text, sizeof(text), 0x201a) == 7);
+    CHECK(std::string(text) == "loop+$A");
+    CHECK(symbols.format(text, sizeof(text), 0x1000) == 0);
+}
+
+TEST_CASE("Loading the same symbols again adds nothing") {
+    ClemensSymbolTable symbols;
+    CHECK(symbols.parse("002000 main\n") == 1);
+    CHECK(symbols.parse("002000 main\n002004 next\n") == 1);
+    CHECK(symbols.size() == 2);
+    symbols.clear();
+    CHECK(symbols.empty());
+    ClemensSymbolTable::Symbol symbol;
+    CHECK_FALSE(symbols.lookup(0x2000, symbol));
+    CHECK_FALSE(symbols.load("/nonexistent/symbols.txt"));
+}
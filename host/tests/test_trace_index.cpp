@@ -0,0 +1,156 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h.h"
+
+#include "clem_trace_index.hpp"
+
+#include <filesystem>
+#include <memory>
+#include <string>
+
+#if defined(_WIN32)
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+
+//  small segments so that a short trace is split across many runs that are
+//  merged as it grows
+constexpr size_t kTestSegmentPostings = 256;
+constexpr uint64_t kFirstSeq = 1000;
+constexpr unsigned kInstructionCount = 10000;
+constexpr unsigned kPCCount = 7;
+constexpr unsigned kWriteInterval = 10;
+constexpr unsigned kWriteAddressCount = 5;
+
+uint32_t instructionPC(unsigned index) { return 0x012000 + (index % kPCCount) * 2; }
+uint32_t instructionWrite(unsigned index) { return 0x000400 + (index % kWriteAddressCount); }
+bool instructionWrites(unsigned index) { return (index % kWriteInterval) == 0; }
+
+std::string makeTestDirectory(const char *name) {
+    auto path = std::filesystem::temp_directory_path() /
+                (std::string(name) + "." + std::to_string(getpid()));
+    std::filesystem::remove_all(path);
+    return path.string();
+}
+
+size_t countRunFiles(const std::string &directory) {
+    size_t count = 0;
+    for (auto &entry : std::filesystem::directory_iterator(directory)) {
+        if (entry.path().extension() == ".run")
+            ++count;
+    }
+    return count;
+}
+
+//  Adds synthetic instructions: A counts them, PCs cycle through a small loop
+//  and every kWriteInterval-th instruction stores to one of a few addresses
+void addTestInstructions(ClemensTraceIndex &index) {
+    static ClemensOpcodeDesc desc{kClemensCPUAddrMode_Absolute, "STA"};
+    auto machine = std::make_unique<ClemensMachine>();
+    for (unsigned i = 0; i < kInstructionCount; ++i) {
+        ClemensInstruction instruction{};
+        instruction.desc = &desc;
+        instruction.opc = 0x8d;
+        instruction.pbr = uint8_t(instructionPC(i) >> 16);
+        instruction.addr = uint16_t(instructionPC(i) & 0xffff);
+        instruction.value = uint16_t(i);
+        instruction.cycles_spent = 4;
+        machine->cpu.regs.A = uint16_t(i);
+        machine->cpu.regs.X = uint16_t(i / 100);
+        machine->cpu.pins.emulation = (i / 1000) % 2 != 0;
+        if (instructionWrites(i)) {
+            auto *writeLog = index.getWriteLog();
+            writeLog->addr[0] = instructionWrite(i);
+            writeLog->data[0] = uint8_t(i);
+            writeLog->count = 1;
+        }
+        index.addInstruction(kFirstSeq + i, instruction, *machine);
+    }
+}
+
+} // namespace
+
+TEST_CASE("Postings are found across merged runs") {
+    auto directory = makeTestDirectory("clem_trace_index_postings");
+    {
+        ClemensTraceIndex index(directory, kTestSegmentPostings);
+        addTestInstructions(index);
+        REQUIRE(index.isOk());
+        CHECK(index.getFirstSeq() == kFirstSeq);
+        CHECK(index.getInstructionCount() == kInstructionCount);
+        CHECK(std::string(index.getOpcodeName(0x8d)) == "STA");
+        //  39 segments were flushed, but merging leaves O(log n) runs
+        CHECK(kInstructionCount / kTestSegmentPostings > 32);
+        CHECK(countRunFiles(directory) <= 2 * 8);
+
+        for (unsigned pcIndex = 0; pcIndex < kPCCount; ++pcIndex) {
+            uint32_t pc = instructionPC(pcIndex);
+            uint64_t executionCount = (kInstructionCount - pcIndex + kPCCount - 1) / kPCCount;
+            for (uint64_t nth = 1; nth <= executionCount; ++nth) {
+                auto seq = index.findExecution(pc, nth);
+                REQUIRE(seq.has_value());
+                CHECK(*seq == kFirstSeq + pcIndex + (nth - 1) * kPCCount);
+            }
+            CHECK_FALSE(index.findExecution(pc, executionCount + 1).has_value());
+        }
+        CHECK_FALSE(index.findExecution(0x012001, 1).has_value());
+        CHECK_FALSE(index.findExecution(instructionPC(0), 0).has_value());
+
+        for (unsigned i = 0; i < kInstructionCount; i += 37) {
+            uint64_t seq = kFirstSeq + i;
+            for (unsigned addrIndex = 0; addrIndex < kWriteAddressCount; ++addrIndex) {
+                uint32_t addr = instructionWrite(addrIndex);
+                std::optional<uint64_t> expected;
+                for (unsigned j = i + 1; j-- > 0;) {
+                    if (instructionWrites(j) && instructionWrite(j) == addr) {
+                        expected = kFirstSeq + j;
+                        break;
+                    }
+                }
+                CHECK(index.findLastWrite(addr, seq) == expected);
+            }
+        }
+        CHECK_FALSE(index.findLastWrite(0x000400, kFirstSeq - 1).has_value());
+        CHECK_FALSE(index.findLastWrite(0x000500, kFirstSeq + kInstructionCount).has_value());
+    }
+    //  the index removes its files
+    CHECK(countRunFiles(directory) == 0);
+    std::filesystem::remove_all(directory);
+}
+
+TEST_CASE("Seeking decodes from the nearest checkpoint") {
+    auto directory = makeTestDirectory("clem_trace_index_seek");
+    {
+        ClemensTraceIndex index(directory, kTestSegmentPostings);
+        addTestInstructions(index);
+        REQUIRE(index.isOk());
+
+        ClemensTraceIndex::Record record;
+        for (unsigned i : {0u, 1u, 999u, 1000u, 4095u, 4096u, 4097u, 8191u, 8192u, 9999u}) {
+            REQUIRE(index.seek(kFirstSeq + i, record));
+            CHECK(record.seq == kFirstSeq + i);
+            CHECK(record.pc == instructionPC(i));
+            CHECK(record.regs.PC == (instructionPC(i) & 0xffff));
+            CHECK(record.regs.PBR == (instructionPC(i) >> 16));
+            CHECK(record.opcode == 0x8d);
+            CHECK(record.value == uint16_t(i));
+            CHECK(record.cycles == 4);
+            CHECK(record.regs.A == uint16_t(i));
+            CHECK(record.regs.X == uint16_t(i / 100));
+            CHECK(record.emulation == ((i / 1000) % 2 != 0));
+            if (instructionWrites(i)) {
+                REQUIRE(record.writeCount == 1);
+                CHECK(record.writeAddrs[0] == instructionWrite(i));
+                CHECK(record.writeData[0] == uint8_t(i));
+            } else {
+                CHECK(record.writeCount == 0);
+            }
+        }
+        CHECK_FALSE(index.seek(kFirstSeq - 1, record));
+        CHECK_FALSE(index.seek(kFirstSeq + kInstructionCount, record));
+    }
+    std::filesystem::remove_all(directory);
+}
@@ -0,0 +1,382 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h.h"
+
+#include "clem_video_capture.hpp"
+#include "render.h"
+
+#include <array>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+
+constexpr unsigned kWidth = ClemensVideoCapture::kFrameWidth;
+constexpr unsigned kHeight = ClemensVideoCapture::kFrameHeight;
+
+//  A hires screen of zeroed memory (black) inside a white border
+struct TestScreen {
+    ClemensMonitor monitor{};
+    ClemensVideo text{};
+    ClemensVideo graphics{};
+    std::array<ClemensScanline, 192> scanlines{};
+    std::vector<uint8_t> e0;
+    std::vector<uint8_t> e1;
+
+    TestScreen() : e0(0x10000), e1(0x10000) {
+        clemens_render_init();
+        monitor.border_color = 15;
+        text.format = kClemensVideoFormat_None;
+        for (unsigned row = 0; row < scanlines.size(); ++row) {
+            scanlines[row].offset = 0x2000 + row * 40;
+        }
+        graphics.format = kClemensVideoFormat_Hires;
+        graphics.scanlines = scanlines.data();
+        graphics.scanline_byte_cnt = 40;
+        graphics.scanline_count = int(scanlines.size());
+        graphics.scanline_limit = int(scanlines.size());
+    }
+
+    void submit(ClemensVideoCapture &capture, unsigned frameCount) {
+        capture.submit(monitor, text, graphics, e0.data(), e1.data(), 0, frameCount);
+    }
+};
+
+std::string makeTestPath(const char *name) {
+    auto path = std::filesystem::temp_directory_path() /
+                (std::string(name) + "." + std::to_string(getpid()));
+    std::filesystem::remove_all(path);
+    return path.string();
+}
+
+std::vector<uint8_t> readFile(const std::filesystem::path &path) {
+    std::ifstream in(path, std::ios_base::in | std::ios_base::binary);
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(in),
+                                std::istreambuf_iterator<char>());
+}
+
+uint32_t getU32(const uint8_t *in) {
+    return (uint32_t(in[0]) << 24) | (uint32_t(in[1]) << 16) | (uint32_t(in[2]) << 8) | in[3];
+}
+
+//  bitwise, rather than the capture's table driven version
+uint32_t referenceCRC32(const uint8_t *data, size_t len) {
+    uint32_t crc = 0xffffffff;
+    for (size_t i = 0; i < len; ++i) {
+        crc ^= data[i];
+        for (int k = 0; k < 8; ++k) {
+            crc = (crc >> 1) ^ (0xedb88320 & (0u - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
+
+struct PNGChunk {
+    std::string type;
+    const uint8_t *data;
+    uint32_t length;
+};
+
+//  A reference inflater for stored and fixed Huffman blocks, decoding a code
+//  bit at a time rather than sharing anything with the capture's encoder
+class Inflater {
+  public:
+    Inflater(const uint8_t *data, size_t size) : data_(data), size_(size), pos_(0), bit_(0) {}
+
+    bool inflate(std::vector<uint8_t> &out) {
+        bool isFinal = false;
+        while (!isFinal) {
+            isFinal = bits(1) != 0;
+            unsigned type = bits(2);
+            if (type == 0) {
+                //  stored blocks start on a byte boundary
+                if (bit_ > 0) {
+                    bit_ = 0;
+                    ++pos_;
+                }
+                if (pos_ + 4 > size_)
+                    return false;
+                unsigned len = data_[pos_] | (data_[pos_ + 1] << 8);
+                unsigned nlen = data_[pos_ + 2] | (data_[pos_ + 3] << 8);
+                pos_ += 4;
+                if ((len ^ 0xffff) != nlen || pos_ + len > size_)
+                    return false;
+                out.insert(out.end(), data_ + pos_, data_ + pos_ + len);
+                pos_ += len;
+            } else if (type == 1) {
+                if (!inflateFixed(out))
+                    return false;
+            } else {
+                return false;
+            }
+            if (pos_ > size_)
+                return false;
+        }
+        //  the Adler-32 follows on a byte boundary
+        if (bit_ > 0) {
+            bit_ = 0;
+            ++pos_;
+        }
+        return true;
+    }
+
+    size_t tell() const { return pos_; }
+
+  private:
+    static constexpr uint16_t kLengthBase[29] = {3,  4,  5,  6,  7,  8,  9,  10,  11,  13,
+                                                 15, 17, 19, 23, 27, 31, 35, 43,  51,  59,
+                                                 67, 83, 99, 115, 131, 163, 195, 227, 258};
+    static constexpr uint8_t kLengthExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+                                                 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+    static constexpr uint16_t kDistanceBase[30] = {
+        1,   2,   3,   4,   5,   7,    9,    13,   17,   25,   33,   49,   65,    97,    129,
+        193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+    static constexpr uint8_t kDistanceExtra[30] = {0, 0, 0, 0, 1, 1, 2, 2,  3,  3,  4,  4,  5,  5,  6,
+                                                   6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+    //  values are packed least significant bit first, and reading past the end
+    //  yields zeros (caught by the position check)
+    unsigned bits(unsigned count) {
+        unsigned value = 0;
+        for (unsigned i = 0; i < count; ++i) {
+            unsigned bit = pos_ < size_ ? (data_[pos_] >> bit_) & 1 : 0;
+            value |= bit << i;
+            if (++bit_ == 8) {
+                bit_ = 0;
+                ++pos_;
+            }
+        }
+        return value;
+    }
+    //  ...and Huffman codes most significant bit first
+    unsigned code(unsigned count, unsigned value = 0) {
+        for (unsigned i = 0; i < count; ++i) {
+            value = (value << 1) | bits(1);
+        }
+        return value;
+    }
+
+    int decodeLiteralLength() {
+        unsigned value = code(7);
+        if (value <= 23)
+            return int(256 + value);
+        value = code(1, value);
+        if (value >= 0x30 && value <= 0xbf)
+            return int(value - 0x30);
+        if (value >= 0xc0 && value <= 0xc7)
+            return int(280 + value - 0xc0);
+        value = code(1, value);
+        if (value >= 0x190 && value <= 0x1ff)
+            return int(144 + value - 0x190);
+        return -1;
+    }
+
+    bool inflateFixed(std::vector<uint8_t> &out) {
+        for (;;) {
+            int symbol = decodeLiteralLength();
+            if (symbol < 0 || symbol > 285 || pos_ > size_)
+                return false;
+            if (symbol < 256) {
+                out.push_back(uint8_t(symbol));
+                continue;
+            }
+            if (symbol == 256)
+                return true;
+            unsigned length = kLengthBase[symbol - 257] + bits(kLengthExtra[symbol - 257]);
+            unsigned distanceCode = code(5);
+            if (distanceCode >= 30)
+                return false;
+            unsigned distance = kDistanceBase[distanceCode] + bits(kDistanceExtra[distanceCode]);
+            if (distance > out.size())
+                return false;
+            for (unsigned i = 0; i < length; ++i) {
+                out.push_back(out[out.size() - distance]);
+            }
+        }
+    }
+
+    const uint8_t *data_;
+    size_t size_;
+    size_t pos_;
+    unsigned bit_;
+};
+
+uint32_t referenceAdler32(const uint8_t *data, size_t len) {
+    uint32_t a = 1, b = 0;
+    for (size_t i = 0; i < len; ++i) {
+        a = (a + data[i]) % 65521;
+        b = (b + a) % 65521;
+    }
+    return (b << 16) | a;
+}
+
+//  Reverses the PNG row filters in place, returning false on an unknown filter
+bool unfilterRows(std::vector<uint8_t> &raw, unsigned rowBytes, unsigned pixelBytes) {
+    for (size_t row = 0; row * rowBytes < raw.size(); ++row) {
+        uint8_t *line = &raw[row * rowBytes];
+        const uint8_t *prior = row > 0 ? line - rowBytes : nullptr;
+        uint8_t filter = line[0];
+        for (unsigned i = 1; i < rowBytes; ++i) {
+            int a = i > pixelBytes ? line[i - pixelBytes] : 0;
+            int b = prior ? prior[i] : 0;
+            int c = prior && i > pixelBytes ? prior[i - pixelBytes] : 0;
+            int predictor;
+            switch (filter) {
+            case 0:
+                predictor = 0;
+                break;
+            case 1:
+                predictor = a;
+                break;
+            case 2:
+                predictor = b;
+                break;
+            case 3:
+                predictor = (a + b) / 2;
+                break;
+            case 4: {
+                int p = a + b - c;
+                int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+                predictor = (pa <= pb && pa <= pc) ? a : (pb <= pc ? b : c);
+                break;
+            }
+            default:
+                return false;
+            }
+            line[i] = uint8_t(line[i] + predictor);
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+TEST_CASE("A PNG frame has a valid signature, header and chunk CRCs") {
+    auto directory = makeTestPath("clem_video_capture_png");
+    TestScreen screen;
+    {
+        ClemensVideoCapture capture(ClemensVideoCapture::Format::PNG, directory, nullptr,
+                                    nullptr);
+        REQUIRE(capture.isOpen());
+        screen.submit(capture, 1);
+        capture.finish();
+        auto stats = capture.getStats();
+        CHECK(stats.imagesSubmitted == 1);
+        CHECK(stats.framesWritten == 1);
+        CHECK_FALSE(stats.writeFailed);
+    }
+    CHECK_FALSE(std::filesystem::exists(std::filesystem::path(directory) / "frame_000001.png"));
+    auto png = readFile(std::filesystem::path(directory) / "frame_000000.png");
+    REQUIRE(png.size() > 8);
+    static const uint8_t kSignature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    CHECK(std::equal(kSignature, kSignature + 8, png.begin()));
+
+    std::vector<PNGChunk> chunks;
+    size_t pos = 8;
+    while (pos + 12 <= png.size()) {
+        PNGChunk chunk;
+        chunk.length = getU32(&png[pos]);
+        REQUIRE(pos + 12 + chunk.length <= png.size());
+        chunk.type.assign(reinterpret_cast<const char *>(&png[pos + 4]), 4);
+        chunk.data = &png[pos + 8];
+        //  the CRC covers the type and data
+        CHECK(getU32(&png[pos + 8 + chunk.length]) ==
+              referenceCRC32(&png[pos + 4], chunk.length + 4));
+        chunks.push_back(chunk);
+        pos += 12 + chunk.length;
+    }
+    CHECK(pos == png.size());
+    REQUIRE(chunks.size() == 3);
+    CHECK(chunks[0].type == "IHDR");
+    CHECK(chunks[1].type == "IDAT");
+    CHECK(chunks[2].type == "IEND");
+    CHECK(chunks[2].length == 0);
+
+    REQUIRE(chunks[0].length == 13);
+    const uint8_t *ihdr = chunks[0].data;
+    CHECK(getU32(ihdr) == kWidth);
+    CHECK(getU32(ihdr + 4) == kHeight);
+    CHECK(ihdr[8] == 8);  // bit depth
+    CHECK(ihdr[9] == 2);  // truecolor
+    CHECK(ihdr[10] == 0); // deflate
+    CHECK(ihdr[11] == 0); // adaptive filtering
+    CHECK(ihdr[12] == 0); // no interlace
+
+    //  a zlib stream, compressed well below the raw image size
+    const uint8_t *zdata = chunks[1].data;
+    REQUIRE(chunks[1].length > 6);
+    CHECK(zdata[0] == 0x78);
+    CHECK(((zdata[0] << 8) | zdata[1]) % 31 == 0);
+    CHECK((zdata[1] & 0x20) == 0); // no preset dictionary
+    const unsigned rowBytes = kWidth * 3 + 1;
+    CHECK(chunks[1].length < rowBytes * kHeight / 4);
+
+    //  that inflates to filtered rows, followed by their Adler-32
+    std::vector<uint8_t> raw;
+    Inflater inflater(zdata + 2, chunks[1].length - 2);
+    REQUIRE(inflater.inflate(raw));
+    REQUIRE(raw.size() == rowBytes * kHeight);
+    REQUIRE(inflater.tell() + 2 + 4 == chunks[1].length);
+    CHECK(getU32(zdata + 2 + inflater.tell()) == referenceAdler32(raw.data(), raw.size()));
+    REQUIRE(unfilterRows(raw, rowBytes, 3));
+
+    //  white border and a black hires area, as in the Y4M stream
+    auto pixel = [&](unsigned x, unsigned y) {
+        const uint8_t *rgb = &raw[y * rowBytes + 1 + x * 3];
+        return std::array<uint8_t, 3>{rgb[0], rgb[1], rgb[2]};
+    };
+    const std::array<uint8_t, 3> kWhite{255, 255, 255}, kBlack{0, 0, 0};
+    CHECK(pixel(0, 0) == kWhite);
+    CHECK(pixel(kWidth - 1, kHeight - 1) == kWhite);
+    CHECK(pixel(kWidth / 2, kHeight / 2) == kBlack);
+    std::filesystem::remove_all(directory);
+}
+
+TEST_CASE("Y4M frames follow the stream header with full planes") {
+    auto streamPath = makeTestPath("clem_video_capture_y4m") + ".y4m";
+    TestScreen screen;
+    {
+        ClemensVideoCapture capture(ClemensVideoCapture::Format::Y4M, streamPath, nullptr,
+                                    nullptr);
+        REQUIRE(capture.isOpen());
+        //  one image standing in for two 60hz frames
+        screen.submit(capture, 2);
+        capture.finish();
+        CHECK(capture.getStats().framesWritten == 2);
+    }
+    auto y4m = readFile(streamPath);
+    const std::string header = "YUV4MPEG2 W640 H400 F60:1 Ip A1:1 C420jpeg\n";
+    const std::string frameTag = "FRAME\n";
+    const size_t lumaSize = kWidth * kHeight;
+    const size_t chromaSize = (kWidth / 2) * (kHeight / 2);
+    const size_t frameSize = frameTag.size() + lumaSize + chromaSize * 2;
+    REQUIRE(y4m.size() == header.size() + frameSize * 2);
+    CHECK(std::string(y4m.begin(), y4m.begin() + header.size()) == header);
+
+    for (size_t frameIndex = 0; frameIndex < 2; ++frameIndex) {
+        const uint8_t *frame = &y4m[header.size() + frameIndex * frameSize];
+        CHECK(std::string(frame, frame + frameTag.size()) == frameTag);
+        const uint8_t *luma = frame + frameTag.size();
+        const uint8_t *cb = luma + lumaSize;
+        const uint8_t *cr = cb + chromaSize;
+        //  white border, black hires area, and no color in either
+        CHECK(luma[0] == 255);
+        CHECK(luma[lumaSize - 1] == 255);
+        CHECK(luma[(kHeight / 2) * kWidth + kWidth / 2] == 0);
+        CHECK(cb[0] == 128);
+        CHECK(cr[0] == 128);
+        CHECK(cb[chromaSize - 1] == 128);
+        CHECK(cr[(kHeight / 4) * (kWidth / 2) + kWidth / 4] == 128);
+    }
+    std::filesystem::remove(streamPath);
+}
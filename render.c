@@ -1,5 +1,8 @@
 #include "render.h"
 
+#include <assert.h>
+#include <string.h>
+
 /* 320x200 scanline mode renders 2x2 pixels to the buffer.
    640x200 scanline mode renders 1x2 pixels to the buffer.
 
@@ -143,8 +146,24 @@ static unsigned stateToColorAction[8] = {
     /* b111 */ 3, //  > 2 adjacent on = white
 };
 
-static void a2hgrToABGR8Scale2x2(uint8_t *pixout, uint8_t *pixout2, const uint8_t *hgr) {
-    //  input is 40 bytes of hgr data to 280 bytes (1 byte per pixel)
+//  Each byte's 7 pixels depend only on the 3 pixel window around each pixel,
+//  the byte's color group (the next byte's group for its last pixel, as the
+//  group is sampled with the incoming bit) and the parity of the pixel's x
+//  position.  So the 14 output pixels for a byte are precomputed for every
+//  combination of:
+//
+//    bits 0-7  = the byte
+//    bit 8     = bit 6 of the previous byte (the pixel at x-1)
+//    bit 9     = bit 0 of the next byte (the pixel at x+7)
+//    bit 10    = bit 7 of the next byte (its color group)
+//    bit 11    = byte index is odd
+//
+#define CLEM_RENDER_HGR_SPAN_KEYS 4096
+#define CLEM_RENDER_HGR_SPAN_SIZE 14
+
+static uint8_t s_hgr_spans[CLEM_RENDER_HGR_SPAN_KEYS][CLEM_RENDER_HGR_SPAN_SIZE];
+
+static void _render_init_hgr_spans(void) {
     //  colors are one, zero, even, odd
     //  strategy:
     //
@@ -178,66 +197,51 @@ static void a2hgrToABGR8Scale2x2(uint8_t *pixout, uint8_t *pixout2, const uint8_
     //
     //  group = bit 7 of color/pixel byte
 
-    unsigned state = 0;
-    int xpos = -2;
-    unsigned group;
-    uint8_t pixel;
-    for (int byteIdx = 0; byteIdx < 40; ++byteIdx) {
-        uint8_t byte = hgr[byteIdx];
-        group = byte >> 7;
-        unsigned pxmask = 0x1;
-        while (pxmask != 0x80) {
-            unsigned bit = byte & pxmask;
-            state <<= 1;
-            pxmask <<= 1;
-            if (bit)
-                state |= 1;
-
-            unsigned action = stateToColorAction[state & 0x7];
+    unsigned key, i;
+    for (key = 0; key < CLEM_RENDER_HGR_SPAN_KEYS; ++key) {
+        //  bit 0 = pixel at x-1, bits 1-7 = the byte's pixels, bit 8 = pixel at x+7
+        unsigned bits = ((key >> 8) & 1) | ((key & 0x7f) << 1) | (((key >> 9) & 1) << 8);
+        unsigned odd_byte = (key >> 11) & 1;
+        for (i = 0; i < 7; ++i) {
+            unsigned state = (((bits >> i) & 1) << 2) | (((bits >> (i + 1)) & 1) << 1) |
+                             ((bits >> (i + 2)) & 1);
+            unsigned action = stateToColorAction[state];
+            unsigned odd_x = (odd_byte + i) & 1;
+            unsigned group = i < 6 ? (key >> 7) & 1 : (key >> 10) & 1;
             unsigned color;
-            if (xpos >= 0) {
-                if (action == 0)
-                    color = 0;
-                else if (action == 1) {
-                    if (xpos & 2)
-                        color = 2;
-                    else
-                        color = 1;
-                } else if (action == 2) {
-                    if (xpos & 2)
-                        color = 1;
-                    else
-                        color = 2;
-                } else {
-                    color = 3;
-                }
-                //  normalize hcolor 0 to 7 to 0-255 to be shader friendly
-                pixel = (abgrFromHGRBitTable[color][group & 1] << 5) + 16;
-                pixout[xpos] = pixel;
-                pixout[xpos + 1] = pixel;
-                pixout2[xpos] = pixel;
-                pixout2[xpos + 1] = pixel;
-            }
-            xpos += 2;
+            uint8_t pixel;
+            if (action == 0)
+                color = 0;
+            else if (action == 1)
+                color = odd_x ? 2 : 1;
+            else if (action == 2)
+                color = odd_x ? 1 : 2;
+            else
+                color = 3;
+            //  normalize hcolor 0 to 7 to 0-255 to be shader friendly
+            pixel = (abgrFromHGRBitTable[color][group] << 5) + 16;
+            s_hgr_spans[key][i * 2] = pixel;
+            s_hgr_spans[key][i * 2 + 1] = pixel;
         }
     }
-    state <<= 1;
-    unsigned action = stateToColorAction[state & 0x7];
-    unsigned color;
-    if (action == 0)
-        color = 0;
-    else if (action == 1) {
-        color = 2;
-    } else if (action == 2) {
-        color = 1;
-    } else {
-        color = 3;
+}
+
+static void a2hgrToABGR8Scale2x2(uint8_t *pixout, uint8_t *pixout2, const uint8_t *hgr) {
+    //  input is 40 bytes of hgr data to 280 pixels, scaled 2x2
+    unsigned prev_bit = 0;
+    unsigned byteIdx;
+    for (byteIdx = 0; byteIdx < 40; ++byteIdx) {
+        unsigned byte = hgr[byteIdx];
+        //  the last pixel on the line has no neighbor and keeps its group
+        unsigned next = byteIdx < 39 ? hgr[byteIdx + 1] : (byte & 0x80);
+        unsigned key = byte | (prev_bit << 8) | ((next & 1) << 9) | ((next >> 7) << 10) |
+                       ((byteIdx & 1) << 11);
+        memcpy(pixout, s_hgr_spans[key], CLEM_RENDER_HGR_SPAN_SIZE);
+        memcpy(pixout2, s_hgr_spans[key], CLEM_RENDER_HGR_SPAN_SIZE);
+        pixout += CLEM_RENDER_HGR_SPAN_SIZE;
+        pixout2 += CLEM_RENDER_HGR_SPAN_SIZE;
+        prev_bit = (byte >> 6) & 1;
     }
-    pixel = (abgrFromHGRBitTable[color][group & 1] << 5) + 16;
-    pixout[xpos] = pixel;
-    pixout[xpos + 1] = pixel;
-    pixout2[xpos] = pixel;
-    pixout2[xpos + 1] = pixel;
 }
 
 static void _render_hires(const ClemensVideo *video, const uint8_t *memory, uint8_t *texture,
@@ -297,12 +301,22 @@ static void _render_hires(const ClemensVideo *video, const uint8_t *memory, uint
 //    Latched Color:
 //        Initially Zero
 //
-//  This is a literal translation of the patent's Fig. 4 - which works pretty
-//  well to emulate the IIgs implementation.   This could be optimized via
-//  lookup tables.
+//  This is a translation of the patent's Fig. 4 - which works pretty well to
+//  emulate the IIgs implementation.  The flip-flops hold the latched color
+//  across an arbitrary number of bits, so rather than a per byte lookup, the
+//  per bit logic is table driven:
+//
+//    s_dhgr_step[phase][shift register][incoming bit] =
+//        barrel shifted color (bits 0-3), color change 0 (bit 4),
+//        color change 1 (bit 5), shift register bit 2 (bit 6)
 //
-//  TODO: optimize using lookup tables
+//    s_dhgr_jk[color changes, bit 2, flip-flops] = next flip-flops
 //
+//  Only the low 7 bits of the shift register contribute to the barrel.
+//
+static uint8_t s_dhgr_step[4][128][2];
+static uint8_t s_dhgr_jk[32];
+
 static inline bool jk_ff(bool j, bool k, bool q) {
     if (!j && !k)
         return q;
@@ -313,44 +327,57 @@ static inline bool jk_ff(bool j, bool k, bool q) {
     return !q;
 }
 
+static void _render_init_dhgr_tables(void) {
+    unsigned phase, shifter, bit, key;
+    for (phase = 0; phase < 4; ++phase) {
+        for (shifter = 0; shifter < 128; ++shifter) {
+            for (bit = 0; bit < 2; ++bit) {
+                unsigned barrel = ((shifter >> phase) | (shifter << (4 - phase))) & 0xf;
+                unsigned colorChanged0 = (bit && !(shifter & 0x8)) ? 1 : 0;
+                unsigned colorChanged1 = (!bit && (shifter & 0x8)) ? 1 : 0;
+                unsigned bit2 = (shifter & 0x4) ? 1 : 0;
+                s_dhgr_step[phase][shifter][bit] =
+                    (uint8_t)(barrel | (colorChanged0 << 4) | (colorChanged1 << 5) | (bit2 << 6));
+            }
+        }
+    }
+    //  key = step bits 4-6 | flip-flop 0 << 3 | flip-flop 1 << 4
+    for (key = 0; key < 32; ++key) {
+        bool colorChanged0 = (key & 0x1) != 0;
+        bool colorChanged1 = (key & 0x2) != 0;
+        bool bit2 = (key & 0x4) != 0;
+        bool jk0 = jk_ff(colorChanged0, bit2, (key & 0x8) != 0);
+        bool jk1 = jk_ff(colorChanged1, !bit2, (key & 0x10) != 0);
+        s_dhgr_jk[key] = (uint8_t)((jk0 ? 1 : 0) | (jk1 ? 2 : 0));
+    }
+}
+
 static void a2dhgrToABGR81x2(uint8_t *pixout0, uint8_t *pixout1, const uint8_t *scanlines[2],
                              int scanlineByteCnt) {
-    int pixinByteCounter = 0;
-    int pixinBitCounter = 0;
-    uint8_t pixinByte = *scanlines[0];
-    uint8_t shifter = 0;
-    uint8_t barrel = 0;
-    uint8_t latch = 0;
-    bool jk0 = false;
-    bool jk1 = false;
-
-    scanlineByteCnt <<= 1;
-    while (pixinByteCounter < scanlineByteCnt) {
-        bool pixinBit = (pixinByte & 0x1);
-        bool colorChanged0 = (pixinBit && !(shifter & 0x8));
-        bool colorChanged1 = (!pixinBit && (shifter & 0x8));
-        unsigned barrelShift = (pixinBitCounter % 4);
-        barrel = shifter >> barrelShift;
-        barrel |= (shifter << (4 - barrelShift));
-        barrel &= 0xf;
-
-        uint8_t selected = (jk0 || jk1) ? latch : barrel;
-        uint8_t pixout = (latch << 4) + 8;
-        *(pixout0++) = pixout;
-        *(pixout1++) = pixout;
-
-        //  next clock
-        jk0 = jk_ff(colorChanged0, shifter & 0x4, jk0);
-        jk1 = jk_ff(colorChanged1, !(shifter & 0x4), jk1);
-        shifter <<= 1;
-        shifter |= (pixinBit ? 0x1 : 0);
-        latch = selected;
-        pixinByte >>= 1;
-        ++pixinBitCounter;
-        if (!(pixinBitCounter % 7)) {
-            ++scanlines[pixinByteCounter % 2];
-            ++pixinByteCounter;
-            pixinByte = *scanlines[pixinByteCounter % 2];
+    unsigned shifter = 0;
+    unsigned latch = 0;
+    unsigned jk = 0;
+    unsigned phase = 0;
+    int byteIdx;
+
+    //  bytes alternate between aux and main memory
+    for (byteIdx = 0; byteIdx < scanlineByteCnt * 2; ++byteIdx) {
+        unsigned pixinByte = scanlines[byteIdx & 1][byteIdx >> 1];
+        unsigned bitIdx;
+        for (bitIdx = 0; bitIdx < 7; ++bitIdx) {
+            unsigned pixinBit = pixinByte & 0x1;
+            unsigned step = s_dhgr_step[phase][shifter][pixinBit];
+            unsigned selected = jk ? latch : (step & 0xf);
+            uint8_t pixout = (uint8_t)((latch << 4) + 8);
+            *(pixout0++) = pixout;
+            *(pixout1++) = pixout;
+
+            //  next clock
+            jk = s_dhgr_jk[(step >> 4) | (jk << 3)];
+            shifter = ((shifter << 1) | pixinBit) & 0x7f;
+            latch = selected;
+            pixinByte >>= 1;
+            phase = (phase + 1) & 3;
         }
     }
 }
@@ -403,8 +430,178 @@ static void _render_double_hires(const ClemensVideo *video, const uint8_t *main,
 
 ////////////////////////////////////////////////////////////////////////////////
 
+//  Lores blocks are written as 4-bit color indices, scaled so that the 40x48
+//  (or 80x48 for double lores) block grid fills the same 560 x 384 area as
+//  the hires modes.  Like the display, double lores takes even columns from
+//  auxiliary memory.
+static void _render_lores_row(uint8_t *pixout, const uint8_t *scanline, unsigned byte_cnt,
+                              unsigned block_width, unsigned phase, unsigned phase_cnt,
+                              unsigned stride) {
+    unsigned x, y, block_x;
+    uint8_t block, color;
+    for (x = 0; x < byte_cnt; ++x) {
+        block = scanline[x];
+        block_x = (x * phase_cnt + phase) * block_width;
+        for (y = 0; y < 16; ++y) {
+            color = (y < 8) ? (block & 0xf) : (block >> 4);
+            memset(pixout + y * stride + block_x, color, block_width);
+        }
+    }
+}
+
+static void _render_lores(const ClemensVideo *video, const uint8_t *main, const uint8_t *aux,
+                          uint8_t *texture, unsigned width, unsigned height, unsigned stride) {
+    unsigned block_width = video->format == kClemensVideoFormat_Double_Lores ? 7 : 14;
+    int i;
+    if (width < 560 || height < (unsigned)video->scanline_count * 16)
+        return;
+    for (i = 0; i < video->scanline_count; ++i) {
+        int row = i + video->scanline_start;
+        uint8_t *pixout = texture + i * 16 * stride;
+        if (video->format == kClemensVideoFormat_Double_Lores) {
+            _render_lores_row(pixout, aux + video->scanlines[row].offset,
+                              video->scanline_byte_cnt, block_width, 0, 2, stride);
+            _render_lores_row(pixout, main + video->scanlines[row].offset,
+                              video->scanline_byte_cnt, block_width, 1, 2, stride);
+        } else {
+            _render_lores_row(pixout, main + video->scanlines[row].offset,
+                              video->scanline_byte_cnt, block_width, 0, 1, stride);
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+//  NTSC and IIgs versions
+//  source from https://www.mrob.com/pub/xapple2/colors.html
+//  RGBA (ABGR in little endian)
+//
+//  Hires uses the IIgs colors rather than those of the original Apple II.
+//
+static const uint8_t s_hgr_colors[8][4] = {
+    {0x00, 0x00, 0x00, 0xFF}, // black group 1
+    {0x11, 0xDD, 0x00, 0xFF}, // green (light green)
+    {0xDD, 0x22, 0xDD, 0xFF}, // purple
+    {0xFF, 0xFF, 0xFF, 0xFF}, // white group 1
+    {0x00, 0x00, 0x00, 0xFF}, // black group 2
+    {0xFF, 0x66, 0x00, 0xFF}, // orange
+    {0x22, 0x22, 0xFF, 0xFF}, // medium blue
+    {0xFF, 0xFF, 0xFF, 0xFF}  // white group 2
+};
+
+static const uint8_t s_dhgr_colors[16][4] = {
+    {0, 0, 0, 255},       // black
+    {221, 0, 51, 255},    // deep red
+    {136, 85, 0, 255},    // brown
+    {255, 102, 0, 255},   // orange
+    {0, 119, 34, 255},    // dark green
+    {85, 85, 85, 255},    // dark gray
+    {17, 221, 0, 255},    // lt. green
+    {255, 255, 0, 255},   // yellow
+    {0, 0, 153, 255},     // dark blue
+    {221, 34, 221, 255},  // purple
+    {170, 170, 170, 255}, // lt. gray
+    {255, 153, 136, 255}, // pink
+    {34, 34, 255, 255},   // med blue
+    {102, 170, 255, 255}, // light blue
+    {68, 255, 153, 255},  // aquamarine
+    {255, 255, 255, 255}  // white
+};
+
+static const uint8_t s_gr_colors[16][4] = {
+    {0, 0, 0, 255},       // black
+    {221, 0, 51, 255},    // deep red
+    {0, 0, 153, 255},     // dark blue
+    {221, 34, 221, 255},  // purple
+    {0, 119, 34, 255},    // dark green
+    {85, 85, 85, 255},    // dark gray
+    {34, 34, 255, 255},   // med blue
+    {102, 170, 255, 255}, // light blue
+    {136, 85, 0, 255},    // brown
+    {255, 102, 0, 255},   // orange
+    {170, 170, 170, 255}, // lt. gray
+    {255, 153, 136, 255}, // pink
+    {17, 221, 0, 255},    // lt. green
+    {255, 255, 0, 255},   // yellow
+    {68, 255, 153, 255},  // aquamarine
+    {255, 255, 255, 255}  // white
+};
+
+const uint8_t *clemens_render_get_palette(enum ClemensVideoFormat format, unsigned *count) {
+    switch (format) {
+    case kClemensVideoFormat_Hires:
+        *count = 8;
+        return &s_hgr_colors[0][0];
+    case kClemensVideoFormat_Double_Hires:
+        *count = 16;
+        return &s_dhgr_colors[0][0];
+    case kClemensVideoFormat_Text:
+    case kClemensVideoFormat_Lores:
+    case kClemensVideoFormat_Double_Lores:
+        *count = 16;
+        return &s_gr_colors[0][0];
+    default:
+        *count = 0;
+        return NULL;
+    }
+}
+
+void clemens_render_indexed_to_rgb(const ClemensVideo *video, const uint8_t *texture,
+                                   unsigned width, unsigned height, unsigned stride, uint8_t *rgb,
+                                   unsigned rgb_stride) {
+    //  mirrors the palette lookups done by the host shaders; see the output
+    //  encodings of the _render_xxx functions above
+    uint8_t lut[256][3];
+    const uint8_t *color;
+    unsigned i, x, y;
+    for (i = 0; i < 256; ++i) {
+        switch (video->format) {
+        case kClemensVideoFormat_Super_Hires:
+            lut[i][0] = (uint8_t)(video->rgba[i] >> 24);
+            lut[i][1] = (uint8_t)((video->rgba[i] >> 16) & 0xff);
+            lut[i][2] = (uint8_t)((video->rgba[i] >> 8) & 0xff);
+            continue;
+        case kClemensVideoFormat_Hires:
+            color = s_hgr_colors[i >> 5];
+            break;
+        case kClemensVideoFormat_Double_Hires:
+            color = s_dhgr_colors[i >> 4];
+            break;
+        default:
+            color = s_gr_colors[i & 0xf];
+            break;
+        }
+        lut[i][0] = color[0];
+        lut[i][1] = color[1];
+        lut[i][2] = color[2];
+    }
+    for (y = 0; y < height; ++y) {
+        const uint8_t *pixin = texture + y * stride;
+        uint8_t *pixout = rgb + y * rgb_stride;
+        for (x = 0; x < width; ++x) {
+            memcpy(pixout, lut[pixin[x]], 3);
+            pixout += 3;
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+//  Only written by clemens_render_init, which runs before any render threads
+//  exist, so the tables are read only while rendering.
+static bool s_render_tables_ready = false;
+
+void clemens_render_init(void) {
+    if (s_render_tables_ready)
+        return;
+    _render_init_hgr_spans();
+    _render_init_dhgr_tables();
+    s_render_tables_ready = true;
+}
+
 void clemens_render_graphics(const ClemensVideo *video, const uint8_t *memory, const uint8_t *aux,
                              uint8_t *texture, unsigned width, unsigned height, unsigned stride) {
+    assert(s_render_tables_ready);
 
     switch (video->format) {
     case kClemensVideoFormat_Super_Hires:
@@ -416,5 +613,11 @@ void clemens_render_graphics(const ClemensVideo *video, const uint8_t *memory, c
     case kClemensVideoFormat_Hires:
         _render_hires(video, memory, texture, width, height, stride);
         break;
+    case kClemensVideoFormat_Lores:
+    case kClemensVideoFormat_Double_Lores:
+        _render_lores(video, memory, aux, texture, width, height, stride);
+        break;
+    default:
+        break;
     }
 }
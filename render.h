@@ -7,12 +7,25 @@
 extern "C" {
 #endif
 
+/**
+ * @brief Builds the lookup tables used by clemens_render_graphics
+ *
+ * Call once at startup before any thread renders.  The tables are only read
+ * afterwards, so rendering is then safe from any number of threads (i.e. the
+ * UI and a capture worker.)
+ */
+void clemens_render_init(void);
+
 /**
  * @brief Renders indexed color into an 8-bit texture
  *
  * Note to support all graphics rendering modes, the output texture should be
  * at least 640 x 400 texels.  Hires and Super hires 320 pixels are scaled 2x2
  * to fill out the texture.  Double hires and 640 mode render pixels at 1x2.
+ * Lores and double lores blocks are written as 14x8 and 7x8 texels.
+ *
+ * Super hires only writes every other row; the host is expected to double
+ * each row.  Texels are palette indices - see clemens_render_indexed_to_rgb.
  *
  * @param video
  * @param memory
@@ -25,6 +38,36 @@ extern "C" {
 void clemens_render_graphics(const ClemensVideo *video, const uint8_t *memory, const uint8_t *aux,
                              uint8_t *texture, unsigned width, unsigned height, unsigned stride);
 
+/**
+ * @brief Returns the RGBA8 palette used for the video format
+ *
+ * Text, lores and double lores share the 16 color lores palette.  Super hires
+ * palettes are per frame and are found in ClemensVideo::rgba.
+ *
+ * @param format
+ * @param count The number of 4 byte entries in the returned palette
+ * @return const uint8_t* NULL if the format has no fixed palette
+ */
+const uint8_t *clemens_render_get_palette(enum ClemensVideoFormat format, unsigned *count);
+
+/**
+ * @brief Converts a texture from clemens_render_graphics into packed RGB8
+ *
+ * This applies the same palette lookups used by the host display so that
+ * software consumers (i.e. capture) match what is drawn on screen.
+ *
+ * @param video The video used to render the indexed texture
+ * @param texture
+ * @param width
+ * @param height
+ * @param stride
+ * @param rgb Output of at least height * rgb_stride bytes
+ * @param rgb_stride
+ */
+void clemens_render_indexed_to_rgb(const ClemensVideo *video, const uint8_t *texture,
+                                   unsigned width, unsigned height, unsigned stride, uint8_t *rgb,
+                                   unsigned rgb_stride);
+
 #ifdef __cplusplus
 }
 #endif
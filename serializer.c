@@ -27,6 +27,8 @@ struct ClemensSerializerRecord kVGC[] = {
     /* scan lines are generated */
     CLEM_SERIALIZER_RECORD_CLOCKS(struct ClemensVGC, ts_last_frame),
     CLEM_SERIALIZER_RECORD_CLOCKS(struct ClemensVGC, ts_scanline_0),
+    CLEM_SERIALIZER_RECORD_CLOCKS(struct ClemensVGC, ts_scanline_dt),
+    CLEM_SERIALIZER_RECORD_CLOCKS(struct ClemensVGC, ts_next_event),
     CLEM_SERIALIZER_RECORD_DURATION(struct ClemensVGC, dt_scanline),
     CLEM_SERIALIZER_RECORD_UINT32(struct ClemensVGC, vbl_counter),
     CLEM_SERIALIZER_RECORD_UINT32(struct ClemensVGC, mode_flags),
@@ -63,6 +65,10 @@ struct ClemensSerializerRecord kADBKeyboard[] = {
     CLEM_SERIALIZER_RECORD_INT32(struct ClemensDeviceKeyboard, repeat_count),
     CLEM_SERIALIZER_RECORD_UINT8(struct ClemensDeviceKeyboard, last_a2_key_down),
     CLEM_SERIALIZER_RECORD_BOOL(struct ClemensDeviceKeyboard, reset_key),
+    CLEM_SERIALIZER_RECORD_ARRAY(struct ClemensDeviceKeyboard, kClemensSerializerTypeUInt8, text,
+                                 CLEM_ADB_TEXT_QUEUE_SIZE, 0),
+    CLEM_SERIALIZER_RECORD_UINT32(struct ClemensDeviceKeyboard, text_head),
+    CLEM_SERIALIZER_RECORD_UINT32(struct ClemensDeviceKeyboard, text_tail),
     CLEM_SERIALIZER_RECORD_EMPTY()};
 
 struct ClemensSerializerRecord kADBMouse[] = {
@@ -70,6 +76,8 @@ struct ClemensSerializerRecord kADBMouse[] = {
                                  CLEM_ADB_KEYB_BUFFER_LIMIT, 0),
     CLEM_SERIALIZER_RECORD_INT32(struct ClemensDeviceMouse, size),
     CLEM_SERIALIZER_RECORD_BOOL(struct ClemensDeviceMouse, btn_down),
+    CLEM_SERIALIZER_RECORD_INT32(struct ClemensDeviceMouse, dx),
+    CLEM_SERIALIZER_RECORD_INT32(struct ClemensDeviceMouse, dy),
     CLEM_SERIALIZER_RECORD_EMPTY()};
 
 struct ClemensSerializerRecord kGameport[] = {
@@ -86,6 +94,8 @@ struct ClemensSerializerRecord kGameport[] = {
     CLEM_SERIALIZER_RECORD_EMPTY()};
 
 struct ClemensSerializerRecord kTimer[] = {
+    CLEM_SERIALIZER_RECORD_UINT64(struct ClemensDeviceTimer, mega2_cycles_1sec),
+    CLEM_SERIALIZER_RECORD_UINT64(struct ClemensDeviceTimer, mega2_cycles_qtrsec),
     CLEM_SERIALIZER_RECORD_UINT32(struct ClemensDeviceTimer, irq_1sec_us),
     CLEM_SERIALIZER_RECORD_UINT32(struct ClemensDeviceTimer, irq_qtrsec_us),
     CLEM_SERIALIZER_RECORD_UINT32(struct ClemensDeviceTimer, flags),
@@ -138,11 +148,48 @@ struct ClemensSerializerRecord kAudio[] = {
     CLEM_SERIALIZER_RECORD_UINT32(struct ClemensDeviceAudio, irq_line),
     CLEM_SERIALIZER_RECORD_EMPTY()};
 
+struct ClemensSerializerRecord kSCCHostQueue[] = {
+    CLEM_SERIALIZER_RECORD_ARRAY(struct ClemensSCCHostQueue, kClemensSerializerTypeUInt8, data,
+                                 CLEM_SCC_HOST_QUEUE_SIZE, 0),
+    CLEM_SERIALIZER_RECORD_UINT32(struct ClemensSCCHostQueue, head),
+    CLEM_SERIALIZER_RECORD_UINT32(struct ClemensSCCHostQueue, tail),
+    CLEM_SERIALIZER_RECORD_EMPTY()};
+
+struct ClemensSerializerRecord kSCCChannel[] = {
+    CLEM_SERIALIZER_RECORD_ARRAY(struct ClemensSCCChannel, kClemensSerializerTypeUInt8, wr, 16, 0),
+    CLEM_SERIALIZER_RECORD_UINT8(struct ClemensSCCChannel, rr0),
+    CLEM_SERIALIZER_RECORD_UINT8(struct ClemensSCCChannel, rr1),
+    CLEM_SERIALIZER_RECORD_UINT8(struct ClemensSCCChannel, ip),
+    CLEM_SERIALIZER_RECORD_UINT8(struct ClemensSCCChannel, tx_buffer),
+    CLEM_SERIALIZER_RECORD_UINT8(struct ClemensSCCChannel, tx_shift),
+    CLEM_SERIALIZER_RECORD_BOOL(struct ClemensSCCChannel, tx_buffer_full),
+    CLEM_SERIALIZER_RECORD_BOOL(struct ClemensSCCChannel, tx_shifting),
+    CLEM_SERIALIZER_RECORD_BOOL(struct ClemensSCCChannel, rx_int_next),
+    CLEM_SERIALIZER_RECORD_BOOL(struct ClemensSCCChannel, rx_receiving),
+    CLEM_SERIALIZER_RECORD_ARRAY(struct ClemensSCCChannel, kClemensSerializerTypeUInt8, rx_fifo,
+                                 CLEM_SCC_RX_FIFO_SIZE, 0),
+    CLEM_SERIALIZER_RECORD_UINT32(struct ClemensSCCChannel, rx_fifo_count),
+    CLEM_SERIALIZER_RECORD_CLOCKS(struct ClemensSCCChannel, ts_tx_done),
+    CLEM_SERIALIZER_RECORD_CLOCKS(struct ClemensSCCChannel, ts_rx_done),
+    CLEM_SERIALIZER_RECORD_CLOCKS(struct ClemensSCCChannel, dt_tx_char),
+    CLEM_SERIALIZER_RECORD_CLOCKS(struct ClemensSCCChannel, dt_rx_char),
+    CLEM_SERIALIZER_RECORD_BOOL(struct ClemensSCCChannel, host_connected),
+    CLEM_SERIALIZER_RECORD_OBJECT(struct ClemensSCCChannel, to_host, struct ClemensSCCHostQueue,
+                                  kSCCHostQueue),
+    CLEM_SERIALIZER_RECORD_OBJECT(struct ClemensSCCChannel, from_host, struct ClemensSCCHostQueue,
+                                  kSCCHostQueue),
+    CLEM_SERIALIZER_RECORD_EMPTY()};
+
 struct ClemensSerializerRecord kSCC[] = {
     CLEM_SERIALIZER_RECORD_CLOCKS(struct ClemensDeviceSCC, ts_last_frame),
-    CLEM_SERIALIZER_RECORD_UINT32(struct ClemensDeviceSCC, state),
+    CLEM_SERIALIZER_RECORD_CLOCKS(struct ClemensDeviceSCC, ts_next_event),
+    CLEM_SERIALIZER_RECORD_DURATION(struct ClemensDeviceSCC, clocks_step_mega2),
     CLEM_SERIALIZER_RECORD_ARRAY(struct ClemensDeviceSCC, kClemensSerializerTypeUInt32,
                                  selected_reg, 2, 0),
+    CLEM_SERIALIZER_RECORD_ARRAY_OBJECTS(struct ClemensDeviceSCC, channel, 2,
+                                         struct ClemensSCCChannel, kSCCChannel),
+    CLEM_SERIALIZER_RECORD_UINT8(struct ClemensDeviceSCC, wr2),
+    CLEM_SERIALIZER_RECORD_UINT8(struct ClemensDeviceSCC, wr9),
     CLEM_SERIALIZER_RECORD_ARRAY(struct ClemensDeviceSCC, kClemensSerializerTypeUInt8, serial, 2,
                                  0),
     CLEM_SERIALIZER_RECORD_UINT32(struct ClemensDeviceSCC, irq_line),
@@ -269,7 +316,8 @@ struct ClemensSerializerRecord kDriveBay[] = {
                                          kDrive),
     CLEM_SERIALIZER_RECORD_ARRAY_OBJECTS(struct ClemensDriveBay, slot6, 2, struct ClemensDrive,
                                          kDrive),
-    CLEM_SERIALIZER_RECORD_ARRAY_OBJECTS(struct ClemensDriveBay, smartport, 1, struct ClemensDrive,
+    CLEM_SERIALIZER_RECORD_ARRAY_OBJECTS(struct ClemensDriveBay, smartport,
+                                         CLEM_SMARTPORT_DRIVE_LIMIT, struct ClemensSmartPortUnit,
                                          kSmartPort),
     CLEM_SERIALIZER_RECORD_EMPTY()};
 
@@ -291,7 +339,7 @@ struct ClemensSerializerRecord kMMIO[] = {
     CLEM_SERIALIZER_RECORD_DURATION(ClemensMMIO, clocks_step_mega2),
     CLEM_SERIALIZER_RECORD_UINT8(ClemensMMIO, speed_c036),
     CLEM_SERIALIZER_RECORD_UINT64(ClemensMMIO, mega2_cycles),
-    CLEM_SERIALIZER_RECORD_UINT32(ClemensMMIO, timer_60hz_us),
+    CLEM_SERIALIZER_RECORD_UINT64(ClemensMMIO, mega2_cycles_60hz),
     CLEM_SERIALIZER_RECORD_INT32(ClemensMMIO, card_expansion_rom_index),
     CLEM_SERIALIZER_RECORD_UINT32(ClemensMMIO, irq_line),
     CLEM_SERIALIZER_RECORD_UINT32(ClemensMMIO, nmi_line),
@@ -813,13 +861,16 @@ mpack_reader_t *clemens_unserialize_machine(mpack_reader_t *reader, ClemensMachi
        special cased to avoid unnecessary serialization
     */
     for (idx = 0; idx < 256; ++idx) {
+        /* unused banks share the empty bank, so a snapshot from a machine with
+           more RAM needs its own storage for the extra banks */
+        bool was_used = machine->mem.fpi_bank_used[idx];
         machine->mem.fpi_bank_used[idx] = mpack_expect_bool(reader);
         if (machine->mem.fpi_bank_used[idx]) {
             if (mpack_expect_u8(reader) != (uint8_t)(idx & 0xff)) {
                 return NULL;
             }
             sz = mpack_expect_bin(reader);
-            if (!machine->mem.fpi_bank_map[idx]) {
+            if (!was_used || !machine->mem.fpi_bank_map[idx]) {
                 machine->mem.fpi_bank_map[idx] = (*alloc_cb)(sz, context);
             }
             mpack_read_bytes(reader, (char *)machine->mem.fpi_bank_map[idx], sz);
@@ -25,6 +25,8 @@ struct ClemensProdosHDD32 {
     /**
      * @brief Callback to read a block of data from the host resident drive
      *
+     * Returns CLEM_SMARTPORT_STATUS_CODE_WAIT if the block is still being
+     * fetched, in which case the call is repeated until it completes.
      */
     uint8_t (*read_block)(void *user_context, unsigned drive_index, unsigned block_index,
                           uint8_t *buffer);
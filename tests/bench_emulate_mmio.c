@@ -0,0 +1,83 @@
+#include "emulator.h"
+#include "emulator_mmio.h"
+
+#include "clem_mmio_defs.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+//  Microbenchmark for the per-instruction MMIO sync path
+//
+//  The CPU is not emulated here.  Instead the machine clock is advanced by a
+//  typical instruction's worth of fast cycles and clemens_emulate_mmio() is
+//  called, which exercises the device sync paths (VGC, IWM, audio, timers)
+//  that run after every emulated instruction.
+//
+//  Usage: bench_emulate_mmio [iterations]
+//
+
+#define BENCH_CYCLES_PER_INSTRUCTION 3
+#define BENCH_BATCH_COUNT            20
+
+static ClemensMachine machine;
+static ClemensMMIO mmio;
+
+static void bench_setup(void) {
+    memset(&machine, 0, sizeof(machine));
+    memset(&mmio, 0, sizeof(mmio));
+    clemens_init(&machine, CLEM_CLOCKS_MEGA2_CYCLE, CLEM_CLOCKS_FAST_CYCLE,
+                 calloc(CLEM_IIGS_ROM3_SIZE, 1), CLEM_IIGS_ROM3_SIZE,
+                 malloc(CLEM_IIGS_BANK_SIZE), malloc(CLEM_IIGS_BANK_SIZE),
+                 malloc(CLEM_IIGS_BANK_SIZE * 16), 16);
+    clem_mmio_init(&mmio, &machine.dev_debug, machine.mem.bank_page_map,
+                   machine.tspec.clocks_step_mega2, calloc(2048 * 7, 1), 16);
+    //  transition the MMIO from its reset state to active
+    mmio.state_type = kClemensMMIOStateType_Reset;
+    clemens_emulate_mmio(&machine, &mmio);
+}
+
+static double bench_run(const char *name, unsigned long iterations) {
+    clock_t t0, t1;
+    double secs, best_secs = 0.0;
+    unsigned long i;
+    unsigned batch;
+
+    //  report the best of several batches to filter out scheduling noise
+    for (batch = 0; batch < BENCH_BATCH_COUNT; ++batch) {
+        t0 = clock();
+        for (i = 0; i < iterations / BENCH_BATCH_COUNT; ++i) {
+            machine.tspec.clocks_spent +=
+                machine.tspec.clocks_step * BENCH_CYCLES_PER_INSTRUCTION;
+            clemens_emulate_mmio(&machine, &mmio);
+        }
+        t1 = clock();
+        secs = (double)(t1 - t0) / CLOCKS_PER_SEC;
+        if (batch == 0 || secs < best_secs) {
+            best_secs = secs;
+        }
+    }
+    printf("%-16s %10lu calls %8.2f ns/call (best of %u)\n", name, iterations,
+           best_secs * 1e9 * BENCH_BATCH_COUNT / iterations, BENCH_BATCH_COUNT);
+    return best_secs;
+}
+
+int main(int argc, char *argv[]) {
+    unsigned long iterations = 20000000;
+    bool mega2_access;
+
+    if (argc > 1) {
+        iterations = strtoul(argv[1], NULL, 10);
+    }
+
+    bench_setup();
+    bench_run("idle", iterations);
+
+    //  spin up the 5.25 drive motor (no disk) so that the IWM runs its LSS
+    clem_mmio_read(&mmio, &machine.tspec, 0xc000 | CLEM_MMIO_REG_IWM_DRIVE_ENABLE, 0,
+                   &mega2_access);
+    bench_run("iwm drive on", iterations);
+
+    return 0;
+}
@@ -0,0 +1,108 @@
+#include "clem_mem.h"
+#include "clem_mmio.h"
+#include "clem_mmio_defs.h"
+#include "emulator.h"
+#include "emulator_mmio.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+//  Microbenchmark for soft switch memory remapping
+//
+//  Soft switches are hit through clem_write/clem_read on bank 00 as the CPU
+//  would, each followed by a RAM access through the remapped page.  This is
+//  the pattern of ProDOS 8 and 128K //e software that copies between main and
+//  auxiliary memory, or runs from the language card with its I/O calls going
+//  through ROM.
+//
+//  Usage: bench_memory_map [iterations]
+//
+
+#define BENCH_BATCH_COUNT 20
+
+static ClemensMachine machine;
+static ClemensMMIO mmio;
+
+static void bench_setup(void) {
+    memset(&machine, 0, sizeof(machine));
+    memset(&mmio, 0, sizeof(mmio));
+    clemens_init(&machine, CLEM_CLOCKS_MEGA2_CYCLE, CLEM_CLOCKS_FAST_CYCLE,
+                 calloc(CLEM_IIGS_ROM3_SIZE, 1), CLEM_IIGS_ROM3_SIZE,
+                 malloc(CLEM_IIGS_BANK_SIZE), malloc(CLEM_IIGS_BANK_SIZE),
+                 malloc(CLEM_IIGS_BANK_SIZE * 4), 4);
+    clem_mmio_init(&mmio, &machine.dev_debug, machine.mem.bank_page_map,
+                   machine.tspec.clocks_step_mega2, calloc(2048 * 7, 1), 4);
+    mmio.state_type = kClemensMMIOStateType_Reset;
+    clemens_emulate_mmio(&machine, &mmio);
+}
+
+//  RAMRD/RAMWRT off and on ($C002-$C005) around an access to auxiliary RAM
+static uint8_t bench_ramrd_ramwrt(unsigned long i) {
+    uint8_t value;
+    clem_write(&machine, 0x00, 0xc003, 0x00, CLEM_MEM_FLAG_DATA);
+    clem_write(&machine, 0x00, 0xc005, 0x00, CLEM_MEM_FLAG_DATA);
+    clem_read(&machine, &value, 0x0800 + (i & 0x3ff), 0x00, CLEM_MEM_FLAG_DATA);
+    clem_write(&machine, value, 0x2000 + (i & 0x3ff), 0x00, CLEM_MEM_FLAG_DATA);
+    clem_write(&machine, 0x00, 0xc002, 0x00, CLEM_MEM_FLAG_DATA);
+    clem_write(&machine, 0x00, 0xc004, 0x00, CLEM_MEM_FLAG_DATA);
+    return value;
+}
+
+//  ALTZP off and on ($C008-$C009) around a zero page access
+static uint8_t bench_altzp(unsigned long i) {
+    uint8_t value;
+    clem_write(&machine, 0x00, 0xc009, 0x00, CLEM_MEM_FLAG_DATA);
+    clem_read(&machine, &value, (uint16_t)(i & 0xff), 0x00, CLEM_MEM_FLAG_DATA);
+    clem_write(&machine, 0x00, 0xc008, 0x00, CLEM_MEM_FLAG_DATA);
+    return value;
+}
+
+//  Every language card switch ($C080-$C08F), each read twice so the write
+//  enable switches take effect, followed by an access to the $D000 bank
+static uint8_t bench_language_card(unsigned long i) {
+    uint8_t value;
+    uint16_t addr = (uint16_t)(0xc080 + (i & 0xf));
+    clem_read(&machine, &value, addr, 0x00, CLEM_MEM_FLAG_DATA);
+    clem_read(&machine, &value, addr, 0x00, CLEM_MEM_FLAG_DATA);
+    clem_read(&machine, &value, 0xd000 + (i & 0x3ff), 0x00, CLEM_MEM_FLAG_DATA);
+    return value;
+}
+
+static void bench_run(const char *name, uint8_t (*op)(unsigned long), unsigned long iterations) {
+    clock_t t0, t1;
+    double secs, best_secs = 0.0;
+    unsigned long i;
+    unsigned batch;
+    uint8_t sum = 0;
+
+    //  report the best of several batches to filter out scheduling noise
+    for (batch = 0; batch < BENCH_BATCH_COUNT; ++batch) {
+        t0 = clock();
+        for (i = 0; i < iterations / BENCH_BATCH_COUNT; ++i) {
+            sum += (*op)(i);
+        }
+        t1 = clock();
+        secs = (double)(t1 - t0) / CLOCKS_PER_SEC;
+        if (batch == 0 || secs < best_secs) {
+            best_secs = secs;
+        }
+    }
+    printf("%-16s %10lu iterations %8.2f ns/iteration (best of %u) [%02x]\n", name, iterations,
+           best_secs * 1e9 * BENCH_BATCH_COUNT / iterations, BENCH_BATCH_COUNT, sum);
+}
+
+int main(int argc, char *argv[]) {
+    unsigned long iterations = 10000000;
+
+    if (argc > 1) {
+        iterations = strtoul(argv[1], NULL, 10);
+    }
+
+    bench_setup();
+    bench_run("ramrd/ramwrt", &bench_ramrd_ramwrt, iterations);
+    bench_run("altzp", &bench_altzp, iterations);
+    bench_run("language card", &bench_language_card, iterations);
+    return 0;
+}
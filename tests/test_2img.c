@@ -0,0 +1,197 @@
+#include "clem_2img.h"
+#include "clem_woz.h"
+#include "unity.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//  Tests the 2IMG nibbilization and de-nibbilization passes
+//
+//  Round trips sector images through clem_2img_nibblize_data and back with
+//  clem_2img_decode_nibblized_data, and decodes WOZ images from the test data
+//  folder (run from the tests directory.)
+//
+
+#define TEST_2IMG_525_SIZE (280 * 512)
+#define TEST_2IMG_35_SIZE  (1600 * 512)
+
+static struct ClemensNibbleDisk nib_disk;
+static struct ClemensWOZDisk woz_disk;
+static uint8_t *nib_bits;
+static uint8_t *source_image;
+static uint8_t *decoded_image;
+
+void setUp(void) {
+    memset(&nib_disk, 0, sizeof(nib_disk));
+    memset(&woz_disk, 0, sizeof(woz_disk));
+    nib_bits = malloc(CLEM_DISK_35_MAX_DATA_SIZE);
+    source_image = malloc(TEST_2IMG_35_SIZE);
+    decoded_image = malloc(TEST_2IMG_35_SIZE);
+    nib_disk.bits_data = nib_bits;
+    nib_disk.bits_data_end = nib_bits + CLEM_DISK_35_MAX_DATA_SIZE;
+}
+
+void tearDown(void) {
+    free(decoded_image);
+    free(source_image);
+    free(nib_bits);
+}
+
+static void fill_random(uint8_t *data, unsigned size, unsigned seed) {
+    unsigned i;
+    srand(seed);
+    for (i = 0; i < size; ++i) {
+        data[i] = (uint8_t)(rand() & 0xff);
+    }
+}
+
+static void round_trip(unsigned disk_type, uint32_t format, unsigned size) {
+    struct Clemens2IMGDisk source, decoded;
+
+    memset(&source, 0, sizeof(source));
+    memset(&decoded, 0, sizeof(decoded));
+    fill_random(source_image, size, size + format);
+    memset(decoded_image, 0, size);
+
+    TEST_ASSERT_TRUE(
+        clem_2img_generate_header(&source, format, source_image, source_image + size, 0));
+    nib_disk.disk_type = disk_type;
+    source.nib = &nib_disk;
+    TEST_ASSERT_TRUE(clem_2img_nibblize_data(&source));
+
+    TEST_ASSERT_TRUE(
+        clem_2img_generate_header(&decoded, format, decoded_image, decoded_image + size, 0));
+    decoded.nib = &nib_disk;
+    TEST_ASSERT_TRUE(clem_2img_decode_nibblized_data(&decoded));
+    TEST_ASSERT_EQUAL_MEMORY(source_image, decoded_image, size);
+}
+
+static bool load_woz(const char *pathname, uint8_t **image_out) {
+    struct ClemensWOZChunkHeader header;
+    const uint8_t *cur;
+    uint8_t *image;
+    long image_size;
+    FILE *fp = fopen(pathname, "rb");
+    if (!fp)
+        return false;
+    fseek(fp, 0, SEEK_END);
+    image_size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    image = malloc(image_size);
+    fread(image, 1, image_size, fp);
+    fclose(fp);
+
+    woz_disk.nib = &nib_disk;
+    cur = clem_woz_check_header(image, image_size);
+    while (cur && (cur = clem_woz_parse_chunk_header(&header, cur,
+                                                     image + image_size - cur)) != NULL) {
+        switch (header.type) {
+        case CLEM_WOZ_CHUNK_INFO:
+            cur = clem_woz_parse_info_chunk(&woz_disk, &header, cur, header.data_size);
+            break;
+        case CLEM_WOZ_CHUNK_TMAP:
+            cur = clem_woz_parse_tmap_chunk(&woz_disk, &header, cur, header.data_size);
+            break;
+        case CLEM_WOZ_CHUNK_TRKS:
+            cur = clem_woz_parse_trks_chunk(&woz_disk, &header, cur, header.data_size);
+            break;
+        default:
+            cur += header.data_size;
+            break;
+        }
+    }
+    *image_out = image;
+    return true;
+}
+
+void test_clem_2img_round_trip_525_prodos(void) {
+    round_trip(CLEM_DISK_TYPE_5_25, CLEM_2IMG_FORMAT_PRODOS, TEST_2IMG_525_SIZE);
+}
+
+void test_clem_2img_round_trip_525_dos(void) {
+    round_trip(CLEM_DISK_TYPE_5_25, CLEM_2IMG_FORMAT_DOS, TEST_2IMG_525_SIZE);
+}
+
+void test_clem_2img_round_trip_35_prodos(void) {
+    round_trip(CLEM_DISK_TYPE_3_5, CLEM_2IMG_FORMAT_PRODOS, TEST_2IMG_35_SIZE);
+}
+
+void test_clem_2img_decode_damaged_track(void) {
+    struct Clemens2IMGDisk source, decoded;
+    unsigned i;
+
+    memset(&source, 0, sizeof(source));
+    memset(&decoded, 0, sizeof(decoded));
+    memset(source_image, 0, TEST_2IMG_525_SIZE);
+    clem_2img_generate_header(&source, CLEM_2IMG_FORMAT_DOS, source_image,
+                              source_image + TEST_2IMG_525_SIZE, 0);
+    nib_disk.disk_type = CLEM_DISK_TYPE_5_25;
+    source.nib = &nib_disk;
+    TEST_ASSERT_TRUE(clem_2img_nibblize_data(&source));
+
+    //  flip bits in the middle of a sector on track 0 so that its data field
+    //  fails the checksum (or is no longer found)
+    for (i = 0; i < 16; ++i) {
+        nib_disk.bits_data[nib_disk.track_byte_offset[0] + 300 + i] ^= 0x24;
+    }
+    clem_2img_generate_header(&decoded, CLEM_2IMG_FORMAT_DOS, decoded_image,
+                              decoded_image + TEST_2IMG_525_SIZE, 0);
+    decoded.nib = &nib_disk;
+    TEST_ASSERT_FALSE(clem_2img_decode_nibblized_data(&decoded));
+}
+
+void test_clem_2img_decode_woz_dos33(void) {
+    struct Clemens2IMGDisk decoded;
+    uint8_t *image = NULL;
+    uint8_t *vtoc;
+
+    TEST_ASSERT_TRUE(load_woz("data/dos_3_3_master.woz", &image));
+    memset(&decoded, 0, sizeof(decoded));
+    clem_2img_generate_header(&decoded, CLEM_2IMG_FORMAT_DOS, decoded_image,
+                              decoded_image + TEST_2IMG_525_SIZE, 0);
+    decoded.nib = &nib_disk;
+    TEST_ASSERT_TRUE(clem_2img_decode_nibblized_data(&decoded));
+
+    //  VTOC at track 17, sector 0 points to the catalog on track 17
+    vtoc = decoded_image + 17 * 16 * 256;
+    TEST_ASSERT_EQUAL_UINT8(17, vtoc[1]);
+    TEST_ASSERT_EQUAL_UINT8(3, vtoc[3]);
+    TEST_ASSERT_EQUAL_UINT8(35, vtoc[0x34]);
+    TEST_ASSERT_EQUAL_UINT8(16, vtoc[0x35]);
+    free(image);
+}
+
+void test_clem_2img_decode_woz_prodos_35(void) {
+    struct Clemens2IMGDisk decoded;
+    uint8_t *image = NULL;
+    uint8_t *volume_dir;
+    unsigned size;
+
+    TEST_ASSERT_TRUE(load_woz("data/a2gs_system_disk_1_1.woz", &image));
+    size = (nib_disk.is_double_sided ? 1600 : 800) * 512;
+    memset(&decoded, 0, sizeof(decoded));
+    clem_2img_generate_header(&decoded, CLEM_2IMG_FORMAT_PRODOS, decoded_image,
+                              decoded_image + size, 0);
+    decoded.nib = &nib_disk;
+    TEST_ASSERT_TRUE(clem_2img_decode_nibblized_data(&decoded));
+
+    //  the volume directory key block has no previous block and a volume
+    //  directory header storage type
+    volume_dir = decoded_image + 2 * 512;
+    TEST_ASSERT_EQUAL_UINT8(0, volume_dir[0]);
+    TEST_ASSERT_EQUAL_UINT8(0, volume_dir[1]);
+    TEST_ASSERT_EQUAL_HEX8(0xf0, volume_dir[4] & 0xf0);
+    free(image);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_clem_2img_round_trip_525_prodos);
+    RUN_TEST(test_clem_2img_round_trip_525_dos);
+    RUN_TEST(test_clem_2img_round_trip_35_prodos);
+    RUN_TEST(test_clem_2img_decode_damaged_track);
+    RUN_TEST(test_clem_2img_decode_woz_dos33);
+    RUN_TEST(test_clem_2img_decode_woz_prodos_35);
+    return UNITY_END();
+}
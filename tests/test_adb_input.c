@@ -0,0 +1,241 @@
+#include "emulator.h"
+#include "emulator_mmio.h"
+#include "unity.h"
+
+#include "clem_mmio.h"
+#include "clem_mmio_defs.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//  Checks that host input too fast for the ADB queues still reaches the guest
+//  intact: text typed through clemens_input_text and mouse motion coalesced
+//  between GLU polls.
+//
+//  The CPU is not emulated.  The machine clock is advanced directly and the
+//  guest's polling loops are modeled with MMIO reads.
+//
+
+#define TEST_ADB_CLOCKS_PER_STEP (CLEM_CLOCKS_MEGA2_CYCLE * 16)
+#define TEST_ADB_TEXT_SIZE       (50 * 1024)
+/* $C027 bit set while a mouse report waits in $C024 */
+#define TEST_ADB_MOUSE_FULL 0x80
+/* Y byte bit clear while the button is down */
+#define TEST_ADB_MOUSE_BTN_UP 0x80
+
+static ClemensMachine machine;
+static ClemensMMIO mmio;
+
+struct TestMouseReport {
+    int dx;
+    int dy;
+    bool btn_down;
+};
+
+void setUp(void) {
+    memset(&machine, 0, sizeof(machine));
+    memset(&mmio, 0, sizeof(mmio));
+    clemens_init(&machine, CLEM_CLOCKS_MEGA2_CYCLE, CLEM_CLOCKS_FAST_CYCLE,
+                 calloc(CLEM_IIGS_ROM3_SIZE, 1), CLEM_IIGS_ROM3_SIZE,
+                 calloc(CLEM_IIGS_BANK_SIZE, 1), calloc(CLEM_IIGS_BANK_SIZE, 1),
+                 calloc(CLEM_IIGS_BANK_SIZE * 16, 1), 16);
+    clem_mmio_init(&mmio, &machine.dev_debug, machine.mem.bank_page_map,
+                   machine.tspec.clocks_step_mega2, calloc(2048 * 7, 1), 16);
+    mmio.state_type = kClemensMMIOStateType_Reset;
+    clemens_emulate_mmio(&machine, &mmio);
+}
+
+void tearDown(void) {}
+
+static void step_machine(void) {
+    machine.tspec.clocks_spent += TEST_ADB_CLOCKS_PER_STEP;
+    clemens_emulate_mmio(&machine, &mmio);
+}
+
+static uint8_t read_io(uint8_t ioreg) {
+    bool mega2_access;
+    return clem_mmio_read(&mmio, &machine.tspec, 0xc000 | ioreg, 0, &mega2_access);
+}
+
+//  A BASIC listing with a Return after every line
+static char *make_listing(unsigned size) {
+    char *text = malloc(size + 1);
+    unsigned length = 0;
+    unsigned line_number = 10;
+    char line[64];
+    while (length < size) {
+        int line_length = snprintf(line, sizeof(line), "%u PRINT \"LINE %u\";: GOTO %u\r",
+                                   line_number, line_number, line_number + 10);
+        if (length + line_length > size)
+            line_length = size - length;
+        memcpy(text + length, line, line_length);
+        length += line_length;
+        line_number += 10;
+    }
+    text[size] = '\0';
+    return text;
+}
+
+//  The host offers the untyped remainder every step, and the guest polls
+//  $C000 every poll_steps steps, clearing the strobe once it has a key.
+//  Returns the number of steps taken.
+static unsigned type_text(const char *text, char *typed, unsigned size, unsigned poll_steps) {
+    unsigned sent = 0;
+    unsigned received = 0;
+    unsigned step = 0;
+    while (received < size && step < size * poll_steps * 4) {
+        if (sent < size) {
+            sent += clemens_input_text(&mmio, (const uint8_t *)text + sent, size - sent);
+        }
+        step_machine();
+        ++step;
+        if ((step % poll_steps) == 0) {
+            uint8_t key = read_io(CLEM_MMIO_REG_KEYB_READ);
+            if (key & 0x80) {
+                typed[received++] = (char)(key & 0x7f);
+                read_io(CLEM_MMIO_REG_ANYKEY_STROBE);
+            }
+        }
+    }
+    typed[received] = '\0';
+    return step;
+}
+
+void test_adb_input_text_paste(void) {
+    char *text = make_listing(TEST_ADB_TEXT_SIZE);
+    char *typed = calloc(TEST_ADB_TEXT_SIZE + 1, 1);
+    unsigned steps = type_text(text, typed, TEST_ADB_TEXT_SIZE, 2);
+    TEST_ASSERT_EQUAL_STRING(text, typed);
+    //  paced by the guest, not by the 60 Hz keyboard poll
+    TEST_ASSERT_LESS_THAN_UINT(TEST_ADB_TEXT_SIZE * 4, steps);
+    free(typed);
+    free(text);
+}
+
+void test_adb_input_text_slow_guest(void) {
+    //  a guest that polls less than once a frame still sees every character
+    char *text = make_listing(2048);
+    char *typed = calloc(2048 + 1, 1);
+    type_text(text, typed, 2048, 1500);
+    TEST_ASSERT_EQUAL_STRING(text, typed);
+    free(typed);
+    free(text);
+}
+
+void test_adb_input_text_waits_for_poll(void) {
+    //  clearing the strobe alone does not consume typed text
+    unsigned i;
+    uint8_t key;
+    TEST_ASSERT_EQUAL_UINT(3, clemens_input_text(&mmio, (const uint8_t *)"RUN", 3));
+    for (i = 0; i < 4096; ++i) {
+        step_machine();
+        read_io(CLEM_MMIO_REG_ANYKEY_STROBE);
+    }
+    key = read_io(CLEM_MMIO_REG_KEYB_READ);
+    TEST_ASSERT_EQUAL_HEX8(0x80 | 'R', key);
+    read_io(CLEM_MMIO_REG_ANYKEY_STROBE);
+    clemens_input_text_clear(&mmio);
+    key = read_io(CLEM_MMIO_REG_KEYB_READ);
+    TEST_ASSERT_EQUAL_HEX8(0, key & 0x80);
+}
+
+static int decode_delta(uint8_t value) {
+    int delta = value & 0x7f;
+    return (delta & 0x40) ? delta - 0x80 : delta;
+}
+
+//  Runs the machine for a number of frames, reading a mouse report every
+//  frame_stride frames.  Returns the number of reports.
+static unsigned read_mouse(struct TestMouseReport *reports, unsigned limit, unsigned frames,
+                           unsigned frame_stride) {
+    unsigned frame, step;
+    unsigned count = 0;
+    unsigned steps_per_frame = CLEM_MEGA2_CYCLES_PER_60TH * CLEM_CLOCKS_MEGA2_CYCLE /
+                               TEST_ADB_CLOCKS_PER_STEP;
+    for (frame = 0; frame < frames; ++frame) {
+        for (step = 0; step < steps_per_frame; ++step) {
+            step_machine();
+        }
+        if ((frame % frame_stride) != 0)
+            continue;
+        if (read_io(CLEM_MMIO_REG_ADB_STATUS) & TEST_ADB_MOUSE_FULL) {
+            uint8_t x = read_io(CLEM_MMIO_REG_ADB_MOUSE_DATA);
+            uint8_t y = read_io(CLEM_MMIO_REG_ADB_MOUSE_DATA);
+            TEST_ASSERT_LESS_THAN_UINT(limit, count);
+            reports[count].dx = decode_delta(x);
+            reports[count].dy = decode_delta(y);
+            reports[count].btn_down = !(y & TEST_ADB_MOUSE_BTN_UP);
+            ++count;
+        }
+    }
+    return count;
+}
+
+static void send_mouse(enum ClemensInputType type, int dx, int dy) {
+    struct ClemensInputEvent input;
+    memset(&input, 0, sizeof(input));
+    input.type = type;
+    input.value_a = (int16_t)dx;
+    input.value_b = (int16_t)dy;
+    clemens_input(&mmio, &input);
+}
+
+void test_adb_input_mouse_coalesced(void) {
+    struct TestMouseReport reports[256];
+    unsigned count, i;
+    int dx = 0, dy = 0;
+    //  far more moves in a frame than the ADB queue holds
+    for (i = 0; i < 1000; ++i) {
+        send_mouse(kClemensInputType_MouseMove, 1, -2);
+    }
+    //  a guest reading every third frame loses nothing either
+    count = read_mouse(reports, 256, 200, 3);
+    for (i = 0; i < count; ++i) {
+        TEST_ASSERT_LESS_OR_EQUAL_INT(63, abs(reports[i].dx));
+        TEST_ASSERT_LESS_OR_EQUAL_INT(63, abs(reports[i].dy));
+        dx += reports[i].dx;
+        dy += reports[i].dy;
+    }
+    TEST_ASSERT_EQUAL_INT(1000, dx);
+    TEST_ASSERT_EQUAL_INT(-2000, dy);
+}
+
+void test_adb_input_mouse_button_order(void) {
+    struct TestMouseReport reports[64];
+    unsigned count, i, first;
+    send_mouse(kClemensInputType_MouseMove, 10, 0);
+    send_mouse(kClemensInputType_MouseButtonDown, 0, 0);
+    send_mouse(kClemensInputType_MouseMove, 5, 3);
+    send_mouse(kClemensInputType_MouseButtonUp, 0, 0);
+    count = read_mouse(reports, 64, 30, 1);
+    //  skip idle reports made before the input arrived
+    for (first = 0; first < count; ++first) {
+        if (reports[first].dx != 0)
+            break;
+    }
+    TEST_ASSERT_LESS_OR_EQUAL_UINT(count - 4, first);
+    TEST_ASSERT_EQUAL_INT(10, reports[first].dx);
+    TEST_ASSERT_FALSE(reports[first].btn_down);
+    TEST_ASSERT_EQUAL_INT(0, reports[first + 1].dx);
+    TEST_ASSERT_TRUE(reports[first + 1].btn_down);
+    TEST_ASSERT_EQUAL_INT(5, reports[first + 2].dx);
+    TEST_ASSERT_EQUAL_INT(3, reports[first + 2].dy);
+    TEST_ASSERT_TRUE(reports[first + 2].btn_down);
+    TEST_ASSERT_EQUAL_INT(0, reports[first + 3].dx);
+    TEST_ASSERT_FALSE(reports[first + 3].btn_down);
+    for (i = first + 4; i < count; ++i) {
+        TEST_ASSERT_EQUAL_INT(0, reports[i].dx);
+        TEST_ASSERT_EQUAL_INT(0, reports[i].dy);
+    }
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_adb_input_text_paste);
+    RUN_TEST(test_adb_input_text_slow_guest);
+    RUN_TEST(test_adb_input_text_waits_for_poll);
+    RUN_TEST(test_adb_input_mouse_coalesced);
+    RUN_TEST(test_adb_input_mouse_button_order);
+    return UNITY_END();
+}
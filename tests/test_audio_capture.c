@@ -0,0 +1,162 @@
+#include "emulator.h"
+#include "emulator_mmio.h"
+#include "unity.h"
+
+#include "clem_mmio.h"
+#include "clem_mmio_defs.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+//  Checks that the audio capture sink sees the same sample stream regardless
+//  of how often the host consumes the mix buffer.
+//
+//  The CPU is not emulated.  The machine clock is advanced directly and the
+//  speaker is toggled through $C030 to generate a square wave.
+//
+
+#define TEST_AUDIO_FRAMES_PER_SECOND 48000
+#define TEST_AUDIO_FRAME_STRIDE      8
+#define TEST_AUDIO_SECONDS           3
+#define TEST_AUDIO_CLOCKS_PER_STEP   (CLEM_CLOCKS_MEGA2_CYCLE * 16)
+#define TEST_AUDIO_STEPS_PER_TOGGLE  32
+
+static ClemensMachine machine;
+static ClemensMMIO mmio;
+static uint8_t *mix_data;
+
+struct TestAudioSink {
+    struct ClemensAudioCapture capture;
+    uint64_t hash;
+    unsigned call_count;
+    unsigned nonzero_count;
+};
+
+static void test_capture_callback(void *user_ptr, const uint8_t *data, unsigned frame_count,
+                                  unsigned frame_stride, unsigned frames_per_second) {
+    struct TestAudioSink *sink = (struct TestAudioSink *)user_ptr;
+    unsigned i, j;
+    TEST_ASSERT_EQUAL_UINT(TEST_AUDIO_FRAME_STRIDE, frame_stride);
+    TEST_ASSERT_EQUAL_UINT(TEST_AUDIO_FRAMES_PER_SECOND, frames_per_second);
+    for (i = 0; i < frame_count; ++i) {
+        const uint8_t *frame = data + i * frame_stride;
+        const float *samples = (const float *)frame;
+        if (samples[0] != 0.0f || samples[1] != 0.0f) {
+            ++sink->nonzero_count;
+        }
+        //  FNV-1a
+        for (j = 0; j < frame_stride; ++j) {
+            sink->hash = (sink->hash ^ frame[j]) * 0x100000001b3ULL;
+        }
+    }
+    ++sink->call_count;
+}
+
+void setUp(void) {
+    struct ClemensAudioMixBuffer mix_buffer;
+    bool mega2_access;
+    memset(&machine, 0, sizeof(machine));
+    memset(&mmio, 0, sizeof(mmio));
+    clemens_init(&machine, CLEM_CLOCKS_MEGA2_CYCLE, CLEM_CLOCKS_FAST_CYCLE,
+                 calloc(CLEM_IIGS_ROM3_SIZE, 1), CLEM_IIGS_ROM3_SIZE,
+                 calloc(CLEM_IIGS_BANK_SIZE, 1), calloc(CLEM_IIGS_BANK_SIZE, 1),
+                 calloc(CLEM_IIGS_BANK_SIZE * 16, 1), 16);
+    clem_mmio_init(&mmio, &machine.dev_debug, machine.mem.bank_page_map,
+                   machine.tspec.clocks_step_mega2, calloc(2048 * 7, 1), 16);
+    mmio.state_type = kClemensMMIOStateType_Reset;
+    clemens_emulate_mmio(&machine, &mmio);
+
+    mix_buffer.frames_per_second = TEST_AUDIO_FRAMES_PER_SECOND;
+    mix_buffer.stride = TEST_AUDIO_FRAME_STRIDE;
+    mix_buffer.frame_count = TEST_AUDIO_FRAMES_PER_SECOND / 4;
+    mix_data = calloc(mix_buffer.frame_count, mix_buffer.stride);
+    mix_buffer.data = mix_data;
+    clemens_assign_audio_mix_buffer(&mmio, &mix_buffer);
+
+    //  sound GLU control - volume is bits 0-2
+    clem_mmio_write(&mmio, &machine.tspec, 0x07,
+                    0xc000 | CLEM_MMIO_REG_AUDIO_CTL, 0, &mega2_access);
+}
+
+void tearDown(void) {
+    clemens_audio_capture(&mmio, NULL);
+    free(mix_data);
+}
+
+//  Runs the machine for TEST_AUDIO_SECONDS, consuming the mix buffer every
+//  consume_steps steps.
+static void run_capture(struct TestAudioSink *sink, unsigned consume_steps) {
+    uint64_t clocks_total =
+        (uint64_t)CLEM_CLOCKS_MEGA2_CYCLE * CLEM_MEGA2_CYCLES_PER_SECOND * TEST_AUDIO_SECONDS;
+    uint64_t clocks_spent = 0;
+    unsigned step = 0;
+    ClemensAudio audio;
+    bool mega2_access;
+
+    memset(sink, 0, sizeof(*sink));
+    sink->capture.callback = &test_capture_callback;
+    sink->capture.user_ptr = sink;
+    sink->hash = 0xcbf29ce484222325ULL;
+    clemens_audio_capture(&mmio, &sink->capture);
+
+    while (clocks_spent < clocks_total) {
+        machine.tspec.clocks_spent += TEST_AUDIO_CLOCKS_PER_STEP;
+        clocks_spent += TEST_AUDIO_CLOCKS_PER_STEP;
+        clemens_emulate_mmio(&machine, &mmio);
+        ++step;
+        if ((step % TEST_AUDIO_STEPS_PER_TOGGLE) == 0) {
+            clem_mmio_read(&mmio, &machine.tspec, 0xc000 | CLEM_MMIO_REG_SPKR, 0,
+                           &mega2_access);
+        }
+        if ((step % consume_steps) == 0) {
+            clemens_get_audio(&audio, &mmio);
+            clemens_audio_next_frame(&mmio, audio.frame_count);
+        }
+    }
+    clemens_get_audio(&audio, &mmio);
+    clemens_audio_next_frame(&mmio, audio.frame_count);
+    clemens_audio_capture(&mmio, NULL);
+}
+
+void test_audio_capture_frame_count(void) {
+    struct TestAudioSink sink;
+    uint64_t expected = (uint64_t)TEST_AUDIO_FRAMES_PER_SECOND * TEST_AUDIO_SECONDS;
+    run_capture(&sink, 1024);
+    TEST_ASSERT_UINT64_WITHIN(TEST_AUDIO_FRAMES_PER_SECOND / 100, expected,
+                              sink.capture.frame_total);
+    TEST_ASSERT_GREATER_THAN_UINT(0, sink.nonzero_count);
+    TEST_ASSERT_GREATER_THAN_UINT(1, sink.call_count);
+}
+
+void test_audio_capture_cadence_independent(void) {
+    struct TestAudioSink sink_fast, sink_slow;
+    run_capture(&sink_fast, 97);
+    //  reset the machine so that both runs start from the same state
+    tearDown();
+    setUp();
+    run_capture(&sink_slow, 4001);
+    TEST_ASSERT_GREATER_THAN_UINT(sink_slow.call_count, sink_fast.call_count);
+    TEST_ASSERT_EQUAL_UINT64(sink_fast.capture.frame_total, sink_slow.capture.frame_total);
+    TEST_ASSERT_EQUAL_HEX64(sink_fast.hash, sink_slow.hash);
+}
+
+void test_audio_capture_detached(void) {
+    struct TestAudioSink sink;
+    ClemensAudio audio;
+    run_capture(&sink, 1024);
+    //  detached sinks see nothing further
+    sink.call_count = 0;
+    machine.tspec.clocks_spent += CLEM_CLOCKS_MEGA2_CYCLE * 10000;
+    clemens_emulate_mmio(&machine, &mmio);
+    clemens_get_audio(&audio, &mmio);
+    clemens_audio_next_frame(&mmio, audio.frame_count);
+    TEST_ASSERT_EQUAL_UINT(0, sink.call_count);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_audio_capture_frame_count);
+    RUN_TEST(test_audio_capture_cadence_independent);
+    RUN_TEST(test_audio_capture_detached);
+    return UNITY_END();
+}
@@ -0,0 +1,149 @@
+#include "emulator.h"
+#include "emulator_mmio.h"
+#include "unity.h"
+
+#include "clem_mem.h"
+#include "clem_mmio_defs.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//  Checks that the page maps selected by soft switches match the maps built
+//  from scratch for the same switch setting.
+//
+//  Soft switch flips reuse page map sets built for earlier settings, and new
+//  sets are built by remapping a copy of the set in use.  A random mix of
+//  switch accesses (enough settings to cycle through every set many times) is
+//  run, and after each access banks 00, 01, E0 and E1 are compared against a
+//  second machine restored from the same switch setting.
+//
+//  Switches are accessed through bank E0, which keeps its I/O page when the
+//  shadow register turns off I/O in bank 00.
+//
+
+#define TEST_MEMORY_MAP_STEPS 20000
+
+static ClemensMachine machine;
+static ClemensMMIO mmio;
+static ClemensMachine ref_machine;
+static ClemensMMIO ref_mmio;
+
+static void machine_setup(ClemensMachine *clem, ClemensMMIO *clem_mmio) {
+    memset(clem, 0, sizeof(*clem));
+    memset(clem_mmio, 0, sizeof(*clem_mmio));
+    clemens_init(clem, CLEM_CLOCKS_MEGA2_CYCLE, CLEM_CLOCKS_FAST_CYCLE,
+                 calloc(CLEM_IIGS_ROM3_SIZE, 1), CLEM_IIGS_ROM3_SIZE,
+                 calloc(CLEM_IIGS_BANK_SIZE, 1), calloc(CLEM_IIGS_BANK_SIZE, 1),
+                 calloc(CLEM_IIGS_BANK_SIZE * 4, 1), 4);
+    clem_mmio_init(clem_mmio, &clem->dev_debug, clem->mem.bank_page_map,
+                   clem->tspec.clocks_step_mega2, calloc(2048 * 7, 1), 4);
+    clem_mmio->state_type = kClemensMMIOStateType_Reset;
+    clemens_emulate_mmio(clem, clem_mmio);
+}
+
+void setUp(void) {
+    machine_setup(&machine, &mmio);
+    machine_setup(&ref_machine, &ref_mmio);
+}
+
+void tearDown(void) {}
+
+static void switch_write(uint16_t addr, uint8_t data) {
+    clem_write(&machine, data, addr, 0xe0, CLEM_MEM_FLAG_DATA);
+}
+
+static void switch_read(uint16_t addr) {
+    uint8_t data;
+    clem_read(&machine, &data, addr, 0xe0, CLEM_MEM_FLAG_DATA);
+}
+
+static void check_against_restored_maps(unsigned step) {
+    static const uint8_t banks[4] = {0x00, 0x01, 0xe0, 0xe1};
+    struct ClemensMemoryPageMap *page_map, *ref_page_map;
+    char message[64];
+    unsigned idx;
+
+    ref_mmio.mmap_register = mmio.mmap_register;
+    clem_mmio_restore(&ref_mmio);
+    for (idx = 0; idx < 4; ++idx) {
+        page_map = machine.mem.bank_page_map[banks[idx]];
+        ref_page_map = ref_machine.mem.bank_page_map[banks[idx]];
+        if (memcmp(page_map->pages, ref_page_map->pages, sizeof(page_map->pages)) != 0) {
+            snprintf(message, sizeof(message), "step %u, bank %02X, switches %08X", step,
+                     banks[idx], mmio.mmap_register);
+            TEST_FAIL_MESSAGE(message);
+        }
+        TEST_ASSERT_EQUAL(ref_page_map->shadow_map != NULL, page_map->shadow_map != NULL);
+        if (page_map->shadow_map) {
+            TEST_ASSERT_EQUAL_MEMORY(ref_page_map->shadow_map->pages, page_map->shadow_map->pages,
+                                     sizeof(page_map->shadow_map->pages));
+        }
+    }
+}
+
+void test_memory_map_matches_restored_maps(void) {
+    uint32_t seed = 0x2545f491;
+    unsigned step;
+    uint8_t data;
+
+    for (step = 0; step < TEST_MEMORY_MAP_STEPS; ++step) {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        data = (uint8_t)(seed >> 8);
+        switch (seed % 8) {
+        case 0:
+            //  80STORE, RAMRD, RAMWRT off/on
+            switch_write(0xc000 + (data & 0x5), 0x00);
+            break;
+        case 1:
+            //  CXROM, ALTZP, C3ROM off/on
+            switch_write(0xc006 + (data & 0x5), 0x00);
+            break;
+        case 2:
+            //  PAGE2, HIRES
+            switch_read(0xc054 + (data & 0x3));
+            break;
+        case 3:
+        case 4:
+            //  language card, with the double read that write enables RAM
+            switch_read(0xc080 + (data & 0xf));
+            if (data & 0x80) {
+                switch_read(0xc080 + (data & 0xf));
+            }
+            break;
+        case 5:
+            switch_write(0xc035, data);
+            break;
+        case 6:
+            //  the PAGE2 bit is not implemented in the state register
+            switch_write(0xc068, data & ~0x40);
+            break;
+        case 7:
+            switch_write(0xc02d, data);
+            break;
+        }
+        check_against_restored_maps(step);
+    }
+}
+
+void test_memory_map_reuses_page_map_set(void) {
+    struct ClemensMemoryPageMap *main_page_map;
+
+    switch_write(0xc002, 0x00);
+    main_page_map = machine.mem.bank_page_map[0x00];
+    switch_write(0xc003, 0x00);
+    TEST_ASSERT_TRUE(main_page_map != machine.mem.bank_page_map[0x00]);
+    TEST_ASSERT_EQUAL_HEX8(0x01, machine.mem.bank_page_map[0x00]->pages[0x08].bank_read);
+    switch_write(0xc002, 0x00);
+    TEST_ASSERT_EQUAL_PTR(main_page_map, machine.mem.bank_page_map[0x00]);
+    TEST_ASSERT_EQUAL_HEX8(0x00, machine.mem.bank_page_map[0x00]->pages[0x08].bank_read);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_memory_map_matches_restored_maps);
+    RUN_TEST(test_memory_map_reuses_page_map_set);
+    return UNITY_END();
+}
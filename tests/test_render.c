@@ -0,0 +1,268 @@
+#include "render.h"
+#include "unity.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+//  Compares the table driven hires and double hires renderers against the
+//  original bit serial implementations (reproduced below) for every pair of
+//  bytes repeated across a scanline, and for random scanlines.
+//
+
+#define TEST_RENDER_WIDTH  640
+#define TEST_RENDER_HEIGHT 400
+
+static struct ClemensScanline scanlines[2];
+static uint8_t main_mem[256];
+static uint8_t aux_mem[256];
+static uint8_t texture[TEST_RENDER_WIDTH * TEST_RENDER_HEIGHT];
+static uint8_t expected[2][TEST_RENDER_WIDTH];
+
+void setUp(void) {
+    memset(main_mem, 0, sizeof(main_mem));
+    memset(aux_mem, 0, sizeof(aux_mem));
+    memset(texture, 0, sizeof(texture));
+    memset(expected, 0, sizeof(expected));
+}
+
+void tearDown(void) {}
+
+static uint8_t abgrFromHGRBitTable[4][2] = {
+    {0, 4}, /* black */
+    {2, 6}, /* even */
+    {1, 5}, /* odd */
+    {3, 7}  /* white */
+};
+
+static unsigned stateToColorAction[8] = {
+    /* b000 */ 0, //  > 2 adjacent off = black
+    /* b001 */ 0, //  2 adjacent off outgoing  = black
+    /* b010 */ 1, //  color at bit 1
+    /* b011 */ 3, //  2 adjacent on incoming = white
+    /* b100 */ 0, //  2 adhacent off incoming = black
+    /* b101 */ 2, //  color at bit 2
+    /* b110 */ 3, //  2 adjacent on outgoing = white
+    /* b111 */ 3, //  > 2 adjacent on = white
+};
+
+static void ref_hgr(uint8_t *pixout, uint8_t *pixout2, const uint8_t *hgr) {
+    unsigned state = 0;
+    int xpos = -2;
+    unsigned group;
+    uint8_t pixel;
+    for (int byteIdx = 0; byteIdx < 40; ++byteIdx) {
+        uint8_t byte = hgr[byteIdx];
+        group = byte >> 7;
+        unsigned pxmask = 0x1;
+        while (pxmask != 0x80) {
+            unsigned bit = byte & pxmask;
+            state <<= 1;
+            pxmask <<= 1;
+            if (bit)
+                state |= 1;
+
+            unsigned action = stateToColorAction[state & 0x7];
+            unsigned color;
+            if (xpos >= 0) {
+                if (action == 0)
+                    color = 0;
+                else if (action == 1) {
+                    if (xpos & 2)
+                        color = 2;
+                    else
+                        color = 1;
+                } else if (action == 2) {
+                    if (xpos & 2)
+                        color = 1;
+                    else
+                        color = 2;
+                } else {
+                    color = 3;
+                }
+                //  normalize hcolor 0 to 7 to 0-255 to be shader friendly
+                pixel = (abgrFromHGRBitTable[color][group & 1] << 5) + 16;
+                pixout[xpos] = pixel;
+                pixout[xpos + 1] = pixel;
+                pixout2[xpos] = pixel;
+                pixout2[xpos + 1] = pixel;
+            }
+            xpos += 2;
+        }
+    }
+    state <<= 1;
+    unsigned action = stateToColorAction[state & 0x7];
+    unsigned color;
+    if (action == 0)
+        color = 0;
+    else if (action == 1) {
+        color = 2;
+    } else if (action == 2) {
+        color = 1;
+    } else {
+        color = 3;
+    }
+    pixel = (abgrFromHGRBitTable[color][group & 1] << 5) + 16;
+    pixout[xpos] = pixel;
+    pixout[xpos + 1] = pixel;
+    pixout2[xpos] = pixel;
+    pixout2[xpos + 1] = pixel;
+}
+
+static inline bool jk_ff(bool j, bool k, bool q) {
+    if (!j && !k)
+        return q;
+    if (!j && k)
+        return 0;
+    if (j && !k)
+        return 1;
+    return !q;
+}
+
+static void ref_dhgr(uint8_t *pixout0, uint8_t *pixout1, const uint8_t *scanlines[2],
+                     int scanlineByteCnt) {
+    int pixinByteCounter = 0;
+    int pixinBitCounter = 0;
+    uint8_t pixinByte = *scanlines[0];
+    uint8_t shifter = 0;
+    uint8_t barrel = 0;
+    uint8_t latch = 0;
+    bool jk0 = false;
+    bool jk1 = false;
+
+    scanlineByteCnt <<= 1;
+    while (pixinByteCounter < scanlineByteCnt) {
+        bool pixinBit = (pixinByte & 0x1);
+        bool colorChanged0 = (pixinBit && !(shifter & 0x8));
+        bool colorChanged1 = (!pixinBit && (shifter & 0x8));
+        unsigned barrelShift = (pixinBitCounter % 4);
+        barrel = shifter >> barrelShift;
+        barrel |= (shifter << (4 - barrelShift));
+        barrel &= 0xf;
+
+        uint8_t selected = (jk0 || jk1) ? latch : barrel;
+        uint8_t pixout = (latch << 4) + 8;
+        *(pixout0++) = pixout;
+        *(pixout1++) = pixout;
+
+        //  next clock
+        jk0 = jk_ff(colorChanged0, shifter & 0x4, jk0);
+        jk1 = jk_ff(colorChanged1, !(shifter & 0x4), jk1);
+        shifter <<= 1;
+        shifter |= (pixinBit ? 0x1 : 0);
+        latch = selected;
+        pixinByte >>= 1;
+        ++pixinBitCounter;
+        if (!(pixinBitCounter % 7)) {
+            ++scanlines[pixinByteCounter % 2];
+            ++pixinByteCounter;
+            pixinByte = *scanlines[pixinByteCounter % 2];
+        }
+    }
+}
+
+static void render_line(enum ClemensVideoFormat format) {
+    ClemensVideo video;
+    memset(&video, 0, sizeof(video));
+    scanlines[0].offset = 0;
+    video.scanlines = scanlines;
+    video.scanline_byte_cnt = 40;
+    video.scanline_start = 0;
+    video.scanline_count = 1;
+    video.scanline_limit = 1;
+    video.format = format;
+    clemens_render_graphics(&video, main_mem, aux_mem, texture, TEST_RENDER_WIDTH,
+                            TEST_RENDER_HEIGHT, TEST_RENDER_WIDTH);
+}
+
+static void check_hgr(void) {
+    ref_hgr(expected[0], expected[1], main_mem);
+    render_line(kClemensVideoFormat_Hires);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected[0], texture, 560);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected[1], texture + TEST_RENDER_WIDTH, 560);
+}
+
+static void check_dhgr(void) {
+    const uint8_t *sources[2] = {aux_mem, main_mem};
+    ref_dhgr(expected[0], expected[1], sources, 40);
+    render_line(kClemensVideoFormat_Double_Hires);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected[0], texture, 560);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected[1], texture + TEST_RENDER_WIDTH, 560);
+}
+
+void test_render_hgr_byte_pairs(void) {
+    unsigned a, b, i;
+    for (a = 0; a < 256; ++a) {
+        for (b = 0; b < 256; ++b) {
+            for (i = 0; i < 40; i += 2) {
+                main_mem[i] = (uint8_t)a;
+                main_mem[i + 1] = (uint8_t)b;
+            }
+            check_hgr();
+        }
+    }
+}
+
+void test_render_dhgr_byte_pairs(void) {
+    unsigned a, b;
+    for (a = 0; a < 256; ++a) {
+        for (b = 0; b < 256; ++b) {
+            memset(aux_mem, (int)a, 40);
+            memset(main_mem, (int)b, 40);
+            check_dhgr();
+        }
+    }
+}
+
+void test_render_random_lines(void) {
+    unsigned line, i;
+    srand(0x2c0de);
+    for (line = 0; line < 4096; ++line) {
+        for (i = 0; i < 40; ++i) {
+            main_mem[i] = (uint8_t)(rand() & 0xff);
+            aux_mem[i] = (uint8_t)(rand() & 0xff);
+        }
+        check_hgr();
+        check_dhgr();
+    }
+}
+
+void test_render_double_lores_rgb(void) {
+    //  even blocks come from aux memory, odd from main; top nibble is the lower
+    //  block.  Converted colors come from the lores palette.
+    static uint8_t rgb[TEST_RENDER_WIDTH * 3];
+    const uint8_t *palette;
+    unsigned count, x;
+    aux_mem[0] = 0x21;
+    main_mem[0] = 0x43;
+    render_line(kClemensVideoFormat_Double_Lores);
+    TEST_ASSERT_EQUAL_UINT8(0x1, texture[0]);
+    TEST_ASSERT_EQUAL_UINT8(0x1, texture[6]);
+    TEST_ASSERT_EQUAL_UINT8(0x3, texture[7]);
+    TEST_ASSERT_EQUAL_UINT8(0x2, texture[8 * TEST_RENDER_WIDTH]);
+    TEST_ASSERT_EQUAL_UINT8(0x4, texture[15 * TEST_RENDER_WIDTH + 13]);
+
+    palette = clemens_render_get_palette(kClemensVideoFormat_Double_Lores, &count);
+    TEST_ASSERT_EQUAL_UINT(16, count);
+    {
+        ClemensVideo video;
+        memset(&video, 0, sizeof(video));
+        video.format = kClemensVideoFormat_Double_Lores;
+        clemens_render_indexed_to_rgb(&video, texture, 14, 1, TEST_RENDER_WIDTH, rgb,
+                                      TEST_RENDER_WIDTH * 3);
+    }
+    for (x = 0; x < 14; ++x) {
+        const uint8_t *color = palette + (x < 7 ? 0x1 : 0x3) * 4;
+        TEST_ASSERT_EQUAL_UINT8_ARRAY(color, rgb + x * 3, 3);
+    }
+}
+
+int main(void) {
+    clemens_render_init();
+    UNITY_BEGIN();
+    RUN_TEST(test_render_hgr_byte_pairs);
+    RUN_TEST(test_render_dhgr_byte_pairs);
+    RUN_TEST(test_render_random_lines);
+    RUN_TEST(test_render_double_lores_rgb);
+    return UNITY_END();
+}
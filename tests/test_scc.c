@@ -0,0 +1,247 @@
+#include "emulator.h"
+#include "unity.h"
+
+#include "clem_device.h"
+#include "clem_mmio_defs.h"
+
+#include <string.h>
+
+//  This test checks the SCC device only (not the CPU side)
+//
+//  Channels are programmed through the command/data switches as the firmware
+//  would, the device is synced in single mega2 cycle steps, and the times at
+//  which characters complete are compared with the configured baud rate.
+//
+
+static struct ClemensDeviceSCC scc_device;
+static clem_clocks_time_t emulator_ref_ts;
+
+//  9600 baud from the 3.6864 Mhz RTxC crystal, x16 clock, 8N1 = 10 bits
+#define TEST_SCC_BAUD_9600_TC 10
+#define TEST_SCC_CHAR_NS      (1000000000ULL * 10 / 9600)
+#define TEST_SCC_TOLERANCE_NS (2 * CLEM_MEGA2_CYCLE_NS)
+
+static void scc_sync(unsigned mega2_cycles) {
+    struct ClemensClock clock;
+    clock.ref_step = CLEM_CLOCKS_MEGA2_CYCLE;
+    while (mega2_cycles--) {
+        emulator_ref_ts += CLEM_CLOCKS_MEGA2_CYCLE;
+        clock.ts = emulator_ref_ts;
+        clem_scc_glu_sync(&scc_device, &clock);
+    }
+}
+
+static uint64_t scc_elapsed_ns(clem_clocks_time_t ts_start) {
+    //  CLEM_MEGA2_CYCLE_NS is rounded, so convert from the exact clock rate
+    return (emulator_ref_ts - ts_start) * 1000000000ULL /
+           ((uint64_t)CLEM_CLOCKS_MEGA2_CYCLE * CLEM_MEGA2_CYCLES_PER_SECOND);
+}
+
+static void scc_write_reg(unsigned channel, unsigned reg, uint8_t value) {
+    uint8_t cmd_reg =
+        channel == CLEM_SCC_CHANNEL_A ? CLEM_MMIO_REG_SCC_A_CMD : CLEM_MMIO_REG_SCC_B_CMD;
+    if (reg > 0) {
+        clem_scc_write_switch(&scc_device, cmd_reg,
+                              (reg & 0x7) | (reg >= 8 ? CLEM_SCC_WR0_CMD_POINT_HIGH : 0));
+    }
+    clem_scc_write_switch(&scc_device, cmd_reg, value);
+}
+
+static uint8_t scc_read_reg(unsigned channel, unsigned reg) {
+    uint8_t cmd_reg =
+        channel == CLEM_SCC_CHANNEL_A ? CLEM_MMIO_REG_SCC_A_CMD : CLEM_MMIO_REG_SCC_B_CMD;
+    if (reg > 0) {
+        clem_scc_write_switch(&scc_device, cmd_reg,
+                              (reg & 0x7) | (reg >= 8 ? CLEM_SCC_WR0_CMD_POINT_HIGH : 0));
+    }
+    return clem_scc_read_switch(&scc_device, cmd_reg, 0);
+}
+
+static uint8_t scc_read_data(unsigned channel) {
+    return clem_scc_read_switch(&scc_device,
+                                channel == CLEM_SCC_CHANNEL_A ? CLEM_MMIO_REG_SCC_A_DATA
+                                                              : CLEM_MMIO_REG_SCC_B_DATA,
+                                0);
+}
+
+static void scc_write_data(unsigned channel, uint8_t value) {
+    clem_scc_write_switch(&scc_device,
+                          channel == CLEM_SCC_CHANNEL_A ? CLEM_MMIO_REG_SCC_A_DATA
+                                                        : CLEM_MMIO_REG_SCC_B_DATA,
+                          value);
+}
+
+static void scc_setup_9600_8n1(unsigned channel, uint8_t wr14) {
+    scc_write_reg(channel, 4, 0x44);  // x16 clock, 1 stop bit, no parity
+    scc_write_reg(channel, 3, 0xc0);  // 8 bits, receiver off
+    scc_write_reg(channel, 5, 0x62);  // 8 bits, RTS, transmitter off
+    scc_write_reg(channel, 11, 0x50); // RX and TX clocks from the BRG
+    scc_write_reg(channel, 12, TEST_SCC_BAUD_9600_TC);
+    scc_write_reg(channel, 13, 0x00);
+    scc_write_reg(channel, 14, wr14 | CLEM_SCC_WR14_BRG_ENABLE);
+    scc_write_reg(channel, 3, 0xc0 | CLEM_SCC_WR3_RX_ENABLE);
+    scc_write_reg(channel, 5, 0x62 | CLEM_SCC_WR5_TX_ENABLE);
+}
+
+//  Syncs until the RR0 bit is set, returning the elapsed time
+static uint64_t scc_wait_rr0(unsigned channel, uint8_t mask, unsigned mega2_limit) {
+    clem_clocks_time_t ts_start = emulator_ref_ts;
+    while (!(scc_read_reg(channel, 0) & mask) && mega2_limit--) {
+        scc_sync(1);
+    }
+    return scc_elapsed_ns(ts_start);
+}
+
+void setUp(void) {
+    emulator_ref_ts = 0;
+    memset(&scc_device, 0, sizeof(scc_device));
+    clem_scc_reset(&scc_device, CLEM_CLOCKS_MEGA2_CYCLE);
+    scc_sync(1);
+}
+
+void tearDown(void) {}
+
+void test_scc_reset(void) {
+    uint8_t rr0 = scc_read_reg(CLEM_SCC_CHANNEL_A, 0);
+    TEST_ASSERT_BITS_HIGH(CLEM_SCC_RR0_TX_EMPTY, rr0);
+    TEST_ASSERT_BITS_LOW(CLEM_SCC_RR0_RX_AVAIL | CLEM_SCC_RR0_DCD | CLEM_SCC_RR0_CTS, rr0);
+    TEST_ASSERT_BITS_HIGH(CLEM_SCC_RR1_ALL_SENT, scc_read_reg(CLEM_SCC_CHANNEL_B, 1));
+    TEST_ASSERT_EQUAL_UINT32(0, scc_device.irq_line);
+    TEST_ASSERT_EQUAL_UINT64(CLEM_TIME_UNINITIALIZED, scc_device.ts_next_event);
+
+    //  register pointer resets after each access
+    scc_write_reg(CLEM_SCC_CHANNEL_A, 12, 0x5a);
+    TEST_ASSERT_EQUAL_HEX8(0x5a, scc_read_reg(CLEM_SCC_CHANNEL_A, 12));
+    TEST_ASSERT_BITS_HIGH(CLEM_SCC_RR0_TX_EMPTY, scc_read_reg(CLEM_SCC_CHANNEL_A, 0));
+}
+
+void test_scc_loopback_timing(void) {
+    uint64_t elapsed_ns;
+    scc_setup_9600_8n1(CLEM_SCC_CHANNEL_A, CLEM_SCC_WR14_LOCAL_LOOPBACK);
+    scc_write_data(CLEM_SCC_CHANNEL_A, 0xa5);
+    //  the buffer moves into the idle shifter at once
+    TEST_ASSERT_BITS_HIGH(CLEM_SCC_RR0_TX_EMPTY, scc_read_reg(CLEM_SCC_CHANNEL_A, 0));
+    TEST_ASSERT_BITS_LOW(CLEM_SCC_RR1_ALL_SENT, scc_read_reg(CLEM_SCC_CHANNEL_A, 1));
+    elapsed_ns = scc_wait_rr0(CLEM_SCC_CHANNEL_A, CLEM_SCC_RR0_RX_AVAIL, 10000);
+    TEST_ASSERT_UINT64_WITHIN(TEST_SCC_TOLERANCE_NS, TEST_SCC_CHAR_NS, elapsed_ns);
+    TEST_ASSERT_BITS_HIGH(CLEM_SCC_RR1_ALL_SENT, scc_read_reg(CLEM_SCC_CHANNEL_A, 1));
+    TEST_ASSERT_EQUAL_HEX8(0xa5, scc_read_data(CLEM_SCC_CHANNEL_A));
+    TEST_ASSERT_BITS_LOW(CLEM_SCC_RR0_RX_AVAIL, scc_read_reg(CLEM_SCC_CHANNEL_A, 0));
+    //  nothing went to the host
+    TEST_ASSERT_EQUAL_UINT(0, clem_scc_host_drain(&scc_device, CLEM_SCC_CHANNEL_A, NULL, 0));
+    TEST_ASSERT_EQUAL_UINT64(CLEM_TIME_UNINITIALIZED, scc_device.ts_next_event);
+}
+
+void test_scc_transmit_to_host(void) {
+    uint8_t out[8];
+    unsigned count;
+    scc_setup_9600_8n1(CLEM_SCC_CHANNEL_B, 0);
+    scc_write_data(CLEM_SCC_CHANNEL_B, 'O');
+    scc_write_data(CLEM_SCC_CHANNEL_B, 'K');
+    //  one byte is in the shifter and the other waits in the buffer
+    TEST_ASSERT_BITS_LOW(CLEM_SCC_RR0_TX_EMPTY, scc_read_reg(CLEM_SCC_CHANNEL_B, 0));
+    scc_sync((unsigned)(TEST_SCC_CHAR_NS / CLEM_MEGA2_CYCLE_NS) - 2);
+    TEST_ASSERT_EQUAL_UINT(0, clem_scc_host_drain(&scc_device, CLEM_SCC_CHANNEL_B, out, 8));
+    scc_sync(4);
+    TEST_ASSERT_BITS_HIGH(CLEM_SCC_RR0_TX_EMPTY, scc_read_reg(CLEM_SCC_CHANNEL_B, 0));
+    count = clem_scc_host_drain(&scc_device, CLEM_SCC_CHANNEL_B, out, 8);
+    TEST_ASSERT_EQUAL_UINT(1, count);
+    TEST_ASSERT_EQUAL_HEX8('O', out[0]);
+    //  the second character follows the first without a gap
+    scc_sync((unsigned)(TEST_SCC_CHAR_NS / CLEM_MEGA2_CYCLE_NS));
+    count = clem_scc_host_drain(&scc_device, CLEM_SCC_CHANNEL_B, out, 8);
+    TEST_ASSERT_EQUAL_UINT(1, count);
+    TEST_ASSERT_EQUAL_HEX8('K', out[0]);
+    TEST_ASSERT_EQUAL_UINT64(CLEM_TIME_UNINITIALIZED, scc_device.ts_next_event);
+}
+
+void test_scc_receive_from_host(void) {
+    static const uint8_t message[] = "HELLO";
+    clem_clocks_time_t ts_start;
+    uint64_t elapsed_ns;
+    unsigned i;
+    scc_setup_9600_8n1(CLEM_SCC_CHANNEL_A, 0);
+    TEST_ASSERT_EQUAL_UINT(5, clem_scc_host_feed(&scc_device, CLEM_SCC_CHANNEL_A, message, 5));
+    ts_start = emulator_ref_ts;
+    for (i = 0; i < 5; ++i) {
+        scc_wait_rr0(CLEM_SCC_CHANNEL_A, CLEM_SCC_RR0_RX_AVAIL, 10000);
+        elapsed_ns = scc_elapsed_ns(ts_start);
+        TEST_ASSERT_UINT64_WITHIN(TEST_SCC_TOLERANCE_NS, TEST_SCC_CHAR_NS * (i + 1), elapsed_ns);
+        TEST_ASSERT_EQUAL_HEX8(message[i], scc_read_data(CLEM_SCC_CHANNEL_A));
+    }
+    TEST_ASSERT_BITS_LOW(CLEM_SCC_RR1_RX_OVERRUN, scc_read_reg(CLEM_SCC_CHANNEL_A, 1));
+    TEST_ASSERT_EQUAL_UINT64(CLEM_TIME_UNINITIALIZED, scc_device.ts_next_event);
+}
+
+void test_scc_receive_overrun(void) {
+    static const uint8_t message[] = "ABCDE";
+    scc_setup_9600_8n1(CLEM_SCC_CHANNEL_A, 0);
+    clem_scc_host_feed(&scc_device, CLEM_SCC_CHANNEL_A, message, 5);
+    scc_sync((unsigned)(TEST_SCC_CHAR_NS * 6 / CLEM_MEGA2_CYCLE_NS));
+    TEST_ASSERT_BITS_HIGH(CLEM_SCC_RR1_RX_OVERRUN, scc_read_reg(CLEM_SCC_CHANNEL_A, 1));
+    TEST_ASSERT_EQUAL_HEX8('A', scc_read_data(CLEM_SCC_CHANNEL_A));
+    TEST_ASSERT_EQUAL_HEX8('B', scc_read_data(CLEM_SCC_CHANNEL_A));
+    TEST_ASSERT_EQUAL_HEX8('E', scc_read_data(CLEM_SCC_CHANNEL_A));
+    scc_write_reg(CLEM_SCC_CHANNEL_A, 0, CLEM_SCC_WR0_CMD_RESET_ERROR);
+    TEST_ASSERT_BITS_LOW(CLEM_SCC_RR1_RX_OVERRUN, scc_read_reg(CLEM_SCC_CHANNEL_A, 1));
+}
+
+void test_scc_interrupts(void) {
+    static const uint8_t message[] = "Z";
+    scc_setup_9600_8n1(CLEM_SCC_CHANNEL_B, 0);
+    scc_write_reg(CLEM_SCC_CHANNEL_B, 1, CLEM_SCC_WR1_RX_IE_ALL | CLEM_SCC_WR1_TX_IE);
+    scc_write_reg(CLEM_SCC_CHANNEL_B, 9, CLEM_SCC_WR9_MIE);
+    TEST_ASSERT_EQUAL_UINT32(0, scc_device.irq_line);
+
+    clem_scc_host_feed(&scc_device, CLEM_SCC_CHANNEL_B, message, 1);
+    scc_wait_rr0(CLEM_SCC_CHANNEL_B, CLEM_SCC_RR0_RX_AVAIL, 10000);
+    TEST_ASSERT_EQUAL_UINT32(CLEM_IRQ_SCC, scc_device.irq_line);
+    TEST_ASSERT_EQUAL_HEX8(CLEM_SCC_RR3_B_RX_IP, scc_read_reg(CLEM_SCC_CHANNEL_A, 3));
+    //  status low modified vector for channel B receive
+    TEST_ASSERT_EQUAL_HEX8(0x02 << 1, scc_read_reg(CLEM_SCC_CHANNEL_B, 2));
+    TEST_ASSERT_EQUAL_HEX8('Z', scc_read_data(CLEM_SCC_CHANNEL_B));
+    TEST_ASSERT_EQUAL_UINT32(0, scc_device.irq_line);
+
+    //  TX interrupt once the buffer empties into the shifter
+    scc_write_data(CLEM_SCC_CHANNEL_B, 'Y');
+    TEST_ASSERT_EQUAL_UINT32(CLEM_IRQ_SCC, scc_device.irq_line);
+    TEST_ASSERT_EQUAL_HEX8(CLEM_SCC_RR3_B_TX_IP, scc_read_reg(CLEM_SCC_CHANNEL_A, 3));
+    scc_write_reg(CLEM_SCC_CHANNEL_B, 0, CLEM_SCC_WR0_CMD_RESET_TX_IP);
+    TEST_ASSERT_EQUAL_UINT32(0, scc_device.irq_line);
+
+    //  external status on connect
+    scc_write_reg(CLEM_SCC_CHANNEL_B, 15, CLEM_SCC_WR15_DCD_IE);
+    scc_write_reg(CLEM_SCC_CHANNEL_B, 1, CLEM_SCC_WR1_EXT_IE);
+    clem_scc_host_connect(&scc_device, CLEM_SCC_CHANNEL_B, true);
+    TEST_ASSERT_EQUAL_UINT32(CLEM_IRQ_SCC, scc_device.irq_line);
+    TEST_ASSERT_BITS_HIGH(CLEM_SCC_RR0_DCD | CLEM_SCC_RR0_CTS,
+                          scc_read_reg(CLEM_SCC_CHANNEL_B, 0));
+    scc_write_reg(CLEM_SCC_CHANNEL_B, 0, CLEM_SCC_WR0_CMD_RESET_EXT);
+    TEST_ASSERT_EQUAL_UINT32(0, scc_device.irq_line);
+}
+
+void test_scc_idle_sync(void) {
+    //  an idle device never schedules work
+    scc_setup_9600_8n1(CLEM_SCC_CHANNEL_A, 0);
+    scc_setup_9600_8n1(CLEM_SCC_CHANNEL_B, 0);
+    scc_sync(100000);
+    TEST_ASSERT_EQUAL_UINT64(CLEM_TIME_UNINITIALIZED, scc_device.ts_next_event);
+    //  a disabled transmitter holds the byte
+    scc_write_reg(CLEM_SCC_CHANNEL_A, 5, 0x62);
+    scc_write_data(CLEM_SCC_CHANNEL_A, 0x11);
+    scc_sync(10000);
+    TEST_ASSERT_BITS_LOW(CLEM_SCC_RR0_TX_EMPTY, scc_read_reg(CLEM_SCC_CHANNEL_A, 0));
+    TEST_ASSERT_EQUAL_UINT64(CLEM_TIME_UNINITIALIZED, scc_device.ts_next_event);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_scc_reset);
+    RUN_TEST(test_scc_loopback_timing);
+    RUN_TEST(test_scc_transmit_to_host);
+    RUN_TEST(test_scc_receive_from_host);
+    RUN_TEST(test_scc_receive_overrun);
+    RUN_TEST(test_scc_interrupts);
+    RUN_TEST(test_scc_idle_sync);
+    return UNITY_END();
+}
@@ -0,0 +1,359 @@
+#include "unity.h"
+
+#include "clem_device.h"
+#include "clem_mmio_defs.h"
+#include "clem_smartport.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+//  Drives the SmartPort bus as the host's firmware would, with bus phases and
+//  bit cells written and read through the IWM flags.  Two units share the bus
+//  to check ID assignment and that only the addressed unit executes a command.
+//
+
+#define TEST_UNIT_COUNT 2
+#define TEST_BLOCK_SIZE 512
+#define TEST_DELTA_NS   500
+
+/* PH0 + PH2 */
+#define TEST_PHASE_BUS_RESET 0x5
+/* PH1 + PH3 */
+#define TEST_PHASE_BUS_ENABLE 0xa
+/* PH0 is REQ */
+#define TEST_PHASE_REQ 0x1
+
+//  a host packet's header, contents and checksum framing take this many bytes
+#define TEST_HOST_PACKET_LIMIT 64
+//  pulses to wait for a unit to answer before giving up
+#define TEST_ACK_PULSE_LIMIT 64
+#define TEST_RESPONSE_LIMIT  CLEM_SMARTPORT_DATA_BUFFER_LIMIT
+
+struct TestDrive {
+    unsigned reset_count;
+    unsigned read_count;
+    unsigned last_block_index;
+};
+
+static struct ClemensSmartPortUnit units[TEST_UNIT_COUNT];
+static struct TestDrive drives[TEST_UNIT_COUNT];
+static unsigned host_write_level;
+//  which units were busy once the response was ready
+static bool units_active_at_response[TEST_UNIT_COUNT];
+
+static uint8_t test_block_byte(unsigned block_index, unsigned offset) {
+    return (uint8_t)(offset * 7 + block_index);
+}
+
+static uint8_t test_drive_reset(struct ClemensSmartPortDevice *device, unsigned delta_ns) {
+    struct TestDrive *drive = (struct TestDrive *)device->device_data;
+    (void)delta_ns;
+    drive->reset_count++;
+    return CLEM_SMARTPORT_STATUS_CODE_OK;
+}
+
+static uint8_t test_drive_read_block(struct ClemensSmartPortDevice *device,
+                                     struct ClemensSmartPortPacket *packet, unsigned block_index,
+                                     unsigned delta_ns) {
+    struct TestDrive *drive = (struct TestDrive *)device->device_data;
+    unsigned offset;
+    (void)delta_ns;
+    drive->read_count++;
+    drive->last_block_index = block_index;
+    for (offset = 0; offset < TEST_BLOCK_SIZE; ++offset) {
+        packet->contents[offset] = test_block_byte(block_index, offset);
+    }
+    packet->contents_length = TEST_BLOCK_SIZE;
+    return CLEM_SMARTPORT_STATUS_CODE_OK;
+}
+
+static unsigned bus_cycle(unsigned phase, unsigned io_flags) {
+    clem_smartport_bus(units, TEST_UNIT_COUNT, &io_flags, &phase, TEST_DELTA_NS);
+    return io_flags;
+}
+
+static bool is_ack_hi(unsigned io_flags) {
+    return (io_flags & CLEM_IWM_FLAG_WRPROTECT_SENSE) != 0;
+}
+
+//  A bit cell is 8 pulses, with a 1 written as a change in the write signal
+static void host_write_byte(uint8_t value) {
+    unsigned bit, pulse, io_flags;
+    for (bit = 0; bit < 8; ++bit) {
+        if (value & (0x80 >> bit)) {
+            host_write_level ^= 1;
+        }
+        io_flags = CLEM_IWM_FLAG_WRITE_REQUEST;
+        if (host_write_level) {
+            io_flags |= CLEM_IWM_FLAG_WRITE_DATA;
+        }
+        for (pulse = 0; pulse < 8; ++pulse) {
+            bus_cycle(TEST_PHASE_BUS_ENABLE | TEST_PHASE_REQ, io_flags);
+        }
+    }
+}
+
+static uint8_t host_encode_byte(uint8_t value, uint8_t *checksum) {
+    value |= 0x80;
+    *checksum ^= value;
+    return value;
+}
+
+//  Builds a command packet as the firmware does, with the contents' MSBs
+//  gathered into a leading byte for the odd bytes and for each group of 7
+static unsigned host_build_command(uint8_t *out, uint8_t dest_unit_id, const uint8_t *contents,
+                                   unsigned contents_length) {
+    unsigned out_size = 0;
+    unsigned odd_count = contents_length % 7;
+    unsigned group_count = contents_length / 7;
+    unsigned index, group;
+    uint8_t checksum = 0;
+    uint8_t msbs;
+
+    out[out_size++] = 0xff;
+    out[out_size++] = 0xff;
+    out[out_size++] = 0xc3;
+    out[out_size++] = host_encode_byte(dest_unit_id, &checksum);
+    out[out_size++] = host_encode_byte(0x00, &checksum);
+    out[out_size++] = host_encode_byte(0x00, &checksum);
+    out[out_size++] = host_encode_byte(0x00, &checksum);
+    out[out_size++] = host_encode_byte(0x00, &checksum);
+    out[out_size++] = host_encode_byte((uint8_t)odd_count, &checksum);
+    out[out_size++] = host_encode_byte((uint8_t)group_count, &checksum);
+    if (odd_count > 0) {
+        msbs = 0;
+        for (index = 0; index < odd_count; ++index) {
+            if (contents[index] & 0x80)
+                msbs |= 1 << (6 - index);
+        }
+        out[out_size++] = 0x80 | msbs;
+        for (index = 0; index < odd_count; ++index) {
+            out[out_size++] = 0x80 | contents[index];
+            checksum ^= contents[index];
+        }
+    }
+    for (group = 0; group < group_count; ++group) {
+        const uint8_t *group_contents = contents + odd_count + group * 7;
+        msbs = 0;
+        for (index = 0; index < 7; ++index) {
+            if (group_contents[index] & 0x80)
+                msbs |= 1 << (6 - index);
+        }
+        out[out_size++] = 0x80 | msbs;
+        for (index = 0; index < 7; ++index) {
+            out[out_size++] = 0x80 | group_contents[index];
+            checksum ^= group_contents[index];
+        }
+    }
+    out[out_size++] = 0xaa | (checksum & 0x55);
+    out[out_size++] = 0xaa | ((checksum & 0xaa) >> 1);
+    out[out_size++] = 0xc8;
+    return out_size;
+}
+
+//  Sends a command, waits for the unit to execute it and reads back the
+//  response's raw bytes.  Returns the response size, or 0 if the unit didn't
+//  respond.
+static unsigned host_transaction(uint8_t dest_unit_id, const uint8_t *contents,
+                                 unsigned contents_length, uint8_t *response) {
+    uint8_t packet[TEST_HOST_PACKET_LIMIT];
+    unsigned packet_size = host_build_command(packet, dest_unit_id, contents, contents_length);
+    unsigned index, io_flags, pulse;
+    unsigned bit_count = 0;
+
+    //  enabling the bus readies the residents for a packet
+    bus_cycle(TEST_PHASE_BUS_ENABLE, 0);
+    host_write_level = 0;
+    for (index = 0; index < packet_size; ++index) {
+        host_write_byte(packet[index]);
+    }
+    //  REQ drops once the packet is sent, and ACK rises when the response is
+    //  ready
+    for (pulse = 0; pulse < TEST_ACK_PULSE_LIMIT; ++pulse) {
+        if (is_ack_hi(bus_cycle(TEST_PHASE_BUS_ENABLE, 0)))
+            break;
+    }
+    if (pulse == TEST_ACK_PULSE_LIMIT)
+        return 0;
+    for (index = 0; index < TEST_UNIT_COUNT; ++index) {
+        units_active_at_response[index] = clem_smartport_unit_is_active(&units[index]);
+    }
+    //  the response is read with REQ high until the unit drops ACK
+    memset(response, 0, TEST_RESPONSE_LIMIT);
+    for (;;) {
+        io_flags = bus_cycle(TEST_PHASE_BUS_ENABLE | TEST_PHASE_REQ, 0);
+        if (!is_ack_hi(io_flags))
+            break;
+        if (!(io_flags & CLEM_IWM_FLAG_PULSE_HIGH))
+            continue;
+        if (bit_count >= TEST_RESPONSE_LIMIT * 8)
+            return 0;
+        if (io_flags & CLEM_IWM_FLAG_READ_DATA) {
+            response[bit_count / 8] |= 0x80 >> (bit_count % 8);
+        }
+        ++bit_count;
+    }
+    bus_cycle(TEST_PHASE_BUS_ENABLE, 0);
+    //  and the bus is disabled between commands
+    bus_cycle(0, 0);
+    return bit_count / 8;
+}
+
+struct TestResponse {
+    uint8_t source_unit_id;
+    uint8_t type;
+    uint8_t status;
+    unsigned contents_length;
+    uint8_t contents[CLEM_SMARTPORT_CONTENTS_LIMIT];
+};
+
+//  Decodes a response, returning false if its framing or checksum is bad
+static bool host_decode_response(const uint8_t *data, unsigned size, struct TestResponse *out) {
+    unsigned index = 0;
+    unsigned odd_count, group_count, byte_index, group;
+    uint8_t checksum = 0;
+    uint8_t msbs;
+    const uint8_t *header;
+
+    while (index < size && data[index] != 0xc3) {
+        ++index;
+    }
+    if (index + 8 > size)
+        return false;
+    header = &data[index + 1];
+    for (byte_index = 0; byte_index < 7; ++byte_index) {
+        checksum ^= header[byte_index];
+    }
+    out->source_unit_id = header[1] & 0x7f;
+    out->type = header[2] & 0x7f;
+    out->status = header[4] & 0x7f;
+    odd_count = header[5] & 0x7f;
+    group_count = header[6] & 0x7f;
+    out->contents_length = odd_count + group_count * 7;
+    index += 8;
+    if (index + (odd_count ? odd_count + 1 : 0) + group_count * 8 + 3 > size)
+        return false;
+    if (odd_count > 0) {
+        msbs = data[index++] << 1;
+        for (byte_index = 0; byte_index < odd_count; ++byte_index) {
+            out->contents[byte_index] = (data[index++] & 0x7f) | (msbs & 0x80);
+            checksum ^= out->contents[byte_index];
+            msbs <<= 1;
+        }
+    }
+    for (group = 0; group < group_count; ++group) {
+        msbs = data[index++] << 1;
+        for (byte_index = 0; byte_index < 7; ++byte_index) {
+            uint8_t *dest = &out->contents[odd_count + group * 7 + byte_index];
+            *dest = (data[index++] & 0x7f) | (msbs & 0x80);
+            checksum ^= *dest;
+            msbs <<= 1;
+        }
+    }
+    if (((data[index] & 0x55) | ((data[index + 1] << 1) & 0xaa)) != checksum)
+        return false;
+    return data[index + 2] == 0xc8;
+}
+
+static void host_bus_reset(void) {
+    bus_cycle(TEST_PHASE_BUS_RESET, 0);
+    bus_cycle(0, 0);
+}
+
+static bool host_init_unit(uint8_t unit_id) {
+    static const uint8_t init_command[9] = {CLEM_SMARTPORT_COMMAND_INIT, 0x02};
+    uint8_t response[TEST_RESPONSE_LIMIT];
+    struct TestResponse decoded;
+    unsigned size = host_transaction(unit_id, init_command, sizeof(init_command), response);
+    if (!host_decode_response(response, size, &decoded))
+        return false;
+    return decoded.source_unit_id == unit_id &&
+           decoded.status == CLEM_SMARTPORT_STATUS_CODE_OK;
+}
+
+void setUp(void) {
+    unsigned index;
+    memset(units, 0, sizeof(units));
+    memset(drives, 0, sizeof(drives));
+    for (index = 0; index < TEST_UNIT_COUNT; ++index) {
+        units[index].device.device_id = CLEM_SMARTPORT_DEVICE_ID_REFERENCE;
+        units[index].device.device_data = &drives[index];
+        units[index].device.do_reset = &test_drive_reset;
+        units[index].device.do_read_block = &test_drive_read_block;
+    }
+    host_write_level = 0;
+    memset(units_active_at_response, 0, sizeof(units_active_at_response));
+}
+
+void tearDown(void) {}
+
+void test_smartport_bus_reset_assigns_ids_in_order(void) {
+    host_bus_reset();
+    TEST_ASSERT_EQUAL_UINT8(0, units[0].unit_id);
+    TEST_ASSERT_EQUAL_UINT8(0, units[1].unit_id);
+
+    //  until it has an ID, the first unit holds PH3 low for the units after it
+    bus_cycle(TEST_PHASE_BUS_ENABLE, 0);
+    TEST_ASSERT_TRUE(units[0].bus_enabled);
+    TEST_ASSERT_FALSE(units[1].bus_enabled);
+    bus_cycle(0, 0);
+
+    TEST_ASSERT_TRUE(host_init_unit(1));
+    TEST_ASSERT_EQUAL_UINT8(1, units[0].unit_id);
+    TEST_ASSERT_EQUAL_UINT8(0, units[1].unit_id);
+    TEST_ASSERT_EQUAL_UINT(1, drives[0].reset_count);
+    TEST_ASSERT_EQUAL_UINT(0, drives[1].reset_count);
+
+    TEST_ASSERT_TRUE(host_init_unit(2));
+    TEST_ASSERT_EQUAL_UINT8(1, units[0].unit_id);
+    TEST_ASSERT_EQUAL_UINT8(2, units[1].unit_id);
+    TEST_ASSERT_EQUAL_UINT(1, drives[0].reset_count);
+    TEST_ASSERT_EQUAL_UINT(1, drives[1].reset_count);
+
+    //  another reset clears the IDs
+    host_bus_reset();
+    TEST_ASSERT_EQUAL_UINT8(0, units[0].unit_id);
+    TEST_ASSERT_EQUAL_UINT8(0, units[1].unit_id);
+}
+
+void test_smartport_bus_read_block_from_second_unit(void) {
+    static const uint8_t read_command[9] = {
+        CLEM_SMARTPORT_COMMAND_READBLOCK, 0x03, 0x00, 0x20, 0x23, 0x01, 0x00};
+    uint8_t response[TEST_RESPONSE_LIMIT];
+    struct TestResponse decoded;
+    unsigned size, offset;
+
+    host_bus_reset();
+    TEST_ASSERT_TRUE(host_init_unit(1));
+    TEST_ASSERT_TRUE(host_init_unit(2));
+
+    size = host_transaction(2, read_command, sizeof(read_command), response);
+    TEST_ASSERT_NOT_EQUAL_UINT(0, size);
+    TEST_ASSERT_TRUE(host_decode_response(response, size, &decoded));
+    TEST_ASSERT_EQUAL_UINT8(2, decoded.source_unit_id);
+    //  a data packet (0x82 on the wire)
+    TEST_ASSERT_EQUAL_UINT8(0x02, decoded.type);
+    TEST_ASSERT_EQUAL_UINT8(CLEM_SMARTPORT_STATUS_CODE_OK, decoded.status);
+    TEST_ASSERT_EQUAL_UINT(TEST_BLOCK_SIZE, decoded.contents_length);
+    for (offset = 0; offset < TEST_BLOCK_SIZE; ++offset) {
+        TEST_ASSERT_EQUAL_UINT8(test_block_byte(0x123, offset), decoded.contents[offset]);
+    }
+    TEST_ASSERT_EQUAL_UINT(1, drives[1].read_count);
+    TEST_ASSERT_EQUAL_UINT(0x123, drives[1].last_block_index);
+
+    //  the first unit saw the packet but left it alone
+    TEST_ASSERT_EQUAL_UINT(0, drives[0].read_count);
+    TEST_ASSERT_FALSE(units_active_at_response[0]);
+    TEST_ASSERT_TRUE(units_active_at_response[1]);
+    TEST_ASSERT_TRUE(units[0].ack_hi);
+    //  and neither is busy once the response is read
+    TEST_ASSERT_FALSE(clem_smartport_unit_is_active(&units[0]));
+    TEST_ASSERT_FALSE(clem_smartport_unit_is_active(&units[1]));
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_smartport_bus_reset_assigns_ids_in_order);
+    RUN_TEST(test_smartport_bus_read_block_from_second_unit);
+    return UNITY_END();
+}
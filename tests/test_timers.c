@@ -0,0 +1,291 @@
+#include "emulator.h"
+#include "emulator_mmio.h"
+#include "unity.h"
+
+#include "clem_mmio_defs.h"
+#include "clem_vgc.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+//  Checks that the periodic interrupt sources (60 Hz tick, 1 sec and quarter
+//  second timers, VBL and scanline IRQs) fire at exactly the clocks they fired
+//  at when every source was polled on every MMIO sync.
+//
+//  The reference model below is the polled implementation these sources were
+//  originally written with.  It is stepped alongside the emulator through an
+//  irregular mix of instruction-sized steps and long stalls, and both must
+//  raise and report the same flags at every step.
+//
+//  The CPU is not emulated.  The machine clock is advanced directly.
+//
+
+#define TEST_TIMERS_SECONDS 30
+
+static ClemensMachine machine;
+static ClemensMMIO mmio;
+
+struct TestTimersReference {
+    uint64_t mega2_cycles;
+    uint32_t timer_60hz_us;
+    uint32_t irq_1sec_us;
+    uint32_t irq_qtrsec_us;
+    uint32_t timer_irq_line;
+
+    clem_clocks_time_t ts_last_frame;
+    clem_clocks_time_t ts_scanline_0;
+    clem_clocks_duration_t dt_scanline;
+    unsigned vbl_counter;
+    bool vbl_started;
+    bool vgc_init;
+    uint32_t vgc_irq_line;
+};
+
+struct TestTimersCounts {
+    unsigned timer_1sec;
+    unsigned timer_qsec;
+    unsigned vbl;
+    unsigned scanline;
+};
+
+static void ref_timer_sync(struct TestTimersReference *ref, uint32_t delta_us) {
+    ref->irq_1sec_us += delta_us;
+    ref->irq_qtrsec_us += delta_us;
+    while (ref->irq_1sec_us >= CLEM_MEGA2_TIMER_1SEC_US) {
+        ref->irq_1sec_us -= CLEM_MEGA2_TIMER_1SEC_US;
+        ref->timer_irq_line |= CLEM_IRQ_TIMER_RTC_1SEC;
+    }
+    while (ref->irq_qtrsec_us >= CLEM_MEGA2_TIMER_QSEC_US) {
+        ref->irq_qtrsec_us -= CLEM_MEGA2_TIMER_QSEC_US;
+        ref->timer_irq_line |= CLEM_IRQ_TIMER_QSEC;
+    }
+}
+
+static bool ref_scanline_int_enabled(const uint8_t *mega2_e1, unsigned v_counter) {
+    if (v_counter >= CLEM_VGC_FIRST_VISIBLE_SCANLINE_CNTR) {
+        v_counter -= CLEM_VGC_FIRST_VISIBLE_SCANLINE_CNTR;
+        if (v_counter < CLEM_VGC_SHGR_SCANLINE_COUNT) {
+            return (mega2_e1[0x9d00 + v_counter] & CLEM_VGC_SCANLINE_CONTROL_INTERRUPT) != 0;
+        }
+    }
+    return false;
+}
+
+static void ref_vgc_sync(struct TestTimersReference *ref, struct ClemensClock *clock,
+                         const uint8_t *mega2_bank1) {
+    unsigned scanline_ns;
+    unsigned frame_ns;
+    unsigned v_counter;
+
+    if (ref->vgc_init) {
+        ref->ts_scanline_0 = clock->ts;
+        ref->dt_scanline = 0;
+        ref->vgc_init = false;
+    } else {
+        frame_ns = clem_calc_ns_step_from_clocks(clock->ts - ref->ts_scanline_0, clock->ref_step);
+        v_counter = (frame_ns / CLEM_VGC_HORIZ_SCAN_TIME_NS) & 0x1ff;
+
+        ref->dt_scanline += (clock->ts - ref->ts_last_frame);
+        scanline_ns = clem_calc_ns_step_from_clocks(ref->dt_scanline, clock->ref_step);
+        if (scanline_ns > CLEM_VGC_HORIZ_SCAN_TIME_NS) {
+            ref->dt_scanline = clem_calc_clocks_step_from_ns(
+                scanline_ns - CLEM_VGC_HORIZ_SCAN_TIME_NS, clock->ref_step);
+            if (ref_scanline_int_enabled(mega2_bank1, v_counter)) {
+                ref->vgc_irq_line |= CLEM_IRQ_VGC_SCAN_LINE;
+            }
+        }
+        if (v_counter >= CLEM_VGC_VBL_NTSC_LOWER_BOUND && !ref->vbl_started) {
+            ref->vgc_irq_line |= CLEM_IRQ_VGC_BLANK;
+            ref->vbl_started = true;
+        }
+        if (frame_ns >= CLEM_VGC_NTSC_SCAN_TIME_NS) {
+            ref->ts_scanline_0 = clock->ts - clem_calc_clocks_step_from_ns(
+                                                 frame_ns - CLEM_VGC_NTSC_SCAN_TIME_NS,
+                                                 clock->ref_step);
+            ref->vbl_started = false;
+            ref->vbl_counter++;
+        }
+    }
+    ref->ts_last_frame = clock->ts;
+}
+
+static void ref_emulate(struct TestTimersReference *ref, const uint8_t *mega2_bank1) {
+    struct ClemensClock clock;
+    uint32_t delta_mega2_cycles =
+        (uint32_t)((machine.tspec.clocks_spent -
+                    ref->mega2_cycles * machine.tspec.clocks_step_mega2) /
+                   machine.tspec.clocks_step_mega2);
+    ref->mega2_cycles += delta_mega2_cycles;
+    ref->timer_60hz_us += delta_mega2_cycles;
+    clock.ts = machine.tspec.clocks_spent;
+    clock.ref_step = machine.tspec.clocks_step_mega2;
+    ref_vgc_sync(ref, &clock, mega2_bank1);
+    while (ref->timer_60hz_us >= CLEM_MEGA2_CYCLES_PER_60TH) {
+        ref_timer_sync(ref, CLEM_MEGA2_CYCLES_PER_60TH);
+        ref->timer_60hz_us -= CLEM_MEGA2_CYCLES_PER_60TH;
+    }
+}
+
+//  The polled VGC read the horizontal counter from the scanline time as of the
+//  last sync
+static uint8_t ref_vgc_read_horizcnt(const struct TestTimersReference *ref,
+                                     struct ClemensClock *clock) {
+    unsigned frame_ns =
+        clem_calc_ns_step_from_clocks(clock->ts - ref->ts_scanline_0, clock->ref_step);
+    unsigned v_counter = (frame_ns / CLEM_VGC_HORIZ_SCAN_TIME_NS) & 0x1ff;
+    unsigned h_counter =
+        (clem_calc_ns_step_from_clocks(ref->dt_scanline, clock->ref_step) / 980) & 0x7f;
+    uint8_t result = h_counter < 1 ? 0x00 : (uint8_t)(0x3f + h_counter);
+    return result | (uint8_t)(((v_counter + 0xfa) & 1) << 7);
+}
+
+void setUp(void) {
+    uint8_t *mega2_bank1;
+    unsigned line;
+    memset(&machine, 0, sizeof(machine));
+    memset(&mmio, 0, sizeof(mmio));
+    clemens_init(&machine, CLEM_CLOCKS_MEGA2_CYCLE, CLEM_CLOCKS_FAST_CYCLE,
+                 calloc(CLEM_IIGS_ROM3_SIZE, 1), CLEM_IIGS_ROM3_SIZE,
+                 calloc(CLEM_IIGS_BANK_SIZE, 1), calloc(CLEM_IIGS_BANK_SIZE, 1),
+                 calloc(CLEM_IIGS_BANK_SIZE * 16, 1), 16);
+    clem_mmio_init(&mmio, &machine.dev_debug, machine.mem.bank_page_map,
+                   machine.tspec.clocks_step_mega2, calloc(2048 * 7, 1), 16);
+    mmio.state_type = kClemensMMIOStateType_Reset;
+    clemens_emulate_mmio(&machine, &mmio);
+
+    //  every source enabled, with scanline interrupts on a spread of lines
+    mmio.dev_timer.flags |= CLEM_MMIO_TIMER_1SEC_ENABLED | CLEM_MMIO_TIMER_QSEC_ENABLED;
+    clem_vgc_set_mode(&mmio.vgc, CLEM_VGC_SUPER_HIRES | CLEM_VGC_ENABLE_VBL_IRQ);
+    clem_vgc_scanline_enable_int(&mmio.vgc, true);
+    mega2_bank1 = machine.mem.mega2_bank_map[1];
+    for (line = 0; line < CLEM_VGC_SHGR_SCANLINE_COUNT; line += 13) {
+        mega2_bank1[0x9d00 + line] |= CLEM_VGC_SCANLINE_CONTROL_INTERRUPT;
+    }
+}
+
+void tearDown(void) {}
+
+static void run_against_reference(uint32_t seed, struct TestTimersCounts *counts) {
+    const uint8_t *mega2_bank1 = machine.mem.mega2_bank_map[1];
+    uint64_t clocks_total = (uint64_t)CLEM_CLOCKS_MEGA2_CYCLE * CLEM_MEGA2_CYCLES_PER_SECOND *
+                            TEST_TIMERS_SECONDS;
+    uint64_t clocks_end = machine.tspec.clocks_spent + clocks_total;
+    struct TestTimersReference ref;
+    struct ClemensClock clock;
+    uint32_t vgc_irqs, r;
+    unsigned step = 0;
+
+    memset(&ref, 0, sizeof(ref));
+    memset(counts, 0, sizeof(*counts));
+    ref.vgc_init = true;
+
+    while (machine.tspec.clocks_spent < clocks_end) {
+        seed = seed * 1664525u + 1013904223u;
+        r = seed >> 8;
+        if ((r & 0xffff) == 0) {
+            //  a stall, i.e. a long DMA or a debugger break
+            machine.tspec.clocks_spent +=
+                machine.tspec.clocks_step_mega2 * (2000 + (r >> 12) % 40000);
+        } else if (r & 0x10) {
+            machine.tspec.clocks_spent += machine.tspec.clocks_step * (2 + (r >> 12) % 29);
+        } else {
+            machine.tspec.clocks_spent += machine.tspec.clocks_step_mega2 * (1 + (r >> 12) % 20);
+        }
+        clemens_emulate_mmio(&machine, &mmio);
+        ref_emulate(&ref, mega2_bank1);
+        ++step;
+
+        vgc_irqs = mmio.vgc.irq_line & (CLEM_IRQ_VGC_BLANK | CLEM_IRQ_VGC_SCAN_LINE);
+        TEST_ASSERT_EQUAL_HEX32_MESSAGE(ref.vgc_irq_line, vgc_irqs, "VGC IRQ");
+        TEST_ASSERT_EQUAL_HEX32_MESSAGE(ref.timer_irq_line, mmio.dev_timer.irq_line,
+                                        "timer IRQ");
+        TEST_ASSERT_EQUAL_UINT_MESSAGE(ref.vbl_counter, mmio.vgc.vbl_counter, "VBL counter");
+
+        if ((step % 7) == 0) {
+            clock.ts = machine.tspec.clocks_spent;
+            clock.ref_step = machine.tspec.clocks_step_mega2;
+            TEST_ASSERT_EQUAL_HEX8_MESSAGE(
+                ref_vgc_read_horizcnt(&ref, &clock),
+                clem_vgc_read_switch(&mmio.vgc, &clock, CLEM_MMIO_REG_VGC_HORIZCNT, 0),
+                "HORIZCNT");
+        }
+
+        if (vgc_irqs & CLEM_IRQ_VGC_BLANK)
+            ++counts->vbl;
+        if (vgc_irqs & CLEM_IRQ_VGC_SCAN_LINE)
+            ++counts->scanline;
+        if (mmio.dev_timer.irq_line & CLEM_IRQ_TIMER_RTC_1SEC)
+            ++counts->timer_1sec;
+        if (mmio.dev_timer.irq_line & CLEM_IRQ_TIMER_QSEC)
+            ++counts->timer_qsec;
+        //  acknowledge everything so the next edge is visible
+        mmio.vgc.irq_line &= ~(CLEM_IRQ_VGC_BLANK | CLEM_IRQ_VGC_SCAN_LINE);
+        mmio.dev_timer.irq_line = 0;
+        ref.vgc_irq_line = 0;
+        ref.timer_irq_line = 0;
+    }
+}
+
+void test_timers_match_polled_model(void) {
+    struct TestTimersCounts counts;
+    run_against_reference(0x1234567u, &counts);
+    //  stalls swallow some edges, so only check the sources actually fired
+    TEST_ASSERT_UINT_WITHIN(2, TEST_TIMERS_SECONDS * 1023 / 1000, counts.timer_1sec);
+    TEST_ASSERT_GREATER_THAN_UINT(TEST_TIMERS_SECONDS * 3, counts.timer_qsec);
+    TEST_ASSERT_GREATER_THAN_UINT(TEST_TIMERS_SECONDS * 50, counts.vbl);
+    TEST_ASSERT_GREATER_THAN_UINT(TEST_TIMERS_SECONDS * 50 * 10, counts.scanline);
+}
+
+void test_timers_match_polled_model_after_reset(void) {
+    struct TestTimersCounts counts;
+    //  start the run from a clock that is not on a mega2 cycle boundary
+    machine.tspec.clocks_spent += machine.tspec.clocks_step * 5;
+    mmio.state_type = kClemensMMIOStateType_Reset;
+    clemens_emulate_mmio(&machine, &mmio);
+    mmio.dev_timer.flags |= CLEM_MMIO_TIMER_1SEC_ENABLED | CLEM_MMIO_TIMER_QSEC_ENABLED;
+    clem_vgc_set_mode(&mmio.vgc, CLEM_VGC_SUPER_HIRES | CLEM_VGC_ENABLE_VBL_IRQ);
+    clem_vgc_scanline_enable_int(&mmio.vgc, true);
+    run_against_reference(0xfeedbeefu, &counts);
+    TEST_ASSERT_GREATER_THAN_UINT(0, counts.timer_1sec);
+    TEST_ASSERT_GREATER_THAN_UINT(0, counts.vbl);
+}
+
+void test_timers_clock_conversions_exact(void) {
+    //  the reciprocal paths must match a plain divide for both machine steps,
+    //  around every quotient boundary and past the 2^32 fallback
+    static const clem_clocks_duration_t steps[] = {CLEM_CLOCKS_FAST_CYCLE,
+                                                   CLEM_CLOCKS_MEGA2_CYCLE, 1000};
+    uint64_t values[] = {0, 1, 0xfffffffeULL, 0xffffffffULL, 0x100000000ULL, 0x123456789aULL};
+    uint64_t clocks;
+    unsigned step_index, value_index;
+    uint32_t seed = 0x2468aceu;
+    for (step_index = 0; step_index < sizeof(steps) / sizeof(steps[0]); ++step_index) {
+        clem_clocks_duration_t step = steps[step_index];
+        for (value_index = 0; value_index < sizeof(values) / sizeof(values[0]); ++value_index) {
+            clocks = values[value_index];
+            TEST_ASSERT_EQUAL_UINT64(clocks / step, clem_calc_clocks_div_step(clocks, step));
+            TEST_ASSERT_EQUAL_UINT32((uint32_t)(CLEM_MEGA2_CYCLE_NS * clocks / step),
+                                     clem_calc_ns_from_clocks_step(clocks, step));
+        }
+        for (clocks = 0; clocks < (uint64_t)step * 4096; ++clocks) {
+            TEST_ASSERT_EQUAL_UINT64(clocks / step, clem_calc_clocks_div_step(clocks, step));
+            TEST_ASSERT_EQUAL_UINT32((uint32_t)(CLEM_MEGA2_CYCLE_NS * clocks / step),
+                                     clem_calc_ns_from_clocks_step(clocks, step));
+        }
+        for (value_index = 0; value_index < 1000000; ++value_index) {
+            seed = seed * 1664525u + 1013904223u;
+            clocks = seed;
+            TEST_ASSERT_EQUAL_UINT64(clocks / step, clem_calc_clocks_div_step(clocks, step));
+            TEST_ASSERT_EQUAL_UINT32((uint32_t)(CLEM_MEGA2_CYCLE_NS * clocks / step),
+                                     clem_calc_ns_from_clocks_step(clocks, step));
+        }
+    }
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_timers_match_polled_model);
+    RUN_TEST(test_timers_match_polled_model_after_reset);
+    RUN_TEST(test_timers_clock_conversions_exact);
+    return UNITY_END();
+}